@@ -43,9 +43,16 @@
 #include "v4coloru.h"
 #include "llsdserialize.h"
 #include "llcleanup.h"
+#include "llmeshdequantize.h"
+#include "llvector4a.h"
+#include "llvolume.h"
+#include "llvolumebvh.h"
+#include "llvolumeoctree.h"
 
 // system libraries
 #include <iostream>
+#include <random>
+#include <vector>
 
 // doc string provided when invoking the program with --help
 static const char USAGE[] = "\n"
@@ -97,6 +104,24 @@ static const char USAGE[] = "\n"
 "        Results in <metric>_report.csv\n"
 " -s, --image-stats\n"
 "        Output stats for each input and output image.\n"
+" -t, --threads <n>\n"
+"        Number of threads the decoder may use on a single large j2c image.\n"
+"        Default is 1 (no threading).\n"
+" -bench, --benchmark <n>\n"
+"        Decode each j2c input file n times and report the decode throughput instead of\n"
+"        converting the files. Honors -d, -r and -t, output files are ignored.\n"
+" -mbench, --mesh-benchmark <n>\n"
+"        Dequantize the positions, texture coordinates and joint weights of a synthetic\n"
+"        mesh face n times and report the throughput. Needs no input file.\n"
+" -bvhbench, --bvh-benchmark <n>\n"
+"        Cast n rays at a synthetic 60K triangles face through its octree and its BVH and\n"
+"        report the build and cast times of each. Needs no input file.\n"
+" -kbench, --kernels-benchmark <n>\n"
+"        Run the raw image channel conversions, compositing and scaling n times on each\n"
+"        input file and report their throughput. Honors -d, -r and -load, output files are ignored.\n"
+" -fbench, --filter-benchmark <n>\n"
+"        Apply the -f filter n times to each input file, on the calling thread then in bands\n"
+"        on a pool of -t threads, and report the time taken both ways. Output files are ignored.\n"
 "\n";
 
 // true when all image loading is done. Used by metric logging thread to know when to stop the thread.
@@ -192,6 +217,365 @@ LLPointer<LLImageRaw> load_image(const std::string &src_filename, int discard_le
     return raw_image;
 }
 
+// Decode the j2c input files passes times over and print the throughput
+void benchmark_decode(const std::list<std::string> &input_filenames, int discard_level, int* region, int passes, int threads)
+{
+    // Load all the files first so that only the decoding is timed
+    std::vector<LLPointer<LLImageJ2C> > images;
+    for (const std::string& filename : input_filenames)
+    {
+        LLPointer<LLImageFormatted> image = create_image(filename);
+        if (image->getCodec() != IMG_CODEC_J2C)
+        {
+            std::cout << "Benchmark : skipping " << filename << ", not a j2c image" << std::endl;
+            continue;
+        }
+        if (!image->load(filename))
+        {
+            std::cout << "Benchmark : image " << filename << " could not be loaded" << std::endl;
+            continue;
+        }
+        images.push_back((LLImageJ2C*)(image.get()));
+    }
+    if (images.empty())
+    {
+        std::cout << "Benchmark : no j2c image to decode" << std::endl;
+        return;
+    }
+
+    S32 decoded = 0;
+    S32 failed = 0;
+    F64 pixels = 0.0;
+    LLTimer timer;
+    for (int pass = 0; pass < passes; ++pass)
+    {
+        for (LLPointer<LLImageJ2C>& image : images)
+        {
+            LLPointer<LLImageRaw> raw_image = new LLImageRaw;
+            if ((discard_level != -1) || (region != NULL))
+            {
+                image->initDecode(*raw_image, discard_level, region);
+            }
+            if (image->decode(raw_image, 0.0f) && raw_image->getData())
+            {
+                ++decoded;
+                pixels += (F64)raw_image->getWidth() * (F64)raw_image->getHeight();
+            }
+            else
+            {
+                ++failed;
+            }
+        }
+    }
+    F64 seconds = llmax(timer.getElapsedTimeF64().value(), 0.000001);
+
+    std::cout << "Benchmark : " << images.size() << " images x " << passes << " passes, "
+              << decoded << " decoded, " << failed << " failed in " << seconds << " s" << std::endl;
+    std::cout << "    " << decoded / seconds << " textures/s, " << pixels / seconds / 1000000.0 << " Mpixels/s, "
+              << decoded / seconds / threads << " textures/s per core (" << threads << " decode threads)" << std::endl;
+}
+
+// Dequantize the streams of a synthetic 64K vertices mesh face passes times
+// over and print the throughput of each
+void benchmark_mesh_decode(int passes)
+{
+    const U32 count = 65536;
+    std::mt19937 rng(1234);
+
+    std::vector<U8> positions(count * 3 * sizeof(U16));
+    std::vector<U8> tex_coords(count * 2 * sizeof(U16));
+    for (U8& b : positions)
+    {
+        b = (U8)rng();
+    }
+    for (U8& b : tex_coords)
+    {
+        b = (U8)rng();
+    }
+
+    // 0 to 4 influences per vertex, 0xFF ending the lists shorter than 4
+    std::vector<U8> weights;
+    for (U32 i = 0; i < count; ++i)
+    {
+        const U32 influences = rng() % 5;
+        for (U32 k = 0; k < influences; ++k)
+        {
+            const U16 w = (U16)rng();
+            weights.push_back((U8)(rng() % 110));
+            weights.push_back((U8)(w & 0xFF));
+            weights.push_back((U8)(w >> 8));
+        }
+        if (influences < 4)
+        {
+            weights.push_back(0xFF);
+        }
+    }
+
+    LLVector4a* out = (LLVector4a*)ll_aligned_malloc_16(count * sizeof(LLVector4a));
+    LLVector4a scale, offset;
+    scale.splat(2.f);
+    offset.splat(-1.f);
+
+    std::cout << "Mesh benchmark : " << count << " vertices x " << passes << " passes" << std::endl;
+
+    LLTimer timer;
+    for (int pass = 0; pass < passes; ++pass)
+    {
+        ll_dequantize_vec3_u16(positions.data(), count, scale, offset, out);
+    }
+    F64 seconds = llmax(timer.getElapsedTimeF64().value(), 0.000001);
+    std::cout << "    positions : " << (F64)count * passes / seconds / 1000000.0 << " Mvertices/s" << std::endl;
+
+    timer.reset();
+    for (int pass = 0; pass < passes; ++pass)
+    {
+        ll_dequantize_vec2_u16(tex_coords.data(), count, scale, offset, (LLVector2*)out);
+    }
+    seconds = llmax(timer.getElapsedTimeF64().value(), 0.000001);
+    std::cout << "    texture coordinates : " << (F64)count * passes / seconds / 1000000.0 << " Mvertices/s" << std::endl;
+
+    U32 consumed = 0;
+    timer.reset();
+    for (int pass = 0; pass < passes; ++pass)
+    {
+        ll_decode_mesh_weights(weights.data(), (U32)weights.size(), count, out, consumed);
+    }
+    seconds = llmax(timer.getElapsedTimeF64().value(), 0.000001);
+    std::cout << "    weights : " << (F64)count * passes / seconds / 1000000.0 << " Mvertices/s" << std::endl;
+
+    ll_aligned_free_16(out);
+}
+
+// Run the raw image conversions, compositing and scaling passes times over
+// the decoded input files and print the throughput of each
+void benchmark_raw_kernels(const std::list<std::string> &input_filenames, int discard_level, int* region, int load_size, int passes)
+{
+    // Decode all the files first, with and without alpha
+    std::vector<LLPointer<LLImageRaw> > rgb_images;
+    std::vector<LLPointer<LLImageRaw> > rgba_images;
+    F64 pixels = 0.0;
+    for (const std::string& filename : input_filenames)
+    {
+        LLPointer<LLImageRaw> raw_image = load_image(filename, discard_level, region, load_size, false);
+        if (!raw_image)
+        {
+            std::cout << "Benchmark : image " << filename << " could not be loaded" << std::endl;
+            continue;
+        }
+        LLPointer<LLImageRaw> rgb = new LLImageRaw(raw_image->getWidth(), raw_image->getHeight(), 3);
+        LLPointer<LLImageRaw> rgba = new LLImageRaw(raw_image->getWidth(), raw_image->getHeight(), 4);
+        if (raw_image->getComponents() == 4)
+        {
+            rgba->copy(raw_image);
+            rgb->copyUnscaled4onto3(raw_image);
+        }
+        else
+        {
+            rgb->copy(raw_image);
+            rgba->copyUnscaled3onto4(raw_image);
+        }
+        rgb_images.push_back(rgb);
+        rgba_images.push_back(rgba);
+        pixels += (F64)raw_image->getWidth() * (F64)raw_image->getHeight();
+    }
+    if (rgb_images.empty())
+    {
+        std::cout << "Benchmark : no image to process" << std::endl;
+        return;
+    }
+
+    std::cout << "Benchmark : " << rgb_images.size() << " images x " << passes << " passes" << std::endl;
+
+    const char* names[] = { "rgba to rgb", "rgb to rgba", "composite", "scale rgb", "scale rgba" };
+    for (int kernel = 0; kernel < 5; ++kernel)
+    {
+        LLTimer timer;
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            for (size_t i = 0; i < rgb_images.size(); ++i)
+            {
+                LLImageRaw* rgb = rgb_images[i];
+                LLImageRaw* rgba = rgba_images[i];
+                switch (kernel)
+                {
+                case 0:
+                    rgb->copyUnscaled4onto3(rgba);
+                    break;
+                case 1:
+                    rgba->copyUnscaled3onto4(rgb);
+                    break;
+                case 2:
+                    rgb->compositeUnscaled4onto3(rgba);
+                    break;
+                default:
+                    {
+                        // To half size, out of the image so that it is scaled from the same size every pass
+                        LLImageRaw* src = (kernel == 3 ? rgb : rgba);
+                        LLPointer<LLImageRaw> scaled = new LLImageRaw(llmax(src->getWidth() / 2, 1), llmax(src->getHeight() / 2, 1), src->getComponents());
+                        scaled->copyScaled(src);
+                    }
+                    break;
+                }
+            }
+        }
+        F64 seconds = llmax(timer.getElapsedTimeF64().value(), 0.000001);
+        std::cout << "    " << names[kernel] << " : " << pixels * passes / seconds / 1000000.0 << " Mpixels/s" << std::endl;
+    }
+}
+
+// Apply the filter passes times to each decoded input file, on the calling
+// thread then on the filter thread pool, and print the time taken both ways
+void benchmark_filter(const std::list<std::string> &input_filenames, const std::string &filter_name, int discard_level, int* region, int load_size, int passes, int threads)
+{
+    std::vector<LLPointer<LLImageRaw> > images;
+    for (const std::string& filename : input_filenames)
+    {
+        LLPointer<LLImageRaw> raw_image = load_image(filename, discard_level, region, load_size, false);
+        if (!raw_image)
+        {
+            std::cout << "Benchmark : image " << filename << " could not be loaded" << std::endl;
+            continue;
+        }
+        images.push_back(raw_image);
+    }
+    if (images.empty())
+    {
+        std::cout << "Benchmark : no image to filter" << std::endl;
+        return;
+    }
+
+    LLImageFilter filter(filter_name);
+    std::vector<LLPointer<LLImageRaw> > serial_results(images.size());
+    F64 seconds[2] = { 0.0, 0.0 };
+    bool same = true;
+    for (int banded = 0; banded < 2; ++banded)
+    {
+        if (banded)
+        {
+            LLImageFilter::initClass(threads);
+        }
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            for (size_t i = 0; i < images.size(); ++i)
+            {
+                // Filter a copy so that every pass works on the same pixels
+                const LLImageRaw* src = images[i];
+                LLPointer<LLImageRaw> image = new LLImageRaw(src->getData(), src->getWidth(), src->getHeight(), src->getComponents());
+                LLTimer timer;
+                filter.executeFilter(image);
+                seconds[banded] += timer.getElapsedTimeF64().value();
+
+                if (pass == 0)
+                {
+                    if (!banded)
+                    {
+                        serial_results[i] = image;
+                    }
+                    else
+                    {
+                        same = same && !memcmp(serial_results[i]->getData(), image->getData(), image->getDataSize());
+                    }
+                }
+            }
+        }
+        LLImageFilter::cleanupClass();
+    }
+
+    std::cout << "Benchmark : " << images.size() << " images x " << passes << " passes, filter " << filter_name << std::endl;
+    std::cout << "    calling thread : " << seconds[0] * 1000.0 << " ms, " << threads << " threads : " << seconds[1] * 1000.0 << " ms"
+              << (same ? "" : ", RESULTS DIFFER") << std::endl;
+}
+
+// Cast rays rays at a synthetic bumpy sphere through the octree and the BVH
+// of its face and print the build and cast times of each
+void benchmark_bvh(int rays)
+{
+    const U32 rings = 150;
+    const U32 segments = 200;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<F32> bump(-0.01f, 0.01f);
+    std::uniform_real_distribution<F32> unit(-1.f, 1.f);
+
+    LLVolumeFace face;
+    face.resizeVertices((rings + 1) * (segments + 1));
+    face.resizeIndices(rings * segments * 6);
+    for (U32 r = 0; r <= rings; ++r)
+    {
+        const F32 theta = F_PI * r / rings;
+        for (U32 s = 0; s <= segments; ++s)
+        {
+            const F32 phi = F_TWO_PI * s / segments;
+            const F32 radius = 0.45f + bump(rng);
+            const U32 i = r * (segments + 1) + s;
+            face.mPositions[i].set(radius * sinf(theta) * cosf(phi), radius * sinf(theta) * sinf(phi), radius * cosf(theta));
+            face.mNormals[i] = face.mPositions[i];
+            face.mNormals[i].normalize3fast();
+            face.mTexCoords[i].set((F32)s / segments, (F32)r / rings);
+        }
+    }
+    U16* idx = face.mIndices;
+    for (U32 r = 0; r < rings; ++r)
+    {
+        for (U32 s = 0; s < segments; ++s)
+        {
+            const U16 i0 = r * (segments + 1) + s;
+            const U16 i1 = i0 + 1;
+            const U16 i2 = i0 + segments + 1;
+            const U16 i3 = i2 + 1;
+            *idx++ = i0; *idx++ = i2; *idx++ = i1;
+            *idx++ = i1; *idx++ = i2; *idx++ = i3;
+        }
+    }
+
+    // Segments from outside the sphere through points near it
+    std::vector<LLVector4a> starts(rays), dirs(rays);
+    for (int i = 0; i < rays; ++i)
+    {
+        starts[i].set(unit(rng), unit(rng), unit(rng));
+        starts[i].normalize3fast();
+        starts[i].mul(2.f);
+        LLVector4a target(unit(rng) * 0.6f, unit(rng) * 0.6f, unit(rng) * 0.6f);
+        dirs[i].setSub(target, starts[i]);
+        dirs[i].mul(1.f + unit(rng));
+    }
+
+    LLTimer timer;
+    face.createOctree();
+    const F64 octree_build = timer.getElapsedTimeF64().value();
+
+    timer.reset();
+    LLVolumeBVH bvh(face.mPositions, face.mNumVertices, face.mIndices, face.mNumIndices);
+    bvh.build();
+    const F64 bvh_build = timer.getElapsedTimeF64().value();
+
+    U32 octree_hits = 0;
+    timer.reset();
+    for (int i = 0; i < rays; ++i)
+    {
+        F32 t = 2.f;
+        LLOctreeTriangleRayIntersect intersect(starts[i], dirs[i], &face, &t, NULL, NULL, NULL, NULL);
+        intersect.traverse(face.getOctree());
+        octree_hits += intersect.mHitFace ? 1 : 0;
+    }
+    const F64 octree_cast = timer.getElapsedTimeF64().value();
+
+    U32 bvh_hits = 0;
+    timer.reset();
+    for (int i = 0; i < rays; ++i)
+    {
+        F32 t = 2.f, a, b;
+        U16 tri[3];
+        bvh_hits += bvh.intersect(face.mPositions, starts[i], dirs[i], t, a, b, tri) ? 1 : 0;
+    }
+    const F64 bvh_cast = timer.getElapsedTimeF64().value();
+
+    std::cout << "BVH benchmark : " << face.mNumIndices / 3 << " triangles, " << rays << " rays" << std::endl;
+    std::cout << "    octree : built in " << octree_build * 1000.0 << " ms, cast in " << octree_cast * 1000.0
+              << " ms, " << octree_hits << " hits" << std::endl;
+    std::cout << "    BVH : built in " << bvh_build * 1000.0 << " ms, cast in " << bvh_cast * 1000.0
+              << " ms, " << bvh_hits << " hits, " << bvh.getMemoryUsage() / 1024 << " KB" << std::endl;
+}
+
 // Save a raw image instance into a file
 bool save_image(const std::string &dest_filename, LLPointer<LLImageRaw> raw_image, int blocks_size, int precincts_size, int levels, bool reversible, bool output_stats)
 {
@@ -356,6 +740,12 @@ int main(int argc, char** argv)
     int blocks_size = -1;
     int levels = 0;
     bool reversible = false;
+    int benchmark_passes = 0;
+    int mesh_benchmark_passes = 0;
+    int kernels_benchmark_passes = 0;
+    int filter_benchmark_passes = 0;
+    int bvh_benchmark_rays = 0;
+    int decode_threads = 1;
     std::string filter_name = "";
 
     // Init whatever is necessary
@@ -557,6 +947,116 @@ int main(int argc, char** argv)
         {
             image_stats = true;
         }
+        else if (!strcmp(argv[arg], "--threads") || !strcmp(argv[arg], "-t"))
+        {
+            std::string value_str;
+            if ((arg + 1) < argc)
+            {
+                value_str = argv[arg+1];
+            }
+            if (((arg + 1) >= argc) || (value_str[0] == '-'))
+            {
+                std::cout << "No valid --threads argument given, decoding won't be threaded" << std::endl;
+            }
+            else
+            {
+                decode_threads = llmax(atoi(value_str.c_str()), 1);
+            }
+        }
+        else if (!strcmp(argv[arg], "--benchmark") || !strcmp(argv[arg], "-bench"))
+        {
+            std::string value_str;
+            if ((arg + 1) < argc)
+            {
+                value_str = argv[arg+1];
+            }
+            if (((arg + 1) >= argc) || (value_str[0] == '-'))
+            {
+                std::cout << "No valid --benchmark argument given, benchmark ignored" << std::endl;
+            }
+            else
+            {
+                benchmark_passes = atoi(value_str.c_str());
+            }
+        }
+        else if (!strcmp(argv[arg], "--mesh-benchmark") || !strcmp(argv[arg], "-mbench"))
+        {
+            std::string value_str;
+            if ((arg + 1) < argc)
+            {
+                value_str = argv[arg+1];
+            }
+            if (((arg + 1) >= argc) || (value_str[0] == '-'))
+            {
+                std::cout << "No valid --mesh-benchmark argument given, benchmark ignored" << std::endl;
+            }
+            else
+            {
+                mesh_benchmark_passes = atoi(value_str.c_str());
+            }
+        }
+        else if (!strcmp(argv[arg], "--bvh-benchmark") || !strcmp(argv[arg], "-bvhbench"))
+        {
+            std::string value_str;
+            if ((arg + 1) < argc)
+            {
+                value_str = argv[arg+1];
+            }
+            if (((arg + 1) >= argc) || (value_str[0] == '-'))
+            {
+                std::cout << "No valid --bvh-benchmark argument given, benchmark ignored" << std::endl;
+            }
+            else
+            {
+                bvh_benchmark_rays = atoi(value_str.c_str());
+            }
+        }
+        else if (!strcmp(argv[arg], "--kernels-benchmark") || !strcmp(argv[arg], "-kbench"))
+        {
+            std::string value_str;
+            if ((arg + 1) < argc)
+            {
+                value_str = argv[arg+1];
+            }
+            if (((arg + 1) >= argc) || (value_str[0] == '-'))
+            {
+                std::cout << "No valid --kernels-benchmark argument given, benchmark ignored" << std::endl;
+            }
+            else
+            {
+                kernels_benchmark_passes = atoi(value_str.c_str());
+            }
+        }
+        else if (!strcmp(argv[arg], "--filter-benchmark") || !strcmp(argv[arg], "-fbench"))
+        {
+            std::string value_str;
+            if ((arg + 1) < argc)
+            {
+                value_str = argv[arg+1];
+            }
+            if (((arg + 1) >= argc) || (value_str[0] == '-'))
+            {
+                std::cout << "No valid --filter-benchmark argument given, benchmark ignored" << std::endl;
+            }
+            else
+            {
+                filter_benchmark_passes = atoi(value_str.c_str());
+            }
+        }
+    }
+
+    // Benchmarks working on synthetic data
+    if (mesh_benchmark_passes > 0)
+    {
+        benchmark_mesh_decode(mesh_benchmark_passes);
+        SUBSYSTEM_CLEANUP(LLImage);
+        return 0;
+    }
+    if (bvh_benchmark_rays > 0)
+    {
+        benchmark_bvh(bvh_benchmark_rays);
+        SUBSYSTEM_CLEANUP(LLImage);
+        return 0;
     }
 
     // Check arguments consistency. Exit with proper message if inconsistent.
@@ -572,6 +1072,36 @@ int main(int argc, char** argv)
     }
 
 
+    LLImageJ2C::setDecodeThreads(decode_threads);
+
+    if (benchmark_passes > 0)
+    {
+        benchmark_decode(input_filenames, discard_level, region, benchmark_passes, decode_threads);
+        SUBSYSTEM_CLEANUP(LLImage);
+        return 0;
+    }
+
+    if (kernels_benchmark_passes > 0)
+    {
+        benchmark_raw_kernels(input_filenames, discard_level, region, load_size, kernels_benchmark_passes);
+        SUBSYSTEM_CLEANUP(LLImage);
+        return 0;
+    }
+
+    if (filter_benchmark_passes > 0)
+    {
+        if (filter_name.empty())
+        {
+            std::cout << "No --filter given, nothing to benchmark -> exit" << std::endl;
+        }
+        else
+        {
+            benchmark_filter(input_filenames, filter_name, discard_level, region, load_size, filter_benchmark_passes, decode_threads);
+        }
+        SUBSYSTEM_CLEANUP(LLImage);
+        return 0;
+    }
+
     // Create the logging thread if required
     if (LLFastTimer::sMetricLog)
     {
@@ -30,6 +30,7 @@
 #include "stdtypes.h"
 
 #include <atomic>
+#include <utility>
 
 template <typename Type, typename AtomicType = std::atomic< Type > > class LLAtomicBase
 {
@@ -66,4 +67,84 @@ typedef LLAtomicBase<S32, std::atomic_int> LLAtomicS32;
 
 typedef LLAtomicBase<bool, std::atomic_bool> LLAtomicBool;
 
+// Lock-free hand-off of items from any number of producer threads to one
+// consumer thread, which takes all the pending items at once. Items come out
+// in the order they were pushed. Since nodes never get popped one by one,
+// there is no ABA problem to guard against.
+template <typename Type> class LLAtomicStack
+{
+public:
+    LLAtomicStack() : mHead(nullptr) {}
+    ~LLAtomicStack()
+    {
+        Node* node = mHead.exchange(nullptr);
+        while (node)
+        {
+            Node* next = node->mNext;
+            delete node;
+            node = next;
+        }
+    }
+
+    LLAtomicStack(const LLAtomicStack&) = delete;
+    LLAtomicStack& operator=(const LLAtomicStack&) = delete;
+
+    void push(Type&& item)
+    {
+        Node* node = new Node(std::move(item));
+        node->mNext = mHead.load(std::memory_order_relaxed);
+        while (!mHead.compare_exchange_weak(node->mNext, node,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void push(const Type& item)
+    {
+        push(Type(item));
+    }
+
+    // Appends all the pending items to container, oldest first. Returns the
+    // number of items taken.
+    template <typename Container>
+    size_t takeAll(Container& container)
+    {
+        Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+
+        // The list is newest first, reverse it
+        Node* oldest = nullptr;
+        while (node)
+        {
+            Node* next = node->mNext;
+            node->mNext = oldest;
+            oldest = node;
+            node = next;
+        }
+
+        size_t count = 0;
+        while (oldest)
+        {
+            Node* next = oldest->mNext;
+            container.push_back(std::move(oldest->mItem));
+            delete oldest;
+            oldest = next;
+            ++count;
+        }
+        return count;
+    }
+
+    bool empty() const { return mHead.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+    struct Node
+    {
+        Node(Type&& item) : mItem(std::move(item)), mNext(nullptr) {}
+        Type mItem;
+        Node* mNext;
+    };
+
+    std::atomic<Node*> mHead;
+};
+
 #endif // LL_LLATOMIC_H
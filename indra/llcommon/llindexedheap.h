@@ -0,0 +1,226 @@
+/**
+ * @file llindexedheap.h
+ * @brief Priority queue whose entries can be found, reprioritized and
+ * removed by key.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINDEXEDHEAP_H
+#define LL_LLINDEXEDHEAP_H
+
+#include "boost/unordered/unordered_flat_map.hpp"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+// A D-ary heap of values queued under unique keys. Like std::priority_queue,
+// top() is the greatest value according to Compare. Any queued value can be
+// looked up, changed or removed by its key in O(log n), which is what
+// queues of requests whose priorities keep changing need.
+// Not thread safe.
+template <typename Key, typename Value, typename Compare = std::less<Value>,
+          typename Hash = boost::hash<Key>, size_t D = 4>
+class LLIndexedHeap
+{
+public:
+    typedef std::pair<Key, Value> entry_t;
+    typedef typename std::vector<entry_t>::const_iterator const_iterator;
+
+    explicit LLIndexedHeap(const Compare& compare = Compare())
+    :   mCompare(compare)
+    {
+    }
+
+    bool empty() const { return mHeap.empty(); }
+    size_t size() const { return mHeap.size(); }
+
+    void clear()
+    {
+        mHeap.clear();
+        mIndex.clear();
+    }
+
+    bool contains(const Key& key) const { return mIndex.find(key) != mIndex.end(); }
+
+    // Returns null when nothing is queued under key
+    const Value* find(const Key& key) const
+    {
+        auto it = mIndex.find(key);
+        return it == mIndex.end() ? nullptr : &mHeap[it->second].second;
+    }
+
+    // Queues value under key, replacing the value already queued under it.
+    // Returns true when nothing was.
+    bool push(const Key& key, const Value& value)
+    {
+        auto it = mIndex.find(key);
+        if (it != mIndex.end())
+        {
+            mHeap[it->second].second = value;
+            restore(it->second);
+            return false;
+        }
+
+        mIndex.emplace(key, mHeap.size());
+        mHeap.emplace_back(key, value);
+        siftUp(mHeap.size() - 1);
+        return true;
+    }
+
+    // Calls fn(Value&) on the value queued under key, then moves it to its
+    // new place. Returns false when nothing is queued under key.
+    template <typename Fn>
+    bool update(const Key& key, Fn fn)
+    {
+        auto it = mIndex.find(key);
+        if (it == mIndex.end())
+        {
+            return false;
+        }
+        const size_t i = it->second;
+        fn(mHeap[i].second);
+        restore(i);
+        return true;
+    }
+
+    const Key& topKey() const { return mHeap.front().first; }
+    const Value& top() const { return mHeap.front().second; }
+
+    // Removes and returns the top entry, the heap must not be empty
+    entry_t pop()
+    {
+        mIndex.erase(mHeap.front().first);
+        entry_t entry = std::move(mHeap.front());
+        fill(0);
+        return entry;
+    }
+
+    // Returns false when nothing was queued under key
+    bool erase(const Key& key)
+    {
+        auto it = mIndex.find(key);
+        if (it == mIndex.end())
+        {
+            return false;
+        }
+        const size_t i = it->second;
+        mIndex.erase(it);
+        fill(i);
+        return true;
+    }
+
+    // In no particular order
+    const_iterator begin() const { return mHeap.begin(); }
+    const_iterator end() const { return mHeap.end(); }
+
+private:
+    // Fills the hole left at i by an entry already removed from mIndex
+    void fill(size_t i)
+    {
+        const size_t last = mHeap.size() - 1;
+        if (i != last)
+        {
+            mHeap[i] = std::move(mHeap[last]);
+            mHeap.pop_back();
+            mIndex[mHeap[i].first] = i;
+            restore(i);
+        }
+        else
+        {
+            mHeap.pop_back();
+        }
+    }
+
+    void restore(size_t i)
+    {
+        if (i > 0 && mCompare(mHeap[(i - 1) / D].second, mHeap[i].second))
+        {
+            siftUp(i);
+        }
+        else
+        {
+            siftDown(i);
+        }
+    }
+
+    void siftUp(size_t i)
+    {
+        entry_t entry = std::move(mHeap[i]);
+        while (i > 0)
+        {
+            const size_t parent = (i - 1) / D;
+            if (!mCompare(mHeap[parent].second, entry.second))
+            {
+                break;
+            }
+            move(parent, i);
+            i = parent;
+        }
+        mHeap[i] = std::move(entry);
+        mIndex[mHeap[i].first] = i;
+    }
+
+    void siftDown(size_t i)
+    {
+        const size_t count = mHeap.size();
+        entry_t entry = std::move(mHeap[i]);
+        while (true)
+        {
+            const size_t first = i * D + 1;
+            if (first >= count)
+            {
+                break;
+            }
+            size_t best = first;
+            const size_t end = first + D < count ? first + D : count;
+            for (size_t child = first + 1; child < end; ++child)
+            {
+                if (mCompare(mHeap[best].second, mHeap[child].second))
+                {
+                    best = child;
+                }
+            }
+            if (!mCompare(entry.second, mHeap[best].second))
+            {
+                break;
+            }
+            move(best, i);
+            i = best;
+        }
+        mHeap[i] = std::move(entry);
+        mIndex[mHeap[i].first] = i;
+    }
+
+    void move(size_t from, size_t to)
+    {
+        mHeap[to] = std::move(mHeap[from]);
+        mIndex[mHeap[to].first] = to;
+    }
+
+    std::vector<entry_t> mHeap;
+    boost::unordered_flat_map<Key, size_t, Hash> mIndex;
+    Compare mCompare;
+};
+
+#endif // LL_LLINDEXEDHEAP_H
@@ -0,0 +1,229 @@
+/**
+ * @file llinternedvector.h
+ * @brief Read mostly vector whose storage is shared by all the vectors
+ * with the same content.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINTERNEDVECTOR_H
+#define LL_LLINTERNEDVECTOR_H
+
+#include "hbxxh.h"
+
+#include "boost/unordered/unordered_map.hpp"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Vector for bulky data loaded many times over, like the joint lists and
+// bind matrices of mesh skins. Once interned, its storage is shared with
+// every other interned vector of the same content, found through a pool
+// hashed on the content. Copies share storage too. Modifying a vector
+// copies the content first so that the others are left as they are, call
+// intern() again to share the result.
+// T is either trivially copyable, compared and hashed as raw bytes, or
+// std::string.
+// The pool is thread safe, a given LLInternedVector is not.
+template <typename T, typename Alloc = std::allocator<T>>
+class LLInternedVector
+{
+public:
+    typedef std::vector<T, Alloc> vector_t;
+    typedef typename vector_t::value_type value_type;
+    typedef typename vector_t::size_type size_type;
+    typedef typename vector_t::const_iterator const_iterator;
+
+    LLInternedVector() = default;
+
+    // Interns data
+    explicit LLInternedVector(vector_t&& data)
+    :   mData(std::make_shared<vector_t>(std::move(data)))
+    {
+        intern();
+    }
+
+    bool empty() const { return get().empty(); }
+    size_type size() const { return get().size(); }
+    const T& operator[](size_type i) const { return get()[i]; }
+    const T* data() const { return get().data(); }
+    const_iterator begin() const { return get().begin(); }
+    const_iterator end() const { return get().end(); }
+
+    const vector_t& get() const
+    {
+        static const vector_t sEmpty;
+        return mData ? *mData : sEmpty;
+    }
+    operator const vector_t&() const { return get(); }
+
+    void set(size_type i, const T& value) { edit()[i] = value; }
+    void push_back(const T& value) { edit().push_back(value); }
+
+    template <typename... Args>
+    void emplace_back(Args&&... args) { edit().emplace_back(std::forward<Args>(args)...); }
+
+    void clear()
+    {
+        mData.reset();
+        mInterned = false;
+    }
+
+    // Shares the storage of the interned vectors with the same content
+    void intern()
+    {
+        if (mInterned || !mData)
+        {
+            return;
+        }
+
+        const U64 hash = hashOf(*mData);
+        Pool& pool = getPool();
+        // Released after the lock, the last reference to one of them going
+        // away locks the pool
+        std::vector<std::shared_ptr<vector_t>> candidates;
+        std::lock_guard<std::mutex> lock(pool.mMutex);
+
+        auto range = pool.mEntries.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            std::shared_ptr<vector_t> shared = it->second.lock();
+            if (shared && equal(*shared, *mData))
+            {
+                mData = std::move(shared);
+                mInterned = true;
+                return;
+            }
+            candidates.emplace_back(std::move(shared));
+        }
+
+        // First of its kind, the pool forgets it once the last vector
+        // sharing it is gone
+        mData = std::shared_ptr<vector_t>(new vector_t(std::move(*mData)), [hash](vector_t* data)
+        {
+            delete data;
+            getPool().release(hash);
+        });
+        pool.mEntries.emplace(hash, mData);
+        mInterned = true;
+    }
+
+    bool interned() const { return mInterned; }
+
+    // Whether both share the same storage, which interned vectors with the
+    // same content do
+    bool sameStorage(const LLInternedVector& other) const { return mData == other.mData; }
+
+    // Number of vectors sharing this one's storage, including this one
+    long useCount() const { return mData.use_count(); }
+
+    // Identifies the storage, as long as this vector holds on to it
+    const void* storageId() const { return mData.get(); }
+
+    // Number of distinct interned contents alive
+    static size_t poolSize()
+    {
+        Pool& pool = getPool();
+        std::lock_guard<std::mutex> lock(pool.mMutex);
+        return pool.mEntries.size();
+    }
+
+private:
+    struct Pool
+    {
+        void release(U64 hash)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto range = mEntries.equal_range(hash);
+            for (auto it = range.first; it != range.second; )
+            {
+                it = it->second.expired() ? mEntries.erase(it) : std::next(it);
+            }
+        }
+
+        std::mutex mMutex;
+        boost::unordered_multimap<U64, std::weak_ptr<vector_t>> mEntries;
+    };
+
+    static Pool& getPool()
+    {
+        // Never destroyed, interned vectors may outlive static destruction
+        static Pool* sPool = new Pool;
+        return *sPool;
+    }
+
+    vector_t& edit()
+    {
+        if (!mData)
+        {
+            mData = std::make_shared<vector_t>();
+        }
+        else if (mInterned || mData.use_count() > 1)
+        {
+            mData = std::make_shared<vector_t>(*mData);
+        }
+        mInterned = false;
+        return *mData;
+    }
+
+    static U64 hashOf(const vector_t& data)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            return HBXXH64::digest(data.data(), data.size() * sizeof(T));
+        }
+        else
+        {
+            HBXXH64 hash;
+            for (const T& value : data)
+            {
+                hash.update(value);
+                // keeps { "ab", "c" } apart from { "a", "bc" }
+                const size_t size = value.size();
+                hash.update(&size, sizeof(size));
+            }
+            return hash.digest();
+        }
+    }
+
+    static bool equal(const vector_t& a, const vector_t& b)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            return a.size() == b.size() && (a.empty() || !memcmp(a.data(), b.data(), a.size() * sizeof(T)));
+        }
+        else
+        {
+            return a == b;
+        }
+    }
+
+    std::shared_ptr<vector_t> mData;
+    bool mInterned = false;
+};
+
+#endif // LL_LLINTERNEDVECTOR_H
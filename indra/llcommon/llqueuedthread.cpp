@@ -323,11 +323,48 @@ void LLQueuedThread::abortRequest(handle_t handle, bool autocomplete)
     LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
     lockData();
     QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+    bool wake = false;
     if (req)
     {
         req->setFlags(FLAG_ABORT | (autocomplete ? FLAG_AUTO_COMPLETE : 0));
+        // A parked request would otherwise never see the abort
+        wake = req->mWaiting;
+        req->mWaiting = false;
     }
     unlockData();
+
+    if (wake)
+    {
+        mRequestQueue.tryPost([this, req]() { processRequest(req); });
+    }
+}
+
+void LLQueuedThread::wakeRequest(handle_t handle)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    lockData();
+    QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
+    bool wake = false;
+    if (req)
+    {
+        if (req->mWaiting)
+        {
+            req->mWaiting = false;
+            wake = true;
+        }
+        else if (req->getStatus() == STATUS_INPROGRESS)
+        {
+            // Keep it from parking once processRequest() returns
+            req->mWoken = true;
+        }
+    }
+    unlockData();
+
+    if (wake)
+    {
+        // If the queue is already closed shutdown() cleans the request up
+        mRequestQueue.tryPost([this, req]() { processRequest(req); });
+    }
 }
 
 // MAIN thread
@@ -417,6 +454,7 @@ void LLQueuedThread::processRequest(LLQueuedThread::QueuedRequest* req)
         if (req)
         {
             req->setStatus(STATUS_INPROGRESS);
+            req->mWoken = false;
         }
         unlockData();
 
@@ -444,13 +482,26 @@ void LLQueuedThread::processRequest(LLQueuedThread::QueuedRequest* req)
             }
             else
             {
-                LL_PROFILE_ZONE_NAMED_CATEGORY_THREAD("qtpr - retry");
                 //put back on queue and try again in 0.1ms
                 lockData();
                 req->setStatus(STATUS_QUEUED);
-
+                // Park requests waiting for an event rather than polling
+                // them, unless the event or an abort already arrived
+                bool park = req->mWaitForWake && !req->mWoken &&
+                    !(req->getFlags() & FLAG_ABORT) && mStatus != QUITTING;
+                req->mWaitForWake = false;
+                req->mWaiting = park;
                 unlockData();
 
+                if (park)
+                {
+                    LL_PROFILE_ZONE_NAMED_CATEGORY_THREAD("qtpr - wait");
+                    mIdleThread = TRUE;
+                    return;
+                }
+
+                LL_PROFILE_ZONE_NAMED_CATEGORY_THREAD("qtpr - retry");
+
 #if 0
                 // try again on next frame
                 // NOTE: tried using "post" with a time in the future, but this
@@ -561,7 +612,10 @@ void LLQueuedThread::threadedUpdate()
 LLQueuedThread::QueuedRequest::QueuedRequest(LLQueuedThread::handle_t handle, U32 flags) :
     LLSimpleHashEntry<LLQueuedThread::handle_t>(handle),
     mStatus(STATUS_UNKNOWN),
-    mFlags(flags)
+    mFlags(flags),
+    mWaitForWake(false),
+    mWaiting(false),
+    mWoken(false)
 {
 }
 
@@ -98,6 +98,14 @@ class LL_COMMON_API LLQueuedThread : public LLThread
             mFlags |= flags;
         }
 
+        // Call from processRequest() before returning false when the request
+        // can't progress until some event: instead of being retried it stays
+        // off the queue until LLQueuedThread::wakeRequest().
+        void waitForWake()
+        {
+            mWaitForWake = true;
+        }
+
         virtual bool processRequest() = 0; // Return true when request has completed
         virtual void finishRequest(bool completed); // Always called from thread after request has completed or aborted
         virtual void deleteRequest(); // Only method to delete a request
@@ -105,6 +113,13 @@ class LL_COMMON_API LLQueuedThread : public LLThread
     protected:
         LLAtomicBase<status_t> mStatus;
         U32 mFlags;
+
+    private:
+        // Only touched by the thread running processRequest()
+        bool mWaitForWake;
+        // Guarded by the thread's data lock
+        bool mWaiting; // parked until wakeRequest()
+        bool mWoken; // wakeRequest() arrived while in progress
     };
 
     //------------------------------------------------------------------------
@@ -148,6 +163,9 @@ class LL_COMMON_API LLQueuedThread : public LLThread
     // Request accessors
     status_t getRequestStatus(handle_t handle);
     void abortRequest(handle_t handle, bool autocomplete);
+    // Puts a request parked by waitForWake() back on the queue. Safe to call
+    // from any thread and before the request has actually parked.
+    void wakeRequest(handle_t handle);
     void setFlags(handle_t handle, U32 flags);
     bool completeRequest(handle_t handle);
     // This is public for support classes like LLWorkerThread,
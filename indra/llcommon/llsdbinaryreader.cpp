@@ -0,0 +1,396 @@
+/**
+ * @file llsdbinaryreader.cpp
+ * @brief Forward-only reader walking binary LLSD in place.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llsdbinaryreader.h"
+
+#include <cstring>
+
+namespace
+{
+    // Same nesting limit as the parser applies to zipped LLSD
+    constexpr S32 MAX_SKIP_DEPTH = 96;
+
+    const char DEPRECATED_HEADER[] = "<? LLSD/Binary ?>";
+    constexpr size_t DEPRECATED_HEADER_SIZE = sizeof(DEPRECATED_HEADER) - 1;
+}
+
+LLSDBinaryReader::LLSDBinaryReader(const U8* data, size_t size)
+:   mCur(data),
+    mEnd(data ? data + size : data)
+{
+    if (size > DEPRECATED_HEADER_SIZE && memcmp(data, DEPRECATED_HEADER, DEPRECATED_HEADER_SIZE) == 0)
+    {
+        mCur += DEPRECATED_HEADER_SIZE;
+        while (mCur < mEnd && (*mCur == '\n' || *mCur == '\r'))
+        {
+            ++mCur;
+        }
+    }
+}
+
+bool LLSDBinaryReader::fail()
+{
+    mFailed = true;
+    mCur = mEnd;
+    return false;
+}
+
+char LLSDBinaryReader::peekType() const
+{
+    return mCur < mEnd ? (char)*mCur : 0;
+}
+
+bool LLSDBinaryReader::readU32(U32& value)
+{
+    if (mEnd - mCur < 4)
+    {
+        return fail();
+    }
+    // Network byte order
+    value = ((U32)mCur[0] << 24) | ((U32)mCur[1] << 16) | ((U32)mCur[2] << 8) | (U32)mCur[3];
+    mCur += 4;
+    return true;
+}
+
+bool LLSDBinaryReader::readSized(const U8*& data, U32& size)
+{
+    if (!readU32(size) || (size_t)(mEnd - mCur) < size)
+    {
+        return fail();
+    }
+    data = mCur;
+    mCur += size;
+    return true;
+}
+
+// Notation style string. Escape sequences are left as they are.
+bool LLSDBinaryReader::readDelimited(char delim, std::string_view& value)
+{
+    const U8* start = mCur;
+    while (mCur < mEnd && *mCur != delim)
+    {
+        if (*mCur == '\\')
+        {
+            ++mCur;
+        }
+        ++mCur;
+    }
+    if (mCur >= mEnd)
+    {
+        return fail();
+    }
+    value = std::string_view((const char*)start, mCur - start);
+    ++mCur;
+    return true;
+}
+
+bool LLSDBinaryReader::beginMap(U32& count)
+{
+    if (peekType() != '{')
+    {
+        return fail();
+    }
+    ++mCur;
+    return readU32(count);
+}
+
+bool LLSDBinaryReader::readKey(std::string_view& key)
+{
+    if (mCur >= mEnd)
+    {
+        return fail();
+    }
+
+    const char c = (char)*mCur++;
+    switch (c)
+    {
+    case 'k':
+    {
+        const U8* data = nullptr;
+        U32 size = 0;
+        if (!readSized(data, size))
+        {
+            return false;
+        }
+        key = std::string_view((const char*)data, size);
+        return true;
+    }
+    case '\'':
+    case '"':
+        return readDelimited(c, key);
+    default:
+        return fail();
+    }
+}
+
+bool LLSDBinaryReader::endMap()
+{
+    if (peekType() != '}')
+    {
+        return fail();
+    }
+    ++mCur;
+    return true;
+}
+
+bool LLSDBinaryReader::beginArray(U32& count)
+{
+    if (peekType() != '[')
+    {
+        return fail();
+    }
+    ++mCur;
+    return readU32(count);
+}
+
+bool LLSDBinaryReader::endArray()
+{
+    if (peekType() != ']')
+    {
+        return fail();
+    }
+    ++mCur;
+    return true;
+}
+
+bool LLSDBinaryReader::readBoolean(bool& value)
+{
+    switch (peekType())
+    {
+    case '1':
+        value = true;
+        break;
+    case '0':
+        value = false;
+        break;
+    default:
+        return fail();
+    }
+    ++mCur;
+    return true;
+}
+
+bool LLSDBinaryReader::readInteger(S32& value)
+{
+    if (peekType() != 'i')
+    {
+        return fail();
+    }
+    ++mCur;
+    U32 raw = 0;
+    if (!readU32(raw))
+    {
+        return false;
+    }
+    value = (S32)raw;
+    return true;
+}
+
+bool LLSDBinaryReader::readReal(F64& value)
+{
+    const char c = peekType();
+    if (c == 'i')
+    {
+        S32 i = 0;
+        if (!readInteger(i))
+        {
+            return false;
+        }
+        value = (F64)i;
+        return true;
+    }
+    if (c != 'r' || mEnd - mCur < 9)
+    {
+        return fail();
+    }
+    ++mCur;
+    U64 raw = 0;
+    for (S32 i = 0; i < 8; ++i)
+    {
+        raw = (raw << 8) | mCur[i];
+    }
+    mCur += 8;
+    memcpy(&value, &raw, sizeof(F64));
+    return true;
+}
+
+bool LLSDBinaryReader::readString(std::string_view& value)
+{
+    const char c = peekType();
+    if (c == 's')
+    {
+        ++mCur;
+        const U8* data = nullptr;
+        U32 size = 0;
+        if (!readSized(data, size))
+        {
+            return false;
+        }
+        value = std::string_view((const char*)data, size);
+        return true;
+    }
+    if (c == '\'' || c == '"')
+    {
+        ++mCur;
+        return readDelimited(c, value);
+    }
+    return fail();
+}
+
+bool LLSDBinaryReader::readBinary(const U8*& data, U32& size)
+{
+    if (peekType() != 'b')
+    {
+        return fail();
+    }
+    ++mCur;
+    return readSized(data, size);
+}
+
+U32 LLSDBinaryReader::readRealArray(F32* values, U32 count)
+{
+    U32 size = 0;
+    if (!beginArray(size))
+    {
+        return 0;
+    }
+
+    U32 read = 0;
+    for (U32 i = 0; i < size; ++i)
+    {
+        if (i < count)
+        {
+            F64 value = 0.0;
+            if (!readReal(value))
+            {
+                return 0;
+            }
+            values[read++] = (F32)value;
+        }
+        else if (!skip())
+        {
+            return 0;
+        }
+    }
+    return endArray() ? read : 0;
+}
+
+bool LLSDBinaryReader::skip()
+{
+    return skip(MAX_SKIP_DEPTH);
+}
+
+bool LLSDBinaryReader::skip(S32 max_depth)
+{
+    if (max_depth <= 0 || mCur >= mEnd)
+    {
+        return fail();
+    }
+
+    const char c = (char)*mCur;
+    switch (c)
+    {
+    case '{':
+    {
+        U32 count = 0;
+        if (!beginMap(count))
+        {
+            return false;
+        }
+        std::string_view key;
+        for (U32 i = 0; i < count; ++i)
+        {
+            if (!readKey(key) || !skip(max_depth - 1))
+            {
+                return false;
+            }
+        }
+        return endMap();
+    }
+    case '[':
+    {
+        U32 count = 0;
+        if (!beginArray(count))
+        {
+            return false;
+        }
+        for (U32 i = 0; i < count; ++i)
+        {
+            if (!skip(max_depth - 1))
+            {
+                return false;
+            }
+        }
+        return endArray();
+    }
+    case '!':
+    case '0':
+    case '1':
+        ++mCur;
+        return true;
+    case 'i':
+        if (mEnd - mCur < 5)
+        {
+            return fail();
+        }
+        mCur += 5;
+        return true;
+    case 'r':
+    case 'd':
+        if (mEnd - mCur < 9)
+        {
+            return fail();
+        }
+        mCur += 9;
+        return true;
+    case 'u':
+        if (mEnd - mCur < 17)
+        {
+            return fail();
+        }
+        mCur += 17;
+        return true;
+    case 's':
+    case 'l':
+    case 'b':
+    {
+        ++mCur;
+        const U8* data = nullptr;
+        U32 size = 0;
+        return readSized(data, size);
+    }
+    case '\'':
+    case '"':
+    {
+        ++mCur;
+        std::string_view value;
+        return readDelimited(c, value);
+    }
+    default:
+        return fail();
+    }
+}
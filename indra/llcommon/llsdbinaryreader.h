@@ -0,0 +1,95 @@
+/**
+ * @file llsdbinaryreader.h
+ * @brief Forward-only reader walking binary LLSD in place.
+ *
+ * @Description:
+ * LLSDBinaryParser builds a complete LLSD tree, copying every string and
+ * binary blob on the way. This reader instead walks a binary LLSD buffer
+ * value by value, so that large documents such as mesh LODs can be decoded
+ * straight into their final storage:
+ *
+ * 1/ Maps and arrays are entered with beginMap()/beginArray(), which return
+ *    the element count, and left with endMap()/endArray().
+ * 2/ Map keys and binary values are returned as views into the buffer.
+ *    They stay valid for as long as the buffer does.
+ * 3/ Values the caller has no use for are skipped with skip().
+ * 4/ Any malformed or truncated input puts the reader in a failed state.
+ *    Every call then fails, so callers may check isValid() once at the end.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSDBINARYREADER_H
+#define LL_LLSDBINARYREADER_H
+
+#include "stdtypes.h"
+
+#include <string_view>
+
+class LL_COMMON_API LLSDBinaryReader
+{
+public:
+    // Skips the deprecated "<? LLSD/Binary ?>" header if present.
+    LLSDBinaryReader(const U8* data, size_t size);
+
+    bool isValid() const { return !mFailed; }
+    bool atEnd() const { return mCur == mEnd; }
+
+    // Marker of the next value ('{', '[', 'b', 'r', ...), 0 at the end.
+    char peekType() const;
+
+    bool beginMap(U32& count);
+    // Key of the next map element. Fails on '}'.
+    bool readKey(std::string_view& key);
+    bool endMap();
+
+    bool beginArray(U32& count);
+    bool endArray();
+
+    bool readBoolean(bool& value);
+    bool readInteger(S32& value);
+    // Accepts integers as well.
+    bool readReal(F64& value);
+    bool readString(std::string_view& value);
+    bool readBinary(const U8*& data, U32& size);
+
+    // Read an array of up to count reals into values, skipping any extra
+    // elements. Returns the number of elements read.
+    U32 readRealArray(F32* values, U32 count);
+
+    // Skip the next value, including any nested map or array.
+    bool skip();
+
+private:
+    bool fail();
+    bool readU32(U32& value);
+    bool readSized(const U8*& data, U32& size);
+    bool readDelimited(char delim, std::string_view& value);
+    bool skip(S32 max_depth);
+
+private:
+    const U8*   mCur;
+    const U8*   mEnd;
+    bool        mFailed = false;
+};
+
+#endif // LL_LLSDBINARYREADER_H
@@ -44,6 +44,9 @@
 # include "zlib/zlib.h"  // for davep's dirty little zip functions
 #endif
 
+#include <zstd.h>
+#include <zdict.h>
+
 #if !LL_WINDOWS
 #include <netinet/in.h> // htonl & ntohl
 #endif
@@ -53,6 +56,7 @@
 #include "llsd.h"
 #include "llstring.h"
 #include "lluri.h"
+#include "llmutex.h"
 
 // File constants
 static const size_t MAX_HDR_LEN = 20;
@@ -2260,100 +2264,327 @@ LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is,
     return unzip_llsd(data, in.get(), size);
 }
 
-LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, const U8* in, S32 size)
+namespace
 {
-    U8* result = NULL;
-    llssize cur_size = 0;
-    z_stream strm;
+    // Level used when re-encoding blocks for the local cache: decoding speed
+    // doesn't depend on it and higher levels cost too much on the mesh decode
+    // threads.
+    constexpr S32 ZSTD_CACHE_LEVEL = 9;
+
+    struct ZstdDictionary
+    {
+        ZstdDictionary(const U8* dict, size_t size)
+        :   mCDict(ZSTD_createCDict(dict, size, ZSTD_CACHE_LEVEL)),
+            mDDict(ZSTD_createDDict(dict, size)),
+            mID(ZDICT_getDictID(dict, size))
+        {
+        }
+        ~ZstdDictionary()
+        {
+            ZSTD_freeCDict(mCDict);
+            ZSTD_freeDDict(mDDict);
+        }
 
-    constexpr llssize CHUNK = (1024 * 1024) * 10;
+        ZSTD_CDict* mCDict;
+        ZSTD_DDict* mDDict;
+        U32 mID;
+    };
+    typedef std::shared_ptr<const ZstdDictionary> zstd_dict_ptr_t;
 
-    static thread_local std::vector<U8, boost::alignment::aligned_allocator<U8, 16>> out;
-    if (out.empty())
+    LLMutex& zstd_dict_mutex()
     {
-        out.resize(CHUNK);
+        static LLMutex sMutex;
+        return sMutex;
     }
 
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = size;
-    strm.next_in = const_cast<U8*>(in);
+    zstd_dict_ptr_t& zstd_dict_ref()
+    {
+        static zstd_dict_ptr_t sDictionary;
+        return sDictionary;
+    }
 
-    S32 ret = inflateInit2(&strm, MAX_WBITS);
-    do
+    zstd_dict_ptr_t get_zstd_dict()
     {
-        strm.avail_out = CHUNK;
-        strm.next_out = out.data();
-        ret = inflate(&strm, Z_NO_FLUSH);
-        switch (ret)
-        {
-        case Z_NEED_DICT:
-        case Z_DATA_ERROR:
+        LLMutexLock lock(&zstd_dict_mutex());
+        return zstd_dict_ref();
+    }
+
+    ZSTD_DCtx* get_zstd_dctx()
+    {
+        static thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> sCtx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        return sCtx.get();
+    }
+
+    ZSTD_CCtx* get_zstd_cctx()
+    {
+        static thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> sCtx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        return sCtx.get();
+    }
+
+    // Parse the binary LLSD of a decompressed block. Takes ownership of result.
+    LLUZipHelper::EZipRresult parse_unzipped_llsd(LLSD& data, U8* result, llssize cur_size)
+    {
+        char* result_ptr = strip_deprecated_header((char*)result, cur_size);
+
+        boost::iostreams::stream<boost::iostreams::array_source> istrm(result_ptr, cur_size);
+
+        const bool parsed = LLSDSerialize::fromBinary(data, istrm, cur_size, UNZIP_LLSD_MAX_DEPTH);
+        free(result);
+        return parsed ? LLUZipHelper::ZR_OK : LLUZipHelper::ZR_PARSE_ERROR;
+    }
+
+    // Inflate a zlib block into a malloc'ed buffer.
+    LLUZipHelper::EZipRresult inflate_block(const U8* in, S32 size, U8*& result, llssize& cur_size)
+    {
+        result = NULL;
+        cur_size = 0;
+        z_stream strm;
+
+        constexpr llssize CHUNK = (1024 * 1024) * 10;
+
+        static thread_local std::vector<U8, boost::alignment::aligned_allocator<U8, 16>> out;
+        if (out.empty())
         {
-            inflateEnd(&strm);
-            free(result);
-            return ZR_DATA_ERROR;
+            out.resize(CHUNK);
         }
-        case Z_STREAM_ERROR:
+
+        strm.zalloc = Z_NULL;
+        strm.zfree = Z_NULL;
+        strm.opaque = Z_NULL;
+        strm.avail_in = size;
+        strm.next_in = const_cast<U8*>(in);
+
+        S32 ret = inflateInit2(&strm, MAX_WBITS);
+        do
+        {
+            strm.avail_out = CHUNK;
+            strm.next_out = out.data();
+            ret = inflate(&strm, Z_NO_FLUSH);
+            switch (ret)
+            {
+            case Z_NEED_DICT:
+            case Z_DATA_ERROR:
+            {
+                inflateEnd(&strm);
+                free(result);
+                result = NULL;
+                return LLUZipHelper::ZR_DATA_ERROR;
+            }
+            case Z_STREAM_ERROR:
+            {
+                inflateEnd(&strm);
+                free(result);
+                result = NULL;
+                return LLUZipHelper::ZR_BUFFER_ERROR;
+            }
+
+            case Z_MEM_ERROR:
+            {
+                inflateEnd(&strm);
+                free(result);
+                result = NULL;
+                return LLUZipHelper::ZR_MEM_ERROR;
+            }
+            }
+
+            llssize have = CHUNK-strm.avail_out;
+            if (have > 0)
+            {
+                U8* new_result = (U8*)realloc(result, cur_size + have);
+                if (new_result == NULL)
+                {
+                    inflateEnd(&strm);
+                    if (result)
+                    {
+                        free(result);
+                        result = NULL;
+                    }
+                    return LLUZipHelper::ZR_MEM_ERROR;
+                }
+                result = new_result;
+                memcpy(result + cur_size, out.data(), have);
+                cur_size += have;
+            }
+
+        } while (strm.avail_out == 0 && ret != Z_STREAM_END);
+
+        inflateEnd(&strm);
+
+        if (ret != Z_STREAM_END)
         {
-            inflateEnd(&strm);
             free(result);
-            return ZR_BUFFER_ERROR;
+            result = NULL;
+            return LLUZipHelper::ZR_DATA_ERROR;
         }
+        return LLUZipHelper::ZR_OK;
+    }
 
-        case Z_MEM_ERROR:
+    // Decode the zstd frame at the start of a block into a malloc'ed buffer.
+    // Anything after the frame is padding and ignored.
+    LLUZipHelper::EZipRresult unzstd_block(const U8* in, S32 size, U8*& result, llssize& cur_size)
+    {
+        result = NULL;
+        cur_size = 0;
+
+        const size_t frame_size = ZSTD_findFrameCompressedSize(in, size);
+        const unsigned long long content_size = ZSTD_getFrameContentSize(in, size);
+        if (ZSTD_isError(frame_size)
+            || content_size == ZSTD_CONTENTSIZE_UNKNOWN
+            || content_size == ZSTD_CONTENTSIZE_ERROR)
         {
-            inflateEnd(&strm);
-            free(result);
-            return ZR_MEM_ERROR;
+            return LLUZipHelper::ZR_DATA_ERROR;
         }
+
+        result = (U8*)malloc(llmax(content_size, 1ULL));
+        if (!result)
+        {
+            return LLUZipHelper::ZR_MEM_ERROR;
         }
 
-        llssize have = CHUNK-strm.avail_out;
-        if (have > 0)
+        size_t ret;
+        ZSTD_DCtx* dctx = get_zstd_dctx();
+        const U32 dict_id = ZSTD_getDictID_fromFrame(in, frame_size);
+        if (dict_id)
         {
-            U8* new_result = (U8*)realloc(result, cur_size + have);
-            if (new_result == NULL)
+            zstd_dict_ptr_t dict = get_zstd_dict();
+            if (!dict || dict->mID != dict_id)
             {
-                inflateEnd(&strm);
-                if (result)
-                {
-                    free(result);
-                }
-                return ZR_MEM_ERROR;
+                // Encoded with a dictionary this session doesn't have
+                free(result);
+                result = NULL;
+                return LLUZipHelper::ZR_VERSION_ERROR;
             }
-            result = new_result;
-            memcpy(result + cur_size, out.data(), have);
-            cur_size += have;
+            ret = ZSTD_decompress_usingDDict(dctx, result, content_size, in, frame_size, dict->mDDict);
+        }
+        else
+        {
+            ret = ZSTD_decompressDCtx(dctx, result, content_size, in, frame_size);
         }
 
-    } while (strm.avail_out == 0 && ret != Z_STREAM_END);
+        if (ZSTD_isError(ret) || ret != content_size)
+        {
+            free(result);
+            result = NULL;
+            return LLUZipHelper::ZR_DATA_ERROR;
+        }
+        cur_size = (llssize)content_size;
+        return LLUZipHelper::ZR_OK;
+    }
+}
 
-    inflateEnd(&strm);
+// static
+bool LLUZipHelper::isZstd(const U8* in, S32 size)
+{
+    return in && size >= 4
+        && in[0] == 0x28 && in[1] == 0xB5 && in[2] == 0x2F && in[3] == 0xFD;
+}
 
-    if (ret != Z_STREAM_END)
+// static
+S32 LLUZipHelper::recompressZstd(const U8* in, S32 size, U8* out, S32 out_size, std::vector<U8>* raw)
+{
+    U8* result = NULL;
+    llssize cur_size = 0;
+    if (!in || size <= 0 || isZstd(in, size) || inflate_block(in, size, result, cur_size) != ZR_OK)
     {
-        free(result);
-        return ZR_DATA_ERROR;
+        return 0;
     }
 
-    //result now points to the decompressed LLSD block
+    size_t ret;
+    ZSTD_CCtx* cctx = get_zstd_cctx();
+    zstd_dict_ptr_t dict = get_zstd_dict();
+    if (dict)
     {
-        char* result_ptr = strip_deprecated_header((char*)result, cur_size);
+        ret = ZSTD_compress_usingCDict(cctx, out, out_size, result, cur_size, dict->mCDict);
+    }
+    else
+    {
+        ret = ZSTD_compressCCtx(cctx, out, out_size, result, cur_size, ZSTD_CACHE_LEVEL);
+    }
 
-        boost::iostreams::stream<boost::iostreams::array_source> istrm(result_ptr, cur_size);
+    if (raw)
+    {
+        raw->assign(result, result + cur_size);
+    }
+    free(result);
+
+    // Not fitting in out_size is reported as an error by zstd
+    return ZSTD_isError(ret) ? 0 : (S32)ret;
+}
 
-        if (!LLSDSerialize::fromBinary(data, istrm, cur_size, UNZIP_LLSD_MAX_DEPTH))
+// static
+bool LLUZipHelper::setZstdDictionary(const U8* dict, size_t size)
+{
+    zstd_dict_ptr_t new_dict;
+    if (dict && size)
+    {
+        new_dict = std::make_shared<ZstdDictionary>(dict, size);
+        if (!new_dict->mCDict || !new_dict->mDDict || !new_dict->mID)
         {
-            free(result);
-            return ZR_PARSE_ERROR;
+            LL_WARNS() << "Invalid zstd dictionary" << LL_ENDL;
+            return false;
         }
     }
 
-    free(result);
-    return ZR_OK;
+    // Threads still decoding with the previous dictionary keep it alive
+    LLMutexLock lock(&zstd_dict_mutex());
+    zstd_dict_ref() = new_dict;
+    return true;
+}
+
+// static
+bool LLUZipHelper::hasZstdDictionary()
+{
+    return get_zstd_dict() != nullptr;
+}
+
+// static
+bool LLUZipHelper::trainZstdDictionary(const std::vector<std::vector<U8>>& samples, size_t dict_size, std::vector<U8>& dict)
+{
+    std::vector<U8> buffer;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (const auto& sample : samples)
+    {
+        if (!sample.empty())
+        {
+            buffer.insert(buffer.end(), sample.begin(), sample.end());
+            sizes.push_back(sample.size());
+        }
+    }
+
+    dict.resize(dict_size);
+    const size_t ret = ZDICT_trainFromBuffer(dict.data(), dict.size(), buffer.data(), sizes.data(), (unsigned)sizes.size());
+    if (ZDICT_isError(ret))
+    {
+        LL_WARNS() << "Failed to train zstd dictionary from " << sizes.size() << " samples: " << ZDICT_getErrorName(ret) << LL_ENDL;
+        dict.clear();
+        return false;
+    }
+    dict.resize(ret);
+    return true;
+}
+
+// static
+LLUZipHelper::EZipRresult LLUZipHelper::unzip_block(const U8* in, S32 size, U8*& result, llssize& result_size)
+{
+    return isZstd(in, size) ? unzstd_block(in, size, result, result_size)
+                            : inflate_block(in, size, result, result_size);
 }
+
+LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, const U8* in, S32 size)
+{
+    U8* result = NULL;
+    llssize cur_size = 0;
+    const EZipRresult ret = unzip_block(in, size, result, cur_size);
+    if (ret != ZR_OK)
+    {
+        return ret;
+    }
+
+    //result now points to the decompressed LLSD block
+    return parse_unzipped_llsd(data, result, cur_size);
+}
+
 //This unzip function will only work with a gzip header and trailer - while the contents
 //of the actual compressed data is the same for either format (gzip vs zlib ), the headers
 //and trailers are different for the formats.
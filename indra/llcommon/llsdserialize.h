@@ -863,8 +863,28 @@ class LL_COMMON_API LLUZipHelper : public LLRefCount
         ZR_VERSION_ERROR
     } EZipRresult;
     // return OK or reason for failure
+    // Accepts zlib blocks as sent by the server and zstd blocks as
+    // re-encoded for the local cache by recompressZstd().
     static EZipRresult unzip_llsd(LLSD& data, std::istream& is, S32 size);
     static EZipRresult unzip_llsd(LLSD& data, const U8* in, S32 size);
+
+    // Decompress a block without parsing it, for LLSDBinaryReader. result
+    // is allocated with malloc() and must be released with free().
+    static EZipRresult unzip_block(const U8* in, S32 size, U8*& result, llssize& result_size);
+
+    static bool isZstd(const U8* in, S32 size);
+
+    // Inflate a zlib block and encode it again as a single zstd frame into
+    // out, using the dictionary set by setZstdDictionary() if any. Returns
+    // the size of the frame, 0 on failure or if the frame doesn't fit in
+    // out_size bytes. raw, when not null, receives the inflated block.
+    static S32 recompressZstd(const U8* in, S32 size, U8* out, S32 out_size, std::vector<U8>* raw = nullptr);
+
+    // Dictionary shared by all threads to encode and decode zstd blocks.
+    // Frames encoded with another dictionary fail with ZR_VERSION_ERROR.
+    static bool setZstdDictionary(const U8* dict, size_t size);
+    static bool hasZstdDictionary();
+    static bool trainZstdDictionary(const std::vector<std::vector<U8>>& samples, size_t dict_size, std::vector<U8>& dict);
 };
 
 //dirty little zip functions -- yell at davep
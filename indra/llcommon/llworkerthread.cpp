@@ -178,7 +178,12 @@ bool LLWorkerThread::WorkRequest::processRequest()
     LL_PROFILE_ZONE_SCOPED;
     LLWorkerClass* workerclass = getWorkerClass();
     workerclass->setWorking(true);
+    workerclass->mWaitForWake = false;
     bool complete = workerclass->doWork(getParam());
+    if (!complete && workerclass->mWaitForWake)
+    {
+        waitForWake();
+    }
     workerclass->setWorking(false);
     return complete;
 }
@@ -201,7 +206,8 @@ LLWorkerClass::LLWorkerClass(LLWorkerThread* workerthread, const std::string& na
       mWorkerClassName(name),
       mRequestHandle(LLWorkerThread::nullHandle()),
       mMutex(),
-      mWorkFlags(0)
+      mWorkFlags(0),
+      mWaitForWake(false)
 {
     if (!mWorkerThread)
     {
@@ -322,6 +328,15 @@ void LLWorkerClass::abortWork(bool autocomplete)
     mMutex.unlock();
 }
 
+void LLWorkerClass::wakeWork()
+{
+    LLMutexLock lock(&mMutex);
+    if (mRequestHandle != LLWorkerThread::nullHandle())
+    {
+        mWorkerThread->wakeRequest(mRequestHandle);
+    }
+}
+
 // if doWork is complete or aborted, call endWork() and return true
 bool LLWorkerClass::checkWork(bool aborting)
 {
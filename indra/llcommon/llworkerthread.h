@@ -147,6 +147,9 @@ class LL_COMMON_API LLWorkerClass
     // schedlueDelete(): schedules deletion once aborted or completed
     void scheduleDelete();
 
+    // wakeWork(): resumes doWork() parked by waitForWake() (ANY THREAD)
+    void wakeWork();
+
     bool haveWork() { return getFlags(WCF_HAVE_WORK); } // may still be true if aborted
     bool isWorking() { return getFlags(WCF_WORKING); }
     bool wasAborted() { return getFlags(WCF_ABORT_REQUESTED); }
@@ -162,6 +165,11 @@ class LL_COMMON_API LLWorkerClass
     // yields the current thread and calls mWorkerThread->checkPause()
     bool yield();
 
+    // Call from doWork only, before returning false when waiting on a
+    // callback: doWork() isn't called again until wakeWork() (or an abort)
+    // instead of being retried every few ms.
+    void waitForWake() { mWaitForWake = true; }
+
     void setWorkerThread(LLWorkerThread* workerthread);
 
     // addWork(): calls startWork, adds doWork() to queue
@@ -193,6 +201,7 @@ class LL_COMMON_API LLWorkerClass
 private:
     LLMutex mMutex;
     LLAtomicU32 mWorkFlags;
+    bool mWaitForWake; // set by doWork() on the worker thread
 };
 
 //============================================================================
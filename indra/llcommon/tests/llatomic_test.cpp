@@ -0,0 +1,113 @@
+/**
+ * @file   llatomic_test.cpp
+ * @brief  Test for LLAtomicStack.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Copyright (c) 2024, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llatomic.h"
+// STL headers
+#include <memory>
+#include <thread>
+#include <vector>
+// std headers
+// external library headers
+// other Linden headers
+#include "../test/lltut.h"
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct llatomic_data
+    {
+    };
+    typedef test_group<llatomic_data> llatomic_group;
+    typedef llatomic_group::object object;
+    llatomic_group llatomicgrp("llatomic");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("Items come out in push order");
+        LLAtomicStack<std::unique_ptr<int>> stack;
+        ensure("starts empty", stack.empty());
+        for (int i = 0; i < 10; ++i)
+        {
+            stack.push(std::make_unique<int>(i));
+        }
+        ensure("not empty", !stack.empty());
+
+        std::vector<std::unique_ptr<int>> items;
+        ensure_equals(stack.takeAll(items), 10);
+        ensure("empty once taken", stack.empty());
+        for (int i = 0; i < 10; ++i)
+        {
+            ensure_equals(*items[i], i);
+        }
+        ensure_equals(stack.takeAll(items), 0);
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("Concurrent producers");
+        const int producers = 4;
+        const int count = 10000;
+        LLAtomicStack<int> stack;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&stack, p, count]()
+                {
+                    for (int i = 0; i < count; ++i)
+                    {
+                        stack.push(p * count + i);
+                    }
+                });
+        }
+
+        // Take while producing, each producer's items must stay in order
+        std::vector<int> items;
+        while (items.size() < producers * count)
+        {
+            stack.takeAll(items);
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        std::vector<int> last(producers, -1);
+        for (int item : items)
+        {
+            int p = item / count;
+            ensure("in order", item % count > last[p]);
+            last[p] = item % count;
+        }
+        for (int p = 0; p < producers; ++p)
+        {
+            ensure_equals(last[p], count - 1);
+        }
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("Pending items are freed");
+        auto item = std::make_shared<int>(1);
+        {
+            LLAtomicStack<std::shared_ptr<int>> stack;
+            stack.push(item);
+            stack.push(item);
+            ensure_equals(item.use_count(), 3);
+        }
+        ensure_equals(item.use_count(), 1);
+    }
+} // namespace tut
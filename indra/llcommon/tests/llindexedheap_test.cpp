@@ -0,0 +1,101 @@
+/**
+ * @file   llindexedheap_test.cpp
+ * @brief  Test for LLIndexedHeap.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Copyright (c) 2024, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llindexedheap.h"
+// STL headers
+#include <map>
+#include <random>
+#include <string>
+// std headers
+// external library headers
+// other Linden headers
+#include "../test/lltut.h"
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct llindexedheap_data
+    {
+        typedef LLIndexedHeap<std::string, int> heap_t;
+    };
+    typedef test_group<llindexedheap_data> llindexedheap_group;
+    typedef llindexedheap_group::object object;
+    llindexedheap_group llindexedheapgrp("llindexedheap");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("Greatest first, by key");
+        heap_t heap;
+        ensure("starts empty", heap.empty());
+        ensure("new key", heap.push("a", 1));
+        ensure("new key", heap.push("b", 5));
+        ensure("new key", heap.push("c", 3));
+        ensure("replaced", !heap.push("a", 4));
+        ensure_equals(heap.size(), 3);
+        ensure_equals(*heap.find("a"), 4);
+        ensure("unknown key", heap.find("d") == nullptr);
+
+        ensure("updated", heap.update("c", [](int& value) { value = 10; }));
+        ensure("unknown key", !heap.update("d", [](int& value) { value = 0; }));
+        ensure_equals(heap.topKey(), "c");
+
+        ensure("erased", heap.erase("b"));
+        ensure("already erased", !heap.erase("b"));
+        ensure_equals(heap.pop().first, "c");
+        ensure_equals(heap.pop().first, "a");
+        ensure("empty once popped", heap.empty());
+        ensure("key forgotten", !heap.contains("a"));
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("Random operations against a reference");
+        std::mt19937 rng(1234);
+        heap_t heap;
+        std::map<std::string, int> reference;
+        for (int i = 0; i < 20000; ++i)
+        {
+            const std::string key = std::to_string(rng() % 200);
+            const int value = (int)(rng() % 1000);
+            switch (rng() % 4)
+            {
+            case 0:
+            case 1:
+                ensure_equals(heap.push(key, value), reference.find(key) == reference.end());
+                reference[key] = value;
+                break;
+            case 2:
+                ensure_equals(heap.erase(key), reference.erase(key) > 0);
+                break;
+            default:
+                if (!reference.empty())
+                {
+                    int greatest = -1;
+                    for (const auto& item : reference)
+                    {
+                        greatest = std::max(greatest, item.second);
+                    }
+                    ensure_equals(heap.top(), greatest);
+                    auto entry = heap.pop();
+                    ensure_equals(entry.second, greatest);
+                    reference.erase(entry.first);
+                }
+                break;
+            }
+            ensure_equals(heap.size(), reference.size());
+        }
+    }
+} // namespace tut
@@ -0,0 +1,120 @@
+/**
+ * @file   llinternedvector_test.cpp
+ * @brief  Test for LLInternedVector.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Copyright (c) 2024, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llinternedvector.h"
+// STL headers
+#include <string>
+#include <thread>
+#include <vector>
+// std headers
+// external library headers
+// other Linden headers
+#include "../test/lltut.h"
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct llinternedvector_data
+    {
+        typedef LLInternedVector<std::string> names_t;
+        typedef LLInternedVector<F32> floats_t;
+    };
+    typedef test_group<llinternedvector_data> llinternedvector_group;
+    typedef llinternedvector_group::object object;
+    llinternedvector_group llinternedvectorgrp("llinternedvector");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("Same content, same storage");
+        const size_t pool_size = names_t::poolSize();
+        {
+            names_t a(std::vector<std::string>{ "mPelvis", "mTorso", "mChest" });
+            names_t b(std::vector<std::string>{ "mPelvis", "mTorso", "mChest" });
+            names_t c(std::vector<std::string>{ "mPelvis", "mTorsoChest" });
+            names_t d(std::vector<std::string>{ "mPelvismTorso", "mChest" });
+            ensure("interned", a.interned() && b.interned());
+            ensure("shared", a.sameStorage(b));
+            ensure("different content", !a.sameStorage(c) && !c.sameStorage(d));
+            ensure_equals(a.size(), 3);
+            ensure_equals(a[1], "mTorso");
+            ensure_equals(names_t::poolSize(), pool_size + 3);
+
+            floats_t e(std::vector<F32>{ 1.f, 2.f });
+            floats_t f(std::vector<F32>{ 1.f, 2.f });
+            ensure("shared raw data", e.sameStorage(f));
+        }
+        ensure_equals("pool forgets", names_t::poolSize(), pool_size);
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("Copy on write");
+        names_t a(std::vector<std::string>{ "mPelvis", "mTorso" });
+        names_t b(a);
+        b.set(1, "mChest");
+        ensure("not interned once modified", !b.interned());
+        ensure_equals("original left alone", a[1], "mTorso");
+        ensure_equals(b[1], "mChest");
+
+        names_t c;
+        ensure("starts empty", c.empty() && c.begin() == c.end());
+        c.push_back("mPelvis");
+        c.emplace_back("mChest");
+        c.intern();
+        b.intern();
+        ensure("shares once interned", b.sameStorage(c));
+
+        names_t d(c);
+        d.clear();
+        ensure("cleared", d.empty());
+        ensure_equals("copy left alone", c.size(), 2);
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("Interning from several threads");
+        std::vector<std::thread> threads;
+        std::vector<std::vector<floats_t>> results(4);
+        for (auto& result : results)
+        {
+            threads.emplace_back([&result]()
+            {
+                for (int i = 0; i < 2000; ++i)
+                {
+                    result.emplace_back(std::vector<F32>{ (F32)(i % 50), 1.f });
+                    if (i % 3 == 0)
+                    {
+                        // let some go while others intern them
+                        result.pop_back();
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (size_t i = 1; i < results.size(); ++i)
+        {
+            for (size_t j = 0; j < results[i].size(); ++j)
+            {
+                ensure("shared across threads", results[i][j].sameStorage(results[0][j]));
+            }
+        }
+    }
+}
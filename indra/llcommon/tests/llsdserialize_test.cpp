@@ -48,6 +48,7 @@ typedef U32 uint32_t;
 
 #include "llsd.h"
 #include "llsdserialize.h"
+#include "llsdbinaryreader.h"
 #include "llsdutil.h"
 #include "llformat.h"
 #include "llmemorystream.h"
@@ -1790,6 +1791,69 @@ namespace tut
         ensureBinaryAndXML("map", test);
     }
 
+    template<> template<>
+    void TestLLSDCompatibleObject::test<9>()
+    {
+        // LLSDBinaryReader walks what the binary formatter writes
+        LLSD face;
+        face["Position"] = LLSD::Binary{ 1, 2, 3, 4, 5, 6 };
+        face["Domain"]["Min"] = llsd::array(-1.0, 0.5, 2);
+        face["Flags"] = llsd::array(true, "skipped", LLUUID::generateNewID());
+        LLSD test = llsd::array(face, LLSD(), 42);
+
+        std::ostringstream ostr;
+        LLSDSerialize::toBinary(test, ostr);
+        const std::string buffer = ostr.str();
+
+        LLSDBinaryReader reader((const U8*)buffer.data(), buffer.size());
+        U32 count = 0;
+        ensure("array", reader.beginArray(count));
+        ensure_equals("array size", count, 3U);
+        ensure("map", reader.beginMap(count));
+        ensure_equals("map size", count, 3U);
+
+        std::string_view key;
+        for (U32 i = 0; i < count; ++i)
+        {
+            ensure("key", reader.readKey(key));
+            if (key == "Position")
+            {
+                const U8* data = nullptr;
+                U32 size = 0;
+                ensure("binary", reader.readBinary(data, size));
+                ensure_equals("binary size", size, 6U);
+                ensure("binary data", memcmp(data, face["Position"].asBinary().data(), size) == 0);
+            }
+            else if (key == "Domain")
+            {
+                U32 domain_count = 0;
+                ensure("domain", reader.beginMap(domain_count) && domain_count == 1 && reader.readKey(key));
+                F32 values[2] = { 0.f, 0.f };
+                ensure_equals("real array", reader.readRealArray(values, 2), 2U);
+                ensure_equals("real", values[0], -1.f);
+                ensure_equals("real", values[1], 0.5f);
+                ensure("domain end", reader.endMap());
+            }
+            else
+            {
+                ensure_equals("unexpected key", std::string(key), "Flags");
+                ensure("skip", reader.skip());
+            }
+        }
+        ensure("map end", reader.endMap());
+        ensure_equals("undef", reader.peekType(), '!');
+        ensure("skip undef", reader.skip());
+        S32 value = 0;
+        ensure("integer", reader.readInteger(value));
+        ensure_equals("integer value", value, 42);
+        ensure("array end", reader.endArray());
+        ensure("end", reader.atEnd() && reader.isValid());
+
+        // Truncated input fails cleanly
+        LLSDBinaryReader truncated((const U8*)buffer.data(), buffer.size() / 2);
+        ensure("truncated", !truncated.skip() && !truncated.isValid());
+    }
+
     // helper for TestPythonCompatible
     static std::string import_llsd("import os.path\n"
                                    "import sys\n"
@@ -2194,4 +2258,117 @@ namespace tut
                         { return LLSDSerialize::fromBinary(data, istr, max_bytes) > 0; });
     }
 |*==========================================================================*/
+
+    // LLUZipHelper zstd blocks, as re-encoded for the mesh cache
+    struct TestLLSDZstd
+    {
+        TestLLSDZstd()
+        {
+            LLUZipHelper::setZstdDictionary(nullptr, 0);
+        }
+
+        ~TestLLSDZstd()
+        {
+            LLUZipHelper::setZstdDictionary(nullptr, 0);
+        }
+
+        // Something shaped like a mesh block, different for each seed
+        static LLSD makeBlock(S32 seed)
+        {
+            LLSD block;
+            block["Material"] = llformat("material%d", seed % 7);
+            std::string positions;
+            for (S32 i = 0; i < 256; ++i)
+            {
+                positions.push_back((char)((i * seed) & 0xff));
+                positions.push_back((char)(i & 0x3f));
+            }
+            block["Position"] = LLSD::Binary(positions.begin(), positions.end());
+            block["PositionDomain"]["Min"] = llsd::array(-0.5, -0.5, (F64)-seed);
+            block["PositionDomain"]["Max"] = llsd::array(0.5, 0.5, (F64)seed);
+            return block;
+        }
+
+        // The zlib block as sent by the server, and its zstd re-encoding
+        // padded with zeroes up to the space of the zlib block
+        static std::vector<U8> recompress(const LLSD& block, std::vector<U8>* raw = nullptr)
+        {
+            LLSD copy(block);
+            const std::string zipped = zip_llsd(copy);
+            ensure("zipped", !zipped.empty() && !LLUZipHelper::isZstd((const U8*)zipped.data(), (S32)zipped.size()));
+
+            std::vector<U8> out(zipped.size() * 2, 0);
+            const S32 encoded = LLUZipHelper::recompressZstd((const U8*)zipped.data(), (S32)zipped.size(),
+                                                             out.data(), (S32)out.size(), raw);
+            ensure("encoded", encoded > 0 && LLUZipHelper::isZstd(out.data(), encoded));
+            ensure("encoded once", LLUZipHelper::recompressZstd(out.data(), (S32)out.size(), out.data(), (S32)out.size()) == 0);
+            return out;
+        }
+    };
+    typedef tut::test_group<TestLLSDZstd> TestLLSDZstdGroup;
+    typedef TestLLSDZstdGroup::object TestLLSDZstdObject;
+    TestLLSDZstdGroup zstdGroup("LLUZipHelper zstd");
+
+    template<> template<>
+    void TestLLSDZstdObject::test<1>()
+    {
+        set_test_name("zstd round trip without a dictionary");
+        const LLSD block = makeBlock(3);
+        std::vector<U8> raw;
+        const std::vector<U8> encoded = recompress(block, &raw);
+
+        std::stringstream expected;
+        LLSDSerialize::toBinary(block, expected);
+        ensure("raw block", std::string(raw.begin(), raw.end()) == expected.str());
+
+        // the zero padding after the frame is skipped
+        LLSD decoded;
+        ensure_equals("unzipped", LLUZipHelper::unzip_llsd(decoded, encoded.data(), (S32)encoded.size()), LLUZipHelper::ZR_OK);
+        ensure("same block", llsd_equals(decoded, block));
+
+        U8* result = nullptr;
+        llssize result_size = 0;
+        ensure_equals("unzipped block", LLUZipHelper::unzip_block(encoded.data(), (S32)encoded.size(), result, result_size), LLUZipHelper::ZR_OK);
+        ensure("same bytes", std::string((const char*)result, result_size) == expected.str());
+        free(result);
+
+        // a frame that doesn't fit is not written
+        LLSD copy(block);
+        const std::string zipped = zip_llsd(copy);
+        U8 small[8];
+        ensure("too small", LLUZipHelper::recompressZstd((const U8*)zipped.data(), (S32)zipped.size(), small, sizeof(small)) == 0);
+    }
+
+    template<> template<>
+    void TestLLSDZstdObject::test<2>()
+    {
+        set_test_name("zstd round trip with a dictionary");
+        std::vector<std::vector<U8>> samples;
+        for (S32 i = 0; i < 500; ++i)
+        {
+            std::vector<U8> raw;
+            recompress(makeBlock(i), &raw);
+            samples.emplace_back(std::move(raw));
+        }
+
+        std::vector<U8> dict;
+        ensure("trained", LLUZipHelper::trainZstdDictionary(samples, 4096, dict));
+        ensure("dictionary set", LLUZipHelper::setZstdDictionary(dict.data(), dict.size()) && LLUZipHelper::hasZstdDictionary());
+
+        const LLSD block = makeBlock(1000);
+        const std::vector<U8> encoded = recompress(block);
+        LLSD decoded;
+        ensure_equals("unzipped", LLUZipHelper::unzip_llsd(decoded, encoded.data(), (S32)encoded.size()), LLUZipHelper::ZR_OK);
+        ensure("same block", llsd_equals(decoded, block));
+
+        // without the dictionary it was encoded with, the block is refused
+        LLUZipHelper::setZstdDictionary(nullptr, 0);
+        ensure_equals("no dictionary", LLUZipHelper::unzip_llsd(decoded, encoded.data(), (S32)encoded.size()), LLUZipHelper::ZR_VERSION_ERROR);
+
+        // and a frame without a dictionary still decodes with one set
+        const std::vector<U8> plain = recompress(block);
+        LLUZipHelper::setZstdDictionary(dict.data(), dict.size());
+        ensure_equals("plain frame", LLUZipHelper::unzip_llsd(decoded, plain.data(), (S32)plain.size()), LLUZipHelper::ZR_OK);
+        ensure("same plain block", llsd_equals(decoded, block));
+    }
 }
@@ -0,0 +1,171 @@
+/**
+ * @file llworkerthread_test.cpp
+ * @brief Test of the workers parked until they are woken
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llworkerthread.h"
+#include "../llcond.h"
+#include "../lltimer.h"
+
+#include <atomic>
+#include <thread>
+
+namespace tut
+{
+    // Parks until woken, then finishes on the next call
+    class ParkedWorker : public LLWorkerClass
+    {
+    public:
+        ParkedWorker(LLWorkerThread* thread) :
+            LLWorkerClass(thread, "ParkedWorker"),
+            mCalls(0),
+            mRelease(true)
+        {
+        }
+
+        // The first doWork() waits for releaseFirstCall() before parking
+        void holdFirstCall() { mRelease.set_all(false); }
+        void releaseFirstCall() { mRelease.set_all(true); }
+        bool waitForFirstCall() { return mEntered.wait_for(F32Milliseconds(5000.f)); }
+
+        void start() { addWork(0); }
+        bool done() { return getFlags(WCF_WORK_FINISHED); }
+        bool check() { return checkWork(); }
+
+        bool doWork(S32 param) override
+        {
+            if (++mCalls > 1)
+            {
+                return true;
+            }
+            mEntered.set_all();
+            mRelease.wait_equal(true);
+            waitForWake();
+            return false;
+        }
+
+        std::atomic<S32> mCalls;
+
+    private:
+        void startWork(S32 param) override {}
+        void endWork(S32 param, bool aborted) override {}
+
+        LLOneShotCond mEntered;
+        LLBoolCond mRelease;
+    };
+
+    struct workerthread_data
+    {
+        workerthread_data() :
+            mThread("llworkerthread_test")
+        {
+        }
+
+        // Waits up to timeout for the worker to be done
+        static bool waitForDone(ParkedWorker& worker, F32 timeout)
+        {
+            LLTimer timer;
+            while (!worker.done())
+            {
+                if (timer.getElapsedTimeF32() > timeout)
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        }
+
+        // Deletes the worker like the owner of the thread does, true once
+        // it is gone
+        bool release(ParkedWorker* worker)
+        {
+            worker->scheduleDelete();
+            LLTimer timer;
+            while (mThread.getNumDeletes() > 0 && timer.getElapsedTimeF32() < 5.f)
+            {
+                mThread.update(0.f);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return mThread.getNumDeletes() == 0;
+        }
+
+        LLWorkerThread mThread;
+    };
+    typedef test_group<workerthread_data> workerthread_group;
+    typedef workerthread_group::object workerthread_object;
+    tut::workerthread_group workerthread("LLWorkerThread");
+
+    template<> template<>
+    void workerthread_object::test<1>()
+    {
+        // A parked worker is not retried until it is woken
+        ParkedWorker* worker = new ParkedWorker(&mThread);
+        worker->start();
+        ensure("first call", worker->waitForFirstCall());
+
+        // the retry interval of an unparked request is 16ms
+        ensure("stays parked", !waitForDone(*worker, 0.2f));
+        ensure_equals("not retried", worker->mCalls.load(), 1);
+
+        worker->wakeWork();
+        ensure("woken", waitForDone(*worker, 5.f));
+        ensure_equals("called again", worker->mCalls.load(), 2);
+        ensure("checked", worker->check());
+        ensure("deleted", release(worker));
+    }
+
+    template<> template<>
+    void workerthread_object::test<2>()
+    {
+        // A wake arriving while doWork() runs, before the worker parks, is
+        // not lost
+        ParkedWorker* worker = new ParkedWorker(&mThread);
+        worker->holdFirstCall();
+        worker->start();
+        ensure("first call", worker->waitForFirstCall());
+
+        worker->wakeWork();
+        worker->releaseFirstCall();
+        ensure("not parked", waitForDone(*worker, 5.f));
+        ensure_equals("called again", worker->mCalls.load(), 2);
+        ensure("checked", worker->check());
+        ensure("deleted", release(worker));
+    }
+
+    template<> template<>
+    void workerthread_object::test<3>()
+    {
+        // Aborting a parked worker finishes it
+        ParkedWorker* worker = new ParkedWorker(&mThread);
+        worker->start();
+        ensure("first call", worker->waitForFirstCall());
+        ensure("parked", !waitForDone(*worker, 0.05f));
+
+        ensure("aborted and deleted", release(worker));
+    }
+}
@@ -39,16 +39,32 @@
 #include <chrono>
 
 #include "lldiskcache.h"
+#include "lldiskcacheindex.h"
+#include "lldiskcachepack.h"
 
 const std::string DISK_CACHE_DIR_NAME = "cache";
+const std::string DISK_CACHE_INDEX_NAME = "cache_index.dat";
 
 LLDiskCache::LLDiskCache()
 {
 }
 
-void LLDiskCache::init(ELLPath location, const uintmax_t max_size_bytes, const bool enable_cache_debug_info, const bool cache_version_mismatch)
+LLDiskCache::~LLDiskCache()
+{
+    if (mPack)
+    {
+        mPack->close();
+    }
+    if (mIndex)
+    {
+        mIndex->close();
+    }
+}
+
+void LLDiskCache::init(ELLPath location, const uintmax_t max_size_bytes, const bool enable_cache_debug_info, const bool cache_version_mismatch, const U32 pack_threshold_bytes)
 {
     mMaxSizeBytes = max_size_bytes;
+    mPackThresholdBytes = pack_threshold_bytes;
     mEnableCacheDebugInfo = enable_cache_debug_info;
     mCacheDir = gDirUtilp->getExpandedFilename(location, DISK_CACHE_DIR_NAME);
 
@@ -58,9 +74,49 @@ void LLDiskCache::init(ELLPath location, const uintmax_t max_size_bytes, const b
     }
 
     createCache();
+
+    if (!mReadOnly)
+    {
+        openIndex();
+    }
+    openPack();
+}
+
+void LLDiskCache::openIndex()
+{
+    if (!mIndex)
+    {
+        mIndex = std::make_unique<LLDiskCacheIndex>();
+    }
+
+    const std::string index_file = fmt::format("{}{}{}", mCacheDir, gDirUtilp->getDirDelimiter(), DISK_CACHE_INDEX_NAME);
+    if (!mIndex->open(index_file))
+    {
+        LL_WARNS() << "Unable to open disk cache index " << index_file << ", falling back to directory scans" << LL_ENDL;
+    }
 }
 
 
+void LLDiskCache::openPack()
+{
+    if (mReadOnly)
+    {
+        // The assets the other instance packed are only found in its packs
+        mPack = std::make_unique<LLDiskCachePack>(mCacheDir, mPackThresholdBytes, true);
+        mPack->open();
+    }
+    else if (mPackThresholdBytes && mIndex && mIndex->isOpen())
+    {
+        mPack = std::make_unique<LLDiskCachePack>(mCacheDir, mPackThresholdBytes);
+        mPack->open();
+    }
+    else
+    {
+        // Without the backend nothing would ever read or purge them
+        LLDiskCachePack::deletePackFiles(mCacheDir);
+    }
+}
+
 void LLDiskCache::createCache()
 {
     LLFile::mkdir(mCacheDir);
@@ -103,16 +159,19 @@ void LLDiskCache::purge()
 {
     if (mReadOnly) return;
 
-    if (mEnableCacheDebugInfo)
+    if (mIndex && mIndex->isOpen())
     {
-        LL_INFOS() << "Total dir size before purge is " << dirFileSize(mCacheDir) << LL_ENDL;
+        purgeFromIndex();
+    }
+    else
+    {
+        purgeFromScan();
     }
+}
 
+bool LLDiskCache::scanCacheDir(std::vector<file_info_t>& file_info)
+{
     boost::system::error_code ec;
-    auto start_time = std::chrono::high_resolution_clock::now();
-
-    typedef std::pair<std::time_t, std::pair<uintmax_t, boost::filesystem::path>> file_info_t;
-    std::vector<file_info_t> file_info;
 
 #if LL_WINDOWS
     boost::filesystem::path cache_path(ll_convert_string_to_wide(mCacheDir));
@@ -128,7 +187,7 @@ void LLDiskCache::purge()
             {
                 if(!LLApp::isRunning())
                 {
-                    return;
+                    return false;
                 }
 
                 if (boost::filesystem::is_regular_file(entry, ec) && !ec.failed())
@@ -155,6 +214,113 @@ void LLDiskCache::purge()
         }
     }
 
+    return true;
+}
+
+void LLDiskCache::purgeFromIndex()
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    if (mIndex->needsScan())
+    {
+        // One-off walk of the directory to seed an index that was missing
+        // or left behind by a crash.
+        std::vector<file_info_t> file_info;
+        if (!scanCacheDir(file_info))
+        {
+            return;
+        }
+
+        LLDiskCacheIndex::scanned_list_t scanned;
+        scanned.reserve(file_info.size());
+        for (const file_info_t& entry : file_info)
+        {
+            const std::string stem = entry.second.second.stem().string();
+            if (LLUUID::validate(stem))
+            {
+                scanned.push_back({ LLUUID(stem), entry.second.first, entry.first });
+            }
+        }
+        // Packed assets are not in the directory listing
+        if (mPack)
+        {
+            LLDiskCachePack::entry_list_t packed;
+            mPack->getEntries(packed);
+            const std::time_t now = std::time(nullptr);
+            for (const LLDiskCachePack::PackedEntry& entry : packed)
+            {
+                scanned.push_back({ entry.mID, entry.mSize, now });
+            }
+        }
+        mIndex->mergeScan(scanned);
+
+        LL_INFOS() << "Rebuilt disk cache index from " << scanned.size() << " files" << LL_ENDL;
+    }
+
+    LL_INFOS() << "Purging cache to a maximum of " << mMaxSizeBytes << " bytes" << LL_ENDL;
+
+    LLDiskCacheIndex::evicted_list_t evicted;
+    mIndex->evict(mMaxSizeBytes, evicted);
+
+    // The entries are already gone from the index so keep going even if the
+    // viewer is shutting down, otherwise the files would be orphaned until
+    // the next rebuild.
+    boost::system::error_code ec;
+    for (const LLDiskCacheIndex::EvictedEntry& entry : evicted)
+    {
+        if (mPack && mPack->remove(entry.mID))
+        {
+            continue;
+        }
+
+        const boost::filesystem::path file_path = metaDataToFilepath(entry.mID, entry.mType);
+        boost::filesystem::remove(file_path, ec);
+        if (ec.failed())
+        {
+            LL_WARNS() << "Failed to delete cache file " << file_path << ": " << ec.message() << LL_ENDL;
+        }
+    }
+
+    // Reclaim the space of removed and superseded packed assets
+    if (mPack)
+    {
+        mPack->removeStaleFiles();
+        mPack->compact();
+    }
+
+    if (mEnableCacheDebugInfo)
+    {
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto execute_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+
+        for (const LLDiskCacheIndex::EvictedEntry& entry : evicted)
+        {
+            std::ostringstream line;
+            line << "DELETE:  " << entry.mLastAccess << "  " << entry.mSize << "  " << entry.mID;
+            LL_INFOS() << line.str() << LL_ENDL;
+        }
+
+        LL_INFOS() << "Total indexed size after purge is " << mIndex->getTotalSize() << " in " << mIndex->getEntryCount() << " files" << LL_ENDL;
+        LL_INFOS() << "Cache purge took " << execute_time << " ms to evict " << evicted.size() << " files" << LL_ENDL;
+    }
+}
+
+void LLDiskCache::purgeFromScan()
+{
+    if (mEnableCacheDebugInfo)
+    {
+        LL_INFOS() << "Total dir size before purge is " << dirFileSize(mCacheDir) << LL_ENDL;
+    }
+
+    boost::system::error_code ec;
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    std::vector<file_info_t> file_info;
+    if (!scanCacheDir(file_info))
+    {
+        return;
+    }
+
     std::sort(file_info.begin(), file_info.end(), [](const file_info_t& x, const file_info_t& y)
     {
         return x.first > y.first;
@@ -335,9 +501,62 @@ void LLDiskCache::updateFileAccessTime(const boost::filesystem::path& file_path)
     }
 }
 
+void LLDiskCache::recordRead(const LLUUID& id, LLAssetType::EType at, const boost::filesystem::path& file_path)
+{
+    if (mIndex && mIndex->isOpen())
+    {
+        if (mIndex->touch(id))
+        {
+            return;
+        }
+
+        // Not indexed yet (e.g. before the first rebuild): pick it up now
+        boost::system::error_code ec;
+        const uintmax_t file_size = boost::filesystem::file_size(file_path, ec);
+        if (!ec.failed())
+        {
+            mIndex->recordWrite(id, at, file_size, true);
+        }
+        return;
+    }
+
+    boost::system::error_code ec;
+    bool exists = boost::filesystem::exists(file_path, ec);
+    if (exists && !ec.failed())
+    {
+        updateFileAccessTime(file_path);
+    }
+}
+
+void LLDiskCache::recordWrite(const LLUUID& id, LLAssetType::EType at, uintmax_t end_offset, bool truncated)
+{
+    if (mIndex)
+    {
+        mIndex->recordWrite(id, at, end_offset, truncated);
+    }
+}
+
+void LLDiskCache::recordRemove(const LLUUID& id)
+{
+    if (mIndex)
+    {
+        mIndex->remove(id);
+    }
+}
+
+void LLDiskCache::recordRename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type)
+{
+    if (mIndex)
+    {
+        mIndex->rename(old_id, new_id, new_type);
+    }
+}
+
 const std::string LLDiskCache::getCacheInfo()
 {
-    uintmax_t cache_used_mb = dirFileSize(mCacheDir) / (1024U * 1024U);
+    // The index knows the total without walking the whole directory
+    const uintmax_t cache_used = (mIndex && mIndex->isOpen() && !mIndex->needsScan()) ? mIndex->getTotalSize() : dirFileSize(mCacheDir);
+    uintmax_t cache_used_mb = cache_used / (1024U * 1024U);
 
     uintmax_t max_in_mb = mMaxSizeBytes / (1024U * 1024U);
     F64 percent_used = ((F64)cache_used_mb / (F64)max_in_mb) * 100.0;
@@ -349,6 +568,18 @@ void LLDiskCache::clearCache(ELLPath location, bool recreate_cache)
 {
     if (!mReadOnly)
     {
+        // The index and pack files are removed along with everything else,
+        // close them first
+        const bool reopen_index = mIndex && mIndex->isOpen();
+        if (mPack)
+        {
+            mPack->close();
+        }
+        if (reopen_index)
+        {
+            mIndex->close();
+        }
+
         std::string disk_cache_dir = gDirUtilp->getExpandedFilename(location, DISK_CACHE_DIR_NAME);
 
         const char* subdirs = "0123456789abcdef";
@@ -371,6 +602,15 @@ void LLDiskCache::clearCache(ELLPath location, bool recreate_cache)
         {
             createCache();
         }
+
+        if (reopen_index)
+        {
+            openIndex();
+            if (mPack)
+            {
+                mPack->open();
+            }
+        }
     }
 }
 
@@ -28,6 +28,10 @@
  *    directory, sorts them by date of last access (write) and then
  *    deletes any files based on age until the total size of all
  *    the files is less than the maximum size specified.
+ *    When the persistent index (see lldiskcacheindex.h) is available,
+ *    reads and writes are recorded there instead and the purge simply
+ *    takes the least recently used entries off the index; the directory
+ *    is only walked once to rebuild an index that cannot be trusted.
  * 4/ An LLSingleton idiom is used since there will only ever be
  *    a single cache and we want to access it from numerous places.
  * 5/ Performance on my modest system seems very acceptable. For
@@ -68,6 +72,11 @@
 
 #include "boost/unordered/unordered_flat_set.hpp"
 
+#include <memory>
+
+class LLDiskCacheIndex;
+class LLDiskCachePack;
+
 class LLDiskCache final :
     public LLSimpleton<LLDiskCache>
 {
@@ -80,7 +89,7 @@ class LLDiskCache final :
          * the class via a call in LLAppViewer.
          */
         LLDiskCache();
-        virtual ~LLDiskCache() = default;
+        virtual ~LLDiskCache();
 public:
         void init(
             /**
@@ -101,7 +110,12 @@ class LLDiskCache final :
             /**
              * Cache version mismatch purge
              */
-            const bool cache_version_mismatch);
+            const bool cache_version_mismatch,
+            /**
+             * Assets no bigger than this are stored in pack files
+             * rather than a file each. Zero disables the pack files.
+             */
+            const U32 pack_threshold_bytes = 0);
 
         /**
          * Construct a filename and path to it based on the file meta data
@@ -120,6 +134,29 @@ class LLDiskCache final :
          */
         static void updateFileAccessTime(const boost::filesystem::path& file_path);
 
+        /**
+         * Record a read of the cache file for an asset. With the index this
+         * is an in-memory update; without it, this falls back on
+         * updateFileAccessTime() if the file exists.
+         */
+        void recordRead(const LLUUID& id, LLAssetType::EType at,
+                        const boost::filesystem::path& file_path);
+
+        /**
+         * Record a write to the cache file for an asset. end_offset is the
+         * position just past the last byte written and truncated is true
+         * when the write replaced the previous contents of the file.
+         */
+        void recordWrite(const LLUUID& id, LLAssetType::EType at,
+                         uintmax_t end_offset, bool truncated);
+
+        /**
+         * Keep the index in step with removed and renamed cache files
+         */
+        void recordRemove(const LLUUID& id);
+        void recordRename(const LLUUID& old_id, const LLUUID& new_id,
+                          LLAssetType::EType new_type);
+
         /**
          * Purge the oldest items in the cache so that the combined size of all files
          * is no bigger than mMaxSizeBytes.
@@ -149,7 +186,44 @@ class LLDiskCache final :
 
         void setReadonly(bool read_only) { mReadOnly = read_only; }
 
+        /**
+         * Directory holding the cached assets, emptied by clearCache()
+         */
+        const std::string& getCacheDirName() const { return mCacheDir; }
+
+        /**
+         * The pack file backend for small assets, null when disabled
+         */
+        LLDiskCachePack* getPack() const { return mPack.get(); }
+
     private:
+        typedef std::pair<std::time_t, std::pair<uintmax_t, boost::filesystem::path>> file_info_t;
+
+        /**
+         * Walk the cache directory and collect the last write time, size
+         * and path of every cache file. Returns false if the viewer started
+         * shutting down during the scan.
+         */
+        bool scanCacheDir(std::vector<file_info_t>& file_info);
+
+        /**
+         * The two purge strategies: from the persistent index or, when it
+         * is not available, from a full directory scan.
+         */
+        void purgeFromIndex();
+        void purgeFromScan();
+
+        /**
+         * Open the persistent index in the cache directory
+         */
+        void openIndex();
+
+        /**
+         * Open the pack files in the cache directory, read only when the
+         * cache is, or delete them if the pack backend is disabled
+         */
+        void openPack();
+
         /**
          * Utility function to gather the total size the files in a given
          * directory. Primarily used here to determine the directory size
@@ -202,6 +276,21 @@ class LLDiskCache final :
         bool mEnableCacheDebugInfo = false;
 
         bool mReadOnly = false;
+
+        /**
+         * Persistent metadata index of the cache files. Null when the cache
+         * is read only (second viewer instance) or the index can't be
+         * mapped, in which case the old directory scan is used.
+         */
+        std::unique_ptr<LLDiskCacheIndex> mIndex;
+
+        /**
+         * Pack file storage for small assets. Requires the index, which is
+         * what keeps track of their last access for the purge, unless the
+         * cache is read only.
+         */
+        std::unique_ptr<LLDiskCachePack> mPack;
+        U32 mPackThresholdBytes = 0;
 };
 
 class LLPurgeDiskCacheThread : public LLThread
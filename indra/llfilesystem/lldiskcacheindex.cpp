@@ -0,0 +1,449 @@
+/**
+ * @file lldiskcacheindex.cpp
+ * @brief Persistent, memory-mapped metadata index for the disk cache.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lldiskcacheindex.h"
+
+#include <algorithm>
+
+namespace
+{
+    constexpr U32 INDEX_MAGIC = 0x58444349; // 'ICDX'
+    constexpr U32 INDEX_VERSION = 1;
+    constexpr U32 INITIAL_CAPACITY = 4096;
+}
+
+LLDiskCacheIndex::~LLDiskCacheIndex()
+{
+    close();
+}
+
+LLDiskCacheIndex::Header* LLDiskCacheIndex::header() const
+{
+    return reinterpret_cast<Header*>(mFile.data());
+}
+
+LLDiskCacheIndex::Record* LLDiskCacheIndex::record(U32 slot) const
+{
+    return reinterpret_cast<Record*>(mFile.data() + sizeof(Header)) + slot;
+}
+
+bool LLDiskCacheIndex::open(const std::string& filename)
+{
+    static_assert(sizeof(Header) == 32, "LLDiskCacheIndex::Header layout changed");
+    static_assert(sizeof(Record) == 48, "LLDiskCacheIndex::Record layout changed");
+
+    LLMutexLock lock(&mMutex);
+
+    if (!mFile.open(filename, sizeof(Header) + INITIAL_CAPACITY * sizeof(Record)))
+    {
+        return false;
+    }
+
+    const U32 file_capacity = (U32)((mFile.size() - sizeof(Header)) / sizeof(Record));
+    Header* hdr = header();
+    const bool trusted = hdr->mMagic == INDEX_MAGIC
+                      && hdr->mVersion == INDEX_VERSION
+                      && hdr->mCapacity <= file_capacity
+                      && hdr->mClean == 1;
+
+    mSlots.clear();
+    mFreeSlots.clear();
+    mTotalSize = 0;
+
+    if (trusted)
+    {
+        hdr->mCapacity = file_capacity;
+        mPrev.assign(file_capacity, NIL);
+        mNext.assign(file_capacity, NIL);
+        for (U32 slot = file_capacity; slot-- > 0; )
+        {
+            Record* rec = record(slot);
+            if (rec->mInUse)
+            {
+                mSlots[rec->mID] = slot;
+                mTotalSize += rec->mSize;
+            }
+            else
+            {
+                mFreeSlots.push_back(slot);
+            }
+        }
+        rebuildLRU();
+        mNeedsScan = false;
+    }
+    else
+    {
+        LL_INFOS() << "Disk cache index " << filename << " is missing or stale, it will be rebuilt" << LL_ENDL;
+        reset();
+        mNeedsScan = true;
+    }
+
+    // Anything past this point may leave the index out of sync with the
+    // files if we crash, so only a clean close() sets this again.
+    header()->mClean = 0;
+    mFile.flush(false);
+
+    LL_INFOS() << "Disk cache index opened with " << mSlots.size() << " entries totalling " << mTotalSize << " bytes" << LL_ENDL;
+    return true;
+}
+
+void LLDiskCacheIndex::close()
+{
+    LLMutexLock lock(&mMutex);
+
+    if (mFile.isOpen())
+    {
+        header()->mClean = 1;
+        mFile.close();
+    }
+
+    mSlots.clear();
+    mFreeSlots.clear();
+    mPrev.clear();
+    mNext.clear();
+    mHead = mTail = NIL;
+    mTotalSize = 0;
+}
+
+bool LLDiskCacheIndex::isOpen() const
+{
+    LLMutexLock lock(&mMutex);
+    return mFile.isOpen();
+}
+
+bool LLDiskCacheIndex::needsScan() const
+{
+    LLMutexLock lock(&mMutex);
+    return mNeedsScan;
+}
+
+void LLDiskCacheIndex::reset()
+{
+    const U32 capacity = (U32)((mFile.size() - sizeof(Header)) / sizeof(Record));
+    memset(mFile.data(), 0, mFile.size());
+
+    Header* hdr = header();
+    hdr->mMagic = INDEX_MAGIC;
+    hdr->mVersion = INDEX_VERSION;
+    hdr->mCapacity = capacity;
+    hdr->mGeneration = 0;
+
+    mSlots.clear();
+    mFreeSlots.clear();
+    mFreeSlots.reserve(capacity);
+    for (U32 slot = capacity; slot-- > 0; )
+    {
+        mFreeSlots.push_back(slot);
+    }
+    mPrev.assign(capacity, NIL);
+    mNext.assign(capacity, NIL);
+    mHead = mTail = NIL;
+    mTotalSize = 0;
+}
+
+bool LLDiskCacheIndex::grow()
+{
+    const U32 old_capacity = header()->mCapacity;
+    const U32 new_capacity = old_capacity * 2;
+    if (!mFile.resize(sizeof(Header) + (size_t)new_capacity * sizeof(Record)))
+    {
+        LL_WARNS() << "Unable to grow disk cache index to " << new_capacity << " entries" << LL_ENDL;
+        return false;
+    }
+
+    // resize() zero fills the new records, so they are all free.
+    header()->mCapacity = new_capacity;
+    mPrev.resize(new_capacity, NIL);
+    mNext.resize(new_capacity, NIL);
+    for (U32 slot = new_capacity; slot-- > old_capacity; )
+    {
+        mFreeSlots.push_back(slot);
+    }
+    return true;
+}
+
+void LLDiskCacheIndex::rebuildLRU()
+{
+    std::vector<U32> slots;
+    slots.reserve(mSlots.size());
+    for (const auto& entry : mSlots)
+    {
+        slots.push_back(entry.second);
+    }
+
+    std::sort(slots.begin(), slots.end(), [this](U32 a, U32 b)
+    {
+        const Record* ra = record(a);
+        const Record* rb = record(b);
+        if (ra->mLastAccess != rb->mLastAccess)
+        {
+            return ra->mLastAccess < rb->mLastAccess;
+        }
+        return ra->mGeneration < rb->mGeneration;
+    });
+
+    mHead = mTail = NIL;
+    std::fill(mPrev.begin(), mPrev.end(), NIL);
+    std::fill(mNext.begin(), mNext.end(), NIL);
+    for (U32 slot : slots)
+    {
+        linkFront(slot);
+    }
+}
+
+U32 LLDiskCacheIndex::allocSlot()
+{
+    if (mFreeSlots.empty() && !grow())
+    {
+        return NIL;
+    }
+    U32 slot = mFreeSlots.back();
+    mFreeSlots.pop_back();
+    return slot;
+}
+
+void LLDiskCacheIndex::freeSlot(U32 slot)
+{
+    *record(slot) = Record();
+    mFreeSlots.push_back(slot);
+}
+
+void LLDiskCacheIndex::linkFront(U32 slot)
+{
+    mPrev[slot] = NIL;
+    mNext[slot] = mHead;
+    if (mHead != NIL)
+    {
+        mPrev[mHead] = slot;
+    }
+    mHead = slot;
+    if (mTail == NIL)
+    {
+        mTail = slot;
+    }
+}
+
+void LLDiskCacheIndex::unlink(U32 slot)
+{
+    const U32 prev = mPrev[slot];
+    const U32 next = mNext[slot];
+    if (prev != NIL)
+    {
+        mNext[prev] = next;
+    }
+    else
+    {
+        mHead = next;
+    }
+    if (next != NIL)
+    {
+        mPrev[next] = prev;
+    }
+    else
+    {
+        mTail = prev;
+    }
+    mPrev[slot] = mNext[slot] = NIL;
+}
+
+void LLDiskCacheIndex::stamp(Record* rec)
+{
+    rec->mLastAccess = (S64)std::time(nullptr);
+    rec->mGeneration = ++header()->mGeneration;
+}
+
+bool LLDiskCacheIndex::touch(const LLUUID& id)
+{
+    LLMutexLock lock(&mMutex);
+
+    if (!mFile.isOpen())
+    {
+        return false;
+    }
+
+    auto iter = mSlots.find(id);
+    if (iter == mSlots.end())
+    {
+        return false;
+    }
+
+    const U32 slot = iter->second;
+    stamp(record(slot));
+    if (mHead != slot)
+    {
+        unlink(slot);
+        linkFront(slot);
+    }
+    return true;
+}
+
+void LLDiskCacheIndex::recordWrite(const LLUUID& id, LLAssetType::EType type, uintmax_t end_offset, bool truncated)
+{
+    LLMutexLock lock(&mMutex);
+
+    if (!mFile.isOpen())
+    {
+        return;
+    }
+
+    Record* rec = nullptr;
+    U32 slot = NIL;
+    auto iter = mSlots.find(id);
+    if (iter != mSlots.end())
+    {
+        slot = iter->second;
+        rec = record(slot);
+        unlink(slot);
+    }
+    else
+    {
+        slot = allocSlot();
+        if (slot == NIL)
+        {
+            return;
+        }
+        rec = record(slot);
+        rec->mID = id;
+        rec->mInUse = 1;
+        rec->mSize = 0;
+        mSlots[id] = slot;
+    }
+
+    const U64 new_size = truncated ? (U64)end_offset : llmax(rec->mSize, (U64)end_offset);
+    mTotalSize = mTotalSize - rec->mSize + new_size;
+    rec->mSize = new_size;
+    rec->mAssetType = (S32)type;
+    stamp(rec);
+    linkFront(slot);
+}
+
+void LLDiskCacheIndex::remove(const LLUUID& id)
+{
+    LLMutexLock lock(&mMutex);
+
+    auto iter = mSlots.find(id);
+    if (iter == mSlots.end())
+    {
+        return;
+    }
+
+    const U32 slot = iter->second;
+    mSlots.erase(iter);
+    mTotalSize -= record(slot)->mSize;
+    unlink(slot);
+    freeSlot(slot);
+}
+
+void LLDiskCacheIndex::rename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type)
+{
+    LLMutexLock lock(&mMutex);
+
+    // The rename replaces any file already cached under new_id.
+    remove(new_id);
+
+    auto iter = mSlots.find(old_id);
+    if (iter == mSlots.end())
+    {
+        return;
+    }
+
+    const U32 slot = iter->second;
+    mSlots.erase(iter);
+    mSlots[new_id] = slot;
+
+    Record* rec = record(slot);
+    rec->mID = new_id;
+    rec->mAssetType = (S32)new_type;
+}
+
+void LLDiskCacheIndex::mergeScan(const scanned_list_t& scanned)
+{
+    LLMutexLock lock(&mMutex);
+
+    if (!mFile.isOpen())
+    {
+        return;
+    }
+
+    for (const ScannedEntry& entry : scanned)
+    {
+        if (mSlots.find(entry.mID) != mSlots.end())
+        {
+            continue;
+        }
+
+        const U32 slot = allocSlot();
+        if (slot == NIL)
+        {
+            break;
+        }
+
+        // The file name does not tell us the asset type.
+        Record* rec = record(slot);
+        rec->mID = entry.mID;
+        rec->mAssetType = (S32)LLAssetType::AT_UNKNOWN;
+        rec->mInUse = 1;
+        rec->mSize = entry.mSize;
+        rec->mLastAccess = (S64)entry.mLastWrite;
+        rec->mGeneration = 0;
+        mSlots[entry.mID] = slot;
+        mTotalSize += entry.mSize;
+    }
+
+    rebuildLRU();
+    mNeedsScan = false;
+}
+
+void LLDiskCacheIndex::evict(uintmax_t max_size_bytes, evicted_list_t& evicted)
+{
+    LLMutexLock lock(&mMutex);
+
+    while (mTotalSize > max_size_bytes && mTail != NIL)
+    {
+        const U32 slot = mTail;
+        const Record* rec = record(slot);
+        evicted.push_back({ rec->mID, (LLAssetType::EType)rec->mAssetType, (uintmax_t)rec->mSize, (std::time_t)rec->mLastAccess });
+
+        mSlots.erase(rec->mID);
+        mTotalSize -= rec->mSize;
+        unlink(slot);
+        freeSlot(slot);
+    }
+}
+
+uintmax_t LLDiskCacheIndex::getTotalSize() const
+{
+    LLMutexLock lock(&mMutex);
+    return mTotalSize;
+}
+
+U32 LLDiskCacheIndex::getEntryCount() const
+{
+    LLMutexLock lock(&mMutex);
+    return (U32)mSlots.size();
+}
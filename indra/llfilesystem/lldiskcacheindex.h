@@ -0,0 +1,192 @@
+/**
+ * @file lldiskcacheindex.h
+ * @brief Persistent, memory-mapped metadata index for the disk cache.
+ *
+ * @Description:
+ * The index keeps one fixed size record per cached asset file (UUID, asset
+ * type, size in bytes, time of last access and a generation number) in a
+ * memory-mapped file that lives next to the cache files. An in-memory LRU
+ * list threaded through the record slots keeps the records ordered by last
+ * access so that:
+ * 1/ Recording a read is an in-memory move-to-front plus a store into the
+ *    mapped record; no filesystem syscall is issued.
+ * 2/ A purge only visits the records that are evicted, taken from the tail
+ *    of the LRU list, instead of walking and stat()ing the whole cache dir.
+ * 3/ The generation number is a counter bumped on every access so the exact
+ *    LRU order can be restored on the next run even when several accesses
+ *    share the same time_t value.
+ *
+ * The index is only a cache of filesystem state. The header carries a
+ * "clean" flag that is cleared while the index is open, so an index left
+ * behind by a crash is discarded and rebuilt from a one-off directory scan
+ * (see LLDiskCache::purge()).
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLDISKCACHEINDEX_H
+#define LL_LLDISKCACHEINDEX_H
+
+#include "llassettype.h"
+#include "llmappedfile.h"
+#include "llmutex.h"
+#include "lluuid.h"
+
+#include "boost/unordered/unordered_flat_map.hpp"
+
+#include <ctime>
+#include <vector>
+
+class LLDiskCacheIndex
+{
+public:
+    struct EvictedEntry
+    {
+        LLUUID              mID;
+        LLAssetType::EType  mType;
+        uintmax_t           mSize;
+        std::time_t         mLastAccess;
+    };
+    typedef std::vector<EvictedEntry> evicted_list_t;
+
+    struct ScannedEntry
+    {
+        LLUUID      mID;
+        uintmax_t   mSize;
+        std::time_t mLastWrite;
+    };
+    typedef std::vector<ScannedEntry> scanned_list_t;
+
+    LLDiskCacheIndex() = default;
+    ~LLDiskCacheIndex();
+
+    /**
+     * Open or create the index file. Returns false if the index could not
+     * be mapped at all; the disk cache then falls back to directory scans.
+     * An index that is new, from another version or that was not closed
+     * cleanly is emptied and flagged as needing a directory scan.
+     */
+    bool open(const std::string& filename);
+
+    /**
+     * Mark the index as cleanly closed, flush it and unmap it.
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * True until mergeScan() has been called on an index that could not be
+     * trusted when it was opened.
+     */
+    bool needsScan() const;
+
+    /**
+     * Record a read of a known entry. Returns false if the entry is not in
+     * the index, in which case the caller is expected to find out whether
+     * the file exists and call recordWrite() with its size.
+     */
+    bool touch(const LLUUID& id);
+
+    /**
+     * Record that a file was written. end_offset is the position after the
+     * last byte written; when truncated is false the entry keeps the larger
+     * of its previous size and end_offset.
+     */
+    void recordWrite(const LLUUID& id, LLAssetType::EType type, uintmax_t end_offset, bool truncated);
+
+    void remove(const LLUUID& id);
+
+    void rename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type);
+
+    /**
+     * Merge the result of a directory scan into the index. Files already
+     * tracked keep their (more accurate) access information. Clears the
+     * needsScan() flag.
+     */
+    void mergeScan(const scanned_list_t& scanned);
+
+    /**
+     * Remove least recently used entries from the index until the total
+     * size of the remaining ones is no more than max_size_bytes and return
+     * them so the caller can delete the files.
+     */
+    void evict(uintmax_t max_size_bytes, evicted_list_t& evicted);
+
+    uintmax_t getTotalSize() const;
+    U32 getEntryCount() const;
+
+private:
+    // On-disk layout. Both structs are written as-is so they must keep a
+    // fixed size and no padding surprises across platforms.
+    struct Header
+    {
+        U32 mMagic;
+        U32 mVersion;
+        U32 mCapacity;
+        U32 mClean;
+        U64 mGeneration;
+        U64 mReserved;
+    };
+
+    struct Record
+    {
+        LLUUID  mID;
+        S32     mAssetType;
+        U32     mInUse;
+        U64     mSize;
+        S64     mLastAccess;
+        U64     mGeneration;
+    };
+
+    static constexpr U32 NIL = U32_MAX;
+
+    Header* header() const;
+    Record* record(U32 slot) const;
+
+    bool grow();
+    void reset();
+    void rebuildLRU();
+    U32 allocSlot();
+    void freeSlot(U32 slot);
+    void linkFront(U32 slot);
+    void unlink(U32 slot);
+    void stamp(Record* rec);
+
+private:
+    mutable LLMutex mMutex;
+    LLMappedFile    mFile;
+
+    boost::unordered_flat_map<LLUUID, U32> mSlots;
+    std::vector<U32> mFreeSlots;
+
+    // LRU list threaded through the slots, head is most recently used.
+    std::vector<U32> mPrev;
+    std::vector<U32> mNext;
+    U32 mHead = NIL;
+    U32 mTail = NIL;
+
+    uintmax_t mTotalSize = 0;
+    bool mNeedsScan = true;
+};
+
+#endif // LL_LLDISKCACHEINDEX_H
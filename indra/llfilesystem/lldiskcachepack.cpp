@@ -0,0 +1,754 @@
+/**
+ * @file lldiskcachepack.cpp
+ * @brief Pack file storage for small disk cache assets.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lldiskcachepack.h"
+
+#include "llapp.h"
+#include "lldir.h"
+
+#if LL_WINDOWS
+#include "llwin32headerslean.h"
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+
+namespace
+{
+    constexpr U32 RECORD_MAGIC = 0x4B504C53; // 'SLPK'
+    constexpr U32 RECORD_TOMBSTONE = 0x1;
+
+    // Start a new pack once the active one grows past this size
+    constexpr U32 PACK_MAX_SIZE = 64 * 1024 * 1024;
+
+    const std::string PACK_PREFIX = "pack_";
+    const std::string PACK_EXT = ".sl_pack";
+
+    struct RecordHeader
+    {
+        U32     mMagic;
+        U32     mFlags;
+        LLUUID  mID;
+        S32     mAssetType;
+        U32     mSize;
+    };
+    static_assert(sizeof(RecordHeader) == 32, "pack RecordHeader layout changed");
+
+    boost::filesystem::path to_path(const std::string& filename)
+    {
+#if LL_WINDOWS
+        return boost::filesystem::path(ll_convert_string_to_wide(filename));
+#else
+        return boost::filesystem::path(filename);
+#endif
+    }
+
+    // Returns the pack number encoded in a pack filename, or 0 if the name
+    // is not the name of a pack file. Pack numbers start at 1.
+    U32 pack_number(const std::string& filename)
+    {
+        if (filename.size() <= PACK_PREFIX.size() + PACK_EXT.size()
+            || filename.compare(0, PACK_PREFIX.size(), PACK_PREFIX) != 0
+            || filename.compare(filename.size() - PACK_EXT.size(), PACK_EXT.size(), PACK_EXT) != 0)
+        {
+            return 0;
+        }
+        const std::string num = filename.substr(PACK_PREFIX.size(), filename.size() - PACK_PREFIX.size() - PACK_EXT.size());
+        return (U32)strtoul(num.c_str(), nullptr, 10);
+    }
+
+    // Reads at offset without moving the file position, so that readers
+    // sharing a pack don't have to take turns on it
+    bool read_at(LLFILE* fp, U32 offset, U8* buffer, U32 bytes)
+    {
+#if LL_WINDOWS
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(fp));
+        while (bytes)
+        {
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = offset;
+            DWORD bytes_read = 0;
+            if (!ReadFile(handle, buffer, bytes, &bytes_read, &overlapped) || !bytes_read)
+            {
+                return false;
+            }
+            offset += bytes_read;
+            buffer += bytes_read;
+            bytes -= bytes_read;
+        }
+#else
+        const int fd = fileno(fp);
+        while (bytes)
+        {
+            const ssize_t bytes_read = pread(fd, buffer, bytes, offset);
+            if (bytes_read < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (bytes_read <= 0)
+            {
+                return false;
+            }
+            offset += (U32)bytes_read;
+            buffer += bytes_read;
+            bytes -= (U32)bytes_read;
+        }
+#endif
+        return true;
+    }
+
+    void list_packs(const std::string& cache_dir, std::vector<U32>& packs)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::directory_iterator iter(to_path(cache_dir), ec);
+        while (!ec.failed() && iter != boost::filesystem::directory_iterator())
+        {
+            if (boost::filesystem::is_regular_file(*iter, ec) && !ec.failed())
+            {
+                const U32 num = pack_number(iter->path().filename().string());
+                if (num)
+                {
+                    packs.push_back(num);
+                }
+            }
+            iter.increment(ec);
+        }
+        std::sort(packs.begin(), packs.end());
+    }
+}
+
+LLDiskCachePack::LLDiskCachePack(const std::string& cache_dir, U32 threshold_bytes, bool read_only)
+:   mCacheDir(cache_dir),
+    mThreshold(threshold_bytes),
+    mReadOnly(read_only)
+{
+}
+
+LLDiskCachePack::~LLDiskCachePack()
+{
+    close();
+}
+
+std::string LLDiskCachePack::packFilename(U32 pack) const
+{
+    return fmt::format("{}{}{}{:04d}{}", mCacheDir, gDirUtilp->getDirDelimiter(), PACK_PREFIX, pack, PACK_EXT);
+}
+
+// static
+void LLDiskCachePack::deletePackFiles(const std::string& cache_dir)
+{
+    std::vector<U32> packs;
+    list_packs(cache_dir, packs);
+    for (U32 num : packs)
+    {
+        LLFile::remove(fmt::format("{}{}{}{:04d}{}", cache_dir, gDirUtilp->getDirDelimiter(), PACK_PREFIX, num, PACK_EXT));
+    }
+}
+
+bool LLDiskCachePack::open()
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+
+    std::vector<U32> packs;
+    list_packs(mCacheDir, packs);
+    for (U32 num : packs)
+    {
+        if (!loadPack(num))
+        {
+            LL_WARNS() << "Unable to load cache pack " << packFilename(num) << LL_ENDL;
+        }
+    }
+
+    mActivePack = mPacks.empty() ? 0 : mPacks.rbegin()->first;
+
+    LL_INFOS() << "Loaded " << mEntries.size() << " packed assets from " << mPacks.size() << " cache packs" << LL_ENDL;
+    return true;
+}
+
+bool LLDiskCachePack::loadPack(U32 pack_num)
+{
+    const std::string filename = packFilename(pack_num);
+    LLFILE* fp = LLFile::fopen(filename, mReadOnly ? "rb" : "r+b");
+    if (!fp)
+    {
+        return false;
+    }
+
+    Pack& pack = mPacks[pack_num];
+    pack.mFile = fp;
+
+    fseek(fp, 0, SEEK_END);
+    const long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    U32 offset = 0;
+    RecordHeader hdr;
+    while (fseek(fp, offset, SEEK_SET) == 0 && fread(&hdr, sizeof(RecordHeader), 1, fp) == 1)
+    {
+        const U32 record_size = sizeof(RecordHeader) + hdr.mSize;
+        if (hdr.mMagic != RECORD_MAGIC || (S64)offset + record_size > (S64)file_size)
+        {
+            break;
+        }
+
+        auto iter = mEntries.find(hdr.mID);
+        if (iter != mEntries.end())
+        {
+            markDead(iter->second);
+        }
+
+        if (hdr.mFlags & RECORD_TOMBSTONE)
+        {
+            if (iter != mEntries.end())
+            {
+                mEntries.erase(iter);
+            }
+            pack.mDeadBytes += record_size;
+        }
+        else
+        {
+            mEntries[hdr.mID] = { pack_num, offset, hdr.mSize, hdr.mAssetType };
+        }
+
+        offset += record_size;
+    }
+
+    // Drop anything after the last complete record (crash mid-write). The
+    // owner of a read only pack may be writing that record right now.
+    if (file_size > (long)offset && !mReadOnly)
+    {
+        LL_WARNS() << "Truncating " << (file_size - offset) << " bytes of incomplete records from " << filename << LL_ENDL;
+        fclose(fp);
+        boost::system::error_code ec;
+        boost::filesystem::resize_file(to_path(filename), offset, ec);
+        pack.mFile = LLFile::fopen(filename, "r+b");
+        if (!pack.mFile)
+        {
+            mPacks.erase(pack_num);
+            return false;
+        }
+    }
+
+    pack.mSize = offset;
+    return true;
+}
+
+void LLDiskCachePack::close()
+{
+    removeStaleFiles();
+
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+
+    for (auto& pack : mPacks)
+    {
+        if (pack.second.mFile)
+        {
+            fclose(pack.second.mFile);
+        }
+    }
+    mPacks.clear();
+    mEntries.clear();
+    mActivePack = 0;
+}
+
+LLDiskCachePack::Pack* LLDiskCachePack::openActivePack(U32 record_size)
+{
+    auto iter = mPacks.find(mActivePack);
+    if (iter != mPacks.end() && iter->second.mSize + record_size <= PACK_MAX_SIZE)
+    {
+        return &iter->second;
+    }
+
+    // Start a new pack
+    const U32 pack_num = mActivePack + 1;
+    LLFILE* fp = LLFile::fopen(packFilename(pack_num), "w+b");
+    if (!fp)
+    {
+        LL_WARNS() << "Unable to create cache pack " << packFilename(pack_num) << LL_ENDL;
+        return nullptr;
+    }
+
+    mActivePack = pack_num;
+    Pack& pack = mPacks[pack_num];
+    pack.mFile = fp;
+    return &pack;
+}
+
+bool LLDiskCachePack::appendRecord(const LLUUID& id, S32 type, U32 flags, const U8* data, U32 size, Location& loc)
+{
+    const U32 record_size = sizeof(RecordHeader) + size;
+    Pack* pack = openActivePack(record_size);
+    if (!pack)
+    {
+        return false;
+    }
+
+    RecordHeader hdr;
+    hdr.mMagic = RECORD_MAGIC;
+    hdr.mFlags = flags;
+    hdr.mID = id;
+    hdr.mAssetType = type;
+    hdr.mSize = size;
+
+    bool success = fseek(pack->mFile, pack->mSize, SEEK_SET) == 0
+                && fwrite(&hdr, sizeof(RecordHeader), 1, pack->mFile) == 1
+                && (size == 0 || fwrite(data, 1, size, pack->mFile) == size)
+                && fflush(pack->mFile) == 0;
+    if (!success)
+    {
+        // Whatever made it to disk is past mSize and gets overwritten by
+        // the next record or truncated at the next startup.
+        LL_WARNS() << "Failed to append " << id << " to cache pack " << mActivePack << LL_ENDL;
+        return false;
+    }
+
+    loc = { mActivePack, pack->mSize, size, type };
+    pack->mSize += record_size;
+    return true;
+}
+
+bool LLDiskCachePack::appendToRecord(Location& loc, const U8* data, U32 size)
+{
+    // Only the last record of the active pack can grow
+    auto iter = mPacks.find(loc.mPack);
+    if (loc.mPack != mActivePack || iter == mPacks.end())
+    {
+        return false;
+    }
+    Pack& pack = iter->second;
+    const U32 record_end = loc.mOffset + sizeof(RecordHeader) + loc.mSize;
+    if (record_end != pack.mSize || pack.mSize + size > PACK_MAX_SIZE)
+    {
+        return false;
+    }
+
+    // Data first, then the size in the header: a crash in between leaves
+    // the record as it was followed by bytes that get truncated at startup.
+    const U32 new_size = loc.mSize + size;
+    bool success = fseek(pack.mFile, record_end, SEEK_SET) == 0
+                && (size == 0 || fwrite(data, 1, size, pack.mFile) == size)
+                && fflush(pack.mFile) == 0
+                && fseek(pack.mFile, loc.mOffset + offsetof(RecordHeader, mSize), SEEK_SET) == 0
+                && fwrite(&new_size, sizeof(U32), 1, pack.mFile) == 1
+                && fflush(pack.mFile) == 0;
+    if (!success)
+    {
+        LL_WARNS() << "Failed to append to record at " << loc.mOffset << " of cache pack " << loc.mPack << LL_ENDL;
+        return false;
+    }
+
+    loc.mSize = new_size;
+    pack.mSize += size;
+    return true;
+}
+
+bool LLDiskCachePack::readData(const Location& loc, U32 offset, U8* buffer, U32 bytes)
+{
+    auto iter = mPacks.find(loc.mPack);
+    if (iter == mPacks.end())
+    {
+        return false;
+    }
+
+    return read_at(iter->second.mFile, loc.mOffset + sizeof(RecordHeader) + offset, buffer, bytes);
+}
+
+void LLDiskCachePack::markDead(const Location& loc)
+{
+    auto iter = mPacks.find(loc.mPack);
+    if (iter != mPacks.end())
+    {
+        iter->second.mDeadBytes += sizeof(RecordHeader) + loc.mSize;
+    }
+}
+
+S32 LLDiskCachePack::getSize(const LLUUID& id) const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+
+    auto iter = mEntries.find(id);
+    return iter != mEntries.end() ? (S32)iter->second.mSize : -1;
+}
+
+bool LLDiskCachePack::read(const LLUUID& id, S32 offset, U8* buffer, S32 bytes, S32& bytes_read)
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+
+    auto iter = mEntries.find(id);
+    if (iter == mEntries.end())
+    {
+        return false;
+    }
+
+    const Location& loc = iter->second;
+    bytes_read = 0;
+    if (offset < 0 || (U32)offset >= loc.mSize || bytes <= 0)
+    {
+        return true;
+    }
+
+    const U32 to_read = llmin((U32)bytes, loc.mSize - (U32)offset);
+    if (readData(loc, offset, buffer, to_read))
+    {
+        bytes_read = (S32)to_read;
+    }
+    return true;
+}
+
+bool LLDiskCachePack::readAll(const LLUUID& id, std::vector<U8>& data)
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+
+    auto iter = mEntries.find(id);
+    if (iter == mEntries.end())
+    {
+        return false;
+    }
+
+    data.resize(iter->second.mSize);
+    return data.empty() || readData(iter->second, 0, data.data(), (U32)data.size());
+}
+
+bool LLDiskCachePack::write(const LLUUID& id, LLAssetType::EType type, const U8* data, S32 size)
+{
+    if (mReadOnly || size < 0 || !accepts(size))
+    {
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+
+    Location loc;
+    if (!appendRecord(id, (S32)type, 0, data, (U32)size, loc))
+    {
+        return false;
+    }
+
+    auto iter = mEntries.find(id);
+    if (iter != mEntries.end())
+    {
+        markDead(iter->second);
+        iter->second = loc;
+    }
+    else
+    {
+        mEntries[id] = loc;
+    }
+    return true;
+}
+
+bool LLDiskCachePack::writeAt(const LLUUID& id, LLAssetType::EType type, S32 offset, const U8* data, S32 bytes, S32& end)
+{
+    if (mReadOnly || bytes < 0)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+
+    auto iter = mEntries.find(id);
+    const U32 old_size = iter != mEntries.end() ? iter->second.mSize : 0;
+    const U32 start = offset < 0 ? old_size : llmin((U32)offset, old_size);
+    const U32 new_size = llmax(old_size, start + (U32)bytes);
+    if (!accepts(new_size))
+    {
+        return false;
+    }
+
+    if (iter == mEntries.end())
+    {
+        Location loc;
+        if (!appendRecord(id, (S32)type, 0, data, (U32)bytes, loc))
+        {
+            return false;
+        }
+        mEntries[id] = loc;
+    }
+    else if (start != old_size || !appendToRecord(iter->second, data, (U32)bytes))
+    {
+        // Records don't change once superseded by a later one, so anything
+        // but a tail append writes the whole asset out again.
+        std::vector<U8> buffer(new_size);
+        if (old_size && !readData(iter->second, 0, buffer.data(), old_size))
+        {
+            return false;
+        }
+        if (bytes)
+        {
+            memcpy(buffer.data() + start, data, bytes);
+        }
+
+        Location loc;
+        if (!appendRecord(id, (S32)type, 0, buffer.data(), new_size, loc))
+        {
+            return false;
+        }
+        markDead(iter->second);
+        iter->second = loc;
+    }
+
+    end = (S32)(start + bytes);
+    return true;
+}
+
+bool LLDiskCachePack::removeLocked(const LLUUID& id)
+{
+    auto iter = mEntries.find(id);
+    if (iter == mEntries.end())
+    {
+        return false;
+    }
+
+    const Location old_loc = iter->second;
+    mEntries.erase(iter);
+    if (mReadOnly)
+    {
+        return true;
+    }
+    markDead(old_loc);
+
+    // The stale loose copy must not outlive the packed one it was shadowed by
+    auto stale_iter = mStaleFiles.find(id);
+    if (stale_iter != mStaleFiles.end())
+    {
+        LLFile::remove(stale_iter->second, ENOENT);
+        mStaleFiles.erase(stale_iter);
+    }
+
+    // If the tombstone can't be written the asset comes back at the next
+    // startup, which is harmless for a cache.
+    Location loc;
+    if (appendRecord(id, old_loc.mAssetType, RECORD_TOMBSTONE, nullptr, 0, loc))
+    {
+        markDead(loc);
+    }
+    return true;
+}
+
+bool LLDiskCachePack::remove(const LLUUID& id)
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    return removeLocked(id);
+}
+
+void LLDiskCachePack::addStaleFile(const LLUUID& id, const boost::filesystem::path& filename)
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+
+    if (!mReadOnly && mEntries.find(id) != mEntries.end())
+    {
+        mStaleFiles.emplace(id, filename);
+    }
+}
+
+void LLDiskCachePack::removeStaleFiles()
+{
+    // The files are deleted with the lock held, otherwise an asset moving
+    // out of the pack could get its new loose file deleted. A few at a time
+    // so that readers are not held off for long.
+    constexpr size_t BATCH_SIZE = 64;
+    bool done = false;
+    while (!done)
+    {
+        std::unique_lock<std::shared_mutex> lock(mMutex);
+        for (size_t i = 0; i < BATCH_SIZE && !mStaleFiles.empty(); ++i)
+        {
+            auto iter = mStaleFiles.begin();
+            LLFile::remove(iter->second, ENOENT);
+            mStaleFiles.erase(iter);
+        }
+        done = mStaleFiles.empty();
+    }
+}
+
+bool LLDiskCachePack::rename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type)
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+
+    auto iter = mEntries.find(old_id);
+    if (mReadOnly || iter == mEntries.end())
+    {
+        return false;
+    }
+
+    std::vector<U8> data(iter->second.mSize);
+    if (!data.empty() && !readData(iter->second, 0, data.data(), (U32)data.size()))
+    {
+        return false;
+    }
+
+    Location loc;
+    if (!appendRecord(new_id, (S32)new_type, 0, data.data(), (U32)data.size(), loc))
+    {
+        return false;
+    }
+
+    auto new_iter = mEntries.find(new_id);
+    if (new_iter != mEntries.end())
+    {
+        markDead(new_iter->second);
+        new_iter->second = loc;
+    }
+    else
+    {
+        mEntries[new_id] = loc;
+    }
+
+    removeLocked(old_id);
+    return true;
+}
+
+bool LLDiskCachePack::compactPack(U32 pack_num)
+{
+    auto pack_iter = mPacks.find(pack_num);
+    if (pack_iter == mPacks.end())
+    {
+        return false;
+    }
+
+    // Tombstones only matter while an older pack may still hold a record
+    // they shadow, so the oldest pack can drop them.
+    const bool is_oldest = pack_num == mPacks.begin()->first;
+    LLFILE* fp = pack_iter->second.mFile;
+    const U32 pack_size = pack_iter->second.mSize;
+
+    std::vector<U8> data;
+    U32 offset = 0;
+    while (offset < pack_size)
+    {
+        RecordHeader hdr;
+        if (!read_at(fp, offset, (U8*)&hdr, sizeof(RecordHeader)))
+        {
+            LL_WARNS() << "Failed to read cache pack " << pack_num << " at " << offset << ", not compacting it" << LL_ENDL;
+            return false;
+        }
+        const U32 record_offset = offset;
+        offset += sizeof(RecordHeader) + hdr.mSize;
+
+        auto iter = mEntries.find(hdr.mID);
+        if (hdr.mFlags & RECORD_TOMBSTONE)
+        {
+            if (!is_oldest && iter == mEntries.end())
+            {
+                Location loc;
+                if (!appendRecord(hdr.mID, hdr.mAssetType, RECORD_TOMBSTONE, nullptr, 0, loc))
+                {
+                    return false;
+                }
+                markDead(loc);
+            }
+            continue;
+        }
+
+        if (iter == mEntries.end() || iter->second.mPack != pack_num || iter->second.mOffset != record_offset)
+        {
+            // superseded or removed
+            continue;
+        }
+
+        data.resize(hdr.mSize);
+        Location loc;
+        if ((hdr.mSize && !read_at(fp, record_offset + sizeof(RecordHeader), data.data(), hdr.mSize))
+            || !appendRecord(hdr.mID, hdr.mAssetType, 0, data.data(), hdr.mSize, loc))
+        {
+            return false;
+        }
+        markDead(iter->second);
+        iter->second = loc;
+    }
+
+    fclose(fp);
+    mPacks.erase(pack_iter);
+    LLFile::remove(packFilename(pack_num));
+    return true;
+}
+
+void LLDiskCachePack::compact()
+{
+    if (mReadOnly)
+    {
+        return;
+    }
+
+    std::vector<U32> candidates;
+    {
+        std::unique_lock<std::shared_mutex> lock(mMutex);
+        for (const auto& pack : mPacks)
+        {
+            // More than half of the pack is dead records
+            if (pack.first != mActivePack && pack.second.mDeadBytes * 2 > pack.second.mSize)
+            {
+                candidates.push_back(pack.first);
+            }
+        }
+    }
+
+    for (U32 pack_num : candidates)
+    {
+        if (LLApp::isExiting())
+        {
+            return;
+        }
+
+        // One pack at a time so that readers are not held off for long
+        std::unique_lock<std::shared_mutex> lock(mMutex);
+        if (compactPack(pack_num))
+        {
+            LL_INFOS() << "Compacted cache pack " << pack_num << LL_ENDL;
+        }
+    }
+}
+
+void LLDiskCachePack::getEntries(entry_list_t& entries) const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+
+    entries.reserve(entries.size() + mEntries.size());
+    for (const auto& entry : mEntries)
+    {
+        entries.push_back({ entry.first, (LLAssetType::EType)entry.second.mAssetType, entry.second.mSize });
+    }
+}
+
+uintmax_t LLDiskCachePack::getPackFileBytes() const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+
+    uintmax_t total = 0;
+    for (const auto& pack : mPacks)
+    {
+        total += pack.second.mSize;
+    }
+    return total;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file lldiskcachepack.h
+ * @brief Pack file storage for small disk cache assets.
+ *
+ * @Description:
+ * Assets no larger than a configurable threshold (animations, gestures,
+ * notecards, landmarks...) are not given a file of their own but are
+ * appended to large pack files that stay open for the whole session.
+ * This saves an inode plus an open() and close() per asset.
+ *
+ * 1/ Pack files are append only. Each record is a small header (UUID,
+ *    asset type, size, flags) followed by the asset data. A later record
+ *    for the same UUID supersedes an earlier one and a record with the
+ *    tombstone flag marks the asset as removed.
+ * 2/ The packs are self describing: the in-memory index is rebuilt at
+ *    startup by walking the record headers, and a record cut short by a
+ *    crash is dropped by truncating the pack.
+ * 3/ Space taken by superseded and removed records is tracked per pack.
+ *    compact(), run as part of the cache purge, copies the live records
+ *    of packs that are mostly dead into the active pack and deletes them.
+ * 4/ Appending to the last record of the active pack grows that record
+ *    in place. The size in its header is only updated once the data is
+ *    written so a crash in between loses the new bytes and nothing else.
+ * 5/ Reads use positional reads on the pack files and only take the lock
+ *    shared, so they don't wait on each other, only on writes.
+ * 6/ A second viewer instance opens the packs read only. It doesn't write
+ *    to them, and assets it writes or removes are just dropped from its
+ *    own index so that their new loose files are not shadowed.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLDISKCACHEPACK_H
+#define LL_LLDISKCACHEPACK_H
+
+#include "llassettype.h"
+#include "llfile.h"
+#include "lluuid.h"
+
+#include "boost/unordered/unordered_flat_map.hpp"
+
+#include <map>
+#include <shared_mutex>
+#include <vector>
+
+class LLDiskCachePack
+{
+public:
+    struct PackedEntry
+    {
+        LLUUID              mID;
+        LLAssetType::EType  mType;
+        U32                 mSize;
+    };
+    typedef std::vector<PackedEntry> entry_list_t;
+
+    LLDiskCachePack(const std::string& cache_dir, U32 threshold_bytes, bool read_only = false);
+    ~LLDiskCachePack();
+
+    /**
+     * Open every pack file in the cache directory and rebuild the index
+     * from their record headers.
+     */
+    bool open();
+    void close();
+
+    /**
+     * Remove every pack file found in the cache directory. Used when the
+     * pack backend is switched off so the packs don't leak.
+     */
+    static void deletePackFiles(const std::string& cache_dir);
+
+    bool accepts(S64 size) const { return size <= (S64)mThreshold; }
+    bool isReadOnly() const { return mReadOnly; }
+
+    /**
+     * Size of a packed asset or -1 if the asset is not in a pack
+     */
+    S32 getSize(const LLUUID& id) const;
+
+    /**
+     * Read up to bytes of a packed asset starting at offset. Returns false
+     * if the asset is not packed.
+     */
+    bool read(const LLUUID& id, S32 offset, U8* buffer, S32 bytes, S32& bytes_read);
+    bool readAll(const LLUUID& id, std::vector<U8>& data);
+
+    /**
+     * Replace the contents of an asset with size bytes of data.
+     */
+    bool write(const LLUUID& id, LLAssetType::EType type, const U8* data, S32 size);
+
+    /**
+     * Write bytes of data into an asset at offset, or at its end when
+     * offset is negative, without handing the old contents back. An asset
+     * that is not packed yet starts out empty. end gets the position right
+     * after the written bytes. Returns false, leaving the asset as it was,
+     * if the result would be too large for the pack.
+     */
+    bool writeAt(const LLUUID& id, LLAssetType::EType type, S32 offset, const U8* data, S32 bytes, S32& end);
+
+    /**
+     * A loose file from before the asset was packed is shadowed by the
+     * pack but still takes up space. Deleting it is left to
+     * removeStaleFiles() so that writes don't pay for an unlink each.
+     */
+    void addStaleFile(const LLUUID& id, const boost::filesystem::path& filename);
+    void removeStaleFiles();
+
+    /**
+     * Returns true if the asset was packed and got removed. A read only
+     * pack only forgets it.
+     */
+    bool remove(const LLUUID& id);
+    bool rename(const LLUUID& old_id, const LLUUID& new_id, LLAssetType::EType new_type);
+
+    /**
+     * Copy the live records of mostly dead packs into the active pack and
+     * delete them. Called from the purge thread.
+     */
+    void compact();
+
+    void getEntries(entry_list_t& entries) const;
+    uintmax_t getPackFileBytes() const;
+
+private:
+    struct Location
+    {
+        U32 mPack;
+        U32 mOffset;        // of the record header
+        U32 mSize;          // of the data
+        S32 mAssetType;
+    };
+
+    struct Pack
+    {
+        LLFILE* mFile = nullptr;
+        U32     mSize = 0;
+        U32     mDeadBytes = 0;
+    };
+
+    std::string packFilename(U32 pack) const;
+    bool loadPack(U32 pack_num);
+    Pack* openActivePack(U32 record_size);
+    bool appendRecord(const LLUUID& id, S32 type, U32 flags, const U8* data, U32 size, Location& loc);
+    bool appendToRecord(Location& loc, const U8* data, U32 size);
+    bool readData(const Location& loc, U32 offset, U8* buffer, U32 bytes);
+    void markDead(const Location& loc);
+    bool compactPack(U32 pack_num);
+    bool removeLocked(const LLUUID& id);
+
+private:
+    mutable std::shared_mutex mMutex;
+    const std::string mCacheDir;
+    const U32 mThreshold;
+    const bool mReadOnly;
+
+    boost::unordered_flat_map<LLUUID, Location> mEntries;
+    std::map<LLUUID, boost::filesystem::path> mStaleFiles;
+    std::map<U32, Pack> mPacks;     // ordered oldest first
+    U32 mActivePack = 0;
+};
+
+#endif // LL_LLDISKCACHEPACK_H
@@ -32,13 +32,20 @@
 #include "lldir.h"
 #include "llfilesystem.h"
 #include "llfasttimer.h"
+#include "llmutex.h"
 #include "lldiskcache.h"
+#include "lldiskcachepack.h"
+#include "threadpool.h"
 
 const S32 LLFileSystem::READ        = 0x00000001;
 const S32 LLFileSystem::WRITE       = 0x00000002;
 const S32 LLFileSystem::READ_WRITE  = 0x00000003;  // LLFileSystem::READ & LLFileSystem::WRITE
 const S32 LLFileSystem::APPEND      = 0x00000006;  // 0x00000004 & LLFileSystem::WRITE
 
+static std::unique_ptr<LL::ThreadPool> sReadThreadPool;
+static LLMutex sReadThreadPoolMutex;
+static size_t sReadThreads = 0;     // 0 before initClass() and after cleanupClass()
+
 LLFileSystem::LLFileSystem(const LLUUID& file_id, const LLAssetType::EType file_type, S32 mode)
 {
     // build the filename (TODO: we do this in a few places - perhaps we should factor into a single function)
@@ -58,12 +65,7 @@ LLFileSystem::LLFileSystem(const LLUUID& file_id, const LLAssetType::EType file_
         // even though we are reading and not writing because this is the
         // way the cache works - it relies on a valid "last accessed time" for
         // each file so it knows how to remove the oldest, unused files
-        boost::system::error_code ec;
-        bool exists = boost::filesystem::exists(mFilePath, ec);
-        if (exists && !ec.failed())
-        {
-            LLDiskCache::updateFileAccessTime(mFilePath);
-        }
+        LLDiskCache::getInstance()->recordRead(file_id, file_type, mFilePath);
     }
 }
 
@@ -74,6 +76,12 @@ LLFileSystem::~LLFileSystem()
 // static
 bool LLFileSystem::getExists(const LLUUID& file_id, const LLAssetType::EType file_type)
 {
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPack();
+    if (pack && pack->getSize(file_id) >= 0)
+    {
+        return true;
+    }
+
     const boost::filesystem::path filename = LLDiskCache::getInstance()->metaDataToFilepath(file_id, file_type);
     boost::system::error_code ec;
     return boost::filesystem::exists(filename, ec) && !ec.failed();
@@ -84,7 +92,15 @@ bool LLFileSystem::removeFile(const LLUUID& file_id, const LLAssetType::EType fi
 {
     const boost::filesystem::path filename = LLDiskCache::getInstance()->metaDataToFilepath(file_id, file_type);
 
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPack();
+    if (pack && pack->remove(file_id))
+    {
+        // Packed assets have no file of their own
+        suppress_error = ENOENT;
+    }
+
     LLFile::remove(filename, suppress_error);
+    LLDiskCache::getInstance()->recordRemove(file_id);
 
     return true;
 }
@@ -100,6 +116,16 @@ bool LLFileSystem::renameFile(const LLUUID& old_file_id, const LLAssetType::ETyp
 // static
 S32 LLFileSystem::getFileSize(const LLUUID& file_id, const LLAssetType::EType file_type)
 {
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        const S32 packed_size = pack->getSize(file_id);
+        if (packed_size >= 0)
+        {
+            return packed_size;
+        }
+    }
+
     const boost::filesystem::path filename = LLDiskCache::getInstance()->metaDataToFilepath(file_id, file_type);
     boost::system::error_code ec;
     S32 file_size = boost::filesystem::file_size(filename, ec);
@@ -110,10 +136,131 @@ S32 LLFileSystem::getFileSize(const LLUUID& file_id, const LLAssetType::EType fi
     return file_size;
 }
 
+// static
+void LLFileSystem::initClass(size_t threads)
+{
+    LLMutexLock lock(&sReadThreadPoolMutex);
+    sReadThreads = threads;
+}
+
+// static
+void LLFileSystem::cleanupClass()
+{
+    LLMutexLock lock(&sReadThreadPoolMutex);
+    sReadThreads = 0;
+    if (sReadThreadPool)
+    {
+        sReadThreadPool->close();
+        sReadThreadPool.reset();
+    }
+}
+
+// static
+bool LLFileSystem::readAsync(const read_batch_t& batch, const read_callback_t& callback, LL::WorkQueue::weak_t reply_queue)
+{
+    return postReads(batch, callback, reply_queue, false);
+}
+
+// static
+bool LLFileSystem::readAsyncOnWorker(const read_batch_t& batch, const read_callback_t& callback)
+{
+    return postReads(batch, callback, {}, true);
+}
+
+// static
+bool LLFileSystem::postReads(const read_batch_t& batch, const read_callback_t& callback,
+                             LL::WorkQueue::weak_t reply_queue, bool on_worker)
+{
+    LL_PROFILE_ZONE_SCOPED;
+
+    // Held while posting so that cleanupClass() can't pull the pool away
+    LLMutexLock lock(&sReadThreadPoolMutex);
+    if (!sReadThreadPool)
+    {
+        if (!sReadThreads)
+        {
+            return false;
+        }
+        sReadThreadPool = std::make_unique<LL::ThreadPool>("FileSystemRead", sReadThreads);
+        sReadThreadPool->start();
+    }
+
+    LL::WorkQueue& queue = sReadThreadPool->getQueue();
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        const ReadRequest& request = batch[i];
+
+        // One work item per request so that the whole pool works on a batch
+        bool posted = queue.post(
+            [request, callback, reply_queue, on_worker]()
+            {
+                LL_PROFILE_ZONE_NAMED("LLFileSystem::readAsync");
+                ReadResult result;
+                readRequest(request, result);
+
+                if (on_worker)
+                {
+                    callback(result);
+                }
+                else
+                {
+                    // Dropped along with the result if the queue is gone
+                    LL::WorkQueue::postMaybe(reply_queue,
+                        [callback, result = std::move(result)]() mutable
+                        {
+                            callback(result);
+                        });
+                }
+            });
+        if (!posted)
+        {
+            LL_DEBUGS() << "Tried to read " << request.mFileID << " on shutdown, "
+                        << (batch.size() - i) << " of " << batch.size() << " requests not posted" << LL_ENDL;
+            return false;
+        }
+    }
+    return true;
+}
+
+// static
+void LLFileSystem::readRequest(const ReadRequest& request, ReadResult& result)
+{
+    result.mFileID = request.mFileID;
+    result.mFileType = request.mFileType;
+    result.mSuccess = false;
+    result.mData.clear();
+
+    LLFileSystem file(request.mFileID, request.mFileType);
+    const S32 size = file.getSize();
+    if (size <= 0 || request.mOffset >= size)
+    {
+        return;
+    }
+
+    const S32 bytes = request.mBytes > 0 ? llmin(request.mBytes, size - request.mOffset) : size - request.mOffset;
+    result.mData.resize(bytes);
+    if (file.seek(request.mOffset, 0) && file.read(result.mData.data(), bytes))
+    {
+        result.mData.resize(file.getLastBytesRead());
+        result.mSuccess = true;
+    }
+    else
+    {
+        result.mData.clear();
+    }
+}
+
 BOOL LLFileSystem::read(U8* buffer, S32 bytes)
 {
     BOOL success = FALSE;
 
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPack();
+    if (pack && pack->read(mFileID, mPosition, buffer, bytes, mBytesRead))
+    {
+        mPosition += mBytesRead;
+        return mBytesRead ? TRUE : FALSE;
+    }
+
     LLFILE* file = LLFile::fopen(mFilePath, TEXT("rb"));
     if (file)
     {
@@ -150,7 +297,12 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
 {
     BOOL success = FALSE;
 
-    if (mMode == APPEND)
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPack();
+    if (pack && writePacked(pack, buffer, bytes, success))
+    {
+        // handled by the pack backend
+    }
+    else if (mMode == APPEND)
     {
         LLFILE* ofs = LLFile::fopen(mFilePath, TEXT("a+b"));
         if (ofs)
@@ -198,10 +350,96 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
         }
     }
 
+    if (success)
+    {
+        // Only the plain WRITE mode truncates, READ_WRITE falls back to it
+        // when the file does not exist yet which amounts to the same thing.
+        LLDiskCache::getInstance()->recordWrite(mFileID, mFileType, mPosition, mMode == WRITE);
+    }
 
     return success;
 }
 
+bool LLFileSystem::writePacked(LLDiskCachePack* pack, const U8* buffer, S32 bytes, BOOL& success)
+{
+    // A read only pack belongs to another viewer instance, what is written
+    // here goes to loose files
+    const bool read_only = pack->isReadOnly();
+    if (mMode == WRITE)
+    {
+        if (read_only || !pack->accepts(bytes))
+        {
+            // Goes to a file of its own, don't let an old packed copy shadow it
+            pack->remove(mFileID);
+            return false;
+        }
+
+        // A loose file can only be left from before the asset was packed
+        boost::system::error_code ec;
+        const bool stale_file = pack->getSize(mFileID) < 0 && boost::filesystem::exists(mFilePath, ec);
+        success = pack->write(mFileID, mFileType, buffer, bytes);
+        if (success)
+        {
+            if (stale_file)
+            {
+                pack->addStaleFile(mFileID, mFilePath);
+            }
+            mPosition = bytes;
+        }
+        return true;
+    }
+
+    const S32 packed_size = pack->getSize(mFileID);
+    if (packed_size < 0)
+    {
+        // Files that are already loose keep being updated in place
+        boost::system::error_code ec;
+        if (read_only || boost::filesystem::exists(mFilePath, ec))
+        {
+            return false;
+        }
+    }
+
+    const S32 old_size = llmax(packed_size, 0);
+    const S32 offset = (mMode == APPEND) ? old_size : llmin(mPosition, old_size);
+    if (!read_only && pack->accepts(llmax(old_size, offset + bytes)))
+    {
+        S32 end = 0;
+        success = pack->writeAt(mFileID, mFileType, (mMode == APPEND) ? -1 : offset, buffer, bytes, end);
+        if (success)
+        {
+            mPosition = end;
+        }
+        return true;
+    }
+
+    // Grew past the threshold or the pack is read only: move it out to a
+    // file of its own. Taking it out of the pack first also takes care of
+    // any stale loose copy.
+    std::vector<U8> data;
+    if (packed_size < 0 || !pack->readAll(mFileID, data))
+    {
+        return false;
+    }
+    pack->remove(mFileID);
+
+    const S32 new_size = llmax((S32)data.size(), offset + bytes);
+    data.resize(new_size);
+    memcpy(data.data() + offset, buffer, bytes);
+
+    LLFILE* ofs = LLFile::fopen(mFilePath, TEXT("wb"));
+    if (ofs)
+    {
+        success = fwrite(data.data(), 1, new_size, ofs) == (size_t)new_size;
+        fclose(ofs);
+    }
+    if (success)
+    {
+        mPosition = offset + bytes;
+    }
+    return true;
+}
+
 BOOL LLFileSystem::seek(S32 offset, S32 origin)
 {
     if (-1 == origin)
@@ -239,6 +477,16 @@ S32 LLFileSystem::tell() const
 
 S32 LLFileSystem::getSize()
 {
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        const S32 packed_size = pack->getSize(mFileID);
+        if (packed_size >= 0)
+        {
+            return packed_size;
+        }
+    }
+
     boost::system::error_code ec;
     S32 file_size = boost::filesystem::file_size(mFilePath, ec);
     if(ec.failed())
@@ -267,6 +515,23 @@ BOOL LLFileSystem::rename(const LLUUID& new_id, const LLAssetType::EType new_typ
         ec.clear();
     }
 
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        if (pack->rename(mFileID, new_id, new_type))
+        {
+            LLDiskCache::getInstance()->recordRename(mFileID, new_id, new_type);
+
+            mFileID = new_id;
+            mFileType = new_type;
+            mFilePath = new_filename;
+            return TRUE;
+        }
+
+        // Same as above for a packed asset under the new name
+        pack->remove(new_id);
+    }
+
     boost::filesystem::rename(mFilePath, new_filename, ec);
     if (ec.failed())
     {
@@ -276,6 +541,10 @@ BOOL LLFileSystem::rename(const LLUUID& new_id, const LLAssetType::EType new_typ
         //return FALSE;
         LL_WARNS() << "Failed to rename " << mFileID << " to " << new_id << " reason: "  << ec.what() << LL_ENDL;
     }
+    else
+    {
+        LLDiskCache::getInstance()->recordRename(mFileID, new_id, new_type);
+    }
 
     mFileID = new_id;
     mFileType = new_type;
@@ -286,7 +555,14 @@ BOOL LLFileSystem::rename(const LLUUID& new_id, const LLAssetType::EType new_typ
 
 BOOL LLFileSystem::remove()
 {
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPack();
+    if (pack)
+    {
+        pack->remove(mFileID);
+    }
+
     boost::system::error_code ec;
     boost::filesystem::remove(mFilePath, ec);
+    LLDiskCache::getInstance()->recordRemove(mFileID);
     return TRUE;
 }
@@ -33,6 +33,12 @@
 #include "lluuid.h"
 #include "llassettype.h"
 #include "lldiskcache.h"
+#include "workqueue.h"
+
+#include <functional>
+#include <vector>
+
+class LLDiskCachePack;
 
 class LLFileSystem
 {
@@ -59,12 +65,77 @@ class LLFileSystem
                                const LLUUID& new_file_id, const LLAssetType::EType new_file_type);
         static S32 getFileSize(const LLUUID& file_id, const LLAssetType::EType file_type);
 
+        /**
+         * Asynchronous batched reads. Each request of a batch is read on the
+         * "FileSystemRead" thread pool so that consumers loading many assets
+         * (mesh, asset storage) can overlap disk latency with their other
+         * work. The pool is only started by the first read.
+         */
+        struct ReadRequest
+        {
+            LLUUID              mFileID;
+            LLAssetType::EType  mFileType = LLAssetType::AT_NONE;
+            S32                 mOffset = 0;
+            S32                 mBytes = 0;     // 0 reads to the end of the file
+        };
+        typedef std::vector<ReadRequest> read_batch_t;
+
+        struct ReadResult
+        {
+            LLUUID              mFileID;
+            LLAssetType::EType  mFileType = LLAssetType::AT_NONE;
+            bool                mSuccess = false;
+            std::vector<U8>     mData;
+        };
+        typedef std::function<void(ReadResult&)> read_callback_t;
+
+        /**
+         * initClass() only records the number of threads, the pool itself
+         * is started on demand. The "FileSystemRead" entry of
+         * ThreadPoolSizes overrides it.
+         */
+        static void initClass(size_t threads);
+        static void cleanupClass();
+
+        /**
+         * The callback is called once per request on reply_queue. Results
+         * are dropped if reply_queue is gone by the time they are ready.
+         *
+         * Returns false if the pool is not running (before initClass() or
+         * during shutdown). Posting is not all or nothing: when the pool
+         * closes part way through a batch, the requests posted before that
+         * still get their callback and the others don't.
+         */
+        static bool readAsync(const read_batch_t& batch, const read_callback_t& callback,
+                              LL::WorkQueue::weak_t reply_queue);
+
+        /**
+         * Same as readAsync() but the callback is called right on the worker
+         * thread, for callers that hand the data off themselves.
+         */
+        static bool readAsyncOnWorker(const read_batch_t& batch, const read_callback_t& callback);
+
+        /**
+         * Synchronous form of a single request, also used by the workers
+         */
+        static void readRequest(const ReadRequest& request, ReadResult& result);
+
     public:
         static const S32 READ;
         static const S32 WRITE;
         static const S32 READ_WRITE;
         static const S32 APPEND;
 
+    protected:
+        static bool postReads(const read_batch_t& batch, const read_callback_t& callback,
+                              LL::WorkQueue::weak_t reply_queue, bool on_worker);
+
+        /**
+         * Write through the pack backend. Returns false if the write has to
+         * go to a file of its own instead, otherwise success is set.
+         */
+        bool writePacked(LLDiskCachePack* pack, const U8* buffer, S32 bytes, BOOL& success);
+
     protected:
         boost::filesystem::path mFilePath;
         LLAssetType::EType mFileType;
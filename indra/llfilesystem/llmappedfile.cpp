@@ -0,0 +1,195 @@
+/**
+ * @file llmappedfile.cpp
+ * @brief A small growable read/write memory-mapped file.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmappedfile.h"
+
+#include "llfile.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/exceptions.hpp>
+
+namespace
+{
+    boost::filesystem::path to_path(const std::string& filename)
+    {
+#if LL_WINDOWS
+        return boost::filesystem::path(ll_convert_string_to_wide(filename));
+#else
+        return boost::filesystem::path(filename);
+#endif
+    }
+}
+
+LLMappedFile::~LLMappedFile()
+{
+    close();
+}
+
+bool LLMappedFile::open(const std::string& filename, size_t min_size)
+{
+    close();
+    mFilename = filename;
+    mReadOnly = false;
+
+    const boost::filesystem::path path = to_path(filename);
+    boost::system::error_code ec;
+    if (!boost::filesystem::exists(path, ec))
+    {
+        // Create the file; file_mapping refuses to open missing files.
+        LLFILE* fp = LLFile::fopen(filename, "wb");
+        if (!fp)
+        {
+            LL_WARNS() << "Unable to create mapped file " << filename << LL_ENDL;
+            return false;
+        }
+        fclose(fp);
+    }
+
+    uintmax_t cur_size = boost::filesystem::file_size(path, ec);
+    if (ec.failed())
+    {
+        LL_WARNS() << "Unable to stat mapped file " << filename << ": " << ec.message() << LL_ENDL;
+        return false;
+    }
+
+    if (cur_size < min_size)
+    {
+        boost::filesystem::resize_file(path, min_size, ec);
+        if (ec.failed())
+        {
+            LL_WARNS() << "Unable to size mapped file " << filename << ": " << ec.message() << LL_ENDL;
+            return false;
+        }
+        cur_size = min_size;
+    }
+
+    mSize = (size_t)cur_size;
+    return map();
+}
+
+bool LLMappedFile::openReadOnly(const std::string& filename)
+{
+    close();
+    mFilename = filename;
+    mReadOnly = true;
+
+    boost::system::error_code ec;
+    const uintmax_t cur_size = boost::filesystem::file_size(to_path(filename), ec);
+    if (ec.failed())
+    {
+        return false;
+    }
+
+    mSize = (size_t)cur_size;
+    return map();
+}
+
+void LLMappedFile::close()
+{
+    if (mData && !mReadOnly)
+    {
+        flush(false);
+    }
+    unmap();
+    mSize = 0;
+}
+
+bool LLMappedFile::resize(size_t new_size)
+{
+    if (mFilename.empty() || mReadOnly)
+    {
+        return false;
+    }
+
+    if (mData)
+    {
+        flush(false);
+    }
+    unmap();
+
+    boost::system::error_code ec;
+    boost::filesystem::resize_file(to_path(mFilename), new_size, ec);
+    if (ec.failed())
+    {
+        LL_WARNS() << "Unable to resize mapped file " << mFilename << " to " << new_size << ": " << ec.message() << LL_ENDL;
+        // Try to restore the previous mapping so callers keep a usable file.
+        map();
+        return false;
+    }
+
+    mSize = new_size;
+    return map();
+}
+
+bool LLMappedFile::flush(bool async)
+{
+    if (!mData || mReadOnly)
+    {
+        return false;
+    }
+    return mRegion.flush(0, 0, async);
+}
+
+bool LLMappedFile::map()
+{
+    if (mSize == 0)
+    {
+        return false;
+    }
+
+    const boost::interprocess::mode_t mode = mReadOnly ? boost::interprocess::read_only : boost::interprocess::read_write;
+    try
+    {
+#if LL_WINDOWS
+        boost::interprocess::file_mapping mapping(ll_convert_string_to_wide(mFilename).c_str(), mode);
+#else
+        boost::interprocess::file_mapping mapping(mFilename.c_str(), mode);
+#endif
+        boost::interprocess::mapped_region region(mapping, mode, 0, mSize);
+        mMapping.swap(mapping);
+        mRegion.swap(region);
+    }
+    catch (const boost::interprocess::interprocess_exception& e)
+    {
+        LL_WARNS() << "Unable to map file " << mFilename << ": " << e.what() << LL_ENDL;
+        unmap();
+        return false;
+    }
+
+    mData = static_cast<U8*>(mRegion.get_address());
+    return true;
+}
+
+void LLMappedFile::unmap()
+{
+    boost::interprocess::mapped_region empty_region;
+    mRegion.swap(empty_region);
+    boost::interprocess::file_mapping empty_mapping;
+    mMapping.swap(empty_mapping);
+    mData = nullptr;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file llmappedfile.h
+ * @brief A small growable read/write memory-mapped file.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMAPPEDFILE_H
+#define LL_LLMAPPEDFILE_H
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <string>
+
+// Wraps a file that is mapped read/write into the address space of the
+// viewer. Used by the on-disk caches that keep fixed size records which are
+// updated in place, so that an update costs a memory store rather than a
+// seek/write/close round trip.
+//
+// Files can also be mapped read only, for caches of write once records.
+//
+// Any pointer returned by data() is invalidated by resize() and close().
+// The class does no locking of its own: callers serialize access.
+class LLMappedFile
+{
+public:
+    LLMappedFile() = default;
+    ~LLMappedFile();
+
+    LLMappedFile(const LLMappedFile&) = delete;
+    LLMappedFile& operator=(const LLMappedFile&) = delete;
+
+    // Open (creating it if needed) the file at filename and map it. If the
+    // file is smaller than min_size it is first grown to min_size bytes,
+    // new bytes being zero filled. Returns false on failure.
+    bool open(const std::string& filename, size_t min_size);
+
+    // Map an existing, non empty file read only. resize() and flush() then
+    // fail. Returns false on failure.
+    bool openReadOnly(const std::string& filename);
+
+    // Flush and unmap the file.
+    void close();
+
+    // Grow or shrink the underlying file and remap it.
+    bool resize(size_t new_size);
+
+    // Schedule dirty pages to be written back. When async is false, only
+    // returns once the OS reports the data as written.
+    bool flush(bool async = true);
+
+    bool isOpen() const     { return mData != nullptr; }
+    U8* data() const        { return mData; }
+    size_t size() const     { return mSize; }
+    const std::string& getFilename() const { return mFilename; }
+
+private:
+    bool map();
+    void unmap();
+
+private:
+    std::string mFilename;
+    boost::interprocess::file_mapping mMapping;
+    boost::interprocess::mapped_region mRegion;
+    U8* mData = nullptr;
+    size_t mSize = 0;
+    bool mReadOnly = false;
+};
+
+#endif // LL_LLMAPPEDFILE_H
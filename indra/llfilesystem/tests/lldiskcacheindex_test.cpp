@@ -0,0 +1,252 @@
+/**
+ * @file lldiskcacheindex_test.cpp
+ * @brief Test of the memory-mapped disk cache index
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../lldiskcacheindex.h"
+#include "../lldir.h"
+
+#include "llfile.h"
+
+#include "boost/filesystem.hpp"
+
+#include <fstream>
+
+namespace tut
+{
+    struct diskcacheindex_data
+    {
+        diskcacheindex_data()
+        {
+            mFilename = gDirUtilp->getTempFilename();
+            for (S32 i = 0; i < 4; ++i)
+            {
+                mIDs[i].generate();
+            }
+        }
+
+        ~diskcacheindex_data()
+        {
+            LLFile::remove(mFilename);
+            LLFile::remove(mFilename + ".copy");
+        }
+
+        // Fills a fresh index with the four ids, 100, 200, 300 and 400
+        // bytes, the last one the most recently used
+        void fill(LLDiskCacheIndex& index)
+        {
+            ensure("opened", index.open(mFilename));
+            ensure("new index needs a scan", index.needsScan());
+            index.mergeScan(LLDiskCacheIndex::scanned_list_t());
+            for (S32 i = 0; i < 4; ++i)
+            {
+                index.recordWrite(mIDs[i], LLAssetType::AT_TEXTURE, (i + 1) * 100, true);
+            }
+        }
+
+        // Ids in eviction order, least recently used first
+        std::vector<LLUUID> evictAll(LLDiskCacheIndex& index)
+        {
+            LLDiskCacheIndex::evicted_list_t evicted;
+            index.evict(0, evicted);
+            std::vector<LLUUID> ids;
+            for (const auto& entry : evicted)
+            {
+                ids.push_back(entry.mID);
+            }
+            return ids;
+        }
+
+        std::string mFilename;
+        LLUUID mIDs[4];
+    };
+    typedef test_group<diskcacheindex_data> diskcacheindex_group;
+    typedef diskcacheindex_group::object diskcacheindex_object;
+    tut::diskcacheindex_group diskcacheindex("LLDiskCacheIndex");
+
+    template<> template<>
+    void diskcacheindex_object::test<1>()
+    {
+        // Insert, lookup and remove
+        LLDiskCacheIndex index;
+        fill(index);
+        ensure("scanned", !index.needsScan());
+        ensure_equals("entries", index.getEntryCount(), 4U);
+        ensure_equals("total size", index.getTotalSize(), (uintmax_t)1000);
+
+        LLUUID unknown;
+        unknown.generate();
+        ensure("known entry", index.touch(mIDs[2]));
+        ensure("unknown entry", !index.touch(unknown));
+
+        // appending keeps the largest size, truncating replaces it
+        index.recordWrite(mIDs[0], LLAssetType::AT_TEXTURE, 50, false);
+        ensure_equals("append keeps the size", index.getTotalSize(), (uintmax_t)1000);
+        index.recordWrite(mIDs[0], LLAssetType::AT_TEXTURE, 50, true);
+        ensure_equals("truncated", index.getTotalSize(), (uintmax_t)950);
+
+        index.remove(mIDs[1]);
+        index.remove(unknown);
+        ensure("removed", !index.touch(mIDs[1]));
+        ensure_equals("entries after remove", index.getEntryCount(), 3U);
+        ensure_equals("size after remove", index.getTotalSize(), (uintmax_t)750);
+
+        // a rename replaces the entry it lands on
+        index.rename(mIDs[3], mIDs[2], LLAssetType::AT_MESH);
+        ensure("renamed away", !index.touch(mIDs[3]));
+        ensure_equals("entries after rename", index.getEntryCount(), 2U);
+        ensure_equals("size after rename", index.getTotalSize(), (uintmax_t)450);
+
+        LLDiskCacheIndex::evicted_list_t evicted;
+        index.evict(0, evicted);
+        ensure_equals("all evicted", evicted.size(), (size_t)2);
+        ensure("renamed type", evicted[0].mID == mIDs[2] && evicted[0].mType == LLAssetType::AT_MESH);
+        ensure_equals("empty", index.getTotalSize(), (uintmax_t)0);
+    }
+
+    template<> template<>
+    void diskcacheindex_object::test<2>()
+    {
+        // Least recently used first, down to the requested size
+        LLDiskCacheIndex index;
+        fill(index);
+        index.touch(mIDs[0]);
+
+        LLDiskCacheIndex::evicted_list_t evicted;
+        index.evict(700, evicted);
+        ensure_equals("two evicted", evicted.size(), (size_t)2);
+        ensure("oldest first", evicted[0].mID == mIDs[1] && evicted[1].mID == mIDs[2]);
+        ensure_equals("evicted size", evicted[0].mSize, (uintmax_t)200);
+        ensure_equals("size left", index.getTotalSize(), (uintmax_t)500);
+
+        evicted.clear();
+        index.evict(500, evicted);
+        ensure("nothing more", evicted.empty());
+    }
+
+    template<> template<>
+    void diskcacheindex_object::test<3>()
+    {
+        // A cleanly closed index comes back as it was, in the same order
+        {
+            LLDiskCacheIndex index;
+            fill(index);
+            index.touch(mIDs[1]);
+            index.touch(mIDs[0]);
+            index.close();
+            ensure("closed", !index.isOpen());
+        }
+
+        LLDiskCacheIndex index;
+        ensure("reopened", index.open(mFilename));
+        ensure("trusted", !index.needsScan());
+        ensure_equals("entries", index.getEntryCount(), 4U);
+        ensure_equals("total size", index.getTotalSize(), (uintmax_t)1000);
+
+        const std::vector<LLUUID> order = evictAll(index);
+        ensure_equals("all evicted", order.size(), (size_t)4);
+        ensure("same order", order[0] == mIDs[2] && order[1] == mIDs[3] && order[2] == mIDs[1] && order[3] == mIDs[0]);
+    }
+
+    template<> template<>
+    void diskcacheindex_object::test<4>()
+    {
+        // An index left open by a crash is emptied and rebuilt from a scan
+        {
+            LLDiskCacheIndex index;
+            fill(index);
+            // the file as the crash leaves it, the index is still open
+            boost::filesystem::copy_file(mFilename, mFilename + ".copy");
+        }
+
+        LLDiskCacheIndex index;
+        ensure("opened", index.open(mFilename + ".copy"));
+        ensure("not trusted", index.needsScan());
+        ensure_equals("emptied", index.getEntryCount(), 0U);
+
+        // files already indexed keep their access time over the scanned one
+        index.recordWrite(mIDs[0], LLAssetType::AT_TEXTURE, 100, true);
+        LLDiskCacheIndex::scanned_list_t scanned;
+        scanned.push_back({ mIDs[0], 100, 0 });
+        scanned.push_back({ mIDs[1], 200, 20 });
+        scanned.push_back({ mIDs[2], 300, 10 });
+        index.mergeScan(scanned);
+        ensure("scanned", !index.needsScan());
+        ensure_equals("entries", index.getEntryCount(), 3U);
+        ensure_equals("total size", index.getTotalSize(), (uintmax_t)600);
+
+        const std::vector<LLUUID> order = evictAll(index);
+        ensure_equals("all evicted", order.size(), (size_t)3);
+        ensure("by write time", order[0] == mIDs[2] && order[1] == mIDs[1] && order[2] == mIDs[0]);
+    }
+
+    template<> template<>
+    void diskcacheindex_object::test<5>()
+    {
+        // A corrupt or truncated file is replaced by an empty index
+        {
+            std::ofstream file(mFilename, std::ios::binary);
+            for (S32 i = 0; i < 1000; ++i)
+            {
+                file.put((char)(i * 37));
+            }
+        }
+
+        {
+            LLDiskCacheIndex index;
+            ensure("opened", index.open(mFilename));
+            ensure("not trusted", index.needsScan());
+            ensure_equals("empty", index.getEntryCount(), 0U);
+
+            // and works once rebuilt, past its initial capacity too
+            index.mergeScan(LLDiskCacheIndex::scanned_list_t());
+            for (S32 i = 0; i < 5000; ++i)
+            {
+                LLUUID id;
+                id.generate();
+                index.recordWrite(id, LLAssetType::AT_TEXTURE, 10, true);
+            }
+            ensure_equals("grown", index.getEntryCount(), 5000U);
+            index.close();
+        }
+
+        {
+            LLDiskCacheIndex index;
+            ensure("grown index reopened", index.open(mFilename));
+            ensure("trusted", !index.needsScan());
+            ensure_equals("entries", index.getEntryCount(), 5000U);
+            ensure_equals("total size", index.getTotalSize(), (uintmax_t)50000);
+        }
+
+        // cut short in the middle of its records
+        boost::filesystem::resize_file(mFilename, 1000);
+        LLDiskCacheIndex index;
+        ensure("truncated opened", index.open(mFilename));
+        ensure("truncated not trusted", index.needsScan());
+        ensure_equals("truncated empty", index.getEntryCount(), 0U);
+    }
+}
@@ -0,0 +1,262 @@
+/**
+ * @file lldiskcachepack_test.cpp
+ * @brief Test of the pack files of the disk cache
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../lldiskcachepack.h"
+#include "../lldir.h"
+
+#include "boost/filesystem.hpp"
+
+#include <atomic>
+#include <thread>
+
+namespace tut
+{
+    struct diskcachepack_data
+    {
+        diskcachepack_data()
+        {
+            mCacheDir = gDirUtilp->getTempFilename();
+            LLFile::mkdir(mCacheDir);
+            for (S32 i = 0; i < 3; ++i)
+            {
+                mIDs[i].generate();
+            }
+        }
+
+        ~diskcachepack_data()
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(mCacheDir, ec);
+        }
+
+        static std::vector<U8> makeData(S32 size, U8 seed)
+        {
+            std::vector<U8> data(size);
+            for (S32 i = 0; i < size; ++i)
+            {
+                data[i] = U8(i * 13 + seed);
+            }
+            return data;
+        }
+
+        std::vector<U8> readAll(LLDiskCachePack& pack, const LLUUID& id)
+        {
+            std::vector<U8> data;
+            ensure("packed", pack.readAll(id, data));
+            return data;
+        }
+
+        std::string packFile(U32 num) const
+        {
+            return mCacheDir + gDirUtilp->getDirDelimiter() + llformat("pack_%04d.sl_pack", num);
+        }
+
+        static constexpr U32 THRESHOLD = 4096;
+        std::string mCacheDir;
+        LLUUID mIDs[3];
+    };
+    typedef test_group<diskcachepack_data> diskcachepack_group;
+    typedef diskcachepack_group::object diskcachepack_object;
+    tut::diskcachepack_group diskcachepack("LLDiskCachePack");
+
+    template<> template<>
+    void diskcachepack_object::test<1>()
+    {
+        // Write and read back
+        LLDiskCachePack pack(mCacheDir, THRESHOLD);
+        ensure("opened", pack.open());
+        ensure("small enough", pack.accepts(THRESHOLD) && !pack.accepts(THRESHOLD + 1));
+        ensure("too large", !pack.write(mIDs[0], LLAssetType::AT_ANIMATION, nullptr, THRESHOLD + 1));
+        ensure_equals("not packed", pack.getSize(mIDs[0]), -1);
+
+        const std::vector<U8> data = makeData(1000, 1);
+        ensure("written", pack.write(mIDs[0], LLAssetType::AT_ANIMATION, data.data(), (S32)data.size()));
+        ensure_equals("size", pack.getSize(mIDs[0]), 1000);
+        ensure("same data", readAll(pack, mIDs[0]) == data);
+
+        U8 buffer[100];
+        S32 bytes_read = 0;
+        ensure("partial read", pack.read(mIDs[0], 950, buffer, 100, bytes_read));
+        ensure_equals("up to the end", bytes_read, 50);
+        ensure("partial data", std::equal(buffer, buffer + 50, data.begin() + 950));
+        ensure("past the end", pack.read(mIDs[0], 1000, buffer, 100, bytes_read) && bytes_read == 0);
+        ensure("unknown", !pack.read(mIDs[1], 0, buffer, 100, bytes_read));
+
+        // concurrent readers all see the data
+        std::vector<std::thread> readers;
+        std::atomic<S32> good_reads(0);
+        for (S32 i = 0; i < 4; ++i)
+        {
+            readers.emplace_back([&]()
+                {
+                    for (S32 j = 0; j < 100; ++j)
+                    {
+                        std::vector<U8> read_data;
+                        if (pack.readAll(mIDs[0], read_data) && read_data == data)
+                        {
+                            ++good_reads;
+                        }
+                    }
+                });
+        }
+        for (auto& reader : readers)
+        {
+            reader.join();
+        }
+        ensure_equals("concurrent reads", good_reads.load(), 400);
+
+        // and so does the next session
+        pack.close();
+        LLDiskCachePack reopened(mCacheDir, THRESHOLD);
+        reopened.open();
+        ensure("reopened data", readAll(reopened, mIDs[0]) == data);
+    }
+
+    template<> template<>
+    void diskcachepack_object::test<2>()
+    {
+        // Overwrites, appends, removes and renames supersede the older records
+        std::vector<U8> data = makeData(500, 2);
+        {
+            LLDiskCachePack pack(mCacheDir, THRESHOLD);
+            pack.open();
+            pack.write(mIDs[0], LLAssetType::AT_GESTURE, data.data(), 500);
+            const std::vector<U8> other = makeData(300, 3);
+            pack.write(mIDs[1], LLAssetType::AT_GESTURE, other.data(), 300);
+
+            data = makeData(200, 4);
+            ensure("overwritten", pack.write(mIDs[0], LLAssetType::AT_GESTURE, data.data(), 200));
+            ensure("new data", readAll(pack, mIDs[0]) == data);
+
+            // the last record grows in place, others are written again
+            const std::vector<U8> tail = makeData(100, 5);
+            S32 end = 0;
+            ensure("appended", pack.writeAt(mIDs[0], LLAssetType::AT_GESTURE, -1, tail.data(), 100, end));
+            ensure_equals("end", end, 300);
+            data.insert(data.end(), tail.begin(), tail.end());
+            ensure("appended data", readAll(pack, mIDs[0]) == data);
+
+            ensure("overwritten in the middle", pack.writeAt(mIDs[0], LLAssetType::AT_GESTURE, 50, tail.data(), 100, end));
+            std::copy(tail.begin(), tail.end(), data.begin() + 50);
+            ensure("middle data", readAll(pack, mIDs[0]) == data);
+            ensure("too large to stay", !pack.writeAt(mIDs[0], LLAssetType::AT_GESTURE, -1, nullptr, THRESHOLD, end));
+            ensure("left as it was", readAll(pack, mIDs[0]) == data);
+
+            ensure("renamed", pack.rename(mIDs[1], mIDs[2], LLAssetType::AT_NOTECARD));
+            ensure("removed", pack.remove(mIDs[2]));
+            ensure("removed once", !pack.remove(mIDs[2]));
+        }
+
+        // the latest records win after a restart
+        LLDiskCachePack pack(mCacheDir, THRESHOLD);
+        pack.open();
+        ensure("latest data", readAll(pack, mIDs[0]) == data);
+        ensure("renamed away", pack.getSize(mIDs[1]) < 0);
+        ensure("tombstone", pack.getSize(mIDs[2]) < 0);
+
+        LLDiskCachePack::entry_list_t entries;
+        pack.getEntries(entries);
+        ensure_equals("one asset left", entries.size(), (size_t)1);
+        ensure("its type", entries[0].mID == mIDs[0] && entries[0].mType == LLAssetType::AT_GESTURE);
+    }
+
+    template<> template<>
+    void diskcachepack_object::test<3>()
+    {
+        // Mostly dead packs are compacted into the active one
+        const std::vector<U8> large = makeData(1000, 6);
+        const std::vector<U8> small = makeData(100, 7);
+        {
+            LLDiskCachePack pack(mCacheDir, THRESHOLD);
+            pack.open();
+            pack.write(mIDs[0], LLAssetType::AT_ANIMATION, large.data(), 1000);
+            pack.write(mIDs[1], LLAssetType::AT_ANIMATION, large.data(), 1000);
+            pack.write(mIDs[2], LLAssetType::AT_ANIMATION, small.data(), 100);
+            pack.remove(mIDs[0]);
+            pack.remove(mIDs[1]);
+        }
+
+        // A new pack only starts once the active one is full, make one by
+        // hand so that the first one can be compacted
+        LLFILE* fp = LLFile::fopen(packFile(2), "wb");
+        ensure("second pack", fp != nullptr);
+        fclose(fp);
+
+        LLDiskCachePack pack(mCacheDir, THRESHOLD);
+        pack.open();
+        const uintmax_t before = pack.getPackFileBytes();
+        pack.compact();
+        ensure("first pack gone", !LLFile::isfile(packFile(1)));
+        ensure("smaller", pack.getPackFileBytes() < before);
+        ensure("live data moved", readAll(pack, mIDs[2]) == small);
+        ensure("removed stay removed", pack.getSize(mIDs[0]) < 0 && pack.getSize(mIDs[1]) < 0);
+
+        pack.close();
+        pack.open();
+        ensure("moved data reopened", readAll(pack, mIDs[2]) == small);
+        ensure("still removed", pack.getSize(mIDs[0]) < 0);
+    }
+
+    template<> template<>
+    void diskcachepack_object::test<4>()
+    {
+        // A record cut short by a crash is dropped, but not by a read only
+        // instance since the owner may be writing it
+        const std::vector<U8> data = makeData(500, 8);
+        {
+            LLDiskCachePack pack(mCacheDir, THRESHOLD);
+            pack.open();
+            pack.write(mIDs[0], LLAssetType::AT_LANDMARK, data.data(), 500);
+            pack.write(mIDs[1], LLAssetType::AT_LANDMARK, data.data(), 500);
+        }
+        boost::filesystem::resize_file(packFile(1), boost::filesystem::file_size(packFile(1)) - 10);
+        const uintmax_t cut_size = boost::filesystem::file_size(packFile(1));
+
+        {
+            LLDiskCachePack read_only(mCacheDir, THRESHOLD, true);
+            read_only.open();
+            ensure("read only data", readAll(read_only, mIDs[0]) == data);
+            ensure("cut record", read_only.getSize(mIDs[1]) < 0);
+            ensure_equals("not truncated", (uintmax_t)boost::filesystem::file_size(packFile(1)), cut_size);
+
+            // nothing is written, the new copies are left to loose files
+            ensure("no write", !read_only.write(mIDs[1], LLAssetType::AT_LANDMARK, data.data(), 500));
+            ensure("forgotten", read_only.remove(mIDs[0]) && read_only.getSize(mIDs[0]) < 0);
+            ensure_equals("untouched", (uintmax_t)boost::filesystem::file_size(packFile(1)), cut_size);
+        }
+
+        LLDiskCachePack pack(mCacheDir, THRESHOLD);
+        pack.open();
+        ensure("still there", readAll(pack, mIDs[0]) == data);
+        ensure("cut record dropped", pack.getSize(mIDs[1]) < 0);
+        ensure("truncated", boost::filesystem::file_size(packFile(1)) < cut_size);
+        ensure("written after the cut", pack.write(mIDs[1], LLAssetType::AT_LANDMARK, data.data(), 500));
+        ensure("readable after the cut", readAll(pack, mIDs[1]) == data);
+    }
+}
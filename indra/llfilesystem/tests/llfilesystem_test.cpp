@@ -0,0 +1,227 @@
+/**
+ * @file llfilesystem_test.cpp
+ * @brief Test of the asynchronous batched reads of LLFileSystem
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llfilesystem.h"
+#include "../lldir.h"
+#include "../lldiskcache.h"
+
+#include "lltimer.h"
+#include "workqueue.h"
+
+#include "boost/filesystem.hpp"
+
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace tut
+{
+    struct filesystem_data
+    {
+        filesystem_data()
+        {
+            mOldCacheDir = gDirUtilp->getCacheDir();
+            mCacheDir = gDirUtilp->getTempFilename();
+            gDirUtilp->setCacheDir(mCacheDir);
+            LLDiskCache::createInstance();
+            LLDiskCache::getInstance()->init(LL_PATH_CACHE, 16 * 1024 * 1024, false, false);
+
+            // a few assets of different sizes
+            for (S32 i = 0; i < 6; ++i)
+            {
+                LLUUID id;
+                id.generate();
+                std::vector<U8>& data = mAssets[id];
+                data.resize(1000 + i * 4096);
+                for (size_t j = 0; j < data.size(); ++j)
+                {
+                    data[j] = U8(j * 7 + i);
+                }
+                LLFileSystem file(id, LLAssetType::AT_MESH, LLFileSystem::WRITE);
+                file.write(data.data(), (S32)data.size());
+            }
+        }
+
+        ~filesystem_data()
+        {
+            LLFileSystem::cleanupClass();
+            LLDiskCache::deleteSingleton();
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(mCacheDir, ec);
+            gDirUtilp->setCacheDir(mOldCacheDir);
+        }
+
+        LLFileSystem::read_batch_t makeBatch(const LLUUID& missing)
+        {
+            LLFileSystem::read_batch_t batch;
+            for (const auto& asset : mAssets)
+            {
+                LLFileSystem::ReadRequest request;
+                request.mFileID = asset.first;
+                request.mFileType = LLAssetType::AT_MESH;
+                batch.push_back(request);
+            }
+            LLFileSystem::ReadRequest request;
+            request.mFileID = missing;
+            request.mFileType = LLAssetType::AT_MESH;
+            batch.push_back(request);
+            return batch;
+        }
+
+        void checkResult(const LLFileSystem::ReadResult& result, const LLUUID& missing)
+        {
+            if (result.mFileID == missing)
+            {
+                ensure("missing file fails", !result.mSuccess && result.mData.empty());
+                return;
+            }
+            auto it = mAssets.find(result.mFileID);
+            ensure("requested file", it != mAssets.end());
+            ensure("read", result.mSuccess);
+            ensure("same data", result.mData == it->second);
+        }
+
+        std::string mOldCacheDir;
+        std::string mCacheDir;
+        std::map<LLUUID, std::vector<U8>> mAssets;
+    };
+    typedef test_group<filesystem_data> filesystem_group;
+    typedef filesystem_group::object filesystem_object;
+    tut::filesystem_group filesystem("LLFileSystem");
+
+    template<> template<>
+    void filesystem_object::test<1>()
+    {
+        // A batch is read on the pool and called back on the reply queue
+        LL::WorkQueue reply("llfilesystem_test");
+        LLUUID missing;
+        missing.generate();
+        const LLFileSystem::read_batch_t batch = makeBatch(missing);
+
+        ensure("no pool before initClass", !LLFileSystem::readAsync(batch, [](LLFileSystem::ReadResult&) {}, reply.getWeak()));
+        LLFileSystem::initClass(2);
+
+        const std::thread::id this_thread = std::this_thread::get_id();
+        std::vector<LLFileSystem::ReadResult> results;
+        bool other_thread = false;
+        ensure("posted", LLFileSystem::readAsync(batch,
+            [&results, &other_thread, this_thread](LLFileSystem::ReadResult& result)
+            {
+                other_thread |= std::this_thread::get_id() != this_thread;
+                results.emplace_back(std::move(result));
+            },
+            reply.getWeak()));
+
+        LLTimer timer;
+        while (results.size() < batch.size() && timer.getElapsedTimeF32() < 10.f)
+        {
+            reply.runPending();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ensure_equals("one callback per request", results.size(), batch.size());
+        ensure("called back on the reply queue", !other_thread);
+        for (const auto& result : results)
+        {
+            checkResult(result, missing);
+        }
+
+        // Same data as the synchronous form
+        LLFileSystem::ReadResult result;
+        LLFileSystem::readRequest(batch[1], result);
+        ensure("synchronous", result.mSuccess && result.mData == mAssets[batch[1].mFileID]);
+    }
+
+    template<> template<>
+    void filesystem_object::test<2>()
+    {
+        // On the worker, the callbacks don't wait on any queue
+        LLFileSystem::initClass(2);
+        LLUUID missing;
+        missing.generate();
+        const LLFileSystem::read_batch_t batch = makeBatch(missing);
+
+        const std::thread::id this_thread = std::this_thread::get_id();
+        std::mutex mutex;
+        std::vector<LLFileSystem::ReadResult> results;
+        bool this_thread_called = false;
+        ensure("posted", LLFileSystem::readAsyncOnWorker(batch,
+            [&](LLFileSystem::ReadResult& result)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                this_thread_called |= std::this_thread::get_id() == this_thread;
+                results.emplace_back(std::move(result));
+            }));
+
+        LLTimer timer;
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (results.size() == batch.size() || timer.getElapsedTimeF32() > 10.f)
+                {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ensure_equals("one callback per request", results.size(), batch.size());
+        ensure("called back on the workers", !this_thread_called);
+        for (const auto& result : results)
+        {
+            checkResult(result, missing);
+        }
+    }
+
+    template<> template<>
+    void filesystem_object::test<3>()
+    {
+        // Partial reads and shutdown
+        LLFileSystem::initClass(1);
+        const auto& asset = *mAssets.rbegin();
+        LLFileSystem::ReadRequest request;
+        request.mFileID = asset.first;
+        request.mFileType = LLAssetType::AT_MESH;
+        request.mOffset = 100;
+        request.mBytes = 50;
+
+        LLFileSystem::ReadResult result;
+        LLFileSystem::readRequest(request, result);
+        ensure("partial read", result.mSuccess);
+        ensure("partial data", result.mData == std::vector<U8>(asset.second.begin() + 100, asset.second.begin() + 150));
+
+        request.mOffset = (S32)asset.second.size();
+        LLFileSystem::readRequest(request, result);
+        ensure("past the end", !result.mSuccess && result.mData.empty());
+
+        LLFileSystem::cleanupClass();
+        ensure("no pool after cleanupClass", !LLFileSystem::readAsyncOnWorker({ request }, [](LLFileSystem::ReadResult&) {}));
+    }
+}
@@ -41,10 +41,14 @@
 #include "llimagewebp.h"
 #include "llimagedxt.h"
 #include "llmemory.h"
+#include "llimagekernels.h"
 
 #include <boost/preprocessor.hpp>
 
 #include <array>
+#if defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
 
 //..................................................................................
 //..................................................................................
@@ -96,32 +100,114 @@
 
 
 //..................................................................................
-// Generated unrolling loop templates with specializations
+// Generated unrolling loop templates with specializations, 4 channels are
+// specialized by hand below when SSE4.1 is available
 //..................................................................................
+#if defined(__SSE4_1__)
+#define UROLL_CHANNELS (1)(3)
+#else
+#define UROLL_CHANNELS (1)(3)(4)
+#endif
 //example: for(c = 0; c < ch; ++c) comp[c] = cx[0] = 0;
-UNROLL_GEN_TPL(uroll_zeroze_cx_comp, (S32 *)(cx)(S32 *)(comp), (cx[_idx] = comp[_idx] = 0), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_zeroze_cx_comp, (S32 *)(cx)(S32 *)(comp), (cx[_idx] = comp[_idx] = 0), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) comp[c] >>= 4;
-UNROLL_GEN_TPL(uroll_comp_rshftasgn_constval, (S32 *)(comp)(const S32)(cval), (comp[_idx] >>= cval), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_comp_rshftasgn_constval, (S32 *)(comp)(const S32)(cval), (comp[_idx] >>= cval), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) comp[c] = (cx[c] >> 5) * yap;
-UNROLL_GEN_TPL(uroll_comp_asgn_cx_rshft_cval_all_mul_val, (S32 *)(comp)(S32 *)(cx)(const S32)(cval)(S32)(val), (comp[_idx] = (cx[_idx] >> cval) * val), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_comp_asgn_cx_rshft_cval_all_mul_val, (S32 *)(comp)(S32 *)(cx)(const S32)(cval)(S32)(val), (comp[_idx] = (cx[_idx] >> cval) * val), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) comp[c] += (cx[c] >> 5) * Cy;
-UNROLL_GEN_TPL(uroll_comp_plusasgn_cx_rshft_cval_all_mul_val, (S32 *)(comp)(S32 *)(cx)(const S32)(cval)(S32)(val), (comp[_idx] += (cx[_idx] >> cval) * val), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_comp_plusasgn_cx_rshft_cval_all_mul_val, (S32 *)(comp)(S32 *)(cx)(const S32)(cval)(S32)(val), (comp[_idx] += (cx[_idx] >> cval) * val), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) comp[c] += pix[c] * info.xapoints[x];
-UNROLL_GEN_TPL(uroll_inp_plusasgn_pix_mul_val, (S32 *)(comp)(const U8 *)(pix)(S32)(val), (comp[_idx] += pix[_idx] * val), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_inp_plusasgn_pix_mul_val, (S32 *)(comp)(const U8 *)(pix)(S32)(val), (comp[_idx] += pix[_idx] * val), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) cx[c] = pix[c] * info.xapoints[x];
-UNROLL_GEN_TPL(uroll_inp_asgn_pix_mul_val, (S32 *)(comp)(const U8 *)(pix)(S32)(val), (comp[_idx] = pix[_idx] * val), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_inp_asgn_pix_mul_val, (S32 *)(comp)(const U8 *)(pix)(S32)(val), (comp[_idx] = pix[_idx] * val), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) comp[c] = ((cx[c] * info.yapoints[y]) + (comp[c] * (256 - info.yapoints[y]))) >> 16;
-UNROLL_GEN_TPL(uroll_comp_asgn_cx_mul_apoint_plus_comp_mul_inv_apoint_allshifted_16_r, (S32 *)(comp)(S32 *)(cx)(S32)(apoint), (comp[_idx] = ((cx[_idx] * apoint) + (comp[_idx] * (256 - apoint))) >> 16), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_comp_asgn_cx_mul_apoint_plus_comp_mul_inv_apoint_allshifted_16_r, (S32 *)(comp)(S32 *)(cx)(S32)(apoint), (comp[_idx] = ((cx[_idx] * apoint) + (comp[_idx] * (256 - apoint))) >> 16), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) comp[c] = (comp[c] + pix[c] * info.yapoints[y]) >> 8;
-UNROLL_GEN_TPL(uroll_comp_asgn_comp_plus_pix_mul_apoint_allshifted_8_r, (S32 *)(comp)(const U8 *)(pix)(S32)(apoint), (comp[_idx] = (comp[_idx] + pix[_idx] * apoint) >> 8), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_comp_asgn_comp_plus_pix_mul_apoint_allshifted_8_r, (S32 *)(comp)(const U8 *)(pix)(S32)(apoint), (comp[_idx] = (comp[_idx] + pix[_idx] * apoint) >> 8), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) comp[c] = ((comp[c]*(256 - info.xapoints[x])) + ((cx[c] * info.xapoints[x]))) >> 12;
-UNROLL_GEN_TPL(uroll_comp_asgn_comp_mul_inv_apoint_plus_cx_mul_apoint_allshifted_12_r, (S32 *)(comp)(S32)(apoint)(S32 *)(cx), (comp[_idx] = ((comp[_idx] * (256-apoint)) + (cx[_idx] * apoint)) >> 12), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_comp_asgn_comp_mul_inv_apoint_plus_cx_mul_apoint_allshifted_12_r, (S32 *)(comp)(S32)(apoint)(S32 *)(cx), (comp[_idx] = ((comp[_idx] * (256-apoint)) + (cx[_idx] * apoint)) >> 12), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) *dptr++ = comp[c]&0xff;
-UNROLL_GEN_TPL(uroll_uref_dptr_inc_asgn_comp_and_ff, (U8 *&)(dptr)(S32 *)(comp), (*dptr++ = comp[_idx]&0xff), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_uref_dptr_inc_asgn_comp_and_ff, (U8 *&)(dptr)(S32 *)(comp), (*dptr++ = comp[_idx]&0xff), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) *dptr++ = (sptr[info.xpoints[x]*ch + c])&0xff;
-UNROLL_GEN_TPL(uroll_uref_dptr_inc_asgn_sptr_apoint_plus_idx_alland_ff, (U8 *&)(dptr)(const U8 *)(sptr)(S32)(apoint), (*dptr++ = sptr[apoint + _idx]&0xff), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_uref_dptr_inc_asgn_sptr_apoint_plus_idx_alland_ff, (U8 *&)(dptr)(const U8 *)(sptr)(S32)(apoint), (*dptr++ = sptr[apoint + _idx]&0xff), UROLL_CHANNELS);
 //example: for(c = 0; c < ch; ++c) *dptr++ = (comp[c]>>10)&0xff;
-UNROLL_GEN_TPL(uroll_uref_dptr_inc_asgn_comp_rshft_cval_and_ff, (U8 *&)(dptr)(S32 *)(comp)(const S32)(cval), (*dptr++ = (comp[_idx]>>cval)&0xff), (1)(3)(4));
+UNROLL_GEN_TPL(uroll_uref_dptr_inc_asgn_comp_rshft_cval_and_ff, (U8 *&)(dptr)(S32 *)(comp)(const S32)(cval), (*dptr++ = (comp[_idx]>>cval)&0xff), UROLL_CHANNELS);
+//..................................................................................
+// The same operations for 4 channels, one channel per S32 lane. pmulld
+// wraps around like the scalar multiplications, so results are identical.
+//..................................................................................
+#if defined(__SSE4_1__)
+namespace
+{
+    inline __m128i load_comp(const S32 *comp) { return _mm_loadu_si128((const __m128i*)comp); }
+    inline void store_comp(S32 *comp, __m128i v) { _mm_storeu_si128((__m128i*)comp, v); }
+    inline __m128i load_pix(const U8 *pix)
+    {
+        S32 v;
+        memcpy(&v, pix, sizeof(v));
+        return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+    }
+    inline __m128i mul_val(__m128i v, S32 val) { return _mm_mullo_epi32(v, _mm_set1_epi32(val)); }
+    inline __m128i shift_right(__m128i v, S32 cval) { return _mm_sra_epi32(v, _mm_cvtsi32_si128(cval)); }
+    inline void store_pix(U8 *&dptr, __m128i v)
+    {
+        // low byte of each lane, i.e. & 0xff
+        const __m128i pack = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        S32 p = _mm_cvtsi128_si32(_mm_shuffle_epi8(v, pack));
+        memcpy(dptr, &p, sizeof(p));
+        dptr += 4;
+    }
+}
+
+template<> struct uroll_zeroze_cx_comp<4> {
+    inline void operator()(S32 *cx, S32 *comp) { store_comp(cx, _mm_setzero_si128()); store_comp(comp, _mm_setzero_si128()); }
+};
+template<> struct uroll_comp_rshftasgn_constval<4> {
+    inline void operator()(S32 *comp, const S32 cval) { store_comp(comp, shift_right(load_comp(comp), cval)); }
+};
+template<> struct uroll_comp_asgn_cx_rshft_cval_all_mul_val<4> {
+    inline void operator()(S32 *comp, S32 *cx, const S32 cval, S32 val) { store_comp(comp, mul_val(shift_right(load_comp(cx), cval), val)); }
+};
+template<> struct uroll_comp_plusasgn_cx_rshft_cval_all_mul_val<4> {
+    inline void operator()(S32 *comp, S32 *cx, const S32 cval, S32 val)
+    {
+        store_comp(comp, _mm_add_epi32(load_comp(comp), mul_val(shift_right(load_comp(cx), cval), val)));
+    }
+};
+template<> struct uroll_inp_plusasgn_pix_mul_val<4> {
+    inline void operator()(S32 *comp, const U8 *pix, S32 val) { store_comp(comp, _mm_add_epi32(load_comp(comp), mul_val(load_pix(pix), val))); }
+};
+template<> struct uroll_inp_asgn_pix_mul_val<4> {
+    inline void operator()(S32 *comp, const U8 *pix, S32 val) { store_comp(comp, mul_val(load_pix(pix), val)); }
+};
+template<> struct uroll_comp_asgn_cx_mul_apoint_plus_comp_mul_inv_apoint_allshifted_16_r<4> {
+    inline void operator()(S32 *comp, S32 *cx, S32 apoint)
+    {
+        store_comp(comp, shift_right(_mm_add_epi32(mul_val(load_comp(cx), apoint), mul_val(load_comp(comp), 256 - apoint)), 16));
+    }
+};
+template<> struct uroll_comp_asgn_comp_plus_pix_mul_apoint_allshifted_8_r<4> {
+    inline void operator()(S32 *comp, const U8 *pix, S32 apoint)
+    {
+        store_comp(comp, shift_right(_mm_add_epi32(load_comp(comp), mul_val(load_pix(pix), apoint)), 8));
+    }
+};
+template<> struct uroll_comp_asgn_comp_mul_inv_apoint_plus_cx_mul_apoint_allshifted_12_r<4> {
+    inline void operator()(S32 *comp, S32 apoint, S32 *cx)
+    {
+        store_comp(comp, shift_right(_mm_add_epi32(mul_val(load_comp(comp), 256 - apoint), mul_val(load_comp(cx), apoint)), 12));
+    }
+};
+template<> struct uroll_uref_dptr_inc_asgn_comp_and_ff<4> {
+    inline void operator()(U8 *&dptr, S32 *comp) { store_pix(dptr, load_comp(comp)); }
+};
+template<> struct uroll_uref_dptr_inc_asgn_sptr_apoint_plus_idx_alland_ff<4> {
+    inline void operator()(U8 *&dptr, const U8 *sptr, S32 apoint) { memcpy(dptr, sptr + apoint, 4); dptr += 4; }
+};
+template<> struct uroll_uref_dptr_inc_asgn_comp_rshft_cval_and_ff<4> {
+    inline void operator()(U8 *&dptr, S32 *comp, const S32 cval) { store_pix(dptr, shift_right(load_comp(comp), cval)); }
+};
+#endif
 //..................................................................................
 
 
@@ -1248,30 +1334,7 @@ void LLImageRaw::compositeUnscaled4onto3( LLImageRaw* src )
         return;
     }
 
-    while( pixels-- )
-    {
-        U8 alpha = src_data[3];
-        if( alpha )
-        {
-            if( 255 == alpha )
-            {
-                dst_data[0] = src_data[0];
-                dst_data[1] = src_data[1];
-                dst_data[2] = src_data[2];
-            }
-            else
-            {
-
-                U8 transparency = 255 - alpha;
-                dst_data[0] = fastFractionalMult( dst_data[0], transparency ) + fastFractionalMult( src_data[0], alpha );
-                dst_data[1] = fastFractionalMult( dst_data[1], transparency ) + fastFractionalMult( src_data[1], alpha );
-                dst_data[2] = fastFractionalMult( dst_data[2], transparency ) + fastFractionalMult( src_data[2], alpha );
-            }
-        }
-
-        src_data += 4;
-        dst_data += 3;
-    }
+    ll_composite_rgba_onto_rgb(src_data, dst_data, pixels);
 }
 
 
@@ -1439,7 +1502,7 @@ void LLImageRaw::copyScaled3onto4(LLImageRaw* src)
 {
     llassert( (3 == src->getComponents()) && (4 == getComponents()) );
 
-    // Slow, but simple.  Optimize later if needed.
+    // Converted first, as the 4 channel scaling is the vectorized one
     LLImageRaw temp( src->getWidth(), src->getHeight(), 4);
     temp.copyUnscaled3onto4( src );
     copyScaled( &temp );
@@ -1451,10 +1514,11 @@ void LLImageRaw::copyScaled4onto3(LLImageRaw* src)
 {
     llassert( (4 == src->getComponents()) && (3 == getComponents()) );
 
-    // Slow, but simple.  Optimize later if needed.
-    LLImageRaw temp( src->getWidth(), src->getHeight(), 3);
-    temp.copyUnscaled4onto3( src );
-    copyScaled( &temp );
+    // Channels are scaled independently, so scaling first gives the same
+    // result with less to convert when shrinking
+    LLImageRaw temp( getWidth(), getHeight(), 4);
+    temp.copyScaled( src );
+    copyUnscaled4onto3( &temp );
 }
 
 
@@ -1466,17 +1530,7 @@ void LLImageRaw::copyUnscaled4onto3( LLImageRaw* src )
     llassert( (3 == dst->getComponents()) && (4 == src->getComponents()) );
     llassert( (src->getWidth() == dst->getWidth()) && (src->getHeight() == dst->getHeight()) );
 
-    S32 pixels = getWidth() * getHeight();
-    U8* src_data = src->getData();
-    U8* dst_data = dst->getData();
-    for( S32 i=0; i<pixels; i++ )
-    {
-        dst_data[0] = src_data[0];
-        dst_data[1] = src_data[1];
-        dst_data[2] = src_data[2];
-        src_data += 4;
-        dst_data += 3;
-    }
+    ll_rgba_to_rgb(src->getData(), dst->getData(), getWidth() * getHeight());
 }
 
 
@@ -1488,18 +1542,7 @@ void LLImageRaw::copyUnscaled3onto4( LLImageRaw* src )
     llassert( 4 == dst->getComponents() );
     llassert( (src->getWidth() == dst->getWidth()) && (src->getHeight() == dst->getHeight()) );
 
-    S32 pixels = getWidth() * getHeight();
-    U8* src_data = src->getData();
-    U8* dst_data = dst->getData();
-    for( S32 i=0; i<pixels; i++ )
-    {
-        dst_data[0] = src_data[0];
-        dst_data[1] = src_data[1];
-        dst_data[2] = src_data[2];
-        dst_data[3] = 255;
-        src_data += 3;
-        dst_data += 4;
-    }
+    ll_rgb_to_rgba(src->getData(), dst->getData(), getWidth() * getHeight());
 }
 
 
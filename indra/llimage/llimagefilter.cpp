@@ -35,6 +35,13 @@
 #include "v3math.h"
 #include "llsdserialize.h"
 #include "llstring.h"
+#include "llcond.h"
+#include "threadpool.h"
+
+// Bands smaller than this are not worth handing to another thread
+static const S32 MIN_BAND_ROWS = 64;
+
+static std::unique_ptr<LL::ThreadPool> sThreadPool;
 
 //---------------------------------------------------------------------------
 // LLImageFilter
@@ -46,12 +53,7 @@ LLImageFilter::LLImageFilter(const std::string& file_path) :
     mHistoRed(NULL),
     mHistoGreen(NULL),
     mHistoBlue(NULL),
-    mHistoBrightness(NULL),
-    mStencilBlendMode(STENCIL_BLEND_MODE_BLEND),
-    mStencilShape(STENCIL_SHAPE_UNIFORM),
-    mStencilGamma(1.0),
-    mStencilMin(0.0),
-    mStencilMax(1.0)
+    mHistoBrightness(NULL)
 {
     // Load filter description from file
     llifstream filter_xml(file_path.c_str());
@@ -64,6 +66,16 @@ LLImageFilter::LLImageFilter(const std::string& file_path) :
     }
 }
 
+LLImageFilter::LLImageFilter(const LLSD& filter_data) :
+    mFilterData(filter_data),
+    mImage(NULL),
+    mHistoRed(NULL),
+    mHistoGreen(NULL),
+    mHistoBlue(NULL),
+    mHistoBrightness(NULL)
+{
+}
+
 LLImageFilter::~LLImageFilter()
 {
     mImage = NULL;
@@ -73,6 +85,26 @@ LLImageFilter::~LLImageFilter()
     ll_aligned_free_16(mHistoBrightness);
 }
 
+//static
+void LLImageFilter::initClass(size_t threads)
+{
+    if (!sThreadPool)
+    {
+        sThreadPool = std::make_unique<LL::ThreadPool>("ImageFilter", threads);
+        sThreadPool->start();
+    }
+}
+
+//static
+void LLImageFilter::cleanupClass()
+{
+    if (sThreadPool)
+    {
+        sThreadPool->close();
+        sThreadPool.reset();
+    }
+}
+
 /*
  *TODO
  * Rename stencil to mask
@@ -86,6 +118,7 @@ LLImageFilter::~LLImageFilter()
 
 void LLImageFilter::executeFilter(LLPointer<LLImageRaw> raw_image)
 {
+    LL_PROFILE_ZONE_SCOPED;
     mImage = raw_image;
 
     //std::cout << "Filter : size = " << mFilterData.size() << std::endl;
@@ -269,16 +302,19 @@ void LLImageFilter::executeFilter(LLPointer<LLImageRaw> raw_image)
             LL_WARNS() << "Filter unknown, cannot execute filter command : " << filter_name << LL_ENDL;
         }
     }
+
+    // Apply whatever is left queued
+    flushPixelPasses();
 }
 
 //============================================================================
 // Filter Primitives
 //============================================================================
 
-void LLImageFilter::blendStencil(F32 alpha, U8* pixel, U8 red, U8 green, U8 blue)
+void LLImageFilter::Stencil::blend(F32 alpha, U8* pixel, U8 red, U8 green, U8 blue) const
 {
     F32 inv_alpha = 1.0 - alpha;
-    switch (mStencilBlendMode)
+    switch (mBlendMode)
     {
         case STENCIL_BLEND_MODE_BLEND:
             // Classic blend of incoming color with the background image
@@ -309,51 +345,138 @@ void LLImageFilter::blendStencil(F32 alpha, U8* pixel, U8 red, U8 green, U8 blue
 
 void LLImageFilter::colorCorrect(const U8* lut_red, const U8* lut_green, const U8* lut_blue)
 {
-    const S32 components = mImage->getComponents();
-    llassert( components >= 1 && components <= 4 );
+    PixelPass pass;
+    pass.mType = PASS_CORRECT;
+    pass.mStencil = mStencil;
+    memcpy(pass.mLUT[VRED], lut_red, 256);      /* Flawfinder: ignore */
+    memcpy(pass.mLUT[VGREEN], lut_green, 256);  /* Flawfinder: ignore */
+    memcpy(pass.mLUT[VBLUE], lut_blue, 256);    /* Flawfinder: ignore */
+    mPixelPasses.push_back(pass);
+}
 
-    S32 width  = mImage->getWidth();
-    S32 height = mImage->getHeight();
+void LLImageFilter::colorTransform(const LLMatrix3 &transform)
+{
+    PixelPass pass;
+    pass.mType = PASS_TRANSFORM;
+    pass.mStencil = mStencil;
+    pass.mTransform = transform;
+    mPixelPasses.push_back(pass);
+}
+
+void LLImageFilter::filterScreen(EScreenMode mode, const F32 wave_length, const F32 angle)
+{
+    PixelPass pass;
+    pass.mType = PASS_SCREEN;
+    pass.mStencil = mStencil;
+    pass.mScreenMode = mode;
+    pass.mWaveLength = wave_length * (F32)(mImage->getHeight()) / 2.0;
+    pass.mSine = sinf(angle*DEG_TO_RAD);
+    pass.mCosine = cosf(angle*DEG_TO_RAD);
 
-    U8* dst_data = mImage->getData();
-    for (S32 j = 0; j < height; j++)
+    // Precompute the gamma table : gives us the gray level to use when cutting outside the screen (prevents strong aliasing on the screen)
+    for (S32 i = 0; i < 256; i++)
     {
-        for (S32 i = 0; i < width; i++)
-        {
-            // Blend LUT value
-            blendStencil(getStencilAlpha(i,j), dst_data, lut_red[dst_data[VRED]], lut_green[dst_data[VGREEN]], lut_blue[dst_data[VBLUE]]);
-            dst_data += components;
-        }
+        F32 gamma_i = llclampf((float)(powf((float)(i)/255.0,1.0/4.0)));
+        pass.mLUT[0][i] = (U8)(255.0 * gamma_i);
     }
+    mPixelPasses.push_back(pass);
 }
 
-void LLImageFilter::colorTransform(const LLMatrix3 &transform)
+void LLImageFilter::applyPixelPass(const PixelPass& pass, U8* dst_data, S32 j) const
 {
     const S32 components = mImage->getComponents();
-    llassert( components >= 1 && components <= 4 );
+    const S32 width = mImage->getWidth();
+    // Local copies, the compiler cannot tell the pixel stores leave them alone
+    const Stencil stencil = pass.mStencil;
+    const LLMatrix3 transform = pass.mTransform;
 
-    S32 width  = mImage->getWidth();
-    S32 height = mImage->getHeight();
+    switch (pass.mType)
+    {
+        case PASS_TRANSFORM:
+            for (S32 i = 0; i < width; i++)
+            {
+                // Compute transform
+                LLVector3 src((F32)(dst_data[VRED]),(F32)(dst_data[VGREEN]),(F32)(dst_data[VBLUE]));
+                LLVector3 dst = src * transform;
+                dst.clamp(0.0f,255.0f);
+
+                // Blend result
+                stencil.blend(stencil.getAlpha(i,j), dst_data, dst.mV[VRED], dst.mV[VGREEN], dst.mV[VBLUE]);
+                dst_data += components;
+            }
+            break;
+        case PASS_CORRECT:
+            for (S32 i = 0; i < width; i++)
+            {
+                // Blend LUT value
+                stencil.blend(stencil.getAlpha(i,j), dst_data, pass.mLUT[VRED][dst_data[VRED]], pass.mLUT[VGREEN][dst_data[VGREEN]], pass.mLUT[VBLUE][dst_data[VBLUE]]);
+                dst_data += components;
+            }
+            break;
+        case PASS_SCREEN:
+            for (S32 i = 0; i < width; i++)
+            {
+                // Compute screen value
+                F32 value = 0.0;
+                F32 di = 0.0;
+                F32 dj = 0.0;
+                switch (pass.mScreenMode)
+                {
+                    case SCREEN_MODE_2DSINE:
+                        di =  pass.mCosine*i + pass.mSine*j;
+                        dj = -pass.mSine*i + pass.mCosine*j;
+                        value = (sinf(2*F_PI*di/pass.mWaveLength)*sinf(2*F_PI*dj/pass.mWaveLength)+1.0)*255.0/2.0;
+                        break;
+                    case SCREEN_MODE_LINE:
+                        dj = pass.mSine*i - pass.mCosine*j;
+                        value = (sinf(2*F_PI*dj/pass.mWaveLength)+1.0)*255.0/2.0;
+                        break;
+                }
+                U8 dst_value = (dst_data[VRED] >= (U8)(value) ? pass.mLUT[0][dst_data[VRED] - (U8)(value)] : 0);
+
+                // Blend result
+                stencil.blend(stencil.getAlpha(i,j), dst_data, dst_value, dst_value, dst_value);
+                dst_data += components;
+            }
+            break;
+    }
+}
 
-    U8* dst_data = mImage->getData();
-    for (S32 j = 0; j < height; j++)
+void LLImageFilter::flushPixelPasses()
+{
+    if (mPixelPasses.empty())
     {
-        for (S32 i = 0; i < width; i++)
-        {
-            // Compute transform
-            LLVector3 src((F32)(dst_data[VRED]),(F32)(dst_data[VGREEN]),(F32)(dst_data[VBLUE]));
-            LLVector3 dst = src * transform;
-            dst.clamp(0.0f,255.0f);
+        return;
+    }
+    LL_PROFILE_ZONE_SCOPED;
 
-            // Blend result
-            blendStencil(getStencilAlpha(i,j), dst_data, dst.mV[VRED], dst.mV[VGREEN], dst.mV[VBLUE]);
-            dst_data += components;
+    const S32 components = mImage->getComponents();
+    llassert( components >= 1 && components <= 4 );
+    const S32 row_size = mImage->getWidth() * components;
+    U8* data = mImage->getData();
+
+    // Each row goes through all the passes while it is in cache
+    processBands(splitRows(mImage->getHeight()), [&](size_t, S32 first, S32 end)
+    {
+        for (S32 j = first; j < end; j++)
+        {
+            U8* row = data + (size_t)j * row_size;
+            for (const PixelPass& pass : mPixelPasses)
+            {
+                applyPixelPass(pass, row, j);
+            }
         }
-    }
+    });
+
+    mPixelPasses.clear();
 }
 
 void LLImageFilter::convolve(const LLMatrix3 &kernel, bool normalize, bool abs_value)
 {
+    // Neighbouring pixels must have gone through the queued filters
+    flushPixelPasses();
+    LL_PROFILE_ZONE_SCOPED;
+
     const S32 components = mImage->getComponents();
     llassert( components >= 1 && components <= 4 );
 
@@ -379,164 +502,173 @@ void LLImageFilter::convolve(const LLMatrix3 &kernel, bool normalize, bool abs_v
     }
     F32 kernel_range = kernel_max - kernel_min;
 
-    // Allocate temporary buffers and initialize algorithm's data
     S32 width  = mImage->getWidth();
     S32 height = mImage->getHeight();
+    const Stencil& stencil = mStencil;
 
-    U8* dst_data = mImage->getData();
+    U8* data = mImage->getData();
 
     S32 buffer_size = width * components;
     llassert(buffer_size > 0);
-    std::vector<U8> even_buffer(buffer_size);
-    std::vector<U8> odd_buffer(buffer_size);
-
-    U8* south_data = dst_data + buffer_size;
-    U8* east_west_data;
-    U8* north_data;
 
-    // Line 0 : we set the line to 0 (debatable)
-    memcpy( &even_buffer[0], dst_data, buffer_size );   /* Flawfinder: ignore */
-    for (S32 i = 0; i < width; i++)
+    // Each band buffers its own rows before overwriting them, but the rows
+    // just above and below it belong to its neighbours: save them first
+    const bands_t bands = splitRows(height);
+    std::vector<U8> edges(bands.size() * 2 * buffer_size);
+    for (size_t b = 0; b < bands.size(); ++b)
     {
-        blendStencil(getStencilAlpha(i,0), dst_data, 0, 0, 0);
-        dst_data += components;
-    }
-    south_data += buffer_size;
-
-    // All other lines
-    for (S32 j = 1; j < (height-1); j++)
-    {
-        // We need to buffer 2 lines. We flip north and east-west (current) to avoid moving too much memory around
-        if (j % 2)
+        if (bands[b].first > 0)
         {
-            memcpy( &odd_buffer[0], dst_data, buffer_size );    /* Flawfinder: ignore */
-            east_west_data = &odd_buffer[0];
-            north_data = &even_buffer[0];
+            memcpy(&edges[(b * 2) * buffer_size], data + (size_t)(bands[b].first - 1) * buffer_size, buffer_size);    /* Flawfinder: ignore */
         }
-        else
+        if (bands[b].second < height)
         {
-            memcpy( &even_buffer[0], dst_data, buffer_size );   /* Flawfinder: ignore */
-            east_west_data = &even_buffer[0];
-            north_data = &odd_buffer[0];
+            memcpy(&edges[(b * 2 + 1) * buffer_size], data + (size_t)bands[b].second * buffer_size, buffer_size);    /* Flawfinder: ignore */
         }
-        // First pixel : set to 0
-        blendStencil(getStencilAlpha(0,j), dst_data, 0, 0, 0);
-        dst_data += components;
-        // Set pointers to kernel
-        U8* NW = north_data;
-        U8* N = NW+components;
-        U8* NE = N+components;
-        U8* W = east_west_data;
-        U8* C = W+components;
-        U8* E = C+components;
-        U8* SW = south_data;
-        U8* S = SW+components;
-        U8* SE = S+components;
-        // All other pixels
-        for (S32 i = 1; i < (width-1); i++)
+    }
+
+    processBands(bands, [&](size_t band, S32 first, S32 end)
+    {
+        // We need to buffer 2 lines, the north one and the current one, as we overwrite them
+        std::vector<U8> north_buffer(edges.begin() + (band * 2) * buffer_size, edges.begin() + (band * 2 + 1) * buffer_size);
+        std::vector<U8> east_west_buffer(buffer_size);
+        const U8* south_edge = &edges[(band * 2 + 1) * buffer_size];
+
+        U8* dst_data = data + (size_t)first * buffer_size;
+        for (S32 j = first; j < end; j++)
         {
-            // Compute convolution
-            LLVector3 dst;
-            dst.mV[VRED] = (kernel.mMatrix[0][0]*NW[VRED] + kernel.mMatrix[0][1]*N[VRED] + kernel.mMatrix[0][2]*NE[VRED] +
-                            kernel.mMatrix[1][0]*W[VRED]  + kernel.mMatrix[1][1]*C[VRED] + kernel.mMatrix[1][2]*E[VRED] +
-                            kernel.mMatrix[2][0]*SW[VRED] + kernel.mMatrix[2][1]*S[VRED] + kernel.mMatrix[2][2]*SE[VRED]);
-            dst.mV[VGREEN] = (kernel.mMatrix[0][0]*NW[VGREEN] + kernel.mMatrix[0][1]*N[VGREEN] + kernel.mMatrix[0][2]*NE[VGREEN] +
-                              kernel.mMatrix[1][0]*W[VGREEN]  + kernel.mMatrix[1][1]*C[VGREEN] + kernel.mMatrix[1][2]*E[VGREEN] +
-                              kernel.mMatrix[2][0]*SW[VGREEN] + kernel.mMatrix[2][1]*S[VGREEN] + kernel.mMatrix[2][2]*SE[VGREEN]);
-            dst.mV[VBLUE] = (kernel.mMatrix[0][0]*NW[VBLUE] + kernel.mMatrix[0][1]*N[VBLUE] + kernel.mMatrix[0][2]*NE[VBLUE] +
-                             kernel.mMatrix[1][0]*W[VBLUE]  + kernel.mMatrix[1][1]*C[VBLUE] + kernel.mMatrix[1][2]*E[VBLUE] +
-                             kernel.mMatrix[2][0]*SW[VBLUE] + kernel.mMatrix[2][1]*S[VBLUE] + kernel.mMatrix[2][2]*SE[VBLUE]);
-            if (abs_value)
-            {
-                dst.mV[VRED]   = llabs(dst.mV[VRED]);
-                dst.mV[VGREEN] = llabs(dst.mV[VGREEN]);
-                dst.mV[VBLUE]  = llabs(dst.mV[VBLUE]);
-            }
-            if (normalize)
+            memcpy( &east_west_buffer[0], dst_data, buffer_size );  /* Flawfinder: ignore */
+
+            // First and last lines : we set the line to 0 (debatable)
+            if (j == 0 || j == height - 1)
             {
-                dst.mV[VRED]   = (dst.mV[VRED] - kernel_min)/kernel_range;
-                dst.mV[VGREEN] = (dst.mV[VGREEN] - kernel_min)/kernel_range;
-                dst.mV[VBLUE]  = (dst.mV[VBLUE] - kernel_min)/kernel_range;
+                for (S32 i = 0; i < width; i++)
+                {
+                    stencil.blend(stencil.getAlpha(i,0), dst_data, 0, 0, 0);
+                    dst_data += components;
+                }
+                north_buffer.swap(east_west_buffer);
+                continue;
             }
-            dst.clamp(0.0f,255.0f);
 
-            // Blend result
-            blendStencil(getStencilAlpha(i,j), dst_data, dst.mV[VRED], dst.mV[VGREEN], dst.mV[VBLUE]);
+            const U8* south_data = (j + 1 < end ? dst_data + buffer_size : south_edge);
 
-            // Next pixel
+            // First pixel : set to 0
+            stencil.blend(stencil.getAlpha(0,j), dst_data, 0, 0, 0);
+            dst_data += components;
+            // Set pointers to kernel
+            const U8* NW = &north_buffer[0];
+            const U8* N = NW+components;
+            const U8* NE = N+components;
+            const U8* W = &east_west_buffer[0];
+            const U8* C = W+components;
+            const U8* E = C+components;
+            const U8* SW = south_data;
+            const U8* S = SW+components;
+            const U8* SE = S+components;
+            // All other pixels
+            for (S32 i = 1; i < (width-1); i++)
+            {
+                // Compute convolution
+                LLVector3 dst;
+                dst.mV[VRED] = (kernel.mMatrix[0][0]*NW[VRED] + kernel.mMatrix[0][1]*N[VRED] + kernel.mMatrix[0][2]*NE[VRED] +
+                                kernel.mMatrix[1][0]*W[VRED]  + kernel.mMatrix[1][1]*C[VRED] + kernel.mMatrix[1][2]*E[VRED] +
+                                kernel.mMatrix[2][0]*SW[VRED] + kernel.mMatrix[2][1]*S[VRED] + kernel.mMatrix[2][2]*SE[VRED]);
+                dst.mV[VGREEN] = (kernel.mMatrix[0][0]*NW[VGREEN] + kernel.mMatrix[0][1]*N[VGREEN] + kernel.mMatrix[0][2]*NE[VGREEN] +
+                                  kernel.mMatrix[1][0]*W[VGREEN]  + kernel.mMatrix[1][1]*C[VGREEN] + kernel.mMatrix[1][2]*E[VGREEN] +
+                                  kernel.mMatrix[2][0]*SW[VGREEN] + kernel.mMatrix[2][1]*S[VGREEN] + kernel.mMatrix[2][2]*SE[VGREEN]);
+                dst.mV[VBLUE] = (kernel.mMatrix[0][0]*NW[VBLUE] + kernel.mMatrix[0][1]*N[VBLUE] + kernel.mMatrix[0][2]*NE[VBLUE] +
+                                 kernel.mMatrix[1][0]*W[VBLUE]  + kernel.mMatrix[1][1]*C[VBLUE] + kernel.mMatrix[1][2]*E[VBLUE] +
+                                 kernel.mMatrix[2][0]*SW[VBLUE] + kernel.mMatrix[2][1]*S[VBLUE] + kernel.mMatrix[2][2]*SE[VBLUE]);
+                if (abs_value)
+                {
+                    dst.mV[VRED]   = llabs(dst.mV[VRED]);
+                    dst.mV[VGREEN] = llabs(dst.mV[VGREEN]);
+                    dst.mV[VBLUE]  = llabs(dst.mV[VBLUE]);
+                }
+                if (normalize)
+                {
+                    dst.mV[VRED]   = (dst.mV[VRED] - kernel_min)/kernel_range;
+                    dst.mV[VGREEN] = (dst.mV[VGREEN] - kernel_min)/kernel_range;
+                    dst.mV[VBLUE]  = (dst.mV[VBLUE] - kernel_min)/kernel_range;
+                }
+                dst.clamp(0.0f,255.0f);
+
+                // Blend result
+                stencil.blend(stencil.getAlpha(i,j), dst_data, dst.mV[VRED], dst.mV[VGREEN], dst.mV[VBLUE]);
+
+                // Next pixel
+                dst_data += components;
+                NW += components;
+                N += components;
+                NE += components;
+                W += components;
+                C += components;
+                E += components;
+                SW += components;
+                S += components;
+                SE += components;
+            }
+            // Last pixel : set to 0
+            stencil.blend(stencil.getAlpha(width-1,j), dst_data, 0, 0, 0);
             dst_data += components;
-            NW += components;
-            N += components;
-            NE += components;
-            W += components;
-            C += components;
-            E += components;
-            SW += components;
-            S += components;
-            SE += components;
+
+            // The current line is the north one of the next
+            north_buffer.swap(east_west_buffer);
         }
-        // Last pixel : set to 0
-        blendStencil(getStencilAlpha(width-1,j), dst_data, 0, 0, 0);
-        dst_data += components;
-        south_data += buffer_size;
+    });
+}
+
+//============================================================================
+// Row Bands
+//============================================================================
+
+//static
+LLImageFilter::bands_t LLImageFilter::splitRows(S32 rows)
+{
+    S32 count = 1;
+    if (sThreadPool)
+    {
+        // The calling thread takes a band too
+        count = llclamp(rows / MIN_BAND_ROWS, 1, (S32)sThreadPool->getWidth() + 1);
     }
 
-    // Last line
-    for (S32 i = 0; i < width; i++)
+    bands_t bands;
+    bands.reserve(count);
+    for (S32 i = 0; i < count; i++)
     {
-        blendStencil(getStencilAlpha(i,0), dst_data, 0, 0, 0);
-        dst_data += components;
+        bands.emplace_back(rows * i / count, rows * (i + 1) / count);
     }
+    return bands;
 }
 
-void LLImageFilter::filterScreen(EScreenMode mode, const F32 wave_length, const F32 angle)
+//static
+void LLImageFilter::processBands(const bands_t& bands, const band_func_t& func)
 {
-    const S32 components = mImage->getComponents();
-    llassert( components >= 1 && components <= 4 );
-
-    S32 width  = mImage->getWidth();
-    S32 height = mImage->getHeight();
-
-    F32 wave_length_pixels = wave_length * (F32)(height) / 2.0;
-    F32 sin = sinf(angle*DEG_TO_RAD);
-    F32 cos = cosf(angle*DEG_TO_RAD);
-
-    // Precompute the gamma table : gives us the gray level to use when cutting outside the screen (prevents strong aliasing on the screen)
-    U8 gamma[256];
-    for (S32 i = 0; i < 256; i++)
+    if (bands.empty())
     {
-        F32 gamma_i = llclampf((float)(powf((float)(i)/255.0,1.0/4.0)));
-        gamma[i] = (U8)(255.0 * gamma_i);
+        return;
     }
 
-    U8* dst_data = mImage->getData();
-    for (S32 j = 0; j < height; j++)
+    // Shared with the workers, which may still be notifying it when we return
+    auto remaining = std::make_shared<LLScalarCond<size_t> >(bands.size() - 1);
+    for (size_t b = 1; b < bands.size(); b++)
     {
-        for (S32 i = 0; i < width; i++)
+        auto work = [&bands, &func, remaining, b]()
         {
-            // Compute screen value
-            F32 value = 0.0;
-            F32 di = 0.0;
-            F32 dj = 0.0;
-            switch (mode)
-            {
-                case SCREEN_MODE_2DSINE:
-                    di =  cos*i + sin*j;
-                    dj = -sin*i + cos*j;
-                    value = (sinf(2*F_PI*di/wave_length_pixels)*sinf(2*F_PI*dj/wave_length_pixels)+1.0)*255.0/2.0;
-                    break;
-                case SCREEN_MODE_LINE:
-                    dj = sin*i - cos*j;
-                    value = (sinf(2*F_PI*dj/wave_length_pixels)+1.0)*255.0/2.0;
-                    break;
-            }
-            U8 dst_value = (dst_data[VRED] >= (U8)(value) ? gamma[dst_data[VRED] - (U8)(value)] : 0);
-
-            // Blend result
-            blendStencil(getStencilAlpha(i,j), dst_data, dst_value, dst_value, dst_value);
-            dst_data += components;
+            LL_PROFILE_ZONE_NAMED("LLImageFilter band");
+            func(b, bands[b].first, bands[b].second);
+            remaining->update_all([](size_t& count) { --count; });
+        };
+        if (!sThreadPool || !sThreadPool->getQueue().post(work))
+        {
+            // Shutting down, do it ourselves
+            work();
         }
     }
+
+    func(0, bands[0].first, bands[0].second);
+    remaining->wait_equal(0);
 }
 
 //============================================================================
@@ -544,55 +676,55 @@ void LLImageFilter::filterScreen(EScreenMode mode, const F32 wave_length, const
 //============================================================================
 void LLImageFilter::setStencil(EStencilShape shape, EStencilBlendMode mode, F32 min, F32 max, F32* params)
 {
-    mStencilShape = shape;
-    mStencilBlendMode = mode;
-    mStencilMin = llmin(llmax(min, -1.0f), 1.0f);
-    mStencilMax = llmin(llmax(max, -1.0f), 1.0f);
+    mStencil.mShape = shape;
+    mStencil.mBlendMode = mode;
+    mStencil.mMin = llmin(llmax(min, -1.0f), 1.0f);
+    mStencil.mMax = llmin(llmax(max, -1.0f), 1.0f);
 
     // Each shape will interpret the 4 params differenly.
     // We compute each systematically, though, clearly, values are meaningless when the shape doesn't correspond to the parameters
-    mStencilCenterX = (S32)(mImage->getWidth()  + params[0] * (F32)(mImage->getHeight()))/2;
-    mStencilCenterY = (S32)(mImage->getHeight() + params[1] * (F32)(mImage->getHeight()))/2;
-    mStencilWidth = (S32)(params[2] * (F32)(mImage->getHeight()))/2;
-    mStencilGamma = (params[3] <= 0.0 ? 1.0 : params[3]);
-
-    mStencilWavelength = (params[0] <= 0.0 ? 10.0 : params[0] * (F32)(mImage->getHeight()) / 2.0);
-    mStencilSine   = sinf(params[1]*DEG_TO_RAD);
-    mStencilCosine = cosf(params[1]*DEG_TO_RAD);
-
-    mStencilStartX = ((F32)(mImage->getWidth())  + params[0] * (F32)(mImage->getHeight()))/2.0;
-    mStencilStartY = ((F32)(mImage->getHeight()) + params[1] * (F32)(mImage->getHeight()))/2.0;
-    F32 end_x      = ((F32)(mImage->getWidth())  + params[2] * (F32)(mImage->getHeight()))/2.0;
-    F32 end_y      = ((F32)(mImage->getHeight()) + params[3] * (F32)(mImage->getHeight()))/2.0;
-    mStencilGradX  = end_x - mStencilStartX;
-    mStencilGradY  = end_y - mStencilStartY;
-    mStencilGradN  = mStencilGradX*mStencilGradX + mStencilGradY*mStencilGradY;
+    mStencil.mCenterX = (S32)(mImage->getWidth()  + params[0] * (F32)(mImage->getHeight()))/2;
+    mStencil.mCenterY = (S32)(mImage->getHeight() + params[1] * (F32)(mImage->getHeight()))/2;
+    mStencil.mWidth = (S32)(params[2] * (F32)(mImage->getHeight()))/2;
+    mStencil.mGamma = (params[3] <= 0.0 ? 1.0 : params[3]);
+
+    mStencil.mWavelength = (params[0] <= 0.0 ? 10.0 : params[0] * (F32)(mImage->getHeight()) / 2.0);
+    mStencil.mSine   = sinf(params[1]*DEG_TO_RAD);
+    mStencil.mCosine = cosf(params[1]*DEG_TO_RAD);
+
+    mStencil.mStartX = ((F32)(mImage->getWidth())  + params[0] * (F32)(mImage->getHeight()))/2.0;
+    mStencil.mStartY = ((F32)(mImage->getHeight()) + params[1] * (F32)(mImage->getHeight()))/2.0;
+    F32 end_x        = ((F32)(mImage->getWidth())  + params[2] * (F32)(mImage->getHeight()))/2.0;
+    F32 end_y        = ((F32)(mImage->getHeight()) + params[3] * (F32)(mImage->getHeight()))/2.0;
+    mStencil.mGradX  = end_x - mStencil.mStartX;
+    mStencil.mGradY  = end_y - mStencil.mStartY;
+    mStencil.mGradN  = mStencil.mGradX*mStencil.mGradX + mStencil.mGradY*mStencil.mGradY;
 }
 
-F32 LLImageFilter::getStencilAlpha(S32 i, S32 j)
+F32 LLImageFilter::Stencil::getAlpha(S32 i, S32 j) const
 {
     F32 alpha = 1.0;    // That init actually takes care of the STENCIL_SHAPE_UNIFORM case...
-    if (mStencilShape == STENCIL_SHAPE_VIGNETTE)
+    if (mShape == STENCIL_SHAPE_VIGNETTE)
     {
         // alpha is a modified gaussian value, with a center and fading in a circular pattern toward the edges
         // The gamma parameter controls the intensity of the drop down from alpha 1.0 (center) to 0.0
-        F32 d_center_square = (i - mStencilCenterX)*(i - mStencilCenterX) + (j - mStencilCenterY)*(j - mStencilCenterY);
-        alpha = powf(F_E, -(powf((d_center_square/(mStencilWidth*mStencilWidth)),mStencilGamma)/2.0f));
+        F32 d_center_square = (i - mCenterX)*(i - mCenterX) + (j - mCenterY)*(j - mCenterY);
+        alpha = powf(F_E, -(powf((d_center_square/(mWidth*mWidth)),mGamma)/2.0f));
     }
-    else if (mStencilShape == STENCIL_SHAPE_SCAN_LINES)
+    else if (mShape == STENCIL_SHAPE_SCAN_LINES)
     {
         // alpha varies according to a squared sine function.
-        F32 d = mStencilSine*i - mStencilCosine*j;
-        alpha = (sinf(2*F_PI*d/mStencilWavelength) > 0.0 ? 1.0 : 0.0);
+        F32 d = mSine*i - mCosine*j;
+        alpha = (sinf(2*F_PI*d/mWavelength) > 0.0 ? 1.0 : 0.0);
     }
-    else if (mStencilShape == STENCIL_SHAPE_GRADIENT)
+    else if (mShape == STENCIL_SHAPE_GRADIENT)
     {
-        alpha = (((F32)(i) - mStencilStartX)*mStencilGradX + ((F32)(j) - mStencilStartY)*mStencilGradY) / mStencilGradN;
+        alpha = (((F32)(i) - mStartX)*mGradX + ((F32)(j) - mStartY)*mGradY) / mGradN;
         alpha = llclampf(alpha);
     }
 
     // We rescale alpha between min and max
-    return (mStencilMin + alpha * (mStencilMax - mStencilMin));
+    return (mMin + alpha * (mMax - mMin));
 }
 
 //============================================================================
@@ -610,6 +742,10 @@ U32* LLImageFilter::getBrightnessHistogram()
 
 void LLImageFilter::computeHistograms()
 {
+    // Count the pixels as the queued filters leave them
+    flushPixelPasses();
+    LL_PROFILE_ZONE_SCOPED;
+
     const S32 components = mImage->getComponents();
     llassert( components >= 1 && components <= 4 );
 
@@ -640,19 +776,43 @@ void LLImageFilter::computeHistograms()
         mHistoBrightness[i] = 0;
     }
 
-    // Compute them
-    S32 pixels = mImage->getWidth() * mImage->getHeight();
-    U8* dst_data = mImage->getData();
-    for (S32 i = 0; i < pixels; i++)
+    // Compute them, each band in its own histograms which are summed up after
+    const S32 width = mImage->getWidth();
+    const U8* data = mImage->getData();
+    const bands_t bands = splitRows(mImage->getHeight());
+    std::vector<U32> band_histos(bands.size() * 4 * 256, 0);
+    processBands(bands, [&](size_t band, S32 first, S32 end)
+    {
+        U32* histo_red = &band_histos[band * 4 * 256];
+        U32* histo_green = histo_red + 256;
+        U32* histo_blue = histo_green + 256;
+        U32* histo_brightness = histo_blue + 256;
+
+        S32 pixels = (end - first) * width;
+        const U8* dst_data = data + (size_t)first * width * components;
+        for (S32 i = 0; i < pixels; i++)
+        {
+            histo_red[dst_data[VRED]]++;
+            histo_green[dst_data[VGREEN]]++;
+            histo_blue[dst_data[VBLUE]]++;
+            // Note: this is a very simple shorthand for brightness but it's OK for our use
+            S32 brightness = ((S32)(dst_data[VRED]) + (S32)(dst_data[VGREEN]) + (S32)(dst_data[VBLUE])) / 3;
+            histo_brightness[brightness]++;
+            // next pixel...
+            dst_data += components;
+        }
+    });
+
+    for (size_t band = 0; band < bands.size(); band++)
     {
-        mHistoRed[dst_data[VRED]]++;
-        mHistoGreen[dst_data[VGREEN]]++;
-        mHistoBlue[dst_data[VBLUE]]++;
-        // Note: this is a very simple shorthand for brightness but it's OK for our use
-        S32 brightness = ((S32)(dst_data[VRED]) + (S32)(dst_data[VGREEN]) + (S32)(dst_data[VBLUE])) / 3;
-        mHistoBrightness[brightness]++;
-        // next pixel...
-        dst_data += components;
+        const U32* histos = &band_histos[band * 4 * 256];
+        for (S32 i = 0; i < 256; i++)
+        {
+            mHistoRed[i] += histos[i];
+            mHistoGreen[i] += histos[256 + i];
+            mHistoBlue[i] += histos[512 + i];
+            mHistoBrightness[i] += histos[768 + i];
+        }
     }
 }
 
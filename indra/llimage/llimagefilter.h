@@ -29,6 +29,10 @@
 
 #include "llsd.h"
 #include "llimage.h"
+#include "m3math.h"
+
+#include <functional>
+#include <vector>
 
 class LLImageRaw;
 class LLColor4U;
@@ -59,16 +63,29 @@ typedef enum e_screen_mode
 
 //============================================================================
 // LLImageFilter
+//
+// Consecutive per-pixel filters (color transforms, color corrections and
+// screens) are queued and applied in a single pass over the image, which is
+// split in bands of rows processed on the "ImageFilter" thread pool when it
+// has been started with initClass(). Filters needing the whole image
+// (convolutions, histograms) apply the queued ones first.
 //============================================================================
 
 class LLImageFilter
 {
 public:
     LLImageFilter(const std::string& file_path);
+    explicit LLImageFilter(const LLSD& filter_data);
     ~LLImageFilter();
 
     void executeFilter(LLPointer<LLImageRaw> raw_image);
 
+    // Start and stop the worker threads. threads is the default width of
+    // the pool, the "ImageFilter" entry of ThreadPoolSizes overrides it.
+    // Without them, filters run on the calling thread.
+    static void initClass(size_t threads);
+    static void cleanupClass();
+
 private:
     // Filter Operations : Transforms
     void filterGrayScale();                         // Convert to grayscale
@@ -87,21 +104,77 @@ class LLImageFilter
     void filterContrast(F32 slope, const LLColor3& alpha);      // Change contrast according to slope: > 1.0 more contrast, < 1.0 less contrast
     void filterBrightness(F32 add, const LLColor3& alpha);      // Change brightness according to add: > 0 brighter, < 0 darker
 
+    // Procedural Stencil Settings
+    struct Stencil
+    {
+        F32 getAlpha(S32 i, S32 j) const;
+        void blend(F32 alpha, U8* pixel, U8 red, U8 green, U8 blue) const;
+
+        EStencilBlendMode mBlendMode = STENCIL_BLEND_MODE_BLEND;
+        EStencilShape mShape = STENCIL_SHAPE_UNIFORM;
+        F32 mMin = 0.0f;
+        F32 mMax = 1.0f;
+
+        S32 mCenterX = 0;
+        S32 mCenterY = 0;
+        S32 mWidth = 0;
+        F32 mGamma = 1.0f;
+
+        F32 mWavelength = 10.0f;
+        F32 mSine = 0.0f;
+        F32 mCosine = 1.0f;
+
+        F32 mStartX = 0.0f;
+        F32 mStartY = 0.0f;
+        F32 mGradX = 0.0f;
+        F32 mGradY = 0.0f;
+        F32 mGradN = 1.0f;
+    };
+
+    // Per-pixel filter waiting to be applied, with the stencil that was
+    // current when it was queued
+    enum EPixelPass
+    {
+        PASS_TRANSFORM,
+        PASS_CORRECT,
+        PASS_SCREEN
+    };
+
+    struct PixelPass
+    {
+        EPixelPass mType;
+        Stencil mStencil;
+        LLMatrix3 mTransform;
+        U8 mLUT[3][256];            // Color correction, or the screen gamma in mLUT[0]
+        EScreenMode mScreenMode;
+        F32 mWaveLength;            // Screen wave length, in pixels
+        F32 mSine;
+        F32 mCosine;
+    };
+
     // Filter Primitives
     void colorTransform(const LLMatrix3 &transform);
     void colorCorrect(const U8* lut_red, const U8* lut_green, const U8* lut_blue);
     void filterScreen(EScreenMode mode, const F32 wave_length, const F32 angle);
-    void blendStencil(F32 alpha, U8* pixel, U8 red, U8 green, U8 blue);
     void convolve(const LLMatrix3 &kernel, bool normalize, bool abs_value);
 
+    // Apply the queued per-pixel filters
+    void flushPixelPasses();
+    void applyPixelPass(const PixelPass& pass, U8* row, S32 j) const;
+
     // Procedural Stencils
     void setStencil(EStencilShape shape, EStencilBlendMode mode, F32 min, F32 max, F32* params);
-    F32 getStencilAlpha(S32 i, S32 j);
 
     // Histograms
     U32* getBrightnessHistogram();
     void computeHistograms();
 
+    // Row bands, [first, end) and their processing, on the thread pool if any
+    typedef std::vector<std::pair<S32, S32> > bands_t;
+    typedef std::function<void(size_t band, S32 first, S32 end)> band_func_t;
+    static bands_t splitRows(S32 rows);
+    static void processBands(const bands_t& bands, const band_func_t& func);
+
     LLSD mFilterData;
     LLPointer<LLImageRaw> mImage;
 
@@ -112,25 +185,9 @@ class LLImageFilter
     U32 *mHistoBrightness;
 
     // Current Stencil Settings
-    EStencilBlendMode mStencilBlendMode;
-    EStencilShape mStencilShape;
-    F32 mStencilMin;
-    F32 mStencilMax;
-
-    S32 mStencilCenterX;
-    S32 mStencilCenterY;
-    S32 mStencilWidth;
-    F32 mStencilGamma;
-
-    F32 mStencilWavelength;
-    F32 mStencilSine;
-    F32 mStencilCosine;
-
-    F32 mStencilStartX;
-    F32 mStencilStartY;
-    F32 mStencilGradX;
-    F32 mStencilGradY;
-    F32 mStencilGradN;
+    Stencil mStencil;
+
+    std::vector<PixelPass> mPixelPasses;
 };
 
 
@@ -42,6 +42,11 @@ LLImageJ2CImpl* fallbackCreateLLImageJ2CImpl();
 LLImageCompressionTester* LLImageJ2C::sTesterp = NULL ;
 const std::string sTesterName("ImageCompressionTester");
 
+S32 LLImageJ2C::sDecodeThreads = 1;
+S32 LLImageJ2C::sThreadedDecodeArea = LLImageJ2C::DEFAULT_THREADED_DECODE_AREA;
+S32 LLImageJ2C::sMaxExtraDecodeThreads = -1;
+std::atomic<S32> LLImageJ2C::sExtraDecodeThreads(0);
+
 //static
 std::string LLImageJ2C::getEngineInfo()
 {
@@ -51,6 +56,49 @@ std::string LLImageJ2C::getEngineInfo()
     return impl->getEngineInfo();
 }
 
+//static
+void LLImageJ2C::setDecodeThreads(S32 threads, S32 min_area, S32 max_extra_threads)
+{
+    sDecodeThreads = llmax(threads, 1);
+    sThreadedDecodeArea = llmax(min_area, 0);
+    sMaxExtraDecodeThreads = max_extra_threads;
+}
+
+//static
+S32 LLImageJ2C::reserveDecodeThreads(S32 wanted)
+{
+    if (wanted <= 0)
+    {
+        return 0;
+    }
+    if (sMaxExtraDecodeThreads < 0)
+    {
+        sExtraDecodeThreads += wanted;
+        return wanted;
+    }
+
+    S32 in_use = sExtraDecodeThreads.load();
+    S32 granted = 0;
+    do
+    {
+        granted = llmin(wanted, sMaxExtraDecodeThreads - in_use);
+        if (granted <= 0)
+        {
+            return 0;
+        }
+    } while (!sExtraDecodeThreads.compare_exchange_weak(in_use, in_use + granted));
+    return granted;
+}
+
+//static
+void LLImageJ2C::releaseDecodeThreads(S32 count)
+{
+    if (count > 0)
+    {
+        sExtraDecodeThreads -= count;
+    }
+}
+
 LLImageJ2C::LLImageJ2C() :  LLImageFormatted(IMG_CODEC_J2C),
                             mMaxBytes(0),
                             mRawDiscardLevel(-1),
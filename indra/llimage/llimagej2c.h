@@ -31,6 +31,8 @@
 #include "llassettype.h"
 #include "llmetricperformancetester.h"
 
+#include <atomic>
+
 // JPEG2000 : compression rate used in j2c conversion.
 const F32 DEFAULT_COMPRESSION_RATE = 1.f/8.f;
 
@@ -78,6 +80,24 @@ class LLImageJ2C final : public LLImageFormatted
 
     static std::string getEngineInfo();
 
+    static const S32 DEFAULT_THREADED_DECODE_AREA = 512 * 512;
+
+    // Let the decoder spread the decode of a single image over up to threads
+    // worker threads when the decoded area is at least min_area pixels.
+    // Smaller images are always decoded on the calling thread, as starting
+    // the workers would cost more than it saves. 1 (the default) disables.
+    // Images decoded at the same time share a budget of max_extra_threads
+    // threads on top of their calling threads, so that they don't
+    // oversubscribe the cores along with the decode thread pool. A negative
+    // budget is unlimited.
+    static void setDecodeThreads(S32 threads, S32 min_area = DEFAULT_THREADED_DECODE_AREA,
+                                 S32 max_extra_threads = -1);
+
+    // Take up to wanted threads from the budget above, returns how many
+    // were granted. They must be given back once the decode is done.
+    static S32 reserveDecodeThreads(S32 wanted);
+    static void releaseDecodeThreads(S32 count);
+
 protected:
     friend class LLImageJ2CImpl;
     friend class LLImageJ2COJ;
@@ -99,6 +119,11 @@ class LLImageJ2C final : public LLImageFormatted
 
     // Image compression/decompression tester
     static LLImageCompressionTester* sTesterp;
+
+    static S32 sDecodeThreads;
+    static S32 sThreadedDecodeArea;
+    static S32 sMaxExtraDecodeThreads;
+    static std::atomic<S32> sExtraDecodeThreads;
 };
 
 // Derive from this class to implement JPEG2000 decoding
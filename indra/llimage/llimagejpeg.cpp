@@ -31,7 +31,7 @@
 #include "llerror.h"
 #include "llexception.h"
 
-jmp_buf LLImageJPEG::sSetjmpBuffer ;
+thread_local jmp_buf LLImageJPEG::sSetjmpBuffer ;
 LLImageJPEG::LLImageJPEG(S32 quality)
 :   LLImageFormatted(IMG_CODEC_JPEG),
     mOutputBuffer( NULL ),
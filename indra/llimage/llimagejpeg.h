@@ -81,7 +81,7 @@ class LLImageJPEG final : public LLImageFormatted
 
     S32             mEncodeQuality;     // on a scale from 1 to 100
 private:
-    static jmp_buf  sSetjmpBuffer;      // To allow the library to abort.
+    static thread_local jmp_buf sSetjmpBuffer; // To allow the library to abort, per encoding thread.
 };
 
 #endif  // LL_LLIMAGEJPEG_H
@@ -0,0 +1,182 @@
+/**
+ * @file llimagekernels.cpp
+ * @brief SIMD channel conversion and compositing of raw image rows.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llimagekernels.h"
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+#if defined(__SSSE3__)
+    // (x * y + 128 + ((x * y + 128) >> 8)) >> 8, which fits in 16 bits for
+    // 8 bit x and y
+    inline __m128i fractional_mult(__m128i x, __m128i y)
+    {
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+        t = _mm_add_epi16(t, _mm_srli_epi16(t, 8));
+        return _mm_srli_epi16(t, 8);
+    }
+#endif
+
+    // Calculates (U8)(255*(a/255.f)*(b/255.f) + 0.5f).  Thanks, Jim Blinn!
+    inline U8 fractional_mult(U8 a, U8 b)
+    {
+        U32 i = a * b + 128;
+        return U8((i + (i >> 8)) >> 8);
+    }
+}
+
+void ll_rgba_to_rgb(const U8* src, U8* dst, U32 pixels)
+{
+    U32 i = 0;
+
+    // Stores are 16 or 32 bytes wide, the bytes written past the pixels
+    // converted get overwritten by the next ones, so leave enough pixels
+    // for the last store to fit
+#if defined(__AVX2__)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                                 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+        for (; i + 11 <= pixels; i += 8)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+            v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle), pack);
+            _mm256_storeu_si256((__m256i*)(dst + i * 3), v);
+        }
+    }
+#endif
+
+#if defined(__SSSE3__)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        for (; i + 6 <= pixels; i += 4)
+        {
+            const __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            _mm_storeu_si128((__m128i*)(dst + i * 3), _mm_shuffle_epi8(v, shuffle));
+        }
+    }
+#endif
+
+    for (; i < pixels; ++i)
+    {
+        dst[i * 3 + 0] = src[i * 4 + 0];
+        dst[i * 3 + 1] = src[i * 4 + 1];
+        dst[i * 3 + 2] = src[i * 4 + 2];
+    }
+}
+
+void ll_rgb_to_rgba(const U8* src, U8* dst, U32 pixels)
+{
+    U32 i = 0;
+
+    // Loads are 16 bytes wide for 12 bytes used, leave enough pixels for
+    // the last one not to read past the end of src
+#if defined(__AVX2__)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+        for (; i + 10 <= pixels; i += 8)
+        {
+            const __m128i lo = _mm_loadu_si128((const __m128i*)(src + i * 3));
+            const __m128i hi = _mm_loadu_si128((const __m128i*)(src + i * 3 + 12));
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha);
+            _mm256_storeu_si256((__m256i*)(dst + i * 4), v);
+        }
+    }
+#endif
+
+#if defined(__SSSE3__)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(0xFF000000);
+        for (; i + 6 <= pixels; i += 4)
+        {
+            const __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 3));
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+        }
+    }
+#endif
+
+    for (; i < pixels; ++i)
+    {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+void ll_composite_rgba_onto_rgb(const U8* src, U8* dst, U32 pixels)
+{
+    U32 i = 0;
+
+#if defined(__SSSE3__)
+    {
+        // The scalar code special cases alpha 0 and 255, which the blend gives
+        // exactly anyway: fractional_mult(x, 255) == x
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        const __m128i spread_alpha = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+        // The 4 bytes loaded and stored past the pixels blended are left as is
+        const __m128i keep = _mm_setr_epi32(0, 0, 0, -1);
+        for (; i + 6 <= pixels; i += 4)
+        {
+            const __m128i s = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            const __m128i d_raw = _mm_loadu_si128((const __m128i*)(dst + i * 3));
+            const __m128i d = _mm_shuffle_epi8(d_raw, expand);
+            const __m128i a = _mm_shuffle_epi8(s, spread_alpha);
+            const __m128i ia = _mm_xor_si128(a, _mm_set1_epi8(-1));
+
+            const __m128i lo = _mm_add_epi16(fractional_mult(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(ia, zero)),
+                                             fractional_mult(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(a, zero)));
+            const __m128i hi = _mm_add_epi16(fractional_mult(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(ia, zero)),
+                                             fractional_mult(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(a, zero)));
+
+            const __m128i blended = _mm_shuffle_epi8(_mm_packus_epi16(lo, hi), pack);
+            _mm_storeu_si128((__m128i*)(dst + i * 3), _mm_or_si128(blended, _mm_and_si128(d_raw, keep)));
+        }
+    }
+#endif
+
+    for (; i < pixels; ++i)
+    {
+        const U8* s = src + i * 4;
+        U8* d = dst + i * 3;
+        const U8 alpha = s[3];
+        const U8 transparency = 255 - alpha;
+        d[0] = fractional_mult(d[0], transparency) + fractional_mult(s[0], alpha);
+        d[1] = fractional_mult(d[1], transparency) + fractional_mult(s[1], alpha);
+        d[2] = fractional_mult(d[2], transparency) + fractional_mult(s[2], alpha);
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * @file llimagekernels.h
+ * @brief SIMD channel conversion and compositing of raw image rows.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMAGEKERNELS_H
+#define LL_LLIMAGEKERNELS_H
+
+#include "stdtypes.h"
+
+// Tightly packed 8 bit pixels, src and dst must not overlap. The results are
+// bit identical to the scalar loops LLImageRaw used to run. The SSSE3 and
+// AVX2 paths are only compiled in when the build enables those instruction
+// sets, the scalar loops are used otherwise.
+
+// Drop the alpha channel of pixels RGBA pixels.
+void ll_rgba_to_rgb(const U8* src, U8* dst, U32 pixels);
+
+// Add an opaque alpha channel to pixels RGB pixels.
+void ll_rgb_to_rgba(const U8* src, U8* dst, U32 pixels);
+
+// Blend pixels RGBA pixels over RGB ones:
+// dst = dst * (255 - a) / 255 + src * a / 255, each product rounded.
+void ll_composite_rgba_onto_rgb(const U8* src, U8* dst, U32 pixels);
+
+#endif // LL_LLIMAGEKERNELS_H
@@ -33,11 +33,15 @@
 #include "llpngwrapper.h"
 #include "llimagepng.h"
 
+// Images with less raw data are not worth splitting in strips
+static const S32 MIN_STRIPS_DATA_SIZE = 4 * 1024 * 1024;
+
 // ---------------------------------------------------------------------------
 // LLImagePNG
 // ---------------------------------------------------------------------------
 LLImagePNG::LLImagePNG()
-    : LLImageFormatted(IMG_CODEC_PNG)
+    : LLImageFormatted(IMG_CODEC_PNG),
+      mCompressionLevel(-1)
 {
 }
 
@@ -134,6 +138,25 @@ bool LLImagePNG::encode(const LLImageRaw* raw_image, F32 encode_time)
     // Image logical size
     setSize(raw_image->getWidth(), raw_image->getHeight(), raw_image->getComponents());
 
+    if (!mEncodeHelpers.empty() && raw_image->getDataSize() >= MIN_STRIPS_DATA_SIZE)
+    {
+        std::vector<U8> encoded;
+        LLPngWrapper pngWrapper;
+        if (!pngWrapper.writePngStrips(raw_image, encoded, mCompressionLevel, mEncodeHelpers))
+        {
+            setLastError(pngWrapper.getErrorMessage());
+            return false;
+        }
+
+        if (!allocateData((S32)encoded.size()))
+        {
+            setLastError("LLImagePNG::out of memory");
+            return false;
+        }
+        memcpy(getData(), encoded.data(), encoded.size());  /* Flawfinder: ignore */
+        return true;
+    }
+
     // Temporary buffer to hold the encoded image. Note: the final image
     // size should be much smaller due to compression.
     U32 bufferSize = getWidth() * getHeight() * getComponents() + 8192;
@@ -146,7 +169,7 @@ bool LLImagePNG::encode(const LLImageRaw* raw_image, F32 encode_time)
 
     // Delegate actual encoding work to wrapper
     LLPngWrapper pngWrapper;
-    if (!pngWrapper.writePng(raw_image, tmpWriteBuffer, bufferSize))
+    if (!pngWrapper.writePng(raw_image, tmpWriteBuffer, bufferSize, mCompressionLevel))
     {
         setLastError(pngWrapper.getErrorMessage());
         delete[] tmpWriteBuffer;
@@ -41,6 +41,16 @@ class LLImagePNG final : public LLImageFormatted
     /*virtual*/ bool updateData();
     /*virtual*/ bool decode(LLImageRaw* raw_image, F32 decode_time);
     /*virtual*/ bool encode(const LLImageRaw* raw_image, F32 encode_time);
+
+    // zlib level used by encode(), 0 to 9, -1 for the default
+    void setCompressionLevel(S32 level) { mCompressionLevel = level; }
+    // Large images are compressed in strips on the threads of this work
+    // queue as well as the encoding one, none when empty
+    void setEncodeHelpers(const std::string& queue_name) { mEncodeHelpers = queue_name; }
+
+private:
+    S32 mCompressionLevel;
+    std::string mEncodeHelpers;
 };
 
 #endif
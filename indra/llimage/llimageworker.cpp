@@ -28,8 +28,47 @@
 
 #include "llimageworker.h"
 #include "llimagedxt.h"
+#include "lltimer.h"
+#include "lltrace.h"
 #include "threadpool.h"
 
+namespace
+{
+    enum EPriorityBand
+    {
+        BAND_HIGH,
+        BAND_MEDIUM,
+        BAND_LOW,
+        BAND_COUNT
+    };
+
+    LLTrace::CountStatHandle<> sDecodesQueued[BAND_COUNT] = {
+        LLTrace::CountStatHandle<>("image_decode_queued_high", "Decodes queued with a high priority"),
+        LLTrace::CountStatHandle<>("image_decode_queued_medium", "Decodes queued with a medium priority"),
+        LLTrace::CountStatHandle<>("image_decode_queued_low", "Decodes queued with a low priority")
+    };
+    LLTrace::CountStatHandle<> sDecodesCancelled[BAND_COUNT] = {
+        LLTrace::CountStatHandle<>("image_decode_cancelled_high", "High priority decodes cancelled"),
+        LLTrace::CountStatHandle<>("image_decode_cancelled_medium", "Medium priority decodes cancelled"),
+        LLTrace::CountStatHandle<>("image_decode_cancelled_low", "Low priority decodes cancelled")
+    };
+    // Time from decodeImage() to a thread picking the request up
+    LLTrace::EventStatHandle<F64Seconds> sDecodeWait[BAND_COUNT] = {
+        LLTrace::EventStatHandle<F64Seconds>("image_decode_wait_high", "Queue time of high priority decodes"),
+        LLTrace::EventStatHandle<F64Seconds>("image_decode_wait_medium", "Queue time of medium priority decodes"),
+        LLTrace::EventStatHandle<F64Seconds>("image_decode_wait_low", "Queue time of low priority decodes")
+    };
+
+    U32 get_priority_band(F32 priority)
+    {
+        if (priority >= LLImageDecodeThread::HIGH_PRIORITY)
+        {
+            return BAND_HIGH;
+        }
+        return priority >= LLImageDecodeThread::LOW_PRIORITY ? BAND_MEDIUM : BAND_LOW;
+    }
+}
+
 /*--------------------------------------------------------------------------*/
 class ImageRequest
 {
@@ -64,17 +103,26 @@ class ImageRequest
 
 //----------------------------------------------------------------------------
 
+// A waiting request gains the priority of a 256x256 texture per second
+const F64 LLImageDecodeThread::PRIORITY_AGING_PER_SECOND = 256.0 * 256.0;
+const F32 LLImageDecodeThread::HIGH_PRIORITY = 512.f * 512.f;
+const F32 LLImageDecodeThread::LOW_PRIORITY = 64.f * 64.f;
+
 // MAIN THREAD
-LLImageDecodeThread::LLImageDecodeThread(bool /*threaded*/)
-    : mDecodeCount(0)
+LLImageDecodeThread::LLImageDecodeThread(bool /*threaded*/, size_t threads)
+    : mDecodeCount(0),
+      mStartTime(LLTimer::getTotalSeconds())
 {
-    mThreadPool.reset(new LL::ThreadPool("ImageDecode", 8));
+    mThreadPool.reset(new LL::ThreadPool("ImageDecode", threads));
     mThreadPool->start();
 }
 
 //virtual
 LLImageDecodeThread::~LLImageDecodeThread()
-{}
+{
+    // Join the threads before the queue they read from is destroyed
+    shutdown();
+}
 
 // MAIN THREAD
 // virtual
@@ -86,38 +134,146 @@ size_t LLImageDecodeThread::update(F32 max_time_ms)
 
 size_t LLImageDecodeThread::getPending()
 {
-    return mThreadPool->getQueue().size();
+    LLMutexLock lock(&mQueueMutex);
+    return mQueue.size();
+}
+
+F64 LLImageDecodeThread::getQueueKey(F32 priority, F64 queue_time) const
+{
+    // Ordering by priority + aging * (now - queue_time) is the same as
+    // ordering by this, which does not change while the request waits.
+    // The earlier a request was queued, the higher its key.
+    return (F64)priority - PRIORITY_AGING_PER_SECOND * (queue_time - mStartTime);
 }
 
 LLImageDecodeThread::handle_t LLImageDecodeThread::decodeImage(
     const LLPointer<LLImageFormatted>& image,
     S32 discard,
     BOOL needs_aux,
-    const LLPointer<LLImageDecodeThread::Responder>& responder)
+    const LLPointer<LLImageDecodeThread::Responder>& responder,
+    F32 priority)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
 
     U32 decode_id = ++mDecodeCount;
-    // Instantiate the ImageRequest right in the lambda, why not?
-    bool posted = mThreadPool->getQueue().post(
-        [req = ImageRequest(image, discard, needs_aux, responder, decode_id)]
-        () mutable
-        {
-            auto done = req.processRequest();
-            req.finishRequest(done);
-        });
+    const U32 band = get_priority_band(priority);
+    {
+        LLMutexLock lock(&mQueueMutex);
+        Request& request = mRequests[decode_id];
+        request.mRequest = std::make_unique<ImageRequest>(image, discard, needs_aux, responder, decode_id);
+        request.mQueueTime = LLTimer::getTotalSeconds();
+        request.mQueued = mQueue.emplace(getQueueKey(priority, request.mQueueTime), decode_id);
+        request.mBand = band;
+    }
+
+    bool posted = mThreadPool->getQueue().post([this]() { processNextRequest(); });
     if (! posted)
     {
         LL_DEBUGS() << "Tried to start decoding on shutdown" << LL_ENDL;
+        LLMutexLock lock(&mQueueMutex);
+        auto it = mRequests.find(decode_id);
+        if (it != mRequests.end())
+        {
+            mQueue.erase(it->second.mQueued);
+            mRequests.erase(it);
+        }
         return 0;
     }
 
+    add(sDecodesQueued[band], 1);
     return decode_id;
 }
 
+// WORKER THREADS
+void LLImageDecodeThread::processNextRequest()
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+
+    std::unique_ptr<ImageRequest> request;
+    handle_t handle = 0;
+    {
+        LLMutexLock lock(&mQueueMutex);
+        if (mQueue.empty())
+        {
+            // The request this task was posted for was cancelled
+            return;
+        }
+        auto first = std::prev(mQueue.end());
+        handle = first->second;
+        mQueue.erase(first);
+
+        Request& queued = mRequests.find(handle)->second;
+        request = std::move(queued.mRequest);
+        queued.mQueued = mQueue.end();
+        record(sDecodeWait[queued.mBand], F64Seconds(LLTimer::getTotalSeconds() - queued.mQueueTime));
+    }
+
+    bool done = request->processRequest();
+
+    bool cancelled = false;
+    {
+        LLMutexLock lock(&mQueueMutex);
+        auto it = mRequests.find(handle);
+        cancelled = it->second.mCancelled;
+        mRequests.erase(it);
+    }
+    // Outside of the lock, responders may call back into this class
+    if (!cancelled)
+    {
+        request->finishRequest(done);
+    }
+}
+
+bool LLImageDecodeThread::setPriority(handle_t handle, F32 priority)
+{
+    LLMutexLock lock(&mQueueMutex);
+    auto it = mRequests.find(handle);
+    if (it == mRequests.end() || !it->second.mRequest)
+    {
+        return false;
+    }
+    Request& request = it->second;
+    mQueue.erase(request.mQueued);
+    request.mQueued = mQueue.emplace(getQueueKey(priority, request.mQueueTime), handle);
+    request.mBand = get_priority_band(priority);
+    return true;
+}
+
+bool LLImageDecodeThread::cancelDecode(handle_t handle)
+{
+    LLMutexLock lock(&mQueueMutex);
+    auto it = mRequests.find(handle);
+    if (it == mRequests.end() || it->second.mCancelled)
+    {
+        return false;
+    }
+    Request& request = it->second;
+    add(sDecodesCancelled[request.mBand], 1);
+    if (request.mRequest)
+    {
+        // Not started: the pool task posted for it will run another request
+        // or find the queue empty
+        mQueue.erase(request.mQueued);
+        mRequests.erase(it);
+    }
+    else
+    {
+        request.mCancelled = true;
+    }
+    return true;
+}
+
 void LLImageDecodeThread::shutdown()
 {
     mThreadPool->close();
+
+    // Requests still queued will never run
+    LLMutexLock lock(&mQueueMutex);
+    for (const auto& entry : mQueue)
+    {
+        mRequests.erase(entry.second);
+    }
+    mQueue.clear();
 }
 
 LLImageDecodeThread::Responder::~Responder()
@@ -28,9 +28,16 @@
 #define LL_LLIMAGEWORKER_H
 
 #include "llimage.h"
+#include "llmutex.h"
 #include "llpointer.h"
 #include "threadpool_fwd.h"
 
+#include <boost/unordered/unordered_flat_map.hpp>
+
+#include <map>
+
+class ImageRequest;
+
 class LLImageDecodeThread
 {
 public:
@@ -43,25 +50,69 @@ class LLImageDecodeThread
     };
 
 public:
-    LLImageDecodeThread(bool threaded = true);
+    // threads is the pool width unless the "ThreadPoolSizes" setting has
+    // one for "ImageDecode"
+    LLImageDecodeThread(bool threaded = true, size_t threads = 8);
     virtual ~LLImageDecodeThread();
 
     // meant to resemble LLQueuedThread::handle_t
     typedef U32 handle_t;
+    // Requests are decoded highest priority first rather than in submission
+    // order. Priorities are in arbitrary units, the viewer uses the on-screen
+    // pixel area of the texture.
     handle_t decodeImage(const LLPointer<LLImageFormatted>& image,
                          S32 discard, BOOL needs_aux,
-                         const LLPointer<Responder>& responder);
+                         const LLPointer<Responder>& responder,
+                         F32 priority = 0.f);
+    // Change the priority of a request still waiting for a thread. Returns
+    // false when it has started or is unknown.
+    bool setPriority(handle_t handle, F32 priority);
+    // A queued request is dropped, the result of a running one is discarded.
+    // Either way the responder is never called. Returns false when the
+    // request is unknown, i.e. it already completed.
+    bool cancelDecode(handle_t handle);
+    // Requests waiting for a thread
     size_t getPending();
     size_t update(F32 max_time_ms);
     S32 getTotalDecodeCount() { return mDecodeCount; }
     void shutdown();
 
+    // Waiting requests gain this much priority per second so that low
+    // priority ones are eventually decoded while higher ones keep coming.
+    static const F64 PRIORITY_AGING_PER_SECOND;
+    // Bounds of the priority bands the LLTrace statistics are split by
+    static const F32 HIGH_PRIORITY;
+    static const F32 LOW_PRIORITY;
+
 private:
+    struct Request
+    {
+        std::unique_ptr<ImageRequest> mRequest; // null once started
+        std::multimap<F64, handle_t>::iterator mQueued;
+        F64 mQueueTime = 0.0;
+        U32 mBand = 0;
+        bool mCancelled = false;
+    };
+
+    // Run on the pool: decode the highest priority request
+    void processNextRequest();
+    F64 getQueueKey(F32 priority, F64 queue_time) const;
+
+
     // As of SL-17483, LLImageDecodeThread is no longer itself an
     // LLQueuedThread - instead this is the API by which we submit work to the
     // "ImageDecode" ThreadPool.
     std::unique_ptr<LL::ThreadPool> mThreadPool;
     LLAtomicU32 mDecodeCount;
+    F64 mStartTime;
+
+    // Every request posts one task to the pool, which runs whichever
+    // request is then first in mQueue rather than its own. Keys are the
+    // aged priorities, the highest is taken first.
+    LLMutex mQueueMutex;
+    std::multimap<F64, handle_t> mQueue;
+    // Queued and running requests
+    boost::unordered_flat_map<handle_t, Request> mRequests;
 };
 
 #endif
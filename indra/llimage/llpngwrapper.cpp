@@ -32,6 +32,16 @@
 #include "llpngwrapper.h"
 
 #include "llexception.h"
+#include "llcond.h"
+#include "workqueue.h"
+
+#if defined(LL_USESYSTEMLIBS) || defined(LL_LINUX)
+# include <zlib.h>
+#else
+# include "zlib/zlib.h"
+#endif
+
+#include <atomic>
 
 namespace {
 // Failure to load an image shouldn't crash the whole viewer.
@@ -39,6 +49,186 @@ struct PngError: public LLContinueError
 {
     PngError(png_const_charp msg): LLContinueError(msg) {}
 };
+
+// Strips are at least this many rows and this many bytes of filtered data,
+// smaller ones compress worse than the threading gains
+const S32 MIN_STRIP_ROWS = 16;
+const size_t MIN_STRIP_BYTES = 2 * 1024 * 1024;
+// Helper tasks posted per image, the calling thread works too
+const size_t MAX_STRIP_HELPERS = 8;
+// Largest IDAT chunk written
+const size_t MAX_IDAT_BYTES = 1024 * 1024;
+
+U8 paeth_predictor(S32 a, S32 b, S32 c)
+{
+    S32 p = a + b - c;
+    S32 pa = llabs(p - a);
+    S32 pb = llabs(p - b);
+    S32 pc = llabs(p - c);
+    if (pa <= pb && pa <= pc)
+    {
+        return (U8)a;
+    }
+    return (U8)(pb <= pc ? b : c);
+}
+
+inline U32 filtered_cost(U8 v)
+{
+    return v < 128 ? v : 256 - v;
+}
+
+// Writes row minus its prediction from the bytes to the left, above and above
+// left, returns the sum of the absolute values of the differences
+template<typename PREDICT>
+U32 apply_filter(const U8* row, const U8* prev, S32 row_bytes, S32 bpp, U8* dst, PREDICT predict)
+{
+    U32 sum = 0;
+    for (S32 i = 0; i < bpp; ++i)
+    {
+        dst[i] = row[i] - predict(0, prev[i], 0);
+        sum += filtered_cost(dst[i]);
+    }
+    for (S32 i = bpp; i < row_bytes; ++i)
+    {
+        dst[i] = row[i] - predict(row[i - bpp], prev[i], prev[i - bpp]);
+        sum += filtered_cost(dst[i]);
+    }
+    return sum;
+}
+
+// Filters a row with each of the five PNG filters and keeps the one with the
+// smallest sum of absolute differences, the heuristic libpng uses. out gets
+// the filter type byte followed by the filtered row. prev is the row above,
+// zeroes for the first one.
+void filter_row(const U8* row, const U8* prev, S32 row_bytes, S32 bpp, U8* out, U8* scratch)
+{
+    U8 best_type = 0;
+    U32 best_sum = apply_filter(row, prev, row_bytes, bpp, out + 1, [](U8, U8, U8) { return (U8)0; });
+    auto consider = [&](U8 type, U32 sum)
+    {
+        if (sum < best_sum)
+        {
+            best_sum = sum;
+            best_type = type;
+            memcpy(out + 1, scratch, row_bytes);    /* Flawfinder: ignore */
+        }
+    };
+    consider(1, apply_filter(row, prev, row_bytes, bpp, scratch, [](U8 a, U8, U8) { return a; }));
+    consider(2, apply_filter(row, prev, row_bytes, bpp, scratch, [](U8, U8 b, U8) { return b; }));
+    consider(3, apply_filter(row, prev, row_bytes, bpp, scratch, [](U8 a, U8 b, U8) { return (U8)((a + b) >> 1); }));
+    consider(4, apply_filter(row, prev, row_bytes, bpp, scratch, [](U8 a, U8 b, U8 c) { return paeth_predictor(a, b, c); }));
+    out[0] = best_type;
+}
+
+// One image being compressed, shared with the helper tasks which may outlive
+// writePngStrips() when they find no strip left to take
+struct StripJob
+{
+    StripJob(const LLImageRaw* raw, S32 level, S32 rows_per_strip)
+    :   mData(raw->getData()),
+        mHeight(raw->getHeight()),
+        mBpp(raw->getComponents()),
+        mRowBytes(raw->getWidth() * raw->getComponents()),
+        mLevel(level),
+        mRowsPerStrip(rows_per_strip),
+        mStripCount((raw->getHeight() + rows_per_strip - 1) / rows_per_strip),
+        mStrips(mStripCount),
+        mAdlers(mStripCount),
+        mNext(0),
+        mFailed(false),
+        mDone(0)
+    {
+    }
+
+    // PNG rows go top down, ours bottom up
+    const U8* row(S32 y) const { return mData + (size_t)(mHeight - 1 - y) * mRowBytes; }
+
+    // Takes strips until there are none left
+    void run()
+    {
+        size_t strip;
+        while ((strip = mNext++) < mStripCount)
+        {
+            if (!compress(strip))
+            {
+                mFailed = true;
+            }
+            mDone.update_all([](size_t& done) { ++done; });
+        }
+    }
+
+    bool compress(size_t strip)
+    {
+        LL_PROFILE_ZONE_NAMED("PNG strip");
+        const S32 first = (S32)strip * mRowsPerStrip;
+        const S32 end = llmin(first + mRowsPerStrip, mHeight);
+        const bool last = end == mHeight;
+
+        std::vector<U8> filtered((size_t)(end - first) * (mRowBytes + 1));
+        std::vector<U8> scratch(mRowBytes);
+        const std::vector<U8> zero_row(mRowBytes, 0);
+        for (S32 y = first; y < end; ++y)
+        {
+            filter_row(row(y), y ? row(y - 1) : zero_row.data(), mRowBytes, mBpp,
+                       &filtered[(size_t)(y - first) * (mRowBytes + 1)], scratch.data());
+        }
+        mAdlers[strip] = adler32(adler32(0L, Z_NULL, 0), filtered.data(), (uInt)filtered.size());
+
+        // Raw deflate, the zlib header and trailer are written once for the
+        // whole stream. Strips but the last end on a byte boundary with a
+        // sync flush so that they can be concatenated.
+        z_stream stream = {};
+        if (deflateInit2(&stream, mLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_FILTERED) != Z_OK)
+        {
+            return false;
+        }
+
+        std::vector<U8>& out = mStrips[strip];
+        out.resize(deflateBound(&stream, (uLong)filtered.size()) + 16);
+        stream.next_in = filtered.data();
+        stream.avail_in = (uInt)filtered.size();
+        stream.next_out = out.data();
+        stream.avail_out = (uInt)out.size();
+        const S32 ret = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        const bool ok = last ? ret == Z_STREAM_END : (ret == Z_OK && stream.avail_in == 0 && stream.avail_out > 0);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return ok;
+    }
+
+    const U8* mData;
+    const S32 mHeight;
+    const S32 mBpp;
+    const S32 mRowBytes;
+    const S32 mLevel;
+    const S32 mRowsPerStrip;
+    const size_t mStripCount;
+    std::vector<std::vector<U8> > mStrips;
+    std::vector<uLong> mAdlers;
+    std::atomic<size_t> mNext;
+    std::atomic<bool> mFailed;
+    LLScalarCond<size_t> mDone;
+};
+
+void append_u32(std::vector<U8>& dst, U32 value)
+{
+    dst.push_back((U8)(value >> 24));
+    dst.push_back((U8)(value >> 16));
+    dst.push_back((U8)(value >> 8));
+    dst.push_back((U8)value);
+}
+
+void append_chunk(std::vector<U8>& dst, const char* type, const U8* data, size_t length)
+{
+    append_u32(dst, (U32)length);
+    const size_t start = dst.size();
+    dst.insert(dst.end(), type, type + 4);
+    if (length)
+    {
+        dst.insert(dst.end(), data, data + length);
+    }
+    append_u32(dst, (U32)crc32(0L, &dst[start], (uInt)(dst.size() - start)));
+}
 } // anonymous namespace
 
 // ---------------------------------------------------------------------------
@@ -288,7 +478,7 @@ void LLPngWrapper::updateMetaData()
 
 // Method to write raw image into PNG at dest. The raw scanline begins
 // at the bottom of the image per SecondLife conventions.
-BOOL LLPngWrapper::writePng(const LLImageRaw* rawImage, U8* dest, size_t destSize)
+BOOL LLPngWrapper::writePng(const LLImageRaw* rawImage, U8* dest, size_t destSize, S32 level)
 {
     try
     {
@@ -331,6 +521,10 @@ BOOL LLPngWrapper::writePng(const LLImageRaw* rawImage, U8* dest, size_t destSiz
         dataPtr.mOffset = 0;
         dataPtr.mDataSize = destSize;
         png_set_write_fn(mWritePngPtr, &dataPtr, &writeDataCallback, &writeFlush);
+        if (level >= 0)
+        {
+            png_set_compression_level(mWritePngPtr, llmin(level, Z_BEST_COMPRESSION));
+        }
 
         // Setup image params
         mWidth = rawImage->getWidth();
@@ -376,6 +570,109 @@ BOOL LLPngWrapper::writePng(const LLImageRaw* rawImage, U8* dest, size_t destSiz
     return TRUE;
 }
 
+// Same output as writePng(), with the rows compressed in independent strips.
+// Each strip is filtered and deflated on its own, ending with a sync flush
+// but for the last one, so that the strips concatenated make a valid deflate
+// stream, and the Adler-32 of the whole is combined from theirs. The only
+// cost is the compression context lost at each strip boundary.
+BOOL LLPngWrapper::writePngStrips(const LLImageRaw* rawImage, std::vector<U8>& dst, S32 level, const std::string& helpers)
+{
+    LL_PROFILE_ZONE_SCOPED;
+    const S8 numComponents = rawImage->getComponents();
+    static const U8 color_types[] = { PNG_COLOR_TYPE_GRAY, PNG_COLOR_TYPE_GRAY_ALPHA, PNG_COLOR_TYPE_RGB, PNG_COLOR_TYPE_RGB_ALPHA };
+    if (numComponents < 1 || numComponents > 4)
+    {
+        mErrorMessage = "Unsupported image: unexpected number of channels";
+        return FALSE;
+    }
+    if (!rawImage->getWidth() || !rawImage->getHeight() || !rawImage->getData())
+    {
+        mErrorMessage = "Unsupported image: empty";
+        return FALSE;
+    }
+
+    mWidth = rawImage->getWidth();
+    mHeight = rawImage->getHeight();
+    mBitDepth = 8;
+    mChannels = numComponents;
+    mColorType = color_types[numComponents - 1];
+
+    const size_t row_bytes = (size_t)mWidth * mChannels + 1;
+    const S32 rows_per_strip = llmax(MIN_STRIP_ROWS, (S32)((MIN_STRIP_BYTES + row_bytes - 1) / row_bytes));
+    auto job = std::make_shared<StripJob>(rawImage, level < 0 ? Z_DEFAULT_COMPRESSION : llmin(level, Z_BEST_COMPRESSION), rows_per_strip);
+
+    if (job->mStripCount > 1 && !helpers.empty())
+    {
+        auto queue = LL::WorkQueue::getInstance(helpers);
+        const size_t count = llmin(job->mStripCount - 1, MAX_STRIP_HELPERS);
+        for (size_t i = 0; queue && i < count; ++i)
+        {
+            // Helpers that start after the strips are all taken just return
+            if (!queue->post([job]() { job->run(); }))
+            {
+                break;
+            }
+        }
+    }
+    job->run();
+    job->mDone.wait_equal(job->mStripCount);
+
+    if (job->mFailed)
+    {
+        mErrorMessage = "Compression of PNG strips failed";
+        return FALSE;
+    }
+
+    // zlib stream: header for a 32K window with the level hint, the strips,
+    // then the Adler-32 of all the filtered data
+    size_t stream_size = 6;
+    for (const auto& strip : job->mStrips)
+    {
+        stream_size += strip.size();
+    }
+    std::vector<U8> stream;
+    stream.reserve(stream_size);
+    const U8 cmf = 0x78;
+    const U8 flevel = (level < 0 || level == 6) ? 2 : level < 2 ? 0 : level < 6 ? 1 : 3;
+    U8 flg = flevel << 6;
+    flg += 31 - ((cmf << 8) + flg) % 31;
+    stream.push_back(cmf);
+    stream.push_back(flg);
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (size_t i = 0; i < job->mStripCount; ++i)
+    {
+        stream.insert(stream.end(), job->mStrips[i].begin(), job->mStrips[i].end());
+        const S32 first = (S32)i * rows_per_strip;
+        const S32 end = llmin(first + rows_per_strip, (S32)mHeight);
+        adler = adler32_combine(adler, job->mAdlers[i], (z_off_t)((end - first) * row_bytes));
+    }
+    append_u32(stream, (U32)adler);
+
+    static const U8 signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    dst.clear();
+    dst.reserve(stream.size() + stream.size() / MAX_IDAT_BYTES * 12 + 64);
+    dst.insert(dst.end(), signature, signature + 8);
+
+    std::vector<U8> ihdr;
+    append_u32(ihdr, mWidth);
+    append_u32(ihdr, mHeight);
+    ihdr.push_back((U8)mBitDepth);
+    ihdr.push_back((U8)mColorType);
+    ihdr.push_back(PNG_COMPRESSION_TYPE_DEFAULT);
+    ihdr.push_back(PNG_FILTER_TYPE_DEFAULT);
+    ihdr.push_back(PNG_INTERLACE_NONE);
+    append_chunk(dst, "IHDR", ihdr.data(), ihdr.size());
+
+    for (size_t offset = 0; offset < stream.size(); offset += MAX_IDAT_BYTES)
+    {
+        append_chunk(dst, "IDAT", &stream[offset], llmin(MAX_IDAT_BYTES, stream.size() - offset));
+    }
+    append_chunk(dst, "IEND", NULL, 0);
+
+    mFinalSize = (U32)dst.size();
+    return TRUE;
+}
+
 // Cleanup various internal structures
 void LLPngWrapper::releaseResources()
 {
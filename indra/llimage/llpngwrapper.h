@@ -29,6 +29,8 @@
 #include "png.h"
 #include "llimage.h"
 
+#include <vector>
+
 class LLPngWrapper final
 {
 public:
@@ -45,7 +47,12 @@ class LLPngWrapper final
 
     BOOL isValidPng(U8* src);
     BOOL readPng(U8* src, S32 dataSize, LLImageRaw* rawImage, ImageInfo *infop = NULL);
-    BOOL writePng(const LLImageRaw* rawImage, U8* dst, size_t destSize);
+    // level is the zlib compression level, 0 to 9, or -1 for libpng's default
+    BOOL writePng(const LLImageRaw* rawImage, U8* dst, size_t destSize, S32 level = -1);
+    // Encodes without libpng, compressing strips of rows in parallel on the
+    // threads of the named work queue as well as the calling one. The strips
+    // are chained into a single zlib stream, the file is a regular PNG.
+    BOOL writePngStrips(const LLImageRaw* rawImage, std::vector<U8>& dst, S32 level, const std::string& helpers);
     U32  getFinalSize();
     const std::string& getErrorMessage();
 
@@ -0,0 +1,129 @@
+/**
+ * @file   llimage_test.cpp
+ * @brief  Test of the raw image scaling.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llimage.h"
+
+#include <random>
+
+namespace tut
+{
+    struct llimage_data
+    {
+        llimage_data()
+        :   mRNG(1234)
+        {
+        }
+
+        LLPointer<LLImageRaw> randomImage(U16 width, U16 height, S8 components)
+        {
+            LLPointer<LLImageRaw> image = new LLImageRaw(width, height, components);
+            U8* data = image->getData();
+            for (S32 i = 0; i < image->getDataSize(); ++i)
+            {
+                data[i] = (U8)mRNG();
+            }
+            return image;
+        }
+
+        // Channel c of every pixel of image, as a one channel image
+        static LLPointer<LLImageRaw> channel(LLImageRaw* image, S32 c)
+        {
+            const S32 pixels = image->getWidth() * image->getHeight();
+            const S32 components = image->getComponents();
+            LLPointer<LLImageRaw> result = new LLImageRaw(image->getWidth(), image->getHeight(), 1);
+            for (S32 i = 0; i < pixels; ++i)
+            {
+                result->getData()[i] = image->getData()[i * components + c];
+            }
+            return result;
+        }
+
+        std::mt19937 mRNG;
+    };
+
+    typedef test_group<llimage_data> llimage_group;
+    typedef llimage_group::object llimage_object;
+    tut::llimage_group llimage_testgroup("LLImageRaw");
+
+    template<> template<>
+    void llimage_object::test<1>()
+    {
+        // Channels are scaled independently, so scaling 4 channels, which is
+        // vectorized, must give what the scalar 3 and 1 channel scaling do
+        const U16 sizes[][4] = {
+            { 37, 23, 64, 40 },     // up
+            { 64, 40, 13, 9 },      // down
+            { 50, 12, 17, 30 },     // down and up
+            { 256, 256, 128, 128 }, // halved
+            { 5, 7, 5, 3 },         // one direction only
+        };
+
+        for (const U16* size : sizes)
+        {
+            LLPointer<LLImageRaw> rgba = randomImage(size[0], size[1], 4);
+            LLPointer<LLImageRaw> rgb = new LLImageRaw(size[0], size[1], 3);
+            rgb->copyUnscaled4onto3(rgba);
+            LLPointer<LLImageRaw> alpha = channel(rgba, 3);
+
+            ensure("scaled 4", rgba->scale(size[2], size[3]));
+            ensure("scaled 3", rgb->scale(size[2], size[3]));
+            ensure("scaled 1", alpha->scale(size[2], size[3]));
+
+            const S32 pixels = size[2] * size[3];
+            const U8* rgba_data = rgba->getData();
+            bool same = true;
+            for (S32 i = 0; i < pixels && same; ++i)
+            {
+                same = rgba_data[i * 4 + 0] == rgb->getData()[i * 3 + 0] &&
+                       rgba_data[i * 4 + 1] == rgb->getData()[i * 3 + 1] &&
+                       rgba_data[i * 4 + 2] == rgb->getData()[i * 3 + 2] &&
+                       rgba_data[i * 4 + 3] == alpha->getData()[i];
+            }
+            ensure("4 channels scale like 3 and 1", same);
+        }
+    }
+
+    template<> template<>
+    void llimage_object::test<2>()
+    {
+        // copyScaled4onto3() scales before dropping alpha, which must give
+        // what dropping it first did
+        LLPointer<LLImageRaw> rgba = randomImage(61, 33, 4);
+        LLPointer<LLImageRaw> rgb = new LLImageRaw(61, 33, 3);
+        rgb->copyUnscaled4onto3(rgba);
+
+        LLPointer<LLImageRaw> expected = new LLImageRaw(20, 45, 3);
+        expected->copyScaled(rgb);
+        LLPointer<LLImageRaw> actual = new LLImageRaw(20, 45, 3);
+        actual->copyScaled4onto3(rgba);
+
+        ensure("same size", expected->getDataSize() == actual->getDataSize());
+        ensure("same pixels", !memcmp(expected->getData(), actual->getData(), expected->getDataSize()));
+    }
+}
@@ -0,0 +1,200 @@
+/**
+ * @file   llimagefilter_test.cpp
+ * @brief  Test of the banded execution of image filters.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "llsdutil.h"
+
+#include "../llimagefilter.h"
+
+#include <random>
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes:
+// * LLImageRaw is simulated with a plain heap buffer, filters only need its size and data
+// -------------------------------------------------------------------------------------------
+
+LLImageBase::LLImageBase()
+:   mData(NULL),
+    mDataSize(0),
+    mWidth(0),
+    mHeight(0),
+    mComponents(0),
+    mBadBufferAllocation(false),
+    mAllowOverSize(false)
+{
+}
+LLImageBase::~LLImageBase() { delete[] mData; }
+void LLImageBase::dump() { }
+void LLImageBase::sanityCheck() { }
+void LLImageBase::deleteData() { delete[] mData; mData = NULL; mDataSize = 0; }
+U8* LLImageBase::allocateData(S32 size) { deleteData(); mData = new U8[size]; mDataSize = size; return mData; }
+U8* LLImageBase::reallocateData(S32 size) { return allocateData(size); }
+void LLImageBase::setSize(S32 width, S32 height, S32 ncomponents) { mWidth = width; mHeight = height; mComponents = ncomponents; }
+const U8* LLImageBase::getData() const { return mData; }
+U8* LLImageBase::getData() { return mData; }
+
+LLImageRaw::LLImageRaw(U16 width, U16 height, S8 components) { setSize(width, height, components); LLImageBase::allocateData(width * height * components); }
+LLImageRaw::~LLImageRaw() { }
+void LLImageRaw::deleteData() { LLImageBase::deleteData(); }
+U8* LLImageRaw::allocateData(S32 size) { return LLImageBase::allocateData(size); }
+U8* LLImageRaw::reallocateData(S32 size) { return LLImageBase::reallocateData(size); }
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+    // Per-pixel filters, a convolution and a histogram based one in between,
+    // under several stencils
+    LLSD filter_chain()
+    {
+        return llsd::array(
+            llsd::array("stencil", "vignette", "blend", 0.2, 1.0, 0.1, -0.2, 1.0, 1.5),
+            llsd::array("sepia"),
+            llsd::array("gamma", 1.4, 1.0, 0.8, 0.6),
+            llsd::array("screen", "2Dsine", 0.05, 15.0),
+            llsd::array("stencil", "gradient", "add", 0.0, 0.7, -1.0, -1.0, 1.0, 1.0),
+            llsd::array("sharpen"),
+            llsd::array("contrast", 1.3, 1.0, 1.0, 1.0),
+            llsd::array("posterize", 6.0, 1.0, 1.0, 1.0),
+            llsd::array("stencil", "scanlines", "fade", 0.3, 1.0, 0.02, 30.0),
+            llsd::array("saturate", 1.5),
+            llsd::array("screen", "line", 0.03, 45.0),
+            llsd::array("colorize", 1.0, 0.2, 0.1, 0.3, 0.3, 0.3));
+    }
+}
+
+namespace tut
+{
+    struct llimagefilter_data
+    {
+        llimagefilter_data()
+        :   mRNG(1234)
+        {
+        }
+
+        ~llimagefilter_data()
+        {
+            LLImageFilter::cleanupClass();
+        }
+
+        LLPointer<LLImageRaw> randomImage(U16 width, U16 height, S8 components)
+        {
+            LLPointer<LLImageRaw> image = new LLImageRaw(width, height, components);
+            U8* data = image->getData();
+            for (S32 i = 0; i < image->getDataSize(); ++i)
+            {
+                data[i] = (U8)mRNG();
+            }
+            return image;
+        }
+
+        LLPointer<LLImageRaw> copyImage(const LLImageRaw* src)
+        {
+            LLPointer<LLImageRaw> image = new LLImageRaw(src->getWidth(), src->getHeight(), src->getComponents());
+            memcpy(image->getData(), src->getData(), src->getDataSize());    /* Flawfinder: ignore */
+            return image;
+        }
+
+        // Run the filters of chain one at a time on the calling thread, each
+        // under the stencil set before it
+        static void filterOneByOne(const LLSD& chain, LLPointer<LLImageRaw> image)
+        {
+            LLImageFilter::cleanupClass();
+            LLSD stencil;
+            for (S32 i = 0; i < chain.size(); ++i)
+            {
+                if (chain[i][0].asString() == "stencil")
+                {
+                    stencil = chain[i];
+                    continue;
+                }
+                LLSD step = LLSD::emptyArray();
+                if (stencil.isDefined())
+                {
+                    step.append(stencil);
+                }
+                step.append(chain[i]);
+                LLImageFilter(step).executeFilter(image);
+            }
+        }
+
+        static bool sameImage(const LLImageRaw* a, const LLImageRaw* b)
+        {
+            return a->getDataSize() == b->getDataSize() && !memcmp(a->getData(), b->getData(), a->getDataSize());
+        }
+
+        std::mt19937 mRNG;
+    };
+
+    typedef test_group<llimagefilter_data> llimagefilter_group;
+    typedef llimagefilter_group::object llimagefilter_object;
+    tut::llimagefilter_group llimagefilter_testgroup("LLImageFilter");
+
+    template<> template<>
+    void llimagefilter_object::test<1>()
+    {
+        // Running the chain at once, fused and in bands, gives the same
+        // image as running its filters one at a time on the calling thread
+        const LLSD chain = filter_chain();
+        for (S8 components = 3; components <= 4; ++components)
+        {
+            LLPointer<LLImageRaw> expected = randomImage(301, 203, components);
+            LLPointer<LLImageRaw> actual = copyImage(expected);
+
+            filterOneByOne(chain, expected);
+
+            LLImageFilter::initClass(3);
+            LLImageFilter(chain).executeFilter(actual);
+
+            ensure("banded chain matches", sameImage(expected, actual));
+        }
+    }
+
+    template<> template<>
+    void llimagefilter_object::test<2>()
+    {
+        // Degenerate sizes, fewer rows than bands, still match the filters
+        // run one at a time on the calling thread
+        const LLSD chain = filter_chain();
+        const U16 sizes[][2] = { { 1, 1 }, { 2, 2 }, { 3, 3 }, { 64, 2 }, { 2, 130 } };
+        for (const auto& size : sizes)
+        {
+            LLPointer<LLImageRaw> expected = randomImage(size[0], size[1], 3);
+            LLPointer<LLImageRaw> actual = copyImage(expected);
+
+            filterOneByOne(chain, expected);
+
+            LLImageFilter::initClass(3);
+            LLImageFilter(chain).executeFilter(actual);
+
+            ensure(llformat("%dx%d banded chain matches", size[0], size[1]), sameImage(expected, actual));
+        }
+    }
+}
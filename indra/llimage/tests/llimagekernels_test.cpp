@@ -0,0 +1,175 @@
+/**
+ * @file   llimagekernels_test.cpp
+ * @brief  Test of the raw image row kernels.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llimagekernels.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    // The loops LLImageRaw used to run
+    void reference_rgba_to_rgb(const U8* src_data, U8* dst_data, U32 pixels)
+    {
+        for (U32 i = 0; i < pixels; i++)
+        {
+            dst_data[0] = src_data[0];
+            dst_data[1] = src_data[1];
+            dst_data[2] = src_data[2];
+            src_data += 4;
+            dst_data += 3;
+        }
+    }
+
+    void reference_rgb_to_rgba(const U8* src_data, U8* dst_data, U32 pixels)
+    {
+        for (U32 i = 0; i < pixels; i++)
+        {
+            dst_data[0] = src_data[0];
+            dst_data[1] = src_data[1];
+            dst_data[2] = src_data[2];
+            dst_data[3] = 255;
+            src_data += 3;
+            dst_data += 4;
+        }
+    }
+
+    U8 fast_fractional_mult(U8 a, U8 b)
+    {
+        U32 i = a * b + 128;
+        return U8((i + (i >> 8)) >> 8);
+    }
+
+    void reference_composite(const U8* src_data, U8* dst_data, U32 pixels)
+    {
+        while (pixels--)
+        {
+            U8 alpha = src_data[3];
+            if (alpha)
+            {
+                if (255 == alpha)
+                {
+                    dst_data[0] = src_data[0];
+                    dst_data[1] = src_data[1];
+                    dst_data[2] = src_data[2];
+                }
+                else
+                {
+                    U8 transparency = 255 - alpha;
+                    dst_data[0] = fast_fractional_mult(dst_data[0], transparency) + fast_fractional_mult(src_data[0], alpha);
+                    dst_data[1] = fast_fractional_mult(dst_data[1], transparency) + fast_fractional_mult(src_data[1], alpha);
+                    dst_data[2] = fast_fractional_mult(dst_data[2], transparency) + fast_fractional_mult(src_data[2], alpha);
+                }
+            }
+            src_data += 4;
+            dst_data += 3;
+        }
+    }
+}
+
+namespace tut
+{
+    struct llimagekernels_data
+    {
+        llimagekernels_data()
+        :   mRNG(1234)
+        {
+        }
+
+        std::vector<U8> random(U32 size)
+        {
+            std::vector<U8> data(size);
+            for (auto& b : data)
+            {
+                b = (U8)mRNG();
+            }
+            return data;
+        }
+
+        // Random colors, with fully transparent and opaque pixels mixed in
+        std::vector<U8> randomRGBA(U32 pixels)
+        {
+            std::vector<U8> data = random(pixels * 4);
+            for (U32 i = 0; i < pixels; ++i)
+            {
+                switch (mRNG() % 4)
+                {
+                case 0: data[i * 4 + 3] = 0; break;
+                case 1: data[i * 4 + 3] = 255; break;
+                default: break;
+                }
+            }
+            return data;
+        }
+
+        std::mt19937 mRNG;
+    };
+
+    typedef test_group<llimagekernels_data> llimagekernels_group;
+    typedef llimagekernels_group::object llimagekernels_object;
+    tut::llimagekernels_group llimagekernels_testgroup("LLImageKernels");
+
+    template<> template<>
+    void llimagekernels_object::test<1>()
+    {
+        // Channel conversions, every count around the vector widths. The
+        // buffers are exactly sized so that reading or writing past them
+        // shows up under a memory checker.
+        for (U32 pixels = 0; pixels < 40; ++pixels)
+        {
+            std::vector<U8> rgba = random(pixels * 4);
+            std::vector<U8> expected(pixels * 3), actual(pixels * 3);
+            reference_rgba_to_rgb(rgba.data(), expected.data(), pixels);
+            ll_rgba_to_rgb(rgba.data(), actual.data(), pixels);
+            ensure("rgba to rgb matches", expected == actual);
+
+            std::vector<U8> rgb = random(pixels * 3);
+            std::vector<U8> expected4(pixels * 4), actual4(pixels * 4);
+            reference_rgb_to_rgba(rgb.data(), expected4.data(), pixels);
+            ll_rgb_to_rgba(rgb.data(), actual4.data(), pixels);
+            ensure("rgb to rgba matches", expected4 == actual4);
+        }
+    }
+
+    template<> template<>
+    void llimagekernels_object::test<2>()
+    {
+        // Compositing, including alpha 0 and 255 which the scalar code
+        // special cases
+        for (U32 pixels = 0; pixels < 40; ++pixels)
+        {
+            std::vector<U8> src = randomRGBA(pixels);
+            std::vector<U8> expected = random(pixels * 3);
+            std::vector<U8> actual = expected;
+            reference_composite(src.data(), expected.data(), pixels);
+            ll_composite_rgba_onto_rgb(src.data(), actual.data(), pixels);
+            ensure("composite matches", expected == actual);
+        }
+    }
+}
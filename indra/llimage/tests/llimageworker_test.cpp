@@ -36,6 +36,10 @@
 // Tut header
 #include "../test/lltut.h"
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 // -------------------------------------------------------------------------------------------
 // Stubbing: Declarations required to link and run the class being tested
 // Notes:
@@ -110,6 +114,57 @@ namespace tut
             bool* done;
     };
 
+    // Records the order requests complete in. The first one to complete
+    // can hold its worker thread until released, so that the requests
+    // queued meanwhile are picked up by priority.
+    class order_responder : public LLImageDecodeThread::Responder
+    {
+        public:
+            struct state
+            {
+                LLMutex mMutex;
+                std::vector<U32> mOrder;
+                std::atomic<bool> mHolding{ false };
+                std::atomic<bool> mRelease{ false };
+
+                size_t count()
+                {
+                    LLMutexLock lock(&mMutex);
+                    return mOrder.size();
+                }
+            };
+
+            order_responder(state* s, bool hold) : mState(s), mHold(hold) {}
+
+            virtual void completed(bool success, const std::string& error_message, LLImageRaw* raw, LLImageRaw* aux, U32 request_id)
+            {
+                if (mHold)
+                {
+                    mState->mHolding = true;
+                    while (!mState->mRelease)
+                    {
+                        ms_sleep(10);
+                    }
+                }
+                LLMutexLock lock(&mState->mMutex);
+                mState->mOrder.push_back(request_id);
+            }
+        private:
+            state* mState;
+            bool mHold;
+    };
+
+    // Waits until cond is true or about 10 seconds have passed
+    template <typename COND>
+    bool wait_for(COND cond)
+    {
+        for (U32 total_time = 0; !cond() && total_time < 10000; total_time += 10)
+        {
+            ms_sleep(10);
+        }
+        return cond();
+    }
+
     // Test wrapper declaration : decode thread
     struct imagedecodethread_test
     {
@@ -166,4 +221,87 @@ namespace tut
         // Verifies that the responder has now been called
         ensure("LLImageDecodeThread: threaded work unit not processed", done == true);
     }
+
+    template<> template<>
+    void imagedecodethread_object_t::test<2>()
+    {
+        // Cancelling and reprioritizing apply to pending requests only
+        mThread = new LLImageDecodeThread(true);
+        bool done = false;
+        LLImageDecodeThread::handle_t decodeHandle = mThread->decodeImage(NULL, 0, FALSE, new responder_test(&done), 1.f);
+        ensure("LLImageDecodeThread: decodeImage() with a priority, returned handle is null", decodeHandle != 0);
+        const U32 INCREMENT_TIME = 100;
+        const U32 MAX_TIME = 100 * INCREMENT_TIME;
+        U32 total_time = 0;
+        while ((done == false) && (total_time < MAX_TIME))
+        {
+            ms_sleep(INCREMENT_TIME);
+            total_time += INCREMENT_TIME;
+        }
+        ensure("LLImageDecodeThread: prioritized work unit not processed", done == true);
+        ensure("LLImageDecodeThread: completed request reprioritized", !mThread->setPriority(decodeHandle, 2.f));
+        ensure("LLImageDecodeThread: completed request cancelled", !mThread->cancelDecode(decodeHandle));
+        ensure_equals("LLImageDecodeThread: requests left pending", mThread->getPending(), (size_t)0);
+    }
+
+    template<> template<>
+    void imagedecodethread_object_t::test<3>()
+    {
+        // Queued requests are decoded highest priority first, a cancelled
+        // one never completes
+        mThread = new LLImageDecodeThread(true, 1);
+        order_responder::state state;
+        mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, true), 0.f);
+        ensure("LLImageDecodeThread: single thread not busy", wait_for([&]() { return state.mHolding.load(); }));
+
+        LLImageDecodeThread::handle_t low = mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, false), 10.f);
+        LLImageDecodeThread::handle_t high = mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, false), 1000.f);
+        LLImageDecodeThread::handle_t cancelled = mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, false), 100.f);
+        LLImageDecodeThread::handle_t raised = mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, false), 1.f);
+        ensure_equals("LLImageDecodeThread: requests queued", mThread->getPending(), (size_t)4);
+
+        ensure("LLImageDecodeThread: queued request not cancelled", mThread->cancelDecode(cancelled));
+        ensure("LLImageDecodeThread: request cancelled twice", !mThread->cancelDecode(cancelled));
+        ensure("LLImageDecodeThread: queued request not reprioritized", mThread->setPriority(raised, 100.f));
+        ensure_equals("LLImageDecodeThread: cancelled request still queued", mThread->getPending(), (size_t)3);
+
+        state.mRelease = true;
+        ensure("LLImageDecodeThread: requests not processed", wait_for([&]() { return state.count() == 4; }));
+        ensure("LLImageDecodeThread: queue not drained", wait_for([&]() { return mThread->getPending() == 0; }));
+
+        LLMutexLock lock(&state.mMutex);
+        ensure_equals("LLImageDecodeThread: highest priority first", state.mOrder[1], high);
+        ensure_equals("LLImageDecodeThread: reprioritized second", state.mOrder[2], raised);
+        ensure_equals("LLImageDecodeThread: lowest priority last", state.mOrder[3], low);
+        ensure("LLImageDecodeThread: cancelled request completed",
+               std::find(state.mOrder.begin(), state.mOrder.end(), cancelled) == state.mOrder.end());
+    }
+
+    template<> template<>
+    void imagedecodethread_object_t::test<4>()
+    {
+        // A request that waited long enough goes before a newer one of
+        // higher priority
+        mThread = new LLImageDecodeThread(true, 1);
+        order_responder::state state;
+        mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, true), 0.f);
+        ensure("LLImageDecodeThread: single thread not busy", wait_for([&]() { return state.mHolding.load(); }));
+
+        LLImageDecodeThread::handle_t old = mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, false), 1.f);
+        ms_sleep(1100);
+        // Less than what the old request gained in a second
+        const F32 newer_priority = 1.f + (F32)LLImageDecodeThread::PRIORITY_AGING_PER_SECOND * 0.5f;
+        LLImageDecodeThread::handle_t newer = mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, false), newer_priority);
+        // More than it gained
+        const F32 urgent_priority = 1.f + (F32)LLImageDecodeThread::PRIORITY_AGING_PER_SECOND * 100.f;
+        LLImageDecodeThread::handle_t urgent = mThread->decodeImage(NULL, 0, FALSE, new order_responder(&state, false), urgent_priority);
+
+        state.mRelease = true;
+        ensure("LLImageDecodeThread: requests not processed", wait_for([&]() { return state.count() == 4; }));
+
+        LLMutexLock lock(&state.mMutex);
+        ensure_equals("LLImageDecodeThread: much higher priority first", state.mOrder[1], urgent);
+        ensure_equals("LLImageDecodeThread: aged request before newer one", state.mOrder[2], old);
+        ensure_equals("LLImageDecodeThread: newer request last", state.mOrder[3], newer);
+    }
 }
@@ -0,0 +1,183 @@
+/**
+ * @file   llpngwrapper_test.cpp
+ * @brief  Test of the PNG encoding in parallel strips.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llpngwrapper.h"
+#include "threadpool.h"
+
+#include "png.h"
+
+#include <random>
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes:
+// * LLImageRaw is simulated with a plain heap buffer, the encoder only needs its size and data
+// -------------------------------------------------------------------------------------------
+
+LLImageBase::LLImageBase()
+:   mData(NULL),
+    mDataSize(0),
+    mWidth(0),
+    mHeight(0),
+    mComponents(0),
+    mBadBufferAllocation(false),
+    mAllowOverSize(false)
+{
+}
+LLImageBase::~LLImageBase() { delete[] mData; }
+void LLImageBase::dump() { }
+void LLImageBase::sanityCheck() { }
+void LLImageBase::deleteData() { delete[] mData; mData = NULL; mDataSize = 0; }
+U8* LLImageBase::allocateData(S32 size) { deleteData(); mData = new U8[size]; mDataSize = size; return mData; }
+U8* LLImageBase::reallocateData(S32 size) { return allocateData(size); }
+void LLImageBase::setSize(S32 width, S32 height, S32 ncomponents) { mWidth = width; mHeight = height; mComponents = ncomponents; }
+const U8* LLImageBase::getData() const { return mData; }
+U8* LLImageBase::getData() { return mData; }
+
+LLImageRaw::LLImageRaw(U16 width, U16 height, S8 components) { setSize(width, height, components); LLImageBase::allocateData(width * height * components); }
+LLImageRaw::~LLImageRaw() { }
+void LLImageRaw::deleteData() { LLImageBase::deleteData(); }
+U8* LLImageRaw::allocateData(S32 size) { return LLImageBase::allocateData(size); }
+U8* LLImageRaw::reallocateData(S32 size) { return LLImageBase::reallocateData(size); }
+bool LLImageRaw::resize(U16 width, U16 height, S8 components) { setSize(width, height, components); LLImageBase::allocateData(width * height * components); return true; }
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+namespace tut
+{
+    struct llpngwrapper_data
+    {
+        llpngwrapper_data()
+        :   mRNG(4321)
+        {
+        }
+
+        // Gradients with some noise, so that the row filters have
+        // something to choose between
+        LLPointer<LLImageRaw> makeImage(U16 width, U16 height, S8 components)
+        {
+            LLPointer<LLImageRaw> image = new LLImageRaw(width, height, components);
+            U8* data = image->getData();
+            for (S32 y = 0; y < height; ++y)
+            {
+                for (S32 x = 0; x < width; ++x)
+                {
+                    for (S32 c = 0; c < components; ++c)
+                    {
+                        *data++ = (U8)(x * (c + 1) + y + (mRNG() & 0x7));
+                    }
+                }
+            }
+            return image;
+        }
+
+        // Decoded by libpng, which knows nothing of the strips
+        static bool decodesTo(const std::vector<U8>& png, const LLImageRaw* expected)
+        {
+            static const png_uint_32 formats[] = { PNG_FORMAT_GRAY, PNG_FORMAT_GA, PNG_FORMAT_RGB, PNG_FORMAT_RGBA };
+
+            png_image image;
+            memset(&image, 0, sizeof(image));
+            image.version = PNG_IMAGE_VERSION;
+            if (!png_image_begin_read_from_memory(&image, png.data(), png.size()))
+            {
+                return false;
+            }
+            image.format = formats[expected->getComponents() - 1];
+            std::vector<U8> pixels(PNG_IMAGE_SIZE(image));
+            const bool read = png_image_finish_read(&image, NULL, pixels.data(), 0, NULL) != 0;
+            png_image_free(&image);
+
+            return read
+                && image.width == (png_uint_32)expected->getWidth()
+                && image.height == (png_uint_32)expected->getHeight()
+                && pixels.size() == (size_t)expected->getDataSize()
+                && !memcmp(pixels.data(), expected->getData(), pixels.size());
+        }
+
+        std::mt19937 mRNG;
+    };
+
+    typedef test_group<llpngwrapper_data> llpngwrapper_group;
+    typedef llpngwrapper_group::object llpngwrapper_object;
+    tut::llpngwrapper_group llpngwrapper_testgroup("LLPngWrapper");
+
+    template<> template<>
+    void llpngwrapper_object::test<1>()
+    {
+        // A single strip, every channel count, at a few levels
+        for (S8 components = 1; components <= 4; ++components)
+        {
+            LLPointer<LLImageRaw> raw = makeImage(67, 41, components);
+            for (S32 level : { -1, 0, 1, 9 })
+            {
+                LLPngWrapper wrapper;
+                std::vector<U8> png;
+                ensure("encoded", wrapper.writePngStrips(raw, png, level, std::string()));
+                ensure_equals("final size", (size_t)wrapper.getFinalSize(), png.size());
+                ensure(llformat("%d channels at level %d decode", components, level), decodesTo(png, raw));
+            }
+        }
+    }
+
+    template<> template<>
+    void llpngwrapper_object::test<2>()
+    {
+        // Several strips compressed by helper threads give the same file as
+        // compressed on the calling thread alone, and it decodes
+        LL::ThreadPool pool("PngStripsTest", 3);
+        pool.start();
+
+        LLPointer<LLImageRaw> raw = makeImage(1500, 1100, 4);
+        LLPngWrapper serial_wrapper;
+        std::vector<U8> serial;
+        ensure("encoded alone", serial_wrapper.writePngStrips(raw, serial, 6, std::string()));
+
+        LLPngWrapper helped_wrapper;
+        std::vector<U8> helped;
+        ensure("encoded with helpers", helped_wrapper.writePngStrips(raw, helped, 6, "PngStripsTest"));
+
+        pool.close();
+
+        ensure("same file", serial == helped);
+        ensure("decodes", decodesTo(helped, raw));
+    }
+
+    template<> template<>
+    void llpngwrapper_object::test<3>()
+    {
+        // Images the encoder can't take
+        LLPointer<LLImageRaw> empty = new LLImageRaw(0, 0, 3);
+        LLPngWrapper wrapper;
+        std::vector<U8> png;
+        ensure("empty image refused", !wrapper.writePngStrips(empty, png, -1, std::string()));
+        ensure("error reported", !wrapper.getErrorMessage().empty());
+    }
+}
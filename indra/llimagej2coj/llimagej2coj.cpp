@@ -222,8 +222,14 @@ LLImageJ2COJ::LLImageJ2COJ()
 
 bool LLImageJ2COJ::initDecode(LLImageJ2C &base, LLImageRaw &raw_image, int discard_level, int* region)
 {
-    // No specific implementation for this method in the OpenJpeg case
-    return false;
+    // The discard level has been set on base by LLImageJ2C::initDecode() and
+    // becomes the reduce factor, only the region needs to be kept.
+    mHasRegion = region && region[2] > region[0] && region[3] > region[1];
+    if (mHasRegion)
+    {
+        memcpy(mRegion, region, sizeof(mRegion));
+    }
+    return true;
 }
 
 bool LLImageJ2COJ::initEncode(LLImageJ2C &base, LLImageRaw &raw_image, int blocks_size, int precincts_size, int levels)
@@ -319,6 +325,29 @@ bool LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
 
     //opj_decoder_set_strict_mode(opj_decoder_p, OPJ_FALSE);
 
+    // Large images get their code blocks decoded in parallel. The workers
+    // have to be set before the header is read.
+    S32 extra_threads = 0;
+    if (LLImageJ2C::sDecodeThreads > 1 && opj_has_thread_support())
+    {
+        const S32 discard = llmax((S32)base.getRawDiscardLevel(), 0);
+        S32 width = mHasRegion ? mRegion[2] - mRegion[0] : base.getWidth();
+        S32 height = mHasRegion ? mRegion[3] - mRegion[1] : base.getHeight();
+        width = ceildivpow2(width, discard);
+        height = ceildivpow2(height, discard);
+        if (width * height >= LLImageJ2C::sThreadedDecodeArea)
+        {
+            // The calling thread counts as one, the rest come from the
+            // budget shared with the other decodes in flight.
+            extra_threads = LLImageJ2C::reserveDecodeThreads(LLImageJ2C::sDecodeThreads - 1);
+            if (extra_threads > 0 && !opj_codec_set_threads(opj_decoder_p, extra_threads + 1))
+            {
+                LLImageJ2C::releaseDecodeThreads(extra_threads);
+                extra_threads = 0;
+            }
+        }
+    }
+
     /* open a byte stream */
     LLJp2StreamReader streamReader(&base);
     opj_stream_t* opj_stream_p = opj_stream_default_create(OPJ_STREAM_READ);
@@ -329,15 +358,27 @@ bool LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
     opj_stream_set_user_data_length(opj_stream_p, base.getDataSize());
 
     /* decode the stream and fill the image structure */
-    bool success = opj_read_header(opj_stream_p, opj_decoder_p, &image) &&
-                    opj_decode(opj_decoder_p, opj_stream_p, image) &&
-                    opj_end_decompress(opj_decoder_p, opj_stream_p);
+    bool success = opj_read_header(opj_stream_p, opj_decoder_p, &image);
+
+    // Only decode the tiles and code blocks covering the requested region.
+    // A region outside of the image makes the decode fail.
+    if (success && mHasRegion)
+    {
+        success = opj_set_decode_area(opj_decoder_p, image,
+                                      llmax(mRegion[0], (S32)image->x0), llmax(mRegion[1], (S32)image->y0),
+                                      llmin(mRegion[2], (S32)image->x1), llmin(mRegion[3], (S32)image->y1));
+    }
+
+    success = success &&
+              opj_decode(opj_decoder_p, opj_stream_p, image) &&
+              opj_end_decompress(opj_decoder_p, opj_stream_p);
 
     /* close the byte stream */
     opj_stream_destroy(opj_stream_p);
 
     /* free remaining structures */
     opj_destroy_codec(opj_decoder_p);
+    LLImageJ2C::releaseDecodeThreads(extra_threads);
 
 
     // The image decode failed if the return was NULL or the component
@@ -386,6 +427,12 @@ bool LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
     S32 f=image->comps[0].factor;
     S32 width = ceildivpow2(image->x1 - image->x0, f);
     S32 height = ceildivpow2(image->y1 - image->y0, f);
+    if (mHasRegion)
+    {
+        // The area rarely falls on the reduced grid, trust the decoder
+        width = image->comps[0].w;
+        height = image->comps[0].h;
+    }
     raw_image.resize(width, height, channels);
     U8 *rawp = raw_image.getData();
     if (!rawp)
@@ -42,6 +42,11 @@ class LLImageJ2COJ final : public LLImageJ2CImpl
     virtual bool initDecode(LLImageJ2C &base, LLImageRaw &raw_image, int discard_level = -1, int* region = NULL);
     virtual bool initEncode(LLImageJ2C &base, LLImageRaw &raw_image, int blocks_size = -1, int precincts_size = -1, int levels = 0);
     virtual std::string getEngineInfo() const;
+
+private:
+    // Area set by initDecode(), in full resolution pixels (x0, y0, x1, y1)
+    S32 mRegion[4] = { 0, 0, 0, 0 };
+    bool mHasRegion = false;
 };
 
 #endif
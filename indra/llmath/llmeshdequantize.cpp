@@ -0,0 +1,232 @@
+/**
+ * @file llmeshdequantize.cpp
+ * @brief SIMD decoding of the quantized vertex streams of mesh assets.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmeshdequantize.h"
+
+#include "llmath.h"
+#include "v2math.h"
+
+#include <immintrin.h>
+
+namespace
+{
+    constexpr F32 QUANTIZED_MAX = 65535.f;
+    constexpr U8 END_INFLUENCES = 0xFF;
+    // Largest encoding of the influences of a vertex: 4 joints and weights
+    constexpr U32 MAX_VERTEX_INFLUENCE_BYTES = 4 * 3;
+
+    inline __m128 dequantize(__m128i q, __m128 scale, __m128 offset)
+    {
+        // Same operations in the same order as the scalar code so the
+        // results don't depend on the path taken
+        __m128 v = _mm_cvtepi32_ps(q);
+        v = _mm_div_ps(v, _mm_set1_ps(QUANTIZED_MAX));
+        v = _mm_mul_ps(v, scale);
+        return _mm_add_ps(v, offset);
+    }
+
+#if defined(__AVX2__)
+    inline __m256 dequantize(__m256i q, __m256 scale, __m256 offset)
+    {
+        __m256 v = _mm256_cvtepi32_ps(q);
+        v = _mm256_div_ps(v, _mm256_set1_ps(QUANTIZED_MAX));
+        v = _mm256_mul_ps(v, scale);
+        return _mm256_add_ps(v, offset);
+    }
+
+    inline __m256 broadcast(const LLVector4a& v)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(v), v, 1);
+    }
+#endif
+
+    // Influences of one vertex, without reading past size.
+    inline U32 decode_vertex_weights(const U8* in, U32 idx, U32 size, LLVector4a& out)
+    {
+        U8 joint = in[idx++];
+
+        U32 cur_influence = 0;
+        F32 wght[4] = { 0.f, 0.f, 0.f, 0.f };
+        U32 joints[4] = { 0, 0, 0, 0 };
+
+        while (joint != END_INFLUENCES && idx + 1 < size)
+        {
+            const U16 influence = (U16)in[idx] | ((U16)in[idx + 1] << 8);
+            idx += 2;
+
+            wght[cur_influence] = llclamp((F32)influence / QUANTIZED_MAX, 0.001f, 0.999f);
+            joints[cur_influence] = joint;
+            cur_influence++;
+
+            if (cur_influence >= 4 || idx >= size)
+            {
+                joint = END_INFLUENCES;
+            }
+            else
+            {
+                joint = in[idx++];
+            }
+        }
+
+        const F32 wsum = wght[VX] + wght[VY] + wght[VZ] + wght[VW];
+        if (wsum <= 0.f)
+        {
+            wght[VX] = 0.999f;
+        }
+
+        F32 combined[4];
+        for (U32 k = 0; k < 4; ++k)
+        {
+            combined[k] = (F32)joints[k] + wght[k];
+            // Any weights we added above should wind up non-zero and applied to a specific bone.
+            // A failure here would indicate a floating point precision error in the math.
+            llassert((k >= cur_influence) || (combined[k] - S32(combined[k]) > 0.0f));
+        }
+        out.loadua(combined);
+        return idx;
+    }
+
+    // Same without branching on the number of influences, which varies from
+    // vertex to vertex. At least MAX_VERTEX_INFLUENCE_BYTES must be left in
+    // the stream. Returns the number of bytes read.
+    inline U32 decode_vertex_weights_fast(const U8* in, LLVector4a& out)
+    {
+        // Joints are every 3 bytes up to the first end marker
+        static const U8 sInfluenceCount[16] = { 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+        const U32 ends = (U32)(in[0] == END_INFLUENCES)
+            | ((U32)(in[3] == END_INFLUENCES) << 1)
+            | ((U32)(in[6] == END_INFLUENCES) << 2)
+            | ((U32)(in[9] == END_INFLUENCES) << 3);
+        const S32 count = sInfluenceCount[ends];
+
+        const __m128 joints = _mm_cvtepi32_ps(_mm_setr_epi32(in[0], in[3], in[6], in[9]));
+        const __m128i influences = _mm_setr_epi32(in[1] | (in[2] << 8), in[4] | (in[5] << 8),
+                                                  in[7] | (in[8] << 8), in[10] | (in[11] << 8));
+        __m128 weights = _mm_div_ps(_mm_cvtepi32_ps(influences), _mm_set1_ps(QUANTIZED_MAX));
+        weights = _mm_min_ps(_mm_max_ps(weights, _mm_set1_ps(0.001f)), _mm_set1_ps(0.999f));
+
+        // Drop the lanes past the influences, a vertex without any gets a
+        // single full weight on joint 0
+        const __m128 used = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(count)));
+        const __m128 none = _mm_castsi128_ps(_mm_set1_epi32(-(S32)(count == 0)));
+        weights = _mm_or_ps(_mm_and_ps(weights, used), _mm_and_ps(none, _mm_setr_ps(0.999f, 0.f, 0.f, 0.f)));
+
+        out = _mm_add_ps(_mm_and_ps(joints, used), weights);
+        return count * 3 + (count < 4 ? 1 : 0);
+    }
+}
+
+void ll_dequantize_vec3_u16(const U8* in, U32 count, const LLVector4a& scale, const LLVector4a& offset, LLVector4a* out)
+{
+    U32 i = 0;
+
+#if defined(__AVX2__)
+    {
+        // Two vertices from 16 bytes, as long as that doesn't read past the
+        // end of the stream
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+        const __m256 scale8 = broadcast(scale);
+        const __m256 offset8 = broadcast(offset);
+        for (; i + 2 < count; i += 2)
+        {
+            __m128i q = _mm_loadu_si128((const __m128i*)(in + i * 6));
+            q = _mm_shuffle_epi8(q, shuffle);
+            _mm256_storeu_ps(out[i].getF32ptr(), dequantize(_mm256_cvtepu16_epi32(q), scale8, offset8));
+        }
+    }
+#endif
+
+    const __m128i mask = _mm_setr_epi32(-1, -1, -1, 0);
+    for (; i + 1 < count; ++i)
+    {
+        // 8 bytes read, the next vertex being there
+        __m128i q = _mm_loadl_epi64((const __m128i*)(in + i * 6));
+        q = _mm_and_si128(_mm_cvtepu16_epi32(q), mask);
+        out[i] = dequantize(q, scale, offset);
+    }
+
+    if (i < count)
+    {
+        U16 last[4] = { 0, 0, 0, 0 };
+        memcpy(last, in + i * 6, 3 * sizeof(U16));
+        const __m128i q = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)last));
+        out[i] = dequantize(q, scale, offset);
+    }
+}
+
+void ll_dequantize_vec2_u16(const U8* in, U32 count, const LLVector4a& scale, const LLVector4a& offset, LLVector2* out)
+{
+    F32* dst = out[0].mV;
+    U32 i = 0;
+
+#if defined(__AVX2__)
+    {
+        const __m256 scale8 = broadcast(scale);
+        const __m256 offset8 = broadcast(offset);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i q = _mm_loadu_si128((const __m128i*)(in + i * 4));
+            _mm256_storeu_ps(dst + i * 2, dequantize(_mm256_cvtepu16_epi32(q), scale8, offset8));
+        }
+    }
+#endif
+
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128i q = _mm_loadl_epi64((const __m128i*)(in + i * 4));
+        _mm_storeu_ps(dst + i * 2, dequantize(_mm_cvtepu16_epi32(q), scale, offset));
+    }
+
+    if (i < count)
+    {
+        U16 last[4] = { 0, 0, 0, 0 };
+        memcpy(last, in + i * 4, 2 * sizeof(U16));
+        const __m128i q = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)last));
+        _mm_storeu_ps(dst + i * 2, dequantize(q, scale, offset));
+    }
+}
+
+U32 ll_decode_mesh_weights(const U8* in, U32 size, U32 count, LLVector4a* out, U32& consumed)
+{
+    U32 idx = 0;
+    U32 cur_vertex = 0;
+
+    // Fast path while a whole vertex is guaranteed to be there
+    while (cur_vertex < count && size - idx >= MAX_VERTEX_INFLUENCE_BYTES)
+    {
+        idx += decode_vertex_weights_fast(in + idx, out[cur_vertex++]);
+    }
+
+    while (cur_vertex < count && idx < size)
+    {
+        idx = decode_vertex_weights(in, idx, size, out[cur_vertex++]);
+    }
+
+    consumed = idx;
+    return cur_vertex;
+}
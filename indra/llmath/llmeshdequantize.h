@@ -0,0 +1,54 @@
+/**
+ * @file llmeshdequantize.h
+ * @brief SIMD decoding of the quantized vertex streams of mesh assets.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESHDEQUANTIZE_H
+#define LL_LLMESHDEQUANTIZE_H
+
+#include "llmath.h"
+
+class LLVector2;
+
+// The input streams are little endian U16 (and U8 for weights) and need not
+// be aligned. The results are bit identical to the scalar decoding done
+// with LLVector4a::set/div/mul/add, the AVX2 paths are only used when the
+// viewer is built with AVX2 enabled.
+
+// out[i] = (q / 65535) * scale + offset for count U16 triplets, the w
+// component being computed from a quantized 0.
+void ll_dequantize_vec3_u16(const U8* in, U32 count, const LLVector4a& scale, const LLVector4a& offset, LLVector4a* out);
+
+// Same for count U16 pairs, two per LLVector4a. scale and offset hold the
+// 2D scale and offset twice. When count is odd, the unused half of the
+// last vector of out is set to the offset.
+void ll_dequantize_vec2_u16(const U8* in, U32 count, const LLVector4a& scale, const LLVector4a& offset, LLVector2* out);
+
+// Decode the joint influence stream of a rigged mesh face: per vertex, up
+// to 4 (joint, U16 weight) pairs ended by 0xFF unless there are 4. Each
+// vertex is stored as joint + weight in every component. Returns the number
+// of vertices decoded, consumed receives the number of bytes read.
+U32 ll_decode_mesh_weights(const U8* in, U32 size, U32 count, LLVector4a* out, U32& consumed);
+
+#endif // LL_LLMESHDEQUANTIZE_H
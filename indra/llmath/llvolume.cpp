@@ -49,11 +49,14 @@
 #include "llvolume.h"
 #include "llstl.h"
 #include "llsdserialize.h"
+#include "llsdbinaryreader.h"
+#include "llmeshdequantize.h"
 #include "llvector4a.h"
 #include "llmatrix4a.h"
 #include "llmeshoptimizer.h"
 #include "lltimer.h"
 #include "llvolumeoctree.h"
+#include "llvolumebvh.h"
 
 #include "mikktspace/mikktspace.hh"
 
@@ -1964,9 +1967,10 @@ void LLPathParams::copyParams(const LLPathParams &params)
     setSkew(params.getSkew());
 }
 
-S32 LLVolume::sNumMeshPoints = 0;
+std::atomic<S32> LLVolume::sNumMeshPoints(0);
 
-LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique)
+LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique,
+                   const BOOL create_faces)
     : mParams(params)
 {
     mUnique = is_unique;
@@ -1997,7 +2001,8 @@ LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL ge
 
     generate();
 
-    if ((mParams.getSculptID().isNull() && mParams.getSculptType() == LL_SCULPT_TYPE_NONE) || mParams.getSculptType() == LL_SCULPT_TYPE_MESH)
+    if (create_faces &&
+        ((mParams.getSculptID().isNull() && mParams.getSculptType() == LL_SCULPT_TYPE_NONE) || mParams.getSculptType() == LL_SCULPT_TYPE_MESH))
     {
         createVolumeFaces();
     }
@@ -2303,40 +2308,175 @@ bool LLVolumeFace::VertexData::compareNormal(const LLVolumeFace::VertexData& rhs
     return retval;
 }
 
+namespace
+{
+    // Blocks of a mesh LOD face, pointing into the decompressed asset.
+    struct MeshFaceBlocks
+    {
+        bool        mNoGeometry = false;
+        const U8*   mPosition = nullptr;
+        U32         mPositionSize = 0;
+        const U8*   mNormal = nullptr;
+        U32         mNormalSize = 0;
+        const U8*   mTexCoord = nullptr;
+        U32         mTexCoordSize = 0;
+        const U8*   mTriangleList = nullptr;
+        U32         mTriangleListSize = 0;
+        bool        mHasWeights = false;
+        const U8*   mWeights = nullptr;
+        U32         mWeightsSize = 0;
+        F32         mPositionMin[3] = { 0.f, 0.f, 0.f };
+        F32         mPositionMax[3] = { 0.f, 0.f, 0.f };
+        F32         mTexCoordMin[2] = { 0.f, 0.f };
+        F32         mTexCoordMax[2] = { 0.f, 0.f };
+        bool        mHasNormalizedScale = false;
+        F32         mNormalizedScale[3] = { 1.f, 1.f, 1.f };
+    };
+
+    // The blocks are not aligned inside the asset
+    inline void load_u16(const U8* in, U16* out, U32 count)
+    {
+        memcpy(out, in, count * sizeof(U16));
+    }
+
+    bool read_mesh_domain(LLSDBinaryReader& reader, F32* min, F32* max, U32 count)
+    {
+        U32 size = 0;
+        if (!reader.beginMap(size))
+        {
+            return false;
+        }
+        std::string_view key;
+        for (U32 i = 0; i < size; ++i)
+        {
+            if (!reader.readKey(key))
+            {
+                return false;
+            }
+            if (key == "Min")
+            {
+                reader.readRealArray(min, count);
+            }
+            else if (key == "Max")
+            {
+                reader.readRealArray(max, count);
+            }
+            else
+            {
+                reader.skip();
+            }
+        }
+        return reader.endMap();
+    }
+
+    bool read_mesh_face(LLSDBinaryReader& reader, MeshFaceBlocks& blocks)
+    {
+        if (reader.peekType() != '{')
+        {
+            // Not a face, leave it empty
+            return reader.skip();
+        }
+
+        U32 size = 0;
+        reader.beginMap(size);
+        std::string_view key;
+        for (U32 i = 0; i < size && reader.isValid(); ++i)
+        {
+            if (!reader.readKey(key))
+            {
+                break;
+            }
+
+            if (key == "Position")
+            {
+                reader.readBinary(blocks.mPosition, blocks.mPositionSize);
+            }
+            else if (key == "Normal")
+            {
+                reader.readBinary(blocks.mNormal, blocks.mNormalSize);
+            }
+            else if (key == "TexCoord0")
+            {
+                reader.readBinary(blocks.mTexCoord, blocks.mTexCoordSize);
+            }
+            else if (key == "TriangleList")
+            {
+                reader.readBinary(blocks.mTriangleList, blocks.mTriangleListSize);
+            }
+            else if (key == "Weights")
+            {
+                blocks.mHasWeights = true;
+                reader.readBinary(blocks.mWeights, blocks.mWeightsSize);
+            }
+            else if (key == "PositionDomain")
+            {
+                read_mesh_domain(reader, blocks.mPositionMin, blocks.mPositionMax, 3);
+            }
+            else if (key == "TexCoord0Domain")
+            {
+                read_mesh_domain(reader, blocks.mTexCoordMin, blocks.mTexCoordMax, 2);
+            }
+            else if (key == "NormalizedScale")
+            {
+                blocks.mHasNormalizedScale = true;
+                reader.readRealArray(blocks.mNormalizedScale, 3);
+            }
+            else
+            {
+                if (key == "NoGeometry")
+                {
+                    blocks.mNoGeometry = true;
+                }
+                reader.skip();
+            }
+        }
+        return reader.endMap();
+    }
+}
+
 bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME
 
-    //input stream is now pointing at a zlib compressed block of LLSD
-    //decompress block
-    LLSD mdl;
-    U32 uzip_result = LLUZipHelper::unzip_llsd(mdl, is, size);
-    if (uzip_result != LLUZipHelper::ZR_OK)
+    //input stream is now pointing at a compressed block of LLSD
+    std::unique_ptr<U8[]> in_data(new(std::nothrow) U8[size]);
+    if (!in_data)
     {
-        LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD with code " << uzip_result << " , will probably fetch from sim again." << LL_ENDL;
+        LL_WARNS("MeshStreaming") << "Failed to allocate " << size << " bytes for LoD" << LL_ENDL;
         return false;
     }
-    return unpackVolumeFacesInternal(mdl);
+    is.read((char*)in_data.get(), size);
+    return unpackVolumeFaces(in_data.get(), size);
 }
 
 bool LLVolume::unpackVolumeFaces(U8* in_data, S32 size)
 {
-    //input data is now pointing at a zlib compressed block of LLSD
-    //decompress block
-    LLSD mdl;
-    U32 uzip_result = LLUZipHelper::unzip_llsd(mdl, in_data, size);
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME
+
+    //input data is now pointing at a compressed block of LLSD
+    //decompress block, the faces are decoded straight out of it
+    U8* result = NULL;
+    llssize result_size = 0;
+    U32 uzip_result = LLUZipHelper::unzip_block(in_data, size, result, result_size);
     if (uzip_result != LLUZipHelper::ZR_OK)
     {
         LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD with code " << uzip_result << " , will probably fetch from sim again." << LL_ENDL;
         return false;
     }
-    return unpackVolumeFacesInternal(mdl);
+    std::unique_ptr<U8, decltype(&free)> result_holder(result, &free);
+
+    LLSDBinaryReader reader(result, result_size);
+    return unpackVolumeFacesInternal(reader);
 }
 
-bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
+bool LLVolume::unpackVolumeFacesInternal(LLSDBinaryReader& reader)
 {
     {
-        U32 face_count = mdl.size();
+        U32 face_count = 0;
+        if (reader.peekType() == '[')
+        {
+            reader.beginArray(face_count);
+        }
 
         if (face_count == 0)
         { //no faces unpacked, treat as failed decode
@@ -2350,9 +2490,15 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
         {
             LLVolumeFace& face = mVolumeFaces[i];
 
-            const auto& mdl_face = mdl[i];
+            MeshFaceBlocks mdl_face;
+            if (!read_mesh_face(reader, mdl_face))
+            {
+                LL_DEBUGS("MeshStreaming") << "Failed to parse LLSD blob for LoD, face index: " << i << " Total: " << face_count << LL_ENDL;
+                mVolumeFaces.clear();
+                return false;
+            }
 
-            if (mdl_face.has("NoGeometry"))
+            if (mdl_face.mNoGeometry)
             { //face has no geometry, continue
                 face.resizeIndices(3);
                 face.resizeVertices(1);
@@ -2363,16 +2509,8 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                 continue;
             }
 
-            const LLSD::Binary& pos = mdl_face["Position"].asBinary();
-            const LLSD::Binary& norm = mdl_face["Normal"].asBinary();
-#if 0 // keep this code for now in case we decide to add support for on-the-wire tangents
-            const LLSD::Binary& tangent = mdl_face["Tangent"].asBinary();
-#endif
-            const LLSD::Binary& tc = mdl_face["TexCoord0"].asBinary();
-            const LLSD::Binary& idx = mdl_face["TriangleList"].asBinary();
-
             //copy out indices
-            S32 num_indices = idx.size() / 2;
+            S32 num_indices = mdl_face.mTriangleListSize / 2;
             const S32 indices_to_discard = num_indices % 3;
             if (indices_to_discard > 0)
             {
@@ -2388,20 +2526,16 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                 continue;
             }
 
-            if (idx.empty() || face.mNumIndices < 3)
+            if (!mdl_face.mTriangleListSize || face.mNumIndices < 3)
             { //why is there an empty index list?
                 LL_WARNS() << "Empty face present! Face index: " << i << " Total: " << face_count << LL_ENDL;
                 continue;
             }
 
-            U16* indices = (U16*) &(idx[0]);
-            for (U32 j = 0; j < num_indices; ++j)
-            {
-                face.mIndices[j] = indices[j];
-            }
+            load_u16(mdl_face.mTriangleList, face.mIndices, num_indices);
 
             //copy out vertices
-            U32 num_verts = pos.size()/(3*2);
+            U32 num_verts = mdl_face.mPositionSize/(3*2);
             face.resizeVertices(num_verts);
 
             if (num_verts > 0 && !face.mPositions)
@@ -2411,24 +2545,19 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                 continue;
             }
 
-            LLVector3 minp;
-            LLVector3 maxp;
-            LLVector2 min_tc;
-            LLVector2 max_tc;
+            LLVector3 minp(mdl_face.mPositionMin);
+            LLVector3 maxp(mdl_face.mPositionMax);
+            LLVector2 min_tc(mdl_face.mTexCoordMin);
+            LLVector2 max_tc(mdl_face.mTexCoordMax);
 
-            minp.setValue(mdl_face["PositionDomain"]["Min"]);
-            maxp.setValue(mdl_face["PositionDomain"]["Max"]);
             LLVector4a min_pos, max_pos;
             min_pos.load3(minp.mV);
             max_pos.load3(maxp.mV);
 
-            min_tc.setValue(mdl_face["TexCoord0Domain"]["Min"]);
-            max_tc.setValue(mdl_face["TexCoord0Domain"]["Max"]);
-
             //unpack normalized scale/translation
-            if (mdl_face.has("NormalizedScale"))
+            if (mdl_face.mHasNormalizedScale)
             {
-                face.mNormalizedScale.setValue(mdl_face["NormalizedScale"]);
+                face.mNormalizedScale.set(mdl_face.mNormalizedScale);
             }
             else
             {
@@ -2443,111 +2572,38 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
             tc_range.set(tc_range2[0], tc_range2[1], tc_range2[0], tc_range2[1]);
             LLVector4a min_tc4(min_tc[0], min_tc[1], min_tc[0], min_tc[1]);
 
-            LLVector4a* pos_out = face.mPositions;
-            LLVector4a* norm_out = face.mNormals;
-            LLVector4a* tc_out = (LLVector4a*) face.mTexCoords;
+            ll_dequantize_vec3_u16(mdl_face.mPosition, num_verts, pos_range, min_pos, face.mPositions);
 
+            if (mdl_face.mNormalSize >= num_verts * 3 * sizeof(U16))
             {
-                U16* v = (U16*) &(pos[0]);
-                for (U32 j = 0; j < num_verts; ++j)
-                {
-                    pos_out->set((F32) v[0], (F32) v[1], (F32) v[2]);
-                    pos_out->div(65535.f);
-                    pos_out->mul(pos_range);
-                    pos_out->add(min_pos);
-                    pos_out++;
-                    v += 3;
-                }
-
+                LLVector4a two, minus_one;
+                two.splat(2.f);
+                minus_one.splat(-1.f);
+                ll_dequantize_vec3_u16(mdl_face.mNormal, num_verts, two, minus_one, face.mNormals);
             }
-
+            else
             {
-                if (!norm.empty())
-                {
-                    U16* n = (U16*) &(norm[0]);
-                    for (U32 j = 0; j < num_verts; ++j)
-                    {
-                        norm_out->set((F32) n[0], (F32) n[1], (F32) n[2]);
-                        norm_out->div(65535.f);
-                        norm_out->mul(2.f);
-                        norm_out->sub(1.f);
-                        norm_out++;
-                        n += 3;
-                    }
-                }
-                else
+                for (U32 j = 0; j < num_verts; ++j)
                 {
-                    for (U32 j = 0; j < num_verts; ++j)
-                    {
-                        norm_out->clear();
-                        norm_out++; // or just norm_out[j].clear();
-                    }
+                    face.mNormals[j].clear();
                 }
             }
 
-#if 0 // keep this code for now in case we decide to add support for on-the-wire tangents
+            if (mdl_face.mTexCoordSize >= num_verts * 2 * sizeof(U16))
             {
-                if (!tangent.empty())
-                {
-                    face.allocateTangents(face.mNumVertices);
-                    U16* t = (U16*)&(tangent[0]);
-
-                    // NOTE: tangents coming from the asset may not be mikkt space, but they should always be used by the GLTF shaders to
-                    // maintain compliance with the GLTF spec
-                    LLVector4a* t_out = face.mTangents;
-
-                    for (U32 j = 0; j < num_verts; ++j)
-                    {
-                        t_out->set((F32)t[0], (F32)t[1], (F32)t[2], (F32) t[3]);
-                        t_out->div(65535.f);
-                        t_out->mul(2.f);
-                        t_out->sub(1.f);
-
-                        F32* tp = t_out->getF32ptr();
-                        tp[3] = tp[3] < 0.f ? -1.f : 1.f;
-
-                        t_out++;
-                        t += 4;
-                    }
-                }
+                ll_dequantize_vec2_u16(mdl_face.mTexCoord, num_verts, tc_range, min_tc4, face.mTexCoords);
             }
-#endif
-
+            else
             {
-                if (!tc.empty())
-                {
-                    U16* t = (U16*) &(tc[0]);
-                    for (U32 j = 0; j < num_verts; j+=2)
-                    {
-                        if (j < num_verts-1)
-                        {
-                            tc_out->set((F32) t[0], (F32) t[1], (F32) t[2], (F32) t[3]);
-                        }
-                        else
-                        {
-                            tc_out->set((F32) t[0], (F32) t[1], 0.f, 0.f);
-                        }
-
-                        t += 4;
-
-                        tc_out->div(65535.f);
-                        tc_out->mul(tc_range);
-                        tc_out->add(min_tc4);
-
-                        tc_out++;
-                    }
-                }
-                else
+                LLVector4a* tc_out = (LLVector4a*) face.mTexCoords;
+                for (U32 j = 0; j < num_verts; j += 2)
                 {
-                    for (U32 j = 0; j < num_verts; j += 2)
-                    {
-                        tc_out->clear();
-                        tc_out++;
-                    }
+                    tc_out->clear();
+                    tc_out++;
                 }
             }
 
-            if (mdl_face.has("Weights"))
+            if (mdl_face.mHasWeights)
             {
                 face.allocateWeights(num_verts);
                 if (!face.mWeights && num_verts)
@@ -2558,60 +2614,10 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
                     continue;
                 }
 
-                const LLSD::Binary& weights = mdl_face["Weights"].asBinary();
-
-                U32 idx = 0;
-
-                U32 cur_vertex = 0;
-                size_t weight_size = weights.size();
-                while (idx < weight_size && cur_vertex < num_verts)
-                {
-                    const U8 END_INFLUENCES = 0xFF;
-                    U8 joint = weights[idx++];
-
-                    U32 cur_influence = 0;
-                    LLVector4 wght(0,0,0,0);
-                    U32 joints[4] = {0,0,0,0};
-                    LLVector4 joints_with_weights(0,0,0,0);
+                U32 consumed = 0;
+                const U32 decoded = ll_decode_mesh_weights(mdl_face.mWeights, mdl_face.mWeightsSize, num_verts, face.mWeights, consumed);
 
-                    while (joint != END_INFLUENCES && idx < weight_size)
-                    {
-                        U16 influence = weights[idx++];
-                        influence |= ((U16) weights[idx++] << 8);
-
-                        F32 w = llclamp((F32) influence / 65535.f, 0.001f, 0.999f);
-                        wght.mV[cur_influence] = w;
-                        joints[cur_influence] = joint;
-                        cur_influence++;
-
-                        if (cur_influence >= 4)
-                        {
-                            joint = END_INFLUENCES;
-                        }
-                        else
-                        {
-                            joint = weights[idx++];
-                        }
-                    }
-                    F32 wsum = wght.mV[VX] + wght.mV[VY] + wght.mV[VZ] + wght.mV[VW];
-                    if (wsum <= 0.f)
-                    {
-                        wght = LLVector4(0.999f,0.f,0.f,0.f);
-                    }
-                    for (U32 k=0; k<4; k++)
-                    {
-                        F32 f_combined = (F32) joints[k] + wght[k];
-                        joints_with_weights[k] = f_combined;
-                        // Any weights we added above should wind up non-zero and applied to a specific bone.
-                        // A failure here would indicate a floating point precision error in the math.
-                        llassert((k >= cur_influence) || (f_combined - S32(f_combined) > 0.0f));
-                    }
-                    face.mWeights[cur_vertex].loadua(joints_with_weights.mV);
-
-                    cur_vertex++;
-                }
-
-                if (cur_vertex != num_verts || idx != weights.size())
+                if (decoded != num_verts || consumed != mdl_face.mWeightsSize)
                 {
                     LL_WARNS() << "Vertex weight count does not match vertex count!" << LL_ENDL;
                 }
@@ -2730,6 +2736,147 @@ bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
     return true;
 }
 
+// Bumped whenever the layout below or the faces createVolumeFaces() makes
+// change, so that older cached faces are no longer used
+static const U32 FACE_CACHE_VERSION = 1;
+
+void LLVolume::packFaceCache(std::vector<U8>& data) const
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME;
+
+    data.clear();
+    auto write = [&data](const void* src, size_t bytes)
+    {
+        const U8* begin = (const U8*)src;
+        data.insert(data.end(), begin, begin + bytes);
+    };
+
+    const U32 num_faces = (U32)mVolumeFaces.size();
+    write(&FACE_CACHE_VERSION, sizeof(U32));
+    write(&num_faces, sizeof(U32));
+    for (const LLVolumeFace& face : mVolumeFaces)
+    {
+        const U32 num_edges = (U32)face.mEdge.size();
+        const U32 has_tangents = face.mTangents ? 1 : 0;
+        write(&face.mID, sizeof(S32));
+        write(&face.mTypeMask, sizeof(U32));
+        write(&face.mBeginS, sizeof(S32));
+        write(&face.mBeginT, sizeof(S32));
+        write(&face.mNumS, sizeof(S32));
+        write(&face.mNumT, sizeof(S32));
+        // minimum, maximum and center
+        write(face.mExtents, sizeof(LLVector4a) * 3);
+        write(face.mTexCoordExtents, sizeof(LLVector2) * 2);
+        write(&face.mNumVertices, sizeof(S32));
+        write(&face.mNumIndices, sizeof(S32));
+        write(&num_edges, sizeof(U32));
+        write(&has_tangents, sizeof(U32));
+
+        write(face.mPositions, sizeof(LLVector4a) * face.mNumVertices);
+        write(face.mNormals, sizeof(LLVector4a) * face.mNumVertices);
+        write(face.mTexCoords, sizeof(LLVector2) * face.mNumVertices);
+        if (has_tangents)
+        {
+            write(face.mTangents, sizeof(LLVector4a) * face.mNumVertices);
+        }
+        write(face.mIndices, sizeof(U16) * face.mNumIndices);
+        write(face.mEdge.data(), sizeof(S32) * num_edges);
+    }
+}
+
+bool LLVolume::unpackFaceCache(const U8* data, size_t size)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME;
+
+    size_t offset = 0;
+    auto read = [data, size, &offset](void* dst, size_t bytes)
+    {
+        if (bytes > size - offset)
+        {
+            return false;
+        }
+        if (bytes)
+        {
+            memcpy(dst, data + offset, bytes);
+        }
+        offset += bytes;
+        return true;
+    };
+
+    U32 version = 0;
+    U32 num_faces = 0;
+    if (!read(&version, sizeof(U32)) || version != FACE_CACHE_VERSION ||
+        !read(&num_faces, sizeof(U32)) || (S32)num_faces != getNumFaces())
+    {
+        return false;
+    }
+
+    mVolumeFaces.clear();
+    mVolumeFaces.resize(num_faces);
+    for (LLVolumeFace& face : mVolumeFaces)
+    {
+        S32 num_vertices = 0;
+        S32 num_indices = 0;
+        U32 num_edges = 0;
+        U32 has_tangents = 0;
+        bool ok = read(&face.mID, sizeof(S32)) &&
+                  read(&face.mTypeMask, sizeof(U32)) &&
+                  read(&face.mBeginS, sizeof(S32)) &&
+                  read(&face.mBeginT, sizeof(S32)) &&
+                  read(&face.mNumS, sizeof(S32)) &&
+                  read(&face.mNumT, sizeof(S32)) &&
+                  read(face.mExtents, sizeof(LLVector4a) * 3) &&
+                  read(face.mTexCoordExtents, sizeof(LLVector2) * 2) &&
+                  read(&num_vertices, sizeof(S32)) &&
+                  read(&num_indices, sizeof(S32)) &&
+                  read(&num_edges, sizeof(U32)) &&
+                  read(&has_tangents, sizeof(U32));
+
+        // Indices are 16 bits, check the counts before allocating anything
+        ok = ok && num_vertices >= 0 && num_vertices <= 65536 &&
+             num_indices >= 0 && num_indices % 3 == 0 &&
+             (size_t)num_indices * sizeof(U16) + (size_t)num_edges * sizeof(S32) <= size - offset;
+        if (ok)
+        {
+            face.resizeVertices(num_vertices);
+            face.resizeIndices(num_indices);
+            ok = face.mNumVertices == num_vertices && face.mNumIndices == num_indices &&
+                 read(face.mPositions, sizeof(LLVector4a) * num_vertices) &&
+                 read(face.mNormals, sizeof(LLVector4a) * num_vertices) &&
+                 read(face.mTexCoords, sizeof(LLVector2) * num_vertices);
+        }
+        if (ok && has_tangents)
+        {
+            face.allocateTangents(num_vertices);
+            ok = read(face.mTangents, sizeof(LLVector4a) * num_vertices);
+        }
+        if (ok)
+        {
+            face.mEdge.resize(num_edges);
+            ok = read(face.mIndices, sizeof(U16) * num_indices) &&
+                 read(face.mEdge.data(), sizeof(S32) * num_edges);
+        }
+        for (S32 i = 0; ok && i < num_indices; ++i)
+        {
+            ok = face.mIndices[i] < num_vertices;
+        }
+
+        if (!ok)
+        {
+            LL_WARNS() << "Cached volume faces do not match " << mParams << LL_ENDL;
+            mVolumeFaces.clear();
+            return false;
+        }
+    }
+
+    if (offset != size)
+    {
+        mVolumeFaces.clear();
+        return false;
+    }
+    return true;
+}
+
 
 bool LLVolume::isMeshAssetLoaded()
 {
@@ -4082,8 +4229,24 @@ S32 LLVolume::lineSegmentIntersect(const LLVector4a& start, const LLVector4a& en
                 genTangents(i);
             }
 
-            if (isUnique())
-            { //don't bother with an octree for flexi volumes
+            const LLVolumeBVH* bvh = NULL;
+            if (!isUnique())
+            { //don't bother with a BVH for flexi volumes
+                face.requestBVH();
+                bvh = face.getBVH();
+            }
+
+            U16 idx[3];
+            F32 a = 0.f;
+            F32 b = 0.f;
+            bool hit = false;
+
+            if (bvh)
+            {
+                hit = bvh->intersect(face.mPositions, start, dir, closest_t, a, b, idx);
+            }
+            else
+            { //flexi volume, or BVH still being built
                 U32 tri_count = face.mNumIndices/3;
 
                 for (U32 j = 0; j < tri_count; ++j)
@@ -4096,91 +4259,85 @@ S32 LLVolume::lineSegmentIntersect(const LLVector4a& start, const LLVector4a& en
                     const LLVector4a& v1 = face.mPositions[idx1];
                     const LLVector4a& v2 = face.mPositions[idx2];
 
-                    F32 a,b,t;
+                    F32 tri_a, tri_b, t;
 
                     if (LLTriangleRayIntersect(v0, v1, v2,
-                            start, dir, a, b, t))
+                            start, dir, tri_a, tri_b, t))
                     {
                         if ((t >= 0.f) &&      // if hit is after start
                             (t <= 1.f) &&      // and before end
                             (t < closest_t))   // and this hit is closer
                         {
                             closest_t = t;
-                            hit_face = i;
-
-                            if (intersection != NULL)
-                            {
-                                LLVector4a intersect = dir;
-                                intersect.mul(closest_t);
-                                intersect.add(start);
-                                *intersection = intersect;
-                            }
-
+                            a = tri_a;
+                            b = tri_b;
+                            idx[0] = idx0;
+                            idx[1] = idx1;
+                            idx[2] = idx2;
+                            hit = true;
+                        }
+                    }
+                }
+            }
 
-                            if (tex_coord != NULL)
-                            {
-                                LLVector2* tc = (LLVector2*) face.mTexCoords;
-                                *tex_coord = ((1.f - a - b)  * tc[idx0] +
-                                    a              * tc[idx1] +
-                                    b              * tc[idx2]);
+            if (hit)
+            {
+                hit_face = i;
 
-                            }
+                if (intersection != NULL)
+                {
+                    LLVector4a intersect = dir;
+                    intersect.mul(closest_t);
+                    intersect.add(start);
+                    *intersection = intersect;
+                }
 
-                            if (normal!= NULL)
-                            {
-                                LLVector4a* norm = face.mNormals;
+                if (tex_coord != NULL)
+                {
+                    LLVector2* tc = (LLVector2*) face.mTexCoords;
+                    *tex_coord = ((1.f - a - b)  * tc[idx[0]] +
+                        a              * tc[idx[1]] +
+                        b              * tc[idx[2]]);
+                }
 
-                                LLVector4a n1,n2,n3;
-                                n1 = norm[idx0];
-                                n1.mul(1.f-a-b);
+                if (normal!= NULL)
+                {
+                    LLVector4a* norm = face.mNormals;
 
-                                n2 = norm[idx1];
-                                n2.mul(a);
+                    LLVector4a n1,n2,n3;
+                    n1 = norm[idx[0]];
+                    n1.mul(1.f-a-b);
 
-                                n3 = norm[idx2];
-                                n3.mul(b);
+                    n2 = norm[idx[1]];
+                    n2.mul(a);
 
-                                n1.add(n2);
-                                n1.add(n3);
+                    n3 = norm[idx[2]];
+                    n3.mul(b);
 
-                                *normal     = n1;
-                            }
+                    n1.add(n2);
+                    n1.add(n3);
 
-                            if (tangent_out != NULL)
-                            {
-                                LLVector4a* tangents = face.mTangents;
+                    *normal     = n1;
+                }
 
-                                LLVector4a t1,t2,t3;
-                                t1 = tangents[idx0];
-                                t1.mul(1.f-a-b);
+                if (tangent_out != NULL)
+                {
+                    LLVector4a* tangents = face.mTangents;
 
-                                t2 = tangents[idx1];
-                                t2.mul(a);
+                    LLVector4a t1,t2,t3;
+                    t1 = tangents[idx[0]];
+                    t1.mul(1.f-a-b);
 
-                                t3 = tangents[idx2];
-                                t3.mul(b);
+                    t2 = tangents[idx[1]];
+                    t2.mul(a);
 
-                                t1.add(t2);
-                                t1.add(t3);
+                    t3 = tangents[idx[2]];
+                    t3.mul(b);
 
-                                *tangent_out = t1;
-                            }
-                        }
-                    }
-                }
-            }
-            else
-            {
-                if (!face.getOctree())
-                {
-                    face.createOctree();
-                }
+                    t1.add(t2);
+                    t1.add(t3);
 
-                LLOctreeTriangleRayIntersect intersect(start, dir, &face, &closest_t, intersection, tex_coord, normal, tangent_out);
-                intersect.traverse(face.getOctree());
-                if (intersect.mHitFace)
-                {
-                    hit_face = i;
+                    *tangent_out = t1;
                 }
             }
         }
@@ -4897,6 +5054,7 @@ void LLVolumeFace::freeData()
 #endif
 
     destroyOctree();
+    destroyBVH();
 }
 
 BOOL LLVolumeFace::create(LLVolume* volume, BOOL partial_build)
@@ -4905,6 +5063,7 @@ BOOL LLVolumeFace::create(LLVolume* volume, BOOL partial_build)
 
     //tree for this face is no longer valid
     destroyOctree();
+    destroyBVH();
 
     LL_CHECK_MEMORY
     BOOL ret = FALSE ;
@@ -5673,6 +5832,42 @@ const LLVolumeOctree* LLVolumeFace::getOctree() const
     return mOctree;
 }
 
+void LLVolumeFace::requestBVH()
+{
+    if (mBVH)
+    {
+        // A build in progress used the old positions, it is refit once done
+        if (mBVHStale && mBVH->isReady())
+        {
+            mBVH->refit(mPositions);
+            mBVHStale = false;
+        }
+    }
+    else if (mPositions && mIndices && mNumIndices >= 3)
+    {
+        mBVH = std::make_shared<LLVolumeBVH>(mPositions, mNumVertices, mIndices, mNumIndices);
+        mBVHStale = false;
+        LLVolumeBVH::buildAsync(mBVH);
+    }
+}
+
+void LLVolumeFace::destroyBVH()
+{
+    // A build in progress keeps its own reference
+    mBVH.reset();
+    mBVHStale = false;
+}
+
+void LLVolumeFace::refitBVH()
+{
+    mBVHStale = mBVH != nullptr;
+}
+
+const LLVolumeBVH* LLVolumeFace::getBVH() const
+{
+    return mBVH && !mBVHStale && mBVH->isReady() ? mBVH.get() : nullptr;
+}
+
 
 void LLVolumeFace::swapData(LLVolumeFace& rhs)
 {
@@ -5683,6 +5878,9 @@ void LLVolumeFace::swapData(LLVolumeFace& rhs)
     llswap(rhs.mIndices,mIndices);
     llswap(rhs.mNumVertices, mNumVertices);
     llswap(rhs.mNumIndices, mNumIndices);
+    // Built over the data it goes with
+    mBVH.swap(rhs.mBVH);
+    llswap(rhs.mBVHStale, mBVHStale);
 }
 
 void    LerpPlanarVertex(LLVolumeFace::VertexData& v0,
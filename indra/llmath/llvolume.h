@@ -27,7 +27,9 @@
 #ifndef LL_LLVOLUME_H
 #define LL_LLVOLUME_H
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 
 class LLProfileParams;
 class LLPathParams;
@@ -42,6 +44,8 @@ class LLVolumeFace;
 class LLVolume;
 class LLVolumeTriangle;
 class LLVolumeOctree;
+class LLVolumeBVH;
+class LLSDBinaryReader;
 
 #include "lluuid.h"
 #include "v4color.h"
@@ -919,6 +923,16 @@ class LLVolumeFace
     // Get a reference to the octree, which may be null
     const LLVolumeOctree* getOctree() const;
 
+    // Starts building the BVH used by ray casts, on a worker thread for
+    // bigger faces
+    void requestBVH();
+    void destroyBVH();
+    // The positions moved but the triangles did not, the BVH is refit to
+    // them by the next requestBVH() rather than built again
+    void refitBVH();
+    // The BVH once built and fit to the positions, null until then
+    const LLVolumeBVH* getBVH() const;
+
     enum
     {
         SINGLE_MASK =   0x0001,
@@ -988,6 +1002,8 @@ class LLVolumeFace
 private:
     LLVolumeOctree* mOctree;
     LLVolumeTriangle* mOctreeTriangles;
+    std::shared_ptr<LLVolumeBVH> mBVH;
+    bool mBVHStale = false;
 
     BOOL createUnCutCubeCap(LLVolume* volume, BOOL partial_build = FALSE);
     BOOL createCap(LLVolume* volume, BOOL partial_build = FALSE);
@@ -1013,7 +1029,10 @@ class LLVolume : public LLRefCount
         S32 mCountT;
     };
 
-    LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face = FALSE, const BOOL is_unique = FALSE);
+    // create_faces = FALSE leaves the faces of prims and meshes to be made
+    // later, by createVolumeFaces() or unpackFaceCache()
+    LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face = FALSE, const BOOL is_unique = FALSE,
+             const BOOL create_faces = TRUE);
 
     U8 getProfileType() const                               { return mParams.getProfileParams().getCurveType(); }
     U8 getPathType() const                                  { return mParams.getPathParams().getCurveType(); }
@@ -1069,7 +1088,7 @@ class LLVolume : public LLRefCount
     LLFaceID generateFaceMask();
 
     BOOL isFaceMaskValid(LLFaceID face_mask);
-    static S32 sNumMeshPoints;
+    static std::atomic<S32> sNumMeshPoints;
 
     friend std::ostream& operator<<(std::ostream &s, const LLVolume &volume);
     friend std::ostream& operator<<(std::ostream &s, const LLVolume *volumep);      // HACK to bypass Windoze confusion over
@@ -1106,8 +1125,15 @@ class LLVolume : public LLRefCount
 public:
     bool unpackVolumeFaces(std::istream& is, S32 size);
     bool unpackVolumeFaces(U8* in_data, S32 size);
+
+    // Raw copy of the faces made by createVolumeFaces(), to be kept on disk
+    // by the same build of the viewer, and read back in place of creating
+    // them. unpackFaceCache() leaves the volume without faces when the data
+    // does not fit it.
+    void packFaceCache(std::vector<U8>& data) const;
+    bool unpackFaceCache(const U8* data, size_t size);
 private:
-    bool unpackVolumeFacesInternal(const LLSD& mdl);
+    bool unpackVolumeFacesInternal(LLSDBinaryReader& reader);
 
 public:
     virtual void setMeshAssetLoaded(bool loaded);
@@ -0,0 +1,670 @@
+/**
+ * @file llvolumebvh.cpp
+ * @brief Bounding volume hierarchy over the triangles of a volume face,
+ * for ray casts.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvolumebvh.h"
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cfloat>
+
+// Triangles per leaf, tested at once
+static const U32 LEAF_SIZE = 4;
+// Centroid bins the surface area heuristic evaluates splits between
+static const U32 SAH_BINS = 16;
+// Deeper than this, a degenerate mesh is split at the median instead, which
+// bounds the depth of the tree and so the traversal stack
+static const U32 SAH_MAX_DEPTH = 48;
+static const U32 STACK_SIZE = 256;
+// Smaller meshes are built on the calling thread, faster than a hand-off
+static const U32 ASYNC_MIN_TRIANGLES = 1024;
+
+static std::unique_ptr<LL::ThreadPool> sThreadPool;
+
+namespace
+{
+    F32 half_area(const LLVector4a& min, const LLVector4a& max)
+    {
+        LLVector4a size;
+        size.setSub(max, min);
+        const F32* s = size.getF32ptr();
+        return s[0] * s[1] + s[1] * s[2] + s[2] * s[0];
+    }
+
+    void set_empty(LLVector4a& min, LLVector4a& max)
+    {
+        min.splat(FLT_MAX);
+        max.splat(-FLT_MAX);
+    }
+
+    void grow(LLVector4a& min, LLVector4a& max, const LLVector4a& other_min, const LLVector4a& other_max)
+    {
+        min.setMin(min, other_min);
+        max.setMax(max, other_max);
+    }
+}
+
+//============================================================================
+// Build
+//============================================================================
+
+// Binary node of the tree being built, collapsed into 4-wide ones afterwards
+struct alignas(16) LLVolumeBVH::BuildNode
+{
+    LLVector4a mMin;
+    LLVector4a mMax;
+    U32 mFirst;
+    U32 mCount;     // 0 for inner nodes
+    U32 mChild[2];
+};
+
+struct LLVolumeBVH::Builder
+{
+    Builder(LLVolumeBVH& bvh)
+    :   mBVH(bvh)
+    {
+        const U32 num_triangles = (U32)bvh.mIndices.size() / 3;
+        const U32 num_positions = (U32)bvh.mPositions.size();
+        mMin.reserve(num_triangles);
+        mMax.reserve(num_triangles);
+        mCentroids.reserve(num_triangles);
+        mOrder.reserve(num_triangles);
+
+        for (U32 i = 0; i < num_triangles; ++i)
+        {
+            const U16* tri = &bvh.mIndices[i * 3];
+            if (tri[0] >= num_positions || tri[1] >= num_positions || tri[2] >= num_positions)
+            {
+                // Bad mesh data, drop the triangle rather than read past the positions
+                continue;
+            }
+            const LLVector4a& v0 = bvh.mPositions[tri[0]];
+            const LLVector4a& v1 = bvh.mPositions[tri[1]];
+            const LLVector4a& v2 = bvh.mPositions[tri[2]];
+
+            LLVector4a min = v0;
+            min.setMin(min, v1);
+            min.setMin(min, v2);
+            LLVector4a max = v0;
+            max.setMax(max, v1);
+            max.setMax(max, v2);
+            LLVector4a centroid;
+            centroid.setAdd(min, max);
+            centroid.mul(0.5f);
+
+            mOrder.push_back(i);
+            mMin.push_back(min);
+            mMax.push_back(max);
+            mCentroids.push_back(centroid);
+        }
+    }
+
+    U32 buildNode(U32 first, U32 count, U32 depth)
+    {
+        const U32 index = (U32)mNodes.size();
+        mNodes.emplace_back();
+
+        LLVector4a min, max, centroid_min, centroid_max;
+        set_empty(min, max);
+        set_empty(centroid_min, centroid_max);
+        for (U32 i = first; i < first + count; ++i)
+        {
+            const U32 tri = mOrder[i];
+            grow(min, max, mMin[tri], mMax[tri]);
+            grow(centroid_min, centroid_max, mCentroids[tri], mCentroids[tri]);
+        }
+        mNodes[index].mMin = min;
+        mNodes[index].mMax = max;
+
+        if (count <= LEAF_SIZE)
+        {
+            mNodes[index].mFirst = first;
+            mNodes[index].mCount = count;
+            return index;
+        }
+
+        const U32 mid = split(first, count, depth, centroid_min, centroid_max);
+        const U32 left = buildNode(first, mid - first, depth + 1);
+        const U32 right = buildNode(mid, first + count - mid, depth + 1);
+        mNodes[index].mFirst = first;
+        mNodes[index].mCount = 0;
+        mNodes[index].mChild[0] = left;
+        mNodes[index].mChild[1] = right;
+        return index;
+    }
+
+    // Reorders the triangles of the range and returns where the second
+    // half starts
+    U32 split(U32 first, U32 count, U32 depth, const LLVector4a& centroid_min, const LLVector4a& centroid_max)
+    {
+        LLVector4a extent;
+        extent.setSub(centroid_max, centroid_min);
+        const F32* e = extent.getF32ptr();
+        const U32 axis = e[0] >= e[1] && e[0] >= e[2] ? 0 : (e[1] >= e[2] ? 1 : 2);
+        const U32 end = first + count;
+
+        if (e[axis] <= 0.f)
+        {
+            // All the centroids are the same point, any split will do
+            return first + count / 2;
+        }
+
+        if (depth < SAH_MAX_DEPTH)
+        {
+            const F32 origin = centroid_min.getF32ptr()[axis];
+            const F32 scale = (F32)SAH_BINS / e[axis];
+            auto bin_of = [&](U32 tri)
+            {
+                return llmin((U32)((mCentroids[tri].getF32ptr()[axis] - origin) * scale), SAH_BINS - 1);
+            };
+
+            LLVector4a bin_min[SAH_BINS], bin_max[SAH_BINS];
+            U32 bin_count[SAH_BINS] = {};
+            for (U32 b = 0; b < SAH_BINS; ++b)
+            {
+                set_empty(bin_min[b], bin_max[b]);
+            }
+            for (U32 i = first; i < end; ++i)
+            {
+                const U32 tri = mOrder[i];
+                const U32 b = bin_of(tri);
+                ++bin_count[b];
+                grow(bin_min[b], bin_max[b], mMin[tri], mMax[tri]);
+            }
+
+            // Cost of the splits before each bin, from the left then the right
+            F32 left_cost[SAH_BINS];
+            LLVector4a min, max;
+            set_empty(min, max);
+            U32 left_count = 0;
+            for (U32 b = 0; b < SAH_BINS - 1; ++b)
+            {
+                grow(min, max, bin_min[b], bin_max[b]);
+                left_count += bin_count[b];
+                left_cost[b + 1] = left_count ? half_area(min, max) * left_count : 0.f;
+            }
+
+            F32 best_cost = FLT_MAX;
+            U32 best_bin = 0;
+            set_empty(min, max);
+            U32 right_count = 0;
+            for (U32 b = SAH_BINS - 1; b > 0; --b)
+            {
+                grow(min, max, bin_min[b], bin_max[b]);
+                right_count += bin_count[b];
+                if (right_count == 0 || right_count == count)
+                {
+                    continue;
+                }
+                const F32 cost = left_cost[b] + half_area(min, max) * right_count;
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_bin = b;
+                }
+            }
+
+            if (best_bin)
+            {
+                auto it = std::partition(mOrder.begin() + first, mOrder.begin() + end,
+                                         [&](U32 tri) { return bin_of(tri) < best_bin; });
+                return (U32)(it - mOrder.begin());
+            }
+        }
+
+        // Too deep or no split found, halve it
+        const U32 mid = first + count / 2;
+        std::nth_element(mOrder.begin() + first, mOrder.begin() + mid, mOrder.begin() + end,
+                         [&](U32 a, U32 b)
+                         {
+                             return mCentroids[a].getF32ptr()[axis] < mCentroids[b].getF32ptr()[axis];
+                         });
+        return mid;
+    }
+
+    // Makes a 4-wide node of the binary node index and the nodes under it
+    U32 collapse(U32 index)
+    {
+        U32 children[4];
+        U32 count = 0;
+        const BuildNode& node = mNodes[index];
+        if (node.mCount)
+        {
+            // Root leaf
+            children[count++] = index;
+        }
+        else
+        {
+            children[count++] = node.mChild[0];
+            children[count++] = node.mChild[1];
+        }
+
+        // Open the largest inner children until there are 4
+        while (count < 4)
+        {
+            S32 largest = -1;
+            F32 largest_area = -1.f;
+            for (U32 i = 0; i < count; ++i)
+            {
+                const BuildNode& child = mNodes[children[i]];
+                const F32 area = half_area(child.mMin, child.mMax);
+                if (!child.mCount && area > largest_area)
+                {
+                    largest = i;
+                    largest_area = area;
+                }
+            }
+            if (largest < 0)
+            {
+                break;
+            }
+            const BuildNode& child = mNodes[children[largest]];
+            children[largest] = child.mChild[0];
+            children[count++] = child.mChild[1];
+        }
+
+        const U32 wide = (U32)mBVH.mNodes.size();
+        mBVH.mNodes.emplace_back();
+        for (U32 i = 0; i < 4; ++i)
+        {
+            LLVector4a min, max;
+            U32 child_index = 0;
+            U32 child_count = 0;
+            if (i < count)
+            {
+                const BuildNode& child = mNodes[children[i]];
+                min = child.mMin;
+                max = child.mMax;
+                if (child.mCount)
+                {
+                    child_index = child.mFirst;
+                    child_count = child.mCount;
+                }
+                else
+                {
+                    child_index = collapse(children[i]);
+                }
+            }
+            else
+            {
+                set_empty(min, max);
+            }
+
+            // collapse() grows mNodes, only index into it now
+            Node& out = mBVH.mNodes[wide];
+            for (U32 axis = 0; axis < 3; ++axis)
+            {
+                out.mBounds[axis].getF32ptr()[i] = min.getF32ptr()[axis];
+                out.mBounds[axis + 3].getF32ptr()[i] = max.getF32ptr()[axis];
+            }
+            out.mChild[i] = child_index;
+            out.mCount[i] = child_count;
+        }
+        return wide;
+    }
+
+    void build()
+    {
+        const U32 num_triangles = (U32)mOrder.size();
+        if (!num_triangles)
+        {
+            return;
+        }
+
+        mNodes.reserve(num_triangles / 2 + 1);
+        buildNode(0, num_triangles, 0);
+
+        mBVH.mNodes.reserve(mNodes.size() / 2 + 1);
+        collapse(0);
+        mBVH.mNodes.shrink_to_fit();
+
+        mBVH.mTriangles.resize(num_triangles * 3);
+        for (U32 i = 0; i < num_triangles; ++i)
+        {
+            const U16* tri = &mBVH.mIndices[mOrder[i] * 3];
+            std::copy(tri, tri + 3, &mBVH.mTriangles[i * 3]);
+        }
+    }
+
+    LLVolumeBVH& mBVH;
+    std::vector<BuildNode> mNodes;
+    // Per triangle
+    std::vector<LLVector4a> mMin;
+    std::vector<LLVector4a> mMax;
+    std::vector<LLVector4a> mCentroids;
+    // Triangles in leaf order
+    std::vector<U32> mOrder;
+};
+
+LLVolumeBVH::LLVolumeBVH(const LLVector4a* positions, U32 num_positions, const U16* indices, U32 num_indices)
+:   mPositions(positions, positions + num_positions),
+    mIndices(indices, indices + num_indices - num_indices % 3),
+    mReady(false)
+{
+}
+
+void LLVolumeBVH::build()
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME;
+
+    if (isReady())
+    {
+        return;
+    }
+
+    {
+        Builder builder(*this);
+        builder.build();
+    }
+
+    std::vector<LLVector4a>().swap(mPositions);
+    std::vector<U16>().swap(mIndices);
+    mReady.store(true, std::memory_order_release);
+}
+
+void LLVolumeBVH::refit(const LLVector4a* positions)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME;
+
+    if (!isReady())
+    {
+        return;
+    }
+
+    // Children are collapsed after their parents, so going backwards visits
+    // them first
+    for (size_t n = mNodes.size(); n-- > 0; )
+    {
+        Node& node = mNodes[n];
+        for (U32 i = 0; i < 4; ++i)
+        {
+            LLVector4a min, max;
+            set_empty(min, max);
+            if (node.mCount[i])
+            {
+                const U16* tri = &mTriangles[node.mChild[i] * 3];
+                for (U32 k = 0; k < node.mCount[i] * 3; ++k)
+                {
+                    grow(min, max, positions[tri[k]], positions[tri[k]]);
+                }
+            }
+            else if (node.mChild[i])
+            {
+                // The root is never a child, unused children refer to it
+                const Node& child = mNodes[node.mChild[i]];
+                for (U32 j = 0; j < 4; ++j)
+                {
+                    LLVector4a child_min, child_max;
+                    for (U32 axis = 0; axis < 3; ++axis)
+                    {
+                        child_min.getF32ptr()[axis] = child.mBounds[axis].getF32ptr()[j];
+                        child_max.getF32ptr()[axis] = child.mBounds[axis + 3].getF32ptr()[j];
+                    }
+                    grow(min, max, child_min, child_max);
+                }
+            }
+
+            for (U32 axis = 0; axis < 3; ++axis)
+            {
+                node.mBounds[axis].getF32ptr()[i] = min.getF32ptr()[axis];
+                node.mBounds[axis + 3].getF32ptr()[i] = max.getF32ptr()[axis];
+            }
+        }
+    }
+}
+
+size_t LLVolumeBVH::getMemoryUsage() const
+{
+    return sizeof(*this) + mNodes.capacity() * sizeof(Node) + mTriangles.capacity() * sizeof(U16)
+        + mPositions.capacity() * sizeof(LLVector4a) + mIndices.capacity() * sizeof(U16);
+}
+
+//static
+void LLVolumeBVH::initClass(size_t threads)
+{
+    if (!sThreadPool)
+    {
+        sThreadPool = std::make_unique<LL::ThreadPool>("VolumeBVH", threads);
+        sThreadPool->start();
+    }
+}
+
+//static
+void LLVolumeBVH::cleanupClass()
+{
+    if (sThreadPool)
+    {
+        sThreadPool->close();
+        sThreadPool.reset();
+    }
+}
+
+//static
+bool LLVolumeBVH::buildAsync(const std::shared_ptr<LLVolumeBVH>& bvh)
+{
+    if (sThreadPool && bvh->mIndices.size() / 3 >= ASYNC_MIN_TRIANGLES)
+    {
+        // Keeps the BVH alive even if its face lets go of it first
+        std::shared_ptr<LLVolumeBVH> pending = bvh;
+        if (sThreadPool->getQueue().post([pending]() { pending->build(); }))
+        {
+            return true;
+        }
+    }
+
+    bvh->build();
+    return false;
+}
+
+//============================================================================
+// Traversal
+//============================================================================
+
+bool LLVolumeBVH::intersect(const LLVector4a* positions, const LLVector4a& start, const LLVector4a& dir,
+                            F32& closest_t, F32& a, F32& b, U16 indices[3]) const
+{
+    if (!isReady() || mNodes.empty())
+    {
+        return false;
+    }
+
+    // Slabs of each axis, entered through the minima of the boxes when going
+    // up that axis, through their maxima otherwise
+    const F32* d = dir.getF32ptr();
+    const F32* o = start.getF32ptr();
+    LLQuad origin[3];
+    LLQuad inv_dir[3];
+    U32 near_bound[3];
+    for (U32 axis = 0; axis < 3; ++axis)
+    {
+        // Keeps axis aligned rays away from 0 * inf
+        const F32 component = fabsf(d[axis]) > 1e-20f ? d[axis] : (d[axis] < 0.f ? -1e-20f : 1e-20f);
+        origin[axis] = _mm_set1_ps(o[axis]);
+        inv_dir[axis] = _mm_set1_ps(1.f / component);
+        near_bound[axis] = component < 0.f ? axis + 3 : axis;
+    }
+
+    struct Entry
+    {
+        U32 mChild;
+        U32 mCount;
+        F32 mNear;
+    };
+    Entry stack[STACK_SIZE];
+    U32 depth = 0;
+    stack[depth++] = { 0, 0, 0.f };
+
+    S32 hit = -1;
+    const LLQuad zero = _mm_setzero_ps();
+
+    while (depth)
+    {
+        const Entry entry = stack[--depth];
+        if (entry.mNear > closest_t)
+        {
+            continue;
+        }
+
+        if (entry.mCount)
+        {
+            intersectLeaf(positions, entry.mChild, entry.mCount, start, dir, closest_t, a, b, hit);
+            continue;
+        }
+
+        const Node& node = mNodes[entry.mChild];
+        LLQuad t_near = zero;
+        LLQuad t_far = _mm_set1_ps(llmin(closest_t, 1.f));
+        for (U32 axis = 0; axis < 3; ++axis)
+        {
+            const U32 near_index = near_bound[axis];
+            const U32 far_index = near_index < 3 ? near_index + 3 : near_index - 3;
+            t_near = _mm_max_ps(t_near, _mm_mul_ps(_mm_sub_ps(node.mBounds[near_index], origin[axis]), inv_dir[axis]));
+            t_far = _mm_min_ps(t_far, _mm_mul_ps(_mm_sub_ps(node.mBounds[far_index], origin[axis]), inv_dir[axis]));
+        }
+        const S32 mask = _mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+        if (!mask)
+        {
+            continue;
+        }
+
+        // Push the children hit farthest first, to visit the nearest first
+        LL_ALIGN_16(F32 near_t[4]);
+        _mm_store_ps(near_t, t_near);
+        Entry hits[4];
+        U32 num_hits = 0;
+        for (U32 i = 0; i < 4; ++i)
+        {
+            if (mask & (1 << i))
+            {
+                Entry child = { node.mChild[i], node.mCount[i], near_t[i] };
+                U32 j = num_hits++;
+                for (; j > 0 && hits[j - 1].mNear < child.mNear; --j)
+                {
+                    hits[j] = hits[j - 1];
+                }
+                hits[j] = child;
+            }
+        }
+        llassert(depth + num_hits <= STACK_SIZE);
+        for (U32 i = 0; i < num_hits; ++i)
+        {
+            stack[depth++] = hits[i];
+        }
+    }
+
+    if (hit < 0)
+    {
+        return false;
+    }
+
+    std::copy(&mTriangles[hit * 3], &mTriangles[hit * 3 + 3], indices);
+    return true;
+}
+
+void LLVolumeBVH::intersectLeaf(const LLVector4a* positions, U32 first, U32 count,
+                                const LLVector4a& start, const LLVector4a& dir,
+                                F32& closest_t, F32& a, F32& b, S32& hit) const
+{
+    // Vertices of the 4 triangles, the last one repeated to fill the leaf,
+    // transposed so that each quad holds one coordinate of all 4
+    LLQuad v[3][4];
+    for (U32 i = 0; i < 4; ++i)
+    {
+        const U16* tri = &mTriangles[(first + llmin(i, count - 1)) * 3];
+        for (U32 k = 0; k < 3; ++k)
+        {
+            v[k][i] = positions[tri[k]];
+        }
+    }
+    for (U32 k = 0; k < 3; ++k)
+    {
+        _MM_TRANSPOSE4_PS(v[k][0], v[k][1], v[k][2], v[k][3]);
+    }
+
+    const LLQuad dx = _mm_set1_ps(dir[0]);
+    const LLQuad dy = _mm_set1_ps(dir[1]);
+    const LLQuad dz = _mm_set1_ps(dir[2]);
+
+    // Moller-Trumbore, as in LLTriangleRayIntersect()
+    const LLQuad e1x = _mm_sub_ps(v[1][0], v[0][0]);
+    const LLQuad e1y = _mm_sub_ps(v[1][1], v[0][1]);
+    const LLQuad e1z = _mm_sub_ps(v[1][2], v[0][2]);
+    const LLQuad e2x = _mm_sub_ps(v[2][0], v[0][0]);
+    const LLQuad e2y = _mm_sub_ps(v[2][1], v[0][1]);
+    const LLQuad e2z = _mm_sub_ps(v[2][2], v[0][2]);
+
+    const LLQuad px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const LLQuad py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const LLQuad pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+    const LLQuad det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+
+    const LLQuad tx = _mm_sub_ps(_mm_set1_ps(start[0]), v[0][0]);
+    const LLQuad ty = _mm_sub_ps(_mm_set1_ps(start[1]), v[0][1]);
+    const LLQuad tz = _mm_sub_ps(_mm_set1_ps(start[2]), v[0][2]);
+
+    const LLQuad u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz));
+
+    const LLQuad qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    const LLQuad qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    const LLQuad qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+    const LLQuad vv = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz));
+    const LLQuad t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz));
+
+    const LLQuad zero = _mm_setzero_ps();
+    LLQuad mask = _mm_cmpge_ps(det, LLVector4a::getEpsilon());
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(u, det));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(vv, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, vv), det));
+    S32 bits = _mm_movemask_ps(mask) & ((1 << count) - 1);
+    if (!bits)
+    {
+        return;
+    }
+
+    LL_ALIGN_16(F32 t_hit[4]);
+    LL_ALIGN_16(F32 a_hit[4]);
+    LL_ALIGN_16(F32 b_hit[4]);
+    _mm_store_ps(t_hit, _mm_div_ps(t, det));
+    _mm_store_ps(a_hit, _mm_div_ps(u, det));
+    _mm_store_ps(b_hit, _mm_div_ps(vv, det));
+
+    for (U32 i = 0; i < count; ++i)
+    {
+        if ((bits & (1 << i)) && t_hit[i] >= 0.f && t_hit[i] <= 1.f && t_hit[i] < closest_t)
+        {
+            closest_t = t_hit[i];
+            a = a_hit[i];
+            b = b_hit[i];
+            hit = (S32)(first + i);
+        }
+    }
+}
@@ -0,0 +1,120 @@
+/**
+ * @file llvolumebvh.h
+ * @brief Bounding volume hierarchy over the triangles of a volume face,
+ * for ray casts.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOLUMEBVH_H
+#define LL_LLVOLUMEBVH_H
+
+#include "llmath.h"
+#include "llvector4a.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//============================================================================
+// LLVolumeBVH
+//
+// Flat bounding volume hierarchy of 4-wide nodes, built with the surface
+// area heuristic over triangles given as 16 bits indices into positions.
+// Nodes are stored in one array and refer to their children by index, the
+// bounds of the 4 children are laid out for testing a ray against all of
+// them at once, and each leaf holds up to 4 triangles tested at once too.
+//
+// The BVH keeps the indices of its triangles, not their positions, which
+// are passed to intersect() like LLVolumeOctree reads them from the face.
+//
+// build() may run on another thread than intersect(), isReady() tells when
+// it is done. LLVolumeFace::requestBVH() builds it on the "VolumeBVH"
+// thread pool when it has been started with initClass().
+//============================================================================
+
+class LLVolumeBVH
+{
+public:
+    // Copies what build() needs, num_indices / 3 triangles
+    LLVolumeBVH(const LLVector4a* positions, U32 num_positions, const U16* indices, U32 num_indices);
+
+    void build();
+    bool isReady() const { return mReady.load(std::memory_order_acquire); }
+
+    // Finds the closest triangle hit by the segment start + t * dir with
+    // 0 <= t <= 1 and t < closest_t, with the same rules as
+    // LLTriangleRayIntersect(). On a hit, updates closest_t, sets the
+    // barycentric coordinates (1 - a - b, a, b) of the hit over the
+    // vertices indices[0], indices[1], indices[2], and returns true.
+    bool intersect(const LLVector4a* positions, const LLVector4a& start, const LLVector4a& dir,
+                   F32& closest_t, F32& a, F32& b, U16 indices[3]) const;
+
+    // Recomputes the bounds of the nodes over moved positions, keeping the
+    // tree as built. Cheaper than building it again, though the tree gets
+    // looser the more the triangles moved relative to each other.
+    void refit(const LLVector4a* positions);
+
+    U32 getNumNodes() const { return (U32)mNodes.size(); }
+    U32 getNumTriangles() const { return (U32)(mTriangles.size() / 3); }
+    size_t getMemoryUsage() const;
+
+    // Start and stop the worker threads. threads is the default width of
+    // the pool, the "VolumeBVH" entry of ThreadPoolSizes overrides it.
+    // Without them, BVHs are built on the calling thread.
+    static void initClass(size_t threads);
+    static void cleanupClass();
+
+    // Builds bvh on a worker thread, or right away without them. Returns
+    // false when built right away.
+    static bool buildAsync(const std::shared_ptr<LLVolumeBVH>& bvh);
+
+private:
+    struct alignas(16) Node
+    {
+        // Bounds of the 4 children, x, y and z of their minima then maxima
+        LLVector4a mBounds[6];
+        // Inner node index when mCount is 0, first triangle of the leaf
+        // otherwise. Unused children have an empty box and a 0 count.
+        U32 mChild[4];
+        U32 mCount[4];
+    };
+
+    struct BuildNode;
+    struct Builder;
+
+    void intersectLeaf(const LLVector4a* positions, U32 first, U32 count,
+                       const LLVector4a& start, const LLVector4a& dir,
+                       F32& closest_t, F32& a, F32& b, S32& hit) const;
+
+    std::vector<Node> mNodes;
+    // 3 indices per triangle, in leaf order
+    std::vector<U16> mTriangles;
+
+    // Build input, released once built
+    std::vector<LLVector4a> mPositions;
+    std::vector<U16> mIndices;
+
+    std::atomic<bool> mReady;
+};
+
+#endif // LL_LLVOLUMEBVH_H
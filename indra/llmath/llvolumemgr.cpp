@@ -28,6 +28,10 @@
 #include "llvolumemgr.h"
 #include "llvolume.h"
 
+#include "hbxxh.h"
+#include "llsdserialize.h"
+#include "workqueue.h"
+
 
 const F32 BASE_THRESHOLD = 0.03f;
 
@@ -40,11 +44,17 @@ F32 LLVolumeLODGroup::mDetailThresholds[NUM_LODS] = {BASE_THRESHOLD,
 //static
 F32 LLVolumeLODGroup::mDetailScales[NUM_LODS] = {1.f, 1.5f, 2.5f, 4.f};
 
+// Volumes with fewer mesh points are generated faster than their faces are
+// read back from the cache
+const size_t MIN_CACHED_MESH_POINTS = 1024;
+
 
 //============================================================================
 
 LLVolumeMgr::LLVolumeMgr()
-:   mDataMutex(NULL)
+:   mDataMutex(NULL),
+    mGenerateAsync(false),
+    mSelf(std::make_shared<LLVolumeMgr*>(this))
 {
     // the LLMutex magic interferes with easy unit testing,
     // so you now must manually call useMutex() to use it
@@ -89,7 +99,7 @@ BOOL LLVolumeMgr::cleanup()
 // Note however that LLVolumeLODGroup that contains the volume
 //  also holds a LLPointer so the volume will only go away after
 //  anything holding the volume and the LODGroup are destroyed
-LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32 lod)
+LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32 lod, bool allow_placeholder)
 {
     LLVolumeLODGroup* volgroupp;
     if (mDataMutex)
@@ -109,9 +119,84 @@ LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32
     {
         mDataMutex->unlock();
     }
+
+    if (allow_placeholder && mGenerateAsync && lod > 0 && !volgroupp->hasLOD(lod) &&
+        volgroupp->canGenerateAsync() && requestLOD(volgroupp, lod))
+    {
+        // Stand in with the closest LOD until this one is generated, or the
+        // lowest one, which is the fastest to make
+        S32 closest = volgroupp->getClosestLOD(lod);
+        return volgroupp->refLOD(closest >= 0 ? closest : 0);
+    }
     return volgroupp->refLOD(lod);
 }
 
+// protected
+bool LLVolumeMgr::requestLOD(LLVolumeLODGroup* volgroupp, const S32 lod)
+{
+    if (volgroupp->isLODPending(lod))
+    {
+        return true;
+    }
+
+    LL::WorkQueue::ptr_t main_queue = LL::WorkQueue::getInstance("mainloop");
+    LL::WorkQueue::ptr_t volume_queue = LL::WorkQueue::getInstance("PrimVolume");
+    if (!main_queue || !volume_queue)
+    {
+        return false;
+    }
+
+    const LLVolumeParams volume_params = *volgroupp->getVolumeParams();
+    const F32 detail = LLVolumeLODGroup::getVolumeScaleFromDetail(lod);
+    std::shared_ptr<LLVolumeFaceCache> cache = mFaceCache;
+    std::weak_ptr<LLVolumeMgr*> self = mSelf;
+    bool posted = main_queue->postTo(
+        volume_queue,
+        [volume_params, detail, cache]()
+        {
+            return LLVolumeLODGroup::generateVolume(volume_params, detail, cache.get());
+        },
+        [self, volume_params, lod](LLPointer<LLVolume> volume)
+        {
+            std::shared_ptr<LLVolumeMgr*> mgr = self.lock();
+            if (mgr)
+            {
+                (*mgr)->onLODGenerated(volume_params, lod, volume);
+            }
+        });
+    if (posted)
+    {
+        volgroupp->mLODPending[lod] = true;
+    }
+    return posted;
+}
+
+// protected
+void LLVolumeMgr::onLODGenerated(const LLVolumeParams& volume_params, const S32 lod, LLVolume* volumep)
+{
+    bool found = false;
+    if (mDataMutex)
+    {
+        mDataMutex->lock();
+    }
+    // The group is gone when nothing refers to these params anymore
+    volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(&volume_params);
+    if (iter != mVolumeLODGroups.end())
+    {
+        iter->second->installLOD(lod, volumep);
+        found = true;
+    }
+    if (mDataMutex)
+    {
+        mDataMutex->unlock();
+    }
+
+    if (found && mGeneratedCallback)
+    {
+        mGeneratedCallback(volume_params, lod);
+    }
+}
+
 // virtual
 LLVolumeLODGroup* LLVolumeMgr::getGroup( const LLVolumeParams& volume_params ) const
 {
@@ -253,6 +338,7 @@ LLVolumeLODGroup::LLVolumeLODGroup(const LLVolumeParams &params)
     {
         mLODRefs[i] = 0;
         mAccessCount[i] = 0;
+        mLODPending[i] = false;
     }
 }
 
@@ -301,6 +387,78 @@ LLVolume* LLVolumeLODGroup::refLOD(const S32 lod)
     return mVolumeLODs[lod];
 }
 
+S32 LLVolumeLODGroup::getClosestLOD(const S32 lod) const
+{
+    for (S32 i = 1; i < NUM_LODS; i++)
+    {
+        if (lod - i >= 0 && mVolumeLODs[lod - i].notNull())
+        {
+            return lod - i;
+        }
+        if (lod + i < NUM_LODS && mVolumeLODs[lod + i].notNull())
+        {
+            return lod + i;
+        }
+    }
+    return -1;
+}
+
+bool LLVolumeLODGroup::canGenerateAsync() const
+{
+    // Sculpts and meshes get their faces later on, flexible prims are
+    // rebuilt every frame
+    return mVolumeParams.getSculptType() == LL_SCULPT_TYPE_NONE &&
+           mVolumeParams.getSculptID().isNull() &&
+           mVolumeParams.getPathParams().getCurveType() != LL_PCODE_PATH_FLEXIBLE;
+}
+
+// protected
+void LLVolumeLODGroup::installLOD(const S32 lod, LLVolume* volumep)
+{
+    llassert(lod >= 0 && lod < NUM_LODS);
+    mLODPending[lod] = false;
+    if (mVolumeLODs[lod].isNull())
+    {
+        mVolumeLODs[lod] = volumep;
+    }
+}
+
+// static
+LLPointer<LLVolume> LLVolumeLODGroup::generateVolume(const LLVolumeParams& params, F32 detail, LLVolumeFaceCache* cache)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME;
+
+    // Path and profile first, they tell how big the faces will be
+    LLPointer<LLVolume> volume = new LLVolume(params, detail, FALSE, FALSE, FALSE);
+    if (!cache || volume->getMesh().size() < MIN_CACHED_MESH_POINTS)
+    {
+        volume->createVolumeFaces();
+        return volume;
+    }
+
+    // Keyed on everything generate() reads
+    LLUUID key;
+    {
+        std::ostringstream str;
+        LLSDSerialize::toBinary(params.asLLSD(), str);
+        HBXXH128 hash;
+        hash.update(str.str());
+        hash.update(&detail, sizeof(detail));
+        hash.digest(key);
+    }
+
+    std::vector<U8> data;
+    if (cache->read(key, data) && volume->unpackFaceCache(data.data(), data.size()))
+    {
+        return volume;
+    }
+
+    volume->createVolumeFaces();
+    volume->packFaceCache(data);
+    cache->write(key, data);
+    return volume;
+}
+
 BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 {
     llassert_always(mRefs > 0);
@@ -27,7 +27,10 @@
 #ifndef LL_LLVOLUMEMGR_H
 #define LL_LLVOLUMEMGR_H
 
+#include <functional>
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "llvolume.h"
 #include "llpointer.h"
@@ -35,6 +38,19 @@
 
 class LLVolumeParams;
 class LLVolumeLODGroup;
+class LLVolumeMgr;
+
+// Persistent store of the faces of generated prim volumes, which are then
+// read back instead of being generated again in later sessions. Called from
+// worker threads.
+class LLVolumeFaceCache
+{
+public:
+    virtual ~LLVolumeFaceCache() = default;
+
+    virtual bool read(const LLUUID& key, std::vector<U8>& data) = 0;
+    virtual void write(const LLUUID& key, const std::vector<U8>& data) = 0;
+};
 
 class LLVolumeLODGroup
 {
@@ -59,17 +75,35 @@ class LLVolumeLODGroup
     BOOL derefLOD(LLVolume *volumep);
     S32 getNumRefs() const { return mRefs; }
 
+    bool hasLOD(const S32 detail) const { return mVolumeLODs[detail].notNull(); }
+    bool isLODPending(const S32 detail) const { return mLODPending[detail]; }
+    // Generated LOD closest to detail, lower ones first, -1 if none
+    S32 getClosestLOD(const S32 detail) const;
+    // Plain prims, which may be generated on another thread
+    bool canGenerateAsync() const;
+
+    // Generates a volume with its faces, reading them from cache when it
+    // has them and storing them otherwise. Thread safe.
+    static LLPointer<LLVolume> generateVolume(const LLVolumeParams& params, F32 detail, LLVolumeFaceCache* cache);
+
     const LLVolumeParams* getVolumeParams() const { return &mVolumeParams; };
 
     F32 dump();
     friend std::ostream& operator<<(std::ostream& s, const LLVolumeLODGroup& volgroup);
 
 protected:
+    friend class LLVolumeMgr;
+
+    // Takes a volume generated on another thread, unless one has been made
+    // meanwhile
+    void installLOD(const S32 detail, LLVolume* volumep);
+
     LLVolumeParams mVolumeParams;
 
     S32 mRefs;
     S32 mLODRefs[NUM_LODS];
     LLPointer<LLVolume> mVolumeLODs[NUM_LODS];
+    bool mLODPending[NUM_LODS];
     static F32 mDetailThresholds[NUM_LODS];
     static F32 mDetailScales[NUM_LODS];
     S32     mAccessCount[NUM_LODS];
@@ -87,7 +121,9 @@ class LLVolumeMgr
     // whatever calls getVolume() never owns the LLVolume* and
     // cannot keep references for long since it may be deleted
     // later.  For best results hold it in an LLPointer<LLVolume>.
-    virtual LLVolume *refVolume(const LLVolumeParams &volume_params, const S32 detail);
+    // With allow_placeholder, another LOD of the volume may stand in while
+    // the one asked for is generated, see setGenerateAsync().
+    virtual LLVolume *refVolume(const LLVolumeParams &volume_params, const S32 detail, bool allow_placeholder = false);
     virtual void unrefVolume(LLVolume *volumep);
 
     void dump();
@@ -95,6 +131,20 @@ class LLVolumeMgr
     // manually call this for mutex magic
     void useMutex();
 
+    // Generates the LODs of plain prims on the "PrimVolume" thread pool. Until
+    // one is ready, refVolume() with allow_placeholder returns the closest
+    // LOD generated so far, or the lowest one, and the generated callback is
+    // called on the main loop once it is. Other refs get the LOD they ask
+    // for right away.
+    void setGenerateAsync(bool generate_async) { mGenerateAsync = generate_async; }
+    bool getGenerateAsync() const { return mGenerateAsync; }
+
+    typedef std::function<void(const LLVolumeParams& volume_params, S32 detail)> generated_callback_t;
+    void setGeneratedCallback(const generated_callback_t& callback) { mGeneratedCallback = callback; }
+
+    // Cache for the faces of volumes generated on the thread pool, or null
+    void setFaceCache(const std::shared_ptr<LLVolumeFaceCache>& cache) { mFaceCache = cache; }
+
     friend std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr);
 
 protected:
@@ -102,11 +152,21 @@ class LLVolumeMgr
     // Overridden in llphysics/abstract/utils/llphysicsvolumemanager.h
     virtual LLVolumeLODGroup* createNewGroup(const LLVolumeParams& volume_params);
 
+    // Returns false when the LOD cannot be generated on the thread pool
+    bool requestLOD(LLVolumeLODGroup* volgroupp, const S32 detail);
+    void onLODGenerated(const LLVolumeParams& volume_params, const S32 detail, LLVolume* volumep);
+
 protected:
     typedef std::map<const LLVolumeParams*, LLVolumeLODGroup*, LLVolumeParams::compare> volume_lod_group_map_t;
     volume_lod_group_map_t mVolumeLODGroups;
 
     LLMutex* mDataMutex;
+
+    bool mGenerateAsync;
+    generated_callback_t mGeneratedCallback;
+    std::shared_ptr<LLVolumeFaceCache> mFaceCache;
+    // Lets the replies of the thread pool find out whether this is gone
+    std::shared_ptr<LLVolumeMgr*> mSelf;
 };
 
 #endif // LL_LLVOLUMEMGR_H
@@ -0,0 +1,244 @@
+/**
+ * @file   llmeshdequantize_test.cpp
+ * @brief  Test of the mesh dequantization kernels.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llmath.h"
+#include "../llmeshdequantize.h"
+#include "../v2math.h"
+#include "../v4math.h"
+
+#include <boost/align/aligned_allocator.hpp>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    typedef std::vector<LLVector4a, boost::alignment::aligned_allocator<LLVector4a, 16>> vec4a_list_t;
+
+    // The scalar decoding LLVolume::unpackVolumeFacesInternal used to do
+    void reference_vec3(const U8* in, U32 count, const LLVector4a& scale, const LLVector4a& offset, LLVector4a* out)
+    {
+        const U16* v = (const U16*)in;
+        for (U32 j = 0; j < count; ++j)
+        {
+            out[j].set((F32)v[0], (F32)v[1], (F32)v[2]);
+            out[j].div(65535.f);
+            out[j].mul(scale);
+            out[j].add(offset);
+            v += 3;
+        }
+    }
+
+    void reference_vec2(const U8* in, U32 count, const LLVector4a& scale, const LLVector4a& offset, LLVector4a* out)
+    {
+        const U16* t = (const U16*)in;
+        for (U32 j = 0; j < count; j += 2)
+        {
+            if (j < count - 1)
+            {
+                out->set((F32)t[0], (F32)t[1], (F32)t[2], (F32)t[3]);
+            }
+            else
+            {
+                out->set((F32)t[0], (F32)t[1], 0.f, 0.f);
+            }
+            t += 4;
+            out->div(65535.f);
+            out->mul(scale);
+            out->add(offset);
+            out++;
+        }
+    }
+
+    U32 reference_weights(const U8* weights, U32 weight_size, U32 count, LLVector4a* out)
+    {
+        U32 idx = 0;
+        U32 cur_vertex = 0;
+        while (idx < weight_size && cur_vertex < count)
+        {
+            const U8 END_INFLUENCES = 0xFF;
+            U8 joint = weights[idx++];
+
+            U32 cur_influence = 0;
+            LLVector4 wght(0, 0, 0, 0);
+            U32 joints[4] = { 0, 0, 0, 0 };
+            LLVector4 joints_with_weights(0, 0, 0, 0);
+
+            while (joint != END_INFLUENCES && idx < weight_size)
+            {
+                U16 influence = weights[idx++];
+                influence |= ((U16)weights[idx++] << 8);
+
+                F32 w = llclamp((F32)influence / 65535.f, 0.001f, 0.999f);
+                wght.mV[cur_influence] = w;
+                joints[cur_influence] = joint;
+                cur_influence++;
+
+                if (cur_influence >= 4)
+                {
+                    joint = END_INFLUENCES;
+                }
+                else
+                {
+                    joint = weights[idx++];
+                }
+            }
+            F32 wsum = wght.mV[VX] + wght.mV[VY] + wght.mV[VZ] + wght.mV[VW];
+            if (wsum <= 0.f)
+            {
+                wght = LLVector4(0.999f, 0.f, 0.f, 0.f);
+            }
+            for (U32 k = 0; k < 4; k++)
+            {
+                joints_with_weights[k] = (F32)joints[k] + wght[k];
+            }
+            out[cur_vertex].loadua(joints_with_weights.mV);
+            cur_vertex++;
+        }
+        return cur_vertex;
+    }
+
+    std::vector<U8> make_weights(std::mt19937& rng, U32 count)
+    {
+        std::vector<U8> stream;
+        for (U32 i = 0; i < count; ++i)
+        {
+            const U32 influences = rng() % 5;
+            for (U32 k = 0; k < influences; ++k)
+            {
+                stream.push_back((U8)(rng() % 110));
+                const U16 w = (U16)rng();
+                stream.push_back((U8)(w & 0xFF));
+                stream.push_back((U8)(w >> 8));
+            }
+            if (influences < 4)
+            {
+                stream.push_back(0xFF);
+            }
+        }
+        return stream;
+    }
+
+    bool same_bits(const void* a, const void* b, size_t size)
+    {
+        return memcmp(a, b, size) == 0;
+    }
+}
+
+namespace tut
+{
+    struct llmeshdequantize_data
+    {
+        llmeshdequantize_data()
+        :   mRNG(1234)
+        {
+            mPosMin.set(-1.5f, -0.25f, 3.f);
+            LLVector4a max(2.f, 7.5f, 3.5f);
+            mPosRange.setSub(max, mPosMin);
+            mTCRange.set(2.f, 4.f, 2.f, 4.f);
+            mTCMin.set(-1.f, 0.5f, -1.f, 0.5f);
+        }
+
+        std::vector<U8> randomU16(U32 count)
+        {
+            // Padded so the scalar reference can be run with odd counts
+            std::vector<U8> data(count * sizeof(U16) + 8);
+            for (auto& b : data)
+            {
+                b = (U8)mRNG();
+            }
+            return data;
+        }
+
+        std::mt19937 mRNG;
+        LLVector4a mPosMin;
+        LLVector4a mPosRange;
+        LLVector4a mTCRange;
+        LLVector4a mTCMin;
+    };
+
+    typedef test_group<llmeshdequantize_data> llmeshdequantize_group;
+    typedef llmeshdequantize_group::object llmeshdequantize_object;
+    tut::llmeshdequantize_group llmeshdequantize_testgroup("LLMeshDequantize");
+
+    template<> template<>
+    void llmeshdequantize_object::test<1>()
+    {
+        // Positions and normals, every count around the vector widths
+        for (U32 count = 1; count < 20; ++count)
+        {
+            std::vector<U8> in = randomU16(count * 3);
+            vec4a_list_t expected(count), actual(count);
+            reference_vec3(in.data(), count, mPosRange, mPosMin, expected.data());
+            ll_dequantize_vec3_u16(in.data(), count, mPosRange, mPosMin, actual.data());
+            ensure("positions match", same_bits(expected.data(), actual.data(), count * sizeof(LLVector4a)));
+
+            LLVector4a two, minus_one;
+            two.splat(2.f);
+            minus_one.splat(-1.f);
+            reference_vec3(in.data(), count, two, minus_one, expected.data());
+            ll_dequantize_vec3_u16(in.data(), count, two, minus_one, actual.data());
+            ensure("normals match", same_bits(expected.data(), actual.data(), count * sizeof(LLVector4a)));
+        }
+    }
+
+    template<> template<>
+    void llmeshdequantize_object::test<2>()
+    {
+        // Texture coordinates, including the odd last vertex
+        for (U32 count = 1; count < 20; ++count)
+        {
+            std::vector<U8> in = randomU16(count * 2);
+            const U32 vecs = (count + 1) / 2;
+            vec4a_list_t expected(vecs), actual(vecs);
+            reference_vec2(in.data(), count, mTCRange, mTCMin, expected.data());
+            ll_dequantize_vec2_u16(in.data(), count, mTCRange, mTCMin, (LLVector2*)actual.data());
+            ensure("texture coordinates match", same_bits(expected.data(), actual.data(), vecs * sizeof(LLVector4a)));
+        }
+    }
+
+    template<> template<>
+    void llmeshdequantize_object::test<3>()
+    {
+        const U32 count = 1000;
+        std::vector<U8> in = make_weights(mRNG, count);
+        vec4a_list_t expected(count), actual(count);
+        const U32 expected_count = reference_weights(in.data(), (U32)in.size(), count, expected.data());
+        U32 consumed = 0;
+        const U32 actual_count = ll_decode_mesh_weights(in.data(), (U32)in.size(), count, actual.data(), consumed);
+        ensure_equals("weights vertex count", actual_count, expected_count);
+        ensure_equals("weights consumed", consumed, (U32)in.size());
+        ensure("weights match", same_bits(expected.data(), actual.data(), count * sizeof(LLVector4a)));
+
+        // A truncated stream decodes what it can without reading past its end
+        std::vector<U8> truncated(in.begin(), in.begin() + in.size() / 2);
+        const U32 partial = ll_decode_mesh_weights(truncated.data(), (U32)truncated.size(), count, actual.data(), consumed);
+        ensure("truncated weights", partial < count && consumed <= truncated.size());
+    }
+}
@@ -0,0 +1,310 @@
+/**
+ * @file   llvolumebvh_test.cpp
+ * @brief  Test of the volume face BVH.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llvolume.h"
+#include "../llvolumebvh.h"
+#include "../llvolumeoctree.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+namespace tut
+{
+    struct llvolumebvh_data
+    {
+        llvolumebvh_data()
+        :   mRNG(1234)
+        {
+        }
+
+        ~llvolumebvh_data()
+        {
+            LLVolumeBVH::cleanupClass();
+        }
+
+        // Bumpy sphere of radius about 0.5 with rings * segments * 2
+        // triangles, facing out
+        void makeSphere(LLVolumeFace& face, U32 rings, U32 segments)
+        {
+            std::uniform_real_distribution<F32> bump(-0.01f, 0.01f);
+            face.resizeVertices((rings + 1) * (segments + 1));
+            face.resizeIndices(rings * segments * 6);
+            for (U32 r = 0; r <= rings; ++r)
+            {
+                const F32 theta = F_PI * r / rings;
+                for (U32 s = 0; s <= segments; ++s)
+                {
+                    const F32 phi = F_TWO_PI * s / segments;
+                    const F32 radius = 0.45f + bump(mRNG);
+                    const U32 i = r * (segments + 1) + s;
+                    face.mPositions[i].set(radius * sinf(theta) * cosf(phi), radius * sinf(theta) * sinf(phi), radius * cosf(theta));
+                    face.mNormals[i] = face.mPositions[i];
+                    face.mNormals[i].normalize3fast();
+                    face.mTexCoords[i].set((F32)s / segments, (F32)r / rings);
+                }
+            }
+            U16* idx = face.mIndices;
+            for (U32 r = 0; r < rings; ++r)
+            {
+                for (U32 s = 0; s < segments; ++s)
+                {
+                    const U16 i0 = r * (segments + 1) + s;
+                    const U16 i1 = i0 + 1;
+                    const U16 i2 = i0 + segments + 1;
+                    const U16 i3 = i2 + 1;
+                    *idx++ = i0; *idx++ = i2; *idx++ = i1;
+                    *idx++ = i1; *idx++ = i2; *idx++ = i3;
+                }
+            }
+        }
+
+        // Segments from outside the sphere through points near it, some
+        // missing it and some stopping short
+        void makeRays(U32 count, std::vector<LLVector4a>& starts, std::vector<LLVector4a>& dirs)
+        {
+            std::uniform_real_distribution<F32> unit(-1.f, 1.f);
+            for (U32 i = 0; i < count; ++i)
+            {
+                LLVector4a start(unit(mRNG), unit(mRNG), unit(mRNG));
+                start.normalize3fast();
+                start.mul(2.f);
+                LLVector4a target(unit(mRNG) * 0.6f, unit(mRNG) * 0.6f, unit(mRNG) * 0.6f);
+                LLVector4a dir;
+                dir.setSub(target, start);
+                dir.mul(1.f + unit(mRNG));
+                starts.push_back(start);
+                dirs.push_back(dir);
+            }
+        }
+
+        static bool bruteForce(const LLVolumeFace& face, const LLVector4a& start, const LLVector4a& dir,
+                               F32& closest_t, F32& a, F32& b, U16 indices[3])
+        {
+            bool hit = false;
+            for (S32 j = 0; j + 2 < face.mNumIndices; j += 3)
+            {
+                const U16* tri = &face.mIndices[j];
+                F32 tri_a, tri_b, t;
+                if (LLTriangleRayIntersect(face.mPositions[tri[0]], face.mPositions[tri[1]], face.mPositions[tri[2]],
+                                           start, dir, tri_a, tri_b, t)
+                    && t >= 0.f && t <= 1.f && t < closest_t)
+                {
+                    closest_t = t;
+                    a = tri_a;
+                    b = tri_b;
+                    std::copy(tri, tri + 3, indices);
+                    hit = true;
+                }
+            }
+            return hit;
+        }
+
+        std::mt19937 mRNG;
+    };
+
+    typedef test_group<llvolumebvh_data> llvolumebvh_group;
+    typedef llvolumebvh_group::object llvolumebvh_object;
+    tut::llvolumebvh_group llvolumebvh_testgroup("LLVolumeBVH");
+
+    template<> template<>
+    void llvolumebvh_object::test<1>()
+    {
+        // Same hits as testing every triangle
+        LLVolumeFace face;
+        makeSphere(face, 40, 60);
+        LLVolumeBVH bvh(face.mPositions, face.mNumVertices, face.mIndices, face.mNumIndices);
+        ensure("not built yet", !bvh.isReady());
+        bvh.build();
+        ensure("built", bvh.isReady());
+        ensure_equals("every triangle in", bvh.getNumTriangles(), (U32)face.mNumIndices / 3);
+
+        std::vector<LLVector4a> starts, dirs;
+        makeRays(2000, starts, dirs);
+        U32 hits = 0;
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            F32 expected_t = 2.f, expected_a = 0.f, expected_b = 0.f;
+            U16 expected_idx[3];
+            const bool expected = bruteForce(face, starts[i], dirs[i], expected_t, expected_a, expected_b, expected_idx);
+
+            F32 t = 2.f, a = 0.f, b = 0.f;
+            U16 idx[3];
+            const bool hit = bvh.intersect(face.mPositions, starts[i], dirs[i], t, a, b, idx);
+            ensure_equals("same hit", hit, expected);
+            if (hit)
+            {
+                ++hits;
+                ensure_approximately_equals("same t", t, expected_t, 16);
+                ensure("same triangle",
+                       std::equal(idx, idx + 3, expected_idx) ||
+                       // or as close on a shared edge
+                       fabsf(t - expected_t) < 1e-6f);
+            }
+        }
+        ensure("some rays hit", hits > 500 && hits < starts.size());
+
+        // Nothing closer than a hit already found, e.g. on another face
+        F32 t = 0.f, a, b;
+        U16 idx[3];
+        ensure("nothing before 0", !bvh.intersect(face.mPositions, starts[0], dirs[0], t, a, b, idx));
+    }
+
+    template<> template<>
+    void llvolumebvh_object::test<2>()
+    {
+        // Degenerate and bad input
+        LLVector4a positions[4];
+        positions[0].set(0.f, 0.f, 0.f);
+        positions[1].set(1.f, 0.f, 0.f);
+        positions[2].set(0.f, 1.f, 0.f);
+        positions[3].set(0.f, 0.f, 0.f);
+        const U16 indices[] = { 0, 1, 2, 0, 0, 0, 1, 2, 7, 3, 3, 3 };
+
+        LLVector4a start(0.25f, 0.25f, 1.f);
+        LLVector4a dir(0.f, 0.f, -2.f);
+
+        LLVolumeBVH empty(positions, 4, indices, 0);
+        empty.build();
+        F32 t = 2.f, a, b;
+        U16 idx[3];
+        ensure("empty", empty.isReady() && !empty.intersect(positions, start, dir, t, a, b, idx));
+
+        LLVolumeBVH bvh(positions, 4, indices, sizeof(indices) / sizeof(indices[0]));
+        bvh.build();
+        ensure_equals("bad triangle dropped", bvh.getNumTriangles(), 3U);
+        ensure("axis aligned ray hits", bvh.intersect(positions, start, dir, t, a, b, idx));
+        ensure_approximately_equals("t", t, 0.5f, 16);
+        ensure("triangle", idx[0] == 0 && idx[1] == 1 && idx[2] == 2);
+
+        // Back faces are not hit, as with LLTriangleRayIntersect
+        LLVector4a back_start(0.25f, 0.25f, -1.f);
+        LLVector4a back_dir(0.f, 0.f, 2.f);
+        t = 2.f;
+        ensure("back face", !bvh.intersect(positions, back_start, back_dir, t, a, b, idx));
+
+        // Too short
+        dir.set(0.f, 0.f, -0.9f);
+        t = 2.f;
+        ensure("stops short", !bvh.intersect(positions, start, dir, t, a, b, idx));
+    }
+
+    template<> template<>
+    void llvolumebvh_object::test<3>()
+    {
+        // Built on the pool for faces asking for it, ray casts fall back to
+        // testing every triangle meanwhile
+        LLVolumeBVH::initClass(1);
+        LLVolumeFace face;
+        makeSphere(face, 100, 100);
+        face.requestBVH();
+        for (S32 i = 0; i < 1000 && !face.getBVH(); ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        ensure("built on the pool", face.getBVH() != NULL);
+
+        // Changing the geometry lets go of it, even while being built
+        face.destroyBVH();
+        ensure("destroyed", face.getBVH() == NULL);
+        face.requestBVH();
+        face.destroyBVH();
+        LLVolumeBVH::cleanupClass();
+    }
+
+    template<> template<>
+    void llvolumebvh_object::test<4>()
+    {
+        // Same hits as the octree the ray casts used before
+        LLVolumeFace face;
+        makeSphere(face, 60, 80);
+        face.createOctree();
+        LLVolumeBVH bvh(face.mPositions, face.mNumVertices, face.mIndices, face.mNumIndices);
+        bvh.build();
+
+        std::vector<LLVector4a> starts, dirs;
+        makeRays(2000, starts, dirs);
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            F32 octree_t = 2.f;
+            LLOctreeTriangleRayIntersect intersect(starts[i], dirs[i], &face, &octree_t, NULL, NULL, NULL, NULL);
+            intersect.traverse(face.getOctree());
+
+            F32 t = 2.f, a, b;
+            U16 idx[3];
+            const bool hit = bvh.intersect(face.mPositions, starts[i], dirs[i], t, a, b, idx);
+            ensure_equals("same hit as the octree", hit, intersect.mHitFace);
+            if (hit)
+            {
+                ensure_approximately_equals("same t as the octree", t, octree_t, 16);
+            }
+        }
+    }
+
+    template<> template<>
+    void llvolumebvh_object::test<5>()
+    {
+        // Moving the positions, as skinning rigged faces does, refits the
+        // BVH kept by the face instead of building it again
+        LLVolumeFace face;
+        makeSphere(face, 40, 60);
+        face.requestBVH();
+        const LLVolumeBVH* built = face.getBVH();
+        ensure("built", built != NULL);
+
+        for (S32 i = 0; i < face.mNumVertices; ++i)
+        {
+            F32* v = face.mPositions[i].getF32ptr();
+            v[0] = v[0] * 1.5f + 0.2f * sinf(v[2] * 6.f);
+            v[1] += 0.3f * v[2];
+        }
+        face.refitBVH();
+        ensure("stale until refit", face.getBVH() == NULL);
+        face.requestBVH();
+        ensure("kept", face.getBVH() == built);
+
+        std::vector<LLVector4a> starts, dirs;
+        makeRays(2000, starts, dirs);
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            F32 expected_t = 2.f, expected_a, expected_b;
+            U16 expected_idx[3];
+            const bool expected = bruteForce(face, starts[i], dirs[i], expected_t, expected_a, expected_b, expected_idx);
+
+            F32 t = 2.f, a, b;
+            U16 idx[3];
+            const bool hit = built->intersect(face.mPositions, starts[i], dirs[i], t, a, b, idx);
+            ensure_equals("same hit once refit", hit, expected);
+            if (hit)
+            {
+                ensure_approximately_equals("same t once refit", t, expected_t, 16);
+            }
+        }
+    }
+}
@@ -0,0 +1,243 @@
+/**
+ * @file   llvolumemgr_test.cpp
+ * @brief  Test of the generation and caching of shared volumes.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llvolume.h"
+#include "../llvolumemgr.h"
+
+#include "workqueue.h"
+
+#include <map>
+
+namespace tut
+{
+    struct llvolumemgr_data
+    {
+        class MemoryCache : public LLVolumeFaceCache
+        {
+        public:
+            bool read(const LLUUID& key, std::vector<U8>& data) override
+            {
+                ++mReads;
+                auto it = mEntries.find(key);
+                if (it == mEntries.end())
+                {
+                    return false;
+                }
+                data = it->second;
+                return true;
+            }
+
+            void write(const LLUUID& key, const std::vector<U8>& data) override
+            {
+                ++mWrites;
+                mEntries[key] = data;
+            }
+
+            std::map<LLUUID, std::vector<U8>> mEntries;
+            S32 mReads = 0;
+            S32 mWrites = 0;
+        };
+
+        // Hollow, cut and twisted torus, many mesh points at the highest LOD
+        static LLVolumeParams makeTorus()
+        {
+            LLVolumeParams params;
+            params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+            params.setRatio(1.f, 0.25f);
+            params.setBeginAndEndS(0.1f, 0.9f);
+            params.setHollow(0.5f);
+            params.setTwistEnd(0.5f);
+            params.setRevolutions(3.f);
+            return params;
+        }
+
+        static bool sameFaces(const LLVolume* a, const LLVolume* b)
+        {
+            if (a->getNumVolumeFaces() != b->getNumVolumeFaces())
+            {
+                return false;
+            }
+            for (S32 i = 0; i < a->getNumVolumeFaces(); ++i)
+            {
+                const LLVolumeFace& fa = a->getVolumeFace(i);
+                const LLVolumeFace& fb = b->getVolumeFace(i);
+                if (fa.mID != fb.mID || fa.mTypeMask != fb.mTypeMask ||
+                    fa.mNumS != fb.mNumS || fa.mNumT != fb.mNumT ||
+                    fa.mNumVertices != fb.mNumVertices || fa.mNumIndices != fb.mNumIndices ||
+                    fa.mEdge != fb.mEdge ||
+                    memcmp(fa.mExtents, fb.mExtents, sizeof(LLVector4a) * 3) ||
+                    memcmp(fa.mPositions, fb.mPositions, sizeof(LLVector4a) * fa.mNumVertices) ||
+                    memcmp(fa.mNormals, fb.mNormals, sizeof(LLVector4a) * fa.mNumVertices) ||
+                    memcmp(fa.mTexCoords, fb.mTexCoords, sizeof(LLVector2) * fa.mNumVertices) ||
+                    memcmp(fa.mIndices, fb.mIndices, sizeof(U16) * fa.mNumIndices))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    typedef test_group<llvolumemgr_data> llvolumemgr_group;
+    typedef llvolumemgr_group::object llvolumemgr_object;
+    tut::llvolumemgr_group llvolumemgr_testgroup("LLVolumeMgr");
+
+    template<> template<>
+    void llvolumemgr_object::test<1>()
+    {
+        // Faces read back from the cache are the generated ones
+        const LLVolumeParams params = makeTorus();
+        MemoryCache cache;
+        LLPointer<LLVolume> generated = LLVolumeLODGroup::generateVolume(params, 4.f, &cache);
+        ensure_equals("stored", cache.mWrites, 1);
+        ensure("some faces", generated->getNumVolumeFaces() > 0);
+
+        LLPointer<LLVolume> expected = new LLVolume(params, 4.f);
+        ensure("same as made right away", sameFaces(generated, expected));
+
+        LLPointer<LLVolume> cached = LLVolumeLODGroup::generateVolume(params, 4.f, &cache);
+        ensure_equals("read", cache.mReads, 2);
+        ensure_equals("not stored again", cache.mWrites, 1);
+        ensure("same as generated", sameFaces(cached, generated));
+
+        // Other params have their own entries
+        LLVolumeParams other = params;
+        other.setTwistEnd(0.6f);
+        LLPointer<LLVolume> twisted = LLVolumeLODGroup::generateVolume(other, 4.f, &cache);
+        ensure_equals("other params", cache.mEntries.size(), (size_t)2);
+        ensure("other faces", !sameFaces(twisted, generated));
+    }
+
+    template<> template<>
+    void llvolumemgr_object::test<2>()
+    {
+        // Bad cached data is generated again
+        const LLVolumeParams params = makeTorus();
+        MemoryCache cache;
+        LLPointer<LLVolume> generated = LLVolumeLODGroup::generateVolume(params, 4.f, &cache);
+        std::vector<U8>& data = cache.mEntries.begin()->second;
+
+        LLPointer<LLVolume> volume = new LLVolume(params, 4.f, FALSE, FALSE, FALSE);
+        ensure_equals("no faces yet", volume->getNumVolumeFaces(), 0);
+        ensure("truncated", !volume->unpackFaceCache(data.data(), data.size() / 2));
+        ensure_equals("left without faces", volume->getNumVolumeFaces(), 0);
+        ensure("trailing bytes", !volume->unpackFaceCache(data.data(), data.size() - 1) &&
+                                 volume->getNumVolumeFaces() == 0);
+
+        ensure("whole", volume->unpackFaceCache(data.data(), data.size()));
+
+        // Older layout
+        data[0] ^= 0xff;
+        LLPointer<LLVolume> regenerated = LLVolumeLODGroup::generateVolume(params, 4.f, &cache);
+        ensure_equals("stored again", cache.mWrites, 2);
+        ensure("generated again", sameFaces(regenerated, generated));
+    }
+
+    template<> template<>
+    void llvolumemgr_object::test<3>()
+    {
+        // Small volumes are not worth caching
+        LLVolumeParams params;
+        params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+        MemoryCache cache;
+        LLPointer<LLVolume> box = LLVolumeLODGroup::generateVolume(params, 1.f, &cache);
+        ensure_equals("box faces", box->getNumVolumeFaces(), 6);
+        ensure("not cached", cache.mReads == 0 && cache.mWrites == 0);
+    }
+
+    template<> template<>
+    void llvolumemgr_object::test<4>()
+    {
+        // Without the thread pool, volumes are generated right away
+        LLVolumeMgr mgr;
+        mgr.setGenerateAsync(true);
+        const LLVolumeParams params = makeTorus();
+        LLPointer<LLVolume> volume = mgr.refVolume(params, 3);
+        ensure_equals("requested LOD", volume->getDetail(), LLVolumeLODGroup::getVolumeScaleFromDetail(3));
+        ensure("faces", volume->getNumVolumeFaces() > 0);
+        mgr.unrefVolume(volume);
+    }
+
+    template<> template<>
+    void llvolumemgr_object::test<5>()
+    {
+        // With the thread pool, only refs allowing a placeholder get one
+        // until their LOD is generated
+        LL::WorkQueue main_queue("mainloop");
+        LL::WorkQueue volume_queue("PrimVolume");
+        LLVolumeMgr mgr;
+        mgr.setGenerateAsync(true);
+        std::vector<std::pair<LLVolumeParams, S32>> generated;
+        mgr.setGeneratedCallback([&generated](const LLVolumeParams& params, S32 detail)
+            {
+                generated.emplace_back(params, detail);
+            });
+
+        const LLVolumeParams params = makeTorus();
+        LLPointer<LLVolume> placeholder = mgr.refVolume(params, 2, true);
+        ensure_equals("lowest LOD made right away", placeholder->getDetail(), LLVolumeLODGroup::getVolumeScaleFromDetail(0));
+        ensure("placeholder faces", placeholder->getNumVolumeFaces() > 0);
+        LLVolumeLODGroup* group = mgr.getGroup(params);
+        ensure("requested", group->isLODPending(2) && !group->hasLOD(2));
+
+        LLPointer<LLVolume> again = mgr.refVolume(params, 2, true);
+        ensure("same placeholder", again == placeholder);
+
+        LLPointer<LLVolume> exact = mgr.refVolume(params, 3);
+        ensure_equals("exact LOD without placeholder", exact->getDetail(), LLVolumeLODGroup::getVolumeScaleFromDetail(3));
+        ensure("not requested", !group->isLODPending(3));
+
+        // generated on "PrimVolume", installed on "mainloop"
+        volume_queue.runPending();
+        ensure("not installed on the pool", generated.empty() && !group->hasLOD(2));
+        main_queue.runPending();
+        ensure_equals("called back once", generated.size(), (size_t)1);
+        ensure("with its params", generated[0].first == params && generated[0].second == 2);
+        ensure("installed", group->hasLOD(2) && !group->isLODPending(2));
+
+        LLPointer<LLVolume> volume = mgr.refVolume(params, 2, true);
+        ensure_equals("generated LOD", volume->getDetail(), LLVolumeLODGroup::getVolumeScaleFromDetail(2));
+        LLPointer<LLVolume> expected = new LLVolume(params, LLVolumeLODGroup::getVolumeScaleFromDetail(2));
+        ensure("same as made right away", sameFaces(volume, expected));
+
+        mgr.unrefVolume(volume);
+        mgr.unrefVolume(exact);
+        mgr.unrefVolume(again);
+        mgr.unrefVolume(placeholder);
+
+        // Nobody is called back once the params are no longer used
+        LLPointer<LLVolume> gone = mgr.refVolume(params, 1, true);
+        ensure("requested again", mgr.getGroup(params)->isLODPending(1));
+        mgr.unrefVolume(gone);
+        ensure("group gone", !mgr.getGroup(params));
+        volume_queue.runPending();
+        main_queue.runPending();
+        ensure_equals("not called back", generated.size(), (size_t)1);
+    }
+}
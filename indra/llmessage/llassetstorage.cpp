@@ -50,6 +50,7 @@
 
 #include "llmetrics.h"
 #include "lltrace.h"
+#include "workqueue.h"
 
 LLAssetStorage *gAssetStorage = NULL;
 LLMetrics *LLAssetStorage::metric_recipient = NULL;
@@ -1360,6 +1361,25 @@ void LLAssetStorage::getAssetData(const LLUUID uuid,
                  is_priority);
 }
 
+// Copies the cached asset read in result to filename
+static S32 write_legacy_asset_file(const std::string& filename, const LLFileSystem::ReadResult& result)
+{
+    LLFILE* fp = LLFile::fopen(filename, "wb");     /* Flawfinder: ignore */
+    if (!fp)
+    {
+        return LL_ERR_CANNOT_OPEN_FILE;
+    }
+
+    S32 status = LL_ERR_NOERR;
+    if (!result.mData.empty() && fwrite(result.mData.data(), result.mData.size(), 1, fp) < 1)
+    {
+        // return a bad file error if we can't write the whole thing
+        status = LL_ERR_CANNOT_OPEN_FILE;
+    }
+    fclose(fp);
+    return status;
+}
+
 // static
 void LLAssetStorage::legacyGetDataCallback(const LLUUID &uuid,
                                            LLAssetType::EType type,
@@ -1376,35 +1396,49 @@ void LLAssetStorage::legacyGetDataCallback(const LLUUID &uuid,
     if ( !status
          && !toxic )
     {
-        LLFileSystem file(uuid, type);
-
         std::string uuid_str;
 
         uuid.toString(uuid_str);
         filename = llformat("%s.%s",gDirUtilp->getExpandedFilename(LL_PATH_CACHE,uuid_str).c_str(),LLAssetType::lookup(type));
 
-        LLFILE* fp = LLFile::fopen(filename, "wb");     /* Flawfinder: ignore */
-        if (fp)
+        LLFileSystem::ReadRequest request;
+        request.mFileID = uuid;
+        request.mFileType = type;
+
+        // The asset is read and copied on the read pool, the callback still
+        // comes on the main loop
+        LL::WorkQueue::weak_t main_queue = LL::WorkQueue::getInstance("mainloop");
+        auto copy = [legacy, filename, uuid, ext_status, main_queue](LLFileSystem::ReadResult& result)
         {
-            const S32 buf_size = 65536;
-            U8 copy_buf[buf_size];
-            while (file.read(copy_buf, buf_size))   /* Flawfinder: ignore */
+            const S32 status = write_legacy_asset_file(filename, result);
+            if (!LL::WorkQueue::postMaybe(main_queue,
+                    [legacy, filename, uuid, status, ext_status]()
+                    {
+                        legacyGetDataDone(legacy, filename, uuid, status, ext_status);
+                    }))
             {
-                if (fwrite(copy_buf, file.getLastBytesRead(), 1, fp) < 1)
-                {
-                    // return a bad file error if we can't write the whole thing
-                    status = LL_ERR_CANNOT_OPEN_FILE;
-                }
+                // shutting down, nobody is waiting for it anymore
+                delete legacy;
             }
-
-            fclose(fp);
-        }
-        else
+        };
+        if (!main_queue.expired() && LLFileSystem::readAsyncOnWorker({ request }, copy))
         {
-            status = LL_ERR_CANNOT_OPEN_FILE;
+            return;
         }
+
+        // no read pool, copy it on this thread
+        LLFileSystem::ReadResult result;
+        LLFileSystem::readRequest(request, result);
+        status = write_legacy_asset_file(filename, result);
     }
 
+    legacyGetDataDone(legacy, filename, uuid, status, ext_status);
+}
+
+// static
+void LLAssetStorage::legacyGetDataDone(LLLegacyAssetRequest* legacy, const std::string& filename,
+                                       const LLUUID& uuid, S32 status, LLExtStat ext_status)
+{
     if (status != LL_ERR_NOERR)
     {
         add(sFailedDownloadCount, 1);
@@ -45,6 +45,7 @@ class LLMessageSystem;
 class LLXferManager;
 class LLAssetStorage;
 class LLSD;
+class LLLegacyAssetRequest;
 
 // anything that takes longer than this to download will abort.
 // HTTP Uploads also timeout if they take longer than this.
@@ -373,6 +374,9 @@ class LLAssetStorage
         F64Seconds timeout  = LL_ASSET_STORAGE_TIMEOUT) = 0;
 
     static void legacyGetDataCallback(const LLUUID &uuid, LLAssetType::EType, void *user_data, S32 status, LLExtStat ext_status);
+    // Calls the legacy callback once the asset has been copied to filename
+    static void legacyGetDataDone(LLLegacyAssetRequest* legacy, const std::string& filename,
+                                  const LLUUID& uuid, S32 status, LLExtStat ext_status);
     static void legacyStoreDataCallback(const LLUUID &uuid, void *user_data, S32 status, LLExtStat ext_status);
 
     // add extra methods to handle metadata
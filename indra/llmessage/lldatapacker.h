@@ -183,6 +183,8 @@ class LLDataPackerBinaryBuffer final : public LLDataPacker
                 void        reset()             { mCurBufferp = mBufferp; mWriteEnabled = (mCurBufferp != NULL); }
                 void        shift(S32 offset)   { reset(); mCurBufferp += offset;}
                 void        freeBuffer()        { delete [] mBufferp; mBufferp = mCurBufferp = NULL; mBufferSize = 0; mWriteEnabled = FALSE; }
+                // Let go of a buffer owned by someone else
+                void        detachBuffer()      { mBufferp = mCurBufferp = NULL; mBufferSize = 0; mWriteEnabled = FALSE; }
                 void        assignBuffer(U8 *bufferp, S32 size)
                 {
                     if(mBufferp && mBufferp != bufferp)
@@ -1474,14 +1474,14 @@ void LLMeshSkinInfo::fromLLSD(const LLSD& skin)
 {
     const auto& skin_map = skin.asMap();
 
+    joint_name_list_t::vector_t joint_names;
     auto it = skin_map.find("joint_names");
     if (it != skin_map.end())
     {
-        const auto& joint_names = it->second;
-        for(const auto& jnt_llsd : joint_names.asArray())
+        const auto& joint_names_llsd = it->second;
+        for(const auto& jnt_llsd : joint_names_llsd.asArray())
         {
-            mJointNames.emplace_back(jnt_llsd.asString());
-            mJointNums.emplace_back(-1);
+            joint_names.emplace_back(jnt_llsd.asString());
         }
     }
 
@@ -1500,6 +1500,8 @@ void LLMeshSkinInfo::fromLLSD(const LLSD& skin)
         mBindShapeMatrix.loadu(mat);
     }
 
+    matrix_list_t inv_bind_matrix;
+    matrix_list_t inv_bind_shape_matrix;
     it = skin_map.find("inverse_bind_matrix");
     if (it != skin_map.end())
     {
@@ -1516,22 +1518,22 @@ void LLMeshSkinInfo::fromLLSD(const LLSD& skin)
             }
 
             LLMatrix4a inv_bind(mat);
-            mInvBindMatrix.push_back(inv_bind);
+            inv_bind_matrix.push_back(inv_bind);
 
             LLMatrix4a inv_bind_shape;
             inv_bind_shape.setMul(inv_bind, mBindShapeMatrix);
-            mInvBindShapeMatrix.push_back(inv_bind_shape);
+            inv_bind_shape_matrix.push_back(inv_bind_shape);
         }
 
-        if (mJointNames.size() != mInvBindMatrix.size())
+        if (joint_names.size() != inv_bind_matrix.size())
         {
             LL_WARNS("MESHSKININFO") << "Joints vs bind matrix count mismatch. Dropping joint bindings." << LL_ENDL;
-            mJointNames.clear();
-            mJointNums.clear();
-            mInvBindMatrix.clear();
+            joint_names.clear();
+            inv_bind_matrix.clear();
         }
     }
 
+    matrix_list_t alt_bind_matrix;
     it = skin_map.find("alt_inverse_bind_matrix");
     if (it != skin_map.end())
     {
@@ -1547,10 +1549,16 @@ void LLMeshSkinInfo::fromLLSD(const LLSD& skin)
                 }
             }
 
-            mAlternateBindMatrix.push_back(LLMatrix4a(mat));
+            alt_bind_matrix.push_back(LLMatrix4a(mat));
         }
     }
 
+    mJointNums = LLInternedVector<S32>(std::vector<S32>(joint_names.size(), -1));
+    mJointNames = joint_name_list_t(std::move(joint_names));
+    mInvBindMatrix = shared_matrix_list_t(std::move(inv_bind_matrix));
+    mInvBindShapeMatrix = shared_matrix_list_t(std::move(inv_bind_shape_matrix));
+    mAlternateBindMatrix = shared_matrix_list_t(std::move(alt_bind_matrix));
+
     it = skin_map.find("pelvis_offset");
     if (it != skin_map.end())
     {
@@ -1638,7 +1646,7 @@ void LLMeshSkinInfo::updateHash()
     hash.update((const void*)mJointNums.data(), sizeof(S32) * mJointNums.size());
 
     //mInvBindMatrix
-    F32* src = mInvBindMatrix[0].getF32ptr();
+    const F32* src = mInvBindMatrix.empty() ? nullptr : mInvBindMatrix[0].getF32ptr();
 
     for (size_t i = 0, count = mInvBindMatrix.size() * 16; i < count; ++i)
     {
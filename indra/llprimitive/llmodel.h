@@ -27,6 +27,7 @@
 #ifndef LL_LLMODEL_H
 #define LL_LLMODEL_H
 
+#include "llinternedvector.h"
 #include "llpointer.h"
 #include "llvolume.h"
 #include "v4math.h"
@@ -55,14 +56,19 @@ class LLMeshSkinInfo : public LLRefCount
     U32 sizeBytes() const;
 
     LLUUID mMeshID;
-    std::vector<std::string> mJointNames;
-    mutable std::vector<S32> mJointNums;
+
+    // Joint lists and bind matrices are interned, the many meshes rigged to
+    // the same body, like clothing layers, share a single copy of them
+    typedef LLInternedVector<std::string> joint_name_list_t;
+    joint_name_list_t mJointNames;
+    mutable LLInternedVector<S32> mJointNums;
     typedef std::vector<LLMatrix4a, boost::alignment::aligned_allocator<LLMatrix4a, 16>> matrix_list_t;
-    matrix_list_t mInvBindMatrix;
+    typedef LLInternedVector<LLMatrix4a, boost::alignment::aligned_allocator<LLMatrix4a, 16>> shared_matrix_list_t;
+    shared_matrix_list_t mInvBindMatrix;
 
     // bones/joints position overrides
-    matrix_list_t mAlternateBindMatrix;
-    matrix_list_t mInvBindShapeMatrix;
+    shared_matrix_list_t mAlternateBindMatrix;
+    shared_matrix_list_t mInvBindShapeMatrix;
 
     LL_ALIGN_16(LLMatrix4a mBindShapeMatrix);
 
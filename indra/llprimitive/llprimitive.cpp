@@ -775,6 +775,12 @@ S32 face_index_from_id(LLFaceID face_ID, const std::vector<LLProfile::Face>& fac
 }
 
 BOOL LLPrimitive::setVolume(const LLVolumeParams &volume_params, const S32 detail, bool unique_volume)
+{
+    return setVolume(volume_params, detail, unique_volume, false);
+}
+
+// protected
+BOOL LLPrimitive::setVolume(const LLVolumeParams &volume_params, const S32 detail, bool unique_volume, bool allow_placeholder)
 {
     if (NO_LOD == detail)
     {
@@ -807,11 +813,12 @@ BOOL LLPrimitive::setVolume(const LLVolumeParams &volume_params, const S32 detai
             }
         }
 
-        volumep = sVolumeManager->refVolume(volume_params, detail);
+        volumep = sVolumeManager->refVolume(volume_params, detail, allow_placeholder);
         if (volumep == mVolumep.get())
         {
             sVolumeManager->unrefVolume( volumep );  // LLVolumeMgr::refVolume() creates a reference, but we don't need a second one.
-            return TRUE;
+            // Still the same stand-in for the LOD being generated
+            return FALSE;
         }
     }
 
@@ -1606,6 +1613,50 @@ S32 LLPrimitive::unpackTEMessage(LLDataPacker &dp)
     return retval;
 }
 
+//static
+bool LLPrimitive::unpackTEImageIDs(LLDataPacker &dp, uuid_vec_t& image_ids)
+{
+    // Same layout as unpackTEMessage(), but only the leading image field is
+    // read, for any face count
+    const U32 MAX_TES = 45;
+    const U32 MAX_TE_BUFFER = 4096;
+    U8 packed_buffer[MAX_TE_BUFFER];
+
+    S32 size;
+    if (!dp.unpackBinaryData(packed_buffer, size, "TextureEntry"))
+    {
+        return false;
+    }
+
+    if (size == 0)
+    {
+        return true;
+    }
+    else if (size >= MAX_TE_BUFFER)
+    {
+        size = MAX_TE_BUFFER - 1;
+    }
+    packed_buffer[size] = 0x00;
+    ++size;
+
+    LLUUID image_data[MAX_TES];
+    U8 *cur_ptr = packed_buffer;
+    if (!unpack_TEField<LLUUID>(image_data, MAX_TES, cur_ptr, packed_buffer + size, MVT_LLUUID))
+    {
+        return false;
+    }
+
+    for (U32 i = 0; i < MAX_TES; ++i)
+    {
+        const LLUUID& id = image_data[i];
+        if (id.notNull() && std::find(image_ids.begin(), image_ids.end(), id) == image_ids.end())
+        {
+            image_ids.push_back(id);
+        }
+    }
+    return true;
+}
+
 U8  LLPrimitive::getExpectedNumTEs() const
 {
     U8 expected_face_count = 0;
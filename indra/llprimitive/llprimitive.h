@@ -505,6 +505,8 @@ class LLPrimitive : public LLXform
     BOOL packTEMessage(LLDataPacker &dp) const;
     S32 unpackTEMessage(LLMessageSystem* mesgsys, char const* block_name, const S32 block_num); // Variable num of blocks
     BOOL unpackTEMessage(LLDataPacker &dp);
+    // Appends the distinct image IDs of a packed texture entry block
+    static bool unpackTEImageIDs(LLDataPacker &dp, uuid_vec_t& image_ids);
     S32 parseTEMessage(LLMessageSystem* mesgsys, char const* block_name, const S32 block_num, LLTEContents& tec);
     S32 applyParsedTEMessage(LLTEContents& tec);
 
@@ -586,6 +588,10 @@ class LLPrimitive : public LLXform
     void updateNumBumpmap(const U8 index, const U8 bump);
 
 protected:
+    // As setVolume(), with allow_placeholder passed on to
+    // LLVolumeMgr::refVolume(). Returns FALSE while the same stand-in is kept.
+    BOOL setVolume(const LLVolumeParams &volume_params, const S32 detail, bool unique_volume, bool allow_placeholder);
+
     LLPCode             mPrimitiveCode;     // Primitive code
     LLVector3           mVelocity;          // how fast are we moving?
     LLVector3           mAcceleration;      // are we under constant acceleration?
@@ -31,6 +31,7 @@
 #include "../llprimitive.h"
 
 #include "../../llmath/llvolumemgr.h"
+#include "../../llmessage/lldatapacker.h"
 
 class DummyVolumeMgr : public LLVolumeMgr
 {
@@ -41,7 +42,7 @@ class DummyVolumeMgr : public LLVolumeMgr
     }
 
 
-    virtual LLVolume *refVolume(const LLVolumeParams &volume_params, const S32 detail)
+    virtual LLVolume *refVolume(const LLVolumeParams &volume_params, const S32 detail, bool allow_placeholder = false)
     {
         if (mVolumeTest.isNull() || volume_params != mCurrParamsTest || detail != mCurrDetailTest)
         {
@@ -128,6 +129,24 @@ namespace tut
     struct llprimitive
     {
         PRIMITIVE_TEST_SETUP setup_class;
+
+        // Append a face bitfield and the image ID those faces use to a
+        // packed "TextureEntry" image field
+        static void appendTEImage(std::vector<U8>& te, U8 faces, const LLUUID& id)
+        {
+            te.push_back(faces);
+            te.insert(te.end(), id.mData, id.mData + UUID_BYTES);
+        }
+
+        // Run unpackTEImageIDs() over te as the data packer holds it
+        static bool unpackImageIDs(const std::vector<U8>& te, uuid_vec_t& image_ids)
+        {
+            U8 buffer[1024];
+            LLDataPackerBinaryBuffer dp(buffer, sizeof(buffer));
+            dp.packBinaryData(te.data(), (S32)te.size(), "TextureEntry");
+            dp.reset();
+            return LLPrimitive::unpackTEImageIDs(dp, image_ids);
+        }
     };
 
     typedef test_group<llprimitive> llprimitive_t;
@@ -262,6 +281,52 @@ namespace tut
         // Ensure that we now have a different volume
         ensure(new_volume != primitive.getVolume());
     }
+
+    template<> template<>
+    void llprimitive_object_t::test<7>()
+    {
+        set_test_name("Test unpackTEImageIDs reads the unique image IDs.");
+        LLUUID a("00000000-0000-0000-0000-00000000000a");
+        LLUUID b("00000000-0000-0000-0000-00000000000b");
+
+        // default a, faces 1 and 2 use b, face 3 repeats a
+        std::vector<U8> te(a.mData, a.mData + UUID_BYTES);
+        appendTEImage(te, 0x06, b);
+        appendTEImage(te, 0x08, a);
+        te.push_back(0);
+
+        uuid_vec_t image_ids;
+        ensure("unpacked", unpackImageIDs(te, image_ids));
+        ensure_equals("unique IDs", image_ids.size(), (size_t)2);
+        ensure("default first", image_ids[0] == a);
+        ensure("exception", image_ids[1] == b);
+
+        // IDs already listed are not repeated
+        image_ids.clear();
+        image_ids.push_back(b);
+        ensure("unpacked again", unpackImageIDs(te, image_ids));
+        ensure_equals("appended once", image_ids.size(), (size_t)2);
+        ensure("appended", image_ids[1] == a);
+
+        // null IDs are skipped
+        std::vector<U8> null_default(UUID_BYTES, 0);
+        appendTEImage(null_default, 0x01, b);
+        null_default.push_back(0);
+        image_ids.clear();
+        ensure("null default", unpackImageIDs(null_default, image_ids));
+        ensure("only the exception", image_ids.size() == 1 && image_ids[0] == b);
+
+        // no texture entry at all
+        image_ids.clear();
+        ensure("empty", unpackImageIDs(std::vector<U8>(), image_ids));
+        ensure("no IDs", image_ids.empty());
+
+        // an exception cut short
+        std::vector<U8> truncated(a.mData, a.mData + UUID_BYTES);
+        truncated.push_back(0x02);
+        truncated.insert(truncated.end(), b.mData, b.mData + 4);
+        ensure("truncated", !unpackImageIDs(truncated, image_ids));
+    }
 }
 
 #include "llmessagesystem_stub.cpp"
@@ -102,6 +102,7 @@
 #include "llprogressview.h"
 #include "llvocache.h"
 #include "lldiskcache.h"
+#include "llfilesystem.h"
 #include "llvopartgroup.h"
 // [SL:KB] - Patch: Appearance-Misc | Checked: 2013-02-12 (Catznip-3.4)
 #include "llappearancemgr.h"
@@ -126,12 +127,14 @@
 #include "llavatarnamecache.h"
 #include "lldiriterator.h"
 #include "llexperiencecache.h"
+#include "llimagefilter.h"
 #include "llimagej2c.h"
 #include "llmemory.h"
 #include "llprimitive.h"
 #include "llurlaction.h"
 #include "llurlentry.h"
 #include "llvolumemgr.h"
+#include "llvolumebvh.h"
 #include "llxfermanager.h"
 #include "llphysicsextensions.h"
 
@@ -655,6 +658,8 @@ LLAppViewer::LLAppViewer()
     mReportedCrash(false),
     mNumSessions(0),
     mGeneralThreadPool(nullptr),
+    mSnapshotThreadPool(nullptr),
+    mPrimVolumeThreadPool(nullptr),
     mPurgeCache(false),
     mPurgeCacheOnExit(false),
     mPurgeUserDataOnExit(false),
@@ -2003,9 +2008,20 @@ bool LLAppViewer::cleanup()
     {
         mGeneralThreadPool->close();
     }
+    if (mSnapshotThreadPool)
+    {
+        mSnapshotThreadPool->close();
+    }
+    if (mPrimVolumeThreadPool)
+    {
+        mPrimVolumeThreadPool->close();
+    }
 
     sTextureFetch->shutDownTextureCacheThread() ;
     LLLFSThread::sLocal->shutdown();
+    LLFileSystem::cleanupClass();
+    LLImageFilter::cleanupClass();
+    LLVolumeBVH::cleanupClass();
 
     LL_INFOS() << "Shutting down disk cache" << LL_ENDL;
     LLDiskCache::deleteSingleton();
@@ -2037,6 +2053,10 @@ bool LLAppViewer::cleanup()
     sPurgeDiskCacheThread = NULL;
     delete mGeneralThreadPool;
     mGeneralThreadPool = NULL;
+    delete mSnapshotThreadPool;
+    mSnapshotThreadPool = NULL;
+    delete mPrimVolumeThreadPool;
+    mPrimVolumeThreadPool = NULL;
 
     if (LLFastTimerView::sAnalyzePerformance)
     {
@@ -2160,13 +2180,35 @@ bool LLAppViewer::initThreads()
         cores = llmin(cores, (S32) max_cores);
     }
 
-    // The only configurable thread count right now is ImageDecode
-    // The viewer typically starts around 8 threads not including image decode,
-    // so try to leave at least one core free
+    // ImageDecode is always sized after the cores. The viewer typically
+    // starts around 8 threads not including image decode, so try to leave
+    // at least one core free
     S32 image_decode_count = llclamp(cores - 9, 1, 8);
     threadCounts["ImageDecode"] = image_decode_count;
     gSavedSettings.setLLSD("ThreadPoolSizes", threadCounts);
 
+    // The other pools only get a default width here, their entry in
+    // ThreadPoolSizes overrides it. Mesh decodes, image filters, BVH builds,
+    // prim LODs and snapshots come in bursts, they share the half of the
+    // cores the texture decodes below leave. Disk reads mostly wait on the
+    // disk and get a few threads of their own.
+    S32 burst_cores = llmax(cores - cores / 2, 1);
+    S32 mesh_decode_count = llclamp(burst_cores / 2, 1, 8);
+    LLImageFilter::initClass(llclamp(burst_cores / 2, 1, 8));
+    LLVolumeBVH::initClass(llclamp(burst_cores / 4, 1, 4));
+    LLFileSystem::initClass(llclamp(cores / 4, 1, 4));
+
+    // Large textures can also have their own decode spread over a few
+    // threads, 0 picks a count from the cores available. All the decodes
+    // together, pool included, keep to half of the cores.
+    S32 threads_per_image = (S32)gSavedSettings.getU32("TextureDecodeThreadsPerImage");
+    if (threads_per_image == 0)
+    {
+        threads_per_image = llclamp(cores / 4, 1, 4);
+    }
+    S32 extra_decode_threads = llmax(cores / 2 - image_decode_count, 0);
+    LLImageJ2C::setDecodeThreads(threads_per_image, LLImageJ2C::DEFAULT_THREADED_DECODE_AREA, extra_decode_threads);
+
     // Image decoding
     LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
     LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
@@ -2177,6 +2219,15 @@ bool LLAppViewer::initThreads()
     // general task background thread (LLPerfStats, etc)
     LLAppViewer::instance()->initGeneralThread();
 
+    // Snapshots to disk are encoded and written on a pool of their own,
+    // large PNGs are deflated in strips over its threads
+    mSnapshotThreadPool = new LL::ThreadPool("Snapshot", llclamp(burst_cores / 2, 1, 4));
+    mSnapshotThreadPool->start();
+
+    // Prim LODs, when PrimVolumeGenerateAsync is on, and their face cache
+    mPrimVolumeThreadPool = new LL::ThreadPool("PrimVolume", llclamp(burst_cores / 4, 1, 4));
+    mPrimVolumeThreadPool->start();
+
     LLAppViewer::sPurgeDiskCacheThread = new LLPurgeDiskCacheThread();
 
     if (LLTrace::BlockTimer::sLog || LLTrace::BlockTimer::sMetricLog)
@@ -2187,7 +2238,7 @@ bool LLAppViewer::initThreads()
     }
 
     // Mesh streaming and caching
-    gMeshRepo.init();
+    gMeshRepo.init(mesh_decode_count);
 
     LLFilePickerThread::initClass();
     LLDirPickerThread::initClass();
@@ -4058,8 +4109,11 @@ U32 LLAppViewer::getDiskCacheVersion()
 {
     // Viewer disk cache version intorduced in Simple Cache Viewer, change if the cache format changes.
     const U32 DISK_CACHE_VERSION = 1;
+    // Mesh blocks re-encoded as zstd can only be read by viewers that know
+    // the format, such a cache gets a version of its own.
+    const U32 DISK_CACHE_MESH_ZSTD = 0x10000;
 
-    return DISK_CACHE_VERSION ;
+    return gSavedSettings.getBOOL("MeshCacheZstd") ? (DISK_CACHE_VERSION | DISK_CACHE_MESH_ZSTD) : DISK_CACHE_VERSION;
 }
 
 //static
@@ -4160,7 +4214,8 @@ bool LLAppViewer::initCache()
         const uintmax_t disk_cache_bytes = disk_cache_mb * 1024ull * 1024ull;
 
         const bool enable_cache_debug_info = gSavedSettings.getBOOL("EnableDiskCacheDebugInfo");
-        LLDiskCache::getInstance()->init(LL_PATH_CACHE, disk_cache_bytes, enable_cache_debug_info, disk_cache_mismatch);
+        const U32 pack_threshold_bytes = gSavedSettings.getU32("DiskCachePackThreshold");
+        LLDiskCache::getInstance()->init(LL_PATH_CACHE, disk_cache_bytes, enable_cache_debug_info, disk_cache_mismatch, pack_threshold_bytes);
 
         if (!read_only)
         {
@@ -4187,6 +4242,10 @@ bool LLAppViewer::initCache()
         texture_cache_size = llclamp(texture_cache_size, MIN_CACHE_SIZE, MAX_CACHE_SIZE);
 
         LLAppViewer::getTextureCache()->initCache(LL_PATH_CACHE, texture_cache_size, texture_cache_mismatch);
+
+        // Decoded textures have a budget of their own, on top of the above
+        const S64 decoded_cache_size = (S64)(gSavedSettings.getU32("TextureDecodedCacheSize")) * MB;
+        LLAppViewer::getTextureCache()->initDecodedCache(llmin(decoded_cache_size, MAX_CACHE_SIZE));
     }
 
     const U32 CACHE_NUMBER_OF_REGIONS_FOR_OBJECTS = 128;
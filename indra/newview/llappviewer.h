@@ -294,6 +294,8 @@ class LLAppViewer : public LLApp
     static LLTextureFetch* sTextureFetch;
     static LLPurgeDiskCacheThread* sPurgeDiskCacheThread;
     LL::ThreadPool* mGeneralThreadPool;
+    LL::ThreadPool* mSnapshotThreadPool;    // snapshot encodes and saves to disk
+    LL::ThreadPool* mPrimVolumeThreadPool;  // prim LOD generation and face cache I/O
 
     S32 mNumSessions;
 
@@ -0,0 +1,393 @@
+/**
+ * @file lldecodedtexturecache.cpp
+ * @brief On-disk cache of decoded texture levels.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lldecodedtexturecache.h"
+
+#include "lldir.h"
+#include "lldiskcache.h"
+#include "llfile.h"
+#include "llimage.h"
+#include "llmappedfile.h"
+#include "workqueue.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <vector>
+
+namespace
+{
+    const char DECODED_EXTENSION[] = ".dtx";
+    constexpr size_t DECODED_EXTENSION_LENGTH = sizeof(DECODED_EXTENSION) - 1;
+    // <uuid>_<discard>.dtx
+    constexpr size_t DECODED_NAME_LENGTH = UUID_STR_LENGTH - 1 + 2 + DECODED_EXTENSION_LENGTH;
+
+    // Bump the last character when the format or the decoder output changes
+    constexpr U32 DECODED_MAGIC = 'L' | ('D' << 8) | ('T' << 16) | ('1' << 24);
+
+    struct FileHeader
+    {
+        U32 mMagic;
+        U16 mWidth;
+        U16 mHeight;
+        U8 mComponents;
+        U8 mDiscard;
+        U8 mPad[2];
+    };
+    static_assert(sizeof(FileHeader) == 12, "FileHeader is stored as is");
+
+    boost::filesystem::path to_path(const std::string& filename)
+    {
+#if LL_WINDOWS
+        return boost::filesystem::path(ll_convert_string_to_wide(filename));
+#else
+        return boost::filesystem::path(filename);
+#endif
+    }
+
+    // Temporary files let readers only ever see complete files
+    std::atomic<U32> sTempCount(0);
+    std::atomic<S32> sPendingWrites(0);
+}
+
+void LLDecodedTextureCache::init(const std::string& dirname, S64 max_size, bool read_only)
+{
+    LLMutexLock lock(&mMutex);
+
+    mDirName = dirname;
+    mMaxSize = llmax(max_size, (S64)0);
+    mReadOnly = read_only;
+    mEntries.clear();
+    mTotalSize = 0;
+
+    if (!mMaxSize)
+    {
+        return;
+    }
+
+    if (!mReadOnly)
+    {
+        LLFile::mkdir(mDirName);
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::directory_iterator iter(to_path(mDirName), ec);
+    for (; !ec && iter != boost::filesystem::directory_iterator(); iter.increment(ec))
+    {
+        if (!boost::filesystem::is_regular_file(iter->status()))
+        {
+            continue;
+        }
+
+        const std::string name = iter->path().filename().string();
+        if (name.size() != DECODED_NAME_LENGTH || name[UUID_STR_LENGTH - 1] != '_'
+            || name.compare(DECODED_NAME_LENGTH - DECODED_EXTENSION_LENGTH, DECODED_EXTENSION_LENGTH, DECODED_EXTENSION) != 0)
+        {
+            // Left over by a write that didn't complete
+            if (!mReadOnly)
+            {
+                LLFile::remove(iter->path());
+            }
+            continue;
+        }
+
+        LLUUID id;
+        const S32 discard = name[UUID_STR_LENGTH] - '0';
+        if (!id.set(std::string_view(name).substr(0, UUID_STR_LENGTH - 1), FALSE) || discard < 0 || discard > MAX_DISCARD_LEVEL)
+        {
+            continue;
+        }
+
+        boost::system::error_code stat_ec;
+        const uintmax_t size = boost::filesystem::file_size(iter->path(), stat_ec);
+        const time_t mtime = boost::filesystem::last_write_time(iter->path(), stat_ec);
+
+        Entry& entry = mEntries[id];
+        entry.mDiscards |= 1 << discard;
+        entry.mSize += (S64)size;
+        entry.mTime = llmax(entry.mTime, mtime);
+        mTotalSize += (S64)size;
+    }
+
+    LL_INFOS("TextureCache") << "Decoded texture cache: " << mEntries.size() << " textures, "
+                             << mTotalSize / (1024 * 1024) << " MB" << LL_ENDL;
+
+    if (mTotalSize > mMaxSize && !mReadOnly)
+    {
+        evict(mMaxSize * 9 / 10);
+    }
+}
+
+std::string LLDecodedTextureCache::getFileName(const LLUUID& id, S32 discard) const
+{
+    return mDirName + gDirUtilp->getDirDelimiter() + id.asString() + "_" + (char)('0' + discard) + DECODED_EXTENSION;
+}
+
+S32 LLDecodedTextureCache::findDiscard(const LLUUID& id, S32 max_discard)
+{
+    if (!isEnabled() || max_discard < 0)
+    {
+        return -1;
+    }
+
+    LLMutexLock lock(&mMutex);
+    auto iter = mEntries.find(id);
+    if (iter == mEntries.end())
+    {
+        return -1;
+    }
+    for (S32 discard = llmin(max_discard, MAX_DISCARD_LEVEL); discard >= 0; --discard)
+    {
+        if (iter->second.mDiscards & (1 << discard))
+        {
+            return discard;
+        }
+    }
+    return -1;
+}
+
+LLPointer<LLImageRaw> LLDecodedTextureCache::read(const LLUUID& id, S32 max_discard, S32& discard)
+{
+    const S32 found = findDiscard(id, max_discard);
+    if (found < 0)
+    {
+        return nullptr;
+    }
+
+    const std::string filename = getFileName(id, found);
+    LLMappedFile file;
+    FileHeader header;
+    if (!file.openReadOnly(filename) || file.size() < sizeof(FileHeader))
+    {
+        remove(id);
+        return nullptr;
+    }
+    memcpy(&header, file.data(), sizeof(FileHeader));
+
+    const size_t data_size = (size_t)header.mWidth * header.mHeight * header.mComponents;
+    if (header.mMagic != DECODED_MAGIC || header.mDiscard != found
+        || header.mComponents < 1 || header.mComponents > 4
+        || file.size() != sizeof(FileHeader) + data_size)
+    {
+        LL_WARNS("TextureCache") << "Invalid decoded texture file " << filename << LL_ENDL;
+        file.close();
+        remove(id);
+        return nullptr;
+    }
+
+    LLPointer<LLImageRaw> raw = new LLImageRaw(header.mWidth, header.mHeight, header.mComponents);
+    if (!raw->getData())
+    {
+        return nullptr;
+    }
+    memcpy(raw->getData(), file.data() + sizeof(FileHeader), data_size);
+    discard = found;
+
+    {
+        LLMutexLock lock(&mMutex);
+        auto iter = mEntries.find(id);
+        if (iter != mEntries.end())
+        {
+            iter->second.mTime = time(nullptr);
+        }
+    }
+    if (!mReadOnly)
+    {
+        // So that the eviction order survives restarts
+        LLDiskCache::updateFileAccessTime(to_path(filename));
+    }
+
+    return raw;
+}
+
+bool LLDecodedTextureCache::write(const LLUUID& id, const LLImageRaw* raw, S32 discard)
+{
+    if (!isEnabled() || mReadOnly || !raw || !raw->getData() || discard < 0 || discard > MAX_DISCARD_LEVEL
+        || raw->getComponents() < 1 || raw->getComponents() > 4)
+    {
+        return false;
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(FileHeader));
+    header.mMagic = DECODED_MAGIC;
+    header.mWidth = raw->getWidth();
+    header.mHeight = raw->getHeight();
+    header.mComponents = raw->getComponents();
+    header.mDiscard = (U8)discard;
+    const size_t data_size = (size_t)header.mWidth * header.mHeight * header.mComponents;
+
+    const std::string filename = getFileName(id, discard);
+    const std::string temp_filename = filename + llformat(".%u.tmp", ++sTempCount);
+    LLFILE* fp = LLFile::fopen(temp_filename, "wb");
+    if (!fp)
+    {
+        return false;
+    }
+    bool success = fwrite(&header, sizeof(FileHeader), 1, fp) == 1
+                   && fwrite(raw->getData(), 1, data_size, fp) == data_size;
+    success = (fclose(fp) == 0) && success;
+    if (!success || LLFile::rename(temp_filename, filename) != 0)
+    {
+        LLFile::remove(temp_filename);
+        return false;
+    }
+
+    LLMutexLock lock(&mMutex);
+    Entry& entry = mEntries[id];
+    const U32 bit = 1 << discard;
+    if (!(entry.mDiscards & bit))
+    {
+        const S64 file_size = (S64)(sizeof(FileHeader) + data_size);
+        entry.mDiscards |= bit;
+        entry.mSize += file_size;
+        mTotalSize += file_size;
+    }
+    entry.mTime = time(nullptr);
+
+    if (mTotalSize > mMaxSize)
+    {
+        evict(mMaxSize * 9 / 10);
+    }
+    return true;
+}
+
+//static
+void LLDecodedTextureCache::writeAsync(const std::shared_ptr<LLDecodedTextureCache>& cache, const LLUUID& id,
+                                       const LLImageRaw* raw, S32 discard)
+{
+    if (!cache || !cache->isEnabled() || cache->mReadOnly || !raw || !raw->getData()
+        || raw->getWidth() * raw->getHeight() < MIN_CACHED_AREA
+        || cache->findDiscard(id, discard) == discard
+        || sPendingWrites >= MAX_PENDING_WRITES)
+    {
+        return;
+    }
+
+    LL::WorkQueue::ptr_t general_queue = LL::WorkQueue::getInstance("General");
+    if (!general_queue)
+    {
+        return;
+    }
+
+    // The caller may hand raw out as soon as this returns
+    LLPointer<LLImageRaw> copy = new LLImageRaw(raw->getData(), raw->getWidth(), raw->getHeight(), raw->getComponents());
+    if (!copy->getData())
+    {
+        return;
+    }
+
+    ++sPendingWrites;
+    const bool posted = general_queue->post([cache, id, copy, discard]()
+        {
+            LL_PROFILE_ZONE_NAMED("write decoded texture");
+            cache->write(id, copy, discard);
+            --sPendingWrites;
+        });
+    if (!posted)
+    {
+        --sPendingWrites;
+    }
+}
+
+void LLDecodedTextureCache::remove(const LLUUID& id)
+{
+    LLMutexLock lock(&mMutex);
+    auto iter = mEntries.find(id);
+    if (iter == mEntries.end())
+    {
+        return;
+    }
+    if (!mReadOnly)
+    {
+        removeFiles(id, iter->second.mDiscards);
+    }
+    mTotalSize -= iter->second.mSize;
+    mEntries.erase(iter);
+}
+
+void LLDecodedTextureCache::purge()
+{
+    LLMutexLock lock(&mMutex);
+    if (!mReadOnly && !mDirName.empty() && LLFile::isdir(mDirName))
+    {
+        gDirUtilp->deleteFilesInDir(mDirName, "*");
+    }
+    mEntries.clear();
+    mTotalSize = 0;
+}
+
+S64 LLDecodedTextureCache::getUsage()
+{
+    LLMutexLock lock(&mMutex);
+    return mTotalSize;
+}
+
+// mMutex must be locked
+void LLDecodedTextureCache::removeFiles(const LLUUID& id, U32 discards)
+{
+    for (S32 discard = 0; discard <= MAX_DISCARD_LEVEL; ++discard)
+    {
+        if (discards & (1 << discard))
+        {
+            LLFile::remove(getFileName(id, discard), ENOENT);
+        }
+    }
+}
+
+// mMutex must be locked
+void LLDecodedTextureCache::evict(S64 target_size)
+{
+    typedef std::pair<time_t, LLUUID> age_t;
+    std::vector<age_t> ages;
+    ages.reserve(mEntries.size());
+    for (const auto& entry : mEntries)
+    {
+        ages.emplace_back(entry.second.mTime, entry.first);
+    }
+    std::sort(ages.begin(), ages.end());
+
+    S32 evicted = 0;
+    for (const age_t& age : ages)
+    {
+        if (mTotalSize <= target_size)
+        {
+            break;
+        }
+        auto iter = mEntries.find(age.second);
+        removeFiles(iter->first, iter->second.mDiscards);
+        mTotalSize -= iter->second.mSize;
+        mEntries.erase(iter);
+        ++evicted;
+    }
+
+    LL_DEBUGS("TextureCache") << "Evicted " << evicted << " decoded textures, " << mTotalSize / (1024 * 1024)
+                              << " MB left" << LL_ENDL;
+}
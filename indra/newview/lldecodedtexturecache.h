@@ -0,0 +1,115 @@
+/**
+ * @file lldecodedtexturecache.h
+ * @brief On-disk cache of decoded texture levels.
+ *
+ * @Description:
+ * Decoding JPEG2000 costs far more than reading the pixels it produces, yet
+ * LLTextureFetch decodes the same textures again every session. This cache
+ * keeps the raw pixels of decoded textures, one file per UUID and discard
+ * level, so that a later fetch can hand them to the texture without decoding
+ * anything. Files are memory mapped when read.
+ *
+ * The cache has its own size budget, the least recently used textures being
+ * evicted when it is exceeded. All the methods are thread safe.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLDECODEDTEXTURECACHE_H
+#define LL_LLDECODEDTEXTURECACHE_H
+
+#include "llmutex.h"
+#include "llpointer.h"
+#include "lluuid.h"
+
+#include <boost/unordered/unordered_flat_map.hpp>
+
+#include <memory>
+
+class LLImageRaw;
+
+class LLDecodedTextureCache
+{
+public:
+    LLDecodedTextureCache() = default;
+
+    LLDecodedTextureCache(const LLDecodedTextureCache&) = delete;
+    LLDecodedTextureCache& operator=(const LLDecodedTextureCache&) = delete;
+
+    /**
+     * Use dirname, creating it if needed, index the files already there and
+     * evict the oldest ones if they exceed max_size bytes. A max_size of 0
+     * disables the cache. When read_only, nothing is ever written or evicted.
+     */
+    void init(const std::string& dirname, S64 max_size, bool read_only);
+
+    bool isEnabled() const { return mMaxSize > 0; }
+
+    // Highest discard level of id cached at or below max_discard, -1 if none.
+    S32 findDiscard(const LLUUID& id, S32 max_discard);
+
+    // Pixels of id at the discard level findDiscard() returns, stored into
+    // discard. Null if there are none or the file turns out to be invalid.
+    LLPointer<LLImageRaw> read(const LLUUID& id, S32 max_discard, S32& discard);
+
+    // Store raw as the discard level of id. Blocks on the file write.
+    bool write(const LLUUID& id, const LLImageRaw* raw, S32 discard);
+
+    // Copy raw and write it from the general thread pool, unless it is too
+    // small to be worth caching, already cached or too many writes are
+    // queued already.
+    static void writeAsync(const std::shared_ptr<LLDecodedTextureCache>& cache, const LLUUID& id,
+                           const LLImageRaw* raw, S32 discard);
+
+    void remove(const LLUUID& id);
+
+    // Delete every cached file.
+    void purge();
+
+    S64 getUsage();
+
+    // Smaller textures decode about as fast as they load
+    static const S32 MIN_CACHED_AREA = 256 * 256;
+    static const S32 MAX_PENDING_WRITES = 16;
+
+private:
+    struct Entry
+    {
+        U32 mDiscards = 0;  // one bit per cached discard level
+        S64 mSize = 0;      // bytes of all the cached levels
+        time_t mTime = 0;   // last access
+    };
+
+    std::string getFileName(const LLUUID& id, S32 discard) const;
+    void removeFiles(const LLUUID& id, U32 discards);
+    void evict(S64 target_size);
+
+private:
+    LLMutex mMutex;
+    boost::unordered_flat_map<LLUUID, Entry> mEntries;
+    std::string mDirName;
+    S64 mMaxSize = 0;
+    S64 mTotalSize = 0;
+    bool mReadOnly = false;
+};
+
+#endif // LL_LLDECODEDTEXTURECACHE_H
@@ -176,6 +176,8 @@ void LLFace::init(LLDrawable* drawablep, LLViewerObject* objp)
     mHasMedia = false ;
     mIsMediaAllowed = true;
 
+    mPriorityRow = gTextureList.getFacePriorityTable().add(this);
+
 // [SL:KB] - Patch: Render-TextureToggle (Catznip-4.0)
     mShowDiffTexture = true;
 // [/SL:KB]
@@ -226,6 +228,12 @@ void LLFace::destroy()
 
     setDrawInfo(NULL);
 
+    if (mPriorityRow != LLFacePriorityTable::NO_ROW)
+    {
+        gTextureList.getFacePriorityTable().remove(mPriorityRow);
+        mPriorityRow = LLFacePriorityTable::NO_ROW;
+    }
+
     mDrawablep = NULL;
     mVObjp = NULL;
 }
@@ -2058,6 +2066,7 @@ F32 LLFace::getTextureVirtualSize()
     F32 radius;
     F32 cos_angle_to_view_dir;
     BOOL in_frustum = calcPixelArea(cos_angle_to_view_dir, radius);
+    updatePriorityInputs(in_frustum);
 
     if (mPixelArea < F_ALMOST_ZERO || !in_frustum)
     {
@@ -2101,6 +2110,37 @@ F32 LLFace::getTextureVirtualSize()
     return face_area;
 }
 
+void LLFace::updatePriorityInputs(bool in_frustum)
+{
+    if (mPriorityRow == LLFacePriorityTable::NO_ROW)
+    {
+        return;
+    }
+
+    LLFacePriorityTable::Inputs inputs;
+    const LLTextureEntry* te = mVObjp.notNull() ? getTextureEntry() : nullptr;
+    if (te && mDrawablep)
+    {
+        // scale desired texture resolution higher or lower depending on texture scale
+        inputs.mValid = true;
+        inputs.mPixelArea = mPixelArea;
+        inputs.mMinScale = llmin(fabsf(te->getScaleS()), fabsf(te->getScaleT()));
+        inputs.mDistance = mDrawablep->mDistanceWRTCamera;
+        inputs.mVisible = in_frustum && mDrawablep->isVisible();
+        // if a GLTF material is present, its textures get the stats instead
+        inputs.mMaterial = te->getGLTFRenderMaterial() != nullptr;
+    }
+    gTextureList.getFacePriorityTable().update(mPriorityRow, inputs, gFrameTimeSeconds);
+}
+
+void LLFace::refreshPriorityInputs()
+{
+    F32 radius;
+    F32 cos_angle_to_view_dir;
+    BOOL in_frustum = calcPixelArea(cos_angle_to_view_dir, radius);
+    updatePriorityInputs(in_frustum);
+}
+
 BOOL LLFace::calcPixelArea(F32& cos_angle_to_view_dir, F32& radius)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_FACE;
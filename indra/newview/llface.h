@@ -115,6 +115,11 @@ class alignas(16) LLFace
     F32             getVirtualSize() const { return mVSize; }
     F32             getPixelArea() const { return mPixelArea; }
 
+    // write the texture priority inputs of this face to its row of the
+    // texture list's LLFacePriorityTable
+    void            updatePriorityInputs(bool in_frustum);
+    U32             getPriorityRow() const { return mPriorityRow; }
+
     S32             getIndexInTex(U32 ch) const {llassert(ch < LLRender::NUM_TEXTURE_CHANNELS); return mIndexInTex[ch];}
     void            setIndexInTex(U32 ch, S32 index) { llassert(ch < LLRender::NUM_TEXTURE_CHANNELS);  mIndexInTex[ch] = index ;}
 
@@ -237,6 +242,8 @@ class alignas(16) LLFace
     friend class LLViewerTextureList;
     F32         adjustPartialOverlapPixelArea(F32 cos_angle_to_view_dir, F32 radius );
     BOOL        calcPixelArea(F32& cos_angle_to_view_dir, F32& radius) ;
+    // calcPixelArea() then updatePriorityInputs(), for rows nothing else updates
+    void        refreshPriorityInputs();
 public:
     static F32 calcImportanceToCamera(F32 to_view_dir, F32 dist);
     static F32 adjustPixelArea(F32 importance, F32 pixel_area) ;
@@ -273,6 +280,7 @@ class alignas(16) LLFace
     U32         mIndicesCount;
     U32         mIndicesIndex;      // index into mVertexBuffer's index array
     S32         mIndexInTex[LLRender::NUM_TEXTURE_CHANNELS];
+    U32         mPriorityRow;
 
     LLXformMatrix* mXform;
 
@@ -0,0 +1,169 @@
+/**
+ * @file llfacepriorities.cpp
+ * @brief Per face inputs to the virtual size of the textures.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llfacepriorities.h"
+
+namespace
+{
+    const U8 ROW_VALID = 0x1;
+    const U8 ROW_VISIBLE = 0x2;
+    const U8 ROW_MATERIAL = 0x4;
+}
+
+void LLFacePriorityTable::Batch::clear()
+{
+    mPixelArea.clear();
+    mMinScale.clear();
+    mDistance.clear();
+    mVisible.clear();
+    mVirtualSize.clear();
+    mImage.clear();
+    mRow.clear();
+    mMaterial.clear();
+}
+
+U32 LLFacePriorityTable::add(LLFace* face)
+{
+    U32 row;
+    if (mFreeRows.empty())
+    {
+        row = (U32)mFace.size();
+        mPixelArea.push_back(0.f);
+        mMinScale.push_back(1.f);
+        mDistance.push_back(0.f);
+        mUpdateTime.push_back(0.f);
+        mFlags.push_back(0);
+        mFace.push_back(nullptr);
+    }
+    else
+    {
+        row = mFreeRows.back();
+        mFreeRows.pop_back();
+    }
+
+    // stale until the face first writes it
+    mUpdateTime[row] = -F32_MAX;
+    mFlags[row] = 0;
+    mFace[row] = face;
+    return row;
+}
+
+void LLFacePriorityTable::remove(U32 row)
+{
+    llassert(row < mFace.size() && mFace[row]);
+    if (row < mFace.size() && mFace[row])
+    {
+        mFace[row] = nullptr;
+        mFlags[row] = 0;
+        mFreeRows.push_back(row);
+    }
+}
+
+void LLFacePriorityTable::update(U32 row, const Inputs& inputs, F32 now)
+{
+    if (row >= mFace.size())
+    {
+        return;
+    }
+    mPixelArea[row] = inputs.mPixelArea;
+    mMinScale[row] = inputs.mMinScale;
+    mDistance[row] = inputs.mDistance;
+    mUpdateTime[row] = now;
+    mFlags[row] = (inputs.mValid ? ROW_VALID : 0) |
+        (inputs.mVisible ? ROW_VISIBLE : 0) |
+        (inputs.mMaterial ? ROW_MATERIAL : 0);
+}
+
+bool LLFacePriorityTable::getInputs(U32 row, Inputs& inputs) const
+{
+    if (row >= mFace.size() || !mFace[row])
+    {
+        return false;
+    }
+    inputs.mPixelArea = mPixelArea[row];
+    inputs.mMinScale = mMinScale[row];
+    inputs.mDistance = mDistance[row];
+    inputs.mValid = (mFlags[row] & ROW_VALID) != 0;
+    inputs.mVisible = (mFlags[row] & ROW_VISIBLE) != 0;
+    inputs.mMaterial = (mFlags[row] & ROW_MATERIAL) != 0;
+    return true;
+}
+
+void LLFacePriorityTable::gather(const U32* rows, U32 count, U32 image_index, F32 stale_time,
+                                 Batch& batch, std::vector<U32>& stale) const
+{
+    for (U32 i = 0; i < count; ++i)
+    {
+        const U32 row = rows[i];
+        if (row >= mFace.size() || !mFace[row])
+        {
+            continue;
+        }
+        if (mUpdateTime[row] < stale_time)
+        {
+            stale.push_back(row);
+            continue;
+        }
+
+        const U8 flags = mFlags[row];
+        if (flags & ROW_VALID)
+        {
+            batch.mPixelArea.push_back(mPixelArea[row]);
+            batch.mMinScale.push_back(mMinScale[row]);
+            batch.mDistance.push_back(mDistance[row]);
+            batch.mVisible.push_back(flags & ROW_VISIBLE ? 1.f : 0.f);
+            batch.mImage.push_back(image_index);
+            batch.mRow.push_back(row);
+            batch.mMaterial.push_back(flags & ROW_MATERIAL ? 1 : 0);
+        }
+    }
+}
+
+//static
+void LLFacePriorityTable::computeVirtualSizes(Batch& batch, F32 discard_bias, F32 distance_scale)
+{
+    const size_t count = batch.size();
+    batch.mVirtualSize.resize(count);
+
+    // Plain arithmetic over flat arrays, which the compiler vectorizes
+    const F32 inv_bias = 1.f / discard_bias;
+    const F32 bias_minus_one = llmax(discard_bias - 1.f, 0.f);
+    const F32* pixel_area = batch.mPixelArea.data();
+    const F32* min_scale = batch.mMinScale.data();
+    const F32* distance = batch.mDistance.data();
+    const F32* visible = batch.mVisible.data();
+    F32* vsize = batch.mVirtualSize.data();
+    for (size_t i = 0; i < count; ++i)
+    {
+        F32 scale = llmax(min_scale[i] * min_scale[i], 0.1f);
+        F32 size = pixel_area[i] / scale * inv_bias;
+        size /= llmax(1.f, bias_minus_one * (1.f + distance[i] * distance_scale));
+        // further reduce by discard bias when off screen or occluded
+        vsize[i] = size * (visible[i] + (1.f - visible[i]) * inv_bias);
+    }
+}
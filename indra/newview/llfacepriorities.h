@@ -0,0 +1,107 @@
+/**
+ * @file llfacepriorities.h
+ * @brief Per face inputs to the virtual size of the textures.
+ *
+ * @Description:
+ * Each face owns a row of the table for as long as it lives and writes its
+ * pixel area, texture scale, distance and visibility there whenever it
+ * computes them. The texture list then gathers the rows of the faces of a
+ * texture without touching the faces, and computes their virtual sizes in
+ * one pass over flat arrays. Rows nobody wrote for a while are reported as
+ * stale so that the caller can have their face refresh them.
+ *
+ * Main thread only.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLFACEPRIORITIES_H
+#define LL_LLFACEPRIORITIES_H
+
+#include <vector>
+
+class LLFace;
+
+class LLFacePriorityTable
+{
+public:
+    static const U32 NO_ROW = U32_MAX;
+
+    // What a face writes to its row
+    struct Inputs
+    {
+        F32 mPixelArea = 0.f;
+        F32 mMinScale = 1.f;    // smallest of the texture repeats
+        F32 mDistance = 0.f;    // from the camera
+        bool mVisible = false;  // in frustum and visible
+        bool mMaterial = false; // stats go to the GLTF material textures
+        bool mValid = false;    // the face has an object and texture entry
+    };
+
+    // Inputs of the faces of the textures updated this frame, one entry per
+    // face in each array. Kept across frames so the storage is reused.
+    struct Batch
+    {
+        std::vector<F32> mPixelArea;
+        std::vector<F32> mMinScale;
+        std::vector<F32> mDistance;
+        std::vector<F32> mVisible; // 1 in frustum and visible, 0 otherwise
+        std::vector<F32> mVirtualSize; // result
+        std::vector<U32> mImage; // index of the texture in the update batch
+        std::vector<U32> mRow;
+        std::vector<U8> mMaterial;
+
+        void clear();
+        size_t size() const { return mPixelArea.size(); }
+    };
+
+    // Row for face, its inputs are invalid until the first update()
+    U32 add(LLFace* face);
+    void remove(U32 row);
+
+    void update(U32 row, const Inputs& inputs, F32 now);
+    bool getInputs(U32 row, Inputs& inputs) const;
+    LLFace* getFace(U32 row) const { return row < mFace.size() ? mFace[row] : nullptr; }
+    U32 getRowCount() const { return (U32)(mFace.size() - mFreeRows.size()); }
+
+    /**
+     * Append the valid rows among count rows to batch, for the texture at
+     * image_index. Rows last updated before stale_time are appended to
+     * stale instead, for the caller to refresh and gather on their own.
+     */
+    void gather(const U32* rows, U32 count, U32 image_index, F32 stale_time,
+                Batch& batch, std::vector<U32>& stale) const;
+
+    // Fill batch.mVirtualSize from the gathered inputs
+    static void computeVirtualSizes(Batch& batch, F32 discard_bias, F32 distance_scale);
+
+private:
+    std::vector<F32> mPixelArea;
+    std::vector<F32> mMinScale;
+    std::vector<F32> mDistance;
+    std::vector<F32> mUpdateTime;
+    std::vector<U8> mFlags;
+    std::vector<LLFace*> mFace;
+    std::vector<U32> mFreeRows;
+};
+
+#endif // LL_LLFACEPRIORITIES_H
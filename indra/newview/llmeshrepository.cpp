@@ -46,6 +46,7 @@
 #include "llsdserialize.h"
 #include "llthread.h"
 #include "llfilesystem.h"
+#include "lldiskcache.h"
 #include "llviewercontrol.h"
 #include "llviewerinventory.h"
 #include "llviewermenufile.h"
@@ -68,6 +69,7 @@
 #include "bufferarray.h"
 #include "bufferstream.h"
 #include "llfasttimer.h"
+#include "lltrace.h"
 #include "llcorehttputil.h"
 #include "lltrans.h"
 #include "llstatusbar.h"
@@ -80,6 +82,9 @@
 #include <boost/iostreams/device/array.hpp>
 #include <boost/iostreams/stream.hpp>
 
+#include <algorithm>
+#include <thread>
+
 #ifndef LL_WINDOWS
 #include "netdb.h"
 #endif
@@ -109,6 +114,8 @@
 //
 //   main     Main rendering thread, very sensitive to locking and other stalls
 //   repo     Overseeing worker thread associated with the LLMeshRepoThread class
+//   decode   LLMeshRepoThread::mDecodePool threads decoding LOD, skin, decomposition
+//            and physics shape blocks, one task per block
 //   decom    Worker thread for mesh decomposition requests
 //   core     HTTP worker thread:  does the work but doesn't intrude here
 //   uploadN  0-N temporary mesh upload threads (0-1 in practice)
@@ -122,7 +129,7 @@
 //   pipeline to achieve throughput.  Ellipsis indicates a return
 //   or break in processing which is resumed elsewhere.
 //
-//         main thread         repo thread (run() method)
+//         main thread         repo thread (run() method)       decode thread
 //
 //         loadMesh() invoked to request LOD
 //           append LODRequest to mPendingRequests
@@ -137,11 +144,16 @@
 //                             ...
 //                             onCompleted() invoked for GET
 //                               data copied
-//                               headerReceived() invoked
-//                                 LLSD parsed
-//                                 mMeshHeader updated
-//                                 scan mPendingLOD for LOD request
-//                                 push LODRequest to mLODReqQ
+//                               queueDecode() posts header
+//                             ...
+//                                                              headerReceived() invoked
+//                                                                LLSD parsed
+//                                                                mMeshHeader updated
+//                                                                scan mPendingLOD for LOD request
+//                                                                push LODRequest to mLODReqQ
+//                             ...
+//                             processDecodedBlocks() invoked
+//                               header written to cache
 //                             ...
 //                             scan mLODReqQ
 //                             fetchMeshLOD() invoked
@@ -149,9 +161,15 @@
 //                             ...
 //                             onCompleted() invoked for GET
 //                               data copied
-//                               lodReceived() invoked
-//                                 unpack data into LLVolume
-//                                 append LoadedMesh to mLoadedQ
+//                               queueDecode() posts block
+//                             ...
+//                                                              lodReceived() invoked
+//                                                                unpack data into LLVolume
+//                                                                push LoadedMesh to mLoadedQ
+//                                                              push block to mDecodedQ
+//                             ...
+//                             processDecodedBlocks() invoked
+//                               block written to cache
 //                             ...
 //         notifyLoadedMeshes() invoked again
 //           scan mLoadedQ
@@ -183,7 +201,7 @@
 //   the mutex, if any, covering the data and then a list of data
 //   access models each of which is a triplet of the following form:
 //
-//     {ro, wo, rw}.{main, repo, any}.{mutex, none}
+//     {ro, wo, rw}.{main, repo, decode, any}.{mutex, none}
 //     Type of access:  read-only, write-only, read-write.
 //     Accessing thread or 'any'
 //     Relevant mutex held during access (several may be held) or 'none'
@@ -229,6 +247,8 @@
 //     mSkinMap                        none            rw.main.none
 //     mDecompositionMap               none            rw.main.none
 //     mPendingRequests                mMeshMutex [4]  rw.main.mMeshMutex
+//     mMeshScores                     none            rw.main.none
+//     mRequestTimes                   none            rw.main.none
 //     mLoadingSkins                   mMeshMutex [4]  rw.main.mMeshMutex
 //     mPendingSkinRequests            mMeshMutex [4]  rw.main.mMeshMutex
 //     mLoadingDecompositions          mMeshMutex [4]  rw.main.mMeshMutex
@@ -246,17 +266,20 @@
 //     sActiveHeaderRequests    mMutex        rw.any.mMutex, ro.repo.none [1]
 //     sActiveLODRequests       mMutex        rw.any.mMutex, ro.repo.none [1]
 //     sMaxConcurrentRequests   mMutex        wo.main.none, ro.repo.none, ro.main.mMutex
-//     mMeshHeader              mHeaderMutex  rw.repo.mHeaderMutex, ro.main.mHeaderMutex, ro.main.none [0]
+//     mMeshHeader              mHeaderMutex  rw.repo.mHeaderMutex, rw.decode.mHeaderMutex, ro.main.mHeaderMutex, ro.main.none [0]
 //     mSkinReqQ                mMutex        rw.repo.mMutex, ro.repo.none [5]
 //     mSkinUnavailableQ        mMutex        rw.repo.mMutex, ro.repo.none [5]
-//     mSkinInfoQ               mMutex        rw.repo.mMutex, rw.main.mMutex [5] (was:  [0])
+//     mSkinInfoQ               none          wo.decode.none, rw.main.none (lock-free)
 //     mDecompositionRequests   mMutex        rw.repo.mMutex, ro.repo.none [5]
 //     mPhysicsShapeRequests    mMutex        rw.repo.mMutex, ro.repo.none [5]
-//     mDecompositionQ          mMutex        rw.repo.mMutex, rw.main.mMutex [5] (was:  [0])
+//     mDecompositionQ          none          wo.decode.none, rw.main.none (lock-free)
+//     mPhysicsQ                none          wo.decode.none, rw.main.none (lock-free)
+//     mDecodedQ                none          wo.decode.none, rw.repo.none (lock-free)
+//     mBadCacheBlocks          none          rw.repo.none
 //     mHeaderReqQ              mMutex        ro.repo.none [5], rw.repo.mMutex, rw.any.mMutex
 //     mLODReqQ                 mMutex        ro.repo.none [5], rw.repo.mMutex, rw.any.mMutex
 //     mUnavailableQ            mMutex        rw.repo.none [0], ro.main.none [5], rw.main.mMutex
-//     mLoadedQ                 mMutex        rw.repo.mMutex, ro.main.none [5], rw.main.mMutex
+//     mLoadedQ                 none          wo.decode.none, rw.main.none (lock-free)
 //     mPendingLOD              mMutex        rw.repo.mMutex, rw.any.mMutex
 //     mGetMeshCapability       mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
 //     mGetMesh2Capability      mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
@@ -341,6 +364,8 @@ static LLFastTimer::DeclareTimer FTM_MESH_FETCH("Mesh Fetch");
 LLMeshRepository gMeshRepo;
 
 const S32 MESH_HEADER_SIZE = 4096;                      // Important:  assumption is that headers fit in this space
+const size_t MESH_ZSTD_SAMPLE_BYTES = 8 * 1024 * 1024;   // Inflated blocks collected before training the cache dictionary
+const size_t MESH_ZSTD_DICT_SIZE = 64 * 1024;
 
 const S32 REQUEST_HIGH_WATER_MIN = 32;                  // Limits for GetMesh regions
 const S32 REQUEST_HIGH_WATER_MAX = 150;                 // Should remain under 2X throttle
@@ -377,6 +402,12 @@ const long UPLOAD_RETRY_LIMIT = 0L;
 // See wiki at https://wiki.secondlife.com/wiki/Mesh/Mesh_Asset_Format
 const S32 MAX_MESH_VERSION = 999;
 
+static LLTrace::SampleStatHandle<> sMeshLODPending("mesh_lod_pending", "Mesh LOD requests waiting to be sent to the mesh thread");
+static LLTrace::SampleStatHandle<> sMeshLODQueued("mesh_lod_queued", "Mesh LOD requests queued on the mesh thread");
+static LLTrace::SampleStatHandle<> sMeshLODHeld("mesh_lod_held", "Meshes whose LOD requests go last while out of view");
+static LLTrace::CountStatHandle<> sMeshLODCancelled("mesh_lod_cancelled", "Mesh LOD requests cancelled before being fetched");
+static LLTrace::EventStatHandle<F64Seconds> sMeshLODLatency("mesh_lod_latency", "Time from requesting a mesh LOD to it loading or failing");
+
 U32 LLMeshRepository::sBytesReceived = 0;
 U32 LLMeshRepository::sMeshRequestCount = 0;
 U32 LLMeshRepository::sHTTPRequestCount = 0;
@@ -409,6 +440,7 @@ namespace {
 
     void NoOpDeletor(LLCore::HttpHandler *)
     { /*NoOp*/ }
+
 }
 
 static S32 dump_num = 0;
@@ -429,6 +461,64 @@ const std::array<std::string, 4> header_lod =
 
 const char * const LOG_MESH = "Mesh";
 
+// Dictionary used to zstd encode the cached mesh blocks. It lives with the
+// blocks so that clearing the asset cache drops it too.
+static std::string mesh_cache_dictionary_filename()
+{
+    return gDirUtilp->add(LLDiskCache::getInstance()->getCacheDirName(), "mesh_zstd.dict");
+}
+
+static bool read_mesh_cache_dictionary(std::vector<U8>& dict)
+{
+    llifstream file(mesh_cache_dictionary_filename().c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    dict.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !dict.empty();
+}
+
+static void write_mesh_cache_dictionary(const std::vector<U8>& dict)
+{
+    llofstream file(mesh_cache_dictionary_filename().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        LL_WARNS(LOG_MESH) << "Unable to save the mesh cache dictionary" << LL_ENDL;
+        return;
+    }
+    file.write((const char*)dict.data(), dict.size());
+}
+
+// Received blocks are decoded after their response is released
+static std::unique_ptr<U8[]> copy_block(const U8* data, S32 data_size)
+{
+    if (!data || data_size <= 0)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<U8[]> block(new(std::nothrow) U8[data_size]);
+    if (block)
+    {
+        memcpy(block.get(), data, data_size);    /* Flawfinder: ignore */
+    }
+    else
+    {
+        LL_WARNS(LOG_MESH) << "Failed to allocate " << data_size << " memory for mesh block" << LL_ENDL;
+    }
+    return block;
+}
+
+// Identifies the mesh of a skin, decomposition or physics shape block
+static LLVolumeParams mesh_block_params(const LLUUID& mesh_id)
+{
+    LLVolumeParams volume_params;
+    volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+    volume_params.setSculptID(mesh_id, LL_SCULPT_TYPE_MESH);
+    return volume_params;
+}
+
 // Static data and functions to measure mesh load
 // time metrics for a new region scene.
 static unsigned int metrics_teleport_start_count = 0;
@@ -813,8 +903,9 @@ void log_upload_error(LLCore::HttpStatus status, const LLSD& content,
     gMeshRepo.uploadError(args);
 }
 
-LLMeshRepoThread::LLMeshRepoThread()
+LLMeshRepoThread::LLMeshRepoThread(size_t decode_threads)
 : LLThread("mesh repo"),
+  mCacheReadsInFlight(0),
   mHttpRequest(NULL),
   mHttpOptions(),
   mHttpLargeOptions(),
@@ -822,10 +913,26 @@ LLMeshRepoThread::LLMeshRepoThread()
   mHttpPolicyClass(LLCore::HttpRequest::DEFAULT_POLICY_ID),
   mHttpLegacyPolicyClass(LLCore::HttpRequest::DEFAULT_POLICY_ID),
   mHttpLargePolicyClass(LLCore::HttpRequest::DEFAULT_POLICY_ID),
-  mLegacyGetMeshVersion(0)
+  mLegacyGetMeshVersion(0),
+  mCacheZstd(false),
+  mZstdSampleBytes(0)
 {
     LLAppCoreHttp & app_core_http(LLAppViewer::instance()->getAppCoreHttp());
 
+    // The disk cache version follows MeshCacheZstd, so the cache is purged
+    // of zstd blocks when re-encoding is turned off.
+    mCacheZstd = gSavedSettings.getBOOL("MeshCacheZstd");
+    std::vector<U8> dict;
+    if (mCacheZstd && read_mesh_cache_dictionary(dict))
+    {
+        LLUZipHelper::setZstdDictionary(dict.data(), dict.size());
+    }
+    if (!LLAppViewer::instance()->isSecondInstance())
+    {
+        // left over from when the dictionary was kept outside the asset cache
+        LLFile::remove(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "mesh_zstd.dict"), ENOENT);
+    }
+
     mMutex = new LLMutex();
     mHeaderMutex = new LLMutex();
     mSignal = new LLCondition();
@@ -841,6 +948,9 @@ LLMeshRepoThread::LLMeshRepoThread()
     mHttpPolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_MESH2);
     mHttpLegacyPolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_MESH1);
     mHttpLargePolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_LARGE_MESH);
+
+    mDecodePool = std::make_unique<LL::ThreadPool>("MeshDecode", decode_threads);
+    mDecodePool->start();
 }
 
 
@@ -851,13 +961,24 @@ LLMeshRepoThread::~LLMeshRepoThread()
                        << ", Max Lock Holdoffs:  " << LLMeshRepository::sMaxLockHoldoffs
                        << LL_ENDL;
 
+    // Let the reads and decodes in flight finish before tearing down what
+    // they use
+    while (mCacheReadsInFlight.CurrentValue() > 0)
+    {
+        micro_sleep(100);
+    }
+    if (mDecodePool)
+    {
+        mDecodePool->close();
+        mDecodePool.reset();
+    }
+
     mHttpRequestSet.clear();
     mHttpHeaders.reset();
 
-    delete_and_clear(mSkinInfoQ);
-
-    mDecompositionQ.clear();
-    mPhysicsQ.clear();
+    std::vector<LLMeshSkinInfo*> skin_info_q;
+    mSkinInfoQ.takeAll(skin_info_q);
+    delete_and_clear(skin_info_q);
 
     delete mHttpRequest;
     mHttpRequest = NULL;
@@ -906,6 +1027,8 @@ void LLMeshRepoThread::run()
         }
         sRequestWaterLevel = mHttpRequestSet.size();            // Stats data update
 
+        processDecodedBlocks();
+
         // NOTE: order of queue processing intentionally favors LOD requests over header requests
         // Todo: we are processing mLODReqQ, mHeaderReqQ, mSkinRequests, mDecompositionRequests and mPhysicsShapeRequests
         // in relatively similar manners, remake code to simplify/unify the process,
@@ -922,8 +1045,13 @@ void LLMeshRepoThread::run()
                 }
 
                 mMutex->lock();
-                LODRequest req = mLODReqQ.front();
-                mLODReqQ.pop();
+                if (mLODReqQ.empty())
+                {
+                    // cancelled meanwhile
+                    mMutex->unlock();
+                    break;
+                }
+                LODRequest req = mLODReqQ.pop().second;
                 LLMeshRepository::sLODProcessing--;
                 mMutex->unlock();
                 if (req.isDelayed())
@@ -954,8 +1082,7 @@ void LLMeshRepoThread::run()
                 LLMutexLock locker(mMutex);
                 for (std::list<LODRequest>::iterator iter = incomplete.begin(); iter != incomplete.end(); iter++)
                 {
-                    mLODReqQ.push(*iter);
-                    ++LLMeshRepository::sLODProcessing;
+                    queueLODRequest(*iter);
                 }
             }
         }
@@ -1164,7 +1291,7 @@ void LLMeshRepoThread::lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32
     }
 }
 
-void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score)
 { //could be called from any thread
     const LLUUID& mesh_id = mesh_params.getSculptID();
     LLMutexLock header_lock(mHeaderMutex);
@@ -1174,10 +1301,10 @@ void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
         header_lock.unlock();
 
         LODRequest req(mesh_params, lod);
+        req.mScore = score;
         {
             LLMutexLock lock(mMutex);
-            mLODReqQ.push(req);
-            LLMeshRepository::sLODProcessing++;
+            queueLODRequest(req);
         }
     }
     else
@@ -1201,6 +1328,50 @@ void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
     }
 }
 
+// Mutex:  must be holding mMutex when called
+void LLMeshRepoThread::queueLODRequest(const LODRequest& req)
+{
+    const lod_key_t key(req.mMeshParams.getSculptID(), req.mLOD);
+    const F32 score = req.mScore;
+    if (!mLODReqQ.update(key, [score](LODRequest& queued) { queued.mScore = llmax(queued.mScore, score); }))
+    {
+        mLODReqQ.push(key, req);
+        LLMeshRepository::sLODProcessing++;
+    }
+}
+
+// Cancels a LOD request not sent yet, whether it is queued or waiting on
+// the header. Returns false when there was none.
+bool LLMeshRepoThread::cancelMeshLOD(const LLUUID& mesh_id, S32 lod)
+{ //could be called from any thread
+    LLMutexLock lock(mMutex);
+    if (mLODReqQ.erase(lod_key_t(mesh_id, lod)))
+    {
+        LLMeshRepository::sLODProcessing--;
+        return true;
+    }
+
+    pending_lod_map::iterator pending = mPendingLOD.find(mesh_id);
+    if (pending != mPendingLOD.end())
+    {
+        // the header is still fetched, other LODs or skin info may need it
+        std::vector<S32>& lods = pending->second;
+        std::vector<S32>::iterator it = std::find(lods.begin(), lods.end(), lod);
+        if (it != lods.end())
+        {
+            lods.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Mutex:  must be holding mMutex when called
+void LLMeshRepoThread::updateLODScore(const lod_key_t& key, F32 score)
+{
+    mLODReqQ.update(key, [score](LODRequest& queued) { queued.mScore = score; });
+}
+
 // Mutex:  must be holding mMutex when called
 void LLMeshRepoThread::setGetMeshCap(const std::string & mesh_cap, const std::string & legacy_get_mesh1,
                                                                     const std::string & legacy_get_mesh2,
@@ -1317,39 +1488,349 @@ LLCore::HttpHandle LLMeshRepoThread::getByteRange(const std::string & url, int l
     return handle;
 }
 
-bool LLMeshRepoThread::loadInfoFromFilesystem(const LLUUID& mesh_id, MeshHeaderInfo& info, boost::function<bool(const LLUUID&, U8*, S32)> fn)
+void LLMeshRepoThread::encodeForCache(DecodedBlock& block)
 {
-    //check cache for mesh skin info
-    LLFileSystem file(mesh_id, LLAssetType::AT_MESH);
-    if (file.getSize() >= info.mOffset + info.mSize)
+    LL_PROFILE_ZONE_SCOPED;
+
+    // The cached asset keeps the layout described by its header, so the
+    // frame has to fit in the space of the block. The rest is zero padding,
+    // which the decoder skips.
+    const S32 size = block.mSize;
+    std::unique_ptr<U8[]> buffer(new(std::nothrow) U8[size]());
+    if (!buffer)
+    {
+        return;
+    }
+
+    bool sample;
+    {
+        LLMutexLock lock(&mZstdMutex);
+        sample = mZstdSampleBytes < MESH_ZSTD_SAMPLE_BYTES && !LLUZipHelper::hasZstdDictionary();
+    }
+    std::vector<U8> raw;
+    const S32 encoded = LLUZipHelper::recompressZstd(block.mData.get(), size, buffer.get(), size, sample ? &raw : nullptr);
+    if (encoded > 0)
     {
-        auto buffer = std::make_unique<U8[]>(info.mSize);
-        if (!buffer)
+        block.mData = std::move(buffer);
+        block.mDataSize = size;
+    }
+
+    if (sample && !raw.empty())
+    {
+        std::vector<std::vector<U8>> samples;
         {
-            LL_WARNS_ONCE(LOG_MESH) << "Failed to allocate memory for mesh data load, size: " << info.mSize << LL_ENDL;
-            return false;
+            LLMutexLock lock(&mZstdMutex);
+            if (mZstdSampleBytes >= MESH_ZSTD_SAMPLE_BYTES)
+            {
+                // another decode thread got there first
+                return;
+            }
+            mZstdSampleBytes += raw.size();
+            mZstdSamples.emplace_back(std::move(raw));
+            if (mZstdSampleBytes >= MESH_ZSTD_SAMPLE_BYTES)
+            {
+                // Whatever the outcome, don't sample again this session
+                samples.swap(mZstdSamples);
+            }
+        }
+        if (!samples.empty())
+        {
+            trainCacheDictionary(samples);
         }
-        LLMeshRepository::sCacheBytesRead += info.mSize;
-        ++LLMeshRepository::sCacheReads;
-        file.seek(info.mOffset);
-        file.read(buffer.get(), info.mSize);
+    }
+}
+
+void LLMeshRepoThread::trainCacheDictionary(const std::vector<std::vector<U8>>& samples)
+{
+    LL_PROFILE_ZONE_SCOPED;
+
+    std::vector<U8> dict;
+    if (LLUZipHelper::trainZstdDictionary(samples, MESH_ZSTD_DICT_SIZE, dict)
+        && LLUZipHelper::setZstdDictionary(dict.data(), dict.size()))
+    {
+        LL_INFOS(LOG_MESH) << "Trained " << dict.size() << " bytes mesh cache dictionary from "
+                           << samples.size() << " blocks" << LL_ENDL;
+        write_mesh_cache_dictionary(dict);
+    }
+}
+
+bool LLMeshRepoThread::loadInfoFromFilesystem(EMeshBlock type, const LLVolumeParams& mesh_params, S32 lod, const MeshHeaderInfo& info)
+{
+    const LLUUID& mesh_id = mesh_params.getSculptID();
+    if (mBadCacheBlocks.count(std::make_pair(mesh_id, info.mOffset)))
+    {
+        // failed to decode before, fetch it from the sim
+        return false;
+    }
+
+    //check cache for mesh skin info
+    if (LLFileSystem::getFileSize(mesh_id, LLAssetType::AT_MESH) < info.mOffset + info.mSize)
+    {
+        return false;
+    }
+
+    LLMeshRepository::sCacheBytesRead += info.mSize;
+    ++LLMeshRepository::sCacheReads;
+    readCachedBlock(type, mesh_params, lod, info.mOffset, info.mSize);
+    return true;
+}
+
+void LLMeshRepoThread::readCachedBlock(EMeshBlock type, const LLVolumeParams& mesh_params, S32 lod, S32 offset, S32 size)
+{
+    LLFileSystem::ReadRequest request;
+    request.mFileID = mesh_params.getSculptID();
+    request.mFileType = LLAssetType::AT_MESH;
+    request.mOffset = offset;
+    request.mBytes = size;
+
+    ++mCacheReadsInFlight;
+    auto read = [this, type, mesh_params, lod, offset, size](LLFileSystem::ReadResult& result)
+    {
+        cachedBlockRead(type, mesh_params, lod, offset, size, result);
+        --mCacheReadsInFlight;
+    };
+    if (!LLFileSystem::readAsyncOnWorker({ request }, read))
+    {
+        // no read pool, read on this thread
+        LLFileSystem::ReadResult result;
+        LLFileSystem::readRequest(request, result);
+        read(result);
+    }
+}
+
+void LLMeshRepoThread::cachedBlockRead(EMeshBlock type, const LLVolumeParams& mesh_params, S32 lod, S32 offset, S32 size,
+                                       LLFileSystem::ReadResult& result)
+{
+    //make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
+    bool zero = true;
+    const S32 bytes = (S32)result.mData.size();
+    for (S32 i = 0; i < llmin(bytes, S32(1024)) && zero; ++i)
+    {
+        zero = result.mData[i] > 0 ? false : true;
+    }
+
+    std::unique_ptr<U8[]> buffer;
+    if (result.mSuccess && bytes == size && !zero)
+    {
+        buffer = copy_block(result.mData.data(), bytes);
+    }
+
+    if (buffer)
+    { //attempt to parse, off this thread
+        queueDecode(type, mesh_params, lod, true, std::move(buffer), size, offset, size);
+        return;
+    }
+
+    // Not in the cache after all, processDecodedBlocks() fetches it from the sim
+    auto block = std::make_shared<DecodedBlock>();
+    block->mType = type;
+    block->mMeshParams = mesh_params;
+    block->mLOD = lod;
+    block->mFromCache = true;
+    block->mOffset = offset;
+    block->mSize = size;
+    block->mDataSize = 0;
+    block->mResult = MESH_NO_DATA;
+    mDecodedQ.push(block);
+    mSignal->signal();
+}
+
+void LLMeshRepoThread::queueDecode(EMeshBlock type, const LLVolumeParams& mesh_params, S32 lod, bool from_cache,
+                                   std::unique_ptr<U8[]> data, S32 data_size, S32 offset, S32 size)
+{
+    auto block = std::make_shared<DecodedBlock>();
+    block->mType = type;
+    block->mMeshParams = mesh_params;
+    block->mLOD = lod;
+    block->mFromCache = from_cache;
+    block->mOffset = offset;
+    block->mSize = size;
+    block->mData = std::move(data);
+    block->mDataSize = data_size;
+    block->mResult = MESH_UNKNOWN;
+
+    auto decode = [this, block]()
+    {
+        decodeBlock(*block);
+        mDecodedQ.push(block);
+        mSignal->signal();
+    };
+
+    if (!mDecodePool || !mDecodePool->getQueue().post(decode))
+    {
+        // pool closed on shutdown, decode on this thread
+        decodeBlock(*block);
+        mDecodedQ.push(block);
+    }
+}
+
+void LLMeshRepoThread::decodeBlock(DecodedBlock& block)
+{
+    LL_PROFILE_ZONE_SCOPED;
+
+    const LLUUID& mesh_id = block.mMeshParams.getSculptID();
+    U8* data = block.mData.get();
+    switch (block.mType)
+    {
+    case MESH_BLOCK_HEADER:
+        block.mResult = headerReceived(block.mMeshParams, data, block.mDataSize);
+        break;
+    case MESH_BLOCK_LOD:
+        block.mResult = lodReceived(block.mMeshParams, block.mLOD, data, block.mDataSize);
+        break;
+    case MESH_BLOCK_SKIN:
+        block.mResult = skinInfoReceived(mesh_id, data, block.mDataSize);
+        break;
+    case MESH_BLOCK_DECOMPOSITION:
+        block.mResult = decompositionReceived(mesh_id, data, block.mDataSize);
+        break;
+    case MESH_BLOCK_PHYSICS_SHAPE:
+        block.mResult = physicsShapeReceived(mesh_id, data, block.mDataSize);
+        break;
+    }
+
+    // Only fetched blocks which decoded get written to the cache
+    if (block.mFromCache || block.mResult != MESH_OK)
+    {
+        block.mData.reset();
+    }
+    else if (mCacheZstd && block.mDataSize >= block.mSize)
+    {
+        // Inflating and encoding again is done here rather than on the repo
+        // thread, which only writes the result
+        encodeForCache(block);
+    }
+}
+
+void LLMeshRepoThread::processDecodedBlocks()
+{
+    std::vector<std::shared_ptr<DecodedBlock>> blocks;
+    if (!mDecodedQ.takeAll(blocks))
+    {
+        return;
+    }
 
-        //make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
-        bool zero = true;
-        for (S32 i = 0; i < llmin(info.mSize, S32(1024)) && zero; ++i)
+    LL_PROFILE_ZONE_SCOPED;
+    for (const auto& block : blocks)
+    {
+        const LLUUID& mesh_id = block->mMeshParams.getSculptID();
+        if (block->mFromCache)
         {
-            zero = buffer[i] > 0 ? false : true;
+            if (block->mResult == MESH_OK)
+            {
+                continue;
+            }
+
+            // Corrupt or stale cache entry, fetch the block from the sim
+            LL_DEBUGS(LOG_MESH) << "Cached mesh block failed to decode, refetching.  ID:  " << mesh_id
+                                << ", Reason: " << block->mResult << LL_ENDL;
+            mBadCacheBlocks.emplace(mesh_id, block->mOffset);
+
+            LLMutexLock lock(mMutex);
+            switch (block->mType)
+            {
+            case MESH_BLOCK_HEADER:
+                mHeaderReqQ.push(HeaderRequest(block->mMeshParams));
+                break;
+            case MESH_BLOCK_LOD:
+                queueLODRequest(LODRequest(block->mMeshParams, block->mLOD));
+                break;
+            case MESH_BLOCK_SKIN:
+                mSkinReqQ.emplace(mesh_id);
+                break;
+            case MESH_BLOCK_DECOMPOSITION:
+                mDecompositionRequests.emplace(mesh_id);
+                break;
+            case MESH_BLOCK_PHYSICS_SHAPE:
+                mPhysicsShapeRequests.emplace(mesh_id);
+                break;
+            }
         }
+        else if (block->mResult == MESH_OK)
+        {
+            // good fetch from sim, write to cache
+            mBadCacheBlocks.erase(std::make_pair(mesh_id, block->mOffset));
 
-        if (!zero)
-        { //attempt to parse
-            if (fn(mesh_id, buffer.get(), info.mSize) == MESH_OK)
+            if (block->mType == MESH_BLOCK_HEADER)
             {
-                return true;
+                if (block->mData && block->mDataSize > 0)
+                {
+                    cacheFetchedHeader(block->mMeshParams, block->mData.get(), block->mDataSize);
+                }
+                continue;
+            }
+
+            // <FS:Ansariel> Fix asset caching
+            //LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::WRITE);
+            LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
+
+            S32 offset = block->mOffset;
+            S32 size = block->mSize;
+
+            if (file.getSize() >= offset+size)
+            {
+                LLMeshRepository::sCacheBytesWritten += size;
+                ++LLMeshRepository::sCacheWrites;
+                file.seek(offset);
+                file.write(block->mData.get(), size);
+            }
+        }
+        else
+        {
+            switch (block->mType)
+            {
+            case MESH_BLOCK_HEADER:
+            {
+                // *TODO:  Get real reason for parse failure here.  Might we want to retry?
+                LL_WARNS(LOG_MESH) << "Unable to parse mesh header.  ID:  " << mesh_id
+                                   << ", Size: " << block->mDataSize
+                                   << ", Reason: " << block->mResult << " Not retrying."
+                                   << LL_ENDL;
+
+                // Can't get the header so none of the LODs will be available
+                LLMutexLock lock(mMutex);
+                for (int i(0); i < LLVolumeLODGroup::NUM_LODS; ++i)
+                {
+                    mUnavailableQ.emplace_back(block->mMeshParams, i);
+                }
+                break;
+            }
+            case MESH_BLOCK_LOD:
+            {
+                LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mesh_id
+                                   << ", Reason: " << block->mResult
+                                   << " LOD: " << block->mLOD
+                                   << " Data size: " << block->mDataSize
+                                   << " Not retrying."
+                                   << LL_ENDL;
+                LLMutexLock lock(mMutex);
+                mUnavailableQ.emplace_back(block->mMeshParams, block->mLOD);
+                break;
+            }
+            case MESH_BLOCK_SKIN:
+            {
+                LL_WARNS(LOG_MESH) << "Error during mesh skin info processing.  ID:  " << mesh_id
+                                   << ", Reason: " << block->mResult << ".  Not retrying."
+                                   << LL_ENDL;
+                LLMutexLock lock(mMutex);
+                mSkinUnavailableQ.emplace_back(mesh_id);
+                break;
+            }
+            case MESH_BLOCK_DECOMPOSITION:
+                LL_WARNS(LOG_MESH) << "Error during mesh decomposition processing.  ID:  " << mesh_id
+                                   << ", Reason: " << block->mResult << ".  Not retrying."
+                                   << LL_ENDL;
+                // *TODO:  Mark mesh unavailable on error
+                break;
+            case MESH_BLOCK_PHYSICS_SHAPE:
+                LL_WARNS(LOG_MESH) << "Error during mesh physics shape processing.  ID:  " << mesh_id
+                                   << ", Reason: " << block->mResult << ".  Not retrying."
+                                   << LL_ENDL;
+                // *TODO:  Mark mesh unavailable on error
+                break;
             }
         }
     }
-    return false;
 }
 
 bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_retry)
@@ -1383,7 +1864,7 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_retry)
     if (info.mVersion <= MAX_MESH_VERSION && info.mOffset >= 0 && info.mSize > 0)
     {
         //check cache for mesh skin info
-        if (loadInfoFromFilesystem(mesh_id, info, boost::bind(&LLMeshRepoThread::skinInfoReceived, this, _1, _2, _3)))
+        if (loadInfoFromFilesystem(MESH_BLOCK_SKIN, mesh_block_params(mesh_id), 0, info))
             return true;
 
         //reading from cache failed for whatever reason, fetch from sim
@@ -1461,7 +1942,7 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
     if (info.mVersion <= MAX_MESH_VERSION && info.mOffset >= 0 && info.mSize > 0)
     {
         //check cache for mesh physics info
-        if (loadInfoFromFilesystem(mesh_id, info, boost::bind(&LLMeshRepoThread::decompositionReceived, this, _1, _2, _3)))
+        if (loadInfoFromFilesystem(MESH_BLOCK_DECOMPOSITION, mesh_block_params(mesh_id), 0, info))
             return true;
 
         //reading from cache failed for whatever reason, fetch from sim
@@ -1523,7 +2004,7 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 
     if (info.mVersion <= MAX_MESH_VERSION && info.mOffset >= 0 && info.mSize > 0)
     {
-        if (loadInfoFromFilesystem(mesh_id, info, boost::bind(&LLMeshRepoThread::physicsShapeReceived, this, _1, _2, _3)))
+        if (loadInfoFromFilesystem(MESH_BLOCK_PHYSICS_SHAPE, mesh_block_params(mesh_id), 0, info))
             return true;
 
         //reading from cache failed for whatever reason, fetch from sim
@@ -1590,30 +2071,25 @@ void LLMeshRepoThread::decActiveHeaderRequests()
 //return false if failed to get header
 bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params, bool can_retry)
 {
+    if (!mBadCacheBlocks.count(std::make_pair(mesh_params.getSculptID(), 0)))
     {
         //look for mesh in asset in cache
-        LLFileSystem file(mesh_params.getSculptID(), LLAssetType::AT_MESH);
-
-        S32 size = file.getSize();
+        S32 size = LLFileSystem::getFileSize(mesh_params.getSculptID(), LLAssetType::AT_MESH);
 
         if (size > 0)
         {
             // *NOTE:  if the header size is ever more than 4KB, this will break
-            U8 buffer[MESH_HEADER_SIZE];
             S32 bytes = llmin(size, MESH_HEADER_SIZE);
             LLMeshRepository::sCacheBytesRead += bytes;
             ++LLMeshRepository::sCacheReads;
-            file.read(buffer, bytes);
-            if (headerReceived(mesh_params, buffer, bytes) == MESH_OK)
-            {
 #ifdef SHOW_DEBUG
-                std::string mid;
-                mesh_params.getSculptID().toString(mid);
-                LL_DEBUGS(LOG_MESH) << "Mesh/Cache: Mesh header for ID " << mid << " - was retrieved from the cache." << LL_ENDL;
+            std::string mid;
+            mesh_params.getSculptID().toString(mid);
+            LL_DEBUGS(LOG_MESH) << "Mesh/Cache: Mesh header for ID " << mid << " - was retrieved from the cache." << LL_ENDL;
 #endif
-                // Found mesh in cache
-                return true;
-            }
+            // Read and parsed off this thread, fetched from the sim if it fails
+            readCachedBlock(MESH_BLOCK_HEADER, mesh_params, 0, 0, bytes);
+            return true;
         }
     }
 
@@ -1687,7 +2163,7 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 
     if(info.mVersion <= MAX_MESH_VERSION && info.mOffset >= 0 && info.mSize > 0)
     {
-        if (loadInfoFromFilesystem(mesh_id, info, boost::bind(&LLMeshRepoThread::lodReceived, this, mesh_params, lod, _2, _3 )))
+        if (loadInfoFromFilesystem(MESH_BLOCK_LOD, mesh_params, lod, info))
             return true;
 
         //reading from cache failed for whatever reason, fetch from sim
@@ -1802,9 +2278,7 @@ EMeshProcessingResult LLMeshRepoThread::headerReceived(const LLVolumeParams& mes
         {
             for (U32 i = 0; i < iter->second.size(); ++i)
             {
-                LODRequest req(mesh_params, iter->second[i]);
-                mLODReqQ.push(req);
-                LLMeshRepository::sLODProcessing++;
+                queueLODRequest(LODRequest(mesh_params, iter->second[i]));
             }
             mPendingLOD.erase(iter);
         }
@@ -1813,6 +2287,89 @@ EMeshProcessingResult LLMeshRepoThread::headerReceived(const LLVolumeParams& mes
     return MESH_OK;
 }
 
+void LLMeshRepoThread::cacheFetchedHeader(const LLVolumeParams& mesh_params, const U8* data, S32 data_size)
+{
+    const LLUUID& mesh_id = mesh_params.getSculptID();
+
+    // header was successfully retrieved from sim and parsed
+    S32 header_bytes = 0;
+    LLMeshHeader header;
+
+    mHeaderMutex->lock();
+    mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
+    if (iter != mMeshHeader.end())
+    {
+        header_bytes = (S32)iter->second.first;
+        header = iter->second.second;
+    }
+
+    if (header_bytes > 0
+        && !header.m404
+        && (header.mVersion <= MAX_MESH_VERSION))
+    {
+        S32 lod_bytes = 0;
+
+        for (U32 i = 0; i < LLModel::LOD_PHYSICS; ++i)
+        {
+            // figure out how many bytes we'll need to reserve in the file
+            lod_bytes = llmax(lod_bytes, header.mLodOffset[i]+header.mLodSize[i]);
+        }
+
+        // just in case skin info or decomposition is at the end of the file (which it shouldn't be)
+        lod_bytes = llmax(lod_bytes, header.mSkinOffset+header.mSkinSize);
+        lod_bytes = llmax(lod_bytes, header.mPhysicsConvexOffset + header.mPhysicsConvexSize);
+
+        // Do not unlock mutex untill we are done with LLSD.
+        // LLSD is smart and can work like smart pointer, is not thread safe.
+        mHeaderMutex->unlock();
+
+        S32 bytes = lod_bytes + header_bytes;
+
+
+        // It's possible for the remote asset to have more data than is needed for the local cache
+        // only allocate as much space in the cache as is needed for the local cache
+        data_size = llmin(data_size, bytes);
+
+        // <FS:Ansariel> Fix asset caching
+        //LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::WRITE);
+        LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
+        if (file.getMaxSize() >= bytes)
+        {
+            LLMeshRepository::sCacheBytesWritten += data_size;
+            ++LLMeshRepository::sCacheWrites;
+
+            file.write(data, data_size);
+
+            // <FS:Ansariel> Fix asset caching
+            S32 remaining = bytes - file.tell();
+            if (remaining > 0)
+            {
+                U8* block = new(std::nothrow) U8[remaining];
+                if (block)
+                {
+                    memset(block, 0, remaining);
+                    file.write(block, remaining);
+                    delete[] block;
+                }
+            }
+            // </FS:Ansariel>
+        }
+    }
+    else
+    {
+        LL_WARNS(LOG_MESH) << "Trying to cache nonexistent mesh, mesh id: " << mesh_id << LL_ENDL;
+
+        mHeaderMutex->unlock();
+
+        // headerReceived() parsed header, but header's data is invalid so none of the LODs will be available
+        LLMutexLock lock(mMutex);
+        for (int i(0); i < LLVolumeLODGroup::NUM_LODS; ++i)
+        {
+            mUnavailableQ.emplace_back(mesh_params, i);
+        }
+    }
+}
+
 EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
 {
     if (data == NULL || data_size == 0)
@@ -1825,17 +2382,11 @@ EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_p
     {
         if (volume->getNumFaces() > 0)
         {
-            LoadedMesh mesh(volume, mesh_params, lod);
-            {
-                LLMutexLock lock(mMutex);
-                mLoadedQ.push_back(mesh);
-                // LLPointer is not thread safe, since we added this pointer into
-                // threaded list, make sure counter gets decreased inside mutex lock
-                // and won't affect mLoadedQ processing
-                volume = NULL;
-                // might be good idea to turn mesh into pointer to avoid making a copy
-                mesh.mVolume = NULL;
-            }
+            // LLPointer is not thread safe, move the only reference into the
+            // queue so that the count is not touched again off the main thread
+            LoadedMesh mesh(NULL, mesh_params, lod);
+            mesh.mVolume = std::move(volume);
+            mLoadedQ.push(std::move(mesh));
             return MESH_OK;
         }
     }
@@ -1881,10 +2432,7 @@ EMeshProcessingResult LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id,
         }
 
         // LL_DEBUGS(LOG_MESH) << "info pelvis offset" << info.mPelvisOffset << LL_ENDL;
-        {
-            LLMutexLock lock(mMutex);
-            mSkinInfoQ.emplace_back(skin_info);
-        }
+        mSkinInfoQ.push(skin_info);
     }
 
     return MESH_OK;
@@ -1918,10 +2466,7 @@ EMeshProcessingResult LLMeshRepoThread::decompositionReceived(const LLUUID& mesh
     {
         auto d = std::make_unique<LLModel::Decomposition>(decomp);
         d->mMeshID = mesh_id;
-        {
-            LLMutexLock lock(mMutex);
-            mDecompositionQ.emplace_back(std::move(d));
-        }
+        mDecompositionQ.push(std::move(d));
     }
 
     return MESH_OK;
@@ -1971,10 +2516,7 @@ EMeshProcessingResult LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_
         }
     }
 
-    {
-        LLMutexLock lock(mMutex);
-        mPhysicsQ.emplace_back(std::move(d));
-    }
+    mPhysicsQ.push(std::move(d));
     return MESH_OK;
 }
 
@@ -2766,37 +3308,25 @@ void LLMeshRepoThread::notifyLoadedMeshes()
     std::deque<UUIDBasedRequest> skin_info_unavail_q;
     std::deque<std::unique_ptr<LLModel::Decomposition>> decomp_q;
     std::deque<std::unique_ptr<LLModel::Decomposition>> physics_q;
+
+    // Decoded results are handed over without locking
+    mLoadedQ.takeAll(loaded_queue);
+    mSkinInfoQ.takeAll(skin_info_q);
+    mDecompositionQ.takeAll(decomp_q);
+    mPhysicsQ.takeAll(physics_q);
+
+    if (!mUnavailableQ.empty() || !mSkinUnavailableQ.empty())
     {
         LLMutexLock mtx_lock(mMutex);
-        if (!mLoadedQ.empty())
-        {
-            loaded_queue.swap(mLoadedQ);
-        }
-
         if (!mUnavailableQ.empty())
         {
             unavil_queue.swap(mUnavailableQ);
         }
 
-        if (!mSkinInfoQ.empty())
-        {
-            skin_info_q.swap(mSkinInfoQ);
-        }
-
         if (!mSkinUnavailableQ.empty())
         {
             skin_info_unavail_q.swap(mSkinUnavailableQ);
         }
-
-        if (!mDecompositionQ.empty())
-        {
-            decomp_q.swap(mDecompositionQ);
-        }
-
-        if (!mPhysicsQ.empty())
-        {
-            physics_q.swap(mPhysicsQ);
-        }
     }
 
 
@@ -3096,22 +3626,23 @@ void LLMeshHeaderHandler::processFailure(LLCore::HttpStatus status)
 void LLMeshHeaderHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
                                       U8 * data, S32 data_size)
 {
-    const LLUUID& mesh_id = mMeshParams.getSculptID();
+    // no data is a valid reply, headerReceived() marks the mesh as non-existent
+    std::unique_ptr<U8[]> block;
     bool success = (!MESH_HEADER_PROCESS_FAILED)
-        && ((data != NULL) == (data_size > 0)); // if we have data but no size or have size but no data, something is wrong;
+        && ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
+        && (!data || (block = copy_block(data, data_size)));
     llassert(success);
-    EMeshProcessingResult res = MESH_UNKNOWN;
     if (success)
     {
-        res = gMeshRepo.mThread->headerReceived(mMeshParams, data, data_size);
-        success = (res == MESH_OK);
+        // parsed off this thread, processDecodedBlocks() writes it to cache
+        gMeshRepo.mThread->queueDecode(LLMeshRepoThread::MESH_BLOCK_HEADER, mMeshParams, 0, false,
+                                       std::move(block), data_size, 0, data_size);
     }
-    if (! success)
+    else
     {
-        // *TODO:  Get real reason for parse failure here.  Might we want to retry?
-        LL_WARNS(LOG_MESH) << "Unable to parse mesh header.  ID:  " << mesh_id
+        LL_WARNS(LOG_MESH) << "Unable to parse mesh header.  ID:  " << mMeshParams.getSculptID()
                            << ", Size: " << data_size
-                           << ", Reason: " << res << " Not retrying."
+                           << ", Unknown reason.  Not retrying."
                            << LL_ENDL;
 
         // Can't get the header so none of the LODs will be available
@@ -3121,88 +3652,6 @@ void LLMeshHeaderHandler::processData(LLCore::BufferArray * /* body */, S32 /* b
             gMeshRepo.mThread->mUnavailableQ.emplace_back(mMeshParams, i);
         }
     }
-    else if (data && data_size > 0)
-    {
-        // header was successfully retrieved from sim and parsed and is in cache
-        S32 header_bytes = 0;
-        LLMeshHeader header;
-
-        gMeshRepo.mThread->mHeaderMutex->lock();
-        LLMeshRepoThread::mesh_header_map::iterator iter = gMeshRepo.mThread->mMeshHeader.find(mesh_id);
-        if (iter != gMeshRepo.mThread->mMeshHeader.end())
-        {
-            header_bytes = (S32)iter->second.first;
-            header = iter->second.second;
-        }
-
-        if (header_bytes > 0
-            && !header.m404
-            && (header.mVersion <= MAX_MESH_VERSION))
-        {
-            std::stringstream str;
-
-            S32 lod_bytes = 0;
-
-            for (U32 i = 0; i < LLModel::LOD_PHYSICS; ++i)
-            {
-                // figure out how many bytes we'll need to reserve in the file
-                lod_bytes = llmax(lod_bytes, header.mLodOffset[i]+header.mLodSize[i]);
-            }
-
-            // just in case skin info or decomposition is at the end of the file (which it shouldn't be)
-            lod_bytes = llmax(lod_bytes, header.mSkinOffset+header.mSkinSize);
-            lod_bytes = llmax(lod_bytes, header.mPhysicsConvexOffset + header.mPhysicsConvexSize);
-
-            // Do not unlock mutex untill we are done with LLSD.
-            // LLSD is smart and can work like smart pointer, is not thread safe.
-            gMeshRepo.mThread->mHeaderMutex->unlock();
-
-            S32 bytes = lod_bytes + header_bytes;
-
-
-            // It's possible for the remote asset to have more data than is needed for the local cache
-            // only allocate as much space in the cache as is needed for the local cache
-            data_size = llmin(data_size, bytes);
-
-            // <FS:Ansariel> Fix asset caching
-            //LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-            LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-            if (file.getMaxSize() >= bytes)
-            {
-                LLMeshRepository::sCacheBytesWritten += data_size;
-                ++LLMeshRepository::sCacheWrites;
-
-                file.write(data, data_size);
-
-                // <FS:Ansariel> Fix asset caching
-                S32 remaining = bytes - file.tell();
-                if (remaining > 0)
-                {
-                    U8* block = new(std::nothrow) U8[remaining];
-                    if (block)
-                    {
-                        memset(block, 0, remaining);
-                        file.write(block, remaining);
-                        delete[] block;
-                    }
-                }
-                // </FS:Ansariel>
-            }
-        }
-        else
-        {
-            LL_WARNS(LOG_MESH) << "Trying to cache nonexistent mesh, mesh id: " << mesh_id << LL_ENDL;
-
-            gMeshRepo.mThread->mHeaderMutex->unlock();
-
-            // headerReceived() parsed header, but header's data is invalid so none of the LODs will be available
-            LLMutexLock lock(gMeshRepo.mThread->mMutex);
-            for (int i(0); i < LLVolumeLODGroup::NUM_LODS; ++i)
-            {
-                gMeshRepo.mThread->mUnavailableQ.emplace_back(mMeshParams, i);
-            }
-        }
-    }
 }
 
 LLMeshLODHandler::~LLMeshLODHandler()
@@ -3232,39 +3681,14 @@ void LLMeshLODHandler::processFailure(LLCore::HttpStatus status)
 void LLMeshLODHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
                                    U8 * data, S32 data_size)
 {
+    std::unique_ptr<U8[]> block;
     if ((!MESH_LOD_PROCESS_FAILED)
-        && ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
+        && ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
+        && (block = copy_block(data, data_size)))
     {
-        EMeshProcessingResult result = gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size);
-        if (result == MESH_OK)
-        {
-            // good fetch from sim, write to cache
-            // <FS:Ansariel> Fix asset caching
-            //LLFileSystem file(mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLFileSystem::WRITE);
-            LLFileSystem file(mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-            S32 offset = mOffset;
-            S32 size = mRequestedBytes;
-
-            if (file.getSize() >= offset+size)
-            {
-                file.seek(offset);
-                file.write(data, size);
-                LLMeshRepository::sCacheBytesWritten += size;
-                ++LLMeshRepository::sCacheWrites;
-            }
-        }
-        else
-        {
-            LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mMeshParams.getSculptID()
-                               << ", Reason: " << result
-                               << " LOD: " << mLOD
-                               << " Data size: " << data_size
-                               << " Not retrying."
-                               << LL_ENDL;
-            LLMutexLock lock(gMeshRepo.mThread->mMutex);
-            gMeshRepo.mThread->mUnavailableQ.emplace_back(mMeshParams, mLOD);
-        }
+        // decoded off this thread, processDecodedBlocks() writes it to cache
+        gMeshRepo.mThread->queueDecode(LLMeshRepoThread::MESH_BLOCK_LOD, mMeshParams, mLOD, false,
+                                       std::move(block), data_size, mOffset, mRequestedBytes);
     }
     else
     {
@@ -3299,25 +3723,14 @@ void LLMeshSkinInfoHandler::processFailure(LLCore::HttpStatus status)
 void LLMeshSkinInfoHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
                                         U8 * data, S32 data_size)
 {
+    std::unique_ptr<U8[]> block;
     if ((!MESH_SKIN_INFO_PROCESS_FAILED)
         && ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
-        && gMeshRepo.mThread->skinInfoReceived(mMeshID, data, data_size) == MESH_OK)
+        && (block = copy_block(data, data_size)))
     {
-        // good fetch from sim, write to cache
-        // <FS:Ansariel> Fix asset caching
-        //LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-        LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-        S32 offset = mOffset;
-        S32 size = mRequestedBytes;
-
-        if (file.getSize() >= offset+size)
-        {
-            LLMeshRepository::sCacheBytesWritten += size;
-            ++LLMeshRepository::sCacheWrites;
-            file.seek(offset);
-            file.write(data, size);
-        }
+        // decoded off this thread, processDecodedBlocks() writes it to cache
+        gMeshRepo.mThread->queueDecode(LLMeshRepoThread::MESH_BLOCK_SKIN, mesh_block_params(mMeshID), 0, false,
+                                       std::move(block), data_size, mOffset, mRequestedBytes);
     }
     else
     {
@@ -3350,25 +3763,14 @@ void LLMeshDecompositionHandler::processFailure(LLCore::HttpStatus status)
 void LLMeshDecompositionHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
                                              U8 * data, S32 data_size)
 {
+    std::unique_ptr<U8[]> block;
     if ((!MESH_DECOMP_PROCESS_FAILED)
         && ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
-        && gMeshRepo.mThread->decompositionReceived(mMeshID, data, data_size) == MESH_OK)
+        && (block = copy_block(data, data_size)))
     {
-        // good fetch from sim, write to cache
-        // <FS:Ansariel> Fix asset caching
-        //LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-        LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-        S32 offset = mOffset;
-        S32 size = mRequestedBytes;
-
-        if (file.getSize() >= offset+size)
-        {
-            LLMeshRepository::sCacheBytesWritten += size;
-            ++LLMeshRepository::sCacheWrites;
-            file.seek(offset);
-            file.write(data, size);
-        }
+        // decoded off this thread, processDecodedBlocks() writes it to cache
+        gMeshRepo.mThread->queueDecode(LLMeshRepoThread::MESH_BLOCK_DECOMPOSITION, mesh_block_params(mMeshID), 0, false,
+                                       std::move(block), data_size, mOffset, mRequestedBytes);
     }
     else
     {
@@ -3399,25 +3801,14 @@ void LLMeshPhysicsShapeHandler::processFailure(LLCore::HttpStatus status)
 void LLMeshPhysicsShapeHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
                                             U8 * data, S32 data_size)
 {
+    std::unique_ptr<U8[]> block;
     if ((!MESH_PHYS_SHAPE_PROCESS_FAILED)
         && ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
-        && gMeshRepo.mThread->physicsShapeReceived(mMeshID, data, data_size) == MESH_OK)
+        && (block = copy_block(data, data_size)))
     {
-        // good fetch from sim, write to cache for caching
-        // <FS:Ansariel> Fix asset caching
-        //LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-        LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-        S32 offset = mOffset;
-        S32 size = mRequestedBytes;
-
-        if (file.getSize() >= offset+size)
-        {
-            LLMeshRepository::sCacheBytesWritten += size;
-            ++LLMeshRepository::sCacheWrites;
-            file.seek(offset);
-            file.write(data, size);
-        }
+        // decoded off this thread, processDecodedBlocks() writes it to cache
+        gMeshRepo.mThread->queueDecode(LLMeshRepoThread::MESH_BLOCK_PHYSICS_SHAPE, mesh_block_params(mMeshID), 0, false,
+                                       std::move(block), data_size, mOffset, mRequestedBytes);
     }
     else
     {
@@ -3438,7 +3829,7 @@ LLMeshRepository::LLMeshRepository()
     mSkinInfoCullTimer.resetWithExpiry(10.f);
 }
 
-void LLMeshRepository::init()
+void LLMeshRepository::init(size_t decode_threads)
 {
     mMeshMutex = new LLMutex();
 
@@ -3459,7 +3850,7 @@ void LLMeshRepository::init()
 
     metrics_teleport_started_signal = LLViewerMessage::getInstance()->setTeleportStartedCallback(teleport_started);
 
-    mThread = new LLMeshRepoThread();
+    mThread = new LLMeshRepoThread(decode_threads);
     mThread->start();
 }
 
@@ -3538,8 +3929,9 @@ S32 LLMeshRepository::update()
 
 void LLMeshRepository::unregisterMesh(LLVOVolume* vobj, const LLUUID& mesh_id)
 {
-    for (auto& lod : mLoadingMeshes)
+    for (S32 i = 0; i < LLVolumeLODGroup::NUM_LODS; ++i)
     {
+        auto& lod = mLoadingMeshes[i];
         auto it = lod.find(mesh_id);
         if(it != lod.end())
         {
@@ -3548,11 +3940,104 @@ void LLMeshRepository::unregisterMesh(LLVOVolume* vobj, const LLUUID& mesh_id)
             if (it->second.empty())
             {
                 lod.erase(it);
+
+                // Nobody wants this LOD anymore, drop the request unless
+                // it's already being fetched
+                const LLMeshRepoThread::lod_key_t key(mesh_id, i);
+                bool cancelled = false;
+                {
+                    LLMutexLock lock(mMeshMutex);
+                    if (mPendingRequests.erase(key))
+                    {
+                        LLMeshRepository::sLODPending--;
+                        cancelled = true;
+                    }
+                }
+                if (cancelled || (mThread && mThread->cancelMeshLOD(mesh_id, i)))
+                {
+                    add(sMeshLODCancelled, 1);
+                }
+                mRequestTimes.erase(key);
             }
         }
     }
 }
 
+// Scores the meshes being loaded by the angular size of their objects in
+// view this frame or the last. Meshes none of them has been in view for
+// MeshRequestHoldTime seconds are held, their requests go after all the
+// others until one is in view again.
+// Main thread only, see applyRequestScores() for the request queues.
+void LLMeshRepository::updateRequestScores()
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+    static LLCachedControl<F32> hold_time(gSavedSettings, "MeshRequestHoldTime", 5.f);
+    const U32 frame = LLFrameTimer::getFrameCount();
+    const F64 now = LLFrameTimer::getElapsedSeconds();
+
+    for (const auto& lod : mLoadingMeshes)
+    {
+        for (const auto& mesh : lod)
+        {
+            for (LLVOVolume* vobj : mesh.second)
+            {
+                LLDrawable* drawable = vobj->mDrawable;
+                if (drawable && drawable->isRecentlyVisible())
+                {
+                    mMeshScores.seen(mesh.first,
+                                     drawable->getRadius() / llmax(drawable->mDistanceWRTCamera, 1.f),
+                                     frame, now);
+                }
+            }
+        }
+    }
+
+    const U32 held = mMeshScores.update(now, hold_time, [this](const LLUUID& mesh_id)
+        {
+            for (const auto& lod : mLoadingMeshes)
+            {
+                if (lod.count(mesh_id))
+                {
+                    return true;
+                }
+            }
+            return false;
+        });
+    sample(sMeshLODHeld, held);
+}
+
+// Moves the pending and queued LOD requests of the meshes whose score
+// changed to their new place
+// Mutex:  must be holding mMeshMutex and mThread->mMutex
+void LLMeshRepository::applyRequestScores()
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_NETWORK;
+
+    mMeshScores.takeUpdates([this](const LLUUID& mesh_id, F32 score)
+        {
+            for (S32 lod = 0; lod < LLVolumeLODGroup::NUM_LODS; ++lod)
+            {
+                const LLMeshRepoThread::lod_key_t key(mesh_id, lod);
+                mPendingRequests.update(key, [score](LLMeshRepoThread::LODRequest& request) { request.mScore = score; });
+                mThread->updateLODScore(key, score);
+            }
+        });
+
+    sample(sMeshLODPending, mPendingRequests.size());
+    sample(sMeshLODQueued, mThread->mLODReqQ.size());
+}
+
+void LLMeshRepository::recordLODLatency(const LLMeshRepoThread::lod_key_t& key)
+{
+    auto it = mRequestTimes.find(key);
+    if (it != mRequestTimes.end())
+    {
+        record(sMeshLODLatency, F64Seconds(LLFrameTimer::getElapsedSeconds() - it->second));
+        mRequestTimes.erase(it);
+    }
+}
+
 void LLMeshRepository::unregisterSkin(LLVOVolume* vobj, const LLUUID& mesh_id)
 {
     auto it = mLoadingSkins.find(mesh_id);
@@ -3598,8 +4083,16 @@ S32 LLMeshRepository::loadMesh(LLVOVolume* vobj, const LLVolumeParams& mesh_para
             LLMutexLock lock(mMeshMutex);
             //first request for this mesh
             mLoadingMeshes[detail][mesh_id].insert(vobj);
-            mPendingRequests.emplace_back(mesh_params, detail);
-            LLMeshRepository::sLODPending++;
+
+            const F64 now = LLFrameTimer::getElapsedSeconds();
+            LLMeshRepoThread::LODRequest request(mesh_params, detail);
+            request.mScore = mMeshScores.add(mesh_id, now);
+            const LLMeshRepoThread::lod_key_t key(mesh_id, detail);
+            if (mPendingRequests.push(key, request))
+            {
+                LLMeshRepository::sLODPending++;
+            }
+            mRequestTimes[key] = now;
         }
     }
 
@@ -3796,6 +4289,7 @@ void LLMeshRepository::notifyLoadedMeshes()
     // longest run of holdoffs is kept in sMaxLockHoldoffs just
     // to collect the data.  In testing, I've never seen a value
     // greater than 2 (written to log on exit).
+    updateRequestScores();
     {
         LLMutexTrylock lock1(mMeshMutex);
         LLMutexTrylock lock2(mThread->mMutex);
@@ -3849,55 +4343,19 @@ void LLMeshRepository::notifyLoadedMeshes()
             mUploadErrorQ.pop();
         }
 
+        applyRequestScores();
+
         S32 active_count = LLMeshRepoThread::sActiveHeaderRequests + LLMeshRepoThread::sActiveLODRequests;
         if (active_count < LLMeshRepoThread::sRequestLowWater)
         {
             S32 push_count = LLMeshRepoThread::sRequestHighWater - active_count;
 
-            if (mPendingRequests.size() > push_count)
-            {
-                // More requests than the high-water limit allows so
-                // sort and forward the most important.
-
-                //calculate "score" for pending requests
-
-                //create score map
-                boost::unordered_flat_map<LLUUID, F32> score_map;
-
-                for (const auto& lod : mLoadingMeshes)
-                {
-                    for (const auto& param : lod)
-                    {
-                        F32 max_score = 0.f;
-                        for (LLVOVolume* vobj : param.second)
-                        {
-                            if (LLDrawable* drawable = vobj->mDrawable)
-                            {
-                                F32 cur_score = drawable->getRadius() / llmax(drawable->mDistanceWRTCamera, 1.f);
-                                max_score = llmax(max_score, cur_score);
-                            }
-                        }
-
-                        score_map[param.first] = max_score;
-                    }
-                }
-
-                //set "score" for pending requests
-                for (auto& request : mPendingRequests)
-                {
-                    request.mScore = score_map[request.mMeshParams.getSculptID()];
-                }
-
-                //sort by "score"
-                std::partial_sort(mPendingRequests.begin(), mPendingRequests.begin() + push_count,
-                                  mPendingRequests.end(), LLMeshRepoThread::CompareScoreGreater());
-            }
-
+            // forward the most important, highest score first
             while (!mPendingRequests.empty() && push_count > 0)
             {
-                LLMeshRepoThread::LODRequest& request = mPendingRequests.front();
-                mThread->loadMeshLOD(request.mMeshParams, request.mLOD);
-                mPendingRequests.erase(mPendingRequests.begin());
+                const LLMeshRepoThread::LODRequest& request = mPendingRequests.top();
+                mThread->loadMeshLOD(request.mMeshParams, request.mLOD, request.mScore);
+                mPendingRequests.pop();
                 LLMeshRepository::sLODPending--;
                 push_count--;
             }
@@ -4012,6 +4470,7 @@ void LLMeshRepository::notifyMeshLoaded(const LLVolumeParams& mesh_params, LLVol
 
     //get list of objects waiting to be notified this mesh is loaded
     const auto& mesh_id = mesh_params.getSculptID();
+    recordLODLatency(LLMeshRepoThread::lod_key_t(mesh_id, detail));
     mesh_load_map::iterator obj_iter = mLoadingMeshes[detail].find(mesh_id);
 
     if (volume && obj_iter != mLoadingMeshes[detail].end())
@@ -4056,6 +4515,8 @@ void LLMeshRepository::notifyMeshLoaded(const LLVolumeParams& mesh_params, LLVol
 
 void LLMeshRepository::notifyMeshUnavailable(const LLVolumeParams& mesh_params, S32 lod)
 { //called from main thread
+    recordLODLatency(LLMeshRepoThread::lod_key_t(mesh_params.getSculptID(), lod));
+
     //get list of objects waiting to be notified this mesh is loaded
     mesh_load_map::iterator obj_iter = mLoadingMeshes[lod].find(mesh_params.getSculptID());
 
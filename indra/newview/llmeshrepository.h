@@ -40,6 +40,11 @@
 #include "httpheaders.h"
 #include "httphandler.h"
 #include "llthread.h"
+#include "llatomic.h"
+#include "llfilesystem.h"
+#include "llindexedheap.h"
+#include "llmeshrequestscores.h"
+#include "threadpool.h"
 
 #include "boost/unordered/unordered_map.hpp"
 #include "boost/unordered/unordered_flat_map.hpp"
@@ -303,14 +308,20 @@ class LLMeshRepoThread final : public LLThread
         }
     };
 
-    struct CompareScoreGreater
+    struct CompareScoreLess
     {
-        bool operator()(const LODRequest& lhs, const LODRequest& rhs)
+        bool operator()(const LODRequest& lhs, const LODRequest& rhs) const
         {
-            return lhs.mScore > rhs.mScore; // greatest = first
+            return lhs.mScore < rhs.mScore; // greatest = top
         }
     };
 
+    // LOD requests keyed by mesh id and LOD, highest score first so they can
+    // be reprioritized or cancelled while queued. Requests for meshes out of
+    // view have a negative score, see LLMeshRequestScores.
+    typedef std::pair<LLUUID, S32> lod_key_t;
+    typedef LLIndexedHeap<lod_key_t, LODRequest, CompareScoreLess> lod_request_queue_t;
+
     class UUIDBasedRequest : public RequestStats
     {
     public:
@@ -341,6 +352,30 @@ class LLMeshRepoThread final : public LLThread
 
     };
 
+    // Mesh asset blocks decoded on mDecodePool
+    enum EMeshBlock
+    {
+        MESH_BLOCK_HEADER,
+        MESH_BLOCK_LOD,
+        MESH_BLOCK_SKIN,
+        MESH_BLOCK_DECOMPOSITION,
+        MESH_BLOCK_PHYSICS_SHAPE
+    };
+
+    // A block handed to mDecodePool, and back to the repo thread once decoded
+    struct DecodedBlock
+    {
+        EMeshBlock mType;
+        LLVolumeParams mMeshParams;     // only the sculpt id is set for non LOD blocks
+        S32 mLOD;
+        bool mFromCache;
+        S32 mOffset;                    // where the block lies in the asset
+        S32 mSize;                      // bytes requested
+        std::unique_ptr<U8[]> mData;    // kept until written to the cache for fetched blocks
+        S32 mDataSize;
+        EMeshProcessingResult mResult;
+    };
+
     struct MeshHeaderInfo
     {
         MeshHeaderInfo()
@@ -359,7 +394,7 @@ class LLMeshRepoThread final : public LLThread
     std::queue<HeaderRequest> mHeaderReqQ;
 
     //queue of requested LODs
-    std::queue<LODRequest> mLODReqQ;
+    lod_request_queue_t mLODReqQ;
 
     //set of requested skin info
     std::queue<UUIDBasedRequest> mSkinReqQ;
@@ -375,22 +410,31 @@ class LLMeshRepoThread final : public LLThread
     /////////
 
     //queue of successfully loaded meshes
-    std::deque<LoadedMesh> mLoadedQ;
+    LLAtomicStack<LoadedMesh> mLoadedQ;
 
     //queue of unavailable LODs (either asset doesn't exist or asset doesn't have desired LOD)
     std::deque<LODRequest> mUnavailableQ;
 
     // list of completed skin info requests
-    std::vector<LLMeshSkinInfo*> mSkinInfoQ;
+    LLAtomicStack<LLMeshSkinInfo*> mSkinInfoQ;
 
     // list of skin info requests that have failed or are unavailaibe
     std::deque<UUIDBasedRequest> mSkinUnavailableQ;
 
     // list of completed Decomposition info requests
-    std::deque<std::unique_ptr<LLModel::Decomposition>> mDecompositionQ;
+    LLAtomicStack<std::unique_ptr<LLModel::Decomposition>> mDecompositionQ;
 
     // list of completed Physics info requests shared with decomp..
-    std::deque<std::unique_ptr<LLModel::Decomposition>> mPhysicsQ;
+    LLAtomicStack<std::unique_ptr<LLModel::Decomposition>> mPhysicsQ;
+
+    // blocks decoded on mDecodePool, waiting for the repo thread
+    LLAtomicStack<std::shared_ptr<DecodedBlock>> mDecodedQ;
+
+    // cache reads posted to the "FileSystemRead" pool and not done yet
+    LLAtomicS32 mCacheReadsInFlight;
+
+    // cached blocks which failed to decode, fetched from the sim instead
+    std::set<std::pair<LLUUID, S32>> mBadCacheBlocks;
 
     // End
 
@@ -416,17 +460,35 @@ class LLMeshRepoThread final : public LLThread
     int mLegacyGetMeshVersion;
     std::string mGetMeshCapability;
 
-    LLMeshRepoThread();
+    // Re-encoding of cached blocks as zstd, done by the decode threads
+    bool mCacheZstd;
+    LLMutex mZstdMutex;                         // guards the samples
+    std::vector<std::vector<U8>> mZstdSamples;  // inflated blocks to train the dictionary on
+    size_t mZstdSampleBytes;
+
+    // Decodes header, LOD, skin, decomposition and physics blocks off the
+    // repo thread
+    std::unique_ptr<LL::ThreadPool> mDecodePool;
+
+    // decode_threads is the default width of mDecodePool, the "MeshDecode"
+    // entry of ThreadPoolSizes overrides it
+    LLMeshRepoThread(size_t decode_threads);
     ~LLMeshRepoThread();
 
     virtual void run();
 
     void lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
-    void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+    void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod, F32 score = 0.f);
+    void queueLODRequest(const LODRequest& req);
+    bool cancelMeshLOD(const LLUUID& mesh_id, S32 lod);
+    void updateLODScore(const lod_key_t& key, F32 score);
 
     bool fetchMeshHeader(const LLVolumeParams& mesh_params, bool can_retry = true);
     bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry = true);
     EMeshProcessingResult headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
+    // Reserves the space of the whole asset in the cache and writes the
+    // header fetched from the sim there. Repo thread only.
+    void cacheFetchedHeader(const LLVolumeParams& mesh_params, const U8* data, S32 data_size);
     EMeshProcessingResult lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
     EMeshProcessingResult skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
     EMeshProcessingResult decompositionReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
@@ -435,7 +497,31 @@ class LLMeshRepoThread final : public LLThread
     bool hasSkinInfoInHeader(const LLUUID& mesh_id);
     bool hasHeader(const LLUUID& mesh_id);
 
-    bool loadInfoFromFilesystem(const LLUUID& mesh_id, MeshHeaderInfo& info, boost::function<bool(const LLUUID&, U8*, S32)> fn);
+    // Reads a block from the cache and queues it for decoding. Returns false
+    // when the block is not in the cache.
+    bool loadInfoFromFilesystem(EMeshBlock type, const LLVolumeParams& mesh_params, S32 lod, const MeshHeaderInfo& info);
+
+    // Reads a cached block on the "FileSystemRead" pool, or right away
+    // without it, then queues it for decoding. A block which can't be read
+    // goes through processDecodedBlocks() as a bad cache block.
+    void readCachedBlock(EMeshBlock type, const LLVolumeParams& mesh_params, S32 lod, S32 offset, S32 size);
+    void cachedBlockRead(EMeshBlock type, const LLVolumeParams& mesh_params, S32 lod, S32 offset, S32 size,
+                         LLFileSystem::ReadResult& result);
+
+    // Hands a block to mDecodePool, or decodes it right away without one.
+    // offset and size are the block's position in the asset.
+    void queueDecode(EMeshBlock type, const LLVolumeParams& mesh_params, S32 lod, bool from_cache,
+                     std::unique_ptr<U8[]> data, S32 data_size, S32 offset, S32 size);
+    void decodeBlock(DecodedBlock& block);
+
+    // Caches the decoded blocks fetched from the sim, refetches the cached
+    // ones which failed to decode. Repo thread only.
+    void processDecodedBlocks();
+
+    // Replaces the data of a block received from the server with the same
+    // block re-encoded as zstd, if it fits. Decode threads only.
+    void encodeForCache(DecodedBlock& block);
+    void trainCacheDictionary(const std::vector<std::vector<U8>>& samples);
 
     void notifyLoadedMeshes(); // Only call from main thread.
     S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
@@ -664,7 +750,7 @@ class LLMeshRepository
 
     LLMeshRepository();
 
-    void init();
+    void init(size_t decode_threads);
     void shutdown();
     S32 update();
 
@@ -674,6 +760,9 @@ class LLMeshRepository
     S32 loadMesh(LLVOVolume* volume, const LLVolumeParams& mesh_params, S32 detail = 0, S32 last_lod = -1);
 
     void notifyLoadedMeshes();
+    void updateRequestScores();
+    void applyRequestScores();
+    void recordLODLatency(const LLMeshRepoThread::lod_key_t& key);
     void notifyMeshLoaded(const LLVolumeParams& mesh_params, LLVolume* volume);
     void notifyMeshUnavailable(const LLVolumeParams& mesh_params, S32 lod);
     void notifySkinInfoReceived(LLMeshSkinInfo* info);
@@ -721,7 +810,13 @@ class LLMeshRepository
 
     LLMutex*                    mMeshMutex;
 
-    std::vector<LLMeshRepoThread::LODRequest> mPendingRequests;
+    LLMeshRepoThread::lod_request_queue_t mPendingRequests;
+
+    // Scores of the LOD requests of the meshes being loaded
+    LLMeshRequestScores mMeshScores;
+
+    // When each LOD request was made, for the latency stat
+    boost::unordered_flat_map<LLMeshRepoThread::lod_key_t, F64> mRequestTimes;
 
     //list of mesh ids awaiting skin info
     typedef boost::unordered_node_map<LLUUID, boost::unordered_flat_set<LLVOVolume*> > skin_load_map;
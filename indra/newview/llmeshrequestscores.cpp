@@ -0,0 +1,69 @@
+/**
+ * @file llmeshrequestscores.cpp
+ * @brief Scores of the mesh LOD requests, by how large their objects in view are
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llmeshrequestscores.h"
+
+F32 LLMeshRequestScores::add(const LLUUID& mesh_id, F64 now)
+{
+    MeshScore& mesh = mMeshes[mesh_id];
+    mesh.mSeen = now;
+    return mesh.mScore;
+}
+
+void LLMeshRequestScores::seen(const LLUUID& mesh_id, F32 score, U32 frame, F64 now)
+{
+    auto it = mMeshes.find(mesh_id);
+    if (it == mMeshes.end())
+    {
+        return;
+    }
+
+    MeshScore& mesh = it->second;
+    if (mesh.mFrame != frame)
+    {
+        mesh.mFrame = frame;
+        mesh.mScore = score;
+        mesh.mSeen = now;
+    }
+    else
+    {
+        mesh.mScore = llmax(mesh.mScore, score);
+    }
+}
+
+F32 LLMeshRequestScores::getScore(const LLUUID& mesh_id) const
+{
+    auto it = mMeshes.find(mesh_id);
+    return it == mMeshes.end() ? 0.f : it->second.mRequestScore;
+}
+
+bool LLMeshRequestScores::isHeld(const LLUUID& mesh_id) const
+{
+    auto it = mMeshes.find(mesh_id);
+    return it != mMeshes.end() && it->second.mHeld;
+}
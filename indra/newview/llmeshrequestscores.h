@@ -0,0 +1,122 @@
+/**
+ * @file llmeshrequestscores.h
+ * @brief Scores of the mesh LOD requests, by how large their objects in view are
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESHREQUESTSCORES_H
+#define LL_LLMESHREQUESTSCORES_H
+
+#include "lluuid.h"
+
+#include "boost/unordered/unordered_flat_map.hpp"
+
+// Score of the LOD requests of each mesh being loaded: the best angular size
+// of the objects waiting on it which are in view. Meshes none of them has
+// been seen for a while are held, their requests go after all the others but
+// are still sent. Changed scores are recorded until the request queues take
+// them. Main thread only.
+class LLMeshRequestScores
+{
+public:
+    // Score of the requests of a held mesh, below any mesh in view
+    static constexpr F32 HELD_SCORE = -1.f;
+
+    // A mesh starts being loaded. The request counts as a sighting, so it
+    // isn't held before its objects had a chance to be seen.
+    // Returns the score its requests start with.
+    F32 add(const LLUUID& mesh_id, F64 now);
+
+    // An object waiting on the mesh is in view this frame, the best score
+    // of the frame is kept
+    void seen(const LLUUID& mesh_id, F32 score, U32 frame, F64 now);
+
+    // Forgets the meshes for which is_loading(mesh_id) is false, holds the
+    // ones not seen for hold_time seconds (never when hold_time <= 0) and
+    // records the new request score of those which changed.
+    // Returns the number of held meshes.
+    template <typename Fn>
+    U32 update(F64 now, F32 hold_time, Fn is_loading);
+
+    // Calls fn(mesh_id, score) for each recorded score change and forgets them
+    template <typename Fn>
+    void takeUpdates(Fn fn);
+
+    // Score of the requests of a mesh, 0 when it isn't being loaded
+    F32 getScore(const LLUUID& mesh_id) const;
+    bool isHeld(const LLUUID& mesh_id) const;
+    size_t size() const { return mMeshes.size(); }
+
+private:
+    struct MeshScore
+    {
+        F32 mScore = 0.f;           // best score of the last frame it was seen
+        F32 mRequestScore = 0.f;    // score of its requests
+        F64 mSeen = 0.0;            // last time an object waiting on it was in view
+        U32 mFrame = 0;             // frame of the last sighting
+        bool mHeld = false;
+    };
+    boost::unordered_flat_map<LLUUID, MeshScore> mMeshes;
+    boost::unordered_flat_map<LLUUID, F32> mUpdates;
+};
+
+template <typename Fn>
+U32 LLMeshRequestScores::update(F64 now, F32 hold_time, Fn is_loading)
+{
+    U32 held = 0;
+    for (auto it = mMeshes.begin(); it != mMeshes.end(); )
+    {
+        if (!is_loading(it->first))
+        {
+            mUpdates.erase(it->first);
+            it = mMeshes.erase(it);
+            continue;
+        }
+
+        MeshScore& mesh = it->second;
+        mesh.mHeld = hold_time > 0.f && now - mesh.mSeen > hold_time;
+        held += mesh.mHeld;
+
+        // keeps the score of the last sighting until held
+        const F32 score = mesh.mHeld ? HELD_SCORE : mesh.mScore;
+        if (score != mesh.mRequestScore)
+        {
+            mesh.mRequestScore = score;
+            mUpdates[it->first] = score;
+        }
+        ++it;
+    }
+    return held;
+}
+
+template <typename Fn>
+void LLMeshRequestScores::takeUpdates(Fn fn)
+{
+    for (const auto& update : mUpdates)
+    {
+        fn(update.first, update.second);
+    }
+    mUpdates.clear();
+}
+
+#endif // LL_LLMESHREQUESTSCORES_H
@@ -68,6 +68,8 @@ class LLPanelSnapshotLocal
 
     void onLocalSaved();
     void onLocalCanceled();
+    // The save ends on a later frame, the panel may be gone by then
+    static void onLocalSaveDone(LLHandle<LLPanelSnapshotLocal> handle, bool saved);
 };
 
 static LLPanelInjector<LLPanelSnapshotLocal> panel_class("llpanelsnapshotlocal");
@@ -171,7 +173,27 @@ void LLPanelSnapshotLocal::onSaveFlyoutCommit(LLUICtrl* ctrl)
     LLFloaterSnapshot* floater = LLFloaterSnapshot::getInstance();
 
     floater->notify(LLSD().with("set-working", true));
-    floater->saveLocal((boost::bind(&LLPanelSnapshotLocal::onLocalSaved, this)), (boost::bind(&LLPanelSnapshotLocal::onLocalCanceled, this)));
+    floater->saveLocal(boost::bind(&LLPanelSnapshotLocal::onLocalSaveDone, getDerivedHandle<LLPanelSnapshotLocal>(), true),
+                       boost::bind(&LLPanelSnapshotLocal::onLocalSaveDone, getDerivedHandle<LLPanelSnapshotLocal>(), false));
+}
+
+// static
+void LLPanelSnapshotLocal::onLocalSaveDone(LLHandle<LLPanelSnapshotLocal> handle, bool saved)
+{
+    LLPanelSnapshotLocal* panel = handle.get();
+    if (!panel)
+    {
+        return;
+    }
+
+    if (saved)
+    {
+        panel->onLocalSaved();
+    }
+    else
+    {
+        panel->onLocalCanceled();
+    }
 }
 
 void LLPanelSnapshotLocal::onLocalSaved()
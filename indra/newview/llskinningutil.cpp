@@ -34,6 +34,8 @@
 #include "llvolume.h"
 #include "llrigginginfo.h"
 
+#include "boost/unordered/unordered_flat_map.hpp"
+
 #define DEBUG_SKINNING  LL_DEBUG
 
 void dump_avatar_and_skin_state(const std::string& reason, LLVOAvatar *avatar, const LLMeshSkinInfo *skin)
@@ -106,7 +108,7 @@ void LLSkinningUtil::scrubInvalidJoints(LLVOAvatar *avatar, LLMeshSkinInfo* skin
         if (!avatar->getJoint(skin->mJointNames[j]))
         {
             LL_WARNS_ONCE("Avatar") << avatar->getFullname() << " mesh rigged to invalid joint" << skin->mJointNames[j] << LL_ENDL;
-            skin->mJointNames[j] = "mPelvis";
+            skin->mJointNames.set(j, "mPelvis");
             skin->mJointNumsInitialized = false; // force update after names change.
         }
     }
@@ -233,24 +235,86 @@ void LLSkinningUtil::getPerVertexSkinMatrix(
 #endif
 }
 
+namespace
+{
+    // Joint numbers of the interned joint lists, keyed by their storage.
+    // They come from the skeleton definition every avatar shares, so skins
+    // rigged to the same joints map to the same numbers whoever wears them.
+    class JointNumsCache
+    {
+    public:
+        typedef LLMeshSkinInfo::joint_name_list_t names_t;
+        typedef LLInternedVector<S32> nums_t;
+
+        const nums_t* find(const names_t& names) const
+        {
+            auto it = mEntries.find(names.storageId());
+            return it == mEntries.end() ? nullptr : &it->second.second;
+        }
+
+        void insert(const names_t& names, const nums_t& nums)
+        {
+            if (mEntries.size() >= mPruneSize)
+            {
+                // forget the lists no skin uses anymore
+                for (auto it = mEntries.begin(); it != mEntries.end(); )
+                {
+                    if (it->second.first.useCount() == 1)
+                    {
+                        it = mEntries.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+                mPruneSize = llmax(MIN_PRUNE_SIZE, mEntries.size() * 2);
+            }
+            // holding on to the names keeps their storage, the key, unique
+            mEntries.emplace(names.storageId(), std::make_pair(names, nums));
+        }
+
+    private:
+        static constexpr size_t MIN_PRUNE_SIZE = 64;
+        boost::unordered_flat_map<const void*, std::pair<names_t, nums_t>> mEntries;
+        size_t mPruneSize = MIN_PRUNE_SIZE;
+    };
+}
+
 void LLSkinningUtil::initJointNums(LLMeshSkinInfo* skin, LLVOAvatar *avatar)
 {
     if (!skin->mJointNumsInitialized)
     {
         LL_PROFILE_ZONE_SCOPED_CATEGORY_AVATAR;
+
+        static JointNumsCache sJointNumsCache; // main thread only
+        const bool cacheable = skin->mJointNames.interned();
+        if (cacheable)
+        {
+            if (const JointNumsCache::nums_t* nums = sJointNumsCache.find(skin->mJointNames))
+            {
+                skin->mJointNums = *nums;
+                skin->mJointNumsInitialized = true;
+                return;
+            }
+        }
+
+        std::vector<S32> joint_nums = skin->mJointNums;
+        joint_nums.resize(skin->mJointNames.size(), -1);
+        bool all_found = true;
         for (U32 j = 0; j < skin->mJointNames.size(); ++j)
         {
     #if DEBUG_SKINNING
             LLJoint *joint = NULL;
-            if (skin->mJointNums[j] == -1)
+            if (joint_nums[j] == -1)
             {
                 joint = avatar->getJoint(skin->mJointNames[j]);
                 if (joint)
                 {
-                    skin->mJointNums[j] = joint->getJointNum();
-                    if (skin->mJointNums[j] < 0)
+                    joint_nums[j] = joint->getJointNum();
+                    if (joint_nums[j] < 0)
                     {
-                        LL_WARNS_ONCE("Avatar") << avatar->getFullname() << " joint has unusual number " << skin->mJointNames[j] << ": " << skin->mJointNums[j] << LL_ENDL;
+                        LL_WARNS_ONCE("Avatar") << avatar->getFullname() << " joint has unusual number " << skin->mJointNames[j] << ": " << joint_nums[j] << LL_ENDL;
                         LL_WARNS_ONCE("Avatar") << avatar->getFullname() << " avatar build state: isBuilt() " << avatar->isBuilt() << " mInitFlags " << avatar->mInitFlags << LL_ENDL;
                     }
                 }
@@ -259,17 +323,27 @@ void LLSkinningUtil::initJointNums(LLMeshSkinInfo* skin, LLVOAvatar *avatar)
                     LL_WARNS_ONCE("Avatar") << avatar->getFullname() << " unable to find joint " << skin->mJointNames[j] << LL_ENDL;
                     LL_WARNS_ONCE("Avatar") << avatar->getFullname() << " avatar build state: isBuilt() " << avatar->isBuilt() << " mInitFlags " << avatar->mInitFlags << LL_ENDL;
                     dump_avatar_and_skin_state("initJointNums joint not found", avatar, skin);
-                    skin->mJointNums[j] = 0;
+                    joint_nums[j] = 0;
+                    all_found = false;
                 }
             }
     #else
-            LLJoint *joint = (skin->mJointNums[j] == -1) ? avatar->getJoint(skin->mJointNames[j]) : avatar->getJoint(skin->mJointNums[j]);
-            skin->mJointNums[j] = joint ? joint->getJointNum() : 0;
+            LLJoint *joint = (joint_nums[j] == -1) ? avatar->getJoint(skin->mJointNames[j]) : avatar->getJoint(joint_nums[j]);
+            joint_nums[j] = joint ? joint->getJointNum() : 0;
+            all_found = all_found && joint;
     #endif
             // insure we have *a* valid joint to reference
-            llassert(skin->mJointNums[j] >= 0);
+            llassert(joint_nums[j] >= 0);
         }
+        skin->mJointNums = LLInternedVector<S32>(std::move(joint_nums));
         skin->mJointNumsInitialized = true;
+
+        // a skeleton still being built would map missing joints to 0 for
+        // every skin rigged to them
+        if (cacheable && all_found)
+        {
+            sJointNumsCache.insert(skin->mJointNames, skin->mJointNums);
+        }
     }
 }
 
@@ -945,39 +945,11 @@ LLPointer<LLImageFormatted> LLSnapshotLivePreview::getFormattedImage()
     if (!mFormattedImage)
     {
         // Apply the filter to mPreviewImage
-        if (getFilter() != "")
-        {
-            std::string filter_path = LLImageFiltersManager::getInstance()->getFilterPath(getFilter());
-            if (filter_path != "")
-            {
-                LLImageFilter filter(filter_path);
-                filter.executeFilter(mPreviewImage);
-            }
-            else
-            {
-                LL_WARNS("Snapshot") << "Couldn't find a path to the following filter : " << getFilter() << LL_ENDL;
-            }
-        }
+        applyFilter(mPreviewImage);
 
         // Create the new formatted image of the appropriate format.
-        LLSnapshotModel::ESnapshotFormat format = getSnapshotFormat();
-        LL_DEBUGS("Snapshot") << "Encoding new image of format " << format << LL_ENDL;
-
-        switch (format)
-        {
-            case LLSnapshotModel::SNAPSHOT_FORMAT_PNG:
-                mFormattedImage = new LLImagePNG();
-                break;
-            case LLSnapshotModel::SNAPSHOT_FORMAT_JPEG:
-                mFormattedImage = new LLImageJPEG(mSnapshotQuality);
-                break;
-            case LLSnapshotModel::SNAPSHOT_FORMAT_BMP:
-                mFormattedImage = new LLImageBMP();
-                break;
-            case LLSnapshotModel::SNAPSHOT_FORMAT_WEBP:
-                mFormattedImage = new LLImageWebP();
-                break;
-        }
+        LL_DEBUGS("Snapshot") << "Encoding new image of format " << getSnapshotFormat() << LL_ENDL;
+        mFormattedImage = newFormattedImage();
         if (mFormattedImage->encode(mPreviewImage, 0))
         {
             // We can update the data size precisely at that point
@@ -987,6 +959,44 @@ LLPointer<LLImageFormatted> LLSnapshotLivePreview::getFormattedImage()
     return mFormattedImage;
 }
 
+void LLSnapshotLivePreview::applyFilter(LLPointer<LLImageRaw> image) const
+{
+    if (getFilter() != "")
+    {
+        std::string filter_path = LLImageFiltersManager::getInstance()->getFilterPath(getFilter());
+        if (filter_path != "")
+        {
+            LLImageFilter filter(filter_path);
+            filter.executeFilter(image);
+        }
+        else
+        {
+            LL_WARNS("Snapshot") << "Couldn't find a path to the following filter : " << getFilter() << LL_ENDL;
+        }
+    }
+}
+
+LLPointer<LLImageFormatted> LLSnapshotLivePreview::newFormattedImage() const
+{
+    LLPointer<LLImageFormatted> image;
+    switch (getSnapshotFormat())
+    {
+        case LLSnapshotModel::SNAPSHOT_FORMAT_PNG:
+            image = newSnapshotPNG();
+            break;
+        case LLSnapshotModel::SNAPSHOT_FORMAT_JPEG:
+            image = new LLImageJPEG(mSnapshotQuality);
+            break;
+        case LLSnapshotModel::SNAPSHOT_FORMAT_BMP:
+            image = new LLImageBMP();
+            break;
+        case LLSnapshotModel::SNAPSHOT_FORMAT_WEBP:
+            image = new LLImageWebP();
+            break;
+    }
+    return image;
+}
+
 void LLSnapshotLivePreview::setSize(S32 w, S32 h)
 {
     LL_DEBUGS("Snapshot") << "setSize(" << w << ", " << h << ")" << LL_ENDL;
@@ -1078,17 +1088,39 @@ void LLSnapshotLivePreview::saveTexture(BOOL outfit_snapshot, std::string name)
 
 void LLSnapshotLivePreview::saveLocal(const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb)
 {
-    // Update mFormattedImage if necessary
-    getFormattedImage();
+    if (mFormattedImage || !mPreviewImage)
+    {
+        // Update mFormattedImage if necessary
+        getFormattedImage();
 
-    // Save the formatted image
-    saveLocal(mFormattedImage, success_cb, failure_cb);
+        // Save the formatted image
+        saveLocal(mFormattedImage, success_cb, failure_cb);
+        return;
+    }
+
+    // Not encoded yet: the save worker encodes a filtered copy of the
+    // preview, which may change in the meantime
+    LLPointer<LLImageRaw> raw = new LLImageRaw(mPreviewImage->getData(), mPreviewImage->getWidth(),
+                                               mPreviewImage->getHeight(), mPreviewImage->getComponents());
+    applyFilter(raw);
+    saveLocal(newFormattedImage(), success_cb, failure_cb, raw);
 }
 
 //Check if failed due to insufficient memory
-void LLSnapshotLivePreview::saveLocal(LLPointer<LLImageFormatted> image, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb)
+void LLSnapshotLivePreview::saveLocal(LLPointer<LLImageFormatted> image, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb, LLImageRaw* raw)
 {
     sSaveLocalImage = image;
 
-    gViewerWindow->saveImageNumbered(sSaveLocalImage, FALSE, success_cb, failure_cb);
+    gViewerWindow->saveImageNumbered(sSaveLocalImage, FALSE, success_cb, failure_cb, raw);
+}
+
+//static
+LLImagePNG* LLSnapshotLivePreview::newSnapshotPNG()
+{
+    static LLCachedControl<S32> compression_level(gSavedSettings, "SnapshotPNGCompressionLevel", 6);
+    LLImagePNG* png = new LLImagePNG();
+    png->setCompressionLevel(llclamp((S32)compression_level, 0, 9));
+    // Large snapshots are compressed in strips on the snapshot workers
+    png->setEncodeHelpers("Snapshot");
+    return png;
 }
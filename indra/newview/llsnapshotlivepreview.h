@@ -32,6 +32,7 @@
 #include "llviewerwindow.h"
 
 class LLImageJPEG;
+class LLImagePNG;
 
 ///----------------------------------------------------------------------------
 /// Class LLSnapshotLivePreview
@@ -42,7 +43,11 @@ class LLSnapshotLivePreview : public LLView
 public:
     typedef boost::signals2::signal<void(void)> snapshot_saved_signal_t;
 
-    static void saveLocal(LLPointer<LLImageFormatted> image, const snapshot_saved_signal_t::slot_type& success_cb = snapshot_saved_signal_t(), const snapshot_saved_signal_t::slot_type& failure_cb = snapshot_saved_signal_t());
+    // When raw is given, image gets encoded from it along with the saving
+    static void saveLocal(LLPointer<LLImageFormatted> image, const snapshot_saved_signal_t::slot_type& success_cb = snapshot_saved_signal_t(), const snapshot_saved_signal_t::slot_type& failure_cb = snapshot_saved_signal_t(), LLImageRaw* raw = NULL);
+    // PNG encoder set up for snapshots
+    static LLImagePNG* newSnapshotPNG();
+
     struct Params : public LLInitParam::Block<Params, LLView::Params>
     {
         Params()
@@ -106,6 +111,9 @@ class LLSnapshotLivePreview : public LLView
 
     LLPointer<LLImageFormatted> getFormattedImage();
     LLPointer<LLImageRaw>       getEncodedImage();
+    // Empty image of the snapshot format, to encode into
+    LLPointer<LLImageFormatted> newFormattedImage() const;
+    void applyFilter(LLPointer<LLImageRaw> image) const;
     bool createUploadFile(const std::string &out_file, const S32 max_image_dimentions, const S32 min_image_dimentions);
 
     /// Sets size of preview thumbnail image and the surrounding rect.
@@ -0,0 +1,219 @@
+/**
+ * @file lltexturebudget.cpp
+ * @brief Memory budget for fetched textures.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturebudget.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace
+{
+    const F32 UPDATE_INTERVAL = 1.f;
+    // Evict down to this fraction of the budget, so as not to evict again
+    // as soon as a few textures load
+    const F64 EVICT_TARGET = 0.9;
+    // Restore textures while under this fraction of the budget
+    const F64 RESTORE_THRESHOLD = 0.75;
+    // An evicted texture that did not get smaller within this many seconds
+    // released nothing
+    const F64 RELEASE_TIMEOUT = 10.0;
+    // Each extra discard level divides the size of a texture by 4, until
+    // the releases measured say otherwise
+    const F64 INITIAL_RELEASE_RATIO = 0.75;
+    // Weight of the latest release in the running ratio
+    const F64 RELEASE_RATIO_WEIGHT = 0.1;
+}
+
+LLTrace::SampleStatHandle<F64Megabytes> LLTextureBudget::sBudget("texture_budget", "Memory budget of fetched textures");
+LLTrace::SampleStatHandle<F64Megabytes> LLTextureBudget::sUsage("texture_budget_usage", "Memory used by fetched textures");
+LLTrace::CountStatHandle<> LLTextureBudget::sEvictions("texture_budget_evictions", "Textures given a lower resolution to stay within budget");
+
+LLTextureBudget::LLTextureBudget()
+    : mUsage(0),
+      mBudget(0),
+      mReleasedBytes(0),
+      mReleaseRatio(INITIAL_RELEASE_RATIO),
+      mEvictedCount(0),
+      mCanEvict(true)
+{
+}
+
+void LLTextureBudget::updateTexture(LLBudgetedTexture* tex, S64 bytes, bool visible, bool evictable, F64 now)
+{
+    Entry& entry = mEntries[tex];
+    mUsage += bytes - entry.mBytes;
+    entry.mBytes = bytes;
+    entry.mEvictable = evictable;
+    if (visible || entry.mLastVisible == 0.0)
+    {
+        entry.mLastVisible = now;
+    }
+    if (entry.mEvictedBytes > 0 && bytes < entry.mEvictedBytes)
+    {
+        recordRelease(entry, entry.mEvictedBytes - bytes);
+    }
+    // Visible textures get their resolution back as soon as the budget
+    // allows it rather than waiting for the next restore pass. While over
+    // budget the eviction order already spares them the longest.
+    if (tex->getBudgetDiscardBias() > 0 && (!evictable || (visible && !isEvicting())))
+    {
+        tex->setBudgetDiscardBias(0);
+        entry.mEvictedBytes = 0;
+    }
+}
+
+void LLTextureBudget::removeTexture(LLBudgetedTexture* tex)
+{
+    auto it = mEntries.find(tex);
+    if (it != mEntries.end())
+    {
+        mUsage -= it->second.mBytes;
+        mEntries.erase(it);
+    }
+}
+
+void LLTextureBudget::recordRelease(Entry& entry, S64 released)
+{
+    F64 ratio = llclamp((F64)released / (F64)entry.mEvictedBytes, 0.0, 1.0);
+    mReleaseRatio += (ratio - mReleaseRatio) * RELEASE_RATIO_WEIGHT;
+    mReleasedBytes += released;
+    entry.mEvictedBytes = 0;
+}
+
+void LLTextureBudget::update()
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+    sample(sBudget, F64Bytes((F64)mBudget));
+    sample(sUsage, F64Bytes((F64)mUsage));
+
+    if (mUpdateTimer.getElapsedTimeF32() < UPDATE_INTERVAL)
+    {
+        return;
+    }
+    mUpdateTimer.reset();
+    rebalance(LLFrameTimer::getElapsedSeconds());
+}
+
+void LLTextureBudget::rebalance(F64 now)
+{
+    if (mBudget <= 0)
+    {
+        mCanEvict = true;
+        return;
+    }
+
+    const bool evict = mUsage > mBudget;
+    const bool restore = mUsage < (S64)(mBudget * RESTORE_THRESHOLD);
+
+    // Evictions not released yet are expected to release as much as the
+    // earlier ones did, those that never do stop being waited for
+    S64 pending = 0;
+    typedef std::pair<F64, LLBudgetedTexture*> candidate_t;
+    std::vector<candidate_t> candidates;
+    candidates.reserve(mEntries.size());
+    for (auto& entry : mEntries)
+    {
+        Entry& info = entry.second;
+        if (info.mEvictedBytes > 0)
+        {
+            if (now - info.mEvictedTime > RELEASE_TIMEOUT)
+            {
+                recordRelease(info, 0);
+            }
+            else
+            {
+                pending += (S64)(info.mEvictedBytes * mReleaseRatio);
+                if (evict)
+                {
+                    // not lowered again before the last eviction shows
+                    continue;
+                }
+            }
+        }
+        if (!info.mEvictable || (!evict && !restore))
+        {
+            continue;
+        }
+        S8 bias = entry.first->getBudgetDiscardBias();
+        if (evict ? bias < MAX_DISCARD_BIAS : bias > 0)
+        {
+            candidates.emplace_back(info.mLastVisible, entry.first);
+        }
+    }
+
+    if (evict)
+    {
+        // Least recently visible first
+        std::sort(candidates.begin(), candidates.end());
+        S64 excess = mUsage - (S64)(mBudget * EVICT_TARGET) - pending;
+        for (const candidate_t& candidate : candidates)
+        {
+            if (excess <= 0)
+            {
+                break;
+            }
+            LLBudgetedTexture* tex = candidate.second;
+            Entry& entry = mEntries[tex];
+            tex->setBudgetDiscardBias(tex->getBudgetDiscardBias() + 1);
+            entry.mEvictedBytes = entry.mBytes;
+            entry.mEvictedTime = now;
+            excess -= (S64)(entry.mBytes * mReleaseRatio);
+            ++mEvictedCount;
+            add(sEvictions, 1);
+        }
+        // with nothing left to lower and nothing on its way, only the
+        // global discard bias can help
+        mCanEvict = excess <= 0 || pending > 0;
+    }
+    else if (restore)
+    {
+        // Most recently visible first, each restored level may take up to
+        // 4 times the memory
+        std::sort(candidates.begin(), candidates.end(), std::greater<candidate_t>());
+        S64 room = (S64)(mBudget * RESTORE_THRESHOLD) - mUsage;
+        for (const candidate_t& candidate : candidates)
+        {
+            LLBudgetedTexture* tex = candidate.second;
+            Entry& entry = mEntries[tex];
+            S64 growth = llmax(entry.mBytes * 3, (S64)1);
+            if (growth > room)
+            {
+                break;
+            }
+            tex->setBudgetDiscardBias(tex->getBudgetDiscardBias() - 1);
+            entry.mEvictedBytes = 0;
+            room -= growth;
+        }
+        mCanEvict = true;
+    }
+    else
+    {
+        mCanEvict = true;
+    }
+}
@@ -0,0 +1,122 @@
+/**
+ * @file lltexturebudget.h
+ * @brief Memory budget for fetched textures.
+ *
+ * @Description:
+ * Keeps the GL memory of fetched textures under a budget. Rather than
+ * lowering the resolution of every texture through
+ * LLViewerTexture::sDesiredDiscardBias, textures that have gone the longest
+ * without being visible get an extra discard bias of their own. The bias is
+ * lifted again, most recently visible textures first, once there is room.
+ * What an eviction frees is measured from the bytes the texture reports
+ * afterwards rather than assumed.
+ *
+ * Main thread only.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREBUDGET_H
+#define LL_LLTEXTUREBUDGET_H
+
+#include "llframetimer.h"
+#include "llsingleton.h"
+#include "lltrace.h"
+
+#include <boost/unordered/unordered_flat_map.hpp>
+
+// The part of a texture the budget works with: the discard levels it adds
+// to the texture's own
+class LLBudgetedTexture
+{
+public:
+    S8 getBudgetDiscardBias() const { return mBudgetDiscardBias; }
+    void setBudgetDiscardBias(S8 bias) { mBudgetDiscardBias = bias; }
+
+protected:
+    S8 mBudgetDiscardBias = 0;
+};
+
+class LLTextureBudget : public LLSingleton<LLTextureBudget>
+{
+    LLSINGLETON(LLTextureBudget);
+
+public:
+    // Extra discard levels a texture can be given
+    static const S8 MAX_DISCARD_BIAS = 3;
+
+    /**
+     * Record the GL bytes held by tex and whether it is visible at now (in
+     * LLFrameTimer::getElapsedSeconds() time). Textures the budget may not
+     * lower (boosted, not mipmapped...) are counted against the budget but
+     * never evicted. A visible texture loses its extra discard levels unless
+     * the budget is evicting.
+     */
+    void updateTexture(LLBudgetedTexture* tex, S64 bytes, bool visible, bool evictable, F64 now);
+    // Call when tex is destroyed
+    void removeTexture(LLBudgetedTexture* tex);
+
+    // Once per frame: samples the stats and rebalances once per second
+    void update();
+    // Evict or restore textures as needed at now
+    void rebalance(F64 now);
+
+    // Budget in bytes, 0 for none
+    void setBudget(S64 bytes) { mBudget = bytes; }
+    S64 getBudget() const { return mBudget; }
+    S64 getUsage() const { return mUsage; }
+    U32 getEvictedCount() const { return mEvictedCount; }
+    // Bytes evicted textures were measured to give back
+    S64 getReleasedBytes() const { return mReleasedBytes; }
+    // Over budget and lowering textures to get back under it
+    bool isEvicting() const { return mCanEvict && mUsage > mBudget && mBudget > 0; }
+
+    static LLTrace::SampleStatHandle<F64Megabytes> sBudget;
+    static LLTrace::SampleStatHandle<F64Megabytes> sUsage;
+    static LLTrace::CountStatHandle<> sEvictions;
+
+private:
+    struct Entry
+    {
+        S64 mBytes = 0;
+        // bytes when last evicted, until the texture reports fewer
+        S64 mEvictedBytes = 0;
+        F64 mEvictedTime = 0.0;
+        F64 mLastVisible = 0.0;
+        bool mEvictable = false;
+    };
+
+    // Account for what entry released since its eviction
+    void recordRelease(Entry& entry, S64 released);
+
+    boost::unordered_flat_map<LLBudgetedTexture*, Entry> mEntries;
+    S64 mUsage;
+    S64 mBudget;
+    S64 mReleasedBytes;
+    // Running fraction of its bytes an evicted texture gives back
+    F64 mReleaseRatio;
+    U32 mEvictedCount;
+    bool mCanEvict;
+    LLFrameTimer mUpdateTimer;
+};
+
+#endif // LL_LLTEXTUREBUDGET_H
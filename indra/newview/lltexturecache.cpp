@@ -61,39 +61,6 @@ class LLTextureCacheWorker : public LLWorkerClass
 {
     friend class LLTextureCache;
 
-private:
-    class ReadResponder : public LLLFSThread::Responder
-    {
-    public:
-        ReadResponder(LLTextureCache* cache, handle_t handle) : mCache(cache), mHandle(handle) {}
-        ~ReadResponder() {}
-        void completed(S32 bytes)
-        {
-            mCache->lockWorkers();
-            LLTextureCacheWorker* reader = mCache->getReader(mHandle);
-            if (reader) reader->ioComplete(bytes);
-            mCache->unlockWorkers();
-        }
-        LLTextureCache* mCache;
-        LLTextureCacheWorker::handle_t mHandle;
-    };
-
-    class WriteResponder : public LLLFSThread::Responder
-    {
-    public:
-        WriteResponder(LLTextureCache* cache, handle_t handle) : mCache(cache), mHandle(handle) {}
-        ~WriteResponder() {}
-        void completed(S32 bytes)
-        {
-            mCache->lockWorkers();
-            LLTextureCacheWorker* writer = mCache->getWriter(mHandle);
-            if (writer) writer->ioComplete(bytes);
-            mCache->unlockWorkers();
-        }
-        LLTextureCache* mCache;
-        LLTextureCacheWorker::handle_t mHandle;
-    };
-
 public:
     LLTextureCacheWorker(LLTextureCache* cache, const LLUUID& id,
                          U8* data, S32 datasize, S32 offset,
@@ -109,10 +76,7 @@ class LLTextureCacheWorker : public LLWorkerClass
           mImageSize(imagesize),
           mImageFormat(IMG_CODEC_J2C),
           mImageLocal(FALSE),
-          mResponder(responder),
-          mFileHandle(LLLFSThread::nullHandle()),
-          mBytesToRead(0),
-          mBytesRead(0)
+          mResponder(responder)
     {
     }
     ~LLTextureCacheWorker()
@@ -130,9 +94,12 @@ class LLTextureCacheWorker : public LLWorkerClass
     handle_t read() { addWork(0); return mRequestHandle; }
     handle_t write() { addWork(1); return mRequestHandle; }
     bool complete() { return checkWork(); }
-    void ioComplete(S32 bytes)
+
+    // True once the cache thread is done with the request, or will never
+    // get to it. Only an atomic flag read, so it can be polled freely.
+    bool isFinished()
     {
-        mBytesRead = bytes;
+        return getFlags(WCF_WORK_FINISHED) || mCache->isQuitting() || mCache->isStopped();
     }
 
 private:
@@ -152,9 +119,6 @@ class LLTextureCacheWorker : public LLWorkerClass
     EImageCodec mImageFormat;
     BOOL mImageLocal;
     LLPointer<LLTextureCache::Responder> mResponder;
-    LLLFSThread::handle_t mFileHandle;
-    S32 mBytesToRead;
-    LLAtomicS32 mBytesRead;
 };
 
 class LLTextureCacheLocalFileWorker : public LLTextureCacheWorker
@@ -794,19 +758,19 @@ void LLTextureCacheWorker::endWork(S32 param, bool aborted)
 
 LLTextureCache::LLTextureCache(bool threaded)
     : LLWorkerThread("TextureCache", threaded),
-      mWorkersMutex(),
+      mNumReads(0),
+      mNumWrites(0),
       mHeaderMutex(),
-      mListMutex(),
       mFastCacheMutex(),
-      mHeaderAPRFile(NULL),
-      mPrioritizeWriteListEmpty(true),
-      mCompletedListEmpty(true),
+      mHeaderEntriesData(NULL),
+      mHeaderEntriesCapacity(0),
       mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
       mTexturesSizeTotal(0),
       mDoPurge(FALSE),
       mFastCachep(NULL),
       mFastCachePoolp(NULL),
-      mFastCachePadBuffer(NULL)
+      mFastCachePadBuffer(NULL),
+      mDecodedCache(std::make_shared<LLDecodedTextureCache>())
 {
     mHeaderAPRFilePoolp = new LLVolatileAPRPool("Texture Cache Pool"); // is_local = true, because this pool is for headers, headers are under own mutex
 }
@@ -814,7 +778,10 @@ LLTextureCache::LLTextureCache(bool threaded)
 LLTextureCache::~LLTextureCache()
 {
     clearDeleteList() ;
-    writeUpdatedEntries() ;
+    {
+        LLMutexLock lock(&mHeaderMutex);
+        closeHeaderEntriesFile();
+    }
     delete mFastCachep;
     delete mFastCachePoolp;
     delete mHeaderAPRFilePoolp;
@@ -835,15 +802,13 @@ size_t LLTextureCache::update(F32 max_time_ms)
 
     handle_list_t priorty_list;
     responder_list_t completed_list;
-    if ((!mPrioritizeWriteListEmpty) || (!mCompletedListEmpty))
+    if (!mPrioritizeWriteList.empty())
     {
-        LLMutexLock lock(&mListMutex);
-        priorty_list.swap(mPrioritizeWriteList); // copy list
-        mPrioritizeWriteList.clear();
-        mPrioritizeWriteListEmpty = mPrioritizeWriteList.empty();
-        completed_list.swap(mCompletedList); // copy list
-        mCompletedList.clear();
-        mCompletedListEmpty = mCompletedList.empty();
+        mPrioritizeWriteList.takeAll(priorty_list);
+    }
+    if (!mCompletedList.empty())
+    {
+        mCompletedList.takeAll(completed_list);
     }
 
     // call 'completed' with workers list unlocked (may call readComplete() or writeComplete()
@@ -857,7 +822,7 @@ size_t LLTextureCache::update(F32 max_time_ms)
     if(!res && timer.getElapsedTimeF32() > MAX_TIME_INTERVAL)
     {
         timer.reset() ;
-        writeUpdatedEntries() ;
+        flushHeaderEntries() ;
     }
 
     return res;
@@ -885,9 +850,7 @@ std::string LLTextureCache::getTextureFileName(const LLUUID& id)
 BOOL LLTextureCache::isInCache(const LLUUID& id)
 {
     LLMutexLock lock(&mHeaderMutex);
-    id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-
-    return (iter != mHeaderIDMap.end()) ;
+    return findEntryIndex(id) >= 0;
 }
 
 //debug
@@ -944,15 +907,18 @@ U32 LLTextureCache::sHeaderCacheAddressSize = 32;
 #endif
 
 const char* entries_filename = "texture.entries";
+const char* index_filename = "texture.index";
 const char* cache_filename = "texture.cache";
 const char* old_textures_dirname = "textures";
 //change the location of the texture cache to prevent from being deleted by old version viewers.
 const char* textures_dirname = "texturecache";
 const char* fast_cache_filename = "FastCache.cache";
+const char* decoded_dirname = "decoded";
 
 void LLTextureCache::setDirNames(ELLPath location)
 {
     mHeaderEntriesFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, entries_filename);
+    mHeaderIndexFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, index_filename);
     mHeaderDataFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, cache_filename);
     mTexturesDirName = gDirUtilp->getExpandedFilename(location, textures_dirname);
     mFastCacheFileName =  gDirUtilp->getExpandedFilename(location, textures_dirname, fast_cache_filename);
@@ -965,7 +931,6 @@ void LLTextureCache::purgeCache(ELLPath location, bool remove_dir)
     if (!mReadOnly)
     {
         setDirNames(location);
-        llassert_always(mHeaderAPRFile == NULL);
 
         //remove the legacy cache if exists
         std::string texture_dir = mTexturesDirName ;
@@ -1048,40 +1013,125 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
     return max_size; // unused cache space
 }
 
+// Called in the main thread, after initCache().
+void LLTextureCache::initDecodedCache(S64 max_size)
+{
+    mDecodedCache->init(gDirUtilp->add(mTexturesDirName, decoded_dirname), max_size, mReadOnly);
+    if (max_size > 0)
+    {
+        LL_INFOS("TextureCache") << "Decoded textures size: " << max_size / (1024 * 1024) << " MB" << LL_ENDL;
+    }
+}
+
 //----------------------------------------------------------------------------
 // mHeaderMutex must be locked for the following functions!
 
-LLAPRFile* LLTextureCache::openHeaderEntriesFile(bool readonly, S32 offset)
+// Maps the entries file, or copies it to memory when read only, and opens the
+// UUID index next to it. Does nothing if they are already open.
+bool LLTextureCache::openHeaderEntriesFile()
 {
-    llassert_always(mHeaderAPRFile == NULL);
-    apr_int32_t flags = readonly ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_BINARY;
-    mHeaderAPRFile = new LLAPRFile(mHeaderEntriesFileName, flags, mHeaderAPRFilePoolp);
-    if(offset > 0)
+    if (mHeaderEntriesData)
+    {
+        return true;
+    }
+
+    // Room for as many entries as the cache may hold. A file left by a
+    // larger cache is mapped whole until readHeaderCache() purges it.
+    const size_t min_size = sizeof(EntriesInfo) + (size_t)sCacheMaxEntries * sizeof(Entry);
+    size_t size = 0;
+    if (mReadOnly)
+    {
+        mReadOnlyHeaderEntries.assign(min_size, 0);
+        llifstream file(mHeaderEntriesFileName.c_str(), std::ios::binary);
+        if (file.is_open())
+        {
+            file.seekg(0, std::ios::end);
+            const std::streamoff file_size = file.tellg();
+            file.seekg(0, std::ios::beg);
+            if (file_size > 0)
+            {
+                mReadOnlyHeaderEntries.resize(llmax((size_t)file_size, min_size), 0);
+                file.read((char*)mReadOnlyHeaderEntries.data(), file_size);
+            }
+        }
+        mHeaderEntriesData = mReadOnlyHeaderEntries.data();
+        size = mReadOnlyHeaderEntries.size();
+    }
+    else
     {
-        mHeaderAPRFile->seek(APR_SET, offset);
+        if (!mHeaderEntriesFile.open(mHeaderEntriesFileName, min_size))
+        {
+            LL_WARNS("TextureCache") << "Unable to map " << mHeaderEntriesFileName << LL_ENDL;
+            return false;
+        }
+        mHeaderEntriesData = mHeaderEntriesFile.data();
+        size = mHeaderEntriesFile.size();
     }
-    return mHeaderAPRFile;
+    mHeaderEntriesCapacity = (U32)((size - sizeof(EntriesInfo)) / sizeof(Entry));
+
+    if (!mHeaderIndex.open(mHeaderIndexFileName, mHeaderEntriesCapacity, mReadOnly))
+    {
+        closeHeaderEntriesFile();
+        return false;
+    }
+    return true;
 }
 
 void LLTextureCache::closeHeaderEntriesFile()
 {
-    if(!mHeaderAPRFile)
+    mHeaderIndex.close();
+    mHeaderEntriesFile.close();
+    std::vector<U8>().swap(mReadOnlyHeaderEntries);
+    mHeaderEntriesData = NULL;
+    mHeaderEntriesCapacity = 0;
+}
+
+// Schedules the entries and the index changed since the last call to be
+// written back. Called periodically, the updates themselves are plain
+// memory stores.
+void LLTextureCache::flushHeaderEntries()
+{
+    LLMutexLock lock(&mHeaderMutex);
+    if (!mReadOnly && mHeaderEntriesData)
     {
-        return ;
+        mHeaderEntriesFile.flush();
+        mHeaderIndex.flush();
     }
+}
+
+LLTextureCache::Entry* LLTextureCache::getEntryPtr(S32 idx) const
+{
+    if (!mHeaderEntriesData || idx < 0 || (U32)idx >= mHeaderEntriesCapacity)
+    {
+        return NULL;
+    }
+    return (Entry*)(mHeaderEntriesData + sizeof(EntriesInfo)) + idx;
+}
 
-    delete mHeaderAPRFile;
-    mHeaderAPRFile = NULL;
+// Entry index of id, -1 if it is not in the cache.
+S32 LLTextureCache::findEntryIndex(const LLUUID& id)
+{
+    S32 idx = mHeaderIndex.find(id);
+    if (idx >= 0)
+    {
+        const Entry* entry = getEntryPtr(idx);
+        if (!entry || entry->mID != id)
+        {
+            // Stale index slot, the entry was reused without the index
+            // being told.
+            mHeaderIndex.erase(id);
+            idx = -1;
+        }
+    }
+    return idx;
 }
 
 void LLTextureCache::readEntriesHeader()
 {
     // mHeaderEntriesInfo initializes to default values so safe not to read it
-    llassert_always(mHeaderAPRFile == NULL);
-    if (LLAPRFile::isExist(mHeaderEntriesFileName, mHeaderAPRFilePoolp))
+    if (LLAPRFile::isExist(mHeaderEntriesFileName, mHeaderAPRFilePoolp) && openHeaderEntriesFile())
     {
-        LLAPRFile::readEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo),
-                          mHeaderAPRFilePoolp);
+        memcpy((void*)&mHeaderEntriesInfo, mHeaderEntriesData, sizeof(EntriesInfo));
     }
     else //create an empty entries header.
     {
@@ -1109,24 +1159,16 @@ void LLTextureCache::setEntriesHeader()
 
 void LLTextureCache::writeEntriesHeader()
 {
-    llassert_always(mHeaderAPRFile == NULL);
-    if (!mReadOnly)
+    if (!mReadOnly && openHeaderEntriesFile())
     {
-        LLAPRFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo),
-                           mHeaderAPRFilePoolp);
+        memcpy(mHeaderEntriesData, (const void*)&mHeaderEntriesInfo, sizeof(EntriesInfo));
     }
 }
 
 //mHeaderMutex is locked before calling this.
 S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create)
 {
-    S32 idx = -1;
-
-    id_map_t::iterator iter1 = mHeaderIDMap.find(id);
-    if (iter1 != mHeaderIDMap.end())
-    {
-        idx = iter1->second;
-    }
+    S32 idx = findEntryIndex(id);
 
     if (idx < 0)
     {
@@ -1153,10 +1195,10 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
                     // Erase entry from LRU regardless
                     mLRU.erase(curiter2);
                     // Look up entry and use it if it is valid
-                    id_map_t::iterator iter3 = mHeaderIDMap.find(oldid);
-                    if (iter3 != mHeaderIDMap.end() && iter3->second >= 0)
+                    S32 old_idx = findEntryIndex(oldid);
+                    if (old_idx >= 0)
                     {
-                        idx = iter3->second;
+                        idx = old_idx;
                         removeCachedTexture(oldid) ;//remove the existing cached texture to release the entry index.
                         break;
                     }
@@ -1178,23 +1220,14 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
         // Remove this entry from the LRU if it exists
         mLRU.erase(id);
         // Read the entry
-        idx_entry_map_t::iterator iter = mUpdatedEntryMap.find(idx) ;
-        if(iter != mUpdatedEntryMap.end())
-        {
-            entry = iter->second ;
-        }
-        else
-        {
-            readEntryFromHeaderImmediately(idx, entry) ;
-        }
-        if(entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
+        readEntryFromHeaderImmediately(idx, entry) ;
+        if(idx >= 0 && entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
         {
             LL_WARNS() << "corrupted entry: " << id << " entry image size: " << entry.mImageSize << " entry body size: " << entry.mBodySize << LL_ENDL ;
 
             //erase this entry and the cached texture from the cache.
             std::string tex_filename = getTextureFileName(id);
             removeEntry(idx, entry, tex_filename) ;
-            mUpdatedEntryMap.erase(idx) ;
             idx = -1 ;
         }
     }
@@ -1204,56 +1237,36 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header)
 {
-    LLAPRFile* aprfile ;
-    S32 bytes_written ;
-    S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-    if(write_header)
-    {
-        aprfile = openHeaderEntriesFile(false, 0);
-        bytes_written = aprfile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo)) ;
-        if(bytes_written != sizeof(EntriesInfo))
-        {
-            clearCorruptedCache() ; //clear the cache.
-            idx = -1 ;//mark the idx invalid.
-            return ;
-        }
-
-        mHeaderAPRFile->seek(APR_SET, offset);
-    }
-    else
-    {
-        aprfile = openHeaderEntriesFile(false, offset);
-    }
-    bytes_written = aprfile->write((void*)&entry, (S32)sizeof(Entry));
-    if(bytes_written != sizeof(Entry))
+    Entry* dest = getEntryPtr(idx);
+    if (!dest)
     {
         clearCorruptedCache() ; //clear the cache.
         idx = -1 ;//mark the idx invalid.
-
         return ;
     }
 
-    closeHeaderEntriesFile();
-    mUpdatedEntryMap.erase(idx) ;
+    if(write_header)
+    {
+        writeEntriesHeader();
+    }
+    *dest = entry;
 }
 
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::readEntryFromHeaderImmediately(S32& idx, Entry& entry)
 {
-    S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-    LLAPRFile* aprfile = openHeaderEntriesFile(true, offset);
-    S32 bytes_read = aprfile->read((void*)&entry, (S32)sizeof(Entry));
-    closeHeaderEntriesFile();
-
-    if(bytes_read != sizeof(Entry))
+    const Entry* src = getEntryPtr(idx);
+    if (!src)
     {
         clearCorruptedCache() ; //clear the cache.
         idx = -1 ;//mark the idx invalid.
+        return ;
     }
+    entry = *src;
 }
 
 //mHeaderMutex is locked before calling this.
-//update an existing entry time stamp, delay writing.
+//update an existing entry time stamp in place, it reaches the disk with the next flush.
 void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 {
     static const U32 MAX_ENTRIES_WITHOUT_TIME_STAMP = (U32)(LLTextureCache::sCacheMaxEntries * 0.75f) ;
@@ -1268,7 +1281,11 @@ void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
         if (!mReadOnly)
         {
             entry.mTime = time(NULL);
-            mUpdatedEntryMap[idx] = entry ;
+            Entry* dest = getEntryPtr(idx);
+            if (dest)
+            {
+                dest->mTime = entry.mTime;
+            }
         }
     }
 }
@@ -1292,7 +1309,7 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
         bool update_header = false ;
         if(entry.mImageSize < 0) //is a brand-new entry
         {
-            mHeaderIDMap[entry.mID] = idx;
+            mHeaderIndex.insert(entry.mID, idx);
             mTexturesSizeMap[entry.mID] = new_body_size ;
             mTexturesSizeTotal += new_body_size ;
 
@@ -1301,7 +1318,7 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
         }
         else if (entry.mBodySize != new_body_size)
         {
-            //already in mHeaderIDMap.
+            //already in mHeaderIndex.
             mTexturesSizeMap[entry.mID] = new_body_size ;
             mTexturesSizeTotal -= entry.mBodySize ;
             mTexturesSizeTotal += new_body_size ;
@@ -1332,45 +1349,44 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
 {
     U32 num_entries = mHeaderEntriesInfo.mEntries;
 
-    mHeaderIDMap.clear();
     mTexturesSizeMap.clear();
     mFreeList.clear();
     mTexturesSizeTotal = 0;
 
-    LLAPRFile* aprfile = NULL;
-    if(mUpdatedEntryMap.empty())
-    {
-        aprfile = openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo));
-    }
-    else //update the header file first.
+    if (!openHeaderEntriesFile())
     {
-        aprfile = openHeaderEntriesFile(false, 0);
-        updatedHeaderEntriesFile() ;
-        if(!aprfile)
-        {
-            return 0;
-        }
-        aprfile->seek(APR_SET, (S32)sizeof(EntriesInfo));
+        return 0;
     }
 
-    entries.resize(num_entries);
-    S32 total_entries_size = sizeof(Entry) * num_entries;
-    S32 bytes_read = aprfile->read((void*)entries.data(), total_entries_size);
-    if (bytes_read != total_entries_size)
+    if (num_entries > mHeaderEntriesCapacity)
     {
-        LL_WARNS() << "Corrupted header entries, expected " << total_entries_size << " bytes but got " << bytes_read << " bytes" << LL_ENDL;
-        closeHeaderEntriesFile();
+        LL_WARNS() << "Corrupted header entries, expected " << num_entries << " entries but the file holds " << mHeaderEntriesCapacity << LL_ENDL;
         purgeAllTextures(false);
         return 0;
     }
 
+    const Entry* first = getEntryPtr(0);
+    entries.assign(first, first + num_entries);
+
+    // The index is kept up to date on disk, it only has to be refilled when
+    // the viewer did not shut down cleanly or the cache size changed. Checking
+    // a valid entry against it is a single probe, so do it anyway.
+    const bool rebuild_index = mHeaderIndex.needsRebuild();
+    if (rebuild_index)
+    {
+        mHeaderIndex.clear();
+    }
+
     for (U32 idx=0; idx<num_entries; idx++)
     {
         const Entry& entry = entries[idx];
 //      LL_INFOS() << "ENTRY: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << LL_ENDL;
         if(entry.mImageSize > entry.mBodySize)
         {
-            mHeaderIDMap[entry.mID] = idx;
+            if (rebuild_index || mHeaderIndex.find(entry.mID) != (S32)idx)
+            {
+                mHeaderIndex.insert(entry.mID, idx);
+            }
             mTexturesSizeMap[entry.mID] = entry.mBodySize;
             mTexturesSizeTotal += entry.mBodySize;
         }
@@ -1379,7 +1395,11 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
             mFreeList.insert(idx);
         }
     }
-    closeHeaderEntriesFile();
+
+    if (rebuild_index)
+    {
+        mHeaderIndex.setRebuilt();
+    }
     return num_entries;
 }
 
@@ -1388,69 +1408,14 @@ void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
     S32 num_entries = entries.size();
     llassert_always(num_entries == mHeaderEntriesInfo.mEntries);
 
-    if (!mReadOnly)
+    if (!mReadOnly && num_entries > 0)
     {
-        LLAPRFile* aprfile = openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
-        for (S32 idx=0; idx<num_entries; idx++)
-        {
-            S32 bytes_written = aprfile->write((void*)(&entries[idx]), (S32)sizeof(Entry));
-            if(bytes_written != sizeof(Entry))
-            {
-                clearCorruptedCache() ; //clear the cache.
-                return ;
-            }
-        }
-        closeHeaderEntriesFile();
-    }
-}
-
-void LLTextureCache::writeUpdatedEntries()
-{
-    lockHeaders() ;
-    if (!mReadOnly && !mUpdatedEntryMap.empty())
-    {
-        openHeaderEntriesFile(false, 0);
-        updatedHeaderEntriesFile() ;
-        closeHeaderEntriesFile();
-    }
-    unlockHeaders() ;
-}
-
-//mHeaderMutex is locked and mHeaderAPRFile is created before calling this.
-void LLTextureCache::updatedHeaderEntriesFile()
-{
-    if (!mReadOnly && !mUpdatedEntryMap.empty() && mHeaderAPRFile)
-    {
-        //entriesInfo
-        mHeaderAPRFile->seek(APR_SET, 0);
-        S32 bytes_written = mHeaderAPRFile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo)) ;
-        if(bytes_written != sizeof(EntriesInfo))
+        if (!getEntryPtr(num_entries - 1))
         {
             clearCorruptedCache() ; //clear the cache.
             return ;
         }
-
-        //write each updated entry
-        S32 entry_size = (S32)sizeof(Entry) ;
-        S32 prev_idx = -1 ;
-        S32 delta_idx ;
-        for (idx_entry_map_t::iterator iter = mUpdatedEntryMap.begin(); iter != mUpdatedEntryMap.end(); ++iter)
-        {
-            delta_idx = iter->first - prev_idx - 1;
-            prev_idx = iter->first ;
-            if(delta_idx)
-            {
-                mHeaderAPRFile->seek(APR_CUR, delta_idx * entry_size);
-            }
-
-            bytes_written = mHeaderAPRFile->write((void*)(&iter->second), entry_size);
-            if(bytes_written != entry_size)
-            {
-                clearCorruptedCache() ; //clear the cache.
-                return ;
-            }
-        }
-        mUpdatedEntryMap.clear() ;
+        std::copy(entries.begin(), entries.end(), getEntryPtr(0));
     }
 }
 //----------------------------------------------------------------------------
@@ -1587,6 +1552,9 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 {
     if (!mReadOnly)
     {
+        // The entries and index files are deleted below
+        closeHeaderEntriesFile();
+
         const char* subdirs = "0123456789abcdef";
         std::string delem = gDirUtilp->getDirDelimiter();
         std::string mask = "*";
@@ -1609,17 +1577,20 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
             PeekMessage(&msg, 0, 0, 0, PM_NOREMOVE | PM_NOYIELD);
 #endif
         }
+        std::string decoded_dir = mTexturesDirName + delem + decoded_dirname;
+        gDirUtilp->deleteFilesInDir(decoded_dir, mask);
         gDirUtilp->deleteFilesInDir(mTexturesDirName, mask); // headers, fast cache
         if (purge_directories)
         {
+            LLFile::rmdir(decoded_dir);
             LLFile::rmdir(mTexturesDirName);
         }
     }
-    mHeaderIDMap.clear();
+    mHeaderIndex.clear();
     mTexturesSizeMap.clear();
     mTexturesSizeTotal = 0;
     mFreeList.clear();
-    mUpdatedEntryMap.clear();
+    mDecodedCache->purge();
 
     // Info with 0 entries
     setEntriesHeader();
@@ -1661,15 +1632,14 @@ void LLTextureCache::purgeTexturesLazy(F32 time_limit_sec)
         {
             if (iter1->second > 0)
             {
-                id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-                if (iter2 != mHeaderIDMap.end())
+                S32 idx = findEntryIndex(iter1->first);
+                if (idx >= 0 && (U32)idx < entries.size())
                 {
-                    S32 idx = iter2->second;
                     time_idx_set.insert(std::make_pair(entries[idx].mTime, idx));
                 }
                 else
                 {
-                    LL_ERRS("TextureCache") << "mTexturesSizeMap / mHeaderIDMap corrupted." << LL_ENDL;
+                    LL_ERRS("TextureCache") << "mTexturesSizeMap / mHeaderIndex corrupted." << LL_ENDL;
                 }
             }
         }
@@ -1702,8 +1672,7 @@ void LLTextureCache::purgeTexturesLazy(F32 time_limit_sec)
             Entry entry = mPurgeEntryList.back().second;
             mPurgeEntryList.pop_back();
             // make sure record is still valid
-            id_map_t::iterator iter_header = mHeaderIDMap.find(entry.mID);
-            if (iter_header != mHeaderIDMap.end() && iter_header->second == idx)
+            if (findEntryIndex(entry.mID) == idx)
             {
                 std::string tex_filename = getTextureFileName(entry.mID);
                 removeEntry(idx, entry, tex_filename);
@@ -1746,16 +1715,15 @@ void LLTextureCache::purgeTextures(bool validate)
     {
         if (iter1->second > 0)
         {
-            id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-            if (iter2 != mHeaderIDMap.end())
+            S32 idx = findEntryIndex(iter1->first);
+            if (idx >= 0 && (U32)idx < entries.size())
             {
-                S32 idx = iter2->second;
                 time_idx_set.insert(std::make_pair(entries[idx].mTime, idx));
 //              LL_INFOS() << "TIME: " << entries[idx].mTime << " TEX: " << entries[idx].mID << " IDX: " << idx << " Size: " << entries[idx].mImageSize << LL_ENDL;
             }
             else
             {
-                LL_ERRS() << "mTexturesSizeMap / mHeaderIDMap corrupted." << LL_ENDL ;
+                LL_ERRS() << "mTexturesSizeMap / mHeaderIndex corrupted." << LL_ENDL ;
             }
         }
     }
@@ -1831,29 +1799,20 @@ void LLTextureCache::purgeTextures(bool validate)
 
 //////////////////////////////////////////////////////////////////////////////
 
-// call lockWorkers() first!
-LLTextureCacheWorker* LLTextureCache::getReader(handle_t handle)
+void LLTextureCache::addWorker(handle_t handle, LLTextureCacheWorker* worker, bool writer)
 {
-    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
-    LLTextureCacheWorker* res = NULL;
-    handle_map_t::iterator iter = mReaders.find(handle);
-    if (iter != mReaders.end())
+    WorkerShard& shard = getWorkerShard(handle);
+    LLMutexLock lock(&shard.mMutex);
+    if (writer)
     {
-        res = iter->second;
+        shard.mWriters[handle] = worker;
+        ++mNumWrites;
     }
-    return res;
-}
-
-LLTextureCacheWorker* LLTextureCache::getWriter(handle_t handle)
-{
-    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
-    LLTextureCacheWorker* res = NULL;
-    handle_map_t::iterator iter = mWriters.find(handle);
-    if (iter != mWriters.end())
+    else
     {
-        res = iter->second;
+        shard.mReaders[handle] = worker;
+        ++mNumReads;
     }
-    return res;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1914,12 +1873,11 @@ LLTextureCache::handle_t LLTextureCache::readFromCache(const std::string& filena
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
     // Note: checking to see if an entry exists can cause a stall,
     //  so let the thread handle it
-    LLMutexLock lock(&mWorkersMutex);
     LLTextureCacheWorker* worker = new LLTextureCacheLocalFileWorker(this, filename, id,
                                                                      NULL, size, offset, 0,
                                                                      responder);
     handle_t handle = worker->read();
-    mReaders[handle] = worker;
+    addWorker(handle, worker, false);
     return handle;
 }
 
@@ -1929,12 +1887,11 @@ LLTextureCache::handle_t LLTextureCache::readFromCache(const LLUUID& id,
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
     // Note: checking to see if an entry exists can cause a stall,
     //  so let the thread handle it
-    LLMutexLock lock(&mWorkersMutex);
     LLTextureCacheWorker* worker = new LLTextureCacheRemoteWorker(this, id,
                                                                   NULL, size, offset,
                                                                   0, NULL, 0, responder);
     handle_t handle = worker->read();
-    mReaders[handle] = worker;
+    addWorker(handle, worker, false);
     return handle;
 }
 
@@ -1942,30 +1899,40 @@ LLTextureCache::handle_t LLTextureCache::readFromCache(const LLUUID& id,
 bool LLTextureCache::readComplete(handle_t handle, bool abort)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
-    lockWorkers();
-    handle_map_t::iterator iter = mReaders.find(handle);
+    WorkerShard& shard = getWorkerShard(handle);
     LLTextureCacheWorker* worker = NULL;
     bool complete = false;
-    if (iter != mReaders.end())
     {
-        worker = iter->second;
-        complete = worker->complete();
-
-        if(!complete && abort)
+        LLMutexLock lock(&shard.mMutex);
+        handle_map_t::iterator iter = shard.mReaders.find(handle);
+        if (iter != shard.mReaders.end())
         {
-            abortRequest(handle, true) ;
+            worker = iter->second;
+            // Polling a request still in flight must not touch the worker
+            // thread's request table, which the cache thread keeps locked.
+            complete = worker->isFinished() && worker->complete();
+
+            if (complete || abort)
+            {
+                shard.mReaders.erase(iter);
+                --mNumReads;
+            }
+            else
+            {
+                worker = NULL;
+            }
         }
     }
-    if (worker && (complete || abort))
+    if (worker)
     {
-        mReaders.erase(iter);
-        unlockWorkers();
+        // Aborting waits on the worker thread's request table, so it is
+        // done once the worker is out of the shard and its lock released.
+        if (!complete)
+        {
+            abortRequest(handle, true) ;
+        }
         worker->scheduleDelete();
     }
-    else
-    {
-        unlockWorkers();
-    }
     return (complete || abort);
 }
 
@@ -1993,12 +1960,11 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id,
         return LLWorkerThread::nullHandle();
     }
 
-    LLMutexLock lock(&mWorkersMutex);
     LLTextureCacheWorker* worker = new LLTextureCacheRemoteWorker(this, id,
                                                                   data, datasize, 0,
                                                                   imagesize, rawimage, discardlevel, responder);
     handle_t handle = worker->write();
-    mWriters[handle] = worker;
+    addWorker(handle, worker, true);
     return handle;
 }
 
@@ -2008,13 +1974,13 @@ LLPointer<LLImageRaw> LLTextureCache::readFromFastCache(const LLUUID& id, S32& d
     U32 offset;
     {
         LLMutexLock lock(&mHeaderMutex);
-        id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-        if(iter == mHeaderIDMap.end())
+        S32 idx = findEntryIndex(id);
+        if(idx < 0)
         {
             return NULL; //not in the cache
         }
 
-        offset = iter->second;
+        offset = idx;
     }
     offset *= TEXTURE_FAST_CACHE_ENTRY_SIZE;
 
@@ -2060,6 +2026,20 @@ LLPointer<LLImageRaw> LLTextureCache::readFromFastCache(const LLUUID& id, S32& d
 }
 
 //return the fast cache location
+LLPointer<LLImageRaw> LLTextureCache::readFromDecodedCache(const LLUUID& id, S32 max_discard, S32& discardlevel)
+{
+    LL_PROFILE_ZONE_SCOPED;
+    return mDecodedCache->read(id, max_discard, discardlevel);
+}
+
+void LLTextureCache::writeToDecodedCache(const LLUUID& id, const LLImageRaw* rawimage, S32 discardlevel)
+{
+    if (!mReadOnly)
+    {
+        LLDecodedTextureCache::writeAsync(mDecodedCache, id, rawimage, discardlevel);
+    }
+}
+
 bool LLTextureCache::writeToFastCache(LLUUID image_id, S32 id, LLPointer<LLImageRaw> raw, S32 discardlevel)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
@@ -2187,21 +2167,25 @@ void LLTextureCache::closeFastCache(bool forced)
 
 bool LLTextureCache::writeComplete(handle_t handle, bool abort)
 {
-    lockWorkers();
-    handle_map_t::iterator iter = mWriters.find(handle);
-    llassert(iter != mWriters.end());
-    if (iter != mWriters.end())
+    WorkerShard& shard = getWorkerShard(handle);
+    LLTextureCacheWorker* worker = NULL;
     {
-        LLTextureCacheWorker* worker = iter->second;
-        if (worker->complete() || abort)
+        LLMutexLock lock(&shard.mMutex);
+        handle_map_t::iterator iter = shard.mWriters.find(handle);
+        llassert(iter != shard.mWriters.end());
+        if (iter != shard.mWriters.end()
+            && ((iter->second->isFinished() && iter->second->complete()) || abort))
         {
-            mWriters.erase(handle);
-            unlockWorkers();
-            worker->scheduleDelete();
-            return true;
+            worker = iter->second;
+            shard.mWriters.erase(iter);
+            --mNumWrites;
         }
     }
-    unlockWorkers();
+    if (worker)
+    {
+        worker->scheduleDelete();
+        return true;
+    }
     return false;
 }
 
@@ -2209,16 +2193,12 @@ void LLTextureCache::prioritizeWrite(handle_t handle)
 {
     // Don't prioritize yet, we might be working on this now
     //   which could create a deadlock
-    LLMutexLock lock(&mListMutex);
-    mPrioritizeWriteList.push_back(handle);
-    mPrioritizeWriteListEmpty = mPrioritizeWriteList.empty();
+    mPrioritizeWriteList.push(handle);
 }
 
 void LLTextureCache::addCompleted(Responder* responder, bool success)
 {
-    LLMutexLock lock(&mListMutex);
-    mCompletedList.push_back(std::make_pair(responder,success));
-    mCompletedListEmpty = mCompletedList.empty();
+    mCompletedList.push(std::make_pair(LLPointer<Responder>(responder), success));
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -2231,7 +2211,7 @@ void LLTextureCache::removeCachedTexture(const LLUUID& id)
         mTexturesSizeTotal -= mTexturesSizeMap[id] ;
         mTexturesSizeMap.erase(id);
     }
-    mHeaderIDMap.erase(id);
+    mHeaderIndex.erase(id);
     // We are inside header's mutex so mHeaderAPRFilePoolp is safe to use,
     // but getLocalAPRFilePool() is not safe, it might be in use by worker
     LLAPRFile::remove(getTextureFileName(id), mHeaderAPRFilePoolp);
@@ -2262,7 +2242,7 @@ void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
 
         entry.mImageSize = -1;
         entry.mBodySize = 0;
-        mHeaderIDMap.erase(entry.mID);
+        mHeaderIndex.erase(entry.mID);
         mTexturesSizeMap.erase(entry.mID);
         mFreeList.insert(idx);
     }
@@ -2292,6 +2272,8 @@ bool LLTextureCache::removeFromCache(const LLUUID& id)
         }
 
         unlockHeaders() ;
+
+        mDecodedCache->remove(id);
     }
     return ret ;
 }
@@ -27,6 +27,7 @@
 #ifndef LL_LLTEXTURECACHE_H
 #define LL_LLTEXTURECACHE_H
 
+#include "llatomic.h"
 #include "lldir.h"
 #include "llstl.h"
 #include "llstring.h"
@@ -34,6 +35,10 @@
 
 #include "llworkerthread.h"
 
+#include "lldecodedtexturecache.h"
+#include "llmappedfile.h"
+#include "lltexturecacheindex.h"
+
 #include <boost/unordered/unordered_flat_map.hpp>
 
 class LLImageFormatted;
@@ -120,6 +125,8 @@ class LLTextureCache final : public LLWorkerThread
     void purgeCache(ELLPath location, bool remove_dir = true);
     void setReadOnly(BOOL read_only) ;
     S64 initCache(ELLPath location, S64 maxsize, BOOL texture_cache_mismatch);
+    // Must be called after initCache(). A max_size of 0 disables it.
+    void initDecodedCache(S64 max_size);
 
     handle_t readFromCache(const std::string& local_filename, const LLUUID& id, S32 offset, S32 size,
                            ReadResponder* responder);
@@ -130,20 +137,19 @@ class LLTextureCache final : public LLWorkerThread
     handle_t writeToCache(const LLUUID& id, U8* data, S32 datasize, S32 imagesize, LLPointer<LLImageRaw> rawimage, S32 discardlevel,
                           WriteResponder* responder);
     LLPointer<LLImageRaw> readFromFastCache(const LLUUID& id, S32& discardlevel);
+    // Decoded pixels of id at a discard level no higher than max_discard,
+    // null if none are cached. Reads synchronously.
+    LLPointer<LLImageRaw> readFromDecodedCache(const LLUUID& id, S32 max_discard, S32& discardlevel);
+    // Copies rawimage, the write itself happens in the background
+    void writeToDecodedCache(const LLUUID& id, const LLImageRaw* rawimage, S32 discardlevel);
     bool writeComplete(handle_t handle, bool abort = false);
     void prioritizeWrite(handle_t handle);
 
     bool removeFromCache(const LLUUID& id);
 
-    // For LLTextureCacheWorker::Responder
-    LLTextureCacheWorker* getReader(handle_t handle);
-    LLTextureCacheWorker* getWriter(handle_t handle);
-    void lockWorkers() { mWorkersMutex.lock(); }
-    void unlockWorkers() { mWorkersMutex.unlock(); }
-
     // debug
-    S32 getNumReads() { return mReaders.size(); }
-    S32 getNumWrites() { return mWriters.size(); }
+    S32 getNumReads() { return mNumReads; }
+    S32 getNumWrites() { return mNumWrites; }
     S64Bytes getUsage() { return S64Bytes(mTexturesSizeTotal); }
     S64Bytes getMaxUsage() { return S64Bytes(sCacheMaxTexturesSize); }
     U32 getEntries() { return mHeaderEntriesInfo.mEntries; }
@@ -167,8 +173,11 @@ class LLTextureCache final : public LLWorkerThread
     void purgeAllTextures(bool purge_directories);
     void purgeTexturesLazy(F32 time_limit_sec);
     void purgeTextures(bool validate);
-    LLAPRFile* openHeaderEntriesFile(bool readonly, S32 offset);
+    bool openHeaderEntriesFile();
     void closeHeaderEntriesFile();
+    void flushHeaderEntries();
+    Entry* getEntryPtr(S32 idx) const;
+    S32 findEntryIndex(const LLUUID& id);
     void readEntriesHeader();
     void setEntriesHeader();
     void writeEntriesHeader();
@@ -183,8 +192,7 @@ class LLTextureCache final : public LLWorkerThread
     void removeCachedTexture(const LLUUID& id) ;
     S32 getHeaderCacheEntry(const LLUUID& id, Entry& entry);
     S32 setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize);
-    void writeUpdatedEntries() ;
-    void updatedHeaderEntriesFile() ;
+    void addWorker(handle_t handle, LLTextureCacheWorker* worker, bool writer);
     void lockHeaders() { mHeaderMutex.lock(); }
     void unlockHeaders() { mHeaderMutex.unlock(); }
 
@@ -194,11 +202,10 @@ class LLTextureCache final : public LLWorkerThread
 
 private:
     // Internal
-    LLMutex mWorkersMutex;
     LLMutex mHeaderMutex;
-    LLMutex mListMutex;
     LLMutex mFastCacheMutex;
-    LLAPRFile* mHeaderAPRFile;
+    U8* mHeaderEntriesData; // EntriesInfo followed by the entries
+    U32 mHeaderEntriesCapacity;
     LLVolatileAPRPool* mFastCachePoolp;
 
     // mLocalAPRFilePoolp is not thread safe and is meant only for workers
@@ -206,34 +213,55 @@ class LLTextureCache final : public LLWorkerThread
     // so it needs own pool (not thread safe by itself, relies onto header's mutex)
     LLVolatileAPRPool*   mHeaderAPRFilePoolp;
 
+    // Active workers by request handle. The fetch thread polls them on every
+    // update while the cache thread and the main thread add and retire them,
+    // so they are spread over shards that each have their own mutex. These
+    // are short lookups: the poll of an unfinished request takes one shard
+    // lock and never waits for the worker thread.
     typedef boost::unordered_flat_map<handle_t, LLTextureCacheWorker*> handle_map_t;
-    handle_map_t mReaders;
-    handle_map_t mWriters;
-
+    struct WorkerShard
+    {
+        LLMutex mMutex;
+        handle_map_t mReaders;
+        handle_map_t mWriters;
+    };
+    static const U32 WORKER_SHARDS = 16;
+    WorkerShard& getWorkerShard(handle_t handle) { return mWorkerShards[handle % WORKER_SHARDS]; }
+    WorkerShard mWorkerShards[WORKER_SHARDS];
+    std::atomic<S32> mNumReads;
+    std::atomic<S32> mNumWrites;
+
+    // Handed to update() through lock-free stacks, see LLAtomicStack. Only
+    // these lists are lock-free, the worker tables above are not.
     typedef std::vector<handle_t> handle_list_t;
-    handle_list_t mPrioritizeWriteList;
-    std::atomic<bool> mPrioritizeWriteListEmpty;
+    LLAtomicStack<handle_t> mPrioritizeWriteList;
 
-    typedef std::vector<std::pair<LLPointer<Responder>, bool> > responder_list_t;
-    responder_list_t mCompletedList;
-    std::atomic<bool> mCompletedListEmpty;
+    typedef std::pair<LLPointer<Responder>, bool> completed_t;
+    typedef std::vector<completed_t> responder_list_t;
+    LLAtomicStack<completed_t> mCompletedList;
 
     BOOL mReadOnly;
 
     // HEADERS (Include first mip)
     std::string mHeaderEntriesFileName;
+    std::string mHeaderIndexFileName;
     std::string mHeaderDataFileName;
     std::string mFastCacheFileName;
     EntriesInfo mHeaderEntriesInfo;
     std::set<S32> mFreeList; // deleted entries
     std::set<LLUUID> mLRU;
-    typedef boost::unordered_flat_map<LLUUID, S32> id_map_t;
-    id_map_t mHeaderIDMap;
+    LLMappedFile mHeaderEntriesFile;
+    std::vector<U8> mReadOnlyHeaderEntries; // whole entries file when read only
+    LLTextureCacheIndex mHeaderIndex; // UUID -> entry index
 
     LLAPRFile*   mFastCachep;
     LLFrameTimer mFastCacheTimer;
     U8*          mFastCachePadBuffer;
 
+    // DECODED TEXTURES (optional)
+    // Shared with the background writes, which may outlive the cache
+    std::shared_ptr<LLDecodedTextureCache> mDecodedCache;
+
     // BODIES (TEXTURES minus headers)
     std::string mTexturesDirName;
     typedef boost::unordered_map<LLUUID,S32> size_map_t;
@@ -241,8 +269,6 @@ class LLTextureCache final : public LLWorkerThread
     S64 mTexturesSizeTotal;
     LLAtomicBool mDoPurge;
 
-    typedef std::map<S32, Entry> idx_entry_map_t;
-    idx_entry_map_t mUpdatedEntryMap;
     typedef std::vector<std::pair<S32, Entry> > idx_entry_vector_t;
     idx_entry_vector_t mPurgeEntryList;
 
@@ -0,0 +1,284 @@
+/**
+ * @file lltexturecacheindex.cpp
+ * @brief Memory-mapped, open-addressed UUID index of the texture cache header entries.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturecacheindex.h"
+
+#include "llfile.h"
+
+namespace
+{
+    constexpr U32 INDEX_MAGIC = 0x58444954; // 'TIDX'
+    constexpr U32 INDEX_VERSION = 1;
+}
+
+struct LLTextureCacheIndex::Header
+{
+    U32 mMagic;
+    U32 mVersion;
+    U32 mSlotCount;
+    U32 mCount;
+    U32 mClean;
+    U32 mReserved[3];
+};
+
+struct LLTextureCacheIndex::Slot
+{
+    LLUUID  mID;
+    U32     mIndex;     // entry index + 1, 0 when the slot is empty
+};
+
+LLTextureCacheIndex::~LLTextureCacheIndex()
+{
+    close();
+}
+
+bool LLTextureCacheIndex::open(const std::string& filename, U32 max_entries, bool read_only)
+{
+    static_assert(sizeof(Header) == 32, "texture cache index Header layout changed");
+    static_assert(sizeof(Slot) == 20, "texture cache index Slot layout changed");
+
+    close();
+
+    mReadOnly = read_only;
+    // Keep the load factor at or below 2/3 so probe runs stay short
+    mSlotCount = llmax(max_entries, 1U) + max_entries / 2 + 1;
+    const size_t file_size = sizeof(Header) + (size_t)mSlotCount * sizeof(Slot);
+
+    U8* data = nullptr;
+    if (read_only)
+    {
+        mReadOnlyData.assign(file_size, 0);
+        LLFILE* fp = LLFile::fopen(filename, "rb");
+        if (fp)
+        {
+            if (fread(mReadOnlyData.data(), 1, file_size, fp) != file_size)
+            {
+                std::fill(mReadOnlyData.begin(), mReadOnlyData.end(), 0);
+            }
+            fclose(fp);
+        }
+        data = mReadOnlyData.data();
+    }
+    else
+    {
+        if (!mFile.open(filename, file_size))
+        {
+            LL_WARNS("TextureCache") << "Unable to map texture cache index " << filename << LL_ENDL;
+            return false;
+        }
+        if (mFile.size() != file_size && !mFile.resize(file_size))
+        {
+            mFile.close();
+            return false;
+        }
+        data = mFile.data();
+    }
+
+    mSlots = (Slot*)(data + sizeof(Header));
+
+    Header* hdr = header();
+    mNeedsRebuild = hdr->mMagic != INDEX_MAGIC
+        || hdr->mVersion != INDEX_VERSION
+        || hdr->mSlotCount != mSlotCount
+        || !hdr->mClean;
+    if (mNeedsRebuild)
+    {
+        LL_INFOS("TextureCache") << "Texture cache index needs to be rebuilt" << LL_ENDL;
+        clear();
+    }
+
+    if (!mReadOnly)
+    {
+        // Until close(), a crash leaves the table marked as dirty
+        hdr->mClean = 0;
+        mFile.flush(false);
+    }
+    return true;
+}
+
+void LLTextureCacheIndex::close()
+{
+    if (!mSlots)
+    {
+        return;
+    }
+
+    if (!mReadOnly)
+    {
+        header()->mClean = 1;
+        mFile.flush(false);
+    }
+    mFile.close();
+    mReadOnlyData.clear();
+    mSlots = nullptr;
+    mSlotCount = 0;
+}
+
+LLTextureCacheIndex::Header* LLTextureCacheIndex::header() const
+{
+    return (Header*)((U8*)mSlots - sizeof(Header));
+}
+
+void LLTextureCacheIndex::clear()
+{
+    if (!mSlots)
+    {
+        return;
+    }
+
+    Header* hdr = header();
+    hdr->mMagic = INDEX_MAGIC;
+    hdr->mVersion = INDEX_VERSION;
+    hdr->mSlotCount = mSlotCount;
+    hdr->mCount = 0;
+    memset((void*)mSlots, 0, (size_t)mSlotCount * sizeof(Slot));
+}
+
+U32 LLTextureCacheIndex::home(const LLUUID& id) const
+{
+    // Texture IDs are random, their bits need no further mixing
+    return (U32)(id.getDigest64() % mSlotCount);
+}
+
+// Slot holding id, or the empty slot ending its probe run, -1 if the table
+// has neither.
+S32 LLTextureCacheIndex::probe(const LLUUID& id) const
+{
+    U32 pos = home(id);
+    for (U32 i = 0; i < mSlotCount; ++i)
+    {
+        const Slot& slot = mSlots[pos];
+        if (!slot.mIndex || slot.mID == id)
+        {
+            return (S32)pos;
+        }
+        if (++pos == mSlotCount)
+        {
+            pos = 0;
+        }
+    }
+    return -1;
+}
+
+S32 LLTextureCacheIndex::find(const LLUUID& id) const
+{
+    if (!mSlots)
+    {
+        return -1;
+    }
+
+    S32 pos = probe(id);
+    if (pos < 0 || !mSlots[pos].mIndex)
+    {
+        return -1;
+    }
+    return (S32)mSlots[pos].mIndex - 1;
+}
+
+bool LLTextureCacheIndex::insert(const LLUUID& id, S32 idx)
+{
+    if (!mSlots || idx < 0)
+    {
+        return false;
+    }
+
+    S32 pos = probe(id);
+    if (pos < 0)
+    {
+        LL_WARNS("TextureCache") << "Texture cache index is full" << LL_ENDL;
+        return false;
+    }
+
+    Slot& slot = mSlots[pos];
+    if (!slot.mIndex)
+    {
+        slot.mID = id;
+        ++header()->mCount;
+    }
+    slot.mIndex = (U32)idx + 1;
+    return true;
+}
+
+bool LLTextureCacheIndex::erase(const LLUUID& id)
+{
+    if (!mSlots)
+    {
+        return false;
+    }
+
+    S32 pos = probe(id);
+    if (pos < 0 || !mSlots[pos].mIndex)
+    {
+        return false;
+    }
+
+    // Shift back the slots of the probe run that can't be found any more
+    // once the hole is left empty.
+    U32 hole = (U32)pos;
+    U32 next = hole;
+    while (true)
+    {
+        if (++next == mSlotCount)
+        {
+            next = 0;
+        }
+        Slot& slot = mSlots[next];
+        if (!slot.mIndex)
+        {
+            break;
+        }
+
+        const U32 want = home(slot.mID);
+        // Distance from the wanted slot to the current one, and to the hole
+        const U32 dist_next = (next + mSlotCount - want) % mSlotCount;
+        const U32 dist_hole = (hole + mSlotCount - want) % mSlotCount;
+        if (dist_hole < dist_next)
+        {
+            mSlots[hole] = slot;
+            hole = next;
+        }
+    }
+
+    mSlots[hole].mID.setNull();
+    mSlots[hole].mIndex = 0;
+    --header()->mCount;
+    return true;
+}
+
+U32 LLTextureCacheIndex::size() const
+{
+    return mSlots ? header()->mCount : 0;
+}
+
+void LLTextureCacheIndex::flush(bool async)
+{
+    if (mSlots && !mReadOnly)
+    {
+        mFile.flush(async);
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ * @file lltexturecacheindex.h
+ * @brief Memory-mapped, open-addressed UUID index of the texture cache header entries.
+ *
+ * @Description:
+ * Maps a texture ID to the index of its entry in texture.entries. The table
+ * lives in its own file next to the entries so that it survives restarts:
+ *
+ * 1/ A fixed size header (magic, version, slot count, count, clean flag)
+ *    followed by the slots. A slot holds the texture ID and the entry index
+ *    plus one, so a zero filled slot is empty and a new file is an empty
+ *    table.
+ * 2/ Collisions are resolved by linear probing. Removal shifts the following
+ *    slots of the probe run back, so there are no tombstones and lookups
+ *    never degrade.
+ * 3/ The clean flag is cleared while the table is open and set again by
+ *    close(). A table that was not closed cleanly, or that was sized for
+ *    another number of entries, is reported by needsRebuild() and has to be
+ *    refilled from the entries by the caller.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTURECACHEINDEX_H
+#define LL_LLTEXTURECACHEINDEX_H
+
+#include "llmappedfile.h"
+#include "lluuid.h"
+
+#include <vector>
+
+// No locking of its own: LLTextureCache only uses it under its header mutex.
+class LLTextureCacheIndex
+{
+public:
+    LLTextureCacheIndex() = default;
+    ~LLTextureCacheIndex();
+
+    LLTextureCacheIndex(const LLTextureCacheIndex&) = delete;
+    LLTextureCacheIndex& operator=(const LLTextureCacheIndex&) = delete;
+
+    /**
+     * Open the table stored in filename, sized for max_entries entries.
+     * When read_only, the file is copied to memory and never written.
+     * Returns false if the table could not be set up at all.
+     */
+    bool open(const std::string& filename, U32 max_entries, bool read_only);
+
+    // Mark the table clean and flush it to disk.
+    void close();
+    bool isOpen() const { return mSlots != nullptr; }
+
+    // True when the table content can't be trusted and must be refilled.
+    bool needsRebuild() const { return mNeedsRebuild; }
+    void setRebuilt() { mNeedsRebuild = false; }
+
+    // Empty the table.
+    void clear();
+
+    // Entry index of id, -1 if id is not in the table.
+    S32 find(const LLUUID& id) const;
+
+    // Add id or move it to another entry index.
+    bool insert(const LLUUID& id, S32 idx);
+    bool erase(const LLUUID& id);
+
+    U32 size() const;
+
+    // Schedule the written pages to be written back to disk.
+    void flush(bool async = true);
+
+private:
+    struct Header;
+    struct Slot;
+
+    Header* header() const;
+    U32 home(const LLUUID& id) const;
+    S32 probe(const LLUUID& id) const;
+
+private:
+    LLMappedFile        mFile;
+    std::vector<U8>     mReadOnlyData;  // whole table when opened read only
+    Slot*               mSlots = nullptr;
+    U32                 mSlotCount = 0;
+    bool                mReadOnly = false;
+    bool                mNeedsRebuild = false;
+};
+
+#endif // LL_LLTEXTURECACHEINDEX_H
@@ -165,6 +165,7 @@ const std::string sTesterName("TextureFetchTester");
 // acquiring 'B'.
 //
 // 1.    Mw < Mfnq
+// 2.    Mw < Mwc < Ct (wakeWork())
 // (there are many more...)
 //
 //
@@ -219,6 +220,12 @@ const std::string sTesterName("TextureFetchTester");
 // return false as soon as possible and not block to avoid starving
 // other workers of cpu cycles.
 //
+// A worker waiting on a completion (cache read or write, HTTP response,
+// decode, or an HTTP slot from releaseHttpWaiters()) calls waitForWake()
+// before returning false.  It is then left off the work queue until the
+// completion callback calls wakeWork(), which posts the next doWork()
+// straight to the fetch thread's WorkQueue, rather than being polled.
+//
 
 
 
@@ -1015,9 +1022,14 @@ void LLTextureFetchWorker::setDesiredDiscard(S32 discard, S32 size)
                 addWork(0);
             }
         }
-        else if (mDesiredDiscard < discard)
+        else
         {
-            prioritize = true;
+            if (mDesiredDiscard < discard)
+            {
+                prioritize = true;
+            }
+            // A worker parked on a cache write needs to prioritize it
+            wakeWork();
         }
         mDesiredDiscard = discard;
         mDesiredSize = size;
@@ -1038,6 +1050,11 @@ void LLTextureFetchWorker::setDesiredDiscard(S32 discard, S32 size)
 void LLTextureFetchWorker::setImagePriority(F32 priority)
 {
     mImagePriority = priority; //should map to max virtual size, abort if zero
+    if (mDecodeHandle != 0 && mState == DECODE_IMAGE_UPDATE)
+    {
+        // Only moves the decode within the queue if it hasn't started
+        LLAppViewer::getImageDecodeThread()->setPriority(mDecodeHandle, priority);
+    }
 }
 
 // Locks:  Mw
@@ -1184,6 +1201,27 @@ bool LLTextureFetchWorker::doWork(S32 param)
         LL_PROFILE_ZONE_NAMED_CATEGORY_THREAD("tfwdw - LOAD_FROM_TEXTURE_CACHE");
         if (mCacheReadHandle == LLTextureCache::nullHandle())
         {
+            if (mFormattedImage.isNull() && !mNeedsAux
+                && (mUrl.empty() || mFTType == FTT_SERVER_BAKE) && mFetcher->canLoadFromCache())
+            {
+                // Textures decoded in an earlier session skip both the cache
+                // read and the decode
+                S32 discard = -1;
+                LLPointer<LLImageRaw> raw = mFetcher->mTextureCache->readFromDecodedCache(mID, mDesiredDiscard, discard);
+                if (raw.notNull())
+                {
+                    mRawImage = raw;
+                    mAuxImage = NULL;
+                    mDecodedDiscard = discard;
+                    mDecoded = TRUE;
+                    mInCache = TRUE;
+                    mWriteToCacheState = NOT_WRITE;
+                    add(LLTextureFetch::sCacheHit, 1.0);
+                    setState(DONE);
+                    return doWork(param);
+                }
+            }
+
             S32 offset = mFormattedImage.notNull() ? mFormattedImage->getDataSize() : 0;
             S32 size = mDesiredSize - offset;
             if (size <= 0)
@@ -1249,6 +1287,11 @@ bool LLTextureFetchWorker::doWork(S32 param)
         }
         else
         {
+            if (mCacheReadHandle != LLTextureCache::nullHandle())
+            {
+                // callbackCacheRead() wakes us
+                waitForWake();
+            }
             return false;
         }
     }
@@ -1413,7 +1456,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
     if (mState == WAIT_HTTP_RESOURCE2)
     {
         LL_PROFILE_ZONE_NAMED_CATEGORY_THREAD("tfwdw - WAIT_HTTP_RESOURCE2");
-        // Just idle it if we make it to the head...
+        // Idle until releaseHttpWaiters() moves us on
+        waitForWake();
         return false;
     }
 
@@ -1766,6 +1810,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
             // various possible timeout components (total request time, connection
             // time, I/O time, with and without retries, etc.) in the future.
 
+            // onCompleted() wakes us
+            waitForWake();
             return false;
         }
     }
@@ -1831,7 +1877,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
         mDecodeHandle = LLAppViewer::getImageDecodeThread()->decodeImage(mFormattedImage,
                                                                        discard,
                                                                        mNeedsAux,
-                                                                       new DecodeResponder(mFetcher, mID, this));
+                                                                       new DecodeResponder(mFetcher, mID, this),
+                                                                       mImagePriority);
         if (mDecodeHandle == 0)
         {
             // Abort, failed to put into queue.
@@ -1880,12 +1927,19 @@ bool LLTextureFetchWorker::doWork(S32 param)
                 LL_DEBUGS(LOG_TXT) << mID << ": Decoded. Discard: " << mDecodedDiscard
                                    << " Raw Image: " << llformat("%dx%d",mRawImage->getWidth(),mRawImage->getHeight()) << LL_ENDL;
 #endif
+                if (!mNeedsAux && !mInLocalCache)
+                {
+                    // Not handed out yet, so still safe to copy
+                    mFetcher->mTextureCache->writeToDecodedCache(mID, mRawImage, mDecodedDiscard);
+                }
                 setState(WRITE_TO_CACHE);
             }
             // fall through
         }
         else
         {
+            // callbackDecoded() wakes us
+            waitForWake();
             return false;
         }
     }
@@ -1948,6 +2002,11 @@ bool LLTextureFetchWorker::doWork(S32 param)
                 // Prioritize the write
                 mFetcher->mTextureCache->prioritizeWrite(mCacheWriteHandle);
             }
+            if (!mWritten)
+            {
+                // callbackCacheWrite() wakes us, as does a new desired discard
+                waitForWake();
+            }
             return false;
         }
     }
@@ -2026,6 +2085,7 @@ void LLTextureFetchWorker::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRe
             setGetStatus(status, reason);
             releaseHttpSemaphore();
             setState(LOAD_FROM_NETWORK);
+            wakeWork();
             return;
         }
         else
@@ -2089,6 +2149,7 @@ void LLTextureFetchWorker::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRe
     mFetcher->removeFromHTTPQueue(mID, data_size);
 
     recordTextureDone(true, data_size);
+    wakeWork();
 }                                                                       // -Mw
 
 
@@ -2098,7 +2159,8 @@ void LLTextureFetchWorker::endWork(S32 param, bool aborted)
     LL_PROFILE_ZONE_SCOPED;
     if (mDecodeHandle != 0)
     {
-        // LL::ThreadPool has no operation to cancel a particular work item
+        // Frees the decode thread for textures still wanted
+        LLAppViewer::getImageDecodeThread()->cancelDecode(mDecodeHandle);
         mDecodeHandle = 0;
     }
     mFormattedImage = NULL;
@@ -2340,6 +2402,7 @@ void LLTextureFetchWorker::callbackCacheRead(bool success, LLImageFormatted* ima
         }
     }
     mLoaded = TRUE;
+    wakeWork();
 }                                                                       // -Mw
 
 // Threads:  Ttc
@@ -2352,6 +2415,7 @@ void LLTextureFetchWorker::callbackCacheWrite(bool success)
         return;
     }
     mWritten = TRUE;
+    wakeWork();
 }                                                                       // -Mw
 
 //////////////////////////////////////////////////////////////////////////////
@@ -2399,6 +2463,7 @@ void LLTextureFetchWorker::callbackDecoded(bool success, const std::string &erro
         mDecodedDiscard = -1; // Redundant, here for clarity and paranoia
     }
     mDecoded = TRUE;
+    wakeWork();
 //  LL_INFOS(LOG_TXT) << mID << " : DECODE COMPLETE " << LL_ENDL;
 }                                                                       // -Mw
 
@@ -3437,6 +3502,7 @@ void LLTextureFetch::releaseHttpWaiters()
         }
 
         worker->setState(LLTextureFetchWorker::SEND_HTTP_REQ);
+        worker->wakeWork();
         worker->unlockWorkMutex();                                      // -Mw
 
         removeHttpWaiter(worker->mID);
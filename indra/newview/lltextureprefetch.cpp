@@ -0,0 +1,266 @@
+/**
+ * @file lltextureprefetch.cpp
+ * @brief Fetches the textures of cached objects on region entry.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltextureprefetch.h"
+
+#include "llagent.h"
+#include "llagentcamera.h"
+#include "llviewercontrol.h"
+#include "llviewerobject.h"
+#include "llviewerregion.h"
+#include "llviewertexture.h"
+#include "workqueue.h"
+
+#include <boost/unordered/unordered_flat_map.hpp>
+#include <boost/unordered/unordered_flat_set.hpp>
+
+#include <algorithm>
+
+namespace
+{
+    // Give up on textures whose objects did not show up by then
+    const F32 ACTIVE_TIMEOUT = 60.f;
+    // Fetches updated per frame while driving them
+    const U32 FETCHES_PER_FRAME = 32;
+    // Virtual sizes of the nearest and farthest prefetched textures, well
+    // under what most visible faces ask for
+    const F32 NEAREST_VSIZE = 256.f * 256.f;
+    const F32 FARTHEST_VSIZE = 32.f * 32.f;
+
+    bool agent_has_arrived()
+    {
+        switch (gAgent.getTeleportState())
+        {
+        case LLAgent::TELEPORT_START:
+        case LLAgent::TELEPORT_REQUESTED:
+        case LLAgent::TELEPORT_MOVING:
+        case LLAgent::TELEPORT_PENDING:
+            return false;
+        default:
+            return gAgent.getRegion() != NULL;
+        }
+    }
+}
+
+LLTrace::CountStatHandle<> LLTexturePrefetch::sPrefetched("texture_prefetched", "Textures of cached objects fetched on region entry");
+
+LLTexturePrefetch::LLTexturePrefetch()
+    : mNextFetch(0)
+{
+}
+
+void LLTexturePrefetch::queueRegion(LLViewerRegion* regionp, const LLVOCacheEntry::vocache_entry_map_t& cache_map)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+    static LLCachedControl<U32> prefetch_count(gSavedSettings, "TexturePrefetchCount", 512);
+    if (!prefetch_count || !regionp)
+    {
+        return;
+    }
+
+    // Only the bytes of the updates are collected here, mostly references
+    // to the object cache store. They are parsed on the general queue.
+    auto objects = std::make_shared<std::vector<CachedObject> >();
+    objects->reserve(cache_map.size());
+    for (const auto& item : cache_map)
+    {
+        CachedObject object;
+        object.mData = item.second->shareData(object.mSize);
+        if (object.mData)
+        {
+            object.mLocalID = item.first;
+            objects->push_back(std::move(object));
+        }
+    }
+    if (objects->empty())
+    {
+        return;
+    }
+
+    const LLVector3d origin = regionp->getOriginGlobal();
+    LL::WorkQueue::ptr_t main_queue = LL::WorkQueue::getInstance("mainloop");
+    LL::WorkQueue::ptr_t general_queue = LL::WorkQueue::getInstance("General");
+    if (!main_queue || !general_queue)
+    {
+        return;
+    }
+    main_queue->postTo(
+        general_queue,
+        [objects, origin]() // work done on the general queue
+        {
+            std::vector<Candidate> candidates;
+            scanObjects(*objects, origin, candidates);
+            return candidates;
+        },
+        [](std::vector<Candidate> candidates) // callback to the main thread
+        {
+            if (LLTexturePrefetch::instanceExists())
+            {
+                std::vector<Candidate>& pending = LLTexturePrefetch::getInstance()->mPending;
+                pending.insert(pending.end(), candidates.begin(), candidates.end());
+            }
+        });
+}
+
+//static
+void LLTexturePrefetch::scanObjects(const std::vector<CachedObject>& objects, const LLVector3d& origin,
+                                    std::vector<Candidate>& candidates)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+    boost::unordered_flat_map<U32, U32> by_id;
+    by_id.reserve(objects.size());
+    for (U32 i = 0; i < objects.size(); ++i)
+    {
+        by_id[objects[i].mLocalID] = i;
+    }
+
+    LLVector3 pos, scale, parent_pos, parent_scale;
+    LLQuaternion rot, parent_rot;
+    uuid_vec_t image_ids;
+    for (const CachedObject& object : objects)
+    {
+        // read only, the buffer is shared with the cache entry
+        LLDataPackerBinaryBuffer dp(const_cast<U8*>(object.mData.get()), object.mSize);
+        U32 parent_id = LLViewerObject::extractSpatialExtents(&dp, pos, scale, rot);
+        if (parent_id)
+        {
+            // Children are positioned relative to their root
+            auto parent = by_id.find(parent_id);
+            if (parent == by_id.end())
+            {
+                continue;
+            }
+            const CachedObject& parent_object = objects[parent->second];
+            LLDataPackerBinaryBuffer parent_dp(const_cast<U8*>(parent_object.mData.get()), parent_object.mSize);
+            LLViewerObject::extractSpatialExtents(&parent_dp, parent_pos, parent_scale, parent_rot);
+            pos = parent_pos + pos * parent_rot;
+        }
+
+        image_ids.clear();
+        LLViewerObject::extractTextureIDs(&dp, image_ids);
+        for (const LLUUID& id : image_ids)
+        {
+            candidates.push_back({ id, origin + LLVector3d(pos), scale.length() * 0.5f });
+        }
+    }
+}
+
+void LLTexturePrefetch::startPending()
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+    static LLCachedControl<U32> prefetch_count(gSavedSettings, "TexturePrefetchCount", 512);
+
+    // Nearest to the arrival point first, measured from the object's
+    // bounding sphere, within draw distance
+    const LLVector3d agent_pos = gAgent.getPositionGlobal();
+    const F32 draw_distance = gAgentCamera.mDrawDistance;
+    std::vector<std::pair<F32, U32> > order;
+    order.reserve(mPending.size());
+    for (U32 i = 0; i < mPending.size(); ++i)
+    {
+        const Candidate& candidate = mPending[i];
+        F32 distance = llmax((F32)(candidate.mPosGlobal - agent_pos).length() - candidate.mRadius, 0.f);
+        if (distance <= draw_distance)
+        {
+            order.emplace_back(distance, i);
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    boost::unordered_flat_set<LLUUID> started;
+    for (const Active& active : mActive)
+    {
+        started.insert(active.mTexture->getID());
+    }
+
+    const U32 limit = llmin((U32)prefetch_count, (U32)order.size());
+    for (U32 i = 0; i < order.size() && mActive.size() < limit; ++i)
+    {
+        const LLUUID& id = mPending[order[i].second].mID;
+        if (!started.insert(id).second)
+        {
+            continue;
+        }
+
+        LLViewerFetchedTexture* tex = LLViewerTextureManager::getFetchedTexture(id, FTT_DEFAULT, TRUE, LLGLTexture::BOOST_NONE, LLViewerTexture::LOD_TEXTURE);
+        if (!tex || tex->getTotalNumFaces() > 0)
+        {
+            // Already in use, the texture list takes care of it
+            continue;
+        }
+
+        F32 rank = (F32)mActive.size() / (F32)limit;
+        mActive.push_back({ tex, lerp(NEAREST_VSIZE, FARTHEST_VSIZE, rank) });
+        add(sPrefetched, 1);
+    }
+
+    mPending.clear();
+    mActiveTimer.reset();
+}
+
+void LLTexturePrefetch::update(bool drive_fetches)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+    if (!mPending.empty() && agent_has_arrived())
+    {
+        startPending();
+    }
+
+    if (mActive.empty())
+    {
+        return;
+    }
+
+    if (mActiveTimer.getElapsedTimeF32() > ACTIVE_TIMEOUT)
+    {
+        mActive.clear();
+        return;
+    }
+
+    // Textures whose faces exist are wanted by them from now on
+    mActive.erase(std::remove_if(mActive.begin(), mActive.end(),
+        [](const Active& active) { return active.mTexture->getTotalNumFaces() > 0; }),
+        mActive.end());
+
+    // Virtual sizes decay as textures get updated, keep asking for ours
+    for (const Active& active : mActive)
+    {
+        active.mTexture->addTextureStats(active.mVirtualSize);
+    }
+
+    if (drive_fetches && !mActive.empty())
+    {
+        for (U32 i = 0; i < llmin(FETCHES_PER_FRAME, (U32)mActive.size()); ++i)
+        {
+            mNextFetch = (mNextFetch + 1) % mActive.size();
+            LLViewerFetchedTexture* tex = mActive[mNextFetch].mTexture;
+            tex->processTextureStats();
+            tex->updateFetch();
+        }
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ * @file lltextureprefetch.h
+ * @brief Fetches the textures of cached objects on region entry.
+ *
+ * @Description:
+ * Objects read from the object cache (LLVOCache) are only instantiated once
+ * the simulator confirms them, and their textures only requested once their
+ * faces exist. The texture entries are already in the cached updates though:
+ * when a region's cache is loaded, they are collected with the position of
+ * their object, and once the agent has arrived the nearest ones are fetched
+ * at a low priority, so that they are warm by the time the geometry shows.
+ *
+ * Main thread only.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREPREFETCH_H
+#define LL_LLTEXTUREPREFETCH_H
+
+#include "llframetimer.h"
+#include "llpointer.h"
+#include "llsingleton.h"
+#include "lltrace.h"
+#include "lluuid.h"
+#include "v3dmath.h"
+#include "llvocache.h"
+
+#include <vector>
+
+class LLViewerFetchedTexture;
+class LLViewerRegion;
+
+class LLTexturePrefetch : public LLSingleton<LLTexturePrefetch>
+{
+    LLSINGLETON(LLTexturePrefetch);
+
+public:
+    // Collect the textures of the objects in cache_map, just loaded from
+    // the object cache of regionp. They are found off the main thread and
+    // queued once found.
+    void queueRegion(LLViewerRegion* regionp, const LLVOCacheEntry::vocache_entry_map_t& cache_map);
+
+    /**
+     * Once per frame. Starts the queued textures once the agent has arrived
+     * and keeps the started ones wanted until their faces exist. While the
+     * texture list is not updated (teleport screen), drive_fetches lets the
+     * prefetcher update their fetches itself.
+     */
+    void update(bool drive_fetches);
+
+    U32 getPendingCount() const { return (U32)mPending.size(); }
+    U32 getActiveCount() const { return (U32)mActive.size(); }
+
+    static LLTrace::CountStatHandle<> sPrefetched;
+
+private:
+    void startPending();
+
+    struct Candidate
+    {
+        LLUUID mID;
+        LLVector3d mPosGlobal;
+        F32 mRadius;
+    };
+
+    struct CachedObject
+    {
+        U32 mLocalID = 0;
+        S32 mSize = 0;
+        LLVOCacheStore::data_ref_t mData;
+    };
+
+    // Thread safe, parses the updates of objects
+    static void scanObjects(const std::vector<CachedObject>& objects, const LLVector3d& origin,
+                            std::vector<Candidate>& candidates);
+
+    struct Active
+    {
+        LLPointer<LLViewerFetchedTexture> mTexture;
+        F32 mVirtualSize;
+    };
+
+    std::vector<Candidate> mPending;
+    std::vector<Active> mActive;
+    LLFrameTimer mActiveTimer;
+    U32 mNextFetch;
+};
+
+#endif // LL_LLTEXTUREPREFETCH_H
@@ -42,6 +42,7 @@
 #include "llmeshrepository.h"
 #include "llselectmgr.h"
 #include "llviewertexlayer.h"
+#include "lltexturebudget.h"
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
 #include "llviewercontrol.h"
@@ -539,6 +540,18 @@ void LLGLTexMemBar::draw()
     LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, v_offset + line_height*6,
                                              text_color, LLFontGL::LEFT, LLFontGL::TOP);
 
+    F64 budget = recording.getLastValue(LLTextureBudget::sBudget).value();
+    F64 budget_usage = recording.getLastValue(LLTextureBudget::sUsage).value();
+    color = budget > 0.0 && budget_usage > budget ? LLColor4::red : text_color;
+    color[VALPHA] = text_color[VALPHA];
+    text = llformat("Budget: %.0f MB Used: %.0f MB Evictions: %.0f (total %u)",
+                    budget,
+                    budget_usage,
+                    recording.getSum(LLTextureBudget::sEvictions),
+                    LLTextureBudget::getInstance()->getEvictedCount());
+    LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, v_offset + line_height*7,
+                                             color, LLFontGL::LEFT, LLFontGL::TOP);
+
     U32 cache_read(0U), cache_write(0U), res_wait(0U);
     LLAppViewer::getTextureFetch()->getStateStats(&cache_read, &cache_write, &res_wait);
 
@@ -649,7 +662,7 @@ BOOL LLGLTexMemBar::handleMouseDown(S32 x, S32 y, MASK mask)
 LLRect LLGLTexMemBar::getRequiredRect()
 {
     LLRect rect;
-    rect.mTop = 78; //LLFontGL::getFontMonospace()->getLineHeight() * 6;
+    rect.mTop = 91; //LLFontGL::getFontMonospace()->getLineHeight() * 7;
     return rect;
 }
 
@@ -939,7 +939,7 @@ class LLFileTakeSnapshotToDisk : public view_listener_t
             default:
                 LL_WARNS() << "Unknown local snapshot format: " << fmt << LL_ENDL;
             case LLSnapshotModel::SNAPSHOT_FORMAT_PNG:
-                formatted = new LLImagePNG;
+                formatted = LLSnapshotLivePreview::newSnapshotPNG();
                 break;
             case LLSnapshotModel::SNAPSHOT_FORMAT_BMP:
                 formatted = new LLImageBMP;
@@ -948,10 +948,8 @@ class LLFileTakeSnapshotToDisk : public view_listener_t
                 formatted = new LLImageWebP;
                 break;
             }
-            formatted->enableOverSize() ;
-            formatted->encode(raw, 0);
-            formatted->disableOverSize() ;
-            LLSnapshotLivePreview::saveLocal(formatted);
+            // Encoded on a worker along with the saving
+            LLSnapshotLivePreview::saveLocal(formatted, LLSnapshotLivePreview::snapshot_saved_signal_t(), LLSnapshotLivePreview::snapshot_saved_signal_t(), raw);
         }
         return true;
     }
@@ -744,6 +744,96 @@ U32 LLViewerObject::unpackParentID(LLDataPackerBinaryBuffer* dp, U32& parent_id)
     return parent_id;
 }
 
+//static
+bool LLViewerObject::unpackCompressedFields(LLDataPacker& dp, CompressedFields& fields, bool read_scratch_pad)
+{
+    dp.unpackU32(fields.mCRC, "CRC");
+    dp.unpackU8(fields.mMaterial, "Material");
+    dp.unpackU8(fields.mClickAction, "ClickAction");
+    dp.unpackVector3(fields.mScale, "Scale");
+    dp.unpackVector3(fields.mPos, "Pos");
+    dp.unpackVector3(fields.mRot, "Rot");
+
+    U32& value = fields.mFlags;
+    dp.unpackU32(value, "SpecialCode");
+    dp.setPassFlags(value);
+    dp.unpackUUID(fields.mOwnerID, "Owner");
+
+    if (value & 0x80)
+    {
+        dp.unpackVector3(fields.mAngularVelocity, "Omega");
+    }
+
+    fields.mParentID = 0;
+    if (value & 0x20)
+    {
+        dp.unpackU32(fields.mParentID, "ParentID");
+    }
+
+    fields.mScratchPad.clear();
+    if (value & 0x2)
+    {
+        dp.unpackU8(fields.mTreeData, "TreeData");
+    }
+    else if (value & 0x1)
+    {
+        if (!read_scratch_pad)
+        {
+            return false;
+        }
+        U32 size;
+        S32 sp_size;
+        dp.unpackU32(size, "ScratchPadSize");
+        fields.mScratchPad.resize(size);
+        dp.unpackBinaryData(fields.mScratchPad.data(), sp_size, "PartData");
+    }
+
+    if (value & 0x4)
+    {
+        dp.unpackString(fields.mText, "Text");
+        dp.unpackBinaryDataFixed(fields.mTextColor.mV, 4, "Color");
+    }
+    if (value & 0x200)
+    {
+        dp.unpackString(fields.mMediaURL, "MediaURL");
+    }
+    return true;
+}
+
+//static
+void LLViewerObject::unpackExtraParams(LLDataPacker& dp, const std::function<void(U16, LLDataPackerBinaryBuffer&)>& func)
+{
+    U8 num_parameters;
+    dp.unpackU8(num_parameters, "num_params");
+    U8 param_block[MAX_OBJECT_PARAMS_SIZE];
+    for (U8 param = 0; param < num_parameters; ++param)
+    {
+        U16 param_type;
+        S32 param_size;
+        dp.unpackU16(param_type, "param_type");
+        dp.unpackBinaryData(param_block, param_size, "param_data");
+        //LL_INFOS() << "Param type: " << param_type << ", Size: " << param_size << LL_ENDL;
+        LLDataPackerBinaryBuffer dp2(param_block, param_size);
+        func(param_type, dp2);
+    }
+}
+
+//static
+void LLViewerObject::unpackCompressedTrailer(LLDataPacker& dp, U32 flags, CompressedTrailer& trailer)
+{
+    if (flags & 0x10)
+    {
+        dp.unpackUUID(trailer.mSoundID, "SoundUUID");
+        dp.unpackF32(trailer.mGain, "SoundGain");
+        dp.unpackU8(trailer.mSoundFlags, "SoundFlags");
+        dp.unpackF32(trailer.mSoundRadius, "SoundRadius");
+    }
+    if (flags & 0x100)
+    {
+        dp.unpackString(trailer.mNameValues, "NV");
+    }
+}
+
 // Replaces all name value pairs with data from \n delimited list
 // Does not update server
 void LLViewerObject::setNameValueList(const std::string& name_value_list)
@@ -1166,6 +1256,83 @@ U32 LLViewerObject::extractSpatialExtents(LLDataPackerBinaryBuffer *dp, LLVector
     return parent_id;
 }
 
+//static
+bool LLViewerObject::extractTextureIDs(LLDataPackerBinaryBuffer *dp, uuid_vec_t& image_ids)
+{
+    // Walks the compressed layout read by processUpdateMessage() and
+    // LLVOVolume::processUpdateMessage() up to the texture entry
+    dp->reset();
+
+    LLUUID id;
+    U32 u32;
+    U8 u8;
+    LLPCode pcode = 0;
+    dp->unpackUUID(id, "ID");
+    dp->unpackU32(u32, "LocalID");
+    dp->unpackU8(pcode, "PCode");
+    if (pcode != LL_PCODE_VOLUME)
+    {
+        dp->reset();
+        return false;
+    }
+
+    dp->unpackU8(u8, "State");
+
+    // Legacy scratch pads are not worth sizing a buffer for
+    CompressedFields fields;
+    if (!unpackCompressedFields(*dp, fields, false))
+    {
+        dp->reset();
+        return false;
+    }
+
+    if (fields.mFlags & 0x8)
+    {
+        LLPartSysData part_sys_data;
+        part_sys_data.unpackLegacy(*dp);
+        if (part_sys_data.mPartImageID.notNull())
+        {
+            image_ids.push_back(part_sys_data.mPartImageID);
+        }
+    }
+
+    LLUUID sculpt_id;
+    unpackExtraParams(*dp, [&](U16 param_type, LLDataPackerBinaryBuffer& dp2)
+        {
+            if (param_type == LLNetworkData::PARAMS_SCULPT)
+            {
+                LLSculptParams sculpt_params;
+                if (sculpt_params.unpack(dp2)
+                    && (sculpt_params.getSculptType() & LL_SCULPT_TYPE_MASK) != LL_SCULPT_TYPE_MESH)
+                {
+                    sculpt_id = sculpt_params.getSculptTexture();
+                }
+            }
+            else if (param_type == LLNetworkData::PARAMS_LIGHT_IMAGE)
+            {
+                LLLightImageParams light_params;
+                if (light_params.unpack(dp2) && light_params.getLightTexture().notNull())
+                {
+                    image_ids.push_back(light_params.getLightTexture());
+                }
+            }
+        });
+    if (sculpt_id.notNull())
+    {
+        image_ids.push_back(sculpt_id);
+    }
+
+    CompressedTrailer trailer;
+    unpackCompressedTrailer(*dp, fields.mFlags, trailer);
+
+    LLVolumeParams volume_params;
+    bool success = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp)
+        && LLPrimitive::unpackTEImageIDs(*dp, image_ids);
+    dp->reset();
+
+    return success;
+}
+
 U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
                      void **user_data,
                      U32 block_num,
@@ -1863,9 +2030,11 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
                     gFloaterTools->dirty();
                 }
 
-                dp->unpackU32(crc, "CRC");
+                CompressedFields fields;
+                unpackCompressedFields(*dp, fields, true);
+                crc = fields.mCRC;
                 mTotalCRC = crc;
-                dp->unpackU8(material, "Material");
+                material = fields.mMaterial;
                 U8 old_material = getMaterial();
                 if (old_material != material)
                 {
@@ -1875,52 +2044,36 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
                         gPipeline.markMoved(mDrawable, FALSE); // undamped
                     }
                 }
-                dp->unpackU8(click_action, "ClickAction");
+                click_action = fields.mClickAction;
                 setClickAction(click_action);
-                dp->unpackVector3(new_scale, "Scale");
-                dp->unpackVector3(new_pos_parent, "Pos");
-                LLVector3 vec;
-                dp->unpackVector3(vec, "Rot");
-                new_rot.unpackFromVector3(vec);
+                new_scale = fields.mScale;
+                new_pos_parent = fields.mPos;
+                new_rot.unpackFromVector3(fields.mRot);
                 setAcceleration(LLVector3::zero);
 
-                U32 value;
-                dp->unpackU32(value, "SpecialCode");
-                dp->setPassFlags(value);
-                dp->unpackUUID(owner_id, "Owner");
-
+                const U32 value = fields.mFlags;
+                owner_id = fields.mOwnerID;
                 mOwnerID = owner_id;
 
                 if (value & 0x80)
                 {
-                    dp->unpackVector3(new_angv, "Omega");
+                    new_angv = fields.mAngularVelocity;
                     setAngularVelocity(new_angv);
                 }
 
-                if (value & 0x20)
-                {
-                    dp->unpackU32(parent_id, "ParentID");
-                }
-                else
-                {
-                    parent_id = 0;
-                }
+                parent_id = fields.mParentID;
 
-                S32 sp_size;
-                U32 size;
                 if (value & 0x2)
                 {
-                    sp_size = 1;
                     delete [] mData;
                     mData = new U8[1];
-                    dp->unpackU8(((U8*)mData)[0], "TreeData");
+                    ((U8*)mData)[0] = fields.mTreeData;
                 }
                 else if (value & 0x1)
                 {
-                    dp->unpackU32(size, "ScratchPadSize");
                     delete [] mData;
-                    mData = new U8[size];
-                    dp->unpackBinaryData((U8 *)mData, sp_size, "PartData");
+                    mData = new U8[fields.mScratchPad.size()];
+                    std::copy(fields.mScratchPad.begin(), fields.mScratchPad.end(), (U8*)mData);
                 }
                 else
                 {
@@ -1935,11 +2088,9 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 
                 if (value & 0x4)
                 {
-                    std::string temp_string;
-                    dp->unpackString(temp_string, "Text");
+                    const std::string& temp_string = fields.mText;
 
-                    LLColor4U coloru;
-                    dp->unpackBinaryDataFixed(coloru.mV, 4, "Color");
+                    LLColor4U coloru = fields.mTextColor;
                     coloru.mV[3] = 255 - coloru.mV[3];
                     mText->setColor(LLColor4(coloru));
                     mText->setString(temp_string);
@@ -1965,12 +2116,7 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
                     mHudText.clear();
                 }
 
-                std::string media_url;
-                if (value & 0x200)
-                {
-                    dp->unpackString(media_url, "MediaURL");
-                }
-                retval |= checkMediaURL(media_url);
+                retval |= checkMediaURL(fields.mMediaURL);
 
                 //
                 // Unpack particle system data (legacy)
@@ -1991,19 +2137,10 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
                 }
 
                 // Unpack extra params
-                U8 num_parameters;
-                dp->unpackU8(num_parameters, "num_params");
-                U8 param_block[MAX_OBJECT_PARAMS_SIZE];
-                for (U8 param=0; param<num_parameters; ++param)
-                {
-                    U16 param_type;
-                    S32 param_size;
-                    dp->unpackU16(param_type, "param_type");
-                    dp->unpackBinaryData(param_block, param_size, "param_data");
-                    //LL_INFOS() << "Param type: " << param_type << ", Size: " << param_size << LL_ENDL;
-                    LLDataPackerBinaryBuffer dp2(param_block, param_size);
-                    unpackParameterEntry(param_type, &dp2);
-                }
+                unpackExtraParams(*dp, [this](U16 param_type, LLDataPackerBinaryBuffer& dp2)
+                    {
+                        unpackParameterEntry(param_type, &dp2);
+                    });
 
                 for (size_t i = 0; i < mExtraParameterList.size(); ++i)
                 {
@@ -2015,20 +2152,19 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
                     }
                 }
 
+                CompressedTrailer trailer;
+                unpackCompressedTrailer(*dp, value, trailer);
                 if (value & 0x10)
                 {
-                    dp->unpackUUID(sound_uuid, "SoundUUID");
-                    dp->unpackF32(gain, "SoundGain");
-                    dp->unpackU8(sound_flags, "SoundFlags");
-                    dp->unpackF32(cutoff, "SoundRadius");
+                    sound_uuid = trailer.mSoundID;
+                    gain = trailer.mGain;
+                    sound_flags = trailer.mSoundFlags;
+                    cutoff = trailer.mSoundRadius;
                 }
 
                 if (value & 0x100)
                 {
-                    std::string name_value_list;
-                    dp->unpackString(name_value_list, "NV");
-
-                    setNameValueList(name_value_list);
+                    setNameValueList(trailer.mNameValues);
                 }
 
                 mTotalCRC = crc;
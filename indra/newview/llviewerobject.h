@@ -27,6 +27,7 @@
 #ifndef LL_LLVIEWEROBJECT_H
 #define LL_LLVIEWEROBJECT_H
 
+#include <functional>
 #include <map>
 #include <unordered_map>
 
@@ -41,6 +42,7 @@
 #include "llquaternion.h"
 #include "v3dmath.h"
 #include "v3math.h"
+#include "v4coloru.h"
 #include "llvertexbuffer.h"
 #include "llbbox.h"
 #include "llrigginginfo.h"
@@ -184,6 +186,9 @@ class LLViewerObject
     };
 
     static  U32     extractSpatialExtents(LLDataPackerBinaryBuffer *dp, LLVector3& pos, LLVector3& scale, LLQuaternion& rot);
+    // Appends the textures a cached volume update would request. Only reads
+    // dp, so it may run on any thread.
+    static  bool    extractTextureIDs(LLDataPackerBinaryBuffer *dp, uuid_vec_t& image_ids);
     virtual U32     processUpdateMessage(LLMessageSystem *mesgsys,
                                         void **user_data,
                                         U32 block_num,
@@ -678,6 +683,42 @@ class LLViewerObject
     static void unpackU8(LLDataPackerBinaryBuffer* dp, U8& value, std::string name);
     static U32 unpackParentID(LLDataPackerBinaryBuffer* dp, U32& parent_id);
 
+    // Fields of a compressed object update from the CRC to the media URL,
+    // in the order they are packed
+    struct CompressedFields
+    {
+        U32 mCRC = 0;
+        U8 mMaterial = 0;
+        U8 mClickAction = 0;
+        LLVector3 mScale;
+        LLVector3 mPos;
+        LLVector3 mRot;
+        U32 mFlags = 0; // "SpecialCode", which of the optional fields are there
+        LLUUID mOwnerID;
+        LLVector3 mAngularVelocity;
+        U32 mParentID = 0;
+        U8 mTreeData = 0;
+        std::vector<U8> mScratchPad;
+        std::string mText;
+        LLColor4U mTextColor;
+        std::string mMediaURL;
+    };
+    // Sound and name values, after the extra parameters
+    struct CompressedTrailer
+    {
+        LLUUID mSoundID;
+        F32 mGain = 0.f;
+        U8 mSoundFlags = 0;
+        F32 mSoundRadius = 0.f;
+        std::string mNameValues;
+    };
+    // Legacy scratch pads are only read with read_scratch_pad, the update
+    // is rejected otherwise. The particle system follows, when mFlags & 0x8.
+    static bool unpackCompressedFields(LLDataPacker& dp, CompressedFields& fields, bool read_scratch_pad);
+    // Calls func with each extra parameter block
+    static void unpackExtraParams(LLDataPacker& dp, const std::function<void(U16, LLDataPackerBinaryBuffer&)>& func);
+    static void unpackCompressedTrailer(LLDataPacker& dp, U32 flags, CompressedTrailer& trailer);
+
 public:
     //counter-translation
     void resetChildrenPosition(const LLVector3& offset, BOOL simplified = FALSE,  BOOL skip_avatar_child = FALSE) ;
@@ -60,6 +60,7 @@
 #include "llregioninfomodel.h"
 #include "llsdutil.h"
 #include "llstartup.h"
+#include "lltextureprefetch.h"
 #include "lltrans.h"
 #include "llurldispatcher.h"
 #include "llviewerobjectlist.h"
@@ -826,6 +827,11 @@ void LLViewerRegion::loadObjectCache()
         {
             mCacheDirty = TRUE;
         }
+        else
+        {
+            // Start on the textures before the objects get instantiated
+            LLTexturePrefetch::getInstance()->queueRegion(this, mImpl->mCacheMap);
+        }
     }
 }
 
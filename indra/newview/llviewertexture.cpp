@@ -58,6 +58,7 @@
 #include "llmediaentry.h"
 #include "llvovolume.h"
 #include "llviewermedia.h"
+#include "lltexturebudget.h"
 #include "lltexturecache.h"
 #include "llviewerwindow.h"
 #include "llwindow.h"
@@ -558,6 +559,27 @@ void LLViewerTexture::updateClass()
     // try to leave half a GB for everyone else, but keep at least 768MB for ourselves
     F32 target = llmax(budget - 512.f, 768.f);
 
+    // Least recently visible textures are evicted first. The budget counts
+    // the GL bytes of the fetched textures, so it gets what the target
+    // leaves once everything else in the estimate above is taken out.
+    // That estimate counts every byte twice.
+    static LLCachedControl<U32> texture_budget_mb(gSavedSettings, "TextureMemoryBudget", 0);
+    LLTextureBudget* texture_budget = LLTextureBudget::getInstance();
+    if (texture_budget_mb)
+    {
+        texture_budget->setBudget((S64)texture_budget_mb * 1024 * 1024);
+    }
+    else
+    {
+        const S64 target_bytes = (S64)target * 1024 * 1024 / 2;
+        const S64 other_bytes = (S64)LLImageGL::getTextureBytesAllocated() - texture_budget->getUsage() +
+            (S64)LLVertexBuffer::getBytesAllocated();
+        // never squeezed below a quarter of the target
+        texture_budget->setBudget(llmax(target_bytes - other_bytes, target_bytes / 4));
+    }
+
+    // The global bias stays the fallback for as long as the target is
+    // exceeded, evictions only lower it once they take effect
     F32 over_pct = llmax((used-target) / target, 0.f);
     sDesiredDiscardBias = llmax(sDesiredDiscardBias, 1.f + over_pct);
 
@@ -628,6 +650,9 @@ void LLViewerTexture::init(bool firstinit)
     mFaceList[LLRender::DIFFUSE_MAP].clear();
     mFaceList[LLRender::NORMAL_MAP].clear();
     mFaceList[LLRender::SPECULAR_MAP].clear();
+    mFaceRows[LLRender::DIFFUSE_MAP].clear();
+    mFaceRows[LLRender::NORMAL_MAP].clear();
+    mFaceRows[LLRender::SPECULAR_MAP].clear();
     mNumFaces[LLRender::DIFFUSE_MAP] =
     mNumFaces[LLRender::NORMAL_MAP] =
     mNumFaces[LLRender::SPECULAR_MAP] = 0;
@@ -655,6 +680,9 @@ void LLViewerTexture::cleanup()
     mFaceList[LLRender::DIFFUSE_MAP].clear();
     mFaceList[LLRender::NORMAL_MAP].clear();
     mFaceList[LLRender::SPECULAR_MAP].clear();
+    mFaceRows[LLRender::DIFFUSE_MAP].clear();
+    mFaceRows[LLRender::NORMAL_MAP].clear();
+    mFaceRows[LLRender::SPECULAR_MAP].clear();
     mVolumeList[LLRender::LIGHT_TEX].clear();
     mVolumeList[LLRender::SCULPT_TEX].clear();
 }
@@ -801,8 +829,10 @@ void LLViewerTexture::addFace(U32 ch, LLFace* facep)
     if(mNumFaces[ch] >= mFaceList[ch].size())
     {
         mFaceList[ch].resize(2 * mNumFaces[ch] + 1);
+        mFaceRows[ch].resize(mFaceList[ch].size());
     }
     mFaceList[ch][mNumFaces[ch]] = facep;
+    mFaceRows[ch][mNumFaces[ch]] = facep->getPriorityRow();
     facep->setIndexInTex(ch, mNumFaces[ch]);
     mNumFaces[ch]++;
     mLastFaceListUpdateTimer.reset();
@@ -820,11 +850,13 @@ void LLViewerTexture::removeFace(U32 ch, LLFace* facep)
         llassert(index < mFaceList[ch].size());
         llassert(index < mNumFaces[ch]);
         mFaceList[ch][index] = mFaceList[ch][--mNumFaces[ch]];
+        mFaceRows[ch][index] = mFaceRows[ch][mNumFaces[ch]];
         mFaceList[ch][index]->setIndexInTex(ch, index);
     }
     else
     {
         mFaceList[ch].clear();
+        mFaceRows[ch].clear();
         mNumFaces[ch] = 0;
     }
     mLastFaceListUpdateTimer.reset();
@@ -907,6 +939,7 @@ void LLViewerTexture::reorganizeFaceList()
     }
 
         mFaceList[i].erase(mFaceList[i].begin() + mNumFaces[i], mFaceList[i].end());
+        mFaceRows[i].resize(mNumFaces[i]);
     }
 
     mLastFaceListUpdateTimer.reset();
@@ -1103,6 +1136,7 @@ void LLViewerFetchedTexture::init(bool firstinit)
     mForceCallbackFetch = FALSE;
     mInDebug = FALSE;
     mUnremovable = FALSE;
+    mBudgetDiscardBias = 0;
 
     mFTType = FTT_UNKNOWN;
 }
@@ -1117,6 +1151,10 @@ LLViewerFetchedTexture::~LLViewerFetchedTexture()
     {
         LLAppViewer::getTextureFetch()->deleteRequest(getID(), true);
     }
+    if (LLTextureBudget::instanceExists())
+    {
+        LLTextureBudget::getInstance()->removeTexture(this);
+    }
     cleanup();
 }
 
@@ -1799,6 +1837,11 @@ void LLViewerFetchedTexture::processTextureStats()
     }
 }
 
+S64 LLViewerFetchedTexture::getGLTextureBytes() const
+{
+    return mGLTexturep.notNull() ? (S64)mGLTexturep->mTextureMemory.value() : 0;
+}
+
 //============================================================================
 
 void LLViewerFetchedTexture::updateVirtualSize()
@@ -3261,6 +3304,8 @@ void LLViewerLODTexture::processTextureStats()
             discard_level *= sDesiredDiscardScale; // scale (default 1.1f)
         }
         discard_level = floorf(discard_level);
+        // Lower the resolution of textures evicted to stay within budget
+        discard_level += mBudgetDiscardBias;
 
         F32 min_discard = 0.f;
         U32 desired_size = MAX_IMAGE_SIZE_DEFAULT; // MAX_IMAGE_SIZE_DEFAULT = 2048 and max size ever is 4096
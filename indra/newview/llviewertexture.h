@@ -35,6 +35,7 @@
 #include "llgltypes.h"
 #include "llrender.h"
 #include "llmetricperformancetester.h"
+#include "lltexturebudget.h"
 #include "httpcommon.h"
 #include "workqueue.h"
 
@@ -158,6 +159,8 @@ class LLViewerTexture : public LLGLTexture
     S32 getTotalNumFaces() const;
     S32 getNumFaces(U32 ch) const;
     const ll_face_list_t* getFaceList(U32 channel) const {llassert(channel < LLRender::NUM_TEXTURE_CHANNELS); return &mFaceList[channel];}
+    // LLFacePriorityTable rows of the faces, in the order of getFaceList()
+    const std::vector<U32>& getFaceRows(U32 channel) const {llassert(channel < LLRender::NUM_TEXTURE_CHANNELS); return mFaceRows[channel];}
 
     virtual void addVolume(U32 channel, LLVOVolume* volumep);
     virtual void removeVolume(U32 channel, LLVOVolume* volumep);
@@ -201,6 +204,7 @@ class LLViewerTexture : public LLGLTexture
 
     ll_face_list_t    mFaceList[LLRender::NUM_TEXTURE_CHANNELS]; //reverse pointer pointing to the faces using this image as texture
     U32               mNumFaces[LLRender::NUM_TEXTURE_CHANNELS];
+    std::vector<U32>  mFaceRows[LLRender::NUM_TEXTURE_CHANNELS];
     LLFrameTimer      mLastFaceListUpdateTimer ;
 
     ll_volume_list_t  mVolumeList[LLRender::NUM_VOLUME_TEXTURE_CHANNELS];
@@ -260,7 +264,7 @@ const std::string& fttype_to_string(const FTType& fttype);
 //raw image data is fetched from remote or local cache
 //but the raw image this texture pointing to is fixed.
 //
-class LLViewerFetchedTexture : public LLViewerTexture
+class LLViewerFetchedTexture : public LLViewerTexture, public LLBudgetedTexture
 {
     friend class LLTextureBar; // debug info only
     friend class LLTextureView; // debug info only
@@ -386,6 +390,9 @@ class LLViewerFetchedTexture : public LLViewerTexture
     BOOL getUseDiscard() const { return mUseMipMaps && !mDontDiscard; }
     //---------------
 
+    // Bytes of GL texture currently held, what LLTextureBudget counts
+    S64 getGLTextureBytes() const;
+
     void setForSculpt();
     BOOL forSculpt() const {return mForSculpt;}
     BOOL isForSculptOnly() const;
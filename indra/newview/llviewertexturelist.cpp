@@ -45,8 +45,10 @@
 #include "message.h"
 
 #include "lldrawpoolbump.h" // to init bumpmap images
+#include "lltexturebudget.h"
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
+#include "lltextureprefetch.h"
 #include "llviewercontrol.h"
 #include "llviewertexture.h"
 #include "llviewermedia.h"
@@ -805,6 +807,7 @@ void LLViewerTextureList::updateImages(F32 max_time)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
     static BOOL cleared = FALSE;
+    LLTexturePrefetch::getInstance()->update(gTeleportDisplay);
     if(gTeleportDisplay)
     {
         if(!cleared)
@@ -841,6 +844,8 @@ void LLViewerTextureList::updateImages(F32 max_time)
     //handle results from decode threads
     updateImagesCreateTextures(remaining_time);
 
+    LLTextureBudget::getInstance()->update();
+
     if (!mDirtyTextureList.empty())
     {
         gPipeline.dirtyPoolObjectTextures(mDirtyTextureList);
@@ -894,68 +899,43 @@ static void touch_texture(LLViewerFetchedTexture* tex, F32 vsize)
 
 extern BOOL gCubeSnapshot;
 
-void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imagep)
+void LLViewerTextureList::gatherFacePriorities(LLViewerFetchedTexture* imagep, U32 image_index)
 {
-    if (imagep->isInDebug() || imagep->isUnremovable())
-    {
-        //update_counter--;
-        return; //is in debug, ignore.
-    }
-
     llassert(!gCubeSnapshot);
 
-    static LLCachedControl<F32> bias_distance_scale(gSavedSettings, "TextureBiasDistanceScale", 1.f);
+    // Volume faces update their rows as their objects go through
+    // LLViewerObjectList::updateApparentAngles(), one of its 128 bins a
+    // frame, and when their pixel area is reset. The other faces only get
+    // refreshed here once their row is this old.
+    static const F32 MAX_FACE_INPUTS_AGE = 2.5f; // seconds
+    const F32 stale_time = gFrameTimeSeconds - MAX_FACE_INPUTS_AGE;
 
-    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE
+    for (U32 i = 0; i < LLRender::NUM_TEXTURE_CHANNELS; ++i)
     {
-        for (U32 i = 0; i < LLRender::NUM_TEXTURE_CHANNELS; ++i)
+        const std::vector<U32>& rows = imagep->getFaceRows(i);
+        const U32 count = llmin((U32)imagep->getNumFaces(i), (U32)rows.size());
+        if (count)
         {
-            for (U32 fi = 0; fi < imagep->getNumFaces(i); ++fi)
-            {
-                LLFace* face = (*(imagep->getFaceList(i)))[fi];
+            mFacePriorityTable.gather(rows.data(), count, image_index, stale_time, mFacePriorities, mStaleFaceRows);
+        }
+    }
 
-                if (face && face->getViewerObject() && face->getTextureEntry())
-                {
-                    F32 vsize = face->getPixelArea();
-
-                    // scale desired texture resolution higher or lower depending on texture scale
-                    const LLTextureEntry* te = face->getTextureEntry();
-                    F32 min_scale = te ? llmin(fabsf(te->getScaleS()), fabsf(te->getScaleT())) : 1.f;
-                    min_scale = llmax(min_scale*min_scale, 0.1f);
-
-                    vsize /= min_scale;
-
-                    vsize /= LLViewerTexture::sDesiredDiscardBias;
-                    vsize /= llmax(1.f, (LLViewerTexture::sDesiredDiscardBias-1.f) * (1.f + face->getDrawable()->mDistanceWRTCamera * bias_distance_scale));
-
-                    F32 radius;
-                    F32 cos_angle_to_view_dir;
-                    BOOL in_frustum = face->calcPixelArea(cos_angle_to_view_dir, radius);
-                    if (!in_frustum || !face->getDrawable()->isVisible())
-                    { // further reduce by discard bias when off screen or occluded
-                        vsize /= LLViewerTexture::sDesiredDiscardBias;
-                    }
-
-                    // if a GLTF material is present, ignore that face
-                    // as far as this texture stats go, but update the GLTF material
-                    // stats
-                    LLFetchedGLTFMaterial* mat = te ? (LLFetchedGLTFMaterial*)te->getGLTFRenderMaterial() : nullptr;
-                    llassert(mat == nullptr || dynamic_cast<LLFetchedGLTFMaterial*>(te->getGLTFRenderMaterial()) != nullptr);
-                    if (mat)
-                    {
-                        touch_texture(mat->mBaseColorTexture, vsize);
-                        touch_texture(mat->mNormalTexture, vsize);
-                        touch_texture(mat->mMetallicRoughnessTexture, vsize);
-                        touch_texture(mat->mEmissiveTexture, vsize);
-                    }
-                    else
-                    {
-                        imagep->addTextureStats(vsize);
-                    }
-                }
-            }
+    for (U32 row : mStaleFaceRows)
+    {
+        LLFace* face = mFacePriorityTable.getFace(row);
+        if (face)
+        {
+            face->refreshPriorityInputs();
+            // just refreshed, so never stale again
+            mFacePriorityTable.gather(&row, 1, image_index, -F32_MAX, mFacePriorities, mStaleFaceRows);
         }
     }
+    mStaleFaceRows.clear();
+}
+
+void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imagep)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
 
     //imagep->setDebugText(llformat("%.3f - %d", sqrtf(imagep->getMaxVirtualSize()), imagep->getBoostLevel()));
 
@@ -963,6 +943,17 @@ void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imag
     F32 max_inactive_time = 20.f; // actually delete
     S32 min_refs = 3; // 1 for mImageList, 1 for mUUIDMap, 1 for local reference
 
+    // Every texture that gets this far keeps its memory counted by the
+    // budget, whichever way it leaves. Textures too small on screen to
+    // matter count as not visible.
+    const F32 MIN_VISIBLE_VSIZE = 10.f;
+    auto update_budget = [imagep](S64 bytes, bool visible)
+    {
+        bool evictable = imagep->getType() == LLViewerTexture::LOD_TEXTURE && imagep->getUseDiscard() &&
+            imagep->getBoostLevel() < LLGLTexture::BOOST_SCULPTED;
+        LLTextureBudget::getInstance()->updateTexture(imagep, bytes, visible, evictable, LLFrameTimer::getElapsedSeconds());
+    };
+
     //
     // Flush formatted images using a lazy flush
     //
@@ -971,10 +962,15 @@ void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imag
     {
         if (imagep->getLastReferencedTimer()->getElapsedTimeF32() > lazy_flush_timeout)
         {
-            // Remove the unused image from the image list
+            // Remove the unused image from the image list, the budget
+            // forgets it when it is destroyed
             deleteImage(imagep);
             imagep = NULL; // should destroy the image
         }
+        else
+        {
+            update_budget(imagep->getGLTextureBytes(), false);
+        }
         return;
     }
     else
@@ -989,11 +985,13 @@ void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imag
 
         if (imagep->isDeleted())
         {
+            update_budget(imagep->getGLTextureBytes(), false);
             return;
         }
         else if (imagep->isDeletionCandidate())
         {
             imagep->destroyTexture();
+            update_budget(0, false);
             return;
         }
         else if (imagep->isInactive())
@@ -1002,6 +1000,7 @@ void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imag
             {
                 imagep->setDeletionCandidate();
             }
+            update_budget(imagep->getGLTextureBytes(), false);
             return;
         }
         else
@@ -1013,6 +1012,8 @@ void LLViewerTextureList::updateImageDecodePriority(LLViewerFetchedTexture* imag
         }
     }
 
+    update_budget(imagep->getGLTextureBytes(), imagep->getMaxVirtualSize() > MIN_VISIBLE_VSIZE);
+
     if (!imagep->isInImageList())
     {
         return;
@@ -1121,6 +1122,8 @@ F32 LLViewerTextureList::updateImagesFetchTextures(F32 max_time)
     typedef std::vector<LLPointer<LLViewerFetchedTexture> > entries_list_t;
     entries_list_t entries;
 
+    LLTimer timer;
+
     // update N textures at beginning of mImageList
     U32 update_count = 0;
     static const S32 MIN_UPDATE_COUNT = gSavedSettings.getS32("TextureFetchUpdateMinCount");       // default: 32
@@ -1150,29 +1153,128 @@ F32 LLViewerTextureList::updateImagesFetchTextures(F32 max_time)
         }
     }
 
-    LLTimer timer;
+    // Collect the face inputs of the batch first, then compute the virtual
+    // sizes in one pass over the table. Gathering gets half of the time and
+    // the batch is cut short where it runs out, the rest of it is left for
+    // the next update. At least one texture goes through so that the walk
+    // over mUUIDMap always moves on.
+    const F32 gather_time = max_time * 0.5f;
+    mFacePriorities.clear();
+    U32 gathered = 0;
+    for (; gathered < entries.size(); ++gathered)
+    {
+        if (gathered > 0 && timer.getElapsedTimeF32() > gather_time)
+        {
+            break;
+        }
+        LLViewerFetchedTexture* imagep = entries[gathered];
+        if (imagep->isInDebug() || imagep->isUnremovable())
+        {
+            continue; //is in debug, ignore.
+        }
+        gatherFacePriorities(imagep, gathered);
+    }
+    entries.resize(gathered);
+    {
+        LL_PROFILE_ZONE_NAMED_CATEGORY_TEXTURE("vtluift - compute");
+        static LLCachedControl<F32> bias_distance_scale(gSavedSettings, "TextureBiasDistanceScale", 1.f);
+        LLFacePriorityTable::computeVirtualSizes(mFacePriorities, LLViewerTexture::sDesiredDiscardBias, bias_distance_scale);
+    }
 
-    LLPointer<LLViewerTexture> last_imagep = nullptr;
+    {
+        LL_PROFILE_ZONE_NAMED_CATEGORY_TEXTURE("vtluift - stats");
+        const LLFacePriorityTable::Batch& batch = mFacePriorities;
+        for (size_t i = 0, count = batch.mVirtualSize.size(); i < count; ++i)
+        {
+            F32 vsize = batch.mVirtualSize[i];
+            if (batch.mMaterial[i])
+            {
+                // if a GLTF material is present, ignore that face as far as
+                // this texture stats go, but update the GLTF material stats
+                LLFace* face = mFacePriorityTable.getFace(batch.mRow[i]);
+                const LLTextureEntry* te = face && face->getViewerObject() ? face->getTextureEntry() : nullptr;
+                LLFetchedGLTFMaterial* mat = te ? (LLFetchedGLTFMaterial*)te->getGLTFRenderMaterial() : nullptr;
+                llassert(mat == nullptr || dynamic_cast<LLFetchedGLTFMaterial*>(te->getGLTFRenderMaterial()) != nullptr);
+                if (!mat)
+                {
+                    continue;
+                }
+                touch_texture(mat->mBaseColorTexture, vsize);
+                touch_texture(mat->mNormalTexture, vsize);
+                touch_texture(mat->mMetallicRoughnessTexture, vsize);
+                touch_texture(mat->mEmissiveTexture, vsize);
+            }
+            else
+            {
+                entries[batch.mImage[i]]->addTextureStats(vsize);
+            }
+        }
+    }
 
-    for (auto& imagep : entries)
+    // Book keeping, then fetch updates from the highest priority down so
+    // that running out of time only delays the least wanted textures
+    std::vector<std::pair<F32, U32> > fetch_order;
+    fetch_order.reserve(entries.size());
+    U32 updated = 0;
+    for (; updated < entries.size(); ++updated)
     {
-        if (imagep && imagep->getNumRefs() > 1) // make sure this image hasn't been deleted before attempting to update (may happen as a side effect of some other image updating)
+        if (updated > 0 && timer.getElapsedTimeF32() > max_time)
+        {
+            break;
+        }
+        const U32 i = updated;
+        LLViewerFetchedTexture* imagep = entries[i];
+        if (imagep->getNumRefs() > 1) // make sure this image hasn't been deleted before attempting to update (may happen as a side effect of some other image updating)
+        {
+            if (!imagep->isInDebug() && !imagep->isUnremovable())
+            {
+                updateImageDecodePriority(imagep);
+            }
+            F32 priority = imagep->getMaxVirtualSize();
+            if (imagep->getBoostLevel() >= LLGLTexture::BOOST_HIGH)
+            {
+                // Boosted textures go first whatever their size
+                priority += LLViewerFetchedTexture::sMaxVirtualSize;
+            }
+            fetch_order.emplace_back(priority, i);
+        }
+    }
+    std::stable_sort(fetch_order.begin(), fetch_order.end(),
+        [](const std::pair<F32, U32>& lhs, const std::pair<F32, U32>& rhs) { return lhs.first > rhs.first; });
 
+    // The next update resumes right before the first texture, in mUUIDMap
+    // order, that was left out by the time limit
+    U32 resume = updated;
+    for (size_t k = 0; k < fetch_order.size(); ++k)
+    {
+        LLViewerFetchedTexture* imagep = entries[fetch_order[k].second];
+        if (imagep->getNumRefs() > 1)
         {
-            updateImageDecodePriority(imagep);
             imagep->updateFetch();
         }
 
-        last_imagep = imagep;
-
         if (timer.getElapsedTimeF32() > max_time)
         {
+            for (size_t j = k + 1; j < fetch_order.size(); ++j)
+            {
+                resume = llmin(resume, fetch_order[j].second);
+            }
             break;
         }
     }
 
-    if (last_imagep)
+    if (resume == 0 && !entries.empty())
+    {
+        // Don't get stuck on a texture that never makes it to the front
+        if (entries[0]->getNumRefs() > 1)
+        {
+            entries[0]->updateFetch();
+        }
+        resume = 1;
+    }
+    if (resume > 0)
     {
+        LLViewerFetchedTexture* last_imagep = entries[resume - 1];
         mLastUpdateKey = LLTextureKey(last_imagep->getID(), (ETexListType)last_imagep->getTextureListType());
     }
 
@@ -31,9 +31,11 @@
 //#include "message.h"
 #include "llgl.h"
 #include "llviewertexture.h"
+#include "llfacepriorities.h"
 #include "llui.h"
 #include <list>
 #include <set>
+#include <vector>
 #include "lluiimage.h"
 
 const U32 LL_IMAGE_REZ_LOSSLESS_CUTOFF = 128;
@@ -47,6 +49,7 @@ const BOOL GL_TEXTURE_NO = FALSE;
 const BOOL IMMEDIATE_YES = TRUE;
 const BOOL IMMEDIATE_NO = FALSE;
 
+class LLFetchedGLTFMaterial;
 class LLImageJ2C;
 class LLMessageSystem;
 class LLTextureView;
@@ -149,6 +152,9 @@ class LLViewerTextureList
 
     S32 getNumImages()                  { return mImageList.size(); }
 
+    // Rows of the faces, written by them as they update
+    LLFacePriorityTable& getFacePriorityTable() { return mFacePriorityTable; }
+
     // Local UI images
     // Local UI images
     void doPreloadImages();
@@ -159,11 +165,13 @@ class LLViewerTextureList
     void setDebugFetching(LLViewerFetchedTexture* tex, S32 debug_level);
 
 private:
-    // do some book keeping on the specified texture
-    // - updates decode priority
+    // do some book keeping on the specified texture, once its face stats
+    // for this update have been added
     // - updates desired discard level
     // - cleans up textures that haven't been referenced in awhile
     void updateImageDecodePriority(LLViewerFetchedTexture* imagep);
+    // add the inputs of each face using the texture to mFacePriorities
+    void gatherFacePriorities(LLViewerFetchedTexture* imagep, U32 image_index);
     F32  updateImagesCreateTextures(F32 max_time);
     F32  updateImagesFetchTextures(F32 max_time);
     void updateImagesUpdateStats();
@@ -240,6 +248,11 @@ class LLViewerTextureList
     typedef std::set < LLPointer<LLViewerFetchedTexture> > image_priority_list_t;
     image_priority_list_t mImageList;
 
+    LLFacePriorityTable mFacePriorityTable;
+    // inputs of the faces of the textures updated this frame
+    LLFacePriorityTable::Batch mFacePriorities;
+    std::vector<U32> mStaleFaceRows;
+
     // simply holds on to LLViewerFetchedTexture references to stop them from being purged too soon
     std::set<LLPointer<LLViewerFetchedTexture> > mImagePreloads;
 
@@ -84,6 +84,7 @@
 #include "llmediaentry.h"
 #include "llurldispatcher.h"
 #include "raytrace.h"
+#include "workqueue.h"
 
 // newview includes
 #include "llagent.h"
@@ -5035,7 +5036,7 @@ BOOL LLViewerWindow::mousePointOnLandGlobal(const S32 x, const S32 y, LLVector3d
 }
 
 // Saves an image to the harddrive as "SnapshotX" where X >= 1.
-void LLViewerWindow::saveImageNumbered(LLImageFormatted *image, BOOL force_picker, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb)
+void LLViewerWindow::saveImageNumbered(LLImageFormatted *image, BOOL force_picker, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb, LLImageRaw *raw)
 {
     if (!image)
     {
@@ -5068,23 +5069,25 @@ void LLViewerWindow::saveImageNumbered(LLImageFormatted *image, BOOL force_picke
         else
             pick_type = LLFilePicker::FFSAVE_ALL;
 
-        LLFilePickerReplyThread::startPicker(boost::bind(&LLViewerWindow::onDirectorySelected, this, _1, formatted_image, success_cb, failure_cb), pick_type, proposed_name,
+        // The raw image is only kept alive by the caller until it returns
+        LLPointer<LLImageRaw> raw_image = raw;
+        LLFilePickerReplyThread::startPicker(boost::bind(&LLViewerWindow::onDirectorySelected, this, _1, formatted_image, raw_image, success_cb, failure_cb), pick_type, proposed_name,
                                         boost::bind(&LLViewerWindow::onSelectionFailure, this, failure_cb));
     }
     else
     {
-        saveImageLocal(formatted_image, success_cb, failure_cb);
+        saveImageLocal(formatted_image, raw, success_cb, failure_cb);
     }
 }
 
-void LLViewerWindow::onDirectorySelected(const std::vector<std::string>& filenames, LLImageFormatted *image, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb)
+void LLViewerWindow::onDirectorySelected(const std::vector<std::string>& filenames, LLImageFormatted *image, LLImageRaw *raw, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb)
 {
     // Copy the directory + file name
     std::string filepath = filenames[0];
 
     gSavedPerAccountSettings.setString("SnapshotBaseName", gDirUtilp->getBaseFileName(filepath, true));
     gSavedPerAccountSettings.setString("SnapshotBaseDir", gDirUtilp->getDirName(filepath));
-    saveImageLocal(image, success_cb, failure_cb);
+    saveImageLocal(image, raw, success_cb, failure_cb);
 }
 
 void LLViewerWindow::onSelectionFailure(const snapshot_saved_signal_t::slot_type& failure_cb)
@@ -5093,7 +5096,11 @@ void LLViewerWindow::onSelectionFailure(const snapshot_saved_signal_t::slot_type
 }
 
 
-void LLViewerWindow::saveImageLocal(LLImageFormatted *image, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb)
+// Snapshots being written on a worker. Their files may not exist yet, the
+// search for an unused name has to skip them all the same.
+static std::multiset<std::string> sSnapshotsInFlight;
+
+void LLViewerWindow::saveImageLocal(LLImageFormatted *image, LLImageRaw *raw, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb)
 {
     std::string lastSnapshotDir = LLViewerWindow::getLastSnapshotDir();
     if (lastSnapshotDir.empty())
@@ -5130,13 +5137,15 @@ void LLViewerWindow::saveImageLocal(LLImageFormatted *image, const snapshot_save
         failure_cb();
         return;
     }
-    if (b_space.free < image->getDataSize())
+    // Not encoded yet, the raw size is an upper bound
+    const S32 needed_size = raw ? raw->getDataSize() : image->getDataSize();
+    if (b_space.free < needed_size)
     {
         LLSD args;
         args["PATH"] = lastSnapshotDir;
 
         std::string needM_bytes_string;
-        LLResMgr::getIntegerString(needM_bytes_string, (image->getDataSize()) >> 10);
+        LLResMgr::getIntegerString(needM_bytes_string, needed_size >> 10);
         args["NEED_MEMORY"] = needM_bytes_string;
 
         std::string freeM_bytes_string;
@@ -5172,20 +5181,61 @@ void LLViewerWindow::saveImageLocal(LLImageFormatted *image, const snapshot_save
 
         llstat stat_info;
         err = LLFile::stat( filepath, &stat_info );
+        if (sSnapshotsInFlight.count(filepath))
+        {
+            err = 0;
+        }
         i++;
     }
     while( -1 != err  // Search until the file is not found (i.e., stat() gives an error).
             && is_snapshot_name_loc_set); // Or stop if we are rewriting.
+    sSnapshotsInFlight.insert(filepath);
 
     LL_INFOS() << "Saving snapshot to " << filepath << LL_ENDL;
-    if (image->save(filepath))
+    LLPointer<LLImageFormatted> formatted_image = image;
+    LLPointer<LLImageRaw> raw_image = raw;
+    auto save = [formatted_image, raw_image, filepath]()
     {
-        playSnapshotAnimAndSound();
-        success_cb();
-    }
-    else
+        LL_PROFILE_ZONE_NAMED("saveImageLocal - save");
+        if (raw_image)
+        {
+            formatted_image->enableOverSize();
+            bool encoded = formatted_image->encode(raw_image, 0);
+            formatted_image->disableOverSize();
+            if (!encoded)
+            {
+                LL_WARNS() << "Failed to encode snapshot: " << LLImage::getLastThreadError() << LL_ENDL;
+                return false;
+            }
+        }
+        return formatted_image->save(filepath);
+    };
+    snapshot_saved_signal_t::slot_type on_success = success_cb;
+    snapshot_saved_signal_t::slot_type on_failure = failure_cb;
+    auto done = [on_success, on_failure, filepath](bool saved) mutable
     {
-        failure_cb();
+        sSnapshotsInFlight.erase(sSnapshotsInFlight.find(filepath));
+        if (saved)
+        {
+            if (gViewerWindow)
+            {
+                gViewerWindow->playSnapshotAnimAndSound();
+            }
+            on_success();
+        }
+        else
+        {
+            on_failure();
+        }
+    };
+
+    // Encoding a large snapshot and writing it out take long enough to
+    // stall the frame, do both on a snapshot worker
+    LL::WorkQueue::ptr_t main_queue = LL::WorkQueue::getInstance("mainloop");
+    LL::WorkQueue::ptr_t snapshot_queue = LL::WorkQueue::getInstance("Snapshot");
+    if (!main_queue || !snapshot_queue || !main_queue->postTo(snapshot_queue, save, done))
+    {
+        done(save());
     }
 }
 
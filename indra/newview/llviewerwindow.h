@@ -396,9 +396,11 @@ class LLViewerWindow final : public LLWindowCallbacks
 
     typedef boost::signals2::signal<void(void)> snapshot_saved_signal_t;
 
-    void            saveImageNumbered(LLImageFormatted *image, BOOL force_picker, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb);
-    void            onDirectorySelected(const std::vector<std::string>& filenames, LLImageFormatted *image, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb);
-    void            saveImageLocal(LLImageFormatted *image, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb);
+    // When raw is given, image is still to be encoded from it. Encoding and
+    // writing are done on a worker, the callbacks come back on the main thread.
+    void            saveImageNumbered(LLImageFormatted *image, BOOL force_picker, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb, LLImageRaw *raw = NULL);
+    void            onDirectorySelected(const std::vector<std::string>& filenames, LLImageFormatted *image, LLImageRaw *raw, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb);
+    void            saveImageLocal(LLImageFormatted *image, LLImageRaw *raw, const snapshot_saved_signal_t::slot_type& success_cb, const snapshot_saved_signal_t::slot_type& failure_cb);
     void            onSelectionFailure(const snapshot_saved_signal_t::slot_type& failure_cb);
 
     // Reset the directory where snapshots are saved.
@@ -33,6 +33,8 @@
 #include "llviewerregion.h"
 #include "llagentcamera.h"
 #include "llsdserialize.h"
+#include "llmemorystream.h"
+#include "threadpool.h"
 #include "llworld.h" // For LLWorld::getInstance()
 //static variables
 U32 LLVOCacheEntry::sMinFrameRange = 0;
@@ -42,19 +44,8 @@ F32 LLVOCacheEntry::sFrontPixelThreshold = 1.0f;
 F32 LLVOCacheEntry::sRearPixelThreshold = 1.0f;
 BOOL LLVOCachePartition::sNeedsOcclusionCheck = FALSE;
 
-const S32 ENTRY_HEADER_SIZE = 6 * sizeof(S32);
 const S32 MAX_ENTRY_BODY_SIZE = 10000;
 
-BOOL check_read(LLAPRFile* apr_file, void* src, S32 n_bytes)
-{
-    return apr_file->read(src, n_bytes) == n_bytes ;
-}
-
-BOOL check_write(LLAPRFile* apr_file, void* src, S32 n_bytes)
-{
-    return apr_file->write(src, n_bytes) == n_bytes ;
-}
-
 // Material Override Cache needs a version label, so we can upgrade this later.
 const std::string LLGLTFOverrideCacheEntry::VERSION_LABEL = {"GLTFCacheVer"};
 const int LLGLTFOverrideCacheEntry::VERSION = 1;
@@ -192,76 +183,57 @@ LLVOCacheEntry::LLVOCacheEntry()
     mDP.assignBuffer(mBuffer, 0);
 }
 
-LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
+LLVOCacheEntry::LLVOCacheEntry(const LLVOCacheStore::ObjectRecord& record)
 :   LLViewerOctreeEntryData(LLViewerOctreeEntry::LLVOCACHEENTRY),
-    mBuffer(NULL),
+    mLocalID(record.mLocalID),
+    mCRC(record.mCRC),
     mUpdateFlags(-1),
+    mHitCount(record.mHitCount),
+    mDupeCount(record.mDupeCount),
+    mCRCChangeCount(record.mCRCChangeCount),
+    mBuffer(NULL),
     mState(INACTIVE),
     mSceneContrib(0.f),
     mValid(FALSE),
     mParentID(0),
     mBSphereRadius(-1.0f)
 {
-    S32 size = -1;
-    BOOL success;
-    static U8 data_buffer[ENTRY_HEADER_SIZE];
-
     mDP.assignBuffer(mBuffer, 0);
 
-    success = check_read(apr_file, (void *)data_buffer, ENTRY_HEADER_SIZE);
-    if (success)
-    {
-        memcpy(&mLocalID, data_buffer, sizeof(U32));
-        memcpy(&mCRC, data_buffer + sizeof(U32), sizeof(U32));
-        memcpy(&mHitCount, data_buffer + (2 * sizeof(U32)), sizeof(S32));
-        memcpy(&mDupeCount, data_buffer + (3 * sizeof(U32)), sizeof(S32));
-        memcpy(&mCRCChangeCount, data_buffer + (4 * sizeof(U32)), sizeof(S32));
-        memcpy(&size, data_buffer + (5 * sizeof(U32)), sizeof(S32));
-
-        // Corruption in the cache entries
-        if ((size > MAX_ENTRY_BODY_SIZE) || (size < 1))
-        {
-            // We've got a bogus size, skip reading it.
-            // We won't bother seeking, because the rest of this file
-            // is likely bogus, and will be tossed anyway.
-            LL_WARNS() << "Bogus cache entry, size " << size << ", aborting!" << LL_ENDL;
-            success = FALSE;
-        }
-    }
-    if(success && size > 0)
-    {
-        mBuffer = new U8[size];
-        success = check_read(apr_file, mBuffer, size);
-
-        if(success)
-        {
-            mDP.assignBuffer(mBuffer, size);
-        }
-        else
-        {
-            // Improve logging around vocache
-            LL_WARNS() << "Error loading cache entry for " << mLocalID << ", size " << size << " aborting!" << LL_ENDL;
-            delete[] mBuffer ;
-            mBuffer = NULL ;
-        }
-    }
-
-    if(!success)
+    // Corruption in the cache entries
+    if (record.mSize < 1 || record.mSize > (U32)MAX_ENTRY_BODY_SIZE || !record.mData || !record.mDataRef)
     {
+        LL_WARNS() << "Bogus cache entry, size " << record.mSize << ", aborting!" << LL_ENDL;
         mLocalID = 0;
         mCRC = 0;
         mHitCount = 0;
         mDupeCount = 0;
         mCRCChangeCount = 0;
-        mBuffer = NULL;
-        mEntry = NULL;
-        mState = INACTIVE;
+        return;
     }
+
+    // Read in place, the store keeps the data as it is while referenced
+    mStoreData = record.mDataRef;
+    mDP.assignBuffer(const_cast<U8*>(record.mData), record.mSize);
 }
 
 LLVOCacheEntry::~LLVOCacheEntry()
 {
-    mDP.freeBuffer();
+    freeBuffer();
+}
+
+void LLVOCacheEntry::freeBuffer()
+{
+    if (mStoreData)
+    {
+        mDP.detachBuffer();
+        mStoreData.reset();
+    }
+    else
+    {
+        mDP.freeBuffer();
+    }
+    mBuffer = NULL;
 }
 
 void LLVOCacheEntry::updateEntry(U32 crc, LLDataPackerBinaryBuffer &dp)
@@ -272,7 +244,7 @@ void LLVOCacheEntry::updateEntry(U32 crc, LLDataPackerBinaryBuffer &dp)
         mCRCChangeCount++;
     }
 
-    mDP.freeBuffer();
+    freeBuffer();
 
     llassert_always(dp.getBufferSize() > 0);
     mBuffer = new U8[dp.getBufferSize()];
@@ -414,6 +386,24 @@ LLDataPackerBinaryBuffer *LLVOCacheEntry::getDP() const
     return &mDP;
 }
 
+LLVOCacheStore::data_ref_t LLVOCacheEntry::shareData(S32& size) const
+{
+    size = mDP.getBufferSize();
+    if (size <= 0)
+    {
+        return nullptr;
+    }
+    if (mStoreData)
+    {
+        return mStoreData;
+    }
+
+    // the entry's own buffer goes away with it, copy it
+    U8* copy = new U8[size];
+    memcpy(copy, mDP.getBuffer(), size);
+    return LLVOCacheStore::data_ref_t(copy, std::default_delete<U8[]>());
+}
+
 void LLVOCacheEntry::recordHit()
 {
     mHitCount++;
@@ -430,25 +420,25 @@ void LLVOCacheEntry::dump() const
         << LL_ENDL;
 }
 
-S32 LLVOCacheEntry::writeToBuffer(U8 *data_buffer) const
+bool LLVOCacheEntry::getObjectRecord(LLVOCacheStore::ObjectRecord& record) const
 {
     S32 size = mDP.getBufferSize();
 
     if (size > MAX_ENTRY_BODY_SIZE)
     {
         LL_WARNS() << "Failed to write entry with size above allowed limit: " << size << LL_ENDL;
-        return 0;
+        return false;
     }
 
-    memcpy(data_buffer, &mLocalID, sizeof(U32));
-    memcpy(data_buffer + sizeof(U32), &mCRC, sizeof(U32));
-    memcpy(data_buffer + (2 * sizeof(U32)), &mHitCount, sizeof(S32));
-    memcpy(data_buffer + (3 * sizeof(U32)), &mDupeCount, sizeof(S32));
-    memcpy(data_buffer + (4 * sizeof(U32)), &mCRCChangeCount, sizeof(S32));
-    memcpy(data_buffer + (5 * sizeof(U32)), &size, sizeof(S32));
-    memcpy(data_buffer + ENTRY_HEADER_SIZE, (void*)mBuffer, size);
+    record.mLocalID = mLocalID;
+    record.mCRC = mCRC;
+    record.mHitCount = mHitCount;
+    record.mDupeCount = mDupeCount;
+    record.mCRCChangeCount = mCRCChangeCount;
+    record.mData = mDP.getBuffer();
+    record.mSize = size;
 
-    return ENTRY_HEADER_SIZE + size;
+    return size > 0;
 }
 
 #ifndef LL_TEST
@@ -1126,43 +1116,55 @@ void LLVOCachePartition::removeOccluder(LLVOCacheGroup* group)
 //-------------------------------------------------------------------
 //LLVOCache
 //-------------------------------------------------------------------
-// Format strings used to construct filename for the object cache
-static const char OBJECT_CACHE_FILENAME[] = "objects_%d_%d.slc";
-static const char OBJECT_CACHE_EXTRAS_FILENAME[] = "objects_%d_%d_extras.slec";
+static const char OBJECT_CACHE_STORE_FILENAME[] = "objects.store";
+
+// Files of the per-region cache format the store replaced
+static const char LEGACY_HEADER_FILENAME[] = "object.cache";
+static const char LEGACY_OBJECT_CACHE_MASK[] = "objects_*.slc";
+static const char LEGACY_OBJECT_CACHE_EXTRAS_MASK[] = "objects_*_extras.slec";
 
 const U32 MAX_NUM_OBJECT_ENTRIES = 128 ;
 const U32 MIN_ENTRIES_TO_PURGE = 16 ;
-const U32 INVALID_TIME = 0 ;
 const char* object_cache_dirname = "objectcache";
-const char* header_filename = "object.cache";
+
+// Region snapshots waiting for the write-back thread. Past this the main
+// thread waits, which bounds the memory held by snapshots.
+const U32 MAX_PENDING_WRITES = 8 ;
+
+// Immutable copy of the entries of a region, owned by the queued write and
+// by the entries read from it before the write is done.
+struct LLVOCache::ObjectSnapshot
+{
+    std::vector<U8> mData;
+    LLVOCacheStore::object_list_t mObjects;
+};
 
 
 LLVOCache::LLVOCache(bool read_only) :
     mInitialized(false),
     mReadOnly(read_only),
-    mNumEntries(0),
+    mCacheVersion(0),
     mCacheSize(1),
     mEnabled(true)
 {
 #ifndef LL_TEST
     mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
 #endif
-    mLocalAPRFilePoolp = new LLVolatileAPRPool("VOCache Pool") ;
 }
 
 LLVOCache::~LLVOCache()
 {
+    // Whatever is still queued gets written before the store closes.
+    stopWriteThread();
     if(mEnabled)
     {
-        writeCacheHeader();
-        clearCacheInMemory();
+        mStore.close();
     }
-    delete mLocalAPRFilePoolp;
 }
 
 void LLVOCache::setDirNames(ELLPath location)
 {
-    mHeaderFileName = gDirUtilp->getExpandedFilename(location, object_cache_dirname, header_filename);
+    mStoreFileName = gDirUtilp->getExpandedFilename(location, object_cache_dirname, OBJECT_CACHE_STORE_FILENAME);
     mObjectCacheDirName = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
 }
 
@@ -1185,331 +1187,247 @@ void LLVOCache::initCache(ELLPath location, U32 size, U32 cache_version)
     if (!mReadOnly)
     {
         LLFile::mkdir(mObjectCacheDirName);
+        removeLegacyCacheFiles();
     }
     mCacheSize = llclamp(size, MIN_ENTRIES_TO_PURGE, MAX_NUM_OBJECT_ENTRIES);
-    mMetaInfo.mVersion = cache_version;
+    mCacheVersion = cache_version;
 
 #if defined(ADDRESS_SIZE)
     U32 expected_address = ADDRESS_SIZE;
 #else
     U32 expected_address = 32;
 #endif
-    mMetaInfo.mAddressSize = expected_address;
-
-    readCacheHeader();
 
-    LL_INFOS() << "Viewer Object Cache Versions - expected: " << cache_version << " found: " << mMetaInfo.mVersion <<  LL_ENDL;
+    LL_INFOS() << "Viewer Object Cache Version: " << cache_version << LL_ENDL;
 
-    if( mMetaInfo.mVersion != cache_version
-        || mMetaInfo.mAddressSize != expected_address)
+    // A store written by another cache version is emptied on open.
+    if (!mStore.open(mStoreFileName, cache_version, expected_address, mReadOnly))
     {
-        mMetaInfo.mVersion = cache_version ;
-        mMetaInfo.mAddressSize = expected_address;
-        if(mReadOnly) //disable cache
+        if (!mReadOnly)
         {
-            clearCacheInMemory();
+            LL_WARNS() << "Unable to open object cache store " << mStoreFileName << ", disabling writes" << LL_ENDL;
+            mReadOnly = true;
         }
-        else //delete the current cache if the format does not match.
-        {
-            LL_INFOS() << "Viewer Object Cache Versions unmatched.  clearing cache." <<  LL_ENDL;
-            removeCache();
-        }
-    }
-}
-
-void LLVOCache::removeCache(ELLPath location, bool started)
-{
-    if(started)
-    {
-        removeCache();
         return;
     }
 
-    if(mReadOnly)
+    if (!mReadOnly && mStore.getRegionCount() >= mCacheSize)
     {
-        LL_WARNS() << "Not removing cache at " << location << ": Cache is currently in read-only mode." << LL_ENDL;
-        return ;
+        purgeEntries(mCacheSize);
     }
 
-    LL_INFOS() << "about to remove the object cache due to settings." << LL_ENDL ;
-
-    std::string mask = "*";
-    std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
-    LL_INFOS() << "Removing cache at " << cache_dir << LL_ENDL;
-    gDirUtilp->deleteFilesInDir(cache_dir, mask); //delete all files
-    LLFile::rmdir(cache_dir);
-
-    clearCacheInMemory();
-    mInitialized = false;
-}
-
-void LLVOCache::removeCache()
-{
-    if(!mInitialized)
-    {
-        //OK to remove cache even it is not initialized.
-        LL_WARNS() << "Object cache is not initialized yet." << LL_ENDL;
-    }
-
-    if(mReadOnly)
+    bool write_back = true;
+#ifndef LL_TEST
+    write_back = gSavedSettings.getBOOL("ObjectCacheWriteBack");
+#endif
+    if (!mReadOnly && write_back)
     {
-        LL_WARNS() << "Not clearing object cache: Cache is currently in read-only mode." << LL_ENDL;
-        return ;
+        mWriteThread = std::make_unique<LL::ThreadPool>("VOCacheWrite", 1, 1024, false);
+        mWriteThread->start();
     }
-
-    std::string mask = "*";
-    LL_INFOS() << "Removing object cache at " << mObjectCacheDirName << LL_ENDL;
-    gDirUtilp->deleteFilesInDir(mObjectCacheDirName, mask);
-
-    clearCacheInMemory() ;
-    writeCacheHeader();
 }
 
-void LLVOCache::removeEntry(HeaderEntryInfo* entry)
+void LLVOCache::queueWrite(U64 handle, const std::function<void()>& write, const pending_func_t& pending_func)
 {
-    llassert_always(mInitialized);
-    if(mReadOnly)
+    if (!mWriteThread)
     {
+        write();
         return;
     }
-    if(!entry)
+
+    mPendingWrites.wait([](const PendingWrites& pending) { return pending.mCount < MAX_PENDING_WRITES; });
+    mPendingWrites.update_all([handle, &pending_func](PendingWrites& pending)
     {
-        return;
-    }
-    // Bit more tracking of cache creation/destruction.
-    std::string filename;
-    getObjectCacheFilename(entry->mHandle, filename);
-    LL_INFOS() << "Removing entry for region with filename" << filename << LL_ENDL;
+        ++pending.mCount;
+        PendingRegion& region = pending.mRegions[handle];
+        ++region.mCount;
+        if (pending_func)
+        {
+            pending_func(region);
+        }
+    });
 
-    // make sure corresponding LLViewerRegion also clears its in-memory cache
-    LLViewerRegion* regionp = LLWorld::instance().getRegionFromHandle(entry->mHandle);
-    if (regionp)
+    bool posted = mWriteThread->getQueue().post([this, handle, write]()
     {
-        regionp->clearVOCacheFromMemory();
+        write();
+        finishWrite(handle);
+    });
+    if (!posted)
+    {
+        // the thread is shutting down
+        write();
+        finishWrite(handle);
     }
+}
 
-    header_entry_queue_t::iterator iter = mHeaderEntryQueue.find(entry);
-    if(iter != mHeaderEntryQueue.end())
+void LLVOCache::finishWrite(U64 handle)
+{
+    mPendingWrites.update_all([handle](PendingWrites& pending)
     {
-        mHandleEntryMap.erase(entry->mHandle);
-        mHeaderEntryQueue.erase(iter);
-        removeFromCache(entry);
-        delete entry;
-
-        mNumEntries = mHandleEntryMap.size() ;
-    }
+        --pending.mCount;
+        auto iter = pending.mRegions.find(handle);
+        if (iter != pending.mRegions.end() && --iter->second.mCount == 0)
+        {
+            pending.mRegions.erase(iter);
+        }
+    });
 }
 
-void LLVOCache::removeEntry(U64 handle)
+bool LLVOCache::getPendingRegion(U64 handle, PendingRegion& region)
 {
-    handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
-    if(iter == mHandleEntryMap.end()) //no cache
+    if (!mWriteThread)
     {
-        return ;
+        return false;
     }
-    HeaderEntryInfo* entry = iter->second ;
-    removeEntry(entry) ;
+    return mPendingWrites.get([handle, &region](const PendingWrites& pending)
+    {
+        auto iter = pending.mRegions.find(handle);
+        if (iter == pending.mRegions.end())
+        {
+            return false;
+        }
+        region = iter->second;
+        return true;
+    });
 }
 
-void LLVOCache::clearCacheInMemory()
+bool LLVOCache::hasRegion(U64 handle)
 {
-    if(!mHeaderEntryQueue.empty())
+    PendingRegion pending;
+    if (getPendingRegion(handle, pending))
     {
-        for(header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin(); iter != mHeaderEntryQueue.end(); ++iter)
+        if (pending.mRemoved)
         {
-            delete *iter ;
+            return false;
+        }
+        if (pending.mObjects)
+        {
+            return true;
         }
-        mHeaderEntryQueue.clear();
-        mHandleEntryMap.clear();
-        mNumEntries = 0 ;
     }
-
+    return mStore.hasRegion(handle);
 }
 
-void LLVOCache::getObjectCacheFilename(U64 handle, std::string& filename)
+void LLVOCache::flushWrites()
 {
-    U32 region_x, region_y;
-
-    grid_from_region_handle(handle, &region_x, &region_y);
-    filename = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, object_cache_dirname,
-               llformat(OBJECT_CACHE_FILENAME, region_x, region_y));
-
-    return ;
+    if (mWriteThread)
+    {
+        mPendingWrites.wait([](const PendingWrites& pending) { return pending.mCount == 0; });
+    }
 }
 
-std::string LLVOCache::getObjectCacheExtrasFilename(U64 handle)
+void LLVOCache::stopWriteThread()
 {
-    U32 region_x, region_y;
-
-    grid_from_region_handle(handle, &region_x, &region_y);
-    return gDirUtilp->getExpandedFilename(LL_PATH_CACHE, object_cache_dirname,
-               llformat(OBJECT_CACHE_EXTRAS_FILENAME, region_x, region_y));
+    if (mWriteThread)
+    {
+        // close() lets the thread drain the queue before joining it
+        mWriteThread->close();
+        mWriteThread.reset();
+    }
 }
 
-void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
+void LLVOCache::removeLegacyCacheFiles()
 {
-    if(mReadOnly)
+    std::string header_filename = gDirUtilp->add(mObjectCacheDirName, LEGACY_HEADER_FILENAME);
+    if (LLFile::isfile(header_filename))
     {
-        LL_WARNS() << "Not removing cache for handle " << entry->mHandle << ": Cache is currently in read-only mode." << LL_ENDL;
-        return ;
+        LL_INFOS() << "Removing per-region object cache files from " << mObjectCacheDirName << LL_ENDL;
+        gDirUtilp->deleteFilesInDir(mObjectCacheDirName, LEGACY_OBJECT_CACHE_MASK);
+        gDirUtilp->deleteFilesInDir(mObjectCacheDirName, LEGACY_OBJECT_CACHE_EXTRAS_MASK);
+        LLFile::remove(header_filename);
     }
-
-    std::string filename;
-    getObjectCacheFilename(entry->mHandle, filename);
-    LL_WARNS("GLTF", "VOCache") << "Removing object cache for handle " << entry->mHandle << "Filename: " << filename << LL_ENDL;
-    LLAPRFile::remove(filename, mLocalAPRFilePoolp);
-
-    // Note: `removeFromCache` should take responsibility for cleaning up all cache artefacts specfic to the handle/entry.
-    // as such this now includes the generic extras
-    filename = getObjectCacheExtrasFilename(entry->mHandle);
-    LL_WARNS("GLTF", "VOCache") << "Removing generic extras for handle " << entry->mHandle << "Filename: " << filename << LL_ENDL;
-    LLFile::remove(filename);
-
-    entry->mTime = INVALID_TIME ;
-    updateEntry(entry) ; //update the head file.
 }
 
-void LLVOCache::readCacheHeader()
+void LLVOCache::removeCache(ELLPath location, bool started)
 {
-    if(!mEnabled)
+    if(started)
     {
-        LL_WARNS() << "Not reading cache header: Cache is currently disabled." << LL_ENDL;
+        removeCache();
         return;
     }
 
-    //clear stale info.
-    clearCacheInMemory();
-
-    bool success = true ;
-    if (LLAPRFile::isExist(mHeaderFileName, mLocalAPRFilePoolp))
+    if(mReadOnly)
     {
-        LLAPRFile apr_file(mHeaderFileName, APR_READ|APR_BINARY, mLocalAPRFilePoolp);
+        LL_WARNS() << "Not removing cache at " << location << ": Cache is currently in read-only mode." << LL_ENDL;
+        return ;
+    }
 
-        //read the meta element
-        success = check_read(&apr_file, &mMetaInfo, sizeof(HeaderMetaInfo)) ;
+    LL_INFOS() << "about to remove the object cache due to settings." << LL_ENDL ;
 
-        if(success)
-        {
-            HeaderEntryInfo* entry = NULL ;
-            mNumEntries = 0 ;
-            U32 num_read = 0 ;
-            while(num_read++ < MAX_NUM_OBJECT_ENTRIES)
-            {
-                if(!entry)
-                {
-                    entry = new HeaderEntryInfo() ;
-                }
-                success = check_read(&apr_file, entry, sizeof(HeaderEntryInfo));
-
-                if(!success) //failed
-                {
-                    LL_WARNS() << "Error reading cache header entry. (entry_index=" << mNumEntries << ")" << LL_ENDL;
-                    delete entry ;
-                    entry = NULL ;
-                    break ;
-                }
-                else if(entry->mTime == INVALID_TIME)
-                {
-                    continue ; //an empty entry
-                }
-
-                entry->mIndex = mNumEntries++ ;
-                mHeaderEntryQueue.insert(entry) ;
-                mHandleEntryMap[entry->mHandle] = entry ;
-                entry = NULL ;
-            }
-            if(entry)
-            {
-                delete entry ;
-            }
-        }
+    stopWriteThread();
+    mStore.close();
 
-        //---------
-        //debug code
-        //----------
-        //std::string name ;
-        //for(header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin() ; success && iter != mHeaderEntryQueue.end(); ++iter)
-        //{
-        //  getObjectCacheFilename((*iter)->mHandle, name) ;
-        //  LL_INFOS() << name << LL_ENDL ;
-        //}
-        //-----------
-    }
-    else
-    {
-        writeCacheHeader() ;
-    }
+    std::string mask = "*";
+    std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
+    LL_INFOS() << "Removing cache at " << cache_dir << LL_ENDL;
+    gDirUtilp->deleteFilesInDir(cache_dir, mask); //delete all files
+    LLFile::rmdir(cache_dir);
 
-    if(!success)
+    mInitialized = false;
+}
+
+void LLVOCache::removeCache()
+{
+    if(!mInitialized)
     {
-        removeCache() ; //failed to read header, clear the cache
+        //OK to remove cache even it is not initialized.
+        LL_WARNS() << "Object cache is not initialized yet." << LL_ENDL;
     }
-    else if(mNumEntries >= mCacheSize)
+
+    if(mReadOnly)
     {
-        purgeEntries(mCacheSize) ;
+        LL_WARNS() << "Not clearing object cache: Cache is currently in read-only mode." << LL_ENDL;
+        return ;
     }
 
-    return ;
+    LL_INFOS() << "Removing object cache at " << mObjectCacheDirName << LL_ENDL;
+    flushWrites();
+    mStore.clear();
 }
 
-void LLVOCache::writeCacheHeader()
+void LLVOCache::removeEntry(U64 handle)
 {
-    if (!mEnabled)
+    if(mReadOnly || !hasRegion(handle)) //no cache
     {
-        LL_WARNS() << "Not writing cache header: Cache is currently disabled." << LL_ENDL;
         return;
     }
+    llassert_always(mInitialized);
 
-    if(mReadOnly)
-    {
-        LL_WARNS() << "Not writing cache header: Cache is currently in read-only mode." << LL_ENDL;
-        return;
-    }
+    // Bit more tracking of cache creation/destruction.
+    LL_INFOS() << "Removing entry for region with handle " << handle << LL_ENDL;
 
-    bool success = true ;
+    // make sure corresponding LLViewerRegion also clears its in-memory cache
+    LLViewerRegion* regionp = LLWorld::instance().getRegionFromHandle(handle);
+    if (regionp)
     {
-        LLAPRFile apr_file(mHeaderFileName, APR_FOPEN_CREATE|APR_FOPEN_WRITE|APR_FOPEN_BINARY|APR_FOPEN_TRUNCATE, mLocalAPRFilePoolp);
-
-        //write the meta element
-        success = check_write(&apr_file, &mMetaInfo, sizeof(HeaderMetaInfo)) ;
-
-
-        mNumEntries = 0 ;
-        for(header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin() ; success && iter != mHeaderEntryQueue.end(); ++iter)
-        {
-            (*iter)->mIndex = mNumEntries++ ;
-            success = check_write(&apr_file, (void*)*iter, sizeof(HeaderEntryInfo));
-        }
-
-        mNumEntries = mHeaderEntryQueue.size() ;
-        if(success && mNumEntries < MAX_NUM_OBJECT_ENTRIES)
-        {
-            HeaderEntryInfo* entry = new HeaderEntryInfo() ;
-            entry->mTime = INVALID_TIME ;
-            for(S32 i = mNumEntries ; success && i < MAX_NUM_OBJECT_ENTRIES ; i++)
-            {
-                //fill the cache with the default entry.
-                success = check_write(&apr_file, entry, sizeof(HeaderEntryInfo)) ;
-
-            }
-            delete entry ;
-        }
+        regionp->clearVOCacheFromMemory();
     }
 
-    if(!success)
+    // Queued behind the writes of the region so they don't bring it back.
+    queueWrite(handle, [this, handle]()
     {
-        clearCacheInMemory() ;
-        mReadOnly = TRUE ; //disable the cache.
-    }
-    return ;
+        removeFromCache(handle);
+    },
+    [](PendingRegion& pending)
+    {
+        pending.mRemoved = true;
+        pending.mExtrasDropped = true;
+        pending.mObjects.reset();
+        pending.mExtras.reset();
+    });
 }
 
-BOOL LLVOCache::updateEntry(const HeaderEntryInfo* entry)
+void LLVOCache::removeFromCache(U64 handle)
 {
-    LLAPRFile apr_file(mHeaderFileName, APR_WRITE|APR_BINARY, mLocalAPRFilePoolp);
-    apr_file.seek(APR_SET, entry->mIndex * sizeof(HeaderEntryInfo) + sizeof(HeaderMetaInfo)) ;
+    if(mReadOnly)
+    {
+        LL_WARNS() << "Not removing cache for handle " << handle << ": Cache is currently in read-only mode." << LL_ENDL;
+        return ;
+    }
 
-    return check_write(&apr_file, (void*)entry, sizeof(HeaderEntryInfo)) ;
+    // The store keeps the generic extras with the objects, so this removes both.
+    LL_WARNS("GLTF", "VOCache") << "Removing object cache for handle " << handle << LL_ENDL;
+    mStore.removeRegion(handle);
 }
 
 // we now return bool to trigger dirty cache
@@ -1523,62 +1441,68 @@ bool LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
     }
     llassert_always(mInitialized);
 
-    handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
-    if(iter == mHandleEntryMap.end()) //no cache
+    // A write-back of this region may still be queued, it has the latest
+    // objects.
+    PendingRegion pending;
+    const bool write_pending = getPendingRegion(handle, pending) && (pending.mRemoved || pending.mObjects);
+
+    LLUUID cache_id;
+    if(write_pending ? pending.mRemoved : !mStore.getRegionID(handle, cache_id)) //no cache
     {
         LL_WARNS() << "No handle map entry for " << handle << LL_ENDL;
         return false; // arguably no a problem, but we'll mark this as dirty anyway.
     }
-
-    bool success = true ;
-    S32 num_entries = 0 ; // lifted out of inner loop.
-    std::string filename; // lifted out of loop
+    if(write_pending)
     {
-        LLUUID cache_id;
-        getObjectCacheFilename(handle, filename);
-        LLAPRFile apr_file(filename, APR_READ|APR_BINARY, mLocalAPRFilePoolp);
+        cache_id = pending.mID;
+    }
 
-        success = check_read(&apr_file, cache_id.mData, UUID_BYTES);
+    if(cache_id != id)
+    {
+        LL_INFOS() << "Cache ID doesn't match for this region, discarding"<< LL_ENDL;
+        removeEntry(handle);
+        return false;
+    }
 
-        if(success)
+    bool success = true ;
+    auto read_record = [&](const LLVOCacheStore::ObjectRecord& record)
+    {
+        if(!success)
         {
-            if(cache_id != id)
-            {
-                LL_INFOS() << "Cache ID doesn't match for this region, discarding"<< LL_ENDL;
-                success = false ;
-            }
-
-            if(success)
-            {
-                success = check_read(&apr_file, &num_entries, sizeof(S32)) ;
-
-                if(success)
-                {
-                    for (S32 i = 0; i < num_entries && apr_file.eof() != APR_EOF; i++)
-                    {
-                        LLPointer<LLVOCacheEntry> entry = new LLVOCacheEntry(&apr_file);
-                        if (!entry->getLocalID())
-                        {
-                            LL_WARNS() << "Aborting cache file load for " << filename << ", cache file corruption!" << LL_ENDL;
-                            success = false ;
-                            break ;
-                        }
-                        cache_entry_map[entry->getLocalID()] = entry;
-                    }
-                }
-            }
+            return;
         }
+        LLPointer<LLVOCacheEntry> entry = new LLVOCacheEntry(record);
+        if (!entry->getLocalID())
+        {
+            LL_WARNS() << "Aborting cache load for handle " << handle << ", cache corruption!" << LL_ENDL;
+            success = false ;
+            return;
+        }
+        cache_entry_map[entry->getLocalID()] = entry;
+    };
+    if(write_pending)
+    {
+        // the entries point into the snapshot, which they keep alive
+        for (LLVOCacheStore::ObjectRecord record : pending.mObjects->mObjects)
+        {
+            record.mDataRef = LLVOCacheStore::data_ref_t(pending.mObjects, record.mData);
+            read_record(record);
+        }
+    }
+    else
+    {
+        mStore.readObjects(handle, read_record);
     }
 
     if(!success)
     {
         if(cache_entry_map.empty())
         {
-            removeEntry(iter->second) ;
+            removeEntry(handle) ;
         }
     }
 
-    LL_DEBUGS("GLTF", "VOCache") << "Read " << cache_entry_map.size() << " entries from object cache " << filename << ", expected " << num_entries << ", success=" << (success?"True":"False") << LL_ENDL;
+    LL_DEBUGS("GLTF", "VOCache") << "Read " << cache_entry_map.size() << " entries from object cache for handle " << handle << ", success=" << (success?"True":"False") << LL_ENDL;
     return success;
 }
 
@@ -1596,100 +1520,70 @@ void LLVOCache::readGenericExtrasFromCache(U64 handle, const LLUUID& id, LLVOCac
     }
     llassert_always(mInitialized);
 
-    handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
-    if(iter == mHandleEntryMap.end()) //no cache
-    {
-        LL_WARNS() << "No handle map entry for " << handle << LL_ENDL;
-        return;
-    }
-
-    std::string filename(getObjectCacheExtrasFilename(handle));
-    llifstream in(filename, std::ios::in | std::ios::binary);
+    // Queued writes of this region go before what is in the store.
+    PendingRegion pending;
+    const bool write_pending = getPendingRegion(handle, pending);
 
-    std::string line;
-    std::getline(in, line);
-    if(!in.good())
+    LLUUID cache_id;
+    if(write_pending && pending.mRemoved)
     {
-        LL_WARNS() << "Failed reading extras cache for handle " << handle << LL_ENDL;
-        in.close();
-        removeGenericExtrasForHandle(handle);
+        LL_WARNS() << "No handle map entry for " << handle << LL_ENDL;
         return;
     }
-    // file formats need versions, let's add one. legacy cache files will be considered version 0
-    // This will make it easier to upgrade/revise later.
-    int versionNumber=0;
-    if (line.compare(0, LLGLTFOverrideCacheEntry::VERSION_LABEL.length(), LLGLTFOverrideCacheEntry::VERSION_LABEL) == 0)
+    if(write_pending && pending.mObjects)
     {
-        std::string versionStr = line.substr(LLGLTFOverrideCacheEntry::VERSION_LABEL.length()+1); // skip the version label and ':'
-        versionNumber = std::stol(versionStr);
+        cache_id = pending.mID;
     }
-    // For future versions we may call a legacy handler here, but realistically we'll just consider this cache out of date.
-    // The important thing is to make sure it gets removed.
-    if(versionNumber != LLGLTFOverrideCacheEntry::VERSION)
+    else if(!mStore.getRegionID(handle, cache_id)) //no cache
     {
-        LL_WARNS() << "Unexpected version number " << versionNumber << " for extras cache for handle " << handle << LL_ENDL;
-        in.close();
-        removeGenericExtrasForHandle(handle);
+        LL_WARNS() << "No handle map entry for " << handle << LL_ENDL;
         return;
     }
 
-    LL_DEBUGS("VOCache") << "Reading extras cache for handle " << handle << ", version " << versionNumber << LL_ENDL;
-    std::getline(in, line);
-    if(!LLUUID::validate(line))
+    if(cache_id != id)
     {
-        LL_WARNS() << "Failed reading extras cache for handle" << handle << ". invalid uuid line: '" << line << "'" << LL_ENDL;
-        in.close();
+        // if the cache id doesn't match the expected region we should just kill the entry.
+        LL_WARNS() << "Cache ID doesn't match for this region, deleting it" << LL_ENDL;
         removeGenericExtrasForHandle(handle);
         return;
     }
 
-    LLUUID cache_id(line);
-    if(cache_id != id)
+    std::vector<U8> data;
+    if(write_pending && pending.mExtras && pending.mExtrasID == cache_id)
     {
-        // if the cache id doesn't match the expected region we should just kill the file.
-        LL_WARNS() << "Cache ID doesn't match for this region, deleting it" << LL_ENDL;
-        in.close();
-        removeGenericExtrasForHandle(handle);
+        data.assign(pending.mExtras->begin(), pending.mExtras->end());
+    }
+    else if((write_pending && pending.mExtrasDropped) || !mStore.readExtras(handle, data))
+    {
+        LL_DEBUGS("GLTF") << "No extras cached for handle " << handle << LL_ENDL;
         return;
     }
 
-    U32 num_entries;  // if removal was enabled during write num_entries might be wrong
-    std::getline(in, line);
-    if(!in.good())
+    LLSD extras;
+    LLMemoryStream in(data.data(), (S32)data.size());
+    if(LLSDSerialize::fromBinary(extras, in, data.size()) <= 0 || !extras.isMap())
     {
         LL_WARNS() << "Failed reading extras cache for handle " << handle << LL_ENDL;
-        in.close();
         removeGenericExtrasForHandle(handle);
         return;
     }
-    try
-    {
-        num_entries = std::stol(line);
-    }
-    catch(const std::logic_error&)  // either invalid_argument or out_of_range
+
+    // For future versions we may call a legacy handler here, but realistically we'll just consider this cache out of date.
+    // The important thing is to make sure it gets removed.
+    int versionNumber = extras[LLGLTFOverrideCacheEntry::VERSION_LABEL].asInteger();
+    if(versionNumber != LLGLTFOverrideCacheEntry::VERSION)
     {
-        LL_WARNS() << "Failed reading extras cache for handle " << handle << ". unreadable num_entries" << LL_ENDL;
-        in.close();
+        LL_WARNS() << "Unexpected version number " << versionNumber << " for extras cache for handle " << handle << LL_ENDL;
         removeGenericExtrasForHandle(handle);
         return;
     }
 
-    LL_DEBUGS("GLTF") << "Beginning reading extras cache for handle " << handle << " from " << getObjectCacheExtrasFilename(handle) << LL_ENDL;
+    LL_DEBUGS("GLTF") << "Beginning reading extras cache for handle " << handle << LL_ENDL;
 
-    LLSD entry_llsd;
-    for (U32 i = 0; i < num_entries && !in.eof(); i++)
+    const LLSD& entries = extras["entries"];
+    for (LLSD::array_const_iterator iter = entries.beginArray(); iter != entries.endArray(); ++iter)
     {
-        static const U32 max_size = 4096;
-        bool success = LLSDSerialize::deserialize(entry_llsd, in, max_size);
-        // check bool(in) this time since eof is not a failure condition here
-        if(!success || !in)
-        {
-            LL_WARNS() << "Failed reading extras cache for handle " << handle << ", entry number " << i << " cache patrtial load only." << LL_ENDL;
-            in.close();
-            removeGenericExtrasForHandle(handle);
-            break;
-        }
-
+        const LLSD& entry_llsd = *iter;
         LLGLTFOverrideCacheEntry entry;
         entry.fromLLSD(entry_llsd);
         U32 local_id = entry_llsd["local_id"].asInteger();
@@ -1716,148 +1610,111 @@ void LLVOCache::readGenericExtrasFromCache(U64 handle, const LLUUID& id, LLVOCac
 void LLVOCache::purgeEntries(U32 size)
 {
     LL_DEBUGS("VOCache","GLTF") << "Purging " << size << " entries from cache" << LL_ENDL;
-    while(mHeaderEntryQueue.size() > size)
+    while(mStore.getRegionCount() > size)
     {
-        header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin() ;
-        HeaderEntryInfo* entry = *iter ;
-        mHandleEntryMap.erase(entry->mHandle) ;
-        mHeaderEntryQueue.erase(iter) ;
-        removeFromCache(entry) ; // This now handles removing extras cache where appropriate.
-        delete entry;
+        removeFromCache(mStore.getOldestRegion()) ; // This now handles removing extras cache where appropriate.
     }
-    mNumEntries = mHandleEntryMap.size() ;
 }
 
 void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache, bool removal_enabled)
 {
-    std::string filename;
-    getObjectCacheFilename(handle, filename);
     if(!mEnabled)
     {
-        LL_WARNS() << "Not writing cache for " << filename << " (handle:" << handle << "): Cache is currently disabled." << LL_ENDL;
+        LL_WARNS() << "Not writing cache for handle " << handle << ": Cache is currently disabled." << LL_ENDL;
         return ;
     }
     llassert_always(mInitialized);
 
     if(mReadOnly)
     {
-        LL_WARNS() << "Not writing cache for " << filename << " (handle:" << handle << "): Cache is currently in read-only mode." << LL_ENDL;
+        LL_WARNS() << "Not writing cache for handle " << handle << ": Cache is currently in read-only mode." << LL_ENDL;
         return ;
     }
 
-    HeaderEntryInfo* entry;
-    handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
-    if(iter == mHandleEntryMap.end()) //new entry
-    {
-        if(mNumEntries >= mCacheSize - 1)
-        {
-            purgeEntries(mCacheSize - 1) ;
-        }
-
-        entry = new HeaderEntryInfo();
-        entry->mHandle = handle ;
-        entry->mTime = time(NULL) ;
-        entry->mIndex = mNumEntries++;
-        mHeaderEntryQueue.insert(entry) ;
-        mHandleEntryMap[handle] = entry ;
-    }
-    else
+    if(!dirty_cache)
     {
         // Update access time.
-        entry = iter->second ;
-
-        //resort
-        mHeaderEntryQueue.erase(entry) ;
-
-        entry->mTime = time(NULL) ;
-        mHeaderEntryQueue.insert(entry) ;
+        queueWrite(handle, [this, handle, id]()
+        {
+            mStore.touchRegion(handle, id);
+        });
+        LL_WARNS() << "Skipping write to cache for handle " << handle << ": cache not dirty" << LL_ENDL;
+        return ; //nothing changed, no need to update.
     }
 
-    //update cache header
-    if(!updateEntry(entry))
+    // Snapshot the entries so the region is free to go away while the
+    // write-back thread stores them. The store only appends the entries
+    // whose data changed since the region was last written back.
+    auto snapshot = std::make_shared<ObjectSnapshot>();
+    LLVOCacheStore::object_list_t& objects = snapshot->mObjects;
+    objects.reserve(cache_entry_map.size());
+    size_t data_size = 0;
+    for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
     {
-        LL_WARNS() << "Failed to update cache header index " << entry->mIndex << ". " << filename << " handle = " << handle << LL_ENDL;
-        return ; //update failed.
+        if (!removal_enabled || iter->second->isValid())
+        {
+            LLVOCacheStore::ObjectRecord record;
+            if (!iter->second->getObjectRecord(record))
+            {
+                LL_WARNS() << "Failed to write cache entry for handle " << handle << ", entry number " << iter->second->getLocalID() << LL_ENDL;
+                removeEntry(handle);
+                return;
+            }
+            objects.push_back(record);
+            data_size += record.mSize;
+        }
     }
 
-    if(!dirty_cache)
+    snapshot->mData.resize(data_size);
+    U8* data = snapshot->mData.data();
+    for (LLVOCacheStore::ObjectRecord& record : objects)
     {
-        LL_WARNS() << "Skipping write to cache for " << filename << " (handle:" << handle << "): cache not dirty" << LL_ENDL;
-        return ; //nothing changed, no need to update.
+        memcpy(data, record.mData, record.mSize);
+        record.mData = data;
+        data += record.mSize;
     }
 
-    //write to cache file
-    bool success = true ;
+    const bool write_back = mWriteThread != nullptr;
+    std::shared_ptr<const ObjectSnapshot> objects_snapshot(snapshot);
+    queueWrite(handle, [this, handle, id, write_back, snapshot = objects_snapshot]()
     {
-        std::string filename;
-        getObjectCacheFilename(handle, filename);
-        LLAPRFile apr_file(filename, APR_FOPEN_CREATE|APR_FOPEN_WRITE|APR_FOPEN_BINARY|APR_FOPEN_TRUNCATE, mLocalAPRFilePoolp);
+        if(!mStore.hasRegion(handle) && mStore.getRegionCount() >= mCacheSize - 1) //new entry
+        {
+            purgeEntries(mCacheSize - 1) ;
+        }
 
-        success = check_write(&apr_file, (void*)id.mData, UUID_BYTES);
+        bool success = mStore.writeObjects(handle, id, snapshot->mObjects);
+        LL_DEBUGS("VOCache") << "Wrote " << snapshot->mObjects.size() << " entries to the object cache for handle " << handle << ". success = " << (success ? "True":"False") << LL_ENDL;
 
-        if(success)
+        if(!success)
         {
-            S32 num_entries = cache_entry_map.size(); // if removal is enabled num_entries might be wrong
-            success = check_write(&apr_file, &num_entries, sizeof(S32));
-            if (success)
-            {
-                const S32 buffer_size = 32768; //should be large enough for couple MAX_ENTRY_BODY_SIZE
-                U8 data_buffer[buffer_size]; // generaly entries are fairly small, so collect them and drop onto disk in one go
-                S32 size_in_buffer = 0;
-
-                // This can have a lot of entries, so might be better to dump them into buffer first and write in one go.
-                for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); success && iter != cache_entry_map.end(); ++iter)
-                {
-                    if (!removal_enabled || iter->second->isValid())
-                    {
-                        S32 size = iter->second->writeToBuffer(data_buffer + size_in_buffer);
-
-                        if (size > ENTRY_HEADER_SIZE) // body is minimum of 1
-                        {
-                            size_in_buffer += size;
-                        }
-                        else
-                        {
-                            LL_WARNS() << "Failed to write cache entry to buffer for " << filename << ", entry number " << iter->second->getLocalID() << LL_ENDL;
-                            success = false;
-                            break;
-                        }
-
-                        // Make sure we have space in buffer for next element
-                        if (buffer_size - size_in_buffer < MAX_ENTRY_BODY_SIZE + ENTRY_HEADER_SIZE)
-                        {
-                            success = check_write(&apr_file, (void*)data_buffer, size_in_buffer);
-                            size_in_buffer = 0;
-                            if (!success)
-                            {
-                                LL_WARNS() << "Failed to write cache to disk " << filename << LL_ENDL;
-                                break;
-                            }
-                        }
-                    }
-                }
-
-                if (success && size_in_buffer > 0)
-                {
-                    // final write
-                    success = check_write(&apr_file, (void*)data_buffer, size_in_buffer);
-                    if(!success)
-                    {
-                        LL_WARNS() << "Failed to write cache entry to disk " << filename << LL_ENDL;
-                    }
-                    size_in_buffer = 0;
-                }
-                LL_DEBUGS("VOCache") << "Wrote " << num_entries << " entries to the primary VOCache file " << filename << ". success = " << (success ? "True":"False") << LL_ENDL;
-            }
+            removeFromCache(handle);
+            return;
         }
-    }
 
-    if(!success)
+        // Off the main thread we can afford to wait for the data to hit the disk.
+        mStore.flush(!write_back);
+    },
+    [this, handle, id, objects_snapshot](PendingRegion& pending)
     {
-        removeEntry(entry) ;
-    }
-
-    return ;
+        // a region cached under another ID loses its extras
+        LLUUID previous_id;
+        if (pending.mObjects)
+        {
+            previous_id = pending.mID;
+        }
+        else if (!pending.mRemoved)
+        {
+            mStore.getRegionID(handle, previous_id);
+        }
+        if (previous_id != id)
+        {
+            pending.mExtrasDropped = true;
+        }
+        pending.mRemoved = false;
+        pending.mID = id;
+        pending.mObjects = objects_snapshot;
+    });
 }
 
 void LLVOCache::removeGenericExtrasForHandle(U64 handle)
@@ -1869,17 +1726,7 @@ void LLVOCache::removeGenericExtrasForHandle(U64 handle)
     }
 
     // NOTE: when removing the extras, we must also remove the objects so the simulator will send us a full upddate with the valid overrides
-    auto* entry = mHandleEntryMap[handle];
-    if (entry)
-    {
-        removeEntry(entry);
-    }
-    else
-    {
-        //shouldn't happen, but if it does, we should remove the extras file since it's orphaned
-        LL_WARNS("GLTF", "VOCache") << "Removing generic extras for handle " << handle << "Filename: " << getObjectCacheExtrasFilename(handle) << LL_ENDL;
-        LLFile::remove(getObjectCacheExtrasFilename(handle));
-    }
+    removeEntry(handle);
 }
 
 void LLVOCache::writeGenericExtrasToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_gltf_overrides_map_t& cache_extras_entry_map, BOOL dirty_cache, bool removal_enabled)
@@ -1897,37 +1744,6 @@ void LLVOCache::writeGenericExtrasToCache(U64 handle, const LLUUID& id, const LL
         return;
     }
 
-    // <FS:Beq> FIRE-33808 - Material Override Cache causes long delays
-    std::string filename = getObjectCacheExtrasFilename(handle);
-    // </FS:Beq>
-    llofstream out(filename, std::ios::out | std::ios::binary);
-    if(!out.good())
-    {
-        LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
-        removeGenericExtrasForHandle(handle);
-        return;
-    }
-    // It is good practice to version file formats so let's add one.
-    // legacy versions will be treated as version 0.
-    out << LLGLTFOverrideCacheEntry::VERSION_LABEL << ":" << LLGLTFOverrideCacheEntry::VERSION << '\n';
-
-    out << id << '\n';
-    if(!out.good())
-    {
-        LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
-        removeGenericExtrasForHandle(handle);
-        return;
-    }
-    // Because we don't write out all the entries we need to record a placeholder and rewrite this later
-    auto num_entries_placeholder = out.tellp();
-    out << std::setw(10) << std::setfill('0') << 0 << '\n';
-    if(!out.good())
-    {
-        LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
-        removeGenericExtrasForHandle(handle);
-        return;
-    }
-
     // get ViewerRegion pointer from handle
     LLViewerRegion* pRegion = LLWorld::getInstance()->getRegionFromHandle(handle);
 
@@ -1935,6 +1751,12 @@ void LLVOCache::writeGenericExtrasToCache(U64 handle, const LLUUID& id, const LL
     U32 inmem_entries = 0;
     U32 skipped = 0;
     inmem_entries = cache_extras_entry_map.size();
+
+    // It is good practice to version file formats so let's add one.
+    LLSD extras;
+    extras[LLGLTFOverrideCacheEntry::VERSION_LABEL] = LLGLTFOverrideCacheEntry::VERSION;
+    LLSD& entries = extras["entries"];
+    entries = LLSD::emptyArray();
     for (auto [local_id, entry] : cache_extras_entry_map)
     {
         // Only write out GLTFOverrides that we can actually apply again on import.
@@ -1953,15 +1775,7 @@ void LLVOCache::writeGenericExtrasToCache(U64 handle, const LLUUID& id, const LL
         {
             LLSD entry_llsd = entry.toLLSD();
             entry_llsd["local_id"] = (S32)local_id;
-            LLSDSerialize::serialize(entry_llsd, out, LLSDSerialize::LLSD_XML);
-            out << '\n';
-            if(!out.good())
-            {
-                // We're not in a good place when this happens so we might as well nuke the file.
-                LL_WARNS() << "Failed writing extras cache for handle " << handle << ". Corrupted cache file " << filename << " removed." << LL_ENDL;
-                removeGenericExtrasForHandle(handle);
-                return;
-            }
+            entries.append(entry_llsd);
             num_entries++;
         }
         else
@@ -1969,14 +1783,33 @@ void LLVOCache::writeGenericExtrasToCache(U64 handle, const LLUUID& id, const LL
             skipped++;
         }
     }
-    // Rewrite the placeholder
-    out.seekp(num_entries_placeholder);
-    out << std::setw(10) << std::setfill('0') << num_entries << '\n';
-    if(!out.good())
+
+    // LLSD is not safe to share across threads, hand over the serialized form.
+    std::ostringstream out;
+    LLSDSerialize::toBinary(extras, out);
+    auto data = std::make_shared<const std::string>(out.str());
+    queueWrite(handle, [this, handle, id, data, num_entries, inmem_entries, skipped]()
     {
-        LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
-        removeGenericExtrasForHandle(handle);
-        return;
-    }
-    LL_DEBUGS("GLTF") << "Completed writing extras cache for handle " << handle << ", " << num_entries << " entries. Total in RAM: " << inmem_entries << " skipped (no persist): " << skipped << LL_ENDL;
+        LLUUID cache_id;
+        if(!mStore.getRegionID(handle, cache_id) || cache_id != id)
+        {
+            // extras are only kept alongside the objects they apply to
+            return;
+        }
+
+        // An unchanged blob is not written again.
+        if(!mStore.writeExtras(handle, (const U8*)data->data(), (U32)data->size()))
+        {
+            // We're not in a good place when this happens so we might as well nuke the entry.
+            LL_WARNS() << "Failed writing extras cache for handle " << handle << LL_ENDL;
+            removeFromCache(handle);
+            return;
+        }
+        LL_DEBUGS("GLTF") << "Completed writing extras cache for handle " << handle << ", " << num_entries << " entries. Total in RAM: " << inmem_entries << " skipped (no persist): " << skipped << LL_ENDL;
+    },
+    [id, data](PendingRegion& pending)
+    {
+        pending.mExtrasID = id;
+        pending.mExtras = data;
+    });
 }
@@ -33,7 +33,13 @@
 #include "llvieweroctree.h"
 #include "llapr.h"
 #include "llgltfmaterial.h"
+#include "llvocachestore.h"
+#include "llcond.h"
+#include "threadpool_fwd.h"
 
+#include <functional>
+#include <map>
+#include <memory>
 #include <unordered_map>
 
 //---------------------------------------------------------------------------
@@ -102,7 +108,7 @@ class LLVOCacheEntry final
     ~LLVOCacheEntry();
 public:
     LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-    LLVOCacheEntry(LLAPRFile* apr_file);
+    LLVOCacheEntry(const LLVOCacheStore::ObjectRecord& record);
     LLVOCacheEntry();
 
     void updateEntry(U32 crc, LLDataPackerBinaryBuffer &dp);
@@ -118,6 +124,7 @@ class LLVOCacheEntry final
     U32 getLocalID() const          { return mLocalID; }
     U32 getCRC() const              { return mCRC; }
     S32 getHitCount() const         { return mHitCount; }
+    S32 getDupeCount() const        { return mDupeCount; }
     S32 getCRCChangeCount() const   { return mCRCChangeCount; }
 
     void calcSceneContribution(const LLVector4a& camera_origin, bool needs_update, U32 last_update, F32 dist_threshold);
@@ -125,8 +132,11 @@ class LLVOCacheEntry final
     F32 getSceneContribution() const             { return mSceneContrib;}
 
     void dump() const;
-    S32 writeToBuffer(U8 *data_buffer) const;
+    bool getObjectRecord(LLVOCacheStore::ObjectRecord& record) const;
     LLDataPackerBinaryBuffer *getDP() const;
+    // The bytes of the update, kept alive for as long as they are referenced
+    // rather than for the lifetime of the entry. Null when there are none.
+    LLVOCacheStore::data_ref_t shareData(S32& size) const;
     void recordHit();
     void recordDupe() { mDupeCount++; }
 
@@ -157,6 +167,7 @@ class LLVOCacheEntry final
 
 private:
     void updateParentBoundingInfo(const LLVOCacheEntry* child);
+    void freeBuffer();
 
 public:
     typedef std::map<U32, LLPointer<LLVOCacheEntry> >      vocache_entry_map_t;
@@ -181,6 +192,7 @@ class LLVOCacheEntry final
     S32                         mCRCChangeCount;
     mutable LLDataPackerBinaryBuffer    mDP;
     U8                          *mBuffer;
+    LLVOCacheStore::data_ref_t  mStoreData; // holds the store data mDP points into, instead of mBuffer
 
     F32                         mSceneContrib; //projected scene contributuion of this object.
     U32                         mState; //high 16 bits reserved for special use.
@@ -246,45 +258,14 @@ class LLVOCachePartition final : public LLViewerOctreePartition
 };
 
 //
-//Note: LLVOCache is not thread-safe
+//Note: LLVOCache is not thread-safe. Only the store write-back runs on the
+//"VOCacheWrite" thread, fed with snapshots taken on the main thread.
 //
 class LLVOCache final : public LLParamSingleton<LLVOCache>
 {
     LLSINGLETON(LLVOCache, bool read_only);
     ~LLVOCache() ;
 
-private:
-    struct HeaderEntryInfo
-    {
-        HeaderEntryInfo() : mHandle(0), mIndex(0), mTime(0) {}
-        U64 mHandle;
-        S32 mIndex;
-        U32 mTime ;
-    };
-
-    struct HeaderMetaInfo
-    {
-        HeaderMetaInfo() : mVersion(0), mAddressSize(0) {}
-
-        U32 mVersion;
-        U32 mAddressSize;
-    };
-
-    struct header_entry_less
-    {
-        bool operator()(const HeaderEntryInfo* lhs, const HeaderEntryInfo* rhs) const
-        {
-            if(lhs->mTime == rhs->mTime)
-            {
-                return lhs < rhs ;
-            }
-
-            return lhs->mTime < rhs->mTime ; // older entry in front of queue (set)
-        }
-    };
-    typedef std::set<HeaderEntryInfo*, header_entry_less> header_entry_queue_t;
-    typedef std::map<U64, HeaderEntryInfo*> handle_entry_map_t;
-
 public:
     // We need this init to be separate from constructor, since we might construct cache, purge it, then init.
     void initCache(ELLPath location, U32 size, U32 cache_version);
@@ -298,35 +279,62 @@ class LLVOCache final : public LLParamSingleton<LLVOCache>
     void removeEntry(U64 handle) ;
     void removeGenericExtrasForHandle(U64 handle);
 
-    U32 getCacheEntries() { return mNumEntries; }
+    U32 getCacheEntries() { return mStore.getRegionCount(); }
     U32 getCacheEntriesMax() { return mCacheSize; }
 
 private:
+    struct ObjectSnapshot;
+
+    // What the queued writes of a region will leave in the store, so that
+    // it can be read before they are done
+    struct PendingRegion
+    {
+        U32 mCount = 0;                 // queued writes
+        bool mRemoved = false;          // the region is removed
+        bool mExtrasDropped = false;    // the stored extras are removed
+        LLUUID mID;                     // ID of mObjects
+        std::shared_ptr<const ObjectSnapshot> mObjects;
+        LLUUID mExtrasID;               // ID of the region mExtras were written for
+        std::shared_ptr<const std::string> mExtras;
+    };
+
+    struct PendingWrites
+    {
+        std::map<U64, PendingRegion> mRegions;
+        U32 mCount = 0;
+    };
+    typedef std::function<void(PendingRegion&)> pending_func_t;
+
     void setDirNames(ELLPath location);
-    // determine the cache filename for the region from the region handle
-    void getObjectCacheFilename(U64 handle, std::string& filename);
-    std::string getObjectCacheExtrasFilename(U64 handle);
-    void removeFromCache(HeaderEntryInfo* entry);
-    void readCacheHeader();
-    void writeCacheHeader();
-    void clearCacheInMemory();
+    void removeLegacyCacheFiles();
+    void removeFromCache(U64 handle);
     void removeCache() ;
-    void removeEntry(HeaderEntryInfo* entry) ;
     void purgeEntries(U32 size);
-    BOOL updateEntry(const HeaderEntryInfo* entry);
+
+    // Run a store write on the write-back thread, or inline when write-back
+    // is off. Blocks while too many writes are already queued. pending
+    // records what the write changes while it is queued.
+    void queueWrite(U64 handle, const std::function<void()>& write, const pending_func_t& pending = nullptr);
+    void finishWrite(U64 handle);
+    // Copy of what the queued writes of a region change, false if none is queued.
+    bool getPendingRegion(U64 handle, PendingRegion& pending);
+    bool hasRegion(U64 handle);
+    // Wait for all the queued writes.
+    void flushWrites();
+    void stopWriteThread();
 
 private:
     bool                 mEnabled;
     bool                 mInitialized ;
     bool                 mReadOnly ;
-    HeaderMetaInfo       mMetaInfo;
+    U32                  mCacheVersion;
     U32                  mCacheSize;
-    U32                  mNumEntries;
-    std::string          mHeaderFileName ;
+    std::string          mStoreFileName;
     std::string          mObjectCacheDirName;
-    LLVolatileAPRPool*   mLocalAPRFilePoolp ;
-    header_entry_queue_t mHeaderEntryQueue;
-    handle_entry_map_t   mHandleEntryMap;
+    LLVOCacheStore       mStore;
+
+    std::unique_ptr<LL::ThreadPool> mWriteThread;
+    LLCond<PendingWrites> mPendingWrites;
 };
 
 #endif
@@ -0,0 +1,857 @@
+/**
+ * @file llvocachestore.cpp
+ * @brief Single file, memory-mapped store backing the viewer object cache.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llvocachestore.h"
+
+#include "llfile.h"
+
+#include "boost/unordered/unordered_flat_set.hpp"
+
+#include <algorithm>
+#include <ctime>
+
+namespace
+{
+    constexpr U32 STORE_MAGIC = 0x54534F56;     // 'VOST'
+    constexpr U32 STORE_VERSION = 1;
+    constexpr U32 RECORD_MAGIC = 0x43524F56;    // 'VORC'
+
+    constexpr U64 INITIAL_SIZE = 1024 * 1024;
+    constexpr U64 SHRINK_GRANULARITY = 64 * 1024;
+    constexpr U64 COMPACT_MIN_DEAD_BYTES = 4 * 1024 * 1024;
+    constexpr U32 MAX_RECORD_BODY = 64 * 1024 * 1024;
+
+    enum ERecordKind : U16
+    {
+        KIND_REGION = 1,            // body: RegionBody
+        KIND_REGION_REMOVED,        // no body
+        KIND_OBJECT,                // body: object update data
+        KIND_OBJECT_REMOVED,        // no body
+        KIND_EXTRAS,                // body: serialized GLTF overrides
+        KIND_COUNT
+    };
+
+    struct RegionBody
+    {
+        LLUUID  mID;
+        U32     mTime;
+        U32     mReserved;
+    };
+
+    inline U64 align8(U64 size)
+    {
+        return (size + 7) & ~(U64)7;
+    }
+
+    // Owner of the records handed out by readObjects()
+    struct PinnedData
+    {
+        std::shared_ptr<const void> mData;  // mapping or read only copy
+        std::shared_ptr<const void> mPin;
+    };
+}
+
+struct LLVOCacheStore::Header
+{
+    U32 mMagic;
+    U32 mVersion;
+    U32 mCacheVersion;
+    U32 mAddressSize;
+    U64 mEnd;           // committed end of the record data
+    U64 mReserved;
+};
+
+struct LLVOCacheStore::RecordHeader
+{
+    U32 mMagic;
+    U16 mKind;
+    U16 mFlags;
+    U64 mHandle;
+    U32 mLocalID;
+    U32 mCRC;
+    S32 mHitCount;
+    S32 mDupeCount;
+    S32 mCRCChangeCount;
+    U32 mSize;          // of the body, excluding padding
+};
+
+LLVOCacheStore::~LLVOCacheStore()
+{
+    close();
+}
+
+U8* LLVOCacheStore::base() const
+{
+    return mReadOnly ? mReadOnlyData->data() : mFile->data();
+}
+
+size_t LLVOCacheStore::capacity() const
+{
+    return mReadOnly ? mReadOnlyData->size() : mFile->size();
+}
+
+LLVOCacheStore::Header* LLVOCacheStore::header() const
+{
+    return reinterpret_cast<Header*>(base());
+}
+
+const LLVOCacheStore::RecordHeader* LLVOCacheStore::recordAt(U64 offset) const
+{
+    return reinterpret_cast<const RecordHeader*>(base() + offset);
+}
+
+U64 LLVOCacheStore::recordBytes(U64 offset) const
+{
+    return align8(sizeof(RecordHeader) + recordAt(offset)->mSize);
+}
+
+bool LLVOCacheStore::open(const std::string& filename, U32 cache_version, U32 address_size, bool read_only)
+{
+    static_assert(sizeof(Header) == 32, "LLVOCacheStore::Header layout changed");
+    static_assert(sizeof(RecordHeader) == 40, "LLVOCacheStore::RecordHeader layout changed");
+    static_assert(sizeof(RegionBody) == 24, "RegionBody layout changed");
+
+    close();
+
+    LLMutexLock lock(&mMutex);
+
+    mReadOnly = read_only;
+    mCacheVersion = cache_version;
+    mAddressSize = address_size;
+
+    if (mReadOnly)
+    {
+        // Another instance owns the store, so take a private copy rather
+        // than mapping a file that may change under us.
+        LLFILE* fp = LLFile::fopen(filename, "rb");
+        if (!fp)
+        {
+            return false;
+        }
+        fseek(fp, 0, SEEK_END);
+        const long file_size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (file_size >= (long)sizeof(Header))
+        {
+            mReadOnlyData->resize((size_t)file_size);
+            if (fread(mReadOnlyData->data(), 1, mReadOnlyData->size(), fp) != mReadOnlyData->size())
+            {
+                mReadOnlyData->clear();
+            }
+        }
+        fclose(fp);
+        if (mReadOnlyData->empty())
+        {
+            return false;
+        }
+    }
+    else
+    {
+        LLMutexLock map_lock(&mMappingMutex);
+        if (!mFile->open(filename, INITIAL_SIZE))
+        {
+            return false;
+        }
+    }
+
+    const Header* hdr = header();
+    const bool valid = hdr->mMagic == STORE_MAGIC
+                    && hdr->mVersion == STORE_VERSION
+                    && hdr->mCacheVersion == cache_version
+                    && hdr->mAddressSize == address_size
+                    && hdr->mEnd >= sizeof(Header)
+                    && hdr->mEnd <= capacity();
+    if (!valid)
+    {
+        LL_INFOS() << "Object cache store " << filename << " is missing or from another version" << LL_ENDL;
+        if (mReadOnly)
+        {
+            mReadOnlyData->clear();
+            return false;
+        }
+        reset();
+    }
+
+    load();
+    mOpen = true;
+
+    if (!mReadOnly)
+    {
+        maybeCompact();
+    }
+
+    LL_INFOS() << "Object cache store opened with " << mRegions.size() << " regions, " << mLiveBytes << " live bytes" << LL_ENDL;
+    return true;
+}
+
+void LLVOCacheStore::close()
+{
+    LLMutexLock lock(&mMutex);
+
+    if (mOpen && !mReadOnly)
+    {
+        maybeCompact();
+    }
+    {
+        // Records still referenced keep their mapping or copy alive, the
+        // last of them unmaps or frees it
+        LLMutexLock map_lock(&mMappingMutex);
+        mFile = std::make_shared<LLMappedFile>();
+    }
+    mReadOnlyData = std::make_shared<std::vector<U8> >();
+    mPins = std::make_shared<U8>();
+    mRegions.clear();
+    mLiveBytes = 0;
+    mOpen = false;
+}
+
+bool LLVOCacheStore::isOpen() const
+{
+    LLMutexLock lock(&mMutex);
+    return mOpen;
+}
+
+bool LLVOCacheStore::isPinned() const
+{
+    return mPins.use_count() > 1;
+}
+
+bool LLVOCacheStore::grow(U64 new_size)
+{
+    LLMutexLock map_lock(&mMappingMutex);
+    if (!isPinned())
+    {
+        return mFile->resize((size_t)new_size);
+    }
+
+    // Remapping would pull the data from under the records handed out,
+    // leave the current mapping to them and map the grown file on the side.
+    std::shared_ptr<LLMappedFile> file = std::make_shared<LLMappedFile>();
+    if (!file->open(mFile->getFilename(), (size_t)new_size))
+    {
+        return false;
+    }
+    mFile = file;
+    return true;
+}
+
+void LLVOCacheStore::reset()
+{
+    if (mFile->size() > INITIAL_SIZE)
+    {
+        LLMutexLock map_lock(&mMappingMutex);
+        mFile->resize(INITIAL_SIZE);
+    }
+
+    Header* hdr = header();
+    hdr->mMagic = STORE_MAGIC;
+    hdr->mVersion = STORE_VERSION;
+    hdr->mCacheVersion = mCacheVersion;
+    hdr->mAddressSize = mAddressSize;
+    hdr->mEnd = sizeof(Header);
+    hdr->mReserved = 0;
+
+    mRegions.clear();
+    mLiveBytes = 0;
+}
+
+void LLVOCacheStore::clear()
+{
+    LLMutexLock lock(&mMutex);
+
+    if (!mOpen || mReadOnly)
+    {
+        return;
+    }
+
+    if (isPinned())
+    {
+        // The records handed out must not be overwritten, so drop the
+        // regions the way removeRegion() does and let compaction reclaim
+        // the space once they are released.
+        while (!mRegions.empty())
+        {
+            const U64 handle = mRegions.begin()->first;
+            dropRegion(mRegions.begin());
+            append(KIND_REGION_REMOVED, handle, 0, nullptr, nullptr, 0);
+        }
+    }
+    else
+    {
+        reset();
+    }
+    mFile->flush();
+}
+
+bool LLVOCacheStore::load()
+{
+    mRegions.clear();
+    mLiveBytes = 0;
+
+    const U64 end = header()->mEnd;
+    U64 offset = sizeof(Header);
+    while (offset < end)
+    {
+        if (end - offset < sizeof(RecordHeader))
+        {
+            break;
+        }
+        const RecordHeader* rec = recordAt(offset);
+        if (rec->mMagic != RECORD_MAGIC
+            || rec->mKind == 0 || rec->mKind >= KIND_COUNT
+            || rec->mSize > MAX_RECORD_BODY
+            || (rec->mKind == KIND_REGION && rec->mSize != sizeof(RegionBody)))
+        {
+            break;
+        }
+        const U64 bytes = align8(sizeof(RecordHeader) + rec->mSize);
+        if (offset + bytes > end)
+        {
+            break;
+        }
+
+        applyRecord(rec, offset);
+        offset += bytes;
+    }
+
+    bool success = true;
+    if (offset != end)
+    {
+        LL_WARNS() << "Object cache store is corrupt at offset " << offset << ", dropping " << (end - offset) << " bytes" << LL_ENDL;
+        if (!mReadOnly)
+        {
+            header()->mEnd = offset;
+        }
+        success = false;
+    }
+
+    // Objects whose region record got lost are of no use.
+    for (region_map_t::iterator iter = mRegions.begin(); iter != mRegions.end(); )
+    {
+        region_map_t::iterator cur = iter++;
+        if (!cur->second.mRecordOffset)
+        {
+            dropRegion(cur);
+        }
+    }
+
+    return success;
+}
+
+void LLVOCacheStore::applyRecord(const RecordHeader* rec, U64 offset)
+{
+    const U64 bytes = align8(sizeof(RecordHeader) + rec->mSize);
+
+    switch (rec->mKind)
+    {
+    case KIND_REGION:
+    {
+        Region& region = mRegions[rec->mHandle];
+        release(region.mRecordOffset);
+        const RegionBody* body = reinterpret_cast<const RegionBody*>(rec + 1);
+        region.mID = body->mID;
+        region.mTime = body->mTime;
+        region.mRecordOffset = offset;
+        mLiveBytes += bytes;
+        break;
+    }
+    case KIND_REGION_REMOVED:
+    {
+        region_map_t::iterator iter = mRegions.find(rec->mHandle);
+        if (iter != mRegions.end())
+        {
+            dropRegion(iter);
+        }
+        break;
+    }
+    case KIND_OBJECT:
+    {
+        U64& slot = mRegions[rec->mHandle].mObjects[rec->mLocalID];
+        release(slot);
+        slot = offset;
+        mLiveBytes += bytes;
+        break;
+    }
+    case KIND_OBJECT_REMOVED:
+    {
+        region_map_t::iterator iter = mRegions.find(rec->mHandle);
+        if (iter != mRegions.end())
+        {
+            auto obj = iter->second.mObjects.find(rec->mLocalID);
+            if (obj != iter->second.mObjects.end())
+            {
+                release(obj->second);
+                iter->second.mObjects.erase(obj);
+            }
+        }
+        break;
+    }
+    case KIND_EXTRAS:
+    {
+        Region& region = mRegions[rec->mHandle];
+        release(region.mExtrasOffset);
+        region.mExtrasOffset = offset;
+        mLiveBytes += bytes;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void LLVOCacheStore::release(U64 offset)
+{
+    if (offset)
+    {
+        mLiveBytes -= recordBytes(offset);
+    }
+}
+
+void LLVOCacheStore::dropRegion(region_map_t::iterator iter)
+{
+    Region& region = iter->second;
+    release(region.mRecordOffset);
+    release(region.mExtrasOffset);
+    for (const auto& obj : region.mObjects)
+    {
+        release(obj.second);
+    }
+    mRegions.erase(iter);
+}
+
+U64 LLVOCacheStore::append(U16 kind, U64 handle, U32 local_id, const ObjectRecord* obj, const U8* body, U32 body_size)
+{
+    const U64 bytes = align8(sizeof(RecordHeader) + body_size);
+    const U64 offset = header()->mEnd;
+    if (offset + bytes > mFile->size())
+    {
+        const U64 new_size = llmax((U64)mFile->size() * 2, align8(offset + bytes));
+        if (!grow(new_size))
+        {
+            LL_WARNS() << "Unable to grow object cache store to " << new_size << " bytes" << LL_ENDL;
+            return 0;
+        }
+    }
+
+    RecordHeader* rec = reinterpret_cast<RecordHeader*>(mFile->data() + offset);
+    rec->mMagic = RECORD_MAGIC;
+    rec->mKind = kind;
+    rec->mFlags = 0;
+    rec->mHandle = handle;
+    rec->mLocalID = local_id;
+    rec->mCRC = obj ? obj->mCRC : 0;
+    rec->mHitCount = obj ? obj->mHitCount : 0;
+    rec->mDupeCount = obj ? obj->mDupeCount : 0;
+    rec->mCRCChangeCount = obj ? obj->mCRCChangeCount : 0;
+    rec->mSize = body_size;
+
+    U8* dest = reinterpret_cast<U8*>(rec + 1);
+    if (body_size)
+    {
+        memcpy(dest, body, body_size);
+    }
+    const U64 padding = bytes - sizeof(RecordHeader) - body_size;
+    if (padding)
+    {
+        memset(dest + body_size, 0, (size_t)padding);
+    }
+
+    // Only now does the record become part of the store.
+    header()->mEnd = offset + bytes;
+
+    if (kind == KIND_REGION || kind == KIND_OBJECT || kind == KIND_EXTRAS)
+    {
+        mLiveBytes += bytes;
+    }
+    return offset;
+}
+
+bool LLVOCacheStore::appendRegionRecord(U64 handle, Region& region, const LLUUID& id)
+{
+    RegionBody body;
+    body.mID = id;
+    body.mTime = (U32)time(NULL);
+    body.mReserved = 0;
+
+    const U64 offset = append(KIND_REGION, handle, 0, nullptr, reinterpret_cast<const U8*>(&body), sizeof(body));
+    if (!offset)
+    {
+        return false;
+    }
+    release(region.mRecordOffset);
+    region.mRecordOffset = offset;
+    region.mID = id;
+    region.mTime = body.mTime;
+    return true;
+}
+
+U32 LLVOCacheStore::getRegionCount() const
+{
+    LLMutexLock lock(&mMutex);
+    return (U32)mRegions.size();
+}
+
+bool LLVOCacheStore::hasRegion(U64 handle) const
+{
+    LLMutexLock lock(&mMutex);
+    return mRegions.find(handle) != mRegions.end();
+}
+
+bool LLVOCacheStore::getRegionID(U64 handle, LLUUID& id) const
+{
+    LLMutexLock lock(&mMutex);
+
+    region_map_t::const_iterator iter = mRegions.find(handle);
+    if (iter == mRegions.end())
+    {
+        return false;
+    }
+    id = iter->second.mID;
+    return true;
+}
+
+U64 LLVOCacheStore::getOldestRegion() const
+{
+    LLMutexLock lock(&mMutex);
+
+    U64 oldest = 0;
+    U32 oldest_time = U32_MAX;
+    for (const auto& region : mRegions)
+    {
+        if (region.second.mTime < oldest_time)
+        {
+            oldest_time = region.second.mTime;
+            oldest = region.first;
+        }
+    }
+    return oldest;
+}
+
+bool LLVOCacheStore::touchRegion(U64 handle, const LLUUID& id)
+{
+    LLMutexLock lock(&mMutex);
+
+    if (!mOpen || mReadOnly)
+    {
+        return false;
+    }
+
+    region_map_t::iterator iter = mRegions.find(handle);
+    if (iter == mRegions.end() || iter->second.mID != id)
+    {
+        return false;
+    }
+
+    // The time is not part of the index, update it in place.
+    Region& region = iter->second;
+    region.mTime = (U32)time(NULL);
+    RecordHeader* rec = reinterpret_cast<RecordHeader*>(mFile->data() + region.mRecordOffset);
+    reinterpret_cast<RegionBody*>(rec + 1)->mTime = region.mTime;
+    return true;
+}
+
+void LLVOCacheStore::removeRegion(U64 handle)
+{
+    LLMutexLock lock(&mMutex);
+
+    if (!mOpen || mReadOnly)
+    {
+        return;
+    }
+
+    region_map_t::iterator iter = mRegions.find(handle);
+    if (iter == mRegions.end())
+    {
+        return;
+    }
+    dropRegion(iter);
+    append(KIND_REGION_REMOVED, handle, 0, nullptr, nullptr, 0);
+    maybeCompact();
+}
+
+bool LLVOCacheStore::readObjects(U64 handle, const object_func_t& func) const
+{
+    LLMutexLock lock(&mMutex);
+
+    region_map_t::const_iterator iter = mRegions.find(handle);
+    if (iter == mRegions.end())
+    {
+        return false;
+    }
+
+    // Every record shares the reference on the store data, which may have
+    // been remapped by the time they are released
+    std::shared_ptr<PinnedData> owner = std::make_shared<PinnedData>();
+    owner->mData = mReadOnly ? std::shared_ptr<const void>(mReadOnlyData) : std::shared_ptr<const void>(mFile);
+    owner->mPin = mPins;
+
+    ObjectRecord obj;
+    for (const auto& entry : iter->second.mObjects)
+    {
+        const RecordHeader* rec = recordAt(entry.second);
+        obj.mLocalID = rec->mLocalID;
+        obj.mCRC = rec->mCRC;
+        obj.mHitCount = rec->mHitCount;
+        obj.mDupeCount = rec->mDupeCount;
+        obj.mCRCChangeCount = rec->mCRCChangeCount;
+        obj.mData = reinterpret_cast<const U8*>(rec + 1);
+        obj.mSize = rec->mSize;
+        obj.mDataRef = data_ref_t(owner, obj.mData);
+        func(obj);
+    }
+    return true;
+}
+
+bool LLVOCacheStore::writeObjects(U64 handle, const LLUUID& id, const object_list_t& objects)
+{
+    LLMutexLock lock(&mMutex);
+
+    if (!mOpen || mReadOnly)
+    {
+        return false;
+    }
+
+    region_map_t::iterator iter = mRegions.find(handle);
+    if (iter != mRegions.end() && iter->second.mID != id)
+    {
+        // Another region now lives at this handle.
+        dropRegion(iter);
+        if (!append(KIND_REGION_REMOVED, handle, 0, nullptr, nullptr, 0))
+        {
+            return false;
+        }
+        iter = mRegions.end();
+    }
+
+    Region& region = mRegions[handle];
+    if (iter == mRegions.end())
+    {
+        if (!appendRegionRecord(handle, region, id))
+        {
+            mRegions.erase(handle);
+            return false;
+        }
+    }
+
+    U32 appended = 0;
+    boost::unordered_flat_set<U32> written;
+    written.reserve(objects.size());
+    for (const ObjectRecord& obj : objects)
+    {
+        written.insert(obj.mLocalID);
+
+        auto found = region.mObjects.find(obj.mLocalID);
+        if (found != region.mObjects.end())
+        {
+            RecordHeader* rec = reinterpret_cast<RecordHeader*>(mFile->data() + found->second);
+            if (rec->mCRC == obj.mCRC && rec->mSize == obj.mSize)
+            {
+                // Same data, only the statistics may have moved.
+                rec->mHitCount = obj.mHitCount;
+                rec->mDupeCount = obj.mDupeCount;
+                rec->mCRCChangeCount = obj.mCRCChangeCount;
+                continue;
+            }
+        }
+
+        const U64 offset = append(KIND_OBJECT, handle, obj.mLocalID, &obj, obj.mData, obj.mSize);
+        if (!offset)
+        {
+            return false;
+        }
+        if (found != region.mObjects.end())
+        {
+            release(found->second);
+            found->second = offset;
+        }
+        else
+        {
+            region.mObjects[obj.mLocalID] = offset;
+        }
+        ++appended;
+    }
+
+    std::vector<U32> removed;
+    for (const auto& entry : region.mObjects)
+    {
+        if (written.find(entry.first) == written.end())
+        {
+            removed.push_back(entry.first);
+        }
+    }
+    for (U32 local_id : removed)
+    {
+        if (!append(KIND_OBJECT_REMOVED, handle, local_id, nullptr, nullptr, 0))
+        {
+            return false;
+        }
+        auto found = region.mObjects.find(local_id);
+        release(found->second);
+        region.mObjects.erase(found);
+    }
+
+    LL_DEBUGS("VOCache") << "Wrote region " << handle << ": " << appended << " of " << objects.size()
+                         << " objects appended, " << removed.size() << " removed" << LL_ENDL;
+
+    maybeCompact();
+    return true;
+}
+
+bool LLVOCacheStore::readExtras(U64 handle, std::vector<U8>& data) const
+{
+    LLMutexLock lock(&mMutex);
+
+    region_map_t::const_iterator iter = mRegions.find(handle);
+    if (iter == mRegions.end() || !iter->second.mExtrasOffset)
+    {
+        return false;
+    }
+
+    const RecordHeader* rec = recordAt(iter->second.mExtrasOffset);
+    const U8* body = reinterpret_cast<const U8*>(rec + 1);
+    data.assign(body, body + rec->mSize);
+    return true;
+}
+
+bool LLVOCacheStore::writeExtras(U64 handle, const U8* data, U32 size)
+{
+    LLMutexLock lock(&mMutex);
+
+    if (!mOpen || mReadOnly)
+    {
+        return false;
+    }
+
+    region_map_t::iterator iter = mRegions.find(handle);
+    if (iter == mRegions.end())
+    {
+        return false;
+    }
+
+    Region& region = iter->second;
+    if (region.mExtrasOffset)
+    {
+        const RecordHeader* rec = recordAt(region.mExtrasOffset);
+        if (rec->mSize == size && (!size || !memcmp(rec + 1, data, size)))
+        {
+            return true; // unchanged
+        }
+    }
+    else if (!size)
+    {
+        return true;
+    }
+
+    const U64 offset = append(KIND_EXTRAS, handle, 0, nullptr, data, size);
+    if (!offset)
+    {
+        return false;
+    }
+    release(region.mExtrasOffset);
+    region.mExtrasOffset = offset;
+    return true;
+}
+
+void LLVOCacheStore::flush(bool async)
+{
+    // Writing the pages out can take a while, so only keep the mapping from
+    // moving and let other threads use the store meanwhile. A read only
+    // store has no mapping and nothing to flush.
+    LLMutexLock map_lock(&mMappingMutex);
+    mFile->flush(async);
+}
+
+void LLVOCacheStore::maybeCompact()
+{
+    // Compaction moves the records, which the ones handed out can't follow
+    if (isPinned())
+    {
+        return;
+    }
+
+    const U64 dead_bytes = header()->mEnd - sizeof(Header) - mLiveBytes;
+    if (dead_bytes > COMPACT_MIN_DEAD_BYTES && dead_bytes > mLiveBytes)
+    {
+        compact();
+    }
+}
+
+void LLVOCacheStore::compact()
+{
+    LL_PROFILE_ZONE_SCOPED;
+
+    const U64 old_end = header()->mEnd;
+
+    // Every live record, by the index slot that refers to it.
+    std::vector<std::pair<U64, U64*> > live;
+    for (auto& entry : mRegions)
+    {
+        Region& region = entry.second;
+        live.emplace_back(region.mRecordOffset, &region.mRecordOffset);
+        if (region.mExtrasOffset)
+        {
+            live.emplace_back(region.mExtrasOffset, &region.mExtrasOffset);
+        }
+        for (auto& obj : region.mObjects)
+        {
+            live.emplace_back(obj.second, &obj.second);
+        }
+    }
+    std::sort(live.begin(), live.end(), [](const std::pair<U64, U64*>& a, const std::pair<U64, U64*>& b)
+    {
+        return a.first < b.first;
+    });
+
+    // Records only ever move towards the start of the file, and in offset
+    // order, so none is overwritten before it was moved. An interrupted
+    // compaction leaves an empty store rather than a corrupt one.
+    U8* data = mFile->data();
+    header()->mEnd = sizeof(Header);
+    U64 cursor = sizeof(Header);
+    for (auto& ref : live)
+    {
+        const U64 bytes = recordBytes(ref.first);
+        if (ref.first != cursor)
+        {
+            memmove(data + cursor, data + ref.first, (size_t)bytes);
+        }
+        *ref.second = cursor;
+        cursor += bytes;
+    }
+    header()->mEnd = cursor;
+    mLiveBytes = cursor - sizeof(Header);
+
+    const U64 target_size = llmax(INITIAL_SIZE, (cursor + cursor / 4 + SHRINK_GRANULARITY - 1) / SHRINK_GRANULARITY * SHRINK_GRANULARITY);
+    if (target_size < mFile->size())
+    {
+        LLMutexLock map_lock(&mMappingMutex);
+        mFile->resize((size_t)target_size);
+    }
+
+    LL_INFOS() << "Compacted object cache store from " << old_end << " to " << cursor << " bytes" << LL_ENDL;
+}
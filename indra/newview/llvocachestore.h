@@ -0,0 +1,179 @@
+/**
+ * @file llvocachestore.h
+ * @brief Single file, memory-mapped store backing the viewer object cache.
+ *
+ * @Description:
+ * All regions share one store file instead of a header file plus one
+ * object file and one extras file per region.
+ *
+ * 1/ The store is append only. Each record is a small header (kind, region
+ *    handle, local ID, CRC, counters, size) followed by its body. A later
+ *    record for the same region/local ID supersedes an earlier one and the
+ *    *_REMOVED kinds act as tombstones.
+ * 2/ The in-memory index (region handle -> local ID -> record offset) is
+ *    rebuilt at startup by walking the record headers. The header keeps the
+ *    committed end of the data so a record cut short by a crash is dropped.
+ * 3/ Writing a region back only appends the objects whose CRC or size
+ *    changed. Hit and dupe counters of unchanged objects are updated in
+ *    place in the mapping.
+ * 4/ Superseded records are reclaimed by compacting the file in place once
+ *    they outweigh the live data.
+ * 5/ Objects are read without copying: the records handed out point into
+ *    the mapping and hold a reference on it. While any is held the mapping
+ *    is not moved or shrunk, growing the store maps the file anew instead,
+ *    and compaction waits until they are all released.
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOCACHESTORE_H
+#define LL_LLVOCACHESTORE_H
+
+#include "llmappedfile.h"
+#include "llmutex.h"
+#include "lluuid.h"
+
+#include "boost/unordered/unordered_flat_map.hpp"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+class LLVOCacheStore
+{
+public:
+    // Keeps the data of an object read from the store valid and unchanged
+    typedef std::shared_ptr<const U8> data_ref_t;
+
+    struct ObjectRecord
+    {
+        U32         mLocalID = 0;
+        U32         mCRC = 0;
+        S32         mHitCount = 0;
+        S32         mDupeCount = 0;
+        S32         mCRCChangeCount = 0;
+        const U8*   mData = nullptr;
+        U32         mSize = 0;
+        data_ref_t  mDataRef;       // set by readObjects()
+    };
+    typedef std::vector<ObjectRecord> object_list_t;
+    typedef std::function<void(const ObjectRecord&)> object_func_t;
+
+    LLVOCacheStore() = default;
+    ~LLVOCacheStore();
+
+    /**
+     * Open the store and rebuild its index. A store written by another
+     * cache_version or address size is emptied, or ignored when read_only.
+     */
+    bool open(const std::string& filename, U32 cache_version, U32 address_size, bool read_only);
+    void close();
+    bool isOpen() const;
+
+    // Drop every region.
+    void clear();
+
+    U32  getRegionCount() const;
+    bool hasRegion(U64 handle) const;
+    bool getRegionID(U64 handle, LLUUID& id) const;
+
+    // Handle of the region written back the longest time ago, 0 if empty.
+    U64  getOldestRegion() const;
+
+    // Refresh the write time of a region so it is purged last.
+    bool touchRegion(U64 handle, const LLUUID& id);
+    void removeRegion(U64 handle);
+
+    /**
+     * Call func for every cached object of a region. The data pointer of
+     * the record handed to func points into the store and stays valid for
+     * as long as a copy of its mDataRef is kept.
+     */
+    bool readObjects(U64 handle, const object_func_t& func) const;
+
+    /**
+     * Make objects the cached contents of the region. Only new and changed
+     * objects are appended; objects missing from the list are removed.
+     * A region previously cached under another ID is dropped first.
+     */
+    bool writeObjects(U64 handle, const LLUUID& id, const object_list_t& objects);
+
+    bool readExtras(U64 handle, std::vector<U8>& data) const;
+    bool writeExtras(U64 handle, const U8* data, U32 size);
+
+    // Flush written pages to disk. When async is false, only returns once
+    // the data is on disk. Does not hold off the other calls unless they
+    // need to grow or shrink the file.
+    void flush(bool async = true);
+
+private:
+    struct Header;
+    struct RecordHeader;
+
+    struct Region
+    {
+        LLUUID  mID;
+        U32     mTime = 0;
+        U64     mRecordOffset = 0;
+        U64     mExtrasOffset = 0;
+        boost::unordered_flat_map<U32, U64> mObjects;  // local ID -> record offset
+    };
+    typedef std::map<U64, Region> region_map_t;
+
+    U8* base() const;
+    size_t capacity() const;
+    Header* header() const;
+    const RecordHeader* recordAt(U64 offset) const;
+    U64 recordBytes(U64 offset) const;
+
+    // True while records handed out by readObjects() are still referenced
+    bool isPinned() const;
+    bool grow(U64 new_size);
+
+    void reset();
+    bool load();
+    void applyRecord(const RecordHeader* rec, U64 offset);
+    void release(U64 offset);
+    void dropRegion(region_map_t::iterator iter);
+
+    U64  append(U16 kind, U64 handle, U32 local_id, const ObjectRecord* obj, const U8* body, U32 body_size);
+    bool appendRegionRecord(U64 handle, Region& region, const LLUUID& id);
+    void maybeCompact();
+    void compact();
+
+private:
+    mutable LLMutex mMutex;
+    LLMutex         mMappingMutex;      // taken after mMutex to remap mFile, alone to flush it
+    std::shared_ptr<LLMappedFile> mFile = std::make_shared<LLMappedFile>();
+    std::shared_ptr<std::vector<U8> > mReadOnlyData = std::make_shared<std::vector<U8> >();  // whole store when opened read only
+    std::shared_ptr<const void> mPins = std::make_shared<U8>();  // one more reference per set of records handed out
+    bool            mReadOnly = false;
+    bool            mOpen = false;
+    U32             mCacheVersion = 0;
+    U32             mAddressSize = 0;
+
+    region_map_t    mRegions;
+    U64             mLiveBytes = 0;
+};
+
+#endif // LL_LLVOCACHESTORE_H
@@ -44,6 +44,7 @@
 #include "llvolumeoctree.h"
 #include "llvolumemgr.h"
 #include "llvolumemessage.h"
+#include "llfilesystem.h"
 #include "material_codes.h"
 #include "message.h"
 #include "llpluginclassmedia.h" // for code in the mediaEvent handler
@@ -110,6 +111,7 @@ S32 LLVOVolume::mRenderComplexity_last = 0;
 S32 LLVOVolume::mRenderComplexity_current = 0;
 LLPointer<LLObjectMediaDataClient> LLVOVolume::sObjectMediaClient = NULL;
 LLPointer<LLObjectMediaNavigateClient> LLVOVolume::sObjectMediaNavigateClient = NULL;
+LLVOVolume::pending_volume_map_t LLVOVolume::sPendingVolumes;
 
 extern BOOL gCubeSnapshot;
 
@@ -263,6 +265,8 @@ LLVOVolume::~LLVOVolume()
         gMeshRepo.unregisterMesh(this, getVolume()->getParams().getSculptID());
     }
 
+    removePendingVolume();
+
     if(mFetchingSkinInfo > 0)
     {
         gMeshRepo.unregisterSkin(this, getVolume()->getParams().getSculptID());
@@ -322,15 +326,52 @@ void LLVOVolume::markDead()
         {
             gPipeline.mHeroProbeManager.unregisterViewerObject(this);
         }
+
+        removePendingVolume();
     }
 
     LLViewerObject::markDead();
 }
 
 
+// Faces of generated prim volumes, kept in the asset disk cache under a
+// hash of their params. Called from the "PrimVolume" thread pool.
+class LLPrimFaceDiskCache final : public LLVolumeFaceCache
+{
+public:
+    bool read(const LLUUID& key, std::vector<U8>& data) override
+    {
+        LLFileSystem file(key, LLAssetType::AT_UNKNOWN, LLFileSystem::READ);
+        S32 size = file.getSize();
+        if (size <= 0)
+        {
+            return false;
+        }
+        data.resize(size);
+        return file.read(data.data(), size) && file.getLastBytesRead() == size;
+    }
+
+    void write(const LLUUID& key, const std::vector<U8>& data) override
+    {
+        LLFileSystem file(key, LLAssetType::AT_UNKNOWN, LLFileSystem::WRITE);
+        file.write(data.data(), (S32)data.size());
+    }
+};
+
 // static
 void LLVOVolume::initClass()
 {
+    LLVolumeMgr* volume_manager = LLPrimitive::getVolumeManager();
+    if (volume_manager && gSavedSettings.getBOOL("PrimVolumeGenerateAsync"))
+    {
+        volume_manager->setGeneratedCallback(notifyVolumeGenerated);
+        volume_manager->setGenerateAsync(true);
+        if (gSavedSettings.getBOOL("PrimVolumeCache") && LLDiskCache::instanceExists())
+        {
+            volume_manager->setFaceCache(std::make_shared<LLPrimFaceDiskCache>());
+        }
+    }
+
     // gSavedSettings better be around
     if (gSavedSettings.getBOOL("PrimMediaMasterEnabled"))
     {
@@ -351,6 +392,22 @@ void LLVOVolume::cleanupClass()
 {
     sObjectMediaClient = NULL;
     sObjectMediaNavigateClient = NULL;
+
+    LLVolumeMgr* volume_manager = LLPrimitive::getVolumeManager();
+    if (volume_manager)
+    {
+        volume_manager->setGenerateAsync(false);
+        volume_manager->setGeneratedCallback(nullptr);
+        volume_manager->setFaceCache(nullptr);
+    }
+    for (auto& pending : sPendingVolumes)
+    {
+        for (LLVOVolume* objectp : pending.second)
+        {
+            objectp->mVolumePending = false;
+        }
+    }
+    sPendingVolumes.clear();
 }
 
 U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
@@ -780,6 +837,7 @@ void LLVOVolume::updateTextureVirtualSize(bool forced)
                 {
                     face->setPixelArea(0.f);
                     face->setVirtualSize(0.f);
+                    face->updatePriorityInputs(false);
                 }
             }
 
@@ -830,6 +888,7 @@ void LLVOVolume::updateTextureVirtualSize(bool forced)
             imagep->setBoostLevel(LLGLTexture::BOOST_HUD);
             face->setPixelArea(area); // treat as full screen
             face->setVirtualSize(vsize);
+            face->updatePriorityInputs(true);
         }
         else
         {
@@ -1097,7 +1156,16 @@ BOOL LLVOVolume::setVolume(const LLVolumeParams &params_in, const S32 detail, bo
 
     }
 
-    if ((LLPrimitive::setVolume(volume_params, lod, (mVolumeImpl && mVolumeImpl->isVolumeUnique()))) || mSculptChanged)
+    // Only this object's own volume may stand in with another LOD while the
+    // one it wants is generated
+    removePendingVolume();
+    const BOOL volume_changed = LLPrimitive::setVolume(volume_params, lod, (mVolumeImpl && mVolumeImpl->isVolumeUnique()), true);
+    if (!mVolumeImpl)
+    {
+        addPendingVolume(lod);
+    }
+
+    if (volume_changed || mSculptChanged)
     {
         mFaceMappingChanged = TRUE;
 
@@ -1217,6 +1285,60 @@ void LLVOVolume::updateVisualComplexity()
     }
 }
 
+// static
+void LLVOVolume::notifyVolumeGenerated(const LLVolumeParams& volume_params, S32 lod)
+{
+    pending_volume_map_t::iterator iter = sPendingVolumes.find(volume_params);
+    if (iter == sPendingVolumes.end())
+    {
+        return;
+    }
+
+    // Those still waiting on another LOD get back in line when rebuilt
+    std::unordered_set<LLVOVolume*> objects;
+    objects.swap(iter->second);
+    sPendingVolumes.erase(iter);
+    for (LLVOVolume* objectp : objects)
+    {
+        objectp->mVolumePending = false;
+        if (!objectp->isDead() && objectp->mDrawable.notNull())
+        {
+            objectp->mLODChanged = TRUE;
+            gPipeline.markRebuild(objectp->mDrawable, LLDrawable::REBUILD_VOLUME);
+        }
+    }
+}
+
+void LLVOVolume::addPendingVolume(S32 lod)
+{
+    llassert(!mVolumePending);
+    LLVolume* volume = getVolume();
+    if (NO_LOD == lod || !volume || volume->getParams().getSculptType() != LL_SCULPT_TYPE_NONE ||
+        volume->getDetail() == LLVolumeLODGroup::getVolumeScaleFromDetail(lod))
+    {
+        return;
+    }
+
+    mPendingVolume = sPendingVolumes.emplace(volume->getParams(), std::unordered_set<LLVOVolume*>()).first;
+    mPendingVolume->second.insert(this);
+    mVolumePending = true;
+}
+
+void LLVOVolume::removePendingVolume()
+{
+    if (!mVolumePending)
+    {
+        return;
+    }
+
+    mPendingVolume->second.erase(this);
+    if (mPendingVolume->second.empty())
+    {
+        sPendingVolumes.erase(mPendingVolume);
+    }
+    mVolumePending = false;
+}
+
 void LLVOVolume::notifyMeshLoaded()
 {
     mSculptChanged = TRUE;
@@ -4771,7 +4893,7 @@ BOOL LLVOVolume::lineSegmentIntersect(const LLVector4a& start, const LLVector4a&
             }
 
             // This calculates the bounding box of the skinned mesh from scratch. It's actually quite expensive, but not nearly as expensive as building a full octree.
-            // rebuild_face_octrees = false because an octree for this face will be built later only if needed for narrow phase picking.
+            // rebuild_face_octrees = false because a BVH for this face will be built later only if needed for narrow phase picking.
             updateRiggedVolume(true, i, false);
             face_hit = volume->lineSegmentIntersect(local_start, local_end, i,
                                                     &p, &tc, &n, &tn);
@@ -5075,8 +5197,10 @@ void LLRiggedVolume::update(
 
             if (rebuild_face_octrees)
             {
+                // rebuilt on demand, the BVH keeps its triangles and is
+                // refit to the skinned positions by the next ray cast
                 dst_face.destroyOctree();
-                dst_face.createOctree();
+                dst_face.refitBVH();
             }
         }
     }
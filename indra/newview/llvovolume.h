@@ -34,6 +34,7 @@
 #include "lllocalbitmaps.h"
 #include "m3math.h"     // LLMatrix3
 #include "m4math.h"     // LLMatrix4
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -392,6 +393,9 @@ class LLVOVolume final : public LLViewerObject
     void updateVisualComplexity();
 
     void notifyMeshLoaded();
+    // Rebuilds the objects given a lower LOD of these prim params while
+    // this one was generated on a background thread
+    static void notifyVolumeGenerated(const LLVolumeParams& volume_params, S32 lod);
     void notifySkinInfoLoaded(const LLMeshSkinInfo* skin);
     void notifySkinInfoUnavailable();
 
@@ -507,6 +511,19 @@ class LLVOVolume final : public LLViewerObject
 protected:
     static S32 sNumLODChanges;
 
+    // Objects given another LOD of a prim volume while the one they want is
+    // generated, by volume params. Not owning, objects leave it before
+    // going away.
+    typedef std::map<LLVolumeParams, std::unordered_set<LLVOVolume*> > pending_volume_map_t;
+    static pending_volume_map_t sPendingVolumes;
+
+    // Enters sPendingVolumes when the volume is a stand-in for lod
+    void addPendingVolume(S32 lod);
+    void removePendingVolume();
+
+    pending_volume_map_t::iterator mPendingVolume; // valid when mVolumePending
+    bool mVolumePending = false;
+
     friend class LLVolumeImplFlexible;
 };
 
@@ -0,0 +1,164 @@
+/**
+ * @file llfacepriorities_test.cpp
+ * @brief Test of the face inputs to the texture virtual sizes
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llfacepriorities.h"
+
+namespace tut
+{
+    struct facepriorities_data
+    {
+        // The table never dereferences its faces
+        static LLFace* fakeFace(uintptr_t n)
+        {
+            return reinterpret_cast<LLFace*>(n * 64);
+        }
+
+        static LLFacePriorityTable::Inputs makeInputs(F32 area, F32 scale, F32 distance, bool visible)
+        {
+            LLFacePriorityTable::Inputs inputs;
+            inputs.mValid = true;
+            inputs.mPixelArea = area;
+            inputs.mMinScale = scale;
+            inputs.mDistance = distance;
+            inputs.mVisible = visible;
+            return inputs;
+        }
+
+        LLFacePriorityTable mTable;
+        LLFacePriorityTable::Batch mBatch;
+        std::vector<U32> mStale;
+    };
+    typedef test_group<facepriorities_data> facepriorities_group;
+    typedef facepriorities_group::object facepriorities_object;
+    tut::facepriorities_group facepriorities("LLFacePriorityTable");
+
+    template<> template<>
+    void facepriorities_object::test<1>()
+    {
+        // Rows are reused once removed and keep their faces' inputs
+        U32 a = mTable.add(fakeFace(1));
+        U32 b = mTable.add(fakeFace(2));
+        ensure("distinct rows", a != b);
+        ensure_equals("two rows", mTable.getRowCount(), 2U);
+        ensure("back pointer", mTable.getFace(b) == fakeFace(2));
+
+        LLFacePriorityTable::Inputs inputs;
+        ensure("row", mTable.getInputs(a, inputs));
+        ensure("invalid until written", !inputs.mValid);
+
+        mTable.update(a, makeInputs(100.f, 2.f, 10.f, true), 1.f);
+        ensure("written", mTable.getInputs(a, inputs));
+        ensure("valid", inputs.mValid && inputs.mVisible && !inputs.mMaterial);
+        ensure_equals("area", inputs.mPixelArea, 100.f);
+        ensure_equals("scale", inputs.mMinScale, 2.f);
+
+        mTable.remove(a);
+        ensure_equals("one row", mTable.getRowCount(), 1U);
+        ensure("removed", !mTable.getInputs(a, inputs) && mTable.getFace(a) == nullptr);
+
+        U32 c = mTable.add(fakeFace(3));
+        ensure_equals("reused", c, a);
+        ensure("reset", mTable.getInputs(c, inputs) && !inputs.mValid);
+        ensure("other row kept", mTable.getFace(b) == fakeFace(2));
+    }
+
+    template<> template<>
+    void facepriorities_object::test<2>()
+    {
+        // Gathering takes the valid, fresh rows and reports the stale ones
+        U32 rows[4];
+        for (U32 i = 0; i < 4; ++i)
+        {
+            rows[i] = mTable.add(fakeFace(i + 1));
+        }
+        mTable.update(rows[0], makeInputs(100.f, 1.f, 0.f, true), 10.f);
+        mTable.update(rows[1], makeInputs(200.f, 1.f, 0.f, false), 10.f);
+        mTable.update(rows[2], makeInputs(300.f, 1.f, 0.f, true), 2.f); // old
+        LLFacePriorityTable::Inputs invalid;
+        mTable.update(rows[3], invalid, 10.f); // no texture entry
+
+        mTable.gather(rows, 4, 7, 5.f, mBatch, mStale);
+        ensure_equals("gathered", mBatch.size(), (size_t)2);
+        ensure_equals("first area", mBatch.mPixelArea[0], 100.f);
+        ensure_equals("visible", mBatch.mVisible[0], 1.f);
+        ensure_equals("not visible", mBatch.mVisible[1], 0.f);
+        ensure_equals("image", mBatch.mImage[1], 7U);
+        ensure_equals("row", mBatch.mRow[1], rows[1]);
+        ensure_equals("one stale", mStale.size(), (size_t)1);
+        ensure_equals("stale row", mStale[0], rows[2]);
+
+        // a new face is stale until it writes its row
+        U32 fresh = mTable.add(fakeFace(5));
+        mStale.clear();
+        mTable.gather(&fresh, 1, 0, 5.f, mBatch, mStale);
+        ensure("new row stale", mStale.size() == 1 && mStale[0] == fresh);
+
+        // removed rows are skipped
+        mTable.remove(rows[0]);
+        mBatch.clear();
+        mStale.clear();
+        mTable.gather(rows, 2, 0, 5.f, mBatch, mStale);
+        ensure_equals("removed skipped", mBatch.size(), (size_t)1);
+        ensure("nothing stale", mStale.empty());
+    }
+
+    template<> template<>
+    void facepriorities_object::test<3>()
+    {
+        // Virtual sizes follow the pixel area, texture scale, distance and
+        // visibility
+        U32 rows[4];
+        for (U32 i = 0; i < 4; ++i)
+        {
+            rows[i] = mTable.add(fakeFace(i + 1));
+        }
+        mTable.update(rows[0], makeInputs(1000.f, 1.f, 0.f, true), 0.f);
+        mTable.update(rows[1], makeInputs(1000.f, 2.f, 0.f, true), 0.f);
+        mTable.update(rows[2], makeInputs(1000.f, 1.f, 9.f, true), 0.f);
+        mTable.update(rows[3], makeInputs(1000.f, 1.f, 0.f, false), 0.f);
+        mTable.gather(rows, 4, 0, -1.f, mBatch, mStale);
+
+        // no discard bias: only the repeats count
+        LLFacePriorityTable::computeVirtualSizes(mBatch, 1.f, 1.f);
+        ensure_equals("plain", mBatch.mVirtualSize[0], 1000.f);
+        ensure_equals("repeated", mBatch.mVirtualSize[1], 250.f);
+        ensure_equals("distance ignored", mBatch.mVirtualSize[2], 1000.f);
+        ensure_equals("hidden ignored", mBatch.mVirtualSize[3], 1000.f);
+
+        // bias of 2: halved, distant faces by 1 + distance, hidden ones again
+        LLFacePriorityTable::computeVirtualSizes(mBatch, 2.f, 1.f);
+        ensure_equals("biased", mBatch.mVirtualSize[0], 500.f);
+        ensure_equals("biased distant", mBatch.mVirtualSize[2], 50.f);
+        ensure_equals("biased hidden", mBatch.mVirtualSize[3], 250.f);
+
+        // the distance is scaled
+        LLFacePriorityTable::computeVirtualSizes(mBatch, 2.f, 0.f);
+        ensure_equals("distance scaled away", mBatch.mVirtualSize[2], 500.f);
+    }
+}
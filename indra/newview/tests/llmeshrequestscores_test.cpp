@@ -0,0 +1,178 @@
+/**
+ * @file llmeshrequestscores_test.cpp
+ * @brief Test of the scores of the mesh LOD requests
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llmeshrequestscores.h"
+
+#include "llindexedheap.h"
+
+#include <set>
+
+namespace tut
+{
+    struct meshrequestscores_data
+    {
+        typedef LLIndexedHeap<LLUUID, F32> queue_t;
+
+        meshrequestscores_data()
+        {
+            mMeshA.generate();
+            mMeshB.generate();
+        }
+
+        U32 update(F64 now)
+        {
+            return mScores.update(now, HOLD_TIME, [this](const LLUUID& mesh_id) { return mLoading.count(mesh_id) > 0; });
+        }
+
+        // Moves the queued requests like the mesh repository does
+        void apply()
+        {
+            mScores.takeUpdates([this](const LLUUID& mesh_id, F32 score)
+                {
+                    mQueue.update(mesh_id, [score](F32& queued) { queued = score; });
+                });
+        }
+
+        void load(const LLUUID& mesh_id, F64 now)
+        {
+            mLoading.insert(mesh_id);
+            mQueue.push(mesh_id, mScores.add(mesh_id, now));
+        }
+
+        static constexpr F32 HOLD_TIME = 5.f;
+        LLMeshRequestScores mScores;
+        std::set<LLUUID> mLoading;
+        queue_t mQueue;
+        LLUUID mMeshA;
+        LLUUID mMeshB;
+    };
+    typedef test_group<meshrequestscores_data> meshrequestscores_group;
+    typedef meshrequestscores_group::object meshrequestscores_object;
+    tut::meshrequestscores_group meshrequestscores("LLMeshRequestScores");
+
+    template<> template<>
+    void meshrequestscores_object::test<1>()
+    {
+        // The best score of a frame goes first
+        load(mMeshA, 0.0);
+        load(mMeshB, 0.0);
+        mScores.seen(mMeshA, 0.5f, 1, 0.0);
+        mScores.seen(mMeshB, 0.2f, 1, 0.0);
+        mScores.seen(mMeshB, 0.8f, 1, 0.0);
+        ensure_equals("none held", update(0.0), 0U);
+        apply();
+        ensure_equals("best of the frame", mScores.getScore(mMeshB), 0.8f);
+        ensure("largest first", mQueue.topKey() == mMeshB);
+
+        // a new frame starts over
+        mScores.seen(mMeshB, 0.1f, 2, 0.1);
+        mScores.seen(mMeshA, 0.5f, 2, 0.1);
+        update(0.1);
+        apply();
+        ensure_equals("new frame", mScores.getScore(mMeshB), 0.1f);
+        ensure("reordered", mQueue.topKey() == mMeshA);
+
+        // not seen keeps the last score until held
+        update(1.0);
+        ensure_equals("kept", mScores.getScore(mMeshA), 0.5f);
+    }
+
+    template<> template<>
+    void meshrequestscores_object::test<2>()
+    {
+        // Meshes out of view are held, then released when seen again
+        load(mMeshA, 0.0);
+        load(mMeshB, 0.0);
+        mScores.seen(mMeshA, 0.5f, 1, 0.0);
+        mScores.seen(mMeshB, 0.2f, 1, 0.0);
+        update(0.0);
+        apply();
+
+        // only the small one stays in view
+        for (U32 frame = 2; frame < 10; ++frame)
+        {
+            mScores.seen(mMeshB, 0.2f, frame, frame);
+        }
+        ensure_equals("one held", update(9.0), 1U);
+        apply();
+        ensure("held", mScores.isHeld(mMeshA) && !mScores.isHeld(mMeshB));
+        ensure_equals("held score", *mQueue.find(mMeshA), LLMeshRequestScores::HELD_SCORE);
+
+        // held requests go last but are still there to be sent
+        ensure("in view first", mQueue.pop().first == mMeshB);
+        ensure("held still sent", !mQueue.empty() && mQueue.topKey() == mMeshA);
+
+        mScores.seen(mMeshA, 0.5f, 10, 10.0);
+        ensure_equals("released", update(10.0), 0U);
+        apply();
+        ensure_equals("score back", *mQueue.find(mMeshA), 0.5f);
+
+        // a new request is a sighting too
+        update(20.0);
+        ensure("held again", mScores.isHeld(mMeshA));
+        load(mMeshA, 20.0);
+        update(20.0);
+        apply();
+        ensure("released by the request", !mScores.isHeld(mMeshA));
+        ensure_equals("last score", *mQueue.find(mMeshA), 0.5f);
+
+        // never held without a hold time
+        ensure_equals("no hold time", mScores.update(100.0, 0.f, [](const LLUUID&) { return true; }), 0U);
+    }
+
+    template<> template<>
+    void meshrequestscores_object::test<3>()
+    {
+        // Meshes no longer loading are forgotten with their changes
+        load(mMeshA, 0.0);
+        load(mMeshB, 0.0);
+        mScores.seen(mMeshA, 0.5f, 1, 0.0);
+        mScores.seen(mMeshB, 0.2f, 1, 0.0);
+        update(0.0);
+
+        // cancelled before its change was taken
+        mLoading.erase(mMeshA);
+        mQueue.erase(mMeshA);
+        update(0.0);
+        ensure_equals("forgotten", mScores.size(), (size_t)1);
+        ensure_equals("no score", mScores.getScore(mMeshA), 0.f);
+
+        S32 updates = 0;
+        mScores.takeUpdates([&updates, this](const LLUUID& mesh_id, F32)
+            {
+                ++updates;
+                ensure("left one", mesh_id == mMeshB);
+            });
+        ensure_equals("one change", updates, 1);
+
+        // seen after being cancelled is ignored
+        mScores.seen(mMeshA, 0.5f, 2, 0.1);
+        ensure_equals("still forgotten", mScores.size(), (size_t)1);
+    }
+}
@@ -0,0 +1,148 @@
+/**
+ * @file lltexturebudget_test.cpp
+ * @brief Test of the eviction order of the texture memory budget
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../lltexturebudget.h"
+
+namespace tut
+{
+    struct texturebudget_data
+    {
+        texturebudget_data()
+        {
+            mBudget = LLTextureBudget::getInstance();
+        }
+
+        ~texturebudget_data()
+        {
+            LLTextureBudget::deleteSingleton();
+        }
+
+        // Textures last visible at 1, 2, 3 and 4 seconds, and an older one
+        // the budget may not lower
+        void addTextures(S64 bytes)
+        {
+            for (S32 i = 0; i < 4; ++i)
+            {
+                mBudget->updateTexture(&mTextures[i], bytes, false, true, 1.0 + i);
+            }
+            mBudget->updateTexture(&mPinned, 100, false, false, 0.5);
+        }
+
+        S8 bias(S32 i) const { return mTextures[i].getBudgetDiscardBias(); }
+
+        LLTextureBudget* mBudget;
+        LLBudgetedTexture mTextures[4];
+        LLBudgetedTexture mPinned;
+    };
+    typedef test_group<texturebudget_data> texturebudget_group;
+    typedef texturebudget_group::object texturebudget_object;
+    tut::texturebudget_group texturebudget("LLTextureBudget");
+
+    template<> template<>
+    void texturebudget_object::test<1>()
+    {
+        // The least recently visible evictable textures go first, only as
+        // many as it takes to get back to 90% of the budget
+        mBudget->setBudget(1000);
+        addTextures(300);
+        ensure_equals("usage", mBudget->getUsage(), (S64)1300);
+
+        mBudget->rebalance(5.0);
+        ensure_equals("oldest evicted", bias(0), (S8)1);
+        ensure_equals("next oldest evicted", bias(1), (S8)1);
+        ensure_equals("recent kept", bias(2), (S8)0);
+        ensure_equals("most recent kept", bias(3), (S8)0);
+        ensure_equals("pinned kept", mPinned.getBudgetDiscardBias(), (S8)0);
+        ensure_equals("evictions", mBudget->getEvictedCount(), 2U);
+        ensure("evicting", mBudget->isEvicting());
+
+        // a visible texture keeps its bias while over budget
+        mBudget->updateTexture(&mTextures[0], 300, true, true, 5.5);
+        ensure_equals("visible kept lowered", bias(0), (S8)1);
+
+        mBudget->removeTexture(&mPinned);
+        ensure_equals("removed", mBudget->getUsage(), (S64)1200);
+    }
+
+    template<> template<>
+    void texturebudget_object::test<2>()
+    {
+        // What evictions release is measured, evictions waiting to show are
+        // not repeated, and those that never do stop being counted on
+        mBudget->setBudget(1000);
+        addTextures(300);
+        mBudget->rebalance(5.0);
+
+        mBudget->updateTexture(&mTextures[0], 75, false, true, 6.0);
+        ensure_equals("released", mBudget->getReleasedBytes(), (S64)225);
+
+        // the second eviction is expected to release as much, nothing more
+        // is evicted meanwhile
+        mBudget->rebalance(6.0);
+        ensure_equals("first not lowered again", bias(0), (S8)1);
+        ensure_equals("pending not lowered again", bias(1), (S8)1);
+        ensure_equals("nothing else evicted", bias(2), (S8)0);
+        ensure_equals("evictions", mBudget->getEvictedCount(), 2U);
+
+        // it never shows, so both are lowered once more
+        mBudget->rebalance(20.0);
+        ensure_equals("first lowered again", bias(0), (S8)2);
+        ensure_equals("timed out lowered again", bias(1), (S8)2);
+        ensure_equals("recent still kept", bias(2), (S8)0);
+        ensure_equals("nothing more released", mBudget->getReleasedBytes(), (S64)225);
+    }
+
+    template<> template<>
+    void texturebudget_object::test<3>()
+    {
+        // Under 75% of the budget, the most recently visible textures get
+        // their resolution back first, as long as they fit
+        mBudget->setBudget(1000);
+        addTextures(60);
+        for (S32 i = 0; i < 4; ++i)
+        {
+            mTextures[i].setBudgetDiscardBias(1);
+        }
+
+        mBudget->rebalance(5.0);
+        ensure_equals("most recent restored", bias(3), (S8)0);
+        ensure_equals("next restored", bias(2), (S8)0);
+        ensure_equals("older kept", bias(1), (S8)1);
+        ensure("not evicting", !mBudget->isEvicting());
+
+        // visible textures are restored at once when not evicting
+        mBudget->updateTexture(&mTextures[0], 60, true, true, 6.0);
+        ensure_equals("visible restored", bias(0), (S8)0);
+
+        // no budget, nothing happens
+        mBudget->setBudget(0);
+        mBudget->rebalance(7.0);
+        ensure_equals("no budget", bias(1), (S8)1);
+    }
+}
@@ -0,0 +1,299 @@
+/**
+ * @file llvocachestore_test.cpp
+ * @brief Test of the object cache store
+ *
+ * $LicenseInfo:firstyear=2024&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2024, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llvocachestore.h"
+
+#include "lldir.h"
+#include "llfile.h"
+
+#include "boost/filesystem.hpp"
+
+#include <map>
+
+namespace tut
+{
+    struct vocachestore_data
+    {
+        typedef std::map<U32, std::vector<U8> > contents_t;
+
+        vocachestore_data()
+        {
+            mFilename = gDirUtilp->getTempFilename();
+            mRegionID.generate();
+        }
+
+        ~vocachestore_data()
+        {
+            mStore.close();
+            LLFile::remove(mFilename);
+        }
+
+        void open(bool read_only = false)
+        {
+            ensure("opened", mStore.open(mFilename, CACHE_VERSION, 64, read_only));
+        }
+
+        // Body of an object, its CRC is the seed
+        static std::vector<U8> makeBody(U32 size, U32 seed)
+        {
+            std::vector<U8> body(size);
+            for (U32 i = 0; i < size; ++i)
+            {
+                body[i] = U8(i * 31 + seed);
+            }
+            return body;
+        }
+
+        bool write(const contents_t& contents, S32 hits = 0)
+        {
+            LLVOCacheStore::object_list_t objects;
+            for (const auto& entry : contents)
+            {
+                LLVOCacheStore::ObjectRecord obj;
+                obj.mLocalID = entry.first;
+                obj.mCRC = entry.second[0];
+                obj.mHitCount = hits;
+                obj.mData = entry.second.data();
+                obj.mSize = (U32)entry.second.size();
+                objects.push_back(obj);
+            }
+            return mStore.writeObjects(REGION, mRegionID, objects);
+        }
+
+        contents_t read(std::map<U32, S32>* hits = nullptr)
+        {
+            contents_t contents;
+            mStore.readObjects(REGION, [&](const LLVOCacheStore::ObjectRecord& obj)
+                {
+                    contents[obj.mLocalID].assign(obj.mData, obj.mData + obj.mSize);
+                    if (hits)
+                    {
+                        (*hits)[obj.mLocalID] = obj.mHitCount;
+                    }
+                });
+            return contents;
+        }
+
+        uintmax_t fileSize() const
+        {
+            return boost::filesystem::file_size(mFilename);
+        }
+
+        static constexpr U32 CACHE_VERSION = 17;
+        static constexpr U64 REGION = 0x0000100000002000ULL;
+        std::string mFilename;
+        LLUUID mRegionID;
+        LLVOCacheStore mStore;
+    };
+    typedef test_group<vocachestore_data> vocachestore_group;
+    typedef vocachestore_group::object vocachestore_object;
+    tut::vocachestore_group vocachestore("LLVOCacheStore");
+
+    template<> template<>
+    void vocachestore_object::test<1>()
+    {
+        // Append, read back and reopen
+        open();
+        ensure("empty", !mStore.hasRegion(REGION) && !mStore.readObjects(REGION, [](const LLVOCacheStore::ObjectRecord&) {}));
+
+        contents_t contents;
+        contents[1] = makeBody(100, 1);
+        contents[2] = makeBody(30, 2);
+        ensure("written", write(contents, 3));
+        ensure("region", mStore.hasRegion(REGION));
+
+        std::map<U32, S32> hits;
+        ensure("read back", read(&hits) == contents);
+        ensure_equals("hits", hits[1], 3);
+
+        // unchanged objects only get their counters updated
+        ensure("written again", write(contents, 5));
+        hits.clear();
+        ensure("same contents", read(&hits) == contents);
+        ensure_equals("updated hits", hits[2], 5);
+
+        mStore.close();
+        open();
+        LLUUID id;
+        ensure("region id", mStore.getRegionID(REGION, id) && id == mRegionID);
+        hits.clear();
+        ensure("reopened", read(&hits) == contents);
+        ensure_equals("reopened hits", hits[1], 5);
+
+        // another store version starts over
+        mStore.close();
+        ensure("other version", mStore.open(mFilename, CACHE_VERSION + 1, 64, false));
+        ensure("emptied", !mStore.hasRegion(REGION));
+    }
+
+    template<> template<>
+    void vocachestore_object::test<2>()
+    {
+        // Changed, removed objects and regions are superseded by tombstones
+        open();
+        contents_t contents;
+        contents[1] = makeBody(100, 1);
+        contents[2] = makeBody(30, 2);
+        contents[3] = makeBody(50, 3);
+        write(contents);
+
+        contents.erase(2);
+        contents[3] = makeBody(60, 4);
+        write(contents);
+        ensure("changed", read() == contents);
+
+        mStore.close();
+        open();
+        ensure("removed object stays removed", read() == contents);
+
+        // a region under another ID replaces the old one
+        mRegionID.generate();
+        contents_t other;
+        other[7] = makeBody(20, 7);
+        write(other);
+        ensure("replaced", read() == other);
+
+        mStore.removeRegion(REGION);
+        ensure("removed", !mStore.hasRegion(REGION));
+        mStore.close();
+        open();
+        ensure("removed region stays removed", !mStore.hasRegion(REGION) && mStore.getRegionCount() == 0);
+    }
+
+    template<> template<>
+    void vocachestore_object::test<3>()
+    {
+        // A store cut short by a crash keeps the records before the cut
+        open();
+        contents_t contents;
+        contents[1] = makeBody(10, 1);
+        write(contents);
+        contents[2] = makeBody(20, 2);
+        write(contents);
+        mStore.close();
+
+        // header (32), region record (40 + 24), object 1 (40 + 10, aligned
+        // to 56), then object 2 starts at 152: cut after its magic
+        boost::filesystem::resize_file(mFilename, 156);
+        open();
+        contents.erase(2);
+        ensure("cut record dropped", read() == contents);
+
+        // and the store goes on from there
+        contents[3] = makeBody(40, 3);
+        ensure("written after the cut", write(contents));
+        mStore.close();
+        open();
+        ensure("reopened after the cut", read() == contents);
+    }
+
+    template<> template<>
+    void vocachestore_object::test<4>()
+    {
+        // Superseded records are compacted away once they outweigh the rest
+        open();
+        contents_t contents;
+        for (U32 pass = 0; pass < 6; ++pass)
+        {
+            for (U32 id = 1; id <= 10; ++id)
+            {
+                contents[id] = makeBody(100 * 1024, pass * 16 + id);
+            }
+            ensure("written", write(contents));
+        }
+        const uintmax_t compacted_size = fileSize();
+        ensure("compacted", compacted_size < 4 * 1024 * 1024);
+        ensure("compacted contents", read() == contents);
+
+        mStore.close();
+        open();
+        ensure("reopened contents", read() == contents);
+    }
+
+    template<> template<>
+    void vocachestore_object::test<5>()
+    {
+        // Records read in place stay valid while the store grows and clears,
+        // compaction waits for them
+        open();
+        contents_t contents;
+        contents[1] = makeBody(1000, 1);
+        write(contents);
+
+        LLVOCacheStore::data_ref_t held;
+        const U8* held_data = nullptr;
+        mStore.readObjects(REGION, [&](const LLVOCacheStore::ObjectRecord& obj)
+            {
+                held = obj.mDataRef;
+                held_data = obj.mData;
+            });
+        ensure("held", held && held.get() == held_data);
+
+        // grows well past the initial mapping and supersedes everything
+        contents_t large;
+        for (U32 pass = 0; pass < 8; ++pass)
+        {
+            for (U32 id = 1; id <= 10; ++id)
+            {
+                large[id] = makeBody(100 * 1024, pass * 16 + id);
+            }
+            ensure("written while held", write(large));
+        }
+        ensure("not compacted while held", fileSize() > 4 * 1024 * 1024);
+        ensure("held data unchanged", std::equal(contents[1].begin(), contents[1].end(), held_data));
+        ensure("latest contents", read() == large);
+
+        mStore.clear();
+        ensure("cleared", !mStore.hasRegion(REGION));
+        ensure("held data survives clear", std::equal(contents[1].begin(), contents[1].end(), held_data));
+
+        // released, the next write compacts
+        held.reset();
+        write(contents);
+        ensure("compacted once released", fileSize() < 4 * 1024 * 1024);
+        ensure("contents after compaction", read() == contents);
+    }
+
+    template<> template<>
+    void vocachestore_object::test<6>()
+    {
+        // A read only store works on its own copy
+        open();
+        contents_t contents;
+        contents[1] = makeBody(100, 1);
+        write(contents);
+        mStore.close();
+
+        open(true);
+        ensure("read only contents", read() == contents);
+        ensure("no writes", !write(contents));
+        mStore.removeRegion(REGION);
+        ensure("not removed", mStore.hasRegion(REGION));
+    }
+}